@@ -96,6 +96,7 @@ struct output {
 #define TS_PAYLOAD_SIZE                 1316
 #define MAX_GAP                         (UCLOCK_FREQ)
 #define DEFAULT_TIME_LIMIT              (UCLOCK_FREQ * 10)
+#define DEFAULT_PREFETCH_SIZE           (64 * 1024 * 1024)
 
 /** 2^33 (max resolution of PCR, PTS and DTS) */
 #define POW2_33 UINT64_C(8589934592)
@@ -109,6 +110,8 @@ static const char *url = NULL;
 static const char *addr = "127.0.0.1";
 static const char *dump = NULL;
 static const char *user_agent = "hls2rtp/1.0";
+static unsigned int prefetch = 0;
+static uint64_t prefetch_size = DEFAULT_PREFETCH_SIZE;
 static struct output video_output = {
     .port = 5004,
     .rtp_type = 96,
@@ -662,6 +665,10 @@ static int catch_playlist(struct uprobe *uprobe,
     case UPROBE_HLS_PLAYLIST_RELOADED: {
         UBASE_SIGNATURE_CHECK(args, UPIPE_HLS_PLAYLIST_SIGNATURE);
         uprobe_notice(uprobe, NULL, "playlist reloaded");
+        if (prefetch &&
+            !ubase_check(upipe_hls_playlist_set_prefetch(upipe, prefetch,
+                                                         prefetch_size)))
+            uprobe_warn(uprobe, NULL, "fail to enable prefetching");
         uint64_t at = probe_playlist->at;
         if (at) {
             uint64_t remain = 0;
@@ -688,8 +695,17 @@ static int catch_playlist(struct uprobe *uprobe,
         return ret;
     }
 
-    case UPROBE_HLS_PLAYLIST_ITEM_END:
+    case UPROBE_HLS_PLAYLIST_ITEM_END: {
         UBASE_SIGNATURE_CHECK(args, UPIPE_HLS_PLAYLIST_SIGNATURE);
+        struct upipe_hls_playlist_stats stats;
+        if (prefetch &&
+            ubase_check(upipe_hls_playlist_get_stats(upipe, &stats)))
+            uprobe_dbg_va(uprobe, NULL, "prefetch %"PRIu64" hits "
+                          "%"PRIu64" misses %"PRIu64" evictions "
+                          "%"PRIu64" octets, %"PRIu64" stalls %.3f s",
+                          stats.hits, stats.misses, stats.evictions,
+                          stats.size, stats.stalls,
+                          (double)stats.stall_time / UCLOCK_FREQ);
         UBASE_RETURN(upipe_hls_playlist_next(upipe));
         UBASE_RETURN(upipe_hls_playlist_get_index(upipe, &sequence));
         if (variant_id != probe_playlist->variant_id) {
@@ -707,6 +723,7 @@ static int catch_playlist(struct uprobe *uprobe,
             cmd_quit();
         return ret;
     }
+    }
     return uprobe_throw_next(uprobe, upipe, event, args);
 }
 
@@ -1270,6 +1287,8 @@ enum opt {
     OPT_DELAY,
     OPT_QUIT_TIMEOUT,
     OPT_USER_AGENT,
+    OPT_PREFETCH,
+    OPT_PREFETCH_SIZE,
 #ifdef HAVE_BEARSSL
     OPT_USE_BEARSSL,
 #endif
@@ -1306,6 +1325,8 @@ static struct option options[] = {
     { "delay", required_argument, NULL, OPT_DELAY },
     { "quit-timeout", required_argument, NULL, OPT_QUIT_TIMEOUT },
     { "user-agent", required_argument, NULL, OPT_USER_AGENT },
+    { "prefetch", required_argument, NULL, OPT_PREFETCH },
+    { "prefetch-size", required_argument, NULL, OPT_PREFETCH_SIZE },
 #ifdef HAVE_BEARSSL
     { "use-bearssl", no_argument, NULL, OPT_USE_BEARSSL },
 #endif
@@ -1455,6 +1476,12 @@ int main(int argc, char **argv)
         case OPT_USER_AGENT:
             user_agent = optarg;
             break;
+        case OPT_PREFETCH:
+            prefetch = strtoul(optarg, NULL, 10);
+            break;
+        case OPT_PREFETCH_SIZE:
+            prefetch_size = strtoull(optarg, NULL, 10);
+            break;
 
         case OPT_HELP:
             return usage(argv[0], NULL);
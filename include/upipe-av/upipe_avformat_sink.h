@@ -60,6 +60,11 @@ enum upipe_avfsink_command {
     UPIPE_AVFSINK_GET_POSITION,
     /** sets a metadata value (const char *, const char *) */
     UPIPE_AVFSINK_SET_METADATA,
+    /** sets the write-behind buffer size of the I/O thread, 0 disables it
+     * (uint64_t) */
+    UPIPE_AVFSINK_SET_ASYNC,
+    /** returns the write-behind buffer size of the I/O thread (uint64_t *) */
+    UPIPE_AVFSINK_GET_ASYNC,
 };
 
 /** @This enumerates the avformat sink sub pipe private commands. */
@@ -232,6 +237,36 @@ static inline int upipe_avfsink_set_metadata(struct upipe *upipe,
                          UPIPE_AVFSINK_SIGNATURE, key, value);
 }
 
+/** @This sets the size of the write-behind buffer of the I/O thread. When
+ * it is not 0, the URL is opened, written and closed by a dedicated thread,
+ * and libavformat only queues data and seeks on the event loop, which never
+ * blocks: the header is written once the thread has opened the URL, and
+ * multiplexing pauses while the buffer is full. It only takes effect when
+ * the URL is opened, and requires a upump manager.
+ *
+ * @param upipe description structure of the pipe
+ * @param size size of the write-behind buffer in octets, or 0
+ * @return an error code
+ */
+static inline int upipe_avfsink_set_async(struct upipe *upipe, uint64_t size)
+{
+    return upipe_control(upipe, UPIPE_AVFSINK_SET_ASYNC,
+                         UPIPE_AVFSINK_SIGNATURE, size);
+}
+
+/** @This returns the size of the write-behind buffer of the I/O thread.
+ *
+ * @param upipe description structure of the pipe
+ * @param size_p filled in with the size of the write-behind buffer
+ * @return an error code
+ */
+static inline int upipe_avfsink_get_async(struct upipe *upipe,
+                                          uint64_t *size_p)
+{
+    return upipe_control(upipe, UPIPE_AVFSINK_GET_ASYNC,
+                         UPIPE_AVFSINK_SIGNATURE, size_p);
+}
+
 /** @This sets the default disposition flag.
  *
  * @param upipe description structure of the subpipe
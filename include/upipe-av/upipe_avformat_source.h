@@ -30,7 +30,12 @@ enum upipe_avfsrc_command {
      * (uint64_t *) */
     UPIPE_AVFSRC_GET_TIME,
     /** asks to read at the given time (uint64_t) */
-    UPIPE_AVFSRC_SET_TIME
+    UPIPE_AVFSRC_SET_TIME,
+    /** sets the read-ahead buffer size of the I/O thread, 0 disables it
+     * (uint64_t) */
+    UPIPE_AVFSRC_SET_ASYNC,
+    /** returns the read-ahead buffer size of the I/O thread (uint64_t *) */
+    UPIPE_AVFSRC_GET_ASYNC
 };
 
 /** @deprecated @This returns the content of an avformat option.
@@ -86,6 +91,35 @@ static inline int upipe_avfsrc_set_time(struct upipe *upipe, uint64_t time)
                          time);
 }
 
+/** @This sets the size of the read-ahead buffer of the I/O thread. When it
+ * is not 0, the URL is opened, probed and demultiplexed by a dedicated
+ * thread, which queues up to that many octets of packets for the event
+ * loop, so that slow storage or networks don't stall the other pipes. It
+ * only takes effect after the next call to @ref upipe_set_uri.
+ *
+ * @param upipe description structure of the pipe
+ * @param size size of the read-ahead buffer in octets, or 0
+ * @return an error code
+ */
+static inline int upipe_avfsrc_set_async(struct upipe *upipe, uint64_t size)
+{
+    return upipe_control(upipe, UPIPE_AVFSRC_SET_ASYNC,
+                         UPIPE_AVFSRC_SIGNATURE, size);
+}
+
+/** @This returns the size of the read-ahead buffer of the I/O thread.
+ *
+ * @param upipe description structure of the pipe
+ * @param size_p filled in with the size of the read-ahead buffer
+ * @return an error code
+ */
+static inline int upipe_avfsrc_get_async(struct upipe *upipe,
+                                         uint64_t *size_p)
+{
+    return upipe_control(upipe, UPIPE_AVFSRC_GET_ASYNC,
+                         UPIPE_AVFSRC_SIGNATURE, size_p);
+}
+
 /** @This returns the management structure for all avformat sources.
  *
  * @return pointer to manager
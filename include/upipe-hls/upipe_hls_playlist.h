@@ -19,6 +19,22 @@ extern "C" {
 
 #define UPIPE_HLS_PLAYLIST_SIGNATURE UBASE_FOURCC('m','3','u','p')
 
+/** @This describes the statistics of the segment prefetch cache. */
+struct upipe_hls_playlist_stats {
+    /** number of items played from the cache */
+    uint64_t hits;
+    /** number of items which were not prefetched */
+    uint64_t misses;
+    /** number of prefetched items dropped before being played */
+    uint64_t evictions;
+    /** number of octets currently in the cache */
+    uint64_t size;
+    /** number of times the playback waited for data */
+    uint64_t stalls;
+    /** cumulated waiting time, in units of UCLOCK_FREQ */
+    uint64_t stall_time;
+};
+
 /** @This extends @ref upipe_command with specific m3u playlist command. */
 enum upipe_hls_playlist_command {
     UPIPE_HLS_PLAYLIST_SENTINEL = UPIPE_CONTROL_LOCAL,
@@ -33,6 +49,14 @@ enum upipe_hls_playlist_command {
     UPIPE_HLS_PLAYLIST_NEXT,
     /** seek to this offset (uint64_t) */
     UPIPE_HLS_PLAYLIST_SEEK,
+    /** set the number of items to prefetch and the maximum size of the
+     * cache (unsigned int, uint64_t) */
+    UPIPE_HLS_PLAYLIST_SET_PREFETCH,
+    /** get the number of items to prefetch and the maximum size of the
+     * cache (unsigned int *, uint64_t *) */
+    UPIPE_HLS_PLAYLIST_GET_PREFETCH,
+    /** get the prefetch statistics (struct upipe_hls_playlist_stats *) */
+    UPIPE_HLS_PLAYLIST_GET_STATS,
 };
 
 /** @This converts m3u playlist specific command to a string.
@@ -49,6 +73,9 @@ static inline const char *upipe_hls_playlist_command_str(int cmd)
     UBASE_CASE_TO_STR(UPIPE_HLS_PLAYLIST_PLAY);
     UBASE_CASE_TO_STR(UPIPE_HLS_PLAYLIST_NEXT);
     UBASE_CASE_TO_STR(UPIPE_HLS_PLAYLIST_SEEK);
+    UBASE_CASE_TO_STR(UPIPE_HLS_PLAYLIST_SET_PREFETCH);
+    UBASE_CASE_TO_STR(UPIPE_HLS_PLAYLIST_GET_PREFETCH);
+    UBASE_CASE_TO_STR(UPIPE_HLS_PLAYLIST_GET_STATS);
     case UPIPE_HLS_PLAYLIST_SENTINEL: break;
     }
     return NULL;
@@ -118,6 +145,54 @@ static inline int upipe_hls_playlist_seek(struct upipe *upipe, uint64_t at,
                          UPIPE_HLS_PLAYLIST_SIGNATURE, at, offset_p);
 }
 
+/** @This sets the number of items to download ahead of the playing item.
+ * Prefetched items are kept in memory until they are played, and the
+ * farthest items are dropped when the cache exceeds the given size. The data
+ * of the playing item counts against this size, but is never dropped: when
+ * there is no room left, its source is blocked until the cache drains.
+ * Prefetching is disabled when items is 0 (default).
+ *
+ * @param upipe description structure of the pipe
+ * @param items number of items to prefetch
+ * @param max_size maximum size of the cache in octets
+ * @return an error code
+ */
+static inline int upipe_hls_playlist_set_prefetch(struct upipe *upipe,
+                                                  unsigned int items,
+                                                  uint64_t max_size)
+{
+    return upipe_control(upipe, UPIPE_HLS_PLAYLIST_SET_PREFETCH,
+                         UPIPE_HLS_PLAYLIST_SIGNATURE, items, max_size);
+}
+
+/** @This gets the prefetch settings.
+ *
+ * @param upipe description structure of the pipe
+ * @param items_p filled with the number of items to prefetch, may be NULL
+ * @param max_size_p filled with the maximum size of the cache, may be NULL
+ * @return an error code
+ */
+static inline int upipe_hls_playlist_get_prefetch(struct upipe *upipe,
+                                                  unsigned int *items_p,
+                                                  uint64_t *max_size_p)
+{
+    return upipe_control(upipe, UPIPE_HLS_PLAYLIST_GET_PREFETCH,
+                         UPIPE_HLS_PLAYLIST_SIGNATURE, items_p, max_size_p);
+}
+
+/** @This gets the prefetch statistics.
+ *
+ * @param upipe description structure of the pipe
+ * @param stats filled with the statistics
+ * @return an error code
+ */
+static inline int upipe_hls_playlist_get_stats(
+    struct upipe *upipe, struct upipe_hls_playlist_stats *stats)
+{
+    return upipe_control(upipe, UPIPE_HLS_PLAYLIST_GET_STATS,
+                         UPIPE_HLS_PLAYLIST_SIGNATURE, stats);
+}
+
 /** @This extends @ref uprobe_event with specific m3u playlist events. */
 enum uprobe_hls_playlist_event {
     UPROBE_HLS_PLAYLIST_SENTINEL = UPROBE_LOCAL,
@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short Upipe HLS sink module - writes TS segments and a media playlist
+ *
+ * This pipe expects a transport stream (typically the output of a
+ * @ref upipe_ts_mux) and cuts it into segments on the random access points
+ * of a PID. Segments are written with an inner file sink and the media
+ * playlist is atomically rewritten each time a segment or a low-latency
+ * partial segment is complete.
+ */
+
+#ifndef _UPIPE_HLS_UPIPE_HLS_SINK_H_
+# define _UPIPE_HLS_UPIPE_HLS_SINK_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "upipe/upipe.h"
+
+#define UPIPE_HLS_SINK_SIGNATURE UBASE_FOURCC('h','l','s','s')
+/** use the video PID, or the PCR PID if there is none, to cut segments */
+#define UPIPE_HLS_SINK_AUTO_PID 8192
+
+/** @This extends upipe_command with specific commands for HLS sink. */
+enum upipe_hls_sink_command {
+    UPIPE_HLS_SINK_SENTINEL = UPIPE_CONTROL_LOCAL,
+
+    /** sets the manager of the inner file sink (struct upipe_mgr *) */
+    UPIPE_HLS_SINK_SET_FSINK_MGR,
+    /** sets the playlist path and the segment prefix
+     * (const char *, const char *) */
+    UPIPE_HLS_SINK_SET_PATH,
+    /** returns the playlist path and the segment prefix
+     * (const char **, const char **) */
+    UPIPE_HLS_SINK_GET_PATH,
+    /** sets the target durations of segments and parts (uint64_t, uint64_t) */
+    UPIPE_HLS_SINK_SET_DURATION,
+    /** returns the target durations of segments and parts
+     * (uint64_t *, uint64_t *) */
+    UPIPE_HLS_SINK_GET_DURATION,
+    /** sets the number of segments in the playlist (unsigned int) */
+    UPIPE_HLS_SINK_SET_WINDOW,
+    /** returns the number of segments in the playlist (unsigned int *) */
+    UPIPE_HLS_SINK_GET_WINDOW,
+    /** sets the PID carrying the random access points (unsigned int) */
+    UPIPE_HLS_SINK_SET_PID,
+    /** returns the PID carrying the random access points (unsigned int *) */
+    UPIPE_HLS_SINK_GET_PID,
+};
+
+/** @This converts @ref upipe_hls_sink_command to a string.
+ *
+ * @param command command to convert
+ * @return a string or NULL if invalid
+ */
+static inline const char *upipe_hls_sink_command_str(int command)
+{
+    switch ((enum upipe_hls_sink_command)command) {
+    UBASE_CASE_TO_STR(UPIPE_HLS_SINK_SET_FSINK_MGR);
+    UBASE_CASE_TO_STR(UPIPE_HLS_SINK_SET_PATH);
+    UBASE_CASE_TO_STR(UPIPE_HLS_SINK_GET_PATH);
+    UBASE_CASE_TO_STR(UPIPE_HLS_SINK_SET_DURATION);
+    UBASE_CASE_TO_STR(UPIPE_HLS_SINK_GET_DURATION);
+    UBASE_CASE_TO_STR(UPIPE_HLS_SINK_SET_WINDOW);
+    UBASE_CASE_TO_STR(UPIPE_HLS_SINK_GET_WINDOW);
+    UBASE_CASE_TO_STR(UPIPE_HLS_SINK_SET_PID);
+    UBASE_CASE_TO_STR(UPIPE_HLS_SINK_GET_PID);
+    case UPIPE_HLS_SINK_SENTINEL: break;
+    }
+    return NULL;
+}
+
+/** @This sets the manager used to allocate the inner file sink, which
+ * writes the segments. It must be set before the path.
+ *
+ * @param upipe description structure of the pipe
+ * @param fsink_mgr file sink manager
+ * @return an error code
+ */
+static inline int upipe_hls_sink_set_fsink_mgr(struct upipe *upipe,
+                                               struct upipe_mgr *fsink_mgr)
+{
+    return upipe_control(upipe, UPIPE_HLS_SINK_SET_FSINK_MGR,
+                         UPIPE_HLS_SINK_SIGNATURE, fsink_mgr);
+}
+
+/** @This sets the path of the media playlist and the prefix of the
+ * segments. Segments are written next to the playlist, in files named
+ * after the prefix and their media sequence, for instance "prefix42.ts".
+ *
+ * @param upipe description structure of the pipe
+ * @param playlist path of the media playlist
+ * @param prefix prefix of the segment files, relative to the playlist
+ * @return an error code
+ */
+static inline int upipe_hls_sink_set_path(struct upipe *upipe,
+                                          const char *playlist,
+                                          const char *prefix)
+{
+    return upipe_control(upipe, UPIPE_HLS_SINK_SET_PATH,
+                         UPIPE_HLS_SINK_SIGNATURE, playlist, prefix);
+}
+
+/** @This returns the path of the media playlist and the prefix of the
+ * segments.
+ *
+ * @param upipe description structure of the pipe
+ * @param playlist_p filled in with the path of the media playlist
+ * @param prefix_p filled in with the prefix of the segment files
+ * @return an error code
+ */
+static inline int upipe_hls_sink_get_path(struct upipe *upipe,
+                                          const char **playlist_p,
+                                          const char **prefix_p)
+{
+    return upipe_control(upipe, UPIPE_HLS_SINK_GET_PATH,
+                         UPIPE_HLS_SINK_SIGNATURE, playlist_p, prefix_p);
+}
+
+/** @This sets the target durations of the segments and of the low-latency
+ * partial segments. Segments are cut on the first random access point
+ * after the target duration. Parts are advertised as byte ranges of
+ * their segment.
+ *
+ * @param upipe description structure of the pipe
+ * @param duration segment target duration, in units of UCLOCK_FREQ
+ * @param part part target duration, or 0 to disable partial segments
+ * @return an error code
+ */
+static inline int upipe_hls_sink_set_duration(struct upipe *upipe,
+                                              uint64_t duration,
+                                              uint64_t part)
+{
+    return upipe_control(upipe, UPIPE_HLS_SINK_SET_DURATION,
+                         UPIPE_HLS_SINK_SIGNATURE, duration, part);
+}
+
+/** @This returns the target durations of the segments and of the parts.
+ *
+ * @param upipe description structure of the pipe
+ * @param duration_p filled in with the segment target duration
+ * @param part_p filled in with the part target duration
+ * @return an error code
+ */
+static inline int upipe_hls_sink_get_duration(struct upipe *upipe,
+                                              uint64_t *duration_p,
+                                              uint64_t *part_p)
+{
+    return upipe_control(upipe, UPIPE_HLS_SINK_GET_DURATION,
+                         UPIPE_HLS_SINK_SIGNATURE, duration_p, part_p);
+}
+
+/** @This sets the number of segments listed in the playlist. Segment files
+ * are deleted once they have been out of the playlist for as long. 0 keeps
+ * all the segments (event playlist).
+ *
+ * @param upipe description structure of the pipe
+ * @param window number of segments
+ * @return an error code
+ */
+static inline int upipe_hls_sink_set_window(struct upipe *upipe,
+                                            unsigned int window)
+{
+    return upipe_control(upipe, UPIPE_HLS_SINK_SET_WINDOW,
+                         UPIPE_HLS_SINK_SIGNATURE, window);
+}
+
+/** @This returns the number of segments listed in the playlist.
+ *
+ * @param upipe description structure of the pipe
+ * @param window_p filled in with the number of segments
+ * @return an error code
+ */
+static inline int upipe_hls_sink_get_window(struct upipe *upipe,
+                                            unsigned int *window_p)
+{
+    return upipe_control(upipe, UPIPE_HLS_SINK_GET_WINDOW,
+                         UPIPE_HLS_SINK_SIGNATURE, window_p);
+}
+
+/** @This sets the PID whose random access points start the segments.
+ *
+ * @param upipe description structure of the pipe
+ * @param pid PID, or @ref UPIPE_HLS_SINK_AUTO_PID for the first video PID
+ * of the PMT, or the PCR PID if there is none
+ * @return an error code
+ */
+static inline int upipe_hls_sink_set_pid(struct upipe *upipe,
+                                         unsigned int pid)
+{
+    return upipe_control(upipe, UPIPE_HLS_SINK_SET_PID,
+                         UPIPE_HLS_SINK_SIGNATURE, pid);
+}
+
+/** @This returns the PID whose random access points start the segments.
+ *
+ * @param upipe description structure of the pipe
+ * @param pid_p filled in with the PID
+ * @return an error code
+ */
+static inline int upipe_hls_sink_get_pid(struct upipe *upipe,
+                                         unsigned int *pid_p)
+{
+    return upipe_control(upipe, UPIPE_HLS_SINK_GET_PID,
+                         UPIPE_HLS_SINK_SIGNATURE, pid_p);
+}
+
+/** @This returns the management structure for HLS sink pipes.
+ *
+ * @return pointer to manager
+ */
+struct upipe_mgr *upipe_hls_sink_mgr_alloc(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* !_UPIPE_HLS_UPIPE_HLS_SINK_H_ */
@@ -36,6 +36,24 @@ enum upipe_fsink_mode {
     UPIPE_FSINK_CREATE
 };
 
+/** @This describes the statistics of the writer thread. */
+struct upipe_fsink_stats {
+    /** number of buffers waiting to be written */
+    unsigned int queue_depth;
+    /** number of bytes waiting to be written */
+    uint64_t queued_bytes;
+    /** highest number of bytes waiting to be written */
+    uint64_t max_queued_bytes;
+    /** number of completed writes */
+    uint64_t writes;
+    /** duration of the last write, in units of UCLOCK_FREQ */
+    uint64_t last_latency;
+    /** duration of the longest write, in units of UCLOCK_FREQ */
+    uint64_t max_latency;
+    /** cumulated duration of all writes, in units of UCLOCK_FREQ */
+    uint64_t total_latency;
+};
+
 /** @This extends upipe_command with specific commands for file sink. */
 enum upipe_fsink_command {
     UPIPE_FSINK_SENTINEL = UPIPE_CONTROL_LOCAL,
@@ -52,6 +70,21 @@ enum upipe_fsink_command {
     UPIPE_FSINK_SET_SYNC_PERIOD,
     /** gets fdatasync period (uint64_t *) */
     UPIPE_FSINK_GET_SYNC_PERIOD,
+    /** sets the byte budget of the writer thread, 0 disables it (uint64_t) */
+    UPIPE_FSINK_SET_ASYNC,
+    /** gets the byte budget of the writer thread (uint64_t *) */
+    UPIPE_FSINK_GET_ASYNC,
+    /** gets the writer thread statistics (struct upipe_fsink_stats *) */
+    UPIPE_FSINK_GET_STATS,
+    /** sets the size of coalesced blocks and O_DIRECT (unsigned int, int) */
+    UPIPE_FSINK_SET_COALESCE,
+    /** gets the size of coalesced blocks and O_DIRECT (unsigned int *,
+     * int *) */
+    UPIPE_FSINK_GET_COALESCE,
+    /** sets the size preallocated when opening a file (uint64_t) */
+    UPIPE_FSINK_SET_PREALLOCATE,
+    /** gets the size preallocated when opening a file (uint64_t *) */
+    UPIPE_FSINK_GET_PREALLOCATE,
 
     /** outer pipes commands begin here */
     UPIPE_FSINK_CONTROL_LOCAL = UPIPE_CONTROL_LOCAL + 0x1000
@@ -145,6 +178,111 @@ static inline int upipe_fsink_set_sync_period(struct upipe *upipe,
                          UPIPE_FSINK_SIGNATURE, sync_period);
 }
 
+/** @This sets the byte budget of the writer thread. When it is not 0,
+ * buffers are written by a dedicated thread so that slow storage doesn't
+ * stall the event loop, and the input is blocked while more than the given
+ * number of bytes are waiting to be written.
+ *
+ * @param upipe description structure of the pipe
+ * @param budget maximum number of bytes waiting to be written, or 0
+ * @return an error code
+ */
+static inline int upipe_fsink_set_async(struct upipe *upipe, uint64_t budget)
+{
+    return upipe_control(upipe, UPIPE_FSINK_SET_ASYNC,
+                         UPIPE_FSINK_SIGNATURE, budget);
+}
+
+/** @This returns the byte budget of the writer thread.
+ *
+ * @param upipe description structure of the pipe
+ * @param budget_p filled in with the byte budget
+ * @return an error code
+ */
+static inline int upipe_fsink_get_async(struct upipe *upipe,
+                                        uint64_t *budget_p)
+{
+    return upipe_control(upipe, UPIPE_FSINK_GET_ASYNC,
+                         UPIPE_FSINK_SIGNATURE, budget_p);
+}
+
+/** @This returns the statistics of the writer thread.
+ *
+ * @param upipe description structure of the pipe
+ * @param stats filled in with the statistics
+ * @return an error code
+ */
+static inline int upipe_fsink_get_stats(struct upipe *upipe,
+                                        struct upipe_fsink_stats *stats)
+{
+    return upipe_control(upipe, UPIPE_FSINK_GET_STATS,
+                         UPIPE_FSINK_SIGNATURE, stats);
+}
+
+/** @This sets the size of coalesced blocks. When it is not 0, incoming
+ * buffers are copied into aligned blocks of the given size (rounded up to
+ * 4096 octets), which are written when they are full, and the partial
+ * block is written when the file is closed or changed. With O_DIRECT, full
+ * blocks bypass the page cache, if the file system supports it.
+ *
+ * @param upipe description structure of the pipe
+ * @param size size of coalesced blocks, or 0
+ * @param direct true to write coalesced blocks with O_DIRECT
+ * @return an error code
+ */
+static inline int upipe_fsink_set_coalesce(struct upipe *upipe,
+                                           unsigned int size, bool direct)
+{
+    return upipe_control(upipe, UPIPE_FSINK_SET_COALESCE,
+                         UPIPE_FSINK_SIGNATURE, size, direct ? 1 : 0);
+}
+
+/** @This returns the size of coalesced blocks.
+ *
+ * @param upipe description structure of the pipe
+ * @param size_p filled in with the size of coalesced blocks
+ * @param direct_p filled in with true if O_DIRECT is requested
+ * @return an error code
+ */
+static inline int upipe_fsink_get_coalesce(struct upipe *upipe,
+                                           unsigned int *size_p,
+                                           bool *direct_p)
+{
+    int direct;
+    int err = upipe_control(upipe, UPIPE_FSINK_GET_COALESCE,
+                            UPIPE_FSINK_SIGNATURE, size_p, &direct);
+    if (ubase_check(err) && direct_p != NULL)
+        *direct_p = !!direct;
+    return err;
+}
+
+/** @This sets the size preallocated on disk when opening a file, without
+ * changing the visible file size.
+ *
+ * @param upipe description structure of the pipe
+ * @param size size to preallocate, or 0
+ * @return an error code
+ */
+static inline int upipe_fsink_set_preallocate(struct upipe *upipe,
+                                              uint64_t size)
+{
+    return upipe_control(upipe, UPIPE_FSINK_SET_PREALLOCATE,
+                         UPIPE_FSINK_SIGNATURE, size);
+}
+
+/** @This returns the size preallocated on disk when opening a file.
+ *
+ * @param upipe description structure of the pipe
+ * @param size_p filled in with the size to preallocate
+ * @return an error code
+ */
+static inline int upipe_fsink_get_preallocate(struct upipe *upipe,
+                                              uint64_t *size_p)
+{
+    return upipe_control(upipe, UPIPE_FSINK_GET_PREALLOCATE,
+                         UPIPE_FSINK_SIGNATURE, size_p);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -27,6 +27,45 @@ extern "C" {
  */
 struct upipe_mgr *upipe_fsrc_mgr_alloc(void);
 
+/** @This extends upipe_command with specific commands for file source. */
+enum upipe_fsrc_command {
+    UPIPE_FSRC_SENTINEL = UPIPE_CONTROL_LOCAL,
+
+    /** returns the size of mapped windows (uint64_t *) */
+    UPIPE_FSRC_GET_MMAP,
+    /** sets the size of mapped windows, 0 to read the file (uint64_t) */
+    UPIPE_FSRC_SET_MMAP
+};
+
+/** @This returns the size of the windows of the file mapped in memory.
+ *
+ * @param upipe description structure of the pipe
+ * @param window_p filled in with the size of mapped windows, or 0
+ * @return an error code
+ */
+static inline int upipe_fsrc_get_mmap(struct upipe *upipe, uint64_t *window_p)
+{
+    return upipe_control(upipe, UPIPE_FSRC_GET_MMAP, UPIPE_FSRC_SIGNATURE,
+                         window_p);
+}
+
+/** @This sets the size of the windows of the file mapped in memory. When it
+ * is not 0, regular files are mapped by windows of the given size, and
+ * output buffers point directly to the mapped pages instead of being read
+ * into new buffers. A window is unmapped when the last buffer pointing to it
+ * is released. The mapping is private, so that downstream pipes writing to
+ * the buffers do not alter the file.
+ *
+ * @param upipe description structure of the pipe
+ * @param window size of mapped windows, or 0
+ * @return an error code
+ */
+static inline int upipe_fsrc_set_mmap(struct upipe *upipe, uint64_t window)
+{
+    return upipe_control(upipe, UPIPE_FSRC_SET_MMAP, UPIPE_FSRC_SIGNATURE,
+                         window);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -133,6 +133,16 @@ enum upipe_http_src_command {
     UPIPE_HTTP_SRC_GET_USER_AGENT,
     /** set the user agent to use (const char *) */
     UPIPE_HTTP_SRC_SET_USER_AGENT,
+    /** get the parallel range requests settings
+     * (unsigned int *, uint64_t *) */
+    UPIPE_HTTP_SRC_GET_PARALLEL,
+    /** set the number of connections and the size of parallel range
+     * requests (unsigned int, uint64_t) */
+    UPIPE_HTTP_SRC_SET_PARALLEL,
+    /** get the maximum read size (unsigned int *) */
+    UPIPE_HTTP_SRC_GET_MAX_READ_SIZE,
+    /** set the maximum read size (unsigned int) */
+    UPIPE_HTTP_SRC_SET_MAX_READ_SIZE,
 };
 
 /** @This converts an enum upipe_http_src_command to a string.
@@ -147,6 +157,10 @@ static inline const char *upipe_http_src_command_str(int cmd)
     UBASE_CASE_TO_STR(UPIPE_HTTP_SRC_SET_TIMEOUT);
     UBASE_CASE_TO_STR(UPIPE_HTTP_SRC_GET_USER_AGENT);
     UBASE_CASE_TO_STR(UPIPE_HTTP_SRC_SET_USER_AGENT);
+    UBASE_CASE_TO_STR(UPIPE_HTTP_SRC_GET_PARALLEL);
+    UBASE_CASE_TO_STR(UPIPE_HTTP_SRC_SET_PARALLEL);
+    UBASE_CASE_TO_STR(UPIPE_HTTP_SRC_GET_MAX_READ_SIZE);
+    UBASE_CASE_TO_STR(UPIPE_HTTP_SRC_SET_MAX_READ_SIZE);
     case UPIPE_HTTP_SRC_SENTINEL: break;
     }
     return NULL;
@@ -204,6 +218,68 @@ static inline int upipe_http_src_set_timeout(struct upipe *upipe,
                          UPIPE_HTTP_SRC_SIGNATURE, timeout);
 }
 
+/** @This gets the parallel range requests settings.
+ *
+ * @param upipe description structure of the pipe
+ * @param connections_p filled with the maximum number of connections
+ * @param part_size_p filled with the size of each range request
+ * @return an error code
+ */
+static inline int upipe_http_src_get_parallel(struct upipe *upipe,
+                                              unsigned int *connections_p,
+                                              uint64_t *part_size_p)
+{
+    return upipe_control(upipe, UPIPE_HTTP_SRC_GET_PARALLEL,
+                         UPIPE_HTTP_SRC_SIGNATURE, connections_p, part_size_p);
+}
+
+/** @This sets the parallel range requests settings. When the server
+ * answers the first request with a partial content giving the total size,
+ * the remaining data is fetched by range requests of part_size bytes over
+ * up to connections simultaneous connections, and output in order. This is
+ * only done for plain http connections. It applies to the next opened url.
+ *
+ * @param upipe description structure of the pipe
+ * @param connections maximum number of connections, 0 or 1 to disable
+ * @param part_size size of each range request
+ * @return an error code
+ */
+static inline int upipe_http_src_set_parallel(struct upipe *upipe,
+                                              unsigned int connections,
+                                              uint64_t part_size)
+{
+    return upipe_control(upipe, UPIPE_HTTP_SRC_SET_PARALLEL,
+                         UPIPE_HTTP_SRC_SIGNATURE, connections, part_size);
+}
+
+/** @This gets the maximum read size.
+ *
+ * @param upipe description structure of the pipe
+ * @param max_read_size_p filled with the maximum read size
+ * @return an error code
+ */
+static inline int upipe_http_src_get_max_read_size(struct upipe *upipe,
+        unsigned int *max_read_size_p)
+{
+    return upipe_control(upipe, UPIPE_HTTP_SRC_GET_MAX_READ_SIZE,
+                         UPIPE_HTTP_SRC_SIGNATURE, max_read_size_p);
+}
+
+/** @This sets the maximum read size. Reads start with the output size and
+ * grow up to this size while the socket fills them, and shrink back when
+ * it does not. A value lower than the output size disables adaptation.
+ *
+ * @param upipe description structure of the pipe
+ * @param max_read_size maximum read size in octets
+ * @return an error code
+ */
+static inline int upipe_http_src_set_max_read_size(struct upipe *upipe,
+        unsigned int max_read_size)
+{
+    return upipe_control(upipe, UPIPE_HTTP_SRC_SET_MAX_READ_SIZE,
+                         UPIPE_HTTP_SRC_SIGNATURE, max_read_size);
+}
+
 /** @This extends upipe_mgr_command with specific commands for http source. */
 enum upipe_http_src_mgr_command {
     UPIPE_HTTP_SRC_MGR_SENTINEL = UPIPE_MGR_CONTROL_LOCAL,
@@ -222,6 +298,11 @@ enum upipe_http_src_mgr_command {
     UPIPE_HTTP_SRC_MGR_GET_USER_AGENT,
     /** set user agent (const char *) */
     UPIPE_HTTP_SRC_MGR_SET_USER_AGENT,
+
+    /** get the maximum number of idle connections (unsigned int *) */
+    UPIPE_HTTP_SRC_MGR_GET_KEEPALIVE,
+    /** set the maximum number of idle connections (unsigned int) */
+    UPIPE_HTTP_SRC_MGR_SET_KEEPALIVE,
 };
 
 /** @This sets the proxy url to use by default for the new allocated pipes.
@@ -276,6 +357,36 @@ static inline int upipe_http_src_mgr_get_user_agent(struct upipe_mgr *mgr,
                              UPIPE_HTTP_SRC_SIGNATURE, user_agent_p);
 }
 
+/** @This sets the maximum number of idle connections kept open by the
+ * manager. When a plain http response completes and the server allows it,
+ * the connection is kept and reused by the next pipe of this manager
+ * requesting the same host.
+ *
+ * @param mgr pointer to upipe manager
+ * @param keepalive maximum number of idle connections, 0 to disable
+ * @return an error code
+ */
+static inline int upipe_http_src_mgr_set_keepalive(struct upipe_mgr *mgr,
+                                                   unsigned int keepalive)
+{
+    return upipe_mgr_control(mgr, UPIPE_HTTP_SRC_MGR_SET_KEEPALIVE,
+                             UPIPE_HTTP_SRC_SIGNATURE, keepalive);
+}
+
+/** @This gets the maximum number of idle connections kept open by the
+ * manager.
+ *
+ * @param mgr pointer to upipe manager
+ * @param keepalive_p filled with the maximum number of idle connections
+ * @return an error code
+ */
+static inline int upipe_http_src_mgr_get_keepalive(struct upipe_mgr *mgr,
+                                                   unsigned int *keepalive_p)
+{
+    return upipe_mgr_control(mgr, UPIPE_HTTP_SRC_MGR_GET_KEEPALIVE,
+                             UPIPE_HTTP_SRC_SIGNATURE, keepalive_p);
+}
+
 /** @This adds a cookie in the manager cookie list.
  *
  * @param mgr pointer to upipe manager
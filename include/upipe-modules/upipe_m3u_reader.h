@@ -10,8 +10,56 @@
 extern "C" {
 #endif
 
+#include "upipe/upipe.h"
+
 # define UPIPE_M3U_READER_SIGNATURE UBASE_FOURCC('m','3','u','r')
 
+/** @This extends upipe_command with specific commands for m3u reader. */
+enum upipe_m3u_reader_command {
+    UPIPE_M3U_READER_SENTINEL = UPIPE_CONTROL_LOCAL,
+
+    /** only outputs the segments changed since the previous playlist
+     * (int) */
+    UPIPE_M3U_READER_SET_INCREMENTAL,
+    /** returns true if incremental parsing is enabled (int *) */
+    UPIPE_M3U_READER_GET_INCREMENTAL,
+};
+
+/** @This enables or disables incremental parsing of the refreshed media
+ * playlists. When enabled, the leading segments which are byte for byte
+ * identical to the previous playlist are neither parsed nor output again,
+ * and their number is set in the flow definition (see
+ * @ref uref_m3u_playlist_flow_get_kept). At least one segment is output
+ * for each non-empty playlist.
+ *
+ * @param upipe description structure of the pipe
+ * @param enabled true to enable incremental parsing
+ * @return an error code
+ */
+static inline int upipe_m3u_reader_set_incremental(struct upipe *upipe,
+                                                   bool enabled)
+{
+    return upipe_control(upipe, UPIPE_M3U_READER_SET_INCREMENTAL,
+                         UPIPE_M3U_READER_SIGNATURE, enabled ? 1 : 0);
+}
+
+/** @This returns whether incremental parsing is enabled.
+ *
+ * @param upipe description structure of the pipe
+ * @param enabled_p filled with true if incremental parsing is enabled
+ * @return an error code
+ */
+static inline int upipe_m3u_reader_get_incremental(struct upipe *upipe,
+                                                   bool *enabled_p)
+{
+    int enabled;
+    UBASE_RETURN(upipe_control(upipe, UPIPE_M3U_READER_GET_INCREMENTAL,
+                               UPIPE_M3U_READER_SIGNATURE, &enabled));
+    if (enabled_p)
+        *enabled_p = !!enabled;
+    return UBASE_ERR_NONE;
+}
+
 /** @This returns the management structure for m3u reader.
  *
  * @return pointer to manager
@@ -29,6 +29,24 @@ extern "C" {
 #define UPIPE_MULTICAT_SINK_DEF_ROTATE UINT64_C(97200000000)
 #define UPIPE_MULTICAT_SINK_DEF_ROTATE_OFFSET UINT64_C(0)
 
+/** size of an entry of the index sidecar: a big-endian 64-bit date
+ * (cr_sys), the big-endian 64-bit offset of the packet in the data file,
+ * ORed with @ref UPIPE_MULTICAT_INDEX_RAP, and the big-endian 64-bit offset
+ * of the last random access point of the data file at or before the packet,
+ * or UINT64_MAX */
+#define UPIPE_MULTICAT_INDEX_ENTRY_SIZE 24
+/** flag of index entries pointing to a random access point */
+#define UPIPE_MULTICAT_INDEX_RAP UINT64_C(0x8000000000000000)
+
+/** @This defines how random access points are detected. */
+enum upipe_multicat_sink_rap {
+    /** packets flagged with @ref uref_flow_set_random */
+    UPIPE_MULTICAT_SINK_RAP_FLOW,
+    /** TS packets with the random access indicator of the adaptation
+     * field */
+    UPIPE_MULTICAT_SINK_RAP_TS
+};
+
 /** @This extends upipe_command with specific commands for multicat sink. */
 enum upipe_multicat_sink_command {
     UPIPE_MULTICAT_SINK_SENTINEL = UPIPE_FSINK_CONTROL_LOCAL,
@@ -47,7 +65,17 @@ enum upipe_multicat_sink_command {
     /** sets fsink manager (struct upipe_fsink_mgr *) */
     UPIPE_MULTICAT_SINK_SET_FSINK_MGR,
     /** gets fsink manager (struct upipe_fsink_mgr **) */
-    UPIPE_MULTICAT_SINK_GET_FSINK_MGR
+    UPIPE_MULTICAT_SINK_GET_FSINK_MGR,
+    /** gets the index suffix and interval (const char **, uint64_t *) */
+    UPIPE_MULTICAT_SINK_GET_INDEX,
+    /** sets the index suffix and interval (const char *, uint64_t) */
+    UPIPE_MULTICAT_SINK_SET_INDEX,
+    /** gets the detection of random access points
+     * (enum upipe_multicat_sink_rap *) */
+    UPIPE_MULTICAT_SINK_GET_RAP,
+    /** sets the detection of random access points
+     * (enum upipe_multicat_sink_rap) */
+    UPIPE_MULTICAT_SINK_SET_RAP
 };
 
 /** @This returns the management structure for multicat_sink pipes.
@@ -161,6 +189,71 @@ static inline int
                                 UPIPE_MULTICAT_SINK_SIGNATURE, fsink_mgr);
 }
 
+/** @This returns the index sidecar configuration.
+ *
+ * @param upipe description structure of the pipe
+ * @param suffix_p filled in with the suffix of index files, or NULL
+ * @param interval_p filled in with the interval between entries in 27MHz
+ * @return an error code
+ */
+static inline int
+    upipe_multicat_sink_get_index(struct upipe *upipe,
+                                  const char **suffix_p, uint64_t *interval_p)
+{
+    return upipe_control(upipe, UPIPE_MULTICAT_SINK_GET_INDEX,
+                         UPIPE_MULTICAT_SINK_SIGNATURE, suffix_p, interval_p);
+}
+
+/** @This asks to write an index sidecar next to each data file, starting
+ * from the next file. An entry is written for the first packet of each
+ * file, for packets flagged as random access points, and at least every
+ * given interval.
+ *
+ * @param upipe description structure of the pipe
+ * @param suffix suffix of index files, or NULL to disable the index
+ * @param interval minimum interval between entries in 27MHz
+ * @return an error code
+ */
+static inline int
+    upipe_multicat_sink_set_index(struct upipe *upipe,
+                                  const char *suffix, uint64_t interval)
+{
+    return upipe_control(upipe, UPIPE_MULTICAT_SINK_SET_INDEX,
+                         UPIPE_MULTICAT_SINK_SIGNATURE, suffix, interval);
+}
+
+/** @This returns how random access points are detected.
+ *
+ * @param upipe description structure of the pipe
+ * @param rap_p filled in with the detection of random access points
+ * @return an error code
+ */
+static inline int
+    upipe_multicat_sink_get_rap(struct upipe *upipe,
+                                enum upipe_multicat_sink_rap *rap_p)
+{
+    return upipe_control(upipe, UPIPE_MULTICAT_SINK_GET_RAP,
+                         UPIPE_MULTICAT_SINK_SIGNATURE, rap_p);
+}
+
+/** @This sets how random access points are detected for the index. By
+ * default, packets flagged with @ref uref_flow_set_random are random access
+ * points. With @ref UPIPE_MULTICAT_SINK_RAP_TS, the packets are parsed as
+ * TS, and the TS packets with the random access indicator set are random
+ * access points.
+ *
+ * @param upipe description structure of the pipe
+ * @param rap detection of random access points
+ * @return an error code
+ */
+static inline int
+    upipe_multicat_sink_set_rap(struct upipe *upipe,
+                                enum upipe_multicat_sink_rap rap)
+{
+    return upipe_control(upipe, UPIPE_MULTICAT_SINK_SET_RAP,
+                         UPIPE_MULTICAT_SINK_SIGNATURE, rap);
+}
+
 #ifdef __cplusplus
 }
 #endif
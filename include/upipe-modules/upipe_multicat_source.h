@@ -27,6 +27,7 @@ UREF_ATTR_STRING(msrc_flow, data, "msrc.data", data suffix)
 UREF_ATTR_STRING(msrc_flow, aux, "msrc.aux", aux suffix)
 UREF_ATTR_UNSIGNED(msrc_flow, rotate, "msrc.rotate", rotate interval)
 UREF_ATTR_UNSIGNED(msrc_flow, offset, "msrc.offset", rotate offset)
+UREF_ATTR_STRING(msrc_flow, index, "msrc.index", index suffix)
 
 #define UPIPE_MSRC_SIGNATURE UBASE_FOURCC('m','s','r','c')
 #define UPIPE_MSRC_DEF_ROTATE UINT64_C(97200000000)
@@ -38,6 +39,45 @@ UREF_ATTR_UNSIGNED(msrc_flow, offset, "msrc.offset", rotate offset)
  */
 struct upipe_mgr *upipe_msrc_mgr_alloc(void);
 
+/** @This extends upipe_command with specific commands for multicat source. */
+enum upipe_msrc_command {
+    UPIPE_MSRC_SENTINEL = UPIPE_CONTROL_LOCAL,
+
+    /** returns the number of packets read at once (unsigned int *) */
+    UPIPE_MSRC_GET_BATCH,
+    /** sets the number of packets read at once (unsigned int) */
+    UPIPE_MSRC_SET_BATCH
+};
+
+/** @This returns the number of packets read at once.
+ *
+ * @param upipe description structure of the pipe
+ * @param batch_p filled in with the number of packets
+ * @return an error code
+ */
+static inline int upipe_msrc_get_batch(struct upipe *upipe,
+                                       unsigned int *batch_p)
+{
+    return upipe_control(upipe, UPIPE_MSRC_GET_BATCH, UPIPE_MSRC_SIGNATURE,
+                         batch_p);
+}
+
+/** @This sets the number of packets read at once (default 1). With more
+ * than one packet, data and aux records are read in a single call each, and
+ * the packets of a batch share the memory of the chunk. The whole batch is
+ * output by the same idler callback.
+ *
+ * @param upipe description structure of the pipe
+ * @param batch number of packets
+ * @return an error code
+ */
+static inline int upipe_msrc_set_batch(struct upipe *upipe,
+                                       unsigned int batch)
+{
+    return upipe_control(upipe, UPIPE_MSRC_SET_BATCH, UPIPE_MSRC_SIGNATURE,
+                         batch);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -30,6 +30,18 @@ enum upipe_udpsrc_command {
     UPIPE_UDPSRC_GET_FD,
     /** set socket fd (int) */
     UPIPE_UDPSRC_SET_FD,
+    /** get slab size (unsigned int *) */
+    UPIPE_UDPSRC_GET_SLAB_SIZE,
+    /** set slab size (unsigned int) */
+    UPIPE_UDPSRC_SET_SLAB_SIZE,
+    /** get exact sizing mode (bool *) */
+    UPIPE_UDPSRC_GET_EXACT_SIZE,
+    /** set exact sizing mode (bool) */
+    UPIPE_UDPSRC_SET_EXACT_SIZE,
+    /** get coalesced reception mode (bool *) */
+    UPIPE_UDPSRC_GET_GRO,
+    /** set coalesced reception mode (bool) */
+    UPIPE_UDPSRC_SET_GRO,
 };
 
 /** @This extends uprobe_throw with specific events. */
@@ -64,6 +76,89 @@ static inline int upipe_udpsrc_set_fd(struct upipe *upipe, int fd)
                          fd);
 }
 
+/** @This returns the size of the slabs datagrams are received into.
+ *
+ * @param upipe description structure of the pipe
+ * @param slab_size_p filled in with the slab size, or 0
+ * @return an error code
+ */
+static inline int upipe_udpsrc_get_slab_size(struct upipe *upipe,
+                                             unsigned int *slab_size_p)
+{
+    return upipe_control(upipe, UPIPE_UDPSRC_GET_SLAB_SIZE,
+                         UPIPE_UDPSRC_SIGNATURE, slab_size_p);
+}
+
+/** @This sets the size of the slabs datagrams are received into. When
+ * non-zero, successive datagrams are packed into a large buffer and output
+ * as ubufs sharing its memory, which is released when all of them are.
+ *
+ * @param upipe description structure of the pipe
+ * @param slab_size slab size, or 0 to allocate a buffer per datagram
+ * @return an error code
+ */
+static inline int upipe_udpsrc_set_slab_size(struct upipe *upipe,
+                                             unsigned int slab_size)
+{
+    return upipe_control(upipe, UPIPE_UDPSRC_SET_SLAB_SIZE,
+                         UPIPE_UDPSRC_SIGNATURE, slab_size);
+}
+
+/** @This returns whether buffers are allocated with the exact datagram size.
+ *
+ * @param upipe description structure of the pipe
+ * @param exact_p filled in with true if exact sizing is enabled
+ * @return an error code
+ */
+static inline int upipe_udpsrc_get_exact_size(struct upipe *upipe,
+                                              bool *exact_p)
+{
+    return upipe_control(upipe, UPIPE_UDPSRC_GET_EXACT_SIZE,
+                         UPIPE_UDPSRC_SIGNATURE, exact_p);
+}
+
+/** @This sets whether buffers are allocated with the exact datagram size,
+ * which is peeked before reception, instead of the output size. Small
+ * datagrams then use small pool classes.
+ *
+ * @param upipe description structure of the pipe
+ * @param exact true to enable exact sizing
+ * @return an error code
+ */
+static inline int upipe_udpsrc_set_exact_size(struct upipe *upipe, bool exact)
+{
+    return upipe_control(upipe, UPIPE_UDPSRC_SET_EXACT_SIZE,
+                         UPIPE_UDPSRC_SIGNATURE, exact ? 1 : 0);
+}
+
+/** @This returns whether coalesced datagrams are received.
+ *
+ * @param upipe description structure of the pipe
+ * @param gro_p filled in with true if UDP_GRO is enabled
+ * @return an error code
+ */
+static inline int upipe_udpsrc_get_gro(struct upipe *upipe, bool *gro_p)
+{
+    return upipe_control(upipe, UPIPE_UDPSRC_GET_GRO,
+                         UPIPE_UDPSRC_SIGNATURE, gro_p);
+}
+
+/** @This sets whether coalesced datagrams are received (UDP_GRO). The
+ * kernel then delivers several datagrams of the same flow in a single
+ * buffer, which is split into block ubufs sharing its memory. Coalesced
+ * buffers are received into slabs (see @ref upipe_udpsrc_set_slab_size),
+ * of four times the maximum coalesced size unless a slab size is set.
+ *
+ * @param upipe description structure of the pipe
+ * @param gro true to enable UDP_GRO
+ * @return an error code
+ */
+static inline int upipe_udpsrc_set_gro(struct upipe *upipe, bool gro)
+{
+    return upipe_control(upipe, UPIPE_UDPSRC_SET_GRO,
+                         UPIPE_UDPSRC_SIGNATURE, gro ? 1 : 0);
+}
+
 /** @This returns the management structure for all udp socket sources.
  *
  * @return pointer to manager
@@ -21,6 +21,48 @@ extern "C" {
 #include "upipe/upipe.h"
 
 #define UPIPE_NETMAP_SOURCE_SIGNATURE UBASE_FOURCC('n','t','m','s')
+
+/** @This extends upipe_command with specific commands. */
+enum upipe_netmap_source_command {
+    UPIPE_NETMAP_SOURCE_SENTINEL = UPIPE_CONTROL_LOCAL,
+
+    /** get the number of spare buffers for zero-copy (unsigned int *) */
+    UPIPE_NETMAP_SOURCE_GET_ZEROCOPY,
+    /** set the number of spare buffers for zero-copy (unsigned int) */
+    UPIPE_NETMAP_SOURCE_SET_ZEROCOPY,
+};
+
+/** @This returns the number of spare buffers requested for zero-copy
+ * reception.
+ *
+ * @param upipe description structure of the pipe
+ * @param nb_buffers_p filled in with the number of spare buffers
+ * @return an error code
+ */
+static inline int upipe_netmap_source_get_zerocopy(struct upipe *upipe,
+                                                   unsigned int *nb_buffers_p)
+{
+    return upipe_control(upipe, UPIPE_NETMAP_SOURCE_GET_ZEROCOPY,
+                         UPIPE_NETMAP_SOURCE_SIGNATURE, nb_buffers_p);
+}
+
+/** @This sets the number of spare buffers requested for zero-copy reception.
+ * When non-zero, received slots are swapped with spare netmap buffers and
+ * output without copy; the number of spare buffers bounds the number of
+ * buffers held downstream, and payloads are copied when none is left.
+ * It takes effect on the next call to @ref upipe_set_uri.
+ *
+ * @param upipe description structure of the pipe
+ * @param nb_buffers number of spare buffers, or 0 to disable zero-copy
+ * @return an error code
+ */
+static inline int upipe_netmap_source_set_zerocopy(struct upipe *upipe,
+                                                   unsigned int nb_buffers)
+{
+    return upipe_control(upipe, UPIPE_NETMAP_SOURCE_SET_ZEROCOPY,
+                         UPIPE_NETMAP_SOURCE_SIGNATURE, nb_buffers);
+}
+
 /** @This returns the management structure for netmap_source pipes.
  *
  * @return pointer to manager
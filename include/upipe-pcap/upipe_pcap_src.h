@@ -17,8 +17,66 @@
 extern "C" {
 #endif
 
+#include "upipe/upipe.h"
+
 #define UPIPE_PCAP_SRC_SIGNATURE UBASE_FOURCC('p','c','a','p')
 
+/** @This extends upipe_command with specific commands. */
+enum upipe_pcap_src_command {
+    UPIPE_PCAP_SRC_SENTINEL = UPIPE_CONTROL_LOCAL,
+
+    /** set the maximum number of packets output per callback
+     * (unsigned int) */
+    UPIPE_PCAP_SRC_SET_BATCH,
+    /** set the replay speed (struct urational) */
+    UPIPE_PCAP_SRC_SET_SPEED,
+    /** set the UDP destination filter (const char *) */
+    UPIPE_PCAP_SRC_SET_FILTER,
+};
+
+/** @This sets the maximum number of packets output per pump callback.
+ *
+ * @param upipe description structure of the pipe
+ * @param batch maximum number of packets (default 1)
+ * @return an error code
+ */
+static inline int upipe_pcap_src_set_batch(struct upipe *upipe,
+                                           unsigned int batch)
+{
+    return upipe_control(upipe, UPIPE_PCAP_SRC_SET_BATCH,
+                         UPIPE_PCAP_SRC_SIGNATURE, batch);
+}
+
+/** @This sets the replay speed. cr_sys dates are computed from the capture
+ * timestamps divided by the speed, and packets are paced accordingly if a
+ * uclock is attached. A speed of 0 outputs packets as fast as possible,
+ * with cr_sys dates following the capture timestamps.
+ *
+ * @param upipe description structure of the pipe
+ * @param speed replay speed (default 1/1)
+ * @return an error code
+ */
+static inline int upipe_pcap_src_set_speed(struct upipe *upipe,
+                                           struct urational speed)
+{
+    return upipe_control(upipe, UPIPE_PCAP_SRC_SET_SPEED,
+                         UPIPE_PCAP_SRC_SIGNATURE, speed);
+}
+
+/** @This only outputs UDP datagrams sent to the given destination.
+ *
+ * @param upipe description structure of the pipe
+ * @param filter destination of the form [addr][:port], or NULL to output
+ * all datagrams
+ * @return an error code
+ */
+static inline int upipe_pcap_src_set_filter(struct upipe *upipe,
+                                            const char *filter)
+{
+    return upipe_control(upipe, UPIPE_PCAP_SRC_SET_FILTER,
+                         UPIPE_PCAP_SRC_SIGNATURE, filter);
+}
+
 /** @This returns the management structure for all pcap sources.
  *
  * @return pointer to manager
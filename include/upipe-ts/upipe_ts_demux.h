@@ -50,6 +50,18 @@ enum upipe_ts_demux_command {
     UPIPE_TS_DEMUX_SET_MAX_PCR_INTERVAL,
     /** gets the configured maximum interval between PCRs (uint64_t *) */
     UPIPE_TS_DEMUX_GET_MAX_PCR_INTERVAL,
+    /** sets the maximum number of TS packets per uref (unsigned int) */
+    UPIPE_TS_DEMUX_SET_BATCH,
+    /** gets the maximum number of TS packets per uref (unsigned int *) */
+    UPIPE_TS_DEMUX_GET_BATCH,
+    /** adds a worker thread framing programs
+     * (struct upipe_mgr *, struct uprobe *) */
+    UPIPE_TS_DEMUX_ADD_WORKER,
+    /** enables or disables the section cache on SI PIDs (int) */
+    UPIPE_TS_DEMUX_SET_PSI_CACHE,
+    /** returns the number of sections dropped by the section cache
+     * (uint64_t *) */
+    UPIPE_TS_DEMUX_GET_PSI_CACHE_HITS,
 };
 
 /** @This returns the currently detected conformance mode. It cannot return
@@ -147,6 +159,91 @@ static inline int upipe_ts_demux_get_max_pcr_interval(struct upipe *upipe,
                          UPIPE_TS_DEMUX_SIGNATURE, max);
 }
 
+/** @This sets the maximum number of TS packets carried by a single uref in
+ * the front end of the demux (sync, split and decaps), which then process
+ * vectors of packets instead of one uref per packet. Per-packet urefs are
+ * still created for PSI and PCR-only PIDs. It must be called before setting
+ * the flow definition.
+ *
+ * @param upipe description structure of the pipe
+ * @param batch maximum number of packets, 1 to disable batch mode
+ * @return an error code
+ */
+static inline int upipe_ts_demux_set_batch(struct upipe *upipe,
+                                           unsigned int batch)
+{
+    return upipe_control(upipe, UPIPE_TS_DEMUX_SET_BATCH,
+                         UPIPE_TS_DEMUX_SIGNATURE, batch);
+}
+
+/** @This gets the maximum number of TS packets carried by a single uref in
+ * the front end of the demux.
+ *
+ * @param upipe description structure of the pipe
+ * @param batch_p filled with the maximum number of packets
+ * @return an error code
+ */
+static inline int upipe_ts_demux_get_batch(struct upipe *upipe,
+                                           unsigned int *batch_p)
+{
+    return upipe_control(upipe, UPIPE_TS_DEMUX_GET_BATCH,
+                         UPIPE_TS_DEMUX_SIGNATURE, batch_p);
+}
+
+/** @This adds a worker thread to the demux. Each new program is assigned
+ * to one of the worker threads in turn, and the framers of its elementary
+ * streams run on that thread, behind a queue. Synchronization, PID
+ * filtering, PSI tables, PES headers and PCRs are still handled on the
+ * thread of the demux, so that clock_ref and clock_ts events are thrown
+ * in the order of the multiplex, and the framed outputs come back to it.
+ *
+ * Only programs allocated afterwards are affected.
+ *
+ * @param upipe description structure of the pipe
+ * @param wlin_mgr manager of linear worker pipes running on the thread
+ * (see @ref upipe_wlin_mgr_alloc)
+ * @param uprobe probe hierarchy to use for the framers on the thread
+ * @return an error code
+ */
+static inline int upipe_ts_demux_add_worker(struct upipe *upipe,
+                                            struct upipe_mgr *wlin_mgr,
+                                            struct uprobe *uprobe)
+{
+    return upipe_control(upipe, UPIPE_TS_DEMUX_ADD_WORKER,
+                         UPIPE_TS_DEMUX_SIGNATURE, wlin_mgr, uprobe);
+}
+
+/** @This enables or disables the section cache on the NIT, SDT and EIT
+ * PIDs, which drops repeated sections before they reach the decoders (see
+ * @ref upipe_ts_psi_split_set_cache). It is enabled by default; monitoring
+ * applications which need to see every repetition should disable it.
+ *
+ * @param upipe description structure of the pipe
+ * @param enabled true to drop repeated sections, false otherwise
+ * @return an error code
+ */
+static inline int upipe_ts_demux_set_psi_cache(struct upipe *upipe,
+                                               bool enabled)
+{
+    return upipe_control(upipe, UPIPE_TS_DEMUX_SET_PSI_CACHE,
+                         UPIPE_TS_DEMUX_SIGNATURE, enabled ? 1 : 0);
+}
+
+/** @This returns the number of repeated sections dropped by the section
+ * cache on the SI PIDs currently in use (see
+ * @ref upipe_ts_psi_split_get_cache_hits).
+ *
+ * @param upipe description structure of the pipe
+ * @param hits_p filled in with the number of cache hits
+ * @return an error code
+ */
+static inline int upipe_ts_demux_get_psi_cache_hits(struct upipe *upipe,
+                                                    uint64_t *hits_p)
+{
+    return upipe_control(upipe, UPIPE_TS_DEMUX_GET_PSI_CACHE_HITS,
+                         UPIPE_TS_DEMUX_SIGNATURE, hits_p);
+}
+
 /** @This returns the management structure for all ts_demux pipes.
  *
  * @return pointer to manager
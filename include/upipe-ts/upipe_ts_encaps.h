@@ -40,7 +40,10 @@ enum upipe_ts_encaps_command {
      * uint64_t, struct ubuf **, uint64_t *) */
     UPIPE_TS_ENCAPS_SPLICE,
     /** signals an end of stream (void) */
-    UPIPE_TS_ENCAPS_EOS
+    UPIPE_TS_ENCAPS_EOS,
+    /** writes a TS packet to a buffer and returns its dts_sys (uint64_t,
+     * uint64_t, uint8_t *, uint64_t *) */
+    UPIPE_TS_ENCAPS_SPLICE_BUFFER
 };
 
 /** @This sets the size of the TB buffer.
@@ -74,6 +77,26 @@ static inline int upipe_ts_encaps_splice(struct upipe *upipe,
                                cr_sys_min, cr_sys_max, ubuf_p, dts_sys_p);
 }
 
+/** @This writes a TS packet to the given buffer, and returns the dts_sys
+ * of the packet. Contrary to @ref upipe_ts_encaps_splice, the payload is
+ * copied once and no ubuf is allocated.
+ *
+ * @param upipe description structure of the pipe
+ * @param cr_sys_min date at which the packet will be muxed
+ * @param cr_sys_max maximum date allowed for muxing
+ * @param buffer buffer of TS_SIZE octets to write the packet to
+ * @param dts_sys_p filled in with the dts_sys, or UINT64_MAX
+ * @return an error code
+ */
+static inline int upipe_ts_encaps_splice_buffer(struct upipe *upipe,
+        uint64_t cr_sys_min, uint64_t cr_sys_max,
+        uint8_t *buffer, uint64_t *dts_sys_p)
+{
+    return upipe_control_nodbg(upipe, UPIPE_TS_ENCAPS_SPLICE_BUFFER,
+                               UPIPE_TS_ENCAPS_SIGNATURE,
+                               cr_sys_min, cr_sys_max, buffer, dts_sys_p);
+}
+
 /** @This signals an end of stream, so that buffered packets can be released.
  *
  * @param upipe description structure of the pipe
@@ -9,6 +9,12 @@
 
 /** @file
  * @short Upipe higher-level module muxing elementary streams in a TS
+ *
+ * An input with a "block.mpegts." flow definition passes through already
+ * packetized TS packets. The PCR of a program made of such inputs is the
+ * one carried by the input flagged with @ref uref_ts_flow_set_passthrough_pcr.
+ * Passed-through and encapsulated inputs cannot be mixed in a program, as
+ * their timestamps are not in the same time base.
  */
 
 #ifndef _UPIPE_TS_UPIPE_TS_MUX_H_
@@ -163,6 +169,14 @@ enum upipe_ts_mux_command {
     UPIPE_TS_MUX_GET_PES_MIN_DURATION,
     /** forces PES alignment (int) */
     UPIPE_TS_MUX_FORCE_PES_ALIGNMENT,
+    /** sets contiguous output buffers (int) */
+    UPIPE_TS_MUX_SET_CONTIGUOUS,
+    /** returns contiguous output buffers (int *) */
+    UPIPE_TS_MUX_GET_CONTIGUOUS,
+    /** sets PCR restamping of passed-through TS packets (int) */
+    UPIPE_TS_MUX_SET_PCR_RESTAMP,
+    /** returns PCR restamping of passed-through TS packets (int *) */
+    UPIPE_TS_MUX_GET_PCR_RESTAMP,
 
     /** ts_encaps commands begin here */
     UPIPE_TS_MUX_ENCAPS = UPIPE_CONTROL_LOCAL + 0x1000,
@@ -784,6 +798,73 @@ static inline int upipe_ts_mux_force_pes_alignment(struct upipe *upipe,
                          UPIPE_TS_MUX_SIGNATURE, force ? 1 : 0);
 }
 
+/** @This sets whether TS packets are written to a single contiguous buffer
+ * per output uref, instead of a chain of one segment per TS packet. This
+ * trades a copy of each packet for output buffers that may be sent without
+ * gathering.
+ *
+ * @param upipe description structure of the pipe
+ * @param contiguous true for contiguous output buffers
+ * @return an error code
+ */
+static inline int upipe_ts_mux_set_contiguous(struct upipe *upipe,
+                                              bool contiguous)
+{
+    return upipe_control(upipe, UPIPE_TS_MUX_SET_CONTIGUOUS,
+                         UPIPE_TS_MUX_SIGNATURE, contiguous ? 1 : 0);
+}
+
+/** @This returns whether TS packets are written to a single contiguous buffer
+ * per output uref.
+ *
+ * @param upipe description structure of the pipe
+ * @param contiguous_p filled in with true for contiguous output buffers
+ * @return an error code
+ */
+static inline int upipe_ts_mux_get_contiguous(struct upipe *upipe,
+                                              bool *contiguous_p)
+{
+    int contiguous;
+    int err = upipe_control(upipe, UPIPE_TS_MUX_GET_CONTIGUOUS,
+                            UPIPE_TS_MUX_SIGNATURE, &contiguous);
+    if (ubase_check(err) && contiguous_p != NULL)
+        *contiguous_p = !!contiguous;
+    return err;
+}
+
+/** @This sets whether the PCRs carried by TS packets passed through
+ * ("block.mpegts." inputs) are restamped to compensate for the muxing
+ * jitter. Other fields of these packets, including PTS and DTS, are kept.
+ *
+ * @param upipe description structure of the pipe
+ * @param restamp true to restamp PCRs
+ * @return an error code
+ */
+static inline int upipe_ts_mux_set_pcr_restamp(struct upipe *upipe,
+                                               bool restamp)
+{
+    return upipe_control(upipe, UPIPE_TS_MUX_SET_PCR_RESTAMP,
+                         UPIPE_TS_MUX_SIGNATURE, restamp ? 1 : 0);
+}
+
+/** @This returns whether the PCRs carried by TS packets passed through are
+ * restamped.
+ *
+ * @param upipe description structure of the pipe
+ * @param restamp_p filled in with true if PCRs are restamped
+ * @return an error code
+ */
+static inline int upipe_ts_mux_get_pcr_restamp(struct upipe *upipe,
+                                               bool *restamp_p)
+{
+    int restamp;
+    int err = upipe_control(upipe, UPIPE_TS_MUX_GET_PCR_RESTAMP,
+                            UPIPE_TS_MUX_SIGNATURE, &restamp);
+    if (ubase_check(err) && restamp_p != NULL)
+        *restamp_p = !!restamp;
+    return err;
+}
+
 /** @This stops updating a PSI table upon sub removal.
  *
  * @param upipe description structure of the pipe
@@ -22,6 +22,52 @@ extern "C" {
 #define UPIPE_TS_PSI_SPLIT_SIGNATURE UBASE_FOURCC('t','s','p','Y')
 #define UPIPE_TS_PSI_SPLIT_OUTPUT_SIGNATURE UBASE_FOURCC('t','s','p','Z')
 
+/** @This extends upipe_command with specific commands for ts_psi_split
+ * pipes. */
+enum upipe_ts_psi_split_command {
+    UPIPE_TS_PSI_SPLIT_SENTINEL = UPIPE_CONTROL_LOCAL,
+
+    /** enables or disables the section cache (int) */
+    UPIPE_TS_PSI_SPLIT_SET_CACHE,
+    /** returns the number of sections dropped by the cache (uint64_t *) */
+    UPIPE_TS_PSI_SPLIT_GET_CACHE_HITS,
+};
+
+/** @This enables or disables the section cache. When enabled, a section
+ * with the same version and CRC as the last one received with its table ID,
+ * table ID extension and section number is dropped before it reaches the
+ * outputs, so that decoders only see new sections. The cache grows with the
+ * number of distinct sections on the PID, and adding an output clears it.
+ * Only sections with the long syntax and a correct CRC are cached, so that a
+ * corrupted section never masks the following repetitions. The cache is
+ * disabled by default; it must stay disabled when outputs rely on
+ * repetitions, such as the PAT and PMT decoders for random access points, or
+ * for monitoring.
+ *
+ * @param upipe description structure of the pipe
+ * @param enabled true to enable the cache
+ * @return an error code
+ */
+static inline int upipe_ts_psi_split_set_cache(struct upipe *upipe,
+                                               bool enabled)
+{
+    return upipe_control(upipe, UPIPE_TS_PSI_SPLIT_SET_CACHE,
+                         UPIPE_TS_PSI_SPLIT_SIGNATURE, enabled ? 1 : 0);
+}
+
+/** @This returns the number of repeated sections dropped by the cache.
+ *
+ * @param upipe description structure of the pipe
+ * @param hits_p filled in with the number of cache hits
+ * @return an error code
+ */
+static inline int upipe_ts_psi_split_get_cache_hits(struct upipe *upipe,
+                                                    uint64_t *hits_p)
+{
+    return upipe_control(upipe, UPIPE_TS_PSI_SPLIT_GET_CACHE_HITS,
+                         UPIPE_TS_PSI_SPLIT_SIGNATURE, hits_p);
+}
+
 /** @This returns the management structure for all ts_psi_split pipes.
  *
  * @return pointer to manager
@@ -37,7 +37,12 @@ enum upipe_ts_sync_command {
     /** returns the configured number of packets to synchronize with (int *) */
     UPIPE_TS_SYNC_GET_SYNC,
     /** sets the configured number of packets to synchronize with (int) */
-    UPIPE_TS_SYNC_SET_SYNC
+    UPIPE_TS_SYNC_SET_SYNC,
+    /** returns the maximum number of packets per output buffer
+     * (unsigned int *) */
+    UPIPE_TS_SYNC_GET_BATCH,
+    /** sets the maximum number of packets per output buffer (unsigned int) */
+    UPIPE_TS_SYNC_SET_BATCH
 };
 
 /** @This returns the management structure for all ts_sync pipes.
@@ -72,6 +77,35 @@ static inline int upipe_ts_sync_set_sync(struct upipe *upipe, int sync)
                          sync);
 }
 
+/** @This returns the maximum number of packets per output buffer.
+ *
+ * @param upipe description structure of the pipe
+ * @param batch_p filled in with number of packets
+ * @return an error code
+ */
+static inline int upipe_ts_sync_get_batch(struct upipe *upipe,
+                                          unsigned int *batch_p)
+{
+    return upipe_control(upipe, UPIPE_TS_SYNC_GET_BATCH,
+                         UPIPE_TS_SYNC_SIGNATURE, batch_p);
+}
+
+/** @This sets the maximum number of packets per output buffer. With a value
+ * greater than 1 (and standard 188-octet packets), the pipe outputs vectors
+ * of contiguous TS packets with the flow definition "block.mpegtsaligned.",
+ * instead of one uref per packet. The default is 1.
+ *
+ * @param upipe description structure of the pipe
+ * @param batch number of packets
+ * @return an error code
+ */
+static inline int upipe_ts_sync_set_batch(struct upipe *upipe,
+                                          unsigned int batch)
+{
+    return upipe_control(upipe, UPIPE_TS_SYNC_SET_BATCH,
+                         UPIPE_TS_SYNC_SIGNATURE, batch);
+}
+
 #ifdef __cplusplus
 }
 #endif
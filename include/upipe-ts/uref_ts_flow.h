@@ -39,6 +39,10 @@ UREF_ATTR_SMALL_UNSIGNED(ts_flow, pes_header, "t.pes_header",
         minimum PES header size)
 UREF_ATTR_UNSIGNED(ts_flow, pes_min_duration, "t.pes_mindur",
         minimum PES duration)
+UREF_ATTR_VOID(ts_flow, passthrough, "t.passthrough",
+        TS packets passed through without encapsulation)
+UREF_ATTR_VOID(ts_flow, passthrough_pcr, "t.passthrough_pcr",
+        passed-through TS packets carrying the PCR of the program)
 
 /* PMT */
 UREF_ATTR_SMALL_UNSIGNED(ts_flow, component_type, "t.ctype", component type)
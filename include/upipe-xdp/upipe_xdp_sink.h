@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short Upipe sink module for AF_XDP sockets
+ *
+ * The URI is of the form
+ * ifname[-queue]@dstaddr:port[/src=addr:port][/dmac=xx:xx:xx:xx:xx:xx]
+ * [/ttl=N][/generic]. Incoming blocks are sent as the payload of UDP/IPv4
+ * datagrams. The destination MAC address is derived from multicast
+ * destination addresses, and must be given for unicast destinations.
+ */
+
+#ifndef _UPIPE_XDP_UPIPE_XDP_SINK_H_
+/** @hidden */
+#define _UPIPE_XDP_UPIPE_XDP_SINK_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "upipe/upipe.h"
+
+#define UPIPE_XDP_SINK_SIGNATURE UBASE_FOURCC('x','d','p','k')
+
+/** @This returns the management structure for xdp sink pipes.
+ *
+ * @return pointer to manager
+ */
+struct upipe_mgr *upipe_xdp_sink_mgr_alloc(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
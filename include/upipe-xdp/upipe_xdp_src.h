@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short Upipe source module for AF_XDP sockets
+ *
+ * The URI is of the form ifname[-queue][/generic]. Received UDP payloads are
+ * output without copy, as block ubufs pointing to the UMEM frames, which are
+ * given back to the kernel once the ubufs are released. When too few frames
+ * are left for the kernel, payloads are copied to buffers allocated from the
+ * requested ubuf manager instead.
+ */
+
+#ifndef _UPIPE_XDP_UPIPE_XDP_SRC_H_
+/** @hidden */
+#define _UPIPE_XDP_UPIPE_XDP_SRC_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "upipe/upipe.h"
+
+#define UPIPE_XDP_SRC_SIGNATURE UBASE_FOURCC('x','d','p','s')
+
+/** @This returns the management structure for xdp source pipes.
+ *
+ * @return pointer to manager
+ */
+struct upipe_mgr *upipe_xdp_src_mgr_alloc(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -20,16 +20,16 @@ extern "C" {
 #include "upipe/ubase.h"
 #include "upipe/ubuf.h"
 #include "upipe/ubuf_block.h"
+#include "upipe/umem.h"
 
 #include <stdint.h>
 
-/** @hidden */
-struct umem_mgr;
-
 /** @This is the signature to use to allocate from an ubuf_pic plane. */
 #define UBUF_BLOCK_MEM_ALLOC_FROM_PIC UBASE_FOURCC('m','e','m','p')
 /** @This is the signature to use to allocate from an ubuf_sound plane. */
 #define UBUF_BLOCK_MEM_ALLOC_FROM_SOUND UBASE_FOURCC('m','e','m','s')
+/** @This is the signature to use to allocate from an existing umem. */
+#define UBUF_BLOCK_MEM_ALLOC_FROM_UMEM UBASE_FOURCC('m','e','m','u')
 
 /** @This returns a new ubuf from the block mem allocator, using a chroma of
  * a ubuf pic mem.
@@ -59,6 +59,25 @@ static inline struct ubuf *ubuf_block_mem_alloc_from_sound(struct ubuf_mgr *mgr,
     return ubuf_alloc(mgr, UBUF_BLOCK_MEM_ALLOC_FROM_SOUND, ubuf_sound, channel);
 }
 
+/** @This returns a new ubuf from the block mem allocator, wrapping a umem
+ * previously allocated by any umem manager. On success the ubuf takes
+ * ownership of the umem, which is released with @ref umem_free when the last
+ * reference to the buffer goes away. This allows external memory (such as
+ * kernel-shared packet buffers) to travel through a pipeline without copy.
+ *
+ * @param mgr management structure for this ubuf type
+ * @param umem umem to wrap (its content is copied and must not be freed by
+ * the caller on success)
+ * @param offset offset of the block in the umem buffer
+ * @param size size of the block
+ * @return pointer to ubuf or NULL in case of failure
+ */
+static inline struct ubuf *ubuf_block_mem_alloc_from_umem(struct ubuf_mgr *mgr,
+        struct umem *umem, int offset, int size)
+{
+    return ubuf_alloc(mgr, UBUF_BLOCK_MEM_ALLOC_FROM_UMEM, umem, offset, size);
+}
+
 /** @This allocates a new instance of the ubuf manager for block formats
  * using umem.
  *
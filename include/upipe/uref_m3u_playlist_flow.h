@@ -26,6 +26,8 @@ UREF_ATTR_UNSIGNED(m3u_playlist_flow, discontinuity_sequence,
                    discontinuity sequence)
 UREF_ATTR_VOID(m3u_playlist_flow, endlist, "m3u.playlist.endlist",
                endlist)
+UREF_ATTR_UNSIGNED(m3u_playlist_flow, kept, "m3u.playlist.kept",
+                   number of unchanged segments not output again)
 
 static inline int uref_m3u_playlist_flow_delete(struct uref *uref)
 {
@@ -35,6 +37,7 @@ static inline int uref_m3u_playlist_flow_delete(struct uref *uref)
         uref_m3u_playlist_flow_delete_media_sequence,
         uref_m3u_playlist_flow_delete_discontinuity_sequence,
         uref_m3u_playlist_flow_delete_endlist,
+        uref_m3u_playlist_flow_delete_kept,
     };
 
     return uref_attr_delete_list(uref, list, UBASE_ARRAY_SIZE(list));
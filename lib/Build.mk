@@ -28,6 +28,7 @@ subdirs = \
     upipe-v210 \
     upipe-x264 \
     upipe-x265 \
+    upipe-xdp \
     upipe-zvbi \
     upump-ecore \
     upump-ev \
@@ -15,7 +15,11 @@ libupipe_av-includes = \
 libupipe_av-src = \
     ubuf_av.c \
     upipe_av.c \
+    upipe_av_avio.c \
+    upipe_av_avio.h \
     upipe_av_codecs.c \
+    upipe_av_demux.c \
+    upipe_av_demux.h \
     upipe_av_internal.h \
     upipe_avformat_sink.c \
     upipe_avformat_source.c
@@ -35,4 +39,4 @@ libupipe_av-src += \
     $(if $(have_upipe_avfilt),upipe_avfilter.c)
 
 libupipe_av-libs = libupipe libupipe_modules libavformat libavcodec libavutil
-libupipe_av-opt-libs = bitstream libavfilter
+libupipe_av-opt-libs = bitstream libavfilter pthread
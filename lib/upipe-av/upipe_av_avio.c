@@ -0,0 +1,540 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short threaded avio output contexts
+ */
+
+#include "upipe/config.h"
+
+#ifdef UPIPE_HAVE_PTHREAD
+
+#include "upipe/ubase.h"
+#include "upipe/ulist.h"
+#include "upipe/ueventfd.h"
+
+#include "upipe_av_avio.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <libavutil/mem.h>
+#include <libavutil/error.h>
+#include <libavformat/avformat.h>
+
+/** size of the buffer of the custom AVIOContext */
+#define AVIO_BUFFER_SIZE 32768
+
+/** @internal @This enumerates the operations queued to the I/O thread. */
+enum upipe_av_avio_op {
+    /** opens a URL */
+    UPIPE_AV_AVIO_OPEN,
+    /** writes data */
+    UPIPE_AV_AVIO_WRITE,
+    /** seeks to an absolute position */
+    UPIPE_AV_AVIO_SEEK,
+    /** closes the URL */
+    UPIPE_AV_AVIO_CLOSE
+};
+
+/** @internal @This is an operation queued to the I/O thread. */
+struct upipe_av_avio_chunk {
+    /** structure for double-linked lists */
+    struct uchain uchain;
+    /** operation */
+    enum upipe_av_avio_op op;
+    /** avformat options of an open operation */
+    AVDictionary *options;
+    /** position of a seek operation */
+    int64_t offset;
+    /** size of the data of a write operation */
+    size_t size;
+    /** data to write, or URL to open */
+    uint8_t data[];
+};
+
+UBASE_FROM_TO(upipe_av_avio_chunk, uchain, uchain, uchain)
+
+/** @internal @This is the context shared between the event loop and the
+ * I/O thread. */
+struct upipe_av_avio {
+    /** I/O thread */
+    pthread_t thread;
+    /** protects the fields below */
+    pthread_mutex_t mutex;
+    /** signals new operations to the I/O thread */
+    pthread_cond_t cond;
+
+    /** operations waiting for the I/O thread */
+    struct uchain pending;
+    /** octets waiting to be written */
+    uint64_t queued;
+    /** number of queued open operations */
+    unsigned int opening;
+    /** first error since the last open, or 0 */
+    int error;
+    /** seekable flags of the last opened URL */
+    int seekable;
+    /** true if the event loop waits for the queue to drain */
+    bool blocked;
+    /** true if the thread must exit after processing pending operations */
+    bool stop;
+
+    /** size of the write-behind buffer */
+    uint64_t size;
+    /** custom context given to libavformat, owned by the event loop */
+    AVIOContext *outer;
+    /** current position in the URL, as seen by the event loop */
+    int64_t position;
+    /** size of the URL, as seen by the event loop */
+    int64_t end;
+
+    /** wakes up the event loop */
+    struct ueventfd event;
+};
+
+/** @internal @This records the first error since the last open. It must be
+ * called with the mutex held.
+ *
+ * @param avio threaded avio context
+ * @param error libavformat error code
+ * @return true if the error is the first one
+ */
+static bool upipe_av_avio_set_error(struct upipe_av_avio *avio, int error)
+{
+    if (error >= 0 || avio->error < 0)
+        return false;
+    avio->error = error;
+    return true;
+}
+
+/** @internal @This is the main loop of the I/O thread.
+ *
+ * @param opaque threaded avio context
+ * @return NULL
+ */
+static void *upipe_av_avio_run(void *opaque)
+{
+    struct upipe_av_avio *avio = opaque;
+    AVIOContext *inner = NULL;
+    bool written = false;
+
+    pthread_mutex_lock(&avio->mutex);
+    for ( ; ; ) {
+        struct uchain *uchain = ulist_pop(&avio->pending);
+        if (uchain == NULL) {
+            if (written) {
+                /* the queue is empty, hand the data over to the OS */
+                written = false;
+                pthread_mutex_unlock(&avio->mutex);
+                avio_flush(inner);
+                pthread_mutex_lock(&avio->mutex);
+                upipe_av_avio_set_error(avio, inner->error);
+                continue;
+            }
+            if (avio->stop)
+                break;
+            pthread_cond_wait(&avio->cond, &avio->mutex);
+            continue;
+        }
+        struct upipe_av_avio_chunk *chunk =
+            upipe_av_avio_chunk_from_uchain(uchain);
+        bool failed = avio->error < 0;
+        pthread_mutex_unlock(&avio->mutex);
+
+        int error = 0;
+        int seekable = 0;
+        switch (chunk->op) {
+            case UPIPE_AV_AVIO_OPEN:
+                if (unlikely(inner != NULL))
+                    /* the close operation couldn't be allocated */
+                    avio_closep(&inner);
+                written = false;
+                error = avio_open2(&inner, (const char *)chunk->data,
+                                   AVIO_FLAG_WRITE, NULL, &chunk->options);
+                if (error >= 0)
+                    seekable = inner->seekable;
+                else
+                    inner = NULL;
+                break;
+            case UPIPE_AV_AVIO_WRITE:
+                if (likely(inner != NULL && !failed)) {
+                    avio_write(inner, chunk->data, chunk->size);
+                    error = inner->error;
+                    written = true;
+                }
+                break;
+            case UPIPE_AV_AVIO_SEEK:
+                if (likely(inner != NULL && !failed)) {
+                    int64_t ret = avio_seek(inner, chunk->offset, SEEK_SET);
+                    if (ret < 0)
+                        error = ret;
+                }
+                break;
+            case UPIPE_AV_AVIO_CLOSE:
+                if (likely(inner != NULL))
+                    error = avio_closep(&inner);
+                written = false;
+                break;
+        }
+
+        pthread_mutex_lock(&avio->mutex);
+        bool notify = false;
+        if (chunk->op == UPIPE_AV_AVIO_OPEN) {
+            avio->opening--;
+            avio->error = error < 0 ? error : 0;
+            avio->seekable = seekable;
+            notify = true;
+        } else if (upipe_av_avio_set_error(avio, error))
+            notify = true;
+        avio->queued -= chunk->size;
+        if (avio->blocked && avio->queued <= avio->size / 2) {
+            avio->blocked = false;
+            notify = true;
+        }
+        pthread_mutex_unlock(&avio->mutex);
+
+        av_dict_free(&chunk->options);
+        free(chunk);
+        if (notify)
+            ueventfd_write(&avio->event);
+        pthread_mutex_lock(&avio->mutex);
+    }
+    pthread_mutex_unlock(&avio->mutex);
+
+    if (inner != NULL)
+        avio_closep(&inner);
+    return NULL;
+}
+
+/** @internal @This queues an operation to the I/O thread.
+ *
+ * @param avio threaded avio context
+ * @param chunk operation to queue
+ */
+static void upipe_av_avio_queue(struct upipe_av_avio *avio,
+                                struct upipe_av_avio_chunk *chunk)
+{
+    pthread_mutex_lock(&avio->mutex);
+    ulist_add(&avio->pending, upipe_av_avio_chunk_to_uchain(chunk));
+    avio->queued += chunk->size;
+    if (chunk->op == UPIPE_AV_AVIO_OPEN)
+        avio->opening++;
+    pthread_cond_signal(&avio->cond);
+    pthread_mutex_unlock(&avio->mutex);
+}
+
+/** @internal @This allocates an operation.
+ *
+ * @param op operation
+ * @param size size of the data
+ * @return pointer to the operation, or NULL in case of allocation error
+ */
+static struct upipe_av_avio_chunk *upipe_av_avio_chunk_alloc(
+        enum upipe_av_avio_op op, size_t size)
+{
+    struct upipe_av_avio_chunk *chunk = malloc(sizeof (*chunk) + size);
+    if (unlikely(chunk == NULL))
+        return NULL;
+    uchain_init(upipe_av_avio_chunk_to_uchain(chunk));
+    chunk->op = op;
+    chunk->options = NULL;
+    chunk->offset = 0;
+    chunk->size = 0;
+    return chunk;
+}
+
+/** @internal @This queues data to write, for libavformat. It never blocks,
+ * and reports errors of previous writes.
+ *
+ * @param opaque threaded avio context
+ * @param buf data to write
+ * @param buf_size size of buf
+ * @return number of octets written, or a libavformat error code
+ */
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(61, 1, 100)
+static int upipe_av_avio_write(void *opaque, const uint8_t *buf, int buf_size)
+#else
+static int upipe_av_avio_write(void *opaque, uint8_t *buf, int buf_size)
+#endif
+{
+    struct upipe_av_avio *avio = opaque;
+    if (unlikely(buf_size <= 0))
+        return 0;
+
+    pthread_mutex_lock(&avio->mutex);
+    int error = avio->error;
+    pthread_mutex_unlock(&avio->mutex);
+    if (unlikely(error < 0))
+        return error;
+
+    struct upipe_av_avio_chunk *chunk =
+        upipe_av_avio_chunk_alloc(UPIPE_AV_AVIO_WRITE, buf_size);
+    if (unlikely(chunk == NULL))
+        return AVERROR(ENOMEM);
+    chunk->size = buf_size;
+    memcpy(chunk->data, buf, buf_size);
+    upipe_av_avio_queue(avio, chunk);
+
+    avio->position += buf_size;
+    if (avio->position > avio->end)
+        avio->end = avio->position;
+    return buf_size;
+}
+
+/** @internal @This queues a seek, for libavformat. The new position is
+ * computed from the octets written so far, so that the event loop doesn't
+ * wait for the I/O thread.
+ *
+ * @param opaque threaded avio context
+ * @param offset offset to seek to
+ * @param whence SEEK_SET, SEEK_CUR, SEEK_END or AVSEEK_SIZE
+ * @return the new position, or a libavformat error code
+ */
+static int64_t upipe_av_avio_seek(void *opaque, int64_t offset, int whence)
+{
+    struct upipe_av_avio *avio = opaque;
+    int64_t position;
+
+    switch (whence & ~AVSEEK_FORCE) {
+        case AVSEEK_SIZE:
+            return avio->end;
+        case SEEK_SET:
+            position = offset;
+            break;
+        case SEEK_CUR:
+            position = avio->position + offset;
+            break;
+        case SEEK_END:
+            position = avio->end + offset;
+            break;
+        default:
+            return AVERROR(EINVAL);
+    }
+    if (unlikely(position < 0))
+        return AVERROR(EINVAL);
+
+    struct upipe_av_avio_chunk *chunk =
+        upipe_av_avio_chunk_alloc(UPIPE_AV_AVIO_SEEK, 0);
+    if (unlikely(chunk == NULL))
+        return AVERROR(ENOMEM);
+    chunk->offset = position;
+    upipe_av_avio_queue(avio, chunk);
+    avio->position = position;
+    return position;
+}
+
+/** @This allocates a threaded avio output context and starts its thread.
+ *
+ * @param size size of the write-behind buffer, in octets
+ * @return pointer to the threaded avio context, or NULL in case of error
+ */
+struct upipe_av_avio *upipe_av_avio_alloc(uint64_t size)
+{
+    if (unlikely(size < AVIO_BUFFER_SIZE))
+        return NULL;
+
+    struct upipe_av_avio *avio = malloc(sizeof (*avio));
+    if (unlikely(avio == NULL))
+        return NULL;
+    if (unlikely(!ueventfd_init(&avio->event, false))) {
+        free(avio);
+        return NULL;
+    }
+
+    ulist_init(&avio->pending);
+    avio->queued = 0;
+    avio->opening = 0;
+    avio->error = 0;
+    avio->seekable = 0;
+    avio->blocked = false;
+    avio->stop = false;
+    avio->size = size;
+    avio->outer = NULL;
+    avio->position = 0;
+    avio->end = 0;
+    pthread_mutex_init(&avio->mutex, NULL);
+    pthread_cond_init(&avio->cond, NULL);
+
+    if (unlikely(pthread_create(&avio->thread, NULL,
+                                upipe_av_avio_run, avio) != 0)) {
+        pthread_cond_destroy(&avio->cond);
+        pthread_mutex_destroy(&avio->mutex);
+        ueventfd_clean(&avio->event);
+        free(avio);
+        return NULL;
+    }
+    return avio;
+}
+
+/** @This allocates a watcher triggering when the I/O thread has opened a
+ * URL, when the write-behind buffer has drained after being full, or when
+ * an error occurs.
+ *
+ * @param avio threaded avio context
+ * @param upump_mgr management structure for this event loop
+ * @param cb function to call when the watcher triggers
+ * @param opaque pointer to the module's internal structure
+ * @param refcount pointer to urefcount structure to increment during callback,
+ * or NULL
+ * @return pointer to allocated watcher, or NULL in case of failure
+ */
+struct upump *upipe_av_avio_upump_alloc(struct upipe_av_avio *avio,
+                                        struct upump_mgr *upump_mgr,
+                                        upump_cb cb, void *opaque,
+                                        struct urefcount *refcount)
+{
+    return ueventfd_upump_alloc(&avio->event, upump_mgr, cb, opaque,
+                                refcount);
+}
+
+/** @This acknowledges a notification of the watcher.
+ *
+ * @param avio threaded avio context
+ */
+void upipe_av_avio_ack(struct upipe_av_avio *avio)
+{
+    ueventfd_read(&avio->event);
+}
+
+/** @This asks the I/O thread to open a URL for writing. The previous URL
+ * is closed if it is still opened.
+ *
+ * @param avio threaded avio context
+ * @param url URL to open
+ * @param options avformat options, or NULL
+ * @return 0, or a libavformat error code
+ */
+int upipe_av_avio_open(struct upipe_av_avio *avio, const char *url,
+                       AVDictionary *options)
+{
+    size_t len = strlen(url) + 1;
+    struct upipe_av_avio_chunk *chunk =
+        upipe_av_avio_chunk_alloc(UPIPE_AV_AVIO_OPEN, len);
+    if (unlikely(chunk == NULL))
+        return AVERROR(ENOMEM);
+    memcpy(chunk->data, url, len);
+    av_dict_copy(&chunk->options, options, 0);
+    if (unlikely(avio->outer != NULL))
+        upipe_av_avio_close(avio);
+    avio->position = 0;
+    avio->end = 0;
+    upipe_av_avio_queue(avio, chunk);
+    return 0;
+}
+
+/** @This returns the status of the last opened URL, without blocking.
+ *
+ * @param avio threaded avio context
+ * @return AVERROR(EAGAIN) while the I/O thread opens the URL, the first
+ * libavformat error since it was opened, or 0
+ */
+int upipe_av_avio_status(struct upipe_av_avio *avio)
+{
+    pthread_mutex_lock(&avio->mutex);
+    int error = avio->opening ? AVERROR(EAGAIN) : avio->error;
+    pthread_mutex_unlock(&avio->mutex);
+    return error;
+}
+
+/** @This returns the custom AVIOContext of the last opened URL. It must
+ * only be called once @ref upipe_av_avio_status returned 0.
+ *
+ * @param avio threaded avio context
+ * @return pointer to the AVIOContext, or NULL in case of allocation error
+ */
+AVIOContext *upipe_av_avio_context(struct upipe_av_avio *avio)
+{
+    if (avio->outer != NULL)
+        return avio->outer;
+
+    pthread_mutex_lock(&avio->mutex);
+    int seekable = avio->seekable;
+    pthread_mutex_unlock(&avio->mutex);
+
+    uint8_t *buffer = av_malloc(AVIO_BUFFER_SIZE);
+    if (unlikely(buffer == NULL))
+        return NULL;
+    avio->outer = avio_alloc_context(buffer, AVIO_BUFFER_SIZE, 1, avio,
+            NULL, upipe_av_avio_write,
+            seekable & AVIO_SEEKABLE_NORMAL ? upipe_av_avio_seek : NULL);
+    if (unlikely(avio->outer == NULL)) {
+        av_free(buffer);
+        return NULL;
+    }
+    avio->outer->seekable = seekable;
+    return avio->outer;
+}
+
+/** @This checks if the write-behind buffer is full. In that case, the
+ * watcher triggers once it is half empty.
+ *
+ * @param avio threaded avio context
+ * @return true if the write-behind buffer is full
+ */
+bool upipe_av_avio_full(struct upipe_av_avio *avio)
+{
+    pthread_mutex_lock(&avio->mutex);
+    bool full = avio->queued >= avio->size;
+    if (full)
+        avio->blocked = true;
+    pthread_mutex_unlock(&avio->mutex);
+    return full;
+}
+
+/** @This flushes the custom AVIOContext and asks the I/O thread to close
+ * the URL once the pending data is written.
+ *
+ * @param avio threaded avio context
+ */
+void upipe_av_avio_close(struct upipe_av_avio *avio)
+{
+    if (avio->outer != NULL) {
+        avio_flush(avio->outer);
+        av_freep(&avio->outer->buffer);
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(57, 80, 100)
+        avio_context_free(&avio->outer);
+#else
+        av_freep(&avio->outer);
+#endif
+    }
+
+    struct upipe_av_avio_chunk *chunk =
+        upipe_av_avio_chunk_alloc(UPIPE_AV_AVIO_CLOSE, 0);
+    if (likely(chunk != NULL))
+        upipe_av_avio_queue(avio, chunk);
+    /* otherwise the URL is closed by the next open or on exit */
+}
+
+/** @This closes the URL, waits for the I/O thread to process pending
+ * operations, stops it and frees everything.
+ *
+ * @param avio threaded avio context
+ * @return the first libavformat error code since the last open, or 0
+ */
+int upipe_av_avio_free(struct upipe_av_avio *avio)
+{
+    if (avio->outer != NULL)
+        upipe_av_avio_close(avio);
+
+    pthread_mutex_lock(&avio->mutex);
+    avio->stop = true;
+    pthread_cond_signal(&avio->cond);
+    pthread_mutex_unlock(&avio->mutex);
+    pthread_join(avio->thread, NULL);
+
+    int error = avio->error;
+    pthread_cond_destroy(&avio->cond);
+    pthread_mutex_destroy(&avio->mutex);
+    ueventfd_clean(&avio->event);
+    free(avio);
+    return error;
+}
+
+#endif
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short internal interface to threaded avio output contexts
+ *
+ * A threaded avio output context opens, writes and closes URLs with
+ * libavformat in a dedicated thread, and exposes a custom AVIOContext that
+ * only queues operations, so that blocking I/O doesn't stall the event
+ * loop. The results of the operations are posted back through an eventfd.
+ */
+
+#ifndef _UPIPE_AV_UPIPE_AV_AVIO_H_
+/** @hidden */
+#define _UPIPE_AV_UPIPE_AV_AVIO_H_
+
+#include "upipe/config.h"
+#include "upipe/upump.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <libavutil/dict.h>
+#include <libavformat/avio.h>
+
+#ifdef UPIPE_HAVE_PTHREAD
+
+/** @hidden */
+struct upipe_av_avio;
+
+/** @This allocates a threaded avio output context and starts its thread.
+ *
+ * @param size size of the write-behind buffer, in octets
+ * @return pointer to the threaded avio context, or NULL in case of error
+ */
+struct upipe_av_avio *upipe_av_avio_alloc(uint64_t size);
+
+/** @This allocates a watcher triggering when the I/O thread has opened a
+ * URL, when the write-behind buffer has drained after being full, or when
+ * an error occurs.
+ *
+ * @param avio threaded avio context
+ * @param upump_mgr management structure for this event loop
+ * @param cb function to call when the watcher triggers
+ * @param opaque pointer to the module's internal structure
+ * @param refcount pointer to urefcount structure to increment during callback,
+ * or NULL
+ * @return pointer to allocated watcher, or NULL in case of failure
+ */
+struct upump *upipe_av_avio_upump_alloc(struct upipe_av_avio *avio,
+                                        struct upump_mgr *upump_mgr,
+                                        upump_cb cb, void *opaque,
+                                        struct urefcount *refcount);
+
+/** @This acknowledges a notification of the watcher.
+ *
+ * @param avio threaded avio context
+ */
+void upipe_av_avio_ack(struct upipe_av_avio *avio);
+
+/** @This asks the I/O thread to open a URL for writing. The previous URL
+ * is closed if it is still opened.
+ *
+ * @param avio threaded avio context
+ * @param url URL to open
+ * @param options avformat options, or NULL
+ * @return 0, or a libavformat error code
+ */
+int upipe_av_avio_open(struct upipe_av_avio *avio, const char *url,
+                       AVDictionary *options);
+
+/** @This returns the status of the last opened URL, without blocking.
+ *
+ * @param avio threaded avio context
+ * @return AVERROR(EAGAIN) while the I/O thread opens the URL, the first
+ * libavformat error since it was opened, or 0
+ */
+int upipe_av_avio_status(struct upipe_av_avio *avio);
+
+/** @This returns the custom AVIOContext of the last opened URL. It must
+ * only be called once @ref upipe_av_avio_status returned 0. Writes and
+ * seeks are queued to the I/O thread, and their errors are reported by
+ * the following writes and by @ref upipe_av_avio_status.
+ *
+ * @param avio threaded avio context
+ * @return pointer to the AVIOContext, or NULL in case of allocation error
+ */
+AVIOContext *upipe_av_avio_context(struct upipe_av_avio *avio);
+
+/** @This checks if the write-behind buffer is full. In that case, the
+ * watcher triggers once it is half empty.
+ *
+ * @param avio threaded avio context
+ * @return true if the write-behind buffer is full
+ */
+bool upipe_av_avio_full(struct upipe_av_avio *avio);
+
+/** @This flushes the custom AVIOContext, which must not be used
+ * afterwards, and asks the I/O thread to close the URL once the pending
+ * data is written.
+ *
+ * @param avio threaded avio context
+ */
+void upipe_av_avio_close(struct upipe_av_avio *avio);
+
+/** @This closes the URL, waits for the I/O thread to process pending
+ * operations, stops it and frees everything.
+ *
+ * @param avio threaded avio context
+ * @return the first libavformat error code since the last open, or 0
+ */
+int upipe_av_avio_free(struct upipe_av_avio *avio);
+
+#endif
+
+#endif
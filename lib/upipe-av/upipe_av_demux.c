@@ -0,0 +1,420 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short threaded avformat demuxers
+ */
+
+#include "upipe/config.h"
+
+#ifdef UPIPE_HAVE_PTHREAD
+
+#include "upipe/ubase.h"
+#include "upipe/ulist.h"
+#include "upipe/ueventfd.h"
+
+#include "upipe_av_demux.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <libavutil/error.h>
+#include <libavformat/avformat.h>
+
+/** delay before retrying a read which returned EAGAIN, in nanoseconds */
+#define AV_DEMUX_RETRY_DELAY 10000000
+
+/** @internal @This is a packet queued by the I/O thread. */
+struct upipe_av_demux_packet {
+    /** structure for double-linked lists */
+    struct uchain uchain;
+    /** packet */
+    AVPacket *pkt;
+};
+
+UBASE_FROM_TO(upipe_av_demux_packet, uchain, uchain, uchain)
+
+/** @internal @This is the context shared between the event loop and the
+ * I/O thread. */
+struct upipe_av_demux {
+    /** I/O thread */
+    pthread_t thread;
+    /** protects the fields below */
+    pthread_mutex_t mutex;
+    /** signals the I/O thread that it may read or must exit */
+    pthread_cond_t cond;
+
+    /** URL */
+    char *url;
+    /** avformat options */
+    AVDictionary *options;
+    /** size of the packet queue */
+    uint64_t size;
+
+    /** avformat context, owned by the event loop between the end of the
+     * probing and @ref upipe_av_demux_start, and by the I/O thread
+     * otherwise */
+    AVFormatContext *context;
+    /** number of streams at probing time */
+    unsigned int nb_streams;
+    /** AVERROR(EAGAIN) until the URL is probed, then the probing error */
+    int status;
+    /** error which stopped the reading, or 0 */
+    int error;
+    /** true once the event loop has handed the context back */
+    bool started;
+    /** true if the thread must exit */
+    bool stop;
+    /** queued packets */
+    struct uchain packets;
+    /** octets of the queued packets */
+    uint64_t queued;
+
+    /** wakes up the event loop */
+    struct ueventfd event;
+};
+
+/** @internal @This interrupts blocking libavformat calls when the thread
+ * is asked to exit.
+ *
+ * @param opaque threaded demuxer
+ * @return true if the call must be interrupted
+ */
+static int upipe_av_demux_interrupt(void *opaque)
+{
+    struct upipe_av_demux *demux = opaque;
+    pthread_mutex_lock(&demux->mutex);
+    bool stop = demux->stop;
+    pthread_mutex_unlock(&demux->mutex);
+    return stop;
+}
+
+/** @internal @This opens and probes the URL, in the thread.
+ *
+ * @param demux threaded demuxer
+ * @param context_p filled in with the avformat context
+ * @return 0, or a libavformat error code
+ */
+static int upipe_av_demux_probe(struct upipe_av_demux *demux,
+                                AVFormatContext **context_p)
+{
+    AVFormatContext *context = avformat_alloc_context();
+    if (unlikely(context == NULL))
+        return AVERROR(ENOMEM);
+    context->interrupt_callback.callback = upipe_av_demux_interrupt;
+    context->interrupt_callback.opaque = demux;
+
+    AVDictionary *options = NULL;
+    av_dict_copy(&options, demux->options, 0);
+    int error = avformat_open_input(&context, demux->url, NULL, &options);
+    av_dict_free(&options);
+    if (unlikely(error < 0))
+        return error;
+
+#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(59, 16, 100)
+    /* Don't merge side data into avpacket data */
+    context->flags |= AVFMT_FLAG_KEEP_SIDE_DATA;
+#endif
+
+    unsigned nb_streams = context->nb_streams;
+    if (nb_streams) {
+        AVDictionary *stream_options[nb_streams];
+        for (unsigned i = 0; i < nb_streams; i++) {
+            stream_options[i] = NULL;
+            av_dict_copy(&stream_options[i], demux->options, 0);
+        }
+        error = avformat_find_stream_info(context, stream_options);
+
+        for (unsigned i = 0; i < nb_streams; i++)
+            av_dict_free(&stream_options[i]);
+    }
+    else
+        error = avformat_find_stream_info(context, NULL);
+
+    if (unlikely(error < 0)) {
+        avformat_close_input(&context);
+        return error;
+    }
+    *context_p = context;
+    return 0;
+}
+
+/** @internal @This is the main loop of the I/O thread.
+ *
+ * @param opaque threaded demuxer
+ * @return NULL
+ */
+static void *upipe_av_demux_run(void *opaque)
+{
+    struct upipe_av_demux *demux = opaque;
+    AVFormatContext *context = NULL;
+    int error = upipe_av_demux_probe(demux, &context);
+
+    pthread_mutex_lock(&demux->mutex);
+    demux->status = error;
+    if (likely(context != NULL)) {
+        demux->context = context;
+        demux->nb_streams = context->nb_streams;
+    }
+    pthread_mutex_unlock(&demux->mutex);
+    ueventfd_write(&demux->event);
+    if (unlikely(context == NULL))
+        return NULL;
+
+    pthread_mutex_lock(&demux->mutex);
+    for ( ; ; ) {
+        if (demux->stop)
+            break;
+        if (!demux->started || demux->error < 0 ||
+            demux->queued >= demux->size) {
+            pthread_cond_wait(&demux->cond, &demux->mutex);
+            continue;
+        }
+        unsigned int nb_streams = demux->nb_streams;
+        pthread_mutex_unlock(&demux->mutex);
+
+        struct upipe_av_demux_packet *packet = malloc(sizeof (*packet));
+        AVPacket *pkt = av_packet_alloc();
+        error = AVERROR(ENOMEM);
+        if (likely(packet != NULL && pkt != NULL))
+            error = av_read_frame(context, pkt);
+        if (unlikely(error == AVERROR(EAGAIN))) {
+            /* the demuxer has no data yet, retry later unless woken up to
+             * exit */
+            av_packet_free(&pkt);
+            free(packet);
+            struct timespec deadline;
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            deadline.tv_nsec += AV_DEMUX_RETRY_DELAY;
+            deadline.tv_sec += deadline.tv_nsec / 1000000000;
+            deadline.tv_nsec %= 1000000000;
+            pthread_mutex_lock(&demux->mutex);
+            if (!demux->stop)
+                pthread_cond_timedwait(&demux->cond, &demux->mutex,
+                                       &deadline);
+            continue;
+        }
+        if (likely(error >= 0)) {
+            if ((unsigned int)pkt->stream_index < nb_streams) {
+                AVStream *stream = context->streams[pkt->stream_index];
+                pkt->time_base = stream->time_base;
+            } else {
+                /* the stream appeared after probing */
+                av_packet_free(&pkt);
+                free(packet);
+                pthread_mutex_lock(&demux->mutex);
+                continue;
+            }
+        }
+
+        pthread_mutex_lock(&demux->mutex);
+        bool notify;
+        if (unlikely(error < 0)) {
+            av_packet_free(&pkt);
+            free(packet);
+            demux->error = error;
+            notify = true;
+        } else {
+            notify = ulist_empty(&demux->packets);
+            uchain_init(upipe_av_demux_packet_to_uchain(packet));
+            packet->pkt = pkt;
+            ulist_add(&demux->packets,
+                      upipe_av_demux_packet_to_uchain(packet));
+            demux->queued += sizeof (AVPacket) + pkt->size;
+        }
+        if (notify) {
+            pthread_mutex_unlock(&demux->mutex);
+            ueventfd_write(&demux->event);
+            pthread_mutex_lock(&demux->mutex);
+        }
+    }
+    pthread_mutex_unlock(&demux->mutex);
+
+    avformat_close_input(&context);
+    return NULL;
+}
+
+/** @This allocates a threaded demuxer and starts opening and probing the
+ * URL.
+ *
+ * @param url URL to open
+ * @param options avformat options, also given to each stream for probing,
+ * or NULL
+ * @param size size of the packet queue, in octets
+ * @return pointer to the threaded demuxer, or NULL in case of error
+ */
+struct upipe_av_demux *upipe_av_demux_alloc(const char *url,
+                                            AVDictionary *options,
+                                            uint64_t size)
+{
+    struct upipe_av_demux *demux = malloc(sizeof (*demux));
+    if (unlikely(demux == NULL))
+        return NULL;
+    demux->url = strdup(url);
+    if (unlikely(demux->url == NULL)) {
+        free(demux);
+        return NULL;
+    }
+    if (unlikely(!ueventfd_init(&demux->event, false))) {
+        free(demux->url);
+        free(demux);
+        return NULL;
+    }
+
+    demux->options = NULL;
+    av_dict_copy(&demux->options, options, 0);
+    demux->size = size;
+    demux->context = NULL;
+    demux->nb_streams = 0;
+    demux->status = AVERROR(EAGAIN);
+    demux->error = 0;
+    demux->started = false;
+    demux->stop = false;
+    ulist_init(&demux->packets);
+    demux->queued = 0;
+    pthread_mutex_init(&demux->mutex, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&demux->cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (unlikely(pthread_create(&demux->thread, NULL,
+                                upipe_av_demux_run, demux) != 0)) {
+        pthread_cond_destroy(&demux->cond);
+        pthread_mutex_destroy(&demux->mutex);
+        av_dict_free(&demux->options);
+        ueventfd_clean(&demux->event);
+        free(demux->url);
+        free(demux);
+        return NULL;
+    }
+    return demux;
+}
+
+/** @This allocates a watcher triggering when the URL is probed, when a
+ * packet is queued while the queue was empty, or at the end of the stream.
+ *
+ * @param demux threaded demuxer
+ * @param upump_mgr management structure for this event loop
+ * @param cb function to call when the watcher triggers
+ * @param opaque pointer to the module's internal structure
+ * @param refcount pointer to urefcount structure to increment during callback,
+ * or NULL
+ * @return pointer to allocated watcher, or NULL in case of failure
+ */
+struct upump *upipe_av_demux_upump_alloc(struct upipe_av_demux *demux,
+                                         struct upump_mgr *upump_mgr,
+                                         upump_cb cb, void *opaque,
+                                         struct urefcount *refcount)
+{
+    return ueventfd_upump_alloc(&demux->event, upump_mgr, cb, opaque,
+                                refcount);
+}
+
+/** @This acknowledges a notification of the watcher.
+ *
+ * @param demux threaded demuxer
+ */
+void upipe_av_demux_ack(struct upipe_av_demux *demux)
+{
+    ueventfd_read(&demux->event);
+}
+
+/** @This returns the probed avformat context, without blocking. The I/O
+ * thread doesn't use the context until @ref upipe_av_demux_start is called.
+ *
+ * @param demux threaded demuxer
+ * @param context_p filled in with the avformat context
+ * @return AVERROR(EAGAIN) while the I/O thread opens and probes the URL,
+ * a libavformat error code if it failed, or 0
+ */
+int upipe_av_demux_context(struct upipe_av_demux *demux,
+                           AVFormatContext **context_p)
+{
+    pthread_mutex_lock(&demux->mutex);
+    int error = demux->status;
+    *context_p = demux->context;
+    pthread_mutex_unlock(&demux->mutex);
+    return error;
+}
+
+/** @This hands the probed avformat context back to the I/O thread, which
+ * starts reading packets. The context must not be used by the caller
+ * afterwards.
+ *
+ * @param demux threaded demuxer
+ */
+void upipe_av_demux_start(struct upipe_av_demux *demux)
+{
+    pthread_mutex_lock(&demux->mutex);
+    demux->started = true;
+    pthread_cond_signal(&demux->cond);
+    pthread_mutex_unlock(&demux->mutex);
+}
+
+/** @This dequeues a packet read by the I/O thread, without blocking.
+ *
+ * @param demux threaded demuxer
+ * @param pkt filled in with the packet
+ * @return AVERROR(EAGAIN) if no packet is queued, the libavformat error
+ * code which stopped the reading, or 0
+ */
+int upipe_av_demux_read(struct upipe_av_demux *demux, AVPacket *pkt)
+{
+    pthread_mutex_lock(&demux->mutex);
+    struct uchain *uchain = ulist_pop(&demux->packets);
+    if (uchain == NULL) {
+        int error = demux->error < 0 ? demux->error : AVERROR(EAGAIN);
+        pthread_cond_signal(&demux->cond);
+        pthread_mutex_unlock(&demux->mutex);
+        return error;
+    }
+    struct upipe_av_demux_packet *packet =
+        upipe_av_demux_packet_from_uchain(uchain);
+    demux->queued -= sizeof (AVPacket) + packet->pkt->size;
+    pthread_cond_signal(&demux->cond);
+    pthread_mutex_unlock(&demux->mutex);
+
+    av_packet_move_ref(pkt, packet->pkt);
+    av_packet_free(&packet->pkt);
+    free(packet);
+    return 0;
+}
+
+/** @This interrupts the I/O thread, waits for it to close the URL and
+ * frees everything.
+ *
+ * @param demux threaded demuxer
+ */
+void upipe_av_demux_free(struct upipe_av_demux *demux)
+{
+    pthread_mutex_lock(&demux->mutex);
+    demux->stop = true;
+    pthread_cond_signal(&demux->cond);
+    pthread_mutex_unlock(&demux->mutex);
+    pthread_join(demux->thread, NULL);
+
+    struct uchain *uchain;
+    while ((uchain = ulist_pop(&demux->packets)) != NULL) {
+        struct upipe_av_demux_packet *packet =
+            upipe_av_demux_packet_from_uchain(uchain);
+        av_packet_free(&packet->pkt);
+        free(packet);
+    }
+    pthread_cond_destroy(&demux->cond);
+    pthread_mutex_destroy(&demux->mutex);
+    av_dict_free(&demux->options);
+    ueventfd_clean(&demux->event);
+    free(demux->url);
+    free(demux);
+}
+
+#endif
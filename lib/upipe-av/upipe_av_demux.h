@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short internal interface to threaded avformat demuxers
+ *
+ * A threaded demuxer opens and probes a URL with libavformat in a
+ * dedicated thread, then reads packets ahead into a queue, so that
+ * blocking I/O doesn't stall the event loop. The results are posted back
+ * through an eventfd.
+ *
+ * Unlike the output side (see upipe_av_avio.h), the thread runs the
+ * demuxer itself rather than only filling the buffer of a custom
+ * AVIOContext. A read callback has no way to tell a demuxer to come back
+ * later: it must either block or fail, and most demuxers treat a failed
+ * or short read as the end of the stream. Demuxers also seek on their own
+ * (e.g. looking for the moov atom of an MP4 file), so a read-ahead buffer
+ * would still block the event loop whenever it runs dry or the demuxer
+ * jumps elsewhere. The cost of demultiplexing thus moves to the thread
+ * along with the I/O, while packets are still turned into urefs on the
+ * event loop.
+ *
+ * The avformat context is only shared through a handover: the I/O thread
+ * leaves it alone after probing until @ref upipe_av_demux_start is called,
+ * and the caller must not use it afterwards.
+ */
+
+#ifndef _UPIPE_AV_UPIPE_AV_DEMUX_H_
+/** @hidden */
+#define _UPIPE_AV_UPIPE_AV_DEMUX_H_
+
+#include "upipe/config.h"
+#include "upipe/upump.h"
+
+#include <stdint.h>
+
+#include <libavutil/dict.h>
+#include <libavformat/avformat.h>
+
+#ifdef UPIPE_HAVE_PTHREAD
+
+/** @hidden */
+struct upipe_av_demux;
+
+/** @This allocates a threaded demuxer and starts opening and probing the
+ * URL.
+ *
+ * @param url URL to open
+ * @param options avformat options, also given to each stream for probing,
+ * or NULL
+ * @param size size of the packet queue, in octets
+ * @return pointer to the threaded demuxer, or NULL in case of error
+ */
+struct upipe_av_demux *upipe_av_demux_alloc(const char *url,
+                                            AVDictionary *options,
+                                            uint64_t size);
+
+/** @This allocates a watcher triggering when the URL is probed, when a
+ * packet is queued while the queue was empty, or at the end of the stream.
+ *
+ * @param demux threaded demuxer
+ * @param upump_mgr management structure for this event loop
+ * @param cb function to call when the watcher triggers
+ * @param opaque pointer to the module's internal structure
+ * @param refcount pointer to urefcount structure to increment during callback,
+ * or NULL
+ * @return pointer to allocated watcher, or NULL in case of failure
+ */
+struct upump *upipe_av_demux_upump_alloc(struct upipe_av_demux *demux,
+                                         struct upump_mgr *upump_mgr,
+                                         upump_cb cb, void *opaque,
+                                         struct urefcount *refcount);
+
+/** @This acknowledges a notification of the watcher.
+ *
+ * @param demux threaded demuxer
+ */
+void upipe_av_demux_ack(struct upipe_av_demux *demux);
+
+/** @This returns the probed avformat context, without blocking. The
+ * context may be inspected until @ref upipe_av_demux_start is called.
+ *
+ * @param demux threaded demuxer
+ * @param context_p filled in with the avformat context
+ * @return AVERROR(EAGAIN) while the I/O thread opens and probes the URL,
+ * a libavformat error code if it failed, or 0
+ */
+int upipe_av_demux_context(struct upipe_av_demux *demux,
+                           AVFormatContext **context_p);
+
+/** @This hands the probed avformat context back to the I/O thread, which
+ * starts reading packets. The context must not be used by the caller
+ * afterwards.
+ *
+ * @param demux threaded demuxer
+ */
+void upipe_av_demux_start(struct upipe_av_demux *demux);
+
+/** @This dequeues a packet read by the I/O thread, without blocking. The
+ * time base of the packet is set to the one of its stream, and packets of
+ * streams added after probing are dropped.
+ *
+ * @param demux threaded demuxer
+ * @param pkt filled in with the packet
+ * @return AVERROR(EAGAIN) if no packet is queued, the libavformat error
+ * code which stopped the reading (AVERROR_EOF at the end of the stream),
+ * or 0
+ */
+int upipe_av_demux_read(struct upipe_av_demux *demux, AVPacket *pkt);
+
+/** @This interrupts the I/O thread, waits for it to close the URL and
+ * frees everything.
+ *
+ * @param demux threaded demuxer
+ */
+void upipe_av_demux_free(struct upipe_av_demux *demux);
+
+#endif
+
+#endif
@@ -10,6 +10,7 @@
  * @short Upipe sink module libavformat wrapper
  */
 
+#include "upipe/config.h"
 #include "upipe/ubase.h"
 #include "upipe/ulist.h"
 #include "upipe/uclock.h"
@@ -26,10 +27,13 @@
 #include "upipe/upipe_helper_flow_def_check.h"
 #include "upipe/upipe_helper_subpipe.h"
 #include "upipe/upipe_helper_sync.h"
+#include "upipe/upipe_helper_upump_mgr.h"
+#include "upipe/upipe_helper_upump.h"
 #include "upipe-framers/uref_mpga_flow.h"
 #include "upipe-av/upipe_avformat_sink.h"
 
 #include "upipe_av_internal.h"
+#include "upipe_av_avio.h"
 
 #include <stdlib.h>
 #include <stdbool.h>
@@ -41,11 +45,26 @@
 #include <libavutil/dict.h>
 #include <libavformat/avformat.h>
 
+/** @internal @This enumerates the steps to open the output. */
+enum upipe_avfsink_step {
+    /** waiting for the first packet */
+    UPIPE_AVFSINK_STEP_PREROLL,
+    /** waiting for the URL to write the header to */
+    UPIPE_AVFSINK_STEP_HEADER,
+    /** waiting for the URL to write the packets to */
+    UPIPE_AVFSINK_STEP_MEDIA
+};
+
 /** @internal @This is the private context of an avformat source pipe. */
 struct upipe_avfsink {
     /** refcount management structure */
     struct urefcount urefcount;
 
+    /** upump manager */
+    struct upump_mgr *upump_mgr;
+    /** watcher of the I/O thread */
+    struct upump *upump_avio;
+
     /** list of subs */
     struct uchain subs;
 
@@ -64,6 +83,14 @@ struct upipe_avfsink {
     AVFormatContext *context;
     /** true if the header has already been written */
     bool opened;
+    /** current step to open the output */
+    enum upipe_avfsink_step step;
+    /** size of the write-behind buffer of the I/O thread, or 0 */
+    uint64_t async_size;
+#ifdef UPIPE_HAVE_PTHREAD
+    /** threaded avio context, or NULL */
+    struct upipe_av_avio *avio;
+#endif
     /** offset between Upipe timestamp and avformat timestamp */
     uint64_t ts_offset;
     /** first DTS */
@@ -84,6 +111,8 @@ UPIPE_HELPER_UPIPE(upipe_avfsink, upipe, UPIPE_AVFSINK_SIGNATURE)
 UPIPE_HELPER_UREFCOUNT(upipe_avfsink, urefcount, upipe_avfsink_free)
 UPIPE_HELPER_VOID(upipe_avfsink)
 UPIPE_HELPER_SYNC(upipe_avfsink, acquired)
+UPIPE_HELPER_UPUMP_MGR(upipe_avfsink, upump_mgr)
+UPIPE_HELPER_UPUMP(upipe_avfsink, upump_avio, upump_mgr)
 
 /** @internal @This is the private context of an output of an avformat source
  * pipe. */
@@ -711,6 +740,8 @@ static struct upipe *upipe_avfsink_alloc(struct upipe_mgr *mgr,
     upipe_avfsink_init_sub_subs(upipe);
     upipe_avfsink_init_sub_mgr(upipe);
     upipe_avfsink_init_sync(upipe);
+    upipe_avfsink_init_upump_mgr(upipe);
+    upipe_avfsink_init_upump_avio(upipe);
 
     upipe_avfsink->uri = NULL;
     upipe_avfsink->init_uri = NULL;
@@ -719,7 +750,12 @@ static struct upipe *upipe_avfsink_alloc(struct upipe_mgr *mgr,
 
     upipe_avfsink->options = NULL;
     upipe_avfsink->context = NULL;
+    upipe_avfsink->async_size = 0;
+#ifdef UPIPE_HAVE_PTHREAD
+    upipe_avfsink->avio = NULL;
+#endif
     upipe_avfsink->opened = false;
+    upipe_avfsink->step = UPIPE_AVFSINK_STEP_PREROLL;
     upipe_avfsink->ts_offset = UINT64_MAX;
     upipe_avfsink->first_dts = 0;
     upipe_avfsink->highest_next_dts = 0;
@@ -755,7 +791,132 @@ static struct upipe_avfsink_sub *upipe_avfsink_find_input(struct upipe *upipe)
     return earliest_input;
 }
 
-static int upipe_avfsink_avio_open(struct upipe *upipe, struct upipe_avfsink_sub *input)
+/** @internal @This reports an error opening the output URL, and drops the
+ * packets of the input.
+ *
+ * @param upipe description structure of the pipe
+ * @param input input with the earliest packet
+ * @param error libavformat error code
+ * @return an error code
+ */
+static int upipe_avfsink_avio_error(struct upipe *upipe,
+                                    struct upipe_avfsink_sub *input,
+                                    int error)
+{
+    struct upipe_avfsink *upipe_avfsink = upipe_avfsink_from_upipe(upipe);
+#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 7, 100)
+    char *url = upipe_avfsink->context->filename;
+#else
+    char *url = upipe_avfsink->context->url;
+#endif
+
+    upipe_err_va(upipe, "couldn't open file %s (%s)", url, av_err2str(error));
+    upipe_throw_fatal(upipe, UBASE_ERR_EXTERNAL);
+    while (!ulist_empty(&input->urefs)) {
+        uref_free(uref_from_uchain(ulist_pop(&input->urefs)));
+    }
+    upipe_release(upipe_avfsink_sub_to_upipe(input));
+    return UBASE_ERR_EXTERNAL;
+}
+
+#ifdef UPIPE_HAVE_PTHREAD
+/** @internal @This lets the watcher of the I/O thread keep the event loop
+ * alive only while the pipe waits for the thread.
+ *
+ * @param upipe description structure of the pipe
+ * @param wait true if the pipe waits for the I/O thread
+ */
+static void upipe_avfsink_avio_wait(struct upipe *upipe, bool wait)
+{
+    struct upipe_avfsink *upipe_avfsink = upipe_avfsink_from_upipe(upipe);
+    if (upipe_avfsink->upump_avio != NULL)
+        upump_set_status(upipe_avfsink->upump_avio, wait);
+}
+
+/** @internal @This is called when the I/O thread has opened the URL, when
+ * its buffer has drained or when it failed.
+ *
+ * @param upump description structure of the watcher
+ */
+static void upipe_avfsink_avio_worker(struct upump *upump)
+{
+    struct upipe *upipe = upump_get_opaque(upump, struct upipe *);
+    struct upipe_avfsink *upipe_avfsink = upipe_avfsink_from_upipe(upipe);
+    upipe_av_avio_ack(upipe_avfsink->avio);
+    upipe_avfsink_avio_wait(upipe, false);
+    upipe_avfsink_mux(upipe, NULL);
+}
+
+/** @internal @This starts the I/O thread and its watcher, if needed.
+ *
+ * @param upipe description structure of the pipe
+ * @return an error code
+ */
+static int upipe_avfsink_avio_start(struct upipe *upipe)
+{
+    struct upipe_avfsink *upipe_avfsink = upipe_avfsink_from_upipe(upipe);
+    if (upipe_avfsink->avio != NULL)
+        return UBASE_ERR_NONE;
+
+    upipe_avfsink_check_upump_mgr(upipe);
+    if (unlikely(upipe_avfsink->upump_mgr == NULL)) {
+        upipe_err(upipe, "no upump manager for the I/O thread");
+        return UBASE_ERR_UPUMP;
+    }
+
+    upipe_avfsink->avio = upipe_av_avio_alloc(upipe_avfsink->async_size);
+    if (unlikely(upipe_avfsink->avio == NULL)) {
+        upipe_err(upipe, "couldn't start the I/O thread");
+        return UBASE_ERR_EXTERNAL;
+    }
+
+    struct upump *upump =
+        upipe_av_avio_upump_alloc(upipe_avfsink->avio,
+                                  upipe_avfsink->upump_mgr,
+                                  upipe_avfsink_avio_worker,
+                                  upipe, upipe->refcount);
+    if (unlikely(upump == NULL)) {
+        upipe_av_avio_free(upipe_avfsink->avio);
+        upipe_avfsink->avio = NULL;
+        upipe_err(upipe, "fail to allocate I/O watcher");
+        return UBASE_ERR_UPUMP;
+    }
+    upipe_avfsink_set_upump_avio(upipe, upump);
+    upump_start(upump);
+    upipe_avfsink_avio_wait(upipe, false);
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This stops the I/O thread, once it has written the pending
+ * data.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_avfsink_avio_stop(struct upipe *upipe)
+{
+    struct upipe_avfsink *upipe_avfsink = upipe_avfsink_from_upipe(upipe);
+    if (upipe_avfsink->avio == NULL)
+        return;
+
+    upipe_avfsink_set_upump_avio(upipe, NULL);
+    int error = upipe_av_avio_free(upipe_avfsink->avio);
+    upipe_avfsink->avio = NULL;
+    if (unlikely(error < 0)) {
+        upipe_warn_va(upipe, "write error (%s)", av_err2str(error));
+        upipe_throw_error(upipe, UBASE_ERR_EXTERNAL);
+    }
+}
+#endif
+
+/** @internal @This opens the output URL. With an I/O thread, it only asks
+ * the thread to open it, see @ref upipe_avfsink_avio_opened.
+ *
+ * @param upipe description structure of the pipe
+ * @param input input with the earliest packet
+ * @return an error code
+ */
+static int upipe_avfsink_avio_open(struct upipe *upipe,
+                                   struct upipe_avfsink_sub *input)
 {
     struct upipe_avfsink *upipe_avfsink = upipe_avfsink_from_upipe(upipe);
 
@@ -768,25 +929,95 @@ static int upipe_avfsink_avio_open(struct upipe *upipe, struct upipe_avfsink_sub
     char *url = upipe_avfsink->context->url;
 #endif
 
+    int error;
+#ifdef UPIPE_HAVE_PTHREAD
+    if (!upipe_avfsink->async_size)
+        upipe_avfsink_avio_stop(upipe);
+    else {
+        int err = upipe_avfsink_avio_start(upipe);
+        if (unlikely(!ubase_check(err))) {
+            upipe_throw_fatal(upipe, err);
+            return err;
+        }
+        error = upipe_av_avio_open(upipe_avfsink->avio, url,
+                                   upipe_avfsink->options);
+        if (unlikely(error < 0))
+            return upipe_avfsink_avio_error(upipe, input, error);
+        return UBASE_ERR_NONE;
+    }
+#endif
+
     AVDictionary *options = NULL;
     av_dict_copy(&options, upipe_avfsink->options, 0);
-    int error = avio_open2(&upipe_avfsink->context->pb, url,
-                           AVIO_FLAG_WRITE, NULL, &options);
+    error = avio_open2(&upipe_avfsink->context->pb, url,
+                       AVIO_FLAG_WRITE, NULL, &options);
     av_dict_free(&options);
-    if (error < 0) {
-        upipe_err_va(upipe, "couldn't open file %s (%s)", url,
-                     av_err2str(error));
-        upipe_throw_fatal(upipe, UBASE_ERR_EXTERNAL);
-        while (!ulist_empty(&input->urefs)) {
-            uref_free(uref_from_uchain(ulist_pop(&input->urefs)));
-        }
-        upipe_release(upipe_avfsink_sub_to_upipe(input));
-        return UBASE_ERR_EXTERNAL;
-    }
+    if (unlikely(error < 0))
+        return upipe_avfsink_avio_error(upipe, input, error);
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This checks that the output URL is opened, and sets the
+ * AVIOContext of the I/O thread once it is.
+ *
+ * @param upipe description structure of the pipe
+ * @param input input with the earliest packet
+ * @return an error code, UBASE_ERR_BUSY while the I/O thread opens the URL
+ */
+static int upipe_avfsink_avio_opened(struct upipe *upipe,
+                                     struct upipe_avfsink_sub *input)
+{
+#ifdef UPIPE_HAVE_PTHREAD
+    struct upipe_avfsink *upipe_avfsink = upipe_avfsink_from_upipe(upipe);
+    if (upipe_avfsink->context->oformat->flags & AVFMT_NOFILE ||
+        upipe_avfsink->avio == NULL || upipe_avfsink->context->pb != NULL)
+        return UBASE_ERR_NONE;
 
+    int error = upipe_av_avio_status(upipe_avfsink->avio);
+    if (error == AVERROR(EAGAIN))
+        return UBASE_ERR_BUSY;
+    if (likely(error >= 0)) {
+        upipe_avfsink->context->pb =
+            upipe_av_avio_context(upipe_avfsink->avio);
+        if (unlikely(upipe_avfsink->context->pb == NULL))
+            error = AVERROR(ENOMEM);
+    }
+    if (unlikely(error < 0))
+        return upipe_avfsink_avio_error(upipe, input, error);
+#endif
     return UBASE_ERR_NONE;
 }
 
+/** @internal @This closes the output URL. With an I/O thread, the URL is
+ * closed once the pending data is written.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_avfsink_avio_close(struct upipe *upipe)
+{
+    struct upipe_avfsink *upipe_avfsink = upipe_avfsink_from_upipe(upipe);
+
+    if (upipe_avfsink->context->oformat->flags & AVFMT_NOFILE)
+        return;
+
+#ifdef UPIPE_HAVE_PTHREAD
+    if (upipe_avfsink->avio != NULL) {
+        if (upipe_avfsink->context->pb == NULL)
+            return;
+        int error = upipe_av_avio_status(upipe_avfsink->avio);
+        upipe_av_avio_close(upipe_avfsink->avio);
+        upipe_avfsink->context->pb = NULL;
+        if (unlikely(error < 0)) {
+            upipe_warn_va(upipe, "write error to %s (%s)", upipe_avfsink->uri,
+                          av_err2str(error));
+            upipe_throw_error(upipe, UBASE_ERR_EXTERNAL);
+        }
+        return;
+    }
+#endif
+    avio_closep(&upipe_avfsink->context->pb);
+}
+
 /** @internal @This sets the default disposition of the streams.
  * This is called when the application doesn't catch preroll end to configure
  * the default disposition.
@@ -832,18 +1063,22 @@ static void upipe_avfsink_set_disposition_default(struct upipe *upipe)
         video_stream->disposition = AV_DISPOSITION_DEFAULT;
 }
 
-/** @internal @This asks avformat to multiplex some data.
+/** @internal @This writes the header, and the init section if any, before
+ * the first packet. With an I/O thread, it is called again by the watcher
+ * once the thread has opened the URL.
  *
  * @param upipe description structure of the pipe
- * @param upump_p reference to pump that generated the last buffer
+ * @param input input with the earliest packet
+ * @return an error code, UBASE_ERR_BUSY while the I/O thread opens the URL,
+ * or UBASE_ERR_INVALID if the pipe was released
  */
-static void upipe_avfsink_mux(struct upipe *upipe, struct upump **upump_p)
+static int upipe_avfsink_open(struct upipe *upipe,
+                              struct upipe_avfsink_sub *input)
 {
     struct upipe_avfsink *upipe_avfsink = upipe_avfsink_from_upipe(upipe);
-    struct upipe_avfsink_sub *input;
 
-    while ((input = upipe_avfsink_find_input(upipe)) != NULL) {
-        if (unlikely(!upipe_avfsink->opened)) {
+    switch (upipe_avfsink->step) {
+        case UPIPE_AVFSINK_STEP_PREROLL: {
             /* prevent the pipe to be released during event handling */
             upipe_use(upipe);
             /* send preroll end event */
@@ -852,7 +1087,7 @@ static void upipe_avfsink_mux(struct upipe *upipe, struct upump **upump_p)
             upipe_release(upipe);
             if (single)
                 /* the pipe was released during event handling */
-                return;
+                return UBASE_ERR_INVALID;
 
             if (err == UBASE_ERR_UNHANDLED)
                 /* the application has not handled the preroll so apply the
@@ -881,8 +1116,12 @@ static void upipe_avfsink_mux(struct upipe *upipe, struct upump **upump_p)
                     av_strdup(upipe_avfsink->init_uri);
 #endif
             }
-            if (!ubase_check(upipe_avfsink_avio_open(upipe, input)))
-                return;
+            UBASE_RETURN(upipe_avfsink_avio_open(upipe, input))
+            upipe_avfsink->step = UPIPE_AVFSINK_STEP_HEADER;
+        }
+        /* fallthrough */
+        case UPIPE_AVFSINK_STEP_HEADER: {
+            UBASE_RETURN(upipe_avfsink_avio_opened(upipe, input))
 
             AVDictionary *options = NULL;
             av_dict_copy(&options, upipe_avfsink->options, 0);
@@ -895,7 +1134,8 @@ static void upipe_avfsink_mux(struct upipe *upipe, struct upump **upump_p)
                     uref_free(uref_from_uchain(ulist_pop(&input->urefs)));
                 }
                 upipe_release(upipe_avfsink_sub_to_upipe(input));
-                return;
+                av_dict_free(&options);
+                return UBASE_ERR_EXTERNAL;
             }
             AVDictionaryEntry *e = NULL;
             while ((e = av_dict_get(options, "", e, AV_DICT_IGNORE_SUFFIX)))
@@ -909,12 +1149,11 @@ static void upipe_avfsink_mux(struct upipe *upipe, struct upump **upump_p)
                     upipe_warn_va(upipe, "write error to %s (%s)",
                                   upipe_avfsink->init_uri, av_err2str(error));
                     upipe_throw_error(upipe, UBASE_ERR_EXTERNAL);
-                    return;
+                    return UBASE_ERR_EXTERNAL;
                 }
                 upipe_notice_va(upipe, "closing init URI %s",
                                 upipe_avfsink->init_uri);
-                if (!(upipe_avfsink->context->oformat->flags & AVFMT_NOFILE))
-                    avio_close(upipe_avfsink->context->pb);
+                upipe_avfsink_avio_close(upipe);
 #if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 7, 100)
                 snprintf(upipe_avfsink->context->filename,
                          sizeof (upipe_avfsink->context->filename),
@@ -923,13 +1162,53 @@ static void upipe_avfsink_mux(struct upipe *upipe, struct upump **upump_p)
                 av_free(upipe_avfsink->context->url);
                 upipe_avfsink->context->url = av_strdup(upipe_avfsink->uri);
 #endif
-                if (!ubase_check(upipe_avfsink_avio_open(upipe, input)))
-                    return;
+                UBASE_RETURN(upipe_avfsink_avio_open(upipe, input))
+            }
+            upipe_avfsink->step = UPIPE_AVFSINK_STEP_MEDIA;
+        }
+        /* fallthrough */
+        case UPIPE_AVFSINK_STEP_MEDIA:
+            UBASE_RETURN(upipe_avfsink_avio_opened(upipe, input))
+            break;
+    }
+
+    upipe_avfsink->opened = true;
+    upipe_avfsink_sync_acquired(upipe);
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This asks avformat to multiplex some data.
+ *
+ * @param upipe description structure of the pipe
+ * @param upump_p reference to pump that generated the last buffer
+ */
+static void upipe_avfsink_mux(struct upipe *upipe, struct upump **upump_p)
+{
+    struct upipe_avfsink *upipe_avfsink = upipe_avfsink_from_upipe(upipe);
+    struct upipe_avfsink_sub *input;
+
+    while ((input = upipe_avfsink_find_input(upipe)) != NULL) {
+        if (unlikely(!upipe_avfsink->opened)) {
+            int err = upipe_avfsink_open(upipe, input);
+#ifdef UPIPE_HAVE_PTHREAD
+            if (err == UBASE_ERR_BUSY) {
+                /* resumed by the watcher once the URL is opened */
+                upipe_avfsink_avio_wait(upipe, true);
+                return;
             }
+#endif
+            if (!ubase_check(err))
+                return;
+        }
 
-            upipe_avfsink->opened = true;
-            upipe_avfsink_sync_acquired(upipe);
+#ifdef UPIPE_HAVE_PTHREAD
+        if (upipe_avfsink->avio != NULL &&
+            upipe_av_avio_full(upipe_avfsink->avio)) {
+            /* resumed by the watcher once the buffer is half empty */
+            upipe_avfsink_avio_wait(upipe, true);
+            return;
         }
+#endif
 
         AVStream *stream = upipe_avfsink->context->streams[input->id];
         struct uchain *uchain = ulist_pop(&input->urefs);
@@ -1216,8 +1495,7 @@ static int upipe_avfsink_set_uri(struct upipe *upipe, const char *uri)
         if (upipe_avfsink->opened) {
             upipe_dbg(upipe, "writing trailer");
             av_write_trailer(upipe_avfsink->context);
-            if (!(upipe_avfsink->context->oformat->flags & AVFMT_NOFILE))
-                avio_close(upipe_avfsink->context->pb);
+            upipe_avfsink_avio_close(upipe);
         }
         avformat_free_context(upipe_avfsink->context);
     }
@@ -1254,6 +1532,7 @@ static int upipe_avfsink_set_uri(struct upipe *upipe, const char *uri)
 
     upipe_avfsink->uri = strdup(uri);
     upipe_avfsink->opened = false;
+    upipe_avfsink->step = UPIPE_AVFSINK_STEP_PREROLL;
     upipe_avfsink_sync_lost(upipe);
     upipe_notice_va(upipe, "opening URI %s", upipe_avfsink->uri);
     return UBASE_ERR_NONE;
@@ -1354,6 +1633,29 @@ static int _upipe_avfsink_set_metadata(struct upipe *upipe,
     return UBASE_ERR_NONE;
 }
 
+/** @internal @This sets the size of the write-behind buffer of the I/O
+ * thread. It only takes effect when the URL is opened.
+ *
+ * @param upipe description structure of the pipe
+ * @param size size of the write-behind buffer in octets, or 0
+ * @return an error code
+ */
+static int _upipe_avfsink_set_async(struct upipe *upipe, uint64_t size)
+{
+    struct upipe_avfsink *upipe_avfsink = upipe_avfsink_from_upipe(upipe);
+#ifdef UPIPE_HAVE_PTHREAD
+    upipe_avfsink->async_size = size;
+    return UBASE_ERR_NONE;
+#else
+    if (size) {
+        upipe_err(upipe, "I/O thread not supported");
+        return UBASE_ERR_INVALID;
+    }
+    upipe_avfsink->async_size = 0;
+    return UBASE_ERR_NONE;
+#endif
+}
+
 /** @internal @This processes control commands on an avformat source pipe.
  *
  * @param upipe description structure of the pipe
@@ -1366,6 +1668,9 @@ static int upipe_avfsink_control(struct upipe *upipe, int command, va_list args)
     UBASE_HANDLED_RETURN(upipe_avfsink_control_subs(upipe, command, args));
 
     switch (command) {
+        case UPIPE_ATTACH_UPUMP_MGR:
+            upipe_avfsink_set_upump_avio(upipe, NULL);
+            return upipe_avfsink_attach_upump_mgr(upipe);
         case UPIPE_REGISTER_REQUEST:
         case UPIPE_UNREGISTER_REQUEST:
             return upipe_control_provide_request(upipe, command, args);
@@ -1440,6 +1745,17 @@ static int upipe_avfsink_control(struct upipe *upipe, int command, va_list args)
             const char *value = va_arg(args, const char *);
             return _upipe_avfsink_set_metadata(upipe, key, value);
         }
+        case UPIPE_AVFSINK_SET_ASYNC: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_AVFSINK_SIGNATURE)
+            uint64_t size = va_arg(args, uint64_t);
+            return _upipe_avfsink_set_async(upipe, size);
+        }
+        case UPIPE_AVFSINK_GET_ASYNC: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_AVFSINK_SIGNATURE)
+            uint64_t *p = va_arg(args, uint64_t *);
+            *p = upipe_avfsink_from_upipe(upipe)->async_size;
+            return UBASE_ERR_NONE;
+        }
 
         case UPIPE_GET_URI: {
             const char **uri_p = va_arg(args, const char **);
@@ -1465,6 +1781,9 @@ static void upipe_avfsink_free(struct upipe *upipe)
 
     upipe_avfsink_set_uri(upipe, NULL);
     upipe_avfsink_set_init_uri(upipe, NULL);
+#ifdef UPIPE_HAVE_PTHREAD
+    upipe_avfsink_avio_stop(upipe);
+#endif
     upipe_throw_dead(upipe);
 
     free(upipe_avfsink->mime);
@@ -1472,6 +1791,8 @@ static void upipe_avfsink_free(struct upipe *upipe)
 
     av_dict_free(&upipe_avfsink->options);
 
+    upipe_avfsink_clean_upump_avio(upipe);
+    upipe_avfsink_clean_upump_mgr(upipe);
     upipe_avfsink_clean_sync(upipe);
     upipe_avfsink_clean_urefcount(upipe);
     upipe_avfsink_free_void(upipe);
@@ -11,6 +11,7 @@
  * @short Upipe source module libavformat wrapper
  */
 
+#include "upipe/config.h"
 #include "upipe/ulist.h"
 #include "upipe/uprobe.h"
 #include "upipe/uprobe_prefix.h"
@@ -43,6 +44,7 @@
 #include "upipe-av/upipe_avformat_source.h"
 
 #include "upipe_av_internal.h"
+#include "upipe_av_demux.h"
 
 #include <stdlib.h>
 #include <stdbool.h>
@@ -106,6 +108,8 @@ struct upipe_avfsrc {
     struct upump_mgr *upump_mgr;
     /** read watcher */
     struct upump *upump;
+    /** I/O thread watcher */
+    struct upump *upump_demux;
     /** offset between libavformat timestamps and Upipe timestamps */
     int64_t timestamp_offset;
     /** highest Upipe timestamp given to a frame */
@@ -126,10 +130,21 @@ struct upipe_avfsrc {
 
     /** avformat options */
     AVDictionary *options;
-    /** avformat context opened from URL */
+    /** avformat context opened from URL; when it belongs to the I/O thread,
+     * it is only dereferenced until the streams are probed */
     AVFormatContext *context;
+    /** true if the URL supports seeking */
+    bool seekable;
     /** true if the URL has already been probed by avformat */
     bool probed;
+    /** number of streams at probing time */
+    unsigned int nb_streams;
+    /** size of the read-ahead buffer of the I/O thread, or 0 */
+    uint64_t async_size;
+#ifdef UPIPE_HAVE_PTHREAD
+    /** threaded demuxer, or NULL */
+    struct upipe_av_demux *demux;
+#endif
 
     /** manager to create subs */
     struct upipe_mgr sub_mgr;
@@ -153,6 +168,7 @@ UPIPE_HELPER_UCLOCK(upipe_avfsrc, uclock, uclock_request, NULL,
 
 UPIPE_HELPER_UPUMP_MGR(upipe_avfsrc, upump_mgr)
 UPIPE_HELPER_UPUMP(upipe_avfsrc, upump, upump_mgr)
+UPIPE_HELPER_UPUMP(upipe_avfsrc, upump_demux, upump_mgr)
 UPIPE_HELPER_SYNC(upipe_avfsrc, probed)
 
 UBASE_FROM_TO(upipe_avfsrc, urefcount, urefcount_real, urefcount_real)
@@ -276,8 +292,7 @@ static struct upipe *upipe_avfsrc_sub_alloc(struct upipe_mgr *mgr,
     }
 
     /* select the stream */
-    if (upipe_avfsrc->context == NULL ||
-        id >= upipe_avfsrc->context->nb_streams) {
+    if (upipe_avfsrc->context == NULL || id >= upipe_avfsrc->nb_streams) {
         upipe_warn_va(upipe, "ID %"PRIu64" doesn't exist", id);
         upipe_release(upipe);
         return NULL;
@@ -469,6 +484,7 @@ static struct upipe *upipe_avfsrc_alloc(struct upipe_mgr *mgr,
     upipe_avfsrc_init_uref_mgr(upipe);
     upipe_avfsrc_init_upump_mgr(upipe);
     upipe_avfsrc_init_upump(upipe);
+    upipe_avfsrc_init_upump_demux(upipe);
     upipe_avfsrc_init_uclock(upipe);
     upipe_avfsrc_init_sync(upipe);
     upipe_avfsrc->timestamp_offset = 0;
@@ -479,6 +495,12 @@ static struct upipe *upipe_avfsrc_alloc(struct upipe_mgr *mgr,
     upipe_avfsrc->url = NULL;
     upipe_avfsrc->options = NULL;
     upipe_avfsrc->context = NULL;
+    upipe_avfsrc->seekable = false;
+    upipe_avfsrc->nb_streams = 0;
+    upipe_avfsrc->async_size = 0;
+#ifdef UPIPE_HAVE_PTHREAD
+    upipe_avfsrc->demux = NULL;
+#endif
 
     upipe_throw_ready(upipe);
     return upipe;
@@ -504,6 +526,8 @@ static struct upipe_avfsrc_sub *upipe_avfsrc_find_output(struct upipe *upipe,
 }
 
 /** @internal @This updates the stream used as clock reference for dejittering.
+ * The media types are taken from the flow definitions built when probing,
+ * since the streams of the avformat context may belong to the I/O thread.
  *
  * @param upipe description structure of the pipe
  */
@@ -519,8 +543,15 @@ static void upipe_avfsrc_update_cr(struct upipe *upipe)
         struct upipe_avfsrc_sub *output =
             upipe_avfsrc_sub_from_uchain(uchain);
 
-        AVStream *stream = upipe_avfsrc->context->streams[output->id];
-        enum AVMediaType current_type = stream->codecpar->codec_type;
+        struct uref *flow_def = upipe_avfsrc->streams[output->id];
+        const char *def = "";
+        if (flow_def != NULL)
+            uref_flow_get_def(flow_def, &def);
+        enum AVMediaType current_type = AVMEDIA_TYPE_DATA;
+        if (strstr(def, "pic.") != NULL)
+            current_type = AVMEDIA_TYPE_VIDEO;
+        else if (strstr(def, "sound.") != NULL)
+            current_type = AVMEDIA_TYPE_AUDIO;
 
         switch (current_type) {
             case AVMEDIA_TYPE_VIDEO:
@@ -709,7 +740,8 @@ static struct uref *alloc_data_def(struct upipe *upipe,
     return NULL;
 }
 
-/** @internal @This probes all flows from the source.
+/** @internal @This probes all flows from the source. The I/O thread has
+ * already found the stream info if there is one.
  *
  * @param upipe description structure of the pipe
  * @return an error code
@@ -719,32 +751,39 @@ static int upipe_avfsrc_probe(struct upipe *upipe)
     struct upipe_avfsrc *upipe_avfsrc = upipe_avfsrc_from_upipe(upipe);
     AVFormatContext *context = upipe_avfsrc->context;
 
-    unsigned nb_streams = context->nb_streams;
-    int error = 0;
-    if (nb_streams) {
-        AVDictionary *options[nb_streams];
-        for (unsigned i = 0; i < nb_streams; i++) {
-            options[i] = NULL;
-            av_dict_copy(&options[i], upipe_avfsrc->options, 0);
-        }
-        error = avformat_find_stream_info(context, options);
+#ifdef UPIPE_HAVE_PTHREAD
+    if (upipe_avfsrc->demux == NULL)
+#endif
+    {
+        unsigned nb_streams = context->nb_streams;
+        int error = 0;
+        if (nb_streams) {
+            AVDictionary *options[nb_streams];
+            for (unsigned i = 0; i < nb_streams; i++) {
+                options[i] = NULL;
+                av_dict_copy(&options[i], upipe_avfsrc->options, 0);
+            }
+            error = avformat_find_stream_info(context, options);
 
-        for (unsigned i = 0; i < nb_streams; i++)
-            av_dict_free(&options[i]);
-    }
-    else
-        error = avformat_find_stream_info(context, NULL);
+            for (unsigned i = 0; i < nb_streams; i++)
+                av_dict_free(&options[i]);
+        }
+        else
+            error = avformat_find_stream_info(context, NULL);
 
-    if (unlikely(error < 0)) {
-        upipe_err_va(upipe, "can't probe URL %s (%s)", upipe_avfsrc->url,
-                     av_err2str(error));
-        return UBASE_ERR_EXTERNAL;
+        if (unlikely(error < 0)) {
+            upipe_err_va(upipe, "can't probe URL %s (%s)", upipe_avfsrc->url,
+                         av_err2str(error));
+            return UBASE_ERR_EXTERNAL;
+        }
     }
 
     upipe_avfsrc_sync_acquired(upipe);
-    upipe_avfsrc->streams = calloc(context->nb_streams, sizeof(struct uref *));
+    upipe_avfsrc->nb_streams = context->nb_streams;
+    upipe_avfsrc->streams = calloc(upipe_avfsrc->nb_streams,
+                                   sizeof(struct uref *));
 
-    for (int i = 0; i < context->nb_streams; i++) {
+    for (unsigned i = 0; i < upipe_avfsrc->nb_streams; i++) {
         AVStream *stream = context->streams[i];
         AVCodecParameters *codecpar = stream->codecpar;
         struct uref *flow_def;
@@ -812,17 +851,31 @@ static void upipe_avfsrc_close(struct upipe *upipe)
     AVFormatContext *context = upipe_avfsrc->context;
 
     upipe_avfsrc->context = NULL;
+    upipe_avfsrc->seekable = false;
     if (unlikely(context != NULL)) {
         if (likely(upipe_avfsrc->url != NULL))
             upipe_notice_va(upipe, "closing URL %s", upipe_avfsrc->url);
-        for (int i = 0; i < context->nb_streams; i++)
+        for (unsigned i = 0; i < upipe_avfsrc->nb_streams; i++)
             uref_free(upipe_avfsrc->streams[i]);
-        avformat_close_input(&context);
+        upipe_avfsrc->nb_streams = 0;
+#ifdef UPIPE_HAVE_PTHREAD
+        /* the context of the I/O thread is closed by the thread */
+        if (upipe_avfsrc->demux == NULL)
+#endif
+            avformat_close_input(&context);
         upipe_avfsrc_set_upump(upipe, NULL);
         upipe_avfsrc_throw_sub_subs(upipe, UPROBE_SOURCE_END);
         free(upipe_avfsrc->streams);
         upipe_avfsrc->streams = NULL;
     }
+#ifdef UPIPE_HAVE_PTHREAD
+    if (upipe_avfsrc->demux != NULL) {
+        upipe_avfsrc_set_upump(upipe, NULL);
+        upipe_avfsrc_set_upump_demux(upipe, NULL);
+        upipe_av_demux_free(upipe_avfsrc->demux);
+        upipe_avfsrc->demux = NULL;
+    }
+#endif
     ubase_clean_str(&upipe_avfsrc->url);
     bool acquired = upipe_avfsrc->probed;
     upipe_avfsrc_sync_lost(upipe);
@@ -830,6 +883,22 @@ static void upipe_avfsrc_close(struct upipe *upipe)
         upipe_split_throw_update(upipe);
 }
 
+#ifdef UPIPE_HAVE_PTHREAD
+/** @internal @This is called when the I/O thread has probed the URL or
+ * queued packets.
+ *
+ * @param upump description structure of the watcher
+ */
+static void upipe_avfsrc_demux_worker(struct upump *upump)
+{
+    struct upipe *upipe = upump_get_opaque(upump, struct upipe *);
+    struct upipe_avfsrc *upipe_avfsrc = upipe_avfsrc_from_upipe(upipe);
+    upipe_av_demux_ack(upipe_avfsrc->demux);
+    if (upipe_avfsrc->upump != NULL)
+        upump_start(upipe_avfsrc->upump);
+}
+#endif
+
 /** @internal @This reads data from the source and outputs it.
  * It is called either when the idler triggers (permanent storage mode) or
  * when data is available on the file descriptor (live stream mode).
@@ -842,21 +911,67 @@ static void upipe_avfsrc_worker(struct upump *upump)
     struct upipe_avfsrc *upipe_avfsrc = upipe_avfsrc_from_upipe(upipe);
     AVPacket pkt;
 
+#ifdef UPIPE_HAVE_PTHREAD
+    if (upipe_avfsrc->demux != NULL && upipe_avfsrc->context == NULL) {
+        AVFormatContext *context;
+        int error = upipe_av_demux_context(upipe_avfsrc->demux, &context);
+        if (error == AVERROR(EAGAIN)) {
+            /* wait for the I/O thread */
+            upump_stop(upump);
+            return;
+        }
+        if (unlikely(error < 0)) {
+            upipe_err_va(upipe, "can't open URL %s (%s)", upipe_avfsrc->url,
+                         av_err2str(error));
+            upipe_avfsrc_close(upipe);
+            return;
+        }
+        upipe_avfsrc->context = context;
+        upipe_avfsrc->seekable = context->pb != NULL &&
+            (context->pb->seekable & AVIO_SEEKABLE_NORMAL);
+    }
+#endif
+
     if (unlikely(!upipe_avfsrc->probed)) {
         if (unlikely(!ubase_check(upipe_avfsrc_probe(upipe)))) {
             upipe_warn_va(upipe, "fail to probe %s", upipe_avfsrc->url);
             upipe_avfsrc_close(upipe);
             return;
         }
+#ifdef UPIPE_HAVE_PTHREAD
+        /* the context now belongs to the I/O thread */
+        if (upipe_avfsrc->demux != NULL)
+            upipe_av_demux_start(upipe_avfsrc->demux);
+#endif
     }
 
-    int error = av_read_frame(upipe_avfsrc->context, &pkt);
+    int error;
+#ifdef UPIPE_HAVE_PTHREAD
+    if (upipe_avfsrc->demux != NULL) {
+        error = upipe_av_demux_read(upipe_avfsrc->demux, &pkt);
+        if (error == AVERROR(EAGAIN)) {
+            /* wait for the I/O thread */
+            upump_stop(upump);
+            return;
+        }
+    } else
+#endif
+    {
+        /* the context belongs to the event loop */
+        error = av_read_frame(upipe_avfsrc->context, &pkt);
+        if (likely(error >= 0))
+            pkt.time_base =
+                upipe_avfsrc->context->streams[pkt.stream_index]->time_base;
+    }
     if (unlikely(error < 0)) {
         if (error != AVERROR_EOF) {
             upipe_err_va(upipe, "read error from %s (%s)",
                          upipe_avfsrc->url, av_err2str(error));
         }
         upipe_avfsrc_set_upump(upipe, NULL);
+#ifdef UPIPE_HAVE_PTHREAD
+        upipe_avfsrc_set_upump_demux(upipe, NULL);
+#endif
         upipe_throw_source_end(upipe);
         return;
     }
@@ -885,7 +1000,6 @@ static void upipe_avfsrc_worker(struct upump *upump)
     if (upipe_avfsrc->cr_id == UINT64_MAX)
         upipe_avfsrc_update_cr(upipe);
 
-    AVStream *stream = upipe_avfsrc->context->streams[pkt.stream_index];
     uint64_t systime = upipe_avfsrc->uclock != NULL ?
                        uclock_now(upipe_avfsrc->uclock) : UINT64_MAX;
     uint8_t *buffer;
@@ -908,7 +1022,7 @@ static void upipe_avfsrc_worker(struct upump *upump)
         upipe_avfsrc->systime_rap = systime;
     }
 
-    av_packet_rescale_ts(&pkt, stream->time_base, UCLOCK_TIME_BASE);
+    av_packet_rescale_ts(&pkt, pkt.time_base, UCLOCK_TIME_BASE);
 
     uint64_t dts_orig = UINT64_MAX, dts_pts_delay = 0;
     if (pkt.dts != AV_NOPTS_VALUE) {
@@ -993,7 +1107,7 @@ static int upipe_avfsrc_iterate(struct upipe *upipe, struct uref **p)
         id++;
     }
 
-    while (id < context->nb_streams) {
+    while (id < upipe_avfsrc->nb_streams) {
         struct uref *flow_def = upipe_avfsrc->streams[id];
         if (flow_def) {
             *p = flow_def;
@@ -1088,20 +1202,36 @@ static int upipe_avfsrc_set_uri(struct upipe *upipe, const char *url)
     struct uref *uref = uref_alloc(upipe_avfsrc->uref_mgr);
     upipe_avfsrc_output(upipe, uref, NULL);
 
-    AVDictionary *options = NULL;
-    av_dict_copy(&options, upipe_avfsrc->options, 0);
-    int error = avformat_open_input(&upipe_avfsrc->context, url, NULL,
-                                    &options);
-    av_dict_free(&options);
-    if (unlikely(error < 0)) {
-        upipe_err_va(upipe, "can't open URL %s (%s)", url, av_err2str(error));
-        return UBASE_ERR_EXTERNAL;
-    }
+#ifdef UPIPE_HAVE_PTHREAD
+    if (upipe_avfsrc->async_size) {
+        /* the context is opened and probed by the I/O thread */
+        upipe_avfsrc->demux = upipe_av_demux_alloc(url, upipe_avfsrc->options,
+                                                   upipe_avfsrc->async_size);
+        if (unlikely(upipe_avfsrc->demux == NULL)) {
+            upipe_err_va(upipe, "can't start I/O thread for URL %s", url);
+            return UBASE_ERR_EXTERNAL;
+        }
+    } else
+#endif
+    {
+        AVDictionary *options = NULL;
+        av_dict_copy(&options, upipe_avfsrc->options, 0);
+        int error = avformat_open_input(&upipe_avfsrc->context, url, NULL,
+                                        &options);
+        av_dict_free(&options);
+        if (unlikely(error < 0)) {
+            upipe_err_va(upipe, "can't open URL %s (%s)", url,
+                         av_err2str(error));
+            return UBASE_ERR_EXTERNAL;
+        }
 
 #if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(59, 16, 100)
-    /* Don't merge side data into avpacket data */
-    upipe_avfsrc->context->flags |= AVFMT_FLAG_KEEP_SIDE_DATA;
+        /* Don't merge side data into avpacket data */
+        upipe_avfsrc->context->flags |= AVFMT_FLAG_KEEP_SIDE_DATA;
 #endif
+        upipe_avfsrc->seekable = upipe_avfsrc->context->pb != NULL &&
+            (upipe_avfsrc->context->pb->seekable & AVIO_SEEKABLE_NORMAL);
+    }
     upipe_avfsrc->timestamp_offset = 0;
     upipe_avfsrc->url = strdup(url);
     upipe_avfsrc_sync_lost(upipe);
@@ -1119,8 +1249,7 @@ static int _upipe_avfsrc_get_time(struct upipe *upipe, uint64_t *time_p)
 {
     struct upipe_avfsrc *upipe_avfsrc = upipe_avfsrc_from_upipe(upipe);
     assert(time_p != NULL);
-    if (upipe_avfsrc->context != NULL && upipe_avfsrc->context->pb != NULL &&
-        upipe_avfsrc->context->pb->seekable & AVIO_SEEKABLE_NORMAL) {
+    if (upipe_avfsrc->context != NULL && upipe_avfsrc->seekable) {
         *time_p = 0; /* TODO */
         return UBASE_ERR_NONE;
     }
@@ -1139,6 +1268,29 @@ static int _upipe_avfsrc_set_time(struct upipe *upipe, uint64_t time)
     return UBASE_ERR_UNHANDLED;
 }
 
+/** @internal @This sets the size of the read-ahead buffer of the I/O
+ * thread. It only takes effect after the next call to @ref upipe_set_uri.
+ *
+ * @param upipe description structure of the pipe
+ * @param size size of the read-ahead buffer in octets, or 0
+ * @return an error code
+ */
+static int _upipe_avfsrc_set_async(struct upipe *upipe, uint64_t size)
+{
+    struct upipe_avfsrc *upipe_avfsrc = upipe_avfsrc_from_upipe(upipe);
+#ifdef UPIPE_HAVE_PTHREAD
+    upipe_avfsrc->async_size = size;
+    return UBASE_ERR_NONE;
+#else
+    if (size) {
+        upipe_err(upipe, "I/O thread not supported");
+        return UBASE_ERR_INVALID;
+    }
+    upipe_avfsrc->async_size = 0;
+    return UBASE_ERR_NONE;
+#endif
+}
+
 /** @internal @This processes control commands on an avformat source pipe.
  *
  * @param upipe description structure of the pipe
@@ -1154,6 +1306,7 @@ static int _upipe_avfsrc_control(struct upipe *upipe,
     switch (command) {
         case UPIPE_ATTACH_UPUMP_MGR:
             upipe_avfsrc_set_upump(upipe, NULL);
+            upipe_avfsrc_set_upump_demux(upipe, NULL);
             return upipe_avfsrc_attach_upump_mgr(upipe);
         case UPIPE_ATTACH_UCLOCK:
             upipe_avfsrc_set_upump(upipe, NULL);
@@ -1198,6 +1351,17 @@ static int _upipe_avfsrc_control(struct upipe *upipe,
             uint64_t time = va_arg(args, uint64_t);
             return _upipe_avfsrc_set_time(upipe, time);
         }
+        case UPIPE_AVFSRC_SET_ASYNC: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_AVFSRC_SIGNATURE)
+            uint64_t size = va_arg(args, uint64_t);
+            return _upipe_avfsrc_set_async(upipe, size);
+        }
+        case UPIPE_AVFSRC_GET_ASYNC: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_AVFSRC_SIGNATURE)
+            uint64_t *p = va_arg(args, uint64_t *);
+            *p = upipe_avfsrc_from_upipe(upipe)->async_size;
+            return UBASE_ERR_NONE;
+        }
         default:
             return UBASE_ERR_UNHANDLED;
     }
@@ -1227,6 +1391,23 @@ static int upipe_avfsrc_check(struct upipe *upipe)
         upump_start(upump);
     }
 
+#ifdef UPIPE_HAVE_PTHREAD
+    if (upipe_avfsrc->upump_mgr != NULL && upipe_avfsrc->demux != NULL &&
+        upipe_avfsrc->upump_demux == NULL) {
+        struct upump *upump =
+            upipe_av_demux_upump_alloc(upipe_avfsrc->demux,
+                                       upipe_avfsrc->upump_mgr,
+                                       upipe_avfsrc_demux_worker,
+                                       upipe, upipe->refcount);
+        if (unlikely(upump == NULL)) {
+            upipe_warn(upipe, "fail to allocate I/O watcher");
+            return UBASE_ERR_ALLOC;
+        }
+        upipe_avfsrc_set_upump_demux(upipe, upump);
+        upump_start(upump);
+    }
+#endif
+
     return UBASE_ERR_NONE;
 }
 
@@ -1262,6 +1443,7 @@ static void upipe_avfsrc_free(struct urefcount *urefcount_real)
 
     upipe_avfsrc_clean_sync(upipe);
     upipe_avfsrc_clean_uclock(upipe);
+    upipe_avfsrc_clean_upump_demux(upipe);
     upipe_avfsrc_clean_upump(upipe);
     upipe_avfsrc_clean_upump_mgr(upipe);
     upipe_avfsrc_clean_uref_mgr(upipe);
@@ -530,6 +530,8 @@ static int probe_src(struct uprobe *uprobe, struct upipe *inner,
                              UPROBE_LOG_VERBOSE, "m3u"));
         upipe_mgr_release(upipe_m3u_reader_mgr);
         UBASE_ALLOC_RETURN(output);
+        /* only parse the new segments of the reloaded playlists */
+        upipe_m3u_reader_set_incremental(output, true);
 
         /* playlist pipe
         */
@@ -25,6 +25,8 @@
 #include "upipe/upipe_helper_upipe.h"
 #include "upipe/upipe_helper_upump_mgr.h"
 #include "upipe/upipe_helper_upump.h"
+#include "upipe/upump_blocker.h"
+#include "upipe/upipe_helper_uclock.h"
 #include "upipe/upipe.h"
 
 #include "upipe/uprobe_prefix.h"
@@ -68,6 +70,40 @@ static int upipe_hls_playlist_throw_item_end(struct upipe *upipe)
                        UPIPE_HLS_PLAYLIST_SIGNATURE);
 }
 
+/** @internal @This is the private context of a prefetched item. */
+struct upipe_hls_playlist_segment {
+    /** for the cache list */
+    struct uchain uchain;
+    /** pointer to the playlist pipe */
+    struct upipe *upipe;
+    /** media sequence of the item */
+    uint64_t index;
+    /** uri of the item */
+    char *uri;
+    /** source pipe */
+    struct upipe *src;
+    /** source probe */
+    struct uprobe probe_src;
+    /** probe for the inner probe uref pipe */
+    struct uprobe probe;
+    /** downloaded flow definition and blocks */
+    struct uchain urefs;
+    /** number of octets downloaded and not played yet */
+    uint64_t size;
+    /** buffers of the playing item waiting for room in the cache */
+    struct uchain held;
+    /** blocker of the source while buffers are held */
+    struct upump_blocker *blocker;
+    /** the source has ended */
+    bool done;
+    /** the item was dropped from the cache */
+    bool evicted;
+};
+
+UBASE_FROM_TO(upipe_hls_playlist_segment, uchain, uchain, uchain);
+UBASE_FROM_TO(upipe_hls_playlist_segment, uprobe, probe_src, probe_src);
+UBASE_FROM_TO(upipe_hls_playlist_segment, uprobe, probe, probe);
+
 /** @internal @This is the private context of a m3u playlist pipe. */
 struct upipe_hls_playlist {
     /** for urefcount helper */
@@ -115,6 +151,12 @@ struct upipe_hls_playlist {
     struct upump_mgr *upump_mgr;
     /** timer */
     struct upump *upump;
+    /** pump feeding the output from the cache */
+    struct upump *upump_cache;
+    /** uclock for the statistics */
+    struct uclock *uclock;
+    /** uclock request */
+    struct urequest uclock_request;
 
     /** current index in the playlist */
     uint64_t index;
@@ -138,6 +180,21 @@ struct upipe_hls_playlist {
     bool attach_uclock;
     /** is currently playing */
     bool playing;
+
+    /** number of items to prefetch */
+    unsigned int prefetch;
+    /** maximum size of the cache */
+    uint64_t cache_max_size;
+    /** current size of the cache */
+    uint64_t cache_size;
+    /** list of prefetched items */
+    struct uchain cache;
+    /** item being played from the cache */
+    struct upipe_hls_playlist_segment *current;
+    /** date the playback started waiting for data, or UINT64_MAX */
+    uint64_t stall_start;
+    /** prefetch statistics */
+    struct upipe_hls_playlist_stats stats;
 };
 
 static int probe_key_src(struct uprobe *uprobe, struct upipe *inner,
@@ -150,6 +207,10 @@ static int probe_map(struct uprobe *uprobe, struct upipe *inner,
                      int event, va_list args);
 static int probe_src(struct uprobe *uprobe, struct upipe *inner,
                      int event, va_list args);
+/** @hidden */
+static void upipe_hls_playlist_cache_flush(struct upipe *upipe);
+/** @hidden */
+static void upipe_hls_playlist_prefetch(struct upipe *upipe);
 
 UPIPE_HELPER_UPIPE(upipe_hls_playlist, upipe, UPIPE_HLS_PLAYLIST_SIGNATURE);
 UPIPE_HELPER_UREFCOUNT(upipe_hls_playlist, urefcount, upipe_hls_playlist_no_ref);
@@ -171,6 +232,9 @@ UPIPE_HELPER_UPROBE(upipe_hls_playlist, urefcount_real, probe_setflowdef, NULL);
 UPIPE_HELPER_BIN_OUTPUT(upipe_hls_playlist, setflowdef, output, requests);
 UPIPE_HELPER_UPUMP_MGR(upipe_hls_playlist, upump_mgr);
 UPIPE_HELPER_UPUMP(upipe_hls_playlist, upump, upump_mgr);
+UPIPE_HELPER_UPUMP(upipe_hls_playlist, upump_cache, upump_mgr);
+UPIPE_HELPER_UCLOCK(upipe_hls_playlist, uclock, uclock_request, NULL,
+                    upipe_throw_provide_request, NULL);
 
 /** @internal @This catches the inner key source pipe event.
  *
@@ -360,6 +424,8 @@ static struct upipe *upipe_hls_playlist_alloc(struct upipe_mgr *mgr,
     upipe_hls_playlist_init_bin_output(upipe);
     upipe_hls_playlist_init_upump_mgr(upipe);
     upipe_hls_playlist_init_upump(upipe);
+    upipe_hls_playlist_init_upump_cache(upipe);
+    upipe_hls_playlist_init_uclock(upipe);
 
     struct upipe_hls_playlist *upipe_hls_playlist =
         upipe_hls_playlist_from_upipe(upipe);
@@ -378,6 +444,13 @@ static struct upipe *upipe_hls_playlist_alloc(struct upipe_mgr *mgr,
     upipe_hls_playlist->map.flow_def = NULL;
     upipe_hls_playlist->attach_uclock = false;
     upipe_hls_playlist->playing = false;
+    upipe_hls_playlist->prefetch = 0;
+    upipe_hls_playlist->cache_max_size = 0;
+    upipe_hls_playlist->cache_size = 0;
+    ulist_init(&upipe_hls_playlist->cache);
+    upipe_hls_playlist->current = NULL;
+    upipe_hls_playlist->stall_start = UINT64_MAX;
+    memset(&upipe_hls_playlist->stats, 0, sizeof (upipe_hls_playlist->stats));
 
     upipe_throw_ready(upipe);
 
@@ -448,8 +521,10 @@ static void upipe_hls_playlist_free(struct upipe *upipe)
         uref_free(upipe_hls_playlist->map.flow_def);
     uref_free(upipe_hls_playlist->flow_def);
     uref_free(upipe_hls_playlist->input_flow_def);
+    upipe_hls_playlist_clean_upump_cache(upipe);
     upipe_hls_playlist_clean_upump(upipe);
     upipe_hls_playlist_clean_upump_mgr(upipe);
+    upipe_hls_playlist_clean_uclock(upipe);
     upipe_hls_playlist_clean_bin_output(upipe);
     upipe_hls_playlist_flush(upipe);
     upipe_hls_playlist_clean_probe_src(upipe);
@@ -474,6 +549,7 @@ static void upipe_hls_playlist_no_ref(struct upipe *upipe)
 
     upipe_hls_playlist_clean_upipe_map(upipe);
     upipe_hls_playlist_clean_upipe_key(upipe);
+    upipe_hls_playlist_cache_flush(upipe);
     upipe_hls_playlist_clean_setflowdef(upipe);
     upipe_hls_playlist_clean_src(upipe);
     upipe_mgr_release(upipe_hls_playlist->source_mgr);
@@ -761,26 +837,614 @@ static void upipe_hls_playlist_need_reload(struct upipe *upipe)
     UBASE_FATAL(upipe, upipe_hls_playlist_throw_need_reload(upipe));
 }
 
+/** @internal @This frees the downloaded data of a prefetched item.
+ *
+ * @param upipe description structure of the pipe
+ * @param segment prefetched item
+ */
+static void upipe_hls_playlist_segment_flush(
+    struct upipe *upipe,
+    struct upipe_hls_playlist_segment *segment)
+{
+    struct upipe_hls_playlist *upipe_hls_playlist =
+        upipe_hls_playlist_from_upipe(upipe);
+    struct uchain *uchain;
+
+    while ((uchain = ulist_pop(&segment->urefs)) != NULL)
+        uref_free(uref_from_uchain(uchain));
+    while ((uchain = ulist_pop(&segment->held)) != NULL)
+        uref_free(uref_from_uchain(uchain));
+    if (segment->blocker != NULL) {
+        upump_blocker_free(segment->blocker);
+        segment->blocker = NULL;
+    }
+    upipe_hls_playlist->cache_size -= segment->size;
+    segment->size = 0;
+}
+
+/** @internal @This frees a prefetched item. It must not be called from the
+ * probes of the item.
+ *
+ * @param upipe description structure of the pipe
+ * @param segment prefetched item
+ */
+static void upipe_hls_playlist_segment_free(
+    struct upipe *upipe,
+    struct upipe_hls_playlist_segment *segment)
+{
+    struct upipe_hls_playlist *upipe_hls_playlist =
+        upipe_hls_playlist_from_upipe(upipe);
+
+    if (upipe_hls_playlist->current == segment)
+        upipe_hls_playlist->current = NULL;
+    ulist_delete(upipe_hls_playlist_segment_to_uchain(segment));
+    upipe_hls_playlist_segment_flush(upipe, segment);
+    upipe_release(segment->src);
+    uprobe_clean(&segment->probe);
+    uprobe_clean(&segment->probe_src);
+    free(segment->uri);
+    free(segment);
+}
+
+/** @internal @This drops a prefetched item before it is played.
+ *
+ * @param upipe description structure of the pipe
+ * @param segment prefetched item
+ */
+static void upipe_hls_playlist_segment_evict(
+    struct upipe *upipe,
+    struct upipe_hls_playlist_segment *segment)
+{
+    struct upipe_hls_playlist *upipe_hls_playlist =
+        upipe_hls_playlist_from_upipe(upipe);
+
+    upipe_verbose_va(upipe, "evict item %"PRIu64, segment->index);
+    upipe_hls_playlist->stats.evictions++;
+    upipe_hls_playlist_segment_free(upipe, segment);
+}
+
+/** @internal @This looks for a prefetched item.
+ *
+ * @param upipe description structure of the pipe
+ * @param index media sequence of the item
+ * @return the prefetched item or NULL
+ */
+static struct upipe_hls_playlist_segment *
+upipe_hls_playlist_segment_find(struct upipe *upipe, uint64_t index)
+{
+    struct upipe_hls_playlist *upipe_hls_playlist =
+        upipe_hls_playlist_from_upipe(upipe);
+    struct uchain *uchain;
+
+    ulist_foreach(&upipe_hls_playlist->cache, uchain) {
+        struct upipe_hls_playlist_segment *segment =
+            upipe_hls_playlist_segment_from_uchain(uchain);
+        if (segment->index == index && !segment->evicted)
+            return segment;
+    }
+    return NULL;
+}
+
+/** @internal @This drops all the prefetched items.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_hls_playlist_cache_flush(struct upipe *upipe)
+{
+    struct upipe_hls_playlist *upipe_hls_playlist =
+        upipe_hls_playlist_from_upipe(upipe);
+    struct uchain *uchain;
+
+    upipe_hls_playlist_set_upump_cache(upipe, NULL);
+    while ((uchain = ulist_peek(&upipe_hls_playlist->cache)) != NULL)
+        upipe_hls_playlist_segment_free(
+            upipe, upipe_hls_playlist_segment_from_uchain(uchain));
+    upipe_hls_playlist->stall_start = UINT64_MAX;
+}
+
+/** @internal @This makes room in the cache for new data of an item,
+ * dropping the farthest prefetched items if needed. The playing item counts
+ * against the cache size but is never dropped. A buffer larger than the
+ * cache is still accepted for the playing item if none of its data is
+ * cached.
+ *
+ * @param upipe description structure of the pipe
+ * @param segment item receiving data
+ * @param size size of the new data
+ * @return false if there is no room for the data
+ */
+static bool upipe_hls_playlist_cache_reserve(
+    struct upipe *upipe,
+    struct upipe_hls_playlist_segment *segment,
+    uint64_t size)
+{
+    struct upipe_hls_playlist *upipe_hls_playlist =
+        upipe_hls_playlist_from_upipe(upipe);
+
+    while (upipe_hls_playlist->cache_size + size >
+           upipe_hls_playlist->cache_max_size) {
+        struct upipe_hls_playlist_segment *farthest = NULL;
+        struct uchain *uchain;
+        ulist_foreach(&upipe_hls_playlist->cache, uchain) {
+            struct upipe_hls_playlist_segment *tmp =
+                upipe_hls_playlist_segment_from_uchain(uchain);
+            if (tmp == upipe_hls_playlist->current || tmp->evicted)
+                continue;
+            if (farthest == NULL || tmp->index > farthest->index)
+                farthest = tmp;
+        }
+        if (farthest == NULL || farthest == segment)
+            return segment == upipe_hls_playlist->current && !segment->size;
+        upipe_hls_playlist_segment_evict(upipe, farthest);
+    }
+    return true;
+}
+
+/** @internal @This is called when the blocked source pump of the playing
+ * item is freed.
+ *
+ * @param blocker description structure of the blocker
+ */
+static void upipe_hls_playlist_segment_blocker_cb(
+    struct upump_blocker *blocker)
+{
+    struct upipe_hls_playlist_segment *segment =
+        upump_blocker_get_opaque(blocker,
+                                 struct upipe_hls_playlist_segment *);
+    segment->blocker = NULL;
+    upump_blocker_free(blocker);
+}
+
+/** @internal @This holds a buffer of the playing item out of the cache,
+ * and blocks its source until there is room again.
+ *
+ * @param upipe description structure of the pipe
+ * @param segment playing item
+ * @param uref buffer to hold
+ * @param upump_p reference to the pump that generated the buffer
+ */
+static void upipe_hls_playlist_segment_hold(
+    struct upipe *upipe,
+    struct upipe_hls_playlist_segment *segment,
+    struct uref *uref, struct upump **upump_p)
+{
+    ulist_add(&segment->held, uref_to_uchain(uref));
+    if (segment->blocker != NULL || upump_p == NULL || *upump_p == NULL)
+        return;
+
+    upipe_verbose_va(upipe, "cache full, blocking item %"PRIu64,
+                     segment->index);
+    segment->blocker = upump_blocker_alloc(
+        *upump_p, upipe_hls_playlist_segment_blocker_cb, segment);
+    if (unlikely(segment->blocker == NULL))
+        upipe_warn_va(upipe, "unable to block item %"PRIu64,
+                      segment->index);
+}
+
+/** @internal @This moves the held buffers of the playing item to the cache
+ * as long as there is room, and unblocks its source once all of them are
+ * moved.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_hls_playlist_cache_drain(struct upipe *upipe)
+{
+    struct upipe_hls_playlist *upipe_hls_playlist =
+        upipe_hls_playlist_from_upipe(upipe);
+    struct upipe_hls_playlist_segment *segment = upipe_hls_playlist->current;
+    struct uchain *uchain;
+
+    while ((uchain = ulist_peek(&segment->held)) != NULL) {
+        size_t size = 0;
+        uref_block_size(uref_from_uchain(uchain), &size);
+        if (!upipe_hls_playlist_cache_reserve(upipe, segment, size))
+            return;
+        ulist_delete(uchain);
+        ulist_add(&segment->urefs, uchain);
+        segment->size += size;
+        upipe_hls_playlist->cache_size += size;
+    }
+
+    if (segment->blocker != NULL) {
+        upipe_verbose_va(upipe, "unblocking item %"PRIu64, segment->index);
+        upump_blocker_free(segment->blocker);
+        segment->blocker = NULL;
+    }
+}
+
+/** @internal @This outputs the next buffer of the playing item from the
+ * cache.
+ *
+ * @param upump description structure of the pump
+ */
+static void upipe_hls_playlist_worker(struct upump *upump)
+{
+    struct upipe *upipe = upump_get_opaque(upump, struct upipe *);
+    struct upipe_hls_playlist *upipe_hls_playlist =
+        upipe_hls_playlist_from_upipe(upipe);
+    struct uchain *uchain, *uchain_tmp;
+
+    ulist_delete_foreach(&upipe_hls_playlist->cache, uchain, uchain_tmp) {
+        struct upipe_hls_playlist_segment *segment =
+            upipe_hls_playlist_segment_from_uchain(uchain);
+        if (segment->evicted)
+            upipe_hls_playlist_segment_free(upipe, segment);
+    }
+
+    struct upipe_hls_playlist_segment *segment = upipe_hls_playlist->current;
+    if (unlikely(segment == NULL)) {
+        upipe_hls_playlist_set_upump_cache(upipe, NULL);
+        return;
+    }
+
+    upipe_hls_playlist_cache_drain(upipe);
+    uchain = ulist_pop(&segment->urefs);
+    if (uchain == NULL) {
+        upipe_hls_playlist_set_upump_cache(upipe, NULL);
+        if (!segment->done) {
+            if (upipe_hls_playlist->stall_start == UINT64_MAX) {
+                upipe_verbose_va(upipe, "waiting for item %"PRIu64,
+                                 segment->index);
+                upipe_hls_playlist->stats.stalls++;
+                upipe_hls_playlist->stall_start =
+                    upipe_hls_playlist_now(upipe);
+            }
+            return;
+        }
+
+        upipe_hls_playlist_segment_free(upipe, segment);
+        upipe_dbg(upipe, "stopped");
+        upipe_hls_playlist->playing = false;
+        upipe_hls_playlist_throw_item_end(upipe);
+        return;
+    }
+
+    if (upipe_hls_playlist->stall_start != UINT64_MAX) {
+        uint64_t now = upipe_hls_playlist_now(upipe);
+        if (now != UINT64_MAX && now > upipe_hls_playlist->stall_start)
+            upipe_hls_playlist->stats.stall_time +=
+                now - upipe_hls_playlist->stall_start;
+        upipe_hls_playlist->stall_start = UINT64_MAX;
+    }
+
+    struct uref *uref = uref_from_uchain(uchain);
+    struct upipe *output = upipe_hls_playlist->setflowdef;
+    if (unlikely(ubase_check(uref_flow_get_def(uref, NULL)))) {
+        if (output)
+            upipe_set_flow_def(output, uref);
+        uref_free(uref);
+        return;
+    }
+
+    size_t size = 0;
+    uref_block_size(uref, &size);
+    segment->size -= size;
+    upipe_hls_playlist->cache_size -= size;
+    if (output)
+        upipe_input(output, uref, &upipe_hls_playlist->upump_cache);
+    else
+        uref_free(uref);
+}
+
+/** @internal @This starts the pump feeding the output from the cache, if it
+ * is not already running.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_hls_playlist_wake(struct upipe *upipe)
+{
+    struct upipe_hls_playlist *upipe_hls_playlist =
+        upipe_hls_playlist_from_upipe(upipe);
+
+    if (upipe_hls_playlist->upump_cache != NULL)
+        return;
+
+    upipe_hls_playlist_check_upump_mgr(upipe);
+    if (unlikely(upipe_hls_playlist->upump_mgr == NULL))
+        return;
+
+    struct upump *upump = upump_alloc_idler(upipe_hls_playlist->upump_mgr,
+                                            upipe_hls_playlist_worker,
+                                            upipe, upipe->refcount);
+    if (unlikely(upump == NULL)) {
+        upipe_throw_fatal(upipe, UBASE_ERR_UPUMP);
+        return;
+    }
+    upipe_hls_playlist_set_upump_cache(upipe, upump);
+    upump_start(upump);
+}
+
+/** @internal @This catches the events of the inner source pipe of a
+ * prefetched item.
+ *
+ * @param uprobe structure used to raise events
+ * @param inner the inner pipe
+ * @param event event thrown
+ * @param args optional arguments
+ * @return an error code
+ */
+static int probe_segment_src(struct uprobe *uprobe, struct upipe *inner,
+                             int event, va_list args)
+{
+    struct upipe_hls_playlist_segment *segment =
+        upipe_hls_playlist_segment_from_probe_src(uprobe);
+    struct upipe *upipe = segment->upipe;
+    struct upipe_hls_playlist *upipe_hls_playlist =
+        upipe_hls_playlist_from_upipe(upipe);
+
+    switch (event) {
+    case UPROBE_SOURCE_END:
+        upipe_verbose_va(upipe, "item %"PRIu64" downloaded", segment->index);
+        segment->done = true;
+        if (segment == upipe_hls_playlist->current)
+            upipe_hls_playlist_wake(upipe);
+        return UBASE_ERR_NONE;
+    }
+    return upipe_throw_proxy(upipe, inner, event, args);
+}
+
+/** @internal @This catches the events of the inner probe uref pipe of a
+ * prefetched item.
+ *
+ * @param uprobe structure used to raise events
+ * @param inner the inner pipe
+ * @param event event thrown
+ * @param args optional arguments
+ * @return an error code
+ */
+static int probe_segment(struct uprobe *uprobe, struct upipe *inner,
+                         int event, va_list args)
+{
+    struct upipe_hls_playlist_segment *segment =
+        upipe_hls_playlist_segment_from_probe(uprobe);
+    struct upipe *upipe = segment->upipe;
+    struct upipe_hls_playlist *upipe_hls_playlist =
+        upipe_hls_playlist_from_upipe(upipe);
+    struct uref *uref;
+
+    switch (event) {
+    case UPROBE_PROBE_UREF: {
+        UBASE_SIGNATURE_CHECK(args, UPIPE_PROBE_UREF_SIGNATURE);
+        uref = va_arg(args, struct uref *);
+        struct upump **upump_p = va_arg(args, struct upump **);
+        bool *drop = va_arg(args, bool *);
+        *drop = true;
+        if (unlikely(segment->evicted))
+            return UBASE_ERR_NONE;
+
+        size_t size = 0;
+        uref_block_size(uref, &size);
+        if (!ulist_empty(&segment->held) ||
+            !upipe_hls_playlist_cache_reserve(upipe, segment, size)) {
+            if (segment == upipe_hls_playlist->current) {
+                uref = uref_dup(uref);
+                UBASE_ALLOC_RETURN(uref);
+                upipe_hls_playlist_segment_hold(upipe, segment, uref,
+                                                upump_p);
+                return UBASE_ERR_NONE;
+            }
+
+            /* the source is released later, out of its own callbacks */
+            upipe_verbose_va(upipe, "evict item %"PRIu64, segment->index);
+            upipe_hls_playlist->stats.evictions++;
+            upipe_hls_playlist_segment_flush(upipe, segment);
+            segment->evicted = true;
+            upipe_hls_playlist_wake(upipe);
+            return UBASE_ERR_NONE;
+        }
+
+        uref = uref_dup(uref);
+        UBASE_ALLOC_RETURN(uref);
+        segment->size += size;
+        upipe_hls_playlist->cache_size += size;
+        break;
+    }
+    case UPROBE_NEW_FLOW_DEF:
+        uref = uref_dup(va_arg(args, struct uref *));
+        UBASE_ALLOC_RETURN(uref);
+        if (!ulist_empty(&segment->held)) {
+            upipe_hls_playlist_segment_hold(upipe, segment, uref, NULL);
+            return UBASE_ERR_NONE;
+        }
+        break;
+    case UPROBE_NEED_OUTPUT:
+        return UBASE_ERR_INVALID;
+    default:
+        return upipe_throw_proxy(upipe, inner, event, args);
+    }
+
+    ulist_add(&segment->urefs, uref_to_uchain(uref));
+    if (segment == upipe_hls_playlist->current)
+        upipe_hls_playlist_wake(upipe);
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This starts downloading an item into the cache.
+ *
+ * @param upipe description structure of the pipe
+ * @param index media sequence of the item
+ * @param item item to download
+ * @param uri uri of the item
+ * @param segment_p filled with the new prefetched item
+ * @return an error code
+ */
+static int upipe_hls_playlist_segment_alloc(
+    struct upipe *upipe, uint64_t index, struct uref *item, const char *uri,
+    struct upipe_hls_playlist_segment **segment_p)
+{
+    struct upipe_hls_playlist *upipe_hls_playlist =
+        upipe_hls_playlist_from_upipe(upipe);
+    int ret;
+
+    UBASE_RETURN(upipe_hls_playlist_check_source_mgr(upipe));
+    struct upipe_hls_playlist_segment *segment = malloc(sizeof (*segment));
+    UBASE_ALLOC_RETURN(segment);
+    segment->uri = strdup(uri);
+    if (unlikely(segment->uri == NULL)) {
+        free(segment);
+        return UBASE_ERR_ALLOC;
+    }
+    uchain_init(upipe_hls_playlist_segment_to_uchain(segment));
+    segment->upipe = upipe;
+    segment->index = index;
+    segment->src = NULL;
+    uprobe_init(&segment->probe_src, probe_segment_src, NULL);
+    uprobe_init(&segment->probe, probe_segment, NULL);
+    ulist_init(&segment->urefs);
+    segment->size = 0;
+    ulist_init(&segment->held);
+    segment->blocker = NULL;
+    segment->done = false;
+    segment->evicted = false;
+    ulist_add(&upipe_hls_playlist->cache,
+              upipe_hls_playlist_segment_to_uchain(segment));
+
+    upipe_verbose_va(upipe, "prefetch item %"PRIu64" %s", index, uri);
+    segment->src = upipe_void_alloc(
+        upipe_hls_playlist->source_mgr,
+        uprobe_pfx_alloc(uprobe_use(&segment->probe_src),
+                         UPROBE_LOG_VERBOSE, "prefetch src"));
+    if (unlikely(segment->src == NULL)) {
+        upipe_hls_playlist_segment_free(upipe, segment);
+        return UBASE_ERR_ALLOC;
+    }
+
+    struct upipe_mgr *upipe_probe_uref_mgr = upipe_probe_uref_mgr_alloc();
+    if (unlikely(upipe_probe_uref_mgr == NULL)) {
+        upipe_hls_playlist_segment_free(upipe, segment);
+        return UBASE_ERR_ALLOC;
+    }
+    struct upipe *output = upipe_void_alloc_output(
+        segment->src, upipe_probe_uref_mgr,
+        uprobe_pfx_alloc(uprobe_use(&segment->probe),
+                         UPROBE_LOG_VERBOSE, "prefetch"));
+    upipe_mgr_release(upipe_probe_uref_mgr);
+    if (unlikely(output == NULL)) {
+        upipe_hls_playlist_segment_free(upipe, segment);
+        return UBASE_ERR_ALLOC;
+    }
+    upipe_release(output);
+
+    uint64_t range_off = 0;
+    uref_m3u_playlist_get_byte_range_off(item, &range_off);
+    uint64_t range_len = (uint64_t)-1;
+    uref_m3u_playlist_get_byte_range_len(item, &range_len);
+
+    ret = UBASE_ERR_NONE;
+    if (upipe_hls_playlist->attach_uclock)
+        ret = upipe_attach_uclock(segment->src);
+    if (ubase_check(ret) && upipe_hls_playlist->output_size)
+        ret = upipe_set_output_size(segment->src,
+                                    upipe_hls_playlist->output_size);
+    if (ubase_check(ret))
+        ret = upipe_set_uri(segment->src, uri);
+    if (ubase_check(ret))
+        ret = upipe_src_set_range(segment->src, range_off, range_len);
+    if (unlikely(!ubase_check(ret))) {
+        upipe_hls_playlist_segment_free(upipe, segment);
+        return ret;
+    }
+
+    if (segment_p != NULL)
+        *segment_p = segment;
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This plays an item through the cache, using the prefetched
+ * data if any.
+ *
+ * @param upipe description structure of the pipe
+ * @param item item to play
+ * @param uri the uri of the item to play
+ * @return an error code
+ */
+static int upipe_hls_playlist_play_segment(struct upipe *upipe,
+                                           struct uref *item,
+                                           const char *uri)
+{
+    struct upipe_hls_playlist *upipe_hls_playlist =
+        upipe_hls_playlist_from_upipe(upipe);
+    uint64_t index = upipe_hls_playlist->index;
+
+    if (upipe_hls_playlist->current != NULL)
+        upipe_hls_playlist_segment_free(upipe, upipe_hls_playlist->current);
+    upipe_hls_playlist->stall_start = UINT64_MAX;
+
+    struct upipe_hls_playlist_segment *segment =
+        upipe_hls_playlist_segment_find(upipe, index);
+    if (segment != NULL && strcmp(segment->uri, uri)) {
+        upipe_hls_playlist_segment_evict(upipe, segment);
+        segment = NULL;
+    }
+
+    if (segment != NULL) {
+        upipe_dbg_va(upipe, "item %"PRIu64" is prefetched (%"PRIu64" octets%s)",
+                     index, segment->size, segment->done ? ", complete" : "");
+        upipe_hls_playlist->stats.hits++;
+    }
+    else {
+        upipe_hls_playlist->stats.misses++;
+        UBASE_RETURN(upipe_hls_playlist_segment_alloc(upipe, index, item, uri,
+                                                      &segment));
+    }
+
+    upipe_hls_playlist->current = segment;
+    upipe_hls_playlist_wake(upipe);
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This plays an item with a new source pipe.
+ *
+ * @param upipe description structure of the pipe
+ * @param item item to play
+ * @param uri the uri of the item to play
+ * @return an error code
+ */
+static int upipe_hls_playlist_play_src(struct upipe *upipe,
+                                       struct uref *item,
+                                       const char *uri)
+{
+    struct upipe_hls_playlist *upipe_hls_playlist =
+        upipe_hls_playlist_from_upipe(upipe);
+
+    UBASE_RETURN(upipe_hls_playlist_check_source_mgr(upipe));
+    struct upipe *inner = upipe_void_alloc(
+        upipe_hls_playlist->source_mgr,
+        uprobe_pfx_alloc(
+            uprobe_use(&upipe_hls_playlist->probe_src),
+            UPROBE_LOG_VERBOSE, "src"));
+    UBASE_ALLOC_RETURN(inner);
+    int ret = upipe_set_output(inner, upipe_hls_playlist->setflowdef);
+    if (likely(ubase_check(ret)))
+        ret = upipe_set_uri(inner, uri);
+    if (unlikely(!ubase_check(ret))) {
+        upipe_release(inner);
+        return ret;
+    }
+    UBASE_RETURN(upipe_hls_playlist_set_src(upipe, inner));
+
+    uint64_t range_off = 0;
+    uref_m3u_playlist_get_byte_range_off(item, &range_off);
+    uint64_t range_len = (uint64_t)-1;
+    uref_m3u_playlist_get_byte_range_len(item, &range_len);
+    return upipe_src_set_range(inner, range_off, range_len);
+}
+
 /** @internal @This plays an URI.
  *
  * @param upipe description structure of the pipe
  * @param item item to play
- * @param uuri the URI of the item to play
+ * @param uri the URI of the item to play
  * @return an error code
  */
 static int upipe_hls_playlist_play_uri(struct upipe *upipe,
                                        struct uref *item,
-                                       struct uuri *uuri)
+                                       const char *uri)
 {
     struct upipe_hls_playlist *upipe_hls_playlist =
         upipe_hls_playlist_from_upipe(upipe);
     struct uref *input_flow_def = upipe_hls_playlist->input_flow_def;
 
-    size_t len;
-    UBASE_RETURN(uuri_len(uuri, &len));
-    char uri[len + 1];
-    UBASE_RETURN(uuri_to_buffer(uuri, uri, sizeof (uri)));
-
     uint64_t media_sequence = 0;
     uref_m3u_playlist_flow_get_media_sequence(input_flow_def, &media_sequence);
     uint64_t last_sequence = media_sequence;
@@ -871,64 +1535,63 @@ static int upipe_hls_playlist_play_uri(struct upipe *upipe,
     }
     UBASE_RETURN(upipe_hls_playlist_update_flow_def(upipe));
 
-    UBASE_RETURN(upipe_hls_playlist_check_source_mgr(upipe));
-    struct upipe *inner = upipe_void_alloc(
-        upipe_hls_playlist->source_mgr,
-        uprobe_pfx_alloc(
-            uprobe_use(&upipe_hls_playlist->probe_src),
-            UPROBE_LOG_VERBOSE, "src"));
-    UBASE_ALLOC_RETURN(inner);
-    int ret = upipe_set_output(inner, upipe_hls_playlist->setflowdef);
-    if (likely(ubase_check(ret)))
-        ret = upipe_set_uri(inner, uri);
-    if (unlikely(!ubase_check(ret))) {
-        upipe_release(inner);
-        return ret;
-    }
-    UBASE_RETURN(upipe_hls_playlist_set_src(upipe, inner));
-
-    uint64_t range_off = 0;
-    uref_m3u_playlist_get_byte_range_off(item, &range_off);
-    uint64_t range_len = (uint64_t)-1;
-    uref_m3u_playlist_get_byte_range_len(item, &range_len);
-    UBASE_RETURN(upipe_src_set_range(inner, range_off, range_len));
+    UBASE_RETURN(upipe_hls_playlist->prefetch ?
+                 upipe_hls_playlist_play_segment(upipe, item, uri) :
+                 upipe_hls_playlist_play_src(upipe, item, uri));
     upipe_dbg(upipe, "playing");
     upipe_hls_playlist->playing = true;
     if (upipe_hls_playlist->index >= last_sequence - 1) {
         upipe_warn(upipe, "reach the end of the playlist");
         upipe_hls_playlist_need_reload(upipe);
     }
+    upipe_hls_playlist_prefetch(upipe);
     return UBASE_ERR_NONE;
 }
 
-/** @internal @This plays an item.
+/** @internal @This allocates a string from an uri.
+ *
+ * @param uuri the uri
+ * @param uri_p filled with an allocated string, to free by the caller
+ * @return an error code
+ */
+static int upipe_hls_playlist_uuri_dup(struct uuri *uuri, char **uri_p)
+{
+    size_t len;
+    UBASE_RETURN(uuri_len(uuri, &len));
+    char *uri = malloc(len + 1);
+    UBASE_ALLOC_RETURN(uri);
+    int ret = uuri_to_buffer(uuri, uri, len + 1);
+    if (unlikely(!ubase_check(ret))) {
+        free(uri);
+        return ret;
+    }
+    *uri_p = uri;
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This resolves the uri of an item against the playlist uri.
  *
  * @param upipe description structure of the pipe
- * @param item item to play
+ * @param item playlist item
+ * @param uri_p filled with an allocated string, to free by the caller
  * @return an error code
  */
-static int upipe_hls_playlist_play_item(struct upipe *upipe,
-                                        struct uref *item)
+static int upipe_hls_playlist_item_uri(struct upipe *upipe,
+                                       struct uref *item,
+                                       char **uri_p)
 {
     struct upipe_hls_playlist *upipe_hls_playlist =
         upipe_hls_playlist_from_upipe(upipe);
     struct uref *input_flow_def = upipe_hls_playlist->input_flow_def;
     int ret;
 
-    if (unlikely(input_flow_def == NULL) || unlikely(item == NULL))
-        return UBASE_ERR_INVALID;
-
-    upipe_verbose_va(upipe, "play item sequence %"PRIu64,
-                     upipe_hls_playlist->index);
-    uref_dump(item, upipe->uprobe);
-
     const char *m3u_uri;
     UBASE_RETURN(uref_m3u_get_uri(item, &m3u_uri));
 
     struct uuri uuri;
     if (ubase_check(uuri_from_str(&uuri, m3u_uri)))
         /* this is a valid URI, we can directly play it */
-        return upipe_hls_playlist_play_uri(upipe, item, &uuri);
+        return upipe_hls_playlist_uuri_dup(&uuri, uri_p);
 
     UBASE_RETURN(uref_uri_get(input_flow_def, &uuri));
     uuri.query = ustring_null();
@@ -939,7 +1602,7 @@ static int upipe_hls_playlist_play_item(struct upipe *upipe,
         snprintf(uri, sizeof (uri),
                  "%.*s:%s", (int)uuri.scheme.len, uuri.scheme.at, m3u_uri);
         if (ubase_check(uuri_from_str(&uuri, uri)))
-            return upipe_hls_playlist_play_uri(upipe, item, &uuri);
+            return upipe_hls_playlist_uuri_dup(&uuri, uri_p);
         else {
             upipe_err(upipe, "invalid uri");
             return UBASE_ERR_INVALID;
@@ -948,7 +1611,7 @@ static int upipe_hls_playlist_play_item(struct upipe *upipe,
     if (strlen(m3u_uri) && *m3u_uri == '/') {
         /* use the item absolute path with the input scheme */
         uuri.path = ustring_from_str(m3u_uri);
-        return upipe_hls_playlist_play_uri(upipe, item, &uuri);
+        return upipe_hls_playlist_uuri_dup(&uuri, uri_p);
     }
 
     /* use the item relative path with the input path as root path */
@@ -960,7 +1623,34 @@ static int upipe_hls_playlist_play_item(struct upipe *upipe,
     if (ret < 0 || (unsigned)ret >= sizeof (new_path))
         return UBASE_ERR_NOSPC;
     uuri.path = ustring_from_str(new_path);
-    return upipe_hls_playlist_play_uri(upipe, item, &uuri);
+    return upipe_hls_playlist_uuri_dup(&uuri, uri_p);
+}
+
+/** @internal @This plays an item.
+ *
+ * @param upipe description structure of the pipe
+ * @param item item to play
+ * @return an error code
+ */
+static int upipe_hls_playlist_play_item(struct upipe *upipe,
+                                        struct uref *item)
+{
+    struct upipe_hls_playlist *upipe_hls_playlist =
+        upipe_hls_playlist_from_upipe(upipe);
+    struct uref *input_flow_def = upipe_hls_playlist->input_flow_def;
+
+    if (unlikely(input_flow_def == NULL) || unlikely(item == NULL))
+        return UBASE_ERR_INVALID;
+
+    upipe_verbose_va(upipe, "play item sequence %"PRIu64,
+                     upipe_hls_playlist->index);
+    uref_dump(item, upipe->uprobe);
+
+    char *uri;
+    UBASE_RETURN(upipe_hls_playlist_item_uri(upipe, item, &uri));
+    int ret = upipe_hls_playlist_play_uri(upipe, item, uri);
+    free(uri);
+    return ret;
 }
 
 /** @internal @This gets a media sequence by its sequence number.
@@ -998,6 +1688,58 @@ static int upipe_hls_playlist_get_item_at(struct upipe *upipe,
     return UBASE_ERR_INVALID;
 }
 
+/** @internal @This drops the prefetched items which are not ahead of the
+ * current index anymore, and starts downloading the next items.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_hls_playlist_prefetch(struct upipe *upipe)
+{
+    struct upipe_hls_playlist *upipe_hls_playlist =
+        upipe_hls_playlist_from_upipe(upipe);
+    struct uref *input_flow_def = upipe_hls_playlist->input_flow_def;
+    uint64_t index = upipe_hls_playlist->index;
+    uint64_t last = index + upipe_hls_playlist->prefetch;
+    struct uchain *uchain, *uchain_tmp;
+
+    if (!upipe_hls_playlist->prefetch || input_flow_def == NULL ||
+        index == (uint64_t)-1)
+        return;
+
+    uint64_t media_sequence = 0;
+    uref_m3u_playlist_flow_get_media_sequence(input_flow_def, &media_sequence);
+    ulist_delete_foreach(&upipe_hls_playlist->cache, uchain, uchain_tmp) {
+        struct upipe_hls_playlist_segment *segment =
+            upipe_hls_playlist_segment_from_uchain(uchain);
+        if (segment == upipe_hls_playlist->current || segment->evicted)
+            continue;
+        if (segment->index < index || segment->index > last ||
+            segment->index < media_sequence)
+            upipe_hls_playlist_segment_evict(upipe, segment);
+    }
+
+    uint64_t i = media_sequence - 1;
+    ulist_foreach(&upipe_hls_playlist->items, uchain) {
+        struct uref *item = uref_from_uchain(uchain);
+        i++;
+        if (i > last || upipe_hls_playlist->cache_size >=
+                        upipe_hls_playlist->cache_max_size)
+            break;
+        if (i < index || upipe_hls_playlist_segment_find(upipe, i) != NULL)
+            continue;
+
+        char *uri;
+        if (!ubase_check(upipe_hls_playlist_item_uri(upipe, item, &uri)))
+            break;
+        int ret = upipe_hls_playlist_segment_alloc(upipe, i, item, uri, NULL);
+        free(uri);
+        if (!ubase_check(ret)) {
+            upipe_warn_va(upipe, "unable to prefetch item %"PRIu64, i);
+            break;
+        }
+    }
+}
+
 /** @internal @This plays the next item in the playlist.
  *
  * @param upipe description structure of the pipe
@@ -1163,6 +1905,8 @@ static void upipe_hls_playlist_input(struct upipe *upipe,
         upipe_dbg(upipe, "playlist end");
         upipe_hls_playlist->reloading = false;
         upipe_hls_playlist_throw_reloaded(upipe);
+        if (upipe_hls_playlist->playing)
+            upipe_hls_playlist_prefetch(upipe);
     }
 }
 
@@ -1181,6 +1925,48 @@ static void upipe_hls_playlist_store_input_flow_def(struct upipe *upipe,
     upipe_hls_playlist->input_flow_def = flow_def;
 }
 
+/** @internal @This takes the items which are still valid after an
+ * incremental reload out of the playlist.
+ *
+ * @param upipe description structure of the pipe
+ * @param input_flow_def new input flow definition
+ * @param items filled with the kept items
+ */
+static void upipe_hls_playlist_keep_items(struct upipe *upipe,
+                                          struct uref *input_flow_def,
+                                          struct uchain *items)
+{
+    struct upipe_hls_playlist *upipe_hls_playlist =
+        upipe_hls_playlist_from_upipe(upipe);
+    struct uref *old_flow_def = upipe_hls_playlist->input_flow_def;
+
+    uint64_t kept;
+    if (!ubase_check(uref_m3u_playlist_flow_get_kept(input_flow_def, &kept)) ||
+        !kept)
+        return;
+
+    uint64_t old_media_sequence = 0, media_sequence = 0;
+    if (old_flow_def != NULL)
+        uref_m3u_playlist_flow_get_media_sequence(old_flow_def,
+                                                  &old_media_sequence);
+    uref_m3u_playlist_flow_get_media_sequence(input_flow_def,
+                                              &media_sequence);
+
+    uint64_t index = old_media_sequence;
+    struct uchain *uchain, *uchain_tmp;
+    ulist_delete_foreach(&upipe_hls_playlist->items, uchain, uchain_tmp) {
+        if (index >= media_sequence && index < media_sequence + kept) {
+            ulist_delete(uchain);
+            ulist_add(items, uchain);
+        }
+        index++;
+    }
+
+    if (unlikely(ulist_depth(items) != kept))
+        upipe_warn_va(upipe, "only %zu of %"PRIu64" unchanged items found",
+                      ulist_depth(items), kept);
+}
+
 static void upipe_hls_playlist_need_reload_cb(struct upump *upump)
 {
         struct upipe *upipe = upump_get_opaque(upump, struct upipe *);
@@ -1201,6 +1987,29 @@ static int upipe_hls_playlist_set_flow_def(struct upipe *upipe,
 
     UBASE_RETURN(uref_flow_match_def(input_flow_def, EXPECTED_FLOW_DEF));
 
+    if (upipe_hls_playlist->input_flow_def != NULL &&
+        !ulist_empty(&upipe_hls_playlist->cache)) {
+        const char *old_host = NULL, *host = NULL;
+        const char *old_path = NULL, *path = NULL;
+        uref_uri_get_host(upipe_hls_playlist->input_flow_def, &old_host);
+        uref_uri_get_host(input_flow_def, &host);
+        uref_uri_get_path(upipe_hls_playlist->input_flow_def, &old_path);
+        uref_uri_get_path(input_flow_def, &path);
+        if (!old_host != !host || !old_path != !path ||
+            (host && strcmp(old_host, host)) ||
+            (path && strcmp(old_path, path))) {
+            /* the variant has changed, keep the playing item only */
+            struct uchain *uchain, *uchain_tmp;
+            ulist_delete_foreach(&upipe_hls_playlist->cache,
+                                 uchain, uchain_tmp) {
+                struct upipe_hls_playlist_segment *segment =
+                    upipe_hls_playlist_segment_from_uchain(uchain);
+                if (segment != upipe_hls_playlist->current)
+                    upipe_hls_playlist_segment_evict(upipe, segment);
+            }
+        }
+    }
+
     if (unlikely(upipe_hls_playlist->flow_def == NULL)) {
         struct uref *flow_def = uref_sibling_alloc(input_flow_def);
         if (unlikely(flow_def == NULL)) {
@@ -1254,6 +2063,10 @@ static int upipe_hls_playlist_set_flow_def(struct upipe *upipe,
             upipe_hls_playlist_set_upump(upipe, NULL);
         }
     }
+
+    struct uchain items;
+    ulist_init(&items);
+    upipe_hls_playlist_keep_items(upipe, input_flow_def, &items);
     upipe_hls_playlist_store_input_flow_def(upipe, flow_def_dup);
 
     if (unlikely(upipe_hls_playlist->reloading)) {
@@ -1262,6 +2075,9 @@ static int upipe_hls_playlist_set_flow_def(struct upipe *upipe,
     }
 
     upipe_hls_playlist_flush(upipe);
+    struct uchain *uchain;
+    while ((uchain = ulist_pop(&items)) != NULL)
+        ulist_add(&upipe_hls_playlist->items, uchain);
     upipe_hls_playlist->reloading = true;
     return UBASE_ERR_NONE;
 }
@@ -1345,6 +2161,70 @@ static int _upipe_hls_playlist_seek(struct upipe *upipe,
     return UBASE_ERR_INVALID;
 }
 
+/** @internal @This sets the prefetch settings.
+ *
+ * @param upipe description structure of the pipe
+ * @param items number of items to prefetch
+ * @param max_size maximum size of the cache
+ * @return an error code
+ */
+static int _upipe_hls_playlist_set_prefetch(struct upipe *upipe,
+                                            unsigned int items,
+                                            uint64_t max_size)
+{
+    struct upipe_hls_playlist *upipe_hls_playlist =
+        upipe_hls_playlist_from_upipe(upipe);
+
+    if (items && !max_size)
+        return UBASE_ERR_INVALID;
+    if (items && upipe_hls_playlist->playing &&
+        upipe_hls_playlist->current == NULL) {
+        upipe_warn(upipe, "cannot enable prefetching while playing");
+        return UBASE_ERR_BUSY;
+    }
+    if (!items && upipe_hls_playlist->current != NULL) {
+        upipe_warn(upipe, "cannot disable prefetching while playing");
+        return UBASE_ERR_BUSY;
+    }
+
+    upipe_hls_playlist->prefetch = items;
+    upipe_hls_playlist->cache_max_size = max_size;
+    if (!items) {
+        upipe_hls_playlist_cache_flush(upipe);
+        return UBASE_ERR_NONE;
+    }
+
+    if (upipe_hls_playlist->uclock == NULL)
+        upipe_hls_playlist_require_uclock(upipe);
+    if (upipe_hls_playlist->playing)
+        upipe_hls_playlist_prefetch(upipe);
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This gets the prefetch statistics.
+ *
+ * @param upipe description structure of the pipe
+ * @param stats filled with the statistics
+ * @return an error code
+ */
+static int _upipe_hls_playlist_get_stats(struct upipe *upipe,
+                                         struct upipe_hls_playlist_stats *stats)
+{
+    struct upipe_hls_playlist *upipe_hls_playlist =
+        upipe_hls_playlist_from_upipe(upipe);
+
+    if (unlikely(stats == NULL))
+        return UBASE_ERR_INVALID;
+    *stats = upipe_hls_playlist->stats;
+    stats->size = upipe_hls_playlist->cache_size;
+    if (upipe_hls_playlist->stall_start != UINT64_MAX) {
+        uint64_t now = upipe_hls_playlist_now(upipe);
+        if (now != UINT64_MAX && now > upipe_hls_playlist->stall_start)
+            stats->stall_time += now - upipe_hls_playlist->stall_start;
+    }
+    return UBASE_ERR_NONE;
+}
+
 /** @internal @This sets the inner pipe output size.
  *
  * @param upipe description structure of the pipe
@@ -1372,6 +2252,8 @@ static int upipe_hls_playlist_attach_uclock(struct upipe *upipe)
     struct upipe_hls_playlist *upipe_hls_playlist =
         upipe_hls_playlist_from_upipe(upipe);
     upipe_hls_playlist->attach_uclock = true;
+    if (upipe_hls_playlist->prefetch)
+        upipe_hls_playlist_require_uclock(upipe);
     if (upipe_hls_playlist->src != NULL)
         return upipe_attach_uclock(upipe_hls_playlist->src);
     return UBASE_ERR_NONE;
@@ -1412,7 +2294,8 @@ static int upipe_hls_playlist_control_internal(struct upipe *upipe,
         struct upipe_hls_playlist *upipe_hls_playlist =
             upipe_hls_playlist_from_upipe(upipe);
         struct upipe **p = va_arg(args, struct upipe **);
-        *p = upipe_hls_playlist->src;
+        *p = upipe_hls_playlist->current ?
+            upipe_hls_playlist->current->src : upipe_hls_playlist->src;
         return (*p != NULL) ? UBASE_ERR_NONE : UBASE_ERR_UNHANDLED;
     }
 
@@ -1444,6 +2327,31 @@ static int upipe_hls_playlist_control_internal(struct upipe *upipe,
         return _upipe_hls_playlist_seek(upipe, at, offset_p);
     }
 
+    case UPIPE_HLS_PLAYLIST_SET_PREFETCH: {
+        UBASE_SIGNATURE_CHECK(args, UPIPE_HLS_PLAYLIST_SIGNATURE);
+        unsigned int items = va_arg(args, unsigned int);
+        uint64_t max_size = va_arg(args, uint64_t);
+        return _upipe_hls_playlist_set_prefetch(upipe, items, max_size);
+    }
+    case UPIPE_HLS_PLAYLIST_GET_PREFETCH: {
+        UBASE_SIGNATURE_CHECK(args, UPIPE_HLS_PLAYLIST_SIGNATURE);
+        struct upipe_hls_playlist *upipe_hls_playlist =
+            upipe_hls_playlist_from_upipe(upipe);
+        unsigned int *items_p = va_arg(args, unsigned int *);
+        uint64_t *max_size_p = va_arg(args, uint64_t *);
+        if (items_p != NULL)
+            *items_p = upipe_hls_playlist->prefetch;
+        if (max_size_p != NULL)
+            *max_size_p = upipe_hls_playlist->cache_max_size;
+        return UBASE_ERR_NONE;
+    }
+    case UPIPE_HLS_PLAYLIST_GET_STATS: {
+        UBASE_SIGNATURE_CHECK(args, UPIPE_HLS_PLAYLIST_SIGNATURE);
+        struct upipe_hls_playlist_stats *stats =
+            va_arg(args, struct upipe_hls_playlist_stats *);
+        return _upipe_hls_playlist_get_stats(upipe, stats);
+    }
+
     default:
         return upipe_hls_playlist_control_bin_output(upipe, command, args);
     }
@@ -0,0 +1,1151 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short Upipe HLS sink module - writes TS segments and a media playlist
+ */
+
+#include "upipe/ubase.h"
+#include "upipe/ulist.h"
+#include "upipe/uprobe.h"
+#include "upipe/uprobe_prefix.h"
+#include "upipe/uclock.h"
+#include "upipe/uref.h"
+#include "upipe/uref_flow.h"
+#include "upipe/uref_block.h"
+#include "upipe/upipe.h"
+#include "upipe/upipe_helper_urefcount.h"
+#include "upipe/upipe_helper_upipe.h"
+#include "upipe/upipe_helper_void.h"
+#include "upipe-modules/upipe_file_sink.h"
+#include "upipe-hls/upipe_hls_sink.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/param.h>
+
+#include <bitstream/mpeg/ts.h>
+#include <bitstream/mpeg/psi.h>
+
+/** matches "block.mpegts." and "block.mpegtsaligned." */
+#define EXPECTED_FLOW_DEF "block.mpegts"
+/** default segment target duration */
+#define DEFAULT_DURATION (6 * UCLOCK_FREQ)
+/** default number of segments in the playlist */
+#define DEFAULT_WINDOW 5
+/** PCR wrap-around period */
+#define PCR_WRAP (UINT64_C(0x200000000) * 300)
+/** PCR gap above which the timeline is considered discontinuous */
+#define MAX_PCR_GAP UCLOCK_FREQ
+
+/** @internal @This is a cached PSI section, prepended to each segment. */
+struct upipe_hls_sink_psi {
+    /** for the PSI list */
+    struct uchain uchain;
+    /** PID of the table */
+    uint16_t pid;
+    /** packets of the last complete section, or NULL */
+    struct uref *uref;
+    /** packets of the section being received, or NULL */
+    struct uref *next;
+    /** number of octets of the section received */
+    uint16_t section_size;
+    /** section being received */
+    uint8_t section[PSI_HEADER_SIZE + PSI_MAX_SIZE];
+};
+
+UBASE_FROM_TO(upipe_hls_sink_psi, uchain, uchain, uchain);
+
+/** @internal @This describes a partial segment. */
+struct upipe_hls_sink_part {
+    /** offset of the part in its segment */
+    uint64_t offset;
+    /** size of the part */
+    uint64_t size;
+    /** duration of the part */
+    uint64_t duration;
+    /** the part starts with a random access point */
+    bool independent;
+};
+
+/** @internal @This describes a segment. */
+struct upipe_hls_sink_segment {
+    /** for the segment list */
+    struct uchain uchain;
+    /** media sequence */
+    uint64_t sequence;
+    /** duration */
+    uint64_t duration;
+    /** number of octets written */
+    uint64_t size;
+    /** the segment follows a timeline discontinuity */
+    bool discontinuity;
+    /** array of parts */
+    struct upipe_hls_sink_part *parts;
+    /** number of parts */
+    unsigned int nb_parts;
+    /** allocated number of parts */
+    unsigned int max_parts;
+};
+
+UBASE_FROM_TO(upipe_hls_sink_segment, uchain, uchain, uchain);
+
+/** @internal @This is the private context of a HLS sink pipe. */
+struct upipe_hls_sink {
+    /** refcount management structure */
+    struct urefcount urefcount;
+
+    /** input flow definition */
+    struct uref *flow_def;
+    /** inner file sink */
+    struct upipe *fsink;
+    /** file sink manager */
+    struct upipe_mgr *fsink_mgr;
+
+    /** path of the playlist */
+    char *playlist;
+    /** directory of the playlist, with a trailing slash */
+    char *dir;
+    /** prefix of the segments */
+    char *prefix;
+
+    /** segment target duration */
+    uint64_t duration;
+    /** part target duration, or 0 */
+    uint64_t part_duration;
+    /** number of segments in the playlist */
+    unsigned int window;
+    /** configured PID of the random access points */
+    unsigned int pid;
+
+    /** detected PCR PID, or UPIPE_HLS_SINK_AUTO_PID */
+    unsigned int pcr_pid;
+    /** detected video PID, or UPIPE_HLS_SINK_AUTO_PID */
+    unsigned int video_pid;
+    /** last PCR value, or UINT64_MAX */
+    uint64_t last_pcr;
+    /** last interval between PCRs */
+    uint64_t pcr_interval;
+    /** continuous time derived from the PCRs */
+    uint64_t clock;
+    /** a discontinuity must be signaled on the next segment */
+    bool discontinuity;
+
+    /** list of cached PSI packets */
+    struct uchain psi;
+
+    /** media sequence of the next segment */
+    uint64_t sequence;
+    /** list of complete segments, including the deleted window */
+    struct uchain segments;
+    /** number of discontinuities in the deleted segments */
+    uint64_t discontinuity_sequence;
+    /** number of complete segments */
+    unsigned int nb_segments;
+    /** segment being written, or NULL */
+    struct upipe_hls_sink_segment *current;
+    /** clock at the start of the current segment */
+    uint64_t segment_start;
+    /** clock at the start of the current part */
+    uint64_t part_start;
+    /** advertised target duration, in seconds */
+    uint64_t target;
+
+    /** public upipe structure */
+    struct upipe upipe;
+};
+
+UPIPE_HELPER_UPIPE(upipe_hls_sink, upipe, UPIPE_HLS_SINK_SIGNATURE);
+UPIPE_HELPER_UREFCOUNT(upipe_hls_sink, urefcount, upipe_hls_sink_free)
+UPIPE_HELPER_VOID(upipe_hls_sink)
+
+/** @internal @This allocates a HLS sink pipe.
+ *
+ * @param mgr common management structure
+ * @param uprobe structure used to raise events
+ * @param signature signature of the pipe allocator
+ * @param args optional arguments
+ * @return pointer to upipe or NULL in case of allocation error
+ */
+static struct upipe *upipe_hls_sink_alloc(struct upipe_mgr *mgr,
+                                          struct uprobe *uprobe,
+                                          uint32_t signature, va_list args)
+{
+    struct upipe *upipe = upipe_hls_sink_alloc_void(mgr, uprobe, signature,
+                                                    args);
+    if (unlikely(upipe == NULL))
+        return NULL;
+
+    struct upipe_hls_sink *upipe_hls_sink = upipe_hls_sink_from_upipe(upipe);
+    upipe_hls_sink_init_urefcount(upipe);
+    upipe_hls_sink->flow_def = NULL;
+    upipe_hls_sink->fsink = NULL;
+    upipe_hls_sink->fsink_mgr = NULL;
+    upipe_hls_sink->playlist = NULL;
+    upipe_hls_sink->dir = NULL;
+    upipe_hls_sink->prefix = NULL;
+    upipe_hls_sink->duration = DEFAULT_DURATION;
+    upipe_hls_sink->part_duration = 0;
+    upipe_hls_sink->window = DEFAULT_WINDOW;
+    upipe_hls_sink->pid = UPIPE_HLS_SINK_AUTO_PID;
+    upipe_hls_sink->pcr_pid = UPIPE_HLS_SINK_AUTO_PID;
+    upipe_hls_sink->video_pid = UPIPE_HLS_SINK_AUTO_PID;
+    upipe_hls_sink->last_pcr = UINT64_MAX;
+    upipe_hls_sink->pcr_interval = 0;
+    upipe_hls_sink->clock = 0;
+    upipe_hls_sink->discontinuity = false;
+    ulist_init(&upipe_hls_sink->psi);
+    upipe_hls_sink->sequence = 0;
+    ulist_init(&upipe_hls_sink->segments);
+    upipe_hls_sink->discontinuity_sequence = 0;
+    upipe_hls_sink->nb_segments = 0;
+    upipe_hls_sink->current = NULL;
+    upipe_hls_sink->segment_start = 0;
+    upipe_hls_sink->part_start = 0;
+    upipe_hls_sink->target = 0;
+    upipe_throw_ready(upipe);
+    return upipe;
+}
+
+/** @internal @This frees a segment description.
+ *
+ * @param segment segment description
+ */
+static void upipe_hls_sink_segment_free(struct upipe_hls_sink_segment *segment)
+{
+    free(segment->parts);
+    free(segment);
+}
+
+/** @internal @This prints the path of a segment.
+ *
+ * @param upipe description structure of the pipe
+ * @param sequence media sequence of the segment
+ * @param path filled in with the path
+ * @param size size of the path buffer
+ */
+static void upipe_hls_sink_segment_path(struct upipe *upipe,
+                                        uint64_t sequence,
+                                        char *path, size_t size)
+{
+    struct upipe_hls_sink *upipe_hls_sink = upipe_hls_sink_from_upipe(upipe);
+    snprintf(path, size, "%s%s%"PRIu64".ts", upipe_hls_sink->dir,
+             upipe_hls_sink->prefix, sequence);
+}
+
+/** @internal @This prints a duration in seconds.
+ *
+ * @param f playlist file
+ * @param duration duration in units of UCLOCK_FREQ
+ */
+static void upipe_hls_sink_print_duration(FILE *f, uint64_t duration)
+{
+    fprintf(f, "%"PRIu64".%05"PRIu64, duration / UCLOCK_FREQ,
+            (duration % UCLOCK_FREQ) * 100000 / UCLOCK_FREQ);
+}
+
+/** @internal @This prints the complete parts of a segment.
+ *
+ * @param upipe description structure of the pipe
+ * @param f playlist file
+ * @param segment segment description
+ * @param nb_parts number of complete parts
+ */
+static void upipe_hls_sink_print_parts(struct upipe *upipe, FILE *f,
+        const struct upipe_hls_sink_segment *segment, unsigned int nb_parts)
+{
+    struct upipe_hls_sink *upipe_hls_sink = upipe_hls_sink_from_upipe(upipe);
+
+    for (unsigned int i = 0; i < nb_parts; i++) {
+        const struct upipe_hls_sink_part *part = &segment->parts[i];
+        fprintf(f, "#EXT-X-PART:DURATION=");
+        upipe_hls_sink_print_duration(f, part->duration);
+        fprintf(f, ",URI=\"%s%"PRIu64".ts\",BYTERANGE=\"%"PRIu64"@%"PRIu64
+                "\"%s\n", upipe_hls_sink->prefix, segment->sequence,
+                part->size, part->offset,
+                part->independent ? ",INDEPENDENT=YES" : "");
+    }
+}
+
+/** @internal @This atomically rewrites the media playlist.
+ *
+ * @param upipe description structure of the pipe
+ * @param ended true if the stream has ended
+ */
+static void upipe_hls_sink_write_playlist(struct upipe *upipe, bool ended)
+{
+    struct upipe_hls_sink *upipe_hls_sink = upipe_hls_sink_from_upipe(upipe);
+    struct upipe_hls_sink_segment *current = upipe_hls_sink->current;
+    uint64_t part_duration = upipe_hls_sink->part_duration;
+    struct uchain *uchain;
+
+    /* skip the segments out of the window */
+    unsigned int skip = 0;
+    if (upipe_hls_sink->window &&
+        upipe_hls_sink->nb_segments > upipe_hls_sink->window)
+        skip = upipe_hls_sink->nb_segments - upipe_hls_sink->window;
+    uint64_t sequence = current != NULL ? current->sequence :
+                        upipe_hls_sink->sequence;
+    sequence -= upipe_hls_sink->nb_segments - skip;
+
+    /* count the discontinuities which left the playlist */
+    uint64_t discontinuity_sequence = upipe_hls_sink->discontinuity_sequence;
+    unsigned int i = 0;
+    ulist_foreach(&upipe_hls_sink->segments, uchain) {
+        if (i++ >= skip)
+            break;
+        if (upipe_hls_sink_segment_from_uchain(uchain)->discontinuity)
+            discontinuity_sequence++;
+    }
+
+    /* parts are listed for the last three target durations */
+    unsigned int parts_from = upipe_hls_sink->nb_segments;
+    if (part_duration) {
+        uint64_t total = 0;
+        ulist_foreach_reverse(&upipe_hls_sink->segments, uchain) {
+            struct upipe_hls_sink_segment *segment =
+                upipe_hls_sink_segment_from_uchain(uchain);
+            if (total >= 3 * upipe_hls_sink->target * UCLOCK_FREQ)
+                break;
+            total += segment->duration;
+            parts_from--;
+        }
+    }
+
+    char tmp[MAXPATHLEN];
+    snprintf(tmp, sizeof (tmp), "%s.tmp", upipe_hls_sink->playlist);
+    FILE *f = fopen(tmp, "w");
+    if (unlikely(f == NULL)) {
+        upipe_warn_va(upipe, "unable to open %s (%m)", tmp);
+        return;
+    }
+
+    fprintf(f, "#EXTM3U\n#EXT-X-VERSION:6\n");
+    fprintf(f, "#EXT-X-TARGETDURATION:%"PRIu64"\n", upipe_hls_sink->target);
+    fprintf(f, "#EXT-X-MEDIA-SEQUENCE:%"PRIu64"\n", sequence);
+    if (discontinuity_sequence)
+        fprintf(f, "#EXT-X-DISCONTINUITY-SEQUENCE:%"PRIu64"\n",
+                discontinuity_sequence);
+    if (!upipe_hls_sink->window)
+        fprintf(f, "#EXT-X-PLAYLIST-TYPE:EVENT\n");
+    fprintf(f, "#EXT-X-INDEPENDENT-SEGMENTS\n");
+    if (part_duration) {
+        fprintf(f, "#EXT-X-PART-INF:PART-TARGET=");
+        upipe_hls_sink_print_duration(f, part_duration);
+        fprintf(f, "\n#EXT-X-SERVER-CONTROL:PART-HOLD-BACK=");
+        upipe_hls_sink_print_duration(f, 3 * part_duration);
+        fprintf(f, "\n");
+    }
+
+    i = 0;
+    ulist_foreach(&upipe_hls_sink->segments, uchain) {
+        struct upipe_hls_sink_segment *segment =
+            upipe_hls_sink_segment_from_uchain(uchain);
+        if (i++ < skip)
+            continue;
+        if (segment->discontinuity)
+            fprintf(f, "#EXT-X-DISCONTINUITY\n");
+        if (i > parts_from)
+            upipe_hls_sink_print_parts(upipe, f, segment, segment->nb_parts);
+        fprintf(f, "#EXTINF:");
+        upipe_hls_sink_print_duration(f, segment->duration);
+        fprintf(f, ",\n%s%"PRIu64".ts\n", upipe_hls_sink->prefix,
+                segment->sequence);
+    }
+
+    if (current != NULL && part_duration && !ended) {
+        if (current->discontinuity)
+            fprintf(f, "#EXT-X-DISCONTINUITY\n");
+        /* the last part is being written */
+        upipe_hls_sink_print_parts(upipe, f, current, current->nb_parts - 1);
+        uint64_t offset = current->parts[current->nb_parts - 1].offset;
+        fprintf(f, "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"%s%"PRIu64".ts\","
+                "BYTERANGE-START=%"PRIu64"\n", upipe_hls_sink->prefix,
+                current->sequence, offset);
+    }
+
+    if (ended)
+        fprintf(f, "#EXT-X-ENDLIST\n");
+
+    if (unlikely(fclose(f) != 0)) {
+        upipe_warn_va(upipe, "unable to write %s (%m)", tmp);
+        unlink(tmp);
+        return;
+    }
+    if (unlikely(rename(tmp, upipe_hls_sink->playlist) == -1)) {
+        upipe_warn_va(upipe, "unable to rename %s (%m)", tmp);
+        unlink(tmp);
+    }
+}
+
+/** @internal @This starts a new part in the current segment.
+ *
+ * @param upipe description structure of the pipe
+ * @param independent true if the part starts with a random access point
+ * @return an error code
+ */
+static int upipe_hls_sink_part_open(struct upipe *upipe, bool independent)
+{
+    struct upipe_hls_sink *upipe_hls_sink = upipe_hls_sink_from_upipe(upipe);
+    struct upipe_hls_sink_segment *segment = upipe_hls_sink->current;
+
+    if (segment->nb_parts >= segment->max_parts) {
+        unsigned int max_parts = segment->max_parts ?
+                                 segment->max_parts * 2 : 8;
+        struct upipe_hls_sink_part *parts =
+            realloc(segment->parts, max_parts * sizeof (*parts));
+        UBASE_ALLOC_RETURN(parts);
+        segment->parts = parts;
+        segment->max_parts = max_parts;
+    }
+
+    struct upipe_hls_sink_part *part = &segment->parts[segment->nb_parts++];
+    part->offset = segment->size;
+    part->size = 0;
+    part->duration = 0;
+    part->independent = independent;
+    upipe_hls_sink->part_start = upipe_hls_sink->clock;
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This completes the last part of the current segment.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_hls_sink_part_close(struct upipe *upipe)
+{
+    struct upipe_hls_sink *upipe_hls_sink = upipe_hls_sink_from_upipe(upipe);
+    struct upipe_hls_sink_segment *segment = upipe_hls_sink->current;
+    if (!segment->nb_parts)
+        return;
+
+    struct upipe_hls_sink_part *part = &segment->parts[segment->nb_parts - 1];
+    part->size = segment->size - part->offset;
+    part->duration = upipe_hls_sink->clock - upipe_hls_sink->part_start;
+    if (!part->size)
+        segment->nb_parts--;
+}
+
+/** @internal @This writes a buffer to the current segment.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref uref carrying TS packets
+ * @param upump_p reference to pump that generated the buffer
+ */
+static void upipe_hls_sink_write(struct upipe *upipe, struct uref *uref,
+                                 struct upump **upump_p)
+{
+    struct upipe_hls_sink *upipe_hls_sink = upipe_hls_sink_from_upipe(upipe);
+    size_t size = 0;
+    uref_block_size(uref, &size);
+    upipe_hls_sink->current->size += size;
+    upipe_input(upipe_hls_sink->fsink, uref, upump_p);
+}
+
+/** @internal @This opens a new segment.
+ *
+ * @param upipe description structure of the pipe
+ * @param upump_p reference to pump that generated the buffer
+ * @return an error code
+ */
+static int upipe_hls_sink_segment_open(struct upipe *upipe,
+                                       struct upump **upump_p)
+{
+    struct upipe_hls_sink *upipe_hls_sink = upipe_hls_sink_from_upipe(upipe);
+
+    struct upipe_hls_sink_segment *segment = malloc(sizeof (*segment));
+    UBASE_ALLOC_RETURN(segment);
+    uchain_init(&segment->uchain);
+    segment->sequence = upipe_hls_sink->sequence++;
+    segment->duration = 0;
+    segment->size = 0;
+    segment->discontinuity = upipe_hls_sink->discontinuity;
+    segment->parts = NULL;
+    segment->nb_parts = 0;
+    segment->max_parts = 0;
+    upipe_hls_sink->discontinuity = false;
+
+    char path[MAXPATHLEN];
+    upipe_hls_sink_segment_path(upipe, segment->sequence, path, sizeof (path));
+    int err = upipe_fsink_set_path(upipe_hls_sink->fsink, path,
+                                   UPIPE_FSINK_OVERWRITE);
+    if (unlikely(!ubase_check(err))) {
+        upipe_hls_sink_segment_free(segment);
+        return err;
+    }
+    upipe_hls_sink->current = segment;
+    upipe_hls_sink->segment_start = upipe_hls_sink->clock;
+    if (upipe_hls_sink->part_duration)
+        UBASE_RETURN(upipe_hls_sink_part_open(upipe, true));
+
+    /* make the segment decodable on its own */
+    struct uchain *uchain;
+    ulist_foreach(&upipe_hls_sink->psi, uchain) {
+        struct upipe_hls_sink_psi *psi =
+            upipe_hls_sink_psi_from_uchain(uchain);
+        if (psi->uref == NULL)
+            continue;
+        struct uref *uref = uref_dup(psi->uref);
+        UBASE_ALLOC_RETURN(uref);
+        upipe_hls_sink_write(upipe, uref, upump_p);
+    }
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This completes the current segment.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_hls_sink_segment_close(struct upipe *upipe)
+{
+    struct upipe_hls_sink *upipe_hls_sink = upipe_hls_sink_from_upipe(upipe);
+    struct upipe_hls_sink_segment *segment = upipe_hls_sink->current;
+
+    upipe_hls_sink_part_close(upipe);
+    segment->duration = upipe_hls_sink->clock - upipe_hls_sink->segment_start;
+    upipe_hls_sink->current = NULL;
+    ulist_add(&upipe_hls_sink->segments, &segment->uchain);
+    upipe_hls_sink->nb_segments++;
+    upipe_verbose_va(upipe, "segment %"PRIu64" complete (%"PRIu64" octets)",
+                     segment->sequence, segment->size);
+
+    /* the target duration must not decrease */
+    uint64_t target = (segment->duration + UCLOCK_FREQ / 2) / UCLOCK_FREQ;
+    if (target > upipe_hls_sink->target) {
+        if (upipe_hls_sink->target)
+            upipe_warn_va(upipe, "segment %"PRIu64" exceeds the target "
+                          "duration", segment->sequence);
+        upipe_hls_sink->target = target;
+    }
+
+    /* delete the segments which left the playlist a window ago */
+    while (upipe_hls_sink->window &&
+           upipe_hls_sink->nb_segments > 2 * upipe_hls_sink->window) {
+        struct upipe_hls_sink_segment *old =
+            upipe_hls_sink_segment_from_uchain(
+                ulist_pop(&upipe_hls_sink->segments));
+        upipe_hls_sink->nb_segments--;
+        if (old->discontinuity)
+            upipe_hls_sink->discontinuity_sequence++;
+        char path[MAXPATHLEN];
+        upipe_hls_sink_segment_path(upipe, old->sequence, path,
+                                    sizeof (path));
+        if (unlink(path) == -1 && errno != ENOENT)
+            upipe_warn_va(upipe, "unable to delete %s (%m)", path);
+        upipe_hls_sink_segment_free(old);
+    }
+}
+
+/** @internal @This allocates the description of a PSI PID.
+ *
+ * @param pid PID of the table
+ * @return pointer to the description, or NULL in case of allocation error
+ */
+static struct upipe_hls_sink_psi *upipe_hls_sink_psi_alloc(uint16_t pid)
+{
+    struct upipe_hls_sink_psi *psi = malloc(sizeof (*psi));
+    if (unlikely(psi == NULL))
+        return NULL;
+    uchain_init(&psi->uchain);
+    psi->pid = pid;
+    psi->uref = NULL;
+    psi->next = NULL;
+    psi->section_size = 0;
+    return psi;
+}
+
+/** @internal @This declares the PMT PIDs of a PAT section.
+ *
+ * @param upipe description structure of the pipe
+ * @param section complete PAT section
+ */
+static void upipe_hls_sink_parse_pat(struct upipe *upipe,
+                                     const uint8_t *section)
+{
+    struct upipe_hls_sink *upipe_hls_sink = upipe_hls_sink_from_upipe(upipe);
+    struct uchain *uchain;
+    uint8_t *program;
+
+    for (int j = 0;
+         (program = pat_get_program((uint8_t *)section, j)) != NULL; j++) {
+        if (!patn_get_program(program))
+            continue;
+        uint16_t pmt_pid = patn_get_pid(program);
+        bool found = false;
+        ulist_foreach(&upipe_hls_sink->psi, uchain) {
+            if (upipe_hls_sink_psi_from_uchain(uchain)->pid == pmt_pid) {
+                found = true;
+                break;
+            }
+        }
+        if (found)
+            continue;
+        struct upipe_hls_sink_psi *pmt = upipe_hls_sink_psi_alloc(pmt_pid);
+        if (unlikely(pmt == NULL))
+            return;
+        ulist_add(&upipe_hls_sink->psi, &pmt->uchain);
+    }
+}
+
+/** @internal @This finds the video PID of a PMT section.
+ *
+ * @param upipe description structure of the pipe
+ * @param section complete PMT section
+ */
+static void upipe_hls_sink_parse_pmt(struct upipe *upipe,
+                                     const uint8_t *section)
+{
+    struct upipe_hls_sink *upipe_hls_sink = upipe_hls_sink_from_upipe(upipe);
+    uint8_t *es;
+
+    for (int j = 0; (es = pmt_get_es((uint8_t *)section, j)) != NULL; j++) {
+        switch (pmtn_get_streamtype(es)) {
+            case PMT_STREAMTYPE_VIDEO_MPEG1:
+            case PMT_STREAMTYPE_VIDEO_MPEG2:
+            case PMT_STREAMTYPE_VIDEO_MPEG4:
+            case PMT_STREAMTYPE_VIDEO_AVC:
+            case PMT_STREAMTYPE_VIDEO_HEVC:
+                break;
+            default:
+                continue;
+        }
+        uint16_t pid = pmtn_get_pid(es);
+        if (pid != upipe_hls_sink->video_pid) {
+            upipe_dbg_va(upipe, "using video PID %"PRIu16, pid);
+            upipe_hls_sink->video_pid = pid;
+        }
+        return;
+    }
+}
+
+/** @internal @This caches the packets of the PAT and the PMTs. A section
+ * is only cached once all its packets have been received and its CRC is
+ * valid, so that each segment starts with complete tables.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref uref carrying the packet
+ * @param offset offset of the packet in the uref
+ * @param ts pointer to the packet
+ */
+static void upipe_hls_sink_cache_psi(struct upipe *upipe, struct uref *uref,
+                                     size_t offset, const uint8_t *ts)
+{
+    struct upipe_hls_sink *upipe_hls_sink = upipe_hls_sink_from_upipe(upipe);
+    uint16_t pid = ts_get_pid(ts);
+    struct uchain *uchain;
+    struct upipe_hls_sink_psi *psi = NULL;
+
+    if (!ts_has_payload(ts))
+        return;
+
+    ulist_foreach(&upipe_hls_sink->psi, uchain) {
+        struct upipe_hls_sink_psi *entry =
+            upipe_hls_sink_psi_from_uchain(uchain);
+        if (entry->pid == pid) {
+            psi = entry;
+            break;
+        }
+    }
+    if (psi == NULL) {
+        if (pid != PAT_PID || !ts_get_unitstart(ts))
+            return;
+        psi = upipe_hls_sink_psi_alloc(PAT_PID);
+        if (unlikely(psi == NULL))
+            return;
+        ulist_unshift(&upipe_hls_sink->psi, &psi->uchain);
+    }
+
+    const uint8_t *payload = ts_payload((uint8_t *)ts);
+    const uint8_t *end = ts + TS_SIZE;
+    if (ts_get_unitstart(ts)) {
+        /* a section left incomplete is dropped */
+        uref_free(psi->next);
+        psi->next = NULL;
+        psi->section_size = 0;
+        if (payload >= end || payload + 1 + *payload >= end)
+            return;
+        payload += 1 + *payload;
+        psi->next = uref_block_splice(uref, offset, TS_SIZE);
+        if (unlikely(psi->next == NULL))
+            return;
+    }
+    else {
+        if (psi->next == NULL || payload >= end)
+            return;
+        struct ubuf *ubuf = ubuf_block_splice(uref->ubuf, offset, TS_SIZE);
+        if (unlikely(ubuf == NULL ||
+                     !ubase_check(uref_block_append(psi->next, ubuf)))) {
+            if (ubuf != NULL)
+                ubuf_free(ubuf);
+            uref_free(psi->next);
+            psi->next = NULL;
+            return;
+        }
+    }
+
+    size_t size = MIN((size_t)(end - payload),
+                      sizeof (psi->section) - psi->section_size);
+    memcpy(psi->section + psi->section_size, payload, size);
+    psi->section_size += size;
+    if (psi->section_size < PSI_HEADER_SIZE)
+        return;
+    size_t section_size = PSI_HEADER_SIZE + psi_get_length(psi->section);
+    if (psi->section_size < section_size &&
+        psi->section_size < sizeof (psi->section))
+        return;
+
+    struct uref *packets = psi->next;
+    psi->next = NULL;
+    if (psi->section_size < section_size || !psi_check_crc(psi->section) ||
+        !(pid == PAT_PID ? pat_validate(psi->section) :
+                           pmt_validate(psi->section))) {
+        upipe_warn_va(upipe, "invalid section on PID %"PRIu16, pid);
+        uref_free(packets);
+        return;
+    }
+    uref_free(psi->uref);
+    psi->uref = packets;
+
+    if (pid == PAT_PID)
+        upipe_hls_sink_parse_pat(upipe, psi->section);
+    else
+        upipe_hls_sink_parse_pmt(upipe, psi->section);
+}
+
+/** @internal @This updates the clock with a PCR.
+ *
+ * @param upipe description structure of the pipe
+ * @param ts pointer to a packet carrying a PCR
+ */
+static void upipe_hls_sink_pcr(struct upipe *upipe, const uint8_t *ts)
+{
+    struct upipe_hls_sink *upipe_hls_sink = upipe_hls_sink_from_upipe(upipe);
+    uint64_t pcr = tsaf_get_pcr(ts) * 300 + tsaf_get_pcrext(ts);
+
+    if (upipe_hls_sink->last_pcr != UINT64_MAX) {
+        uint64_t delta = (PCR_WRAP + pcr - upipe_hls_sink->last_pcr) %
+                         PCR_WRAP;
+        if (unlikely(delta > MAX_PCR_GAP || tsaf_has_discontinuity(ts))) {
+            upipe_warn_va(upipe, "PCR discontinuity (%"PRIu64" ms)",
+                          delta / (UCLOCK_FREQ / 1000));
+            upipe_hls_sink->discontinuity = true;
+        }
+        else {
+            upipe_hls_sink->clock += delta;
+            upipe_hls_sink->pcr_interval = delta;
+        }
+    }
+    upipe_hls_sink->last_pcr = pcr;
+}
+
+/** @internal @This handles data.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref uref carrying TS packets
+ * @param upump_p reference to pump that generated the buffer
+ */
+static void upipe_hls_sink_input(struct upipe *upipe, struct uref *uref,
+                                 struct upump **upump_p)
+{
+    struct upipe_hls_sink *upipe_hls_sink = upipe_hls_sink_from_upipe(upipe);
+
+    size_t size;
+    if (unlikely(upipe_hls_sink->fsink == NULL ||
+                 upipe_hls_sink->playlist == NULL)) {
+        upipe_warn(upipe, "received a buffer before the path, dropping");
+        uref_free(uref);
+        return;
+    }
+    if (unlikely(!ubase_check(uref_block_size(uref, &size)))) {
+        upipe_warn(upipe, "invalid buffer received");
+        uref_free(uref);
+        return;
+    }
+
+    size_t offset;
+    for (offset = 0; offset + TS_SIZE <= size; offset += TS_SIZE) {
+        uint8_t buffer[TS_SIZE];
+        const uint8_t *ts = uref_block_peek(uref, offset, TS_SIZE, buffer);
+        if (unlikely(ts == NULL))
+            break;
+        if (unlikely(!ts_validate(ts))) {
+            uref_block_peek_unmap(uref, offset, buffer, ts);
+            continue;
+        }
+
+        uint16_t pid = ts_get_pid(ts);
+        bool random = false;
+        if (ts_has_adaptation(ts) && ts_get_adaptation(ts)) {
+            random = tsaf_has_randomaccess(ts);
+            if (tsaf_has_pcr(ts)) {
+                if (upipe_hls_sink->pcr_pid == UPIPE_HLS_SINK_AUTO_PID) {
+                    upipe_dbg_va(upipe, "using PCR PID %"PRIu16, pid);
+                    upipe_hls_sink->pcr_pid = pid;
+                }
+                if (pid == upipe_hls_sink->pcr_pid)
+                    upipe_hls_sink_pcr(upipe, ts);
+            }
+        }
+        upipe_hls_sink_cache_psi(upipe, uref, offset, ts);
+
+        unsigned int cut_pid = upipe_hls_sink->pid;
+        if (cut_pid == UPIPE_HLS_SINK_AUTO_PID)
+            cut_pid = upipe_hls_sink->video_pid;
+        if (cut_pid == UPIPE_HLS_SINK_AUTO_PID)
+            cut_pid = upipe_hls_sink->pcr_pid;
+        /* segments and parts start on a unit of the cut PID, so that a part
+         * is never left empty of time by the next segment */
+        bool unit = pid == cut_pid && ts_get_unitstart(ts);
+        random = random && unit;
+        uref_block_peek_unmap(uref, offset, buffer, ts);
+
+        struct upipe_hls_sink_segment *current = upipe_hls_sink->current;
+        uint64_t clock = upipe_hls_sink->clock;
+        bool cut_segment = random && (current == NULL ||
+            clock - upipe_hls_sink->segment_start >= upipe_hls_sink->duration);
+        bool cut_part = unit && !cut_segment && current != NULL &&
+            upipe_hls_sink->part_duration &&
+            clock - upipe_hls_sink->part_start +
+                upipe_hls_sink->pcr_interval > upipe_hls_sink->part_duration;
+        if (!cut_segment && !cut_part)
+            continue;
+
+        /* hand the previous packets over before publishing them */
+        if (offset) {
+            struct uref *tail = uref_block_split(uref, offset);
+            if (unlikely(tail == NULL)) {
+                uref_free(uref);
+                upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+                return;
+            }
+            if (current != NULL)
+                upipe_hls_sink_write(upipe, uref, upump_p);
+            else
+                uref_free(uref);
+            uref = tail;
+            size -= offset;
+            offset = 0;
+        }
+
+        int err;
+        if (cut_segment) {
+            if (current != NULL)
+                upipe_hls_sink_segment_close(upipe);
+            err = upipe_hls_sink_segment_open(upipe, upump_p);
+        }
+        else {
+            upipe_hls_sink_part_close(upipe);
+            err = upipe_hls_sink_part_open(upipe, random);
+        }
+        if (unlikely(!ubase_check(err))) {
+            uref_free(uref);
+            upipe_throw_fatal(upipe, err);
+            return;
+        }
+        upipe_hls_sink_write_playlist(upipe, false);
+    }
+
+    if (upipe_hls_sink->current != NULL)
+        upipe_hls_sink_write(upipe, uref, upump_p);
+    else
+        uref_free(uref);
+}
+
+/** @internal @This allocates the inner file sink.
+ *
+ * @param upipe description structure of the pipe
+ * @return an error code
+ */
+static int upipe_hls_sink_alloc_fsink(struct upipe *upipe)
+{
+    struct upipe_hls_sink *upipe_hls_sink = upipe_hls_sink_from_upipe(upipe);
+    if (upipe_hls_sink->fsink != NULL)
+        return UBASE_ERR_NONE;
+
+    if (unlikely(upipe_hls_sink->fsink_mgr == NULL)) {
+        upipe_err(upipe, "fsink manager required");
+        return UBASE_ERR_UNHANDLED;
+    }
+    struct upipe *fsink = upipe_void_alloc(upipe_hls_sink->fsink_mgr,
+            uprobe_pfx_alloc(uprobe_use(upipe->uprobe),
+                             UPROBE_LOG_VERBOSE, "fsink"));
+    if (unlikely(fsink == NULL)) {
+        upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+        return UBASE_ERR_ALLOC;
+    }
+    upipe_hls_sink->fsink = fsink;
+    if (upipe_hls_sink->flow_def != NULL)
+        return upipe_set_flow_def(fsink, upipe_hls_sink->flow_def);
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This sets the input flow definition.
+ *
+ * @param upipe description structure of the pipe
+ * @param flow_def flow definition packet
+ * @return an error code
+ */
+static int upipe_hls_sink_set_flow_def(struct upipe *upipe,
+                                       struct uref *flow_def)
+{
+    struct upipe_hls_sink *upipe_hls_sink = upipe_hls_sink_from_upipe(upipe);
+    if (flow_def == NULL)
+        return UBASE_ERR_INVALID;
+    UBASE_RETURN(uref_flow_match_def(flow_def, EXPECTED_FLOW_DEF))
+
+    struct uref *flow_def_dup = uref_dup(flow_def);
+    UBASE_ALLOC_RETURN(flow_def_dup);
+    uref_free(upipe_hls_sink->flow_def);
+    upipe_hls_sink->flow_def = flow_def_dup;
+    if (upipe_hls_sink->fsink != NULL)
+        return upipe_set_flow_def(upipe_hls_sink->fsink, flow_def_dup);
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This sets the playlist path and the segment prefix.
+ *
+ * @param upipe description structure of the pipe
+ * @param playlist path of the media playlist
+ * @param prefix prefix of the segments, relative to the playlist
+ * @return an error code
+ */
+static int _upipe_hls_sink_set_path(struct upipe *upipe,
+                                    const char *playlist,
+                                    const char *prefix)
+{
+    struct upipe_hls_sink *upipe_hls_sink = upipe_hls_sink_from_upipe(upipe);
+
+    if (unlikely(playlist == NULL || prefix == NULL))
+        return UBASE_ERR_INVALID;
+    UBASE_RETURN(upipe_hls_sink_alloc_fsink(upipe));
+
+    if (upipe_hls_sink->current != NULL) {
+        upipe_hls_sink_segment_close(upipe);
+        upipe_hls_sink_write_playlist(upipe, true);
+    }
+
+    char *playlist_dup = strdup(playlist);
+    char *prefix_dup = strdup(prefix);
+    char *dir = strdup(playlist);
+    if (unlikely(playlist_dup == NULL || prefix_dup == NULL || dir == NULL)) {
+        free(playlist_dup);
+        free(prefix_dup);
+        free(dir);
+        return UBASE_ERR_ALLOC;
+    }
+    char *slash = strrchr(dir, '/');
+    if (slash != NULL)
+        slash[1] = '\0';
+    else
+        dir[0] = '\0';
+
+    free(upipe_hls_sink->playlist);
+    free(upipe_hls_sink->prefix);
+    free(upipe_hls_sink->dir);
+    upipe_hls_sink->playlist = playlist_dup;
+    upipe_hls_sink->prefix = prefix_dup;
+    upipe_hls_sink->dir = dir;
+
+    /* start a new playlist */
+    struct uchain *uchain;
+    while ((uchain = ulist_pop(&upipe_hls_sink->segments)) != NULL)
+        upipe_hls_sink_segment_free(
+            upipe_hls_sink_segment_from_uchain(uchain));
+    upipe_hls_sink->nb_segments = 0;
+    upipe_hls_sink->discontinuity_sequence = 0;
+    upipe_hls_sink->sequence = 0;
+    upipe_hls_sink->target = (upipe_hls_sink->duration + UCLOCK_FREQ - 1) /
+                             UCLOCK_FREQ;
+    upipe_notice_va(upipe, "writing %s with segments %s%s<n>.ts",
+                    playlist, dir, prefix);
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This sets the target durations.
+ *
+ * @param upipe description structure of the pipe
+ * @param duration segment target duration
+ * @param part part target duration, or 0
+ * @return an error code
+ */
+static int _upipe_hls_sink_set_duration(struct upipe *upipe,
+                                        uint64_t duration, uint64_t part)
+{
+    struct upipe_hls_sink *upipe_hls_sink = upipe_hls_sink_from_upipe(upipe);
+    if (unlikely(duration < UCLOCK_FREQ || part >= duration))
+        return UBASE_ERR_INVALID;
+    if (unlikely(upipe_hls_sink->current != NULL &&
+                 !upipe_hls_sink->part_duration != !part)) {
+        upipe_warn(upipe, "cannot toggle the parts during a segment");
+        return UBASE_ERR_BUSY;
+    }
+    upipe_hls_sink->duration = duration;
+    upipe_hls_sink->part_duration = part;
+    uint64_t target = (duration + UCLOCK_FREQ - 1) / UCLOCK_FREQ;
+    if (target > upipe_hls_sink->target)
+        upipe_hls_sink->target = target;
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This processes control commands.
+ *
+ * @param upipe description structure of the pipe
+ * @param command type of command to process
+ * @param args arguments of the command
+ * @return an error code
+ */
+static int upipe_hls_sink_control(struct upipe *upipe,
+                                  int command, va_list args)
+{
+    struct upipe_hls_sink *upipe_hls_sink = upipe_hls_sink_from_upipe(upipe);
+
+    switch (command) {
+        case UPIPE_SET_FLOW_DEF: {
+            struct uref *flow_def = va_arg(args, struct uref *);
+            return upipe_hls_sink_set_flow_def(upipe, flow_def);
+        }
+        case UPIPE_REGISTER_REQUEST:
+        case UPIPE_UNREGISTER_REQUEST:
+        case UPIPE_ATTACH_UREF_MGR:
+        case UPIPE_ATTACH_UPUMP_MGR:
+        case UPIPE_ATTACH_UBUF_MGR:
+        case UPIPE_ATTACH_UCLOCK:
+            UBASE_RETURN(upipe_hls_sink_alloc_fsink(upipe));
+            return upipe_control_va(upipe_hls_sink->fsink, command, args);
+
+        case UPIPE_HLS_SINK_SET_FSINK_MGR: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_HLS_SINK_SIGNATURE)
+            struct upipe_mgr *fsink_mgr = va_arg(args, struct upipe_mgr *);
+            upipe_mgr_release(upipe_hls_sink->fsink_mgr);
+            upipe_hls_sink->fsink_mgr = upipe_mgr_use(fsink_mgr);
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_HLS_SINK_SET_PATH: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_HLS_SINK_SIGNATURE)
+            const char *playlist = va_arg(args, const char *);
+            const char *prefix = va_arg(args, const char *);
+            return _upipe_hls_sink_set_path(upipe, playlist, prefix);
+        }
+        case UPIPE_HLS_SINK_GET_PATH: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_HLS_SINK_SIGNATURE)
+            const char **playlist_p = va_arg(args, const char **);
+            const char **prefix_p = va_arg(args, const char **);
+            if (playlist_p != NULL)
+                *playlist_p = upipe_hls_sink->playlist;
+            if (prefix_p != NULL)
+                *prefix_p = upipe_hls_sink->prefix;
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_HLS_SINK_SET_DURATION: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_HLS_SINK_SIGNATURE)
+            uint64_t duration = va_arg(args, uint64_t);
+            uint64_t part = va_arg(args, uint64_t);
+            return _upipe_hls_sink_set_duration(upipe, duration, part);
+        }
+        case UPIPE_HLS_SINK_GET_DURATION: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_HLS_SINK_SIGNATURE)
+            uint64_t *duration_p = va_arg(args, uint64_t *);
+            uint64_t *part_p = va_arg(args, uint64_t *);
+            if (duration_p != NULL)
+                *duration_p = upipe_hls_sink->duration;
+            if (part_p != NULL)
+                *part_p = upipe_hls_sink->part_duration;
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_HLS_SINK_SET_WINDOW: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_HLS_SINK_SIGNATURE)
+            upipe_hls_sink->window = va_arg(args, unsigned int);
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_HLS_SINK_GET_WINDOW: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_HLS_SINK_SIGNATURE)
+            unsigned int *window_p = va_arg(args, unsigned int *);
+            *window_p = upipe_hls_sink->window;
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_HLS_SINK_SET_PID: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_HLS_SINK_SIGNATURE)
+            unsigned int pid = va_arg(args, unsigned int);
+            if (unlikely(pid > UPIPE_HLS_SINK_AUTO_PID))
+                return UBASE_ERR_INVALID;
+            upipe_hls_sink->pid = pid;
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_HLS_SINK_GET_PID: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_HLS_SINK_SIGNATURE)
+            unsigned int *pid_p = va_arg(args, unsigned int *);
+            *pid_p = upipe_hls_sink->pid;
+            return UBASE_ERR_NONE;
+        }
+        default:
+            if (upipe_hls_sink->fsink != NULL)
+                return upipe_control_va(upipe_hls_sink->fsink, command, args);
+            return UBASE_ERR_UNHANDLED;
+    }
+}
+
+/** @internal @This frees all resources allocated.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_hls_sink_free(struct upipe *upipe)
+{
+    struct upipe_hls_sink *upipe_hls_sink = upipe_hls_sink_from_upipe(upipe);
+
+    if (upipe_hls_sink->current != NULL) {
+        upipe_hls_sink_segment_close(upipe);
+        upipe_hls_sink_write_playlist(upipe, true);
+    }
+    upipe_release(upipe_hls_sink->fsink);
+
+    upipe_throw_dead(upipe);
+
+    struct uchain *uchain;
+    while ((uchain = ulist_pop(&upipe_hls_sink->segments)) != NULL)
+        upipe_hls_sink_segment_free(
+            upipe_hls_sink_segment_from_uchain(uchain));
+    while ((uchain = ulist_pop(&upipe_hls_sink->psi)) != NULL) {
+        struct upipe_hls_sink_psi *psi =
+            upipe_hls_sink_psi_from_uchain(uchain);
+        uref_free(psi->uref);
+        uref_free(psi->next);
+        free(psi);
+    }
+    uref_free(upipe_hls_sink->flow_def);
+    upipe_mgr_release(upipe_hls_sink->fsink_mgr);
+    free(upipe_hls_sink->playlist);
+    free(upipe_hls_sink->prefix);
+    free(upipe_hls_sink->dir);
+    upipe_hls_sink_clean_urefcount(upipe);
+    upipe_hls_sink_free_void(upipe);
+}
+
+/** module manager static descriptor */
+static struct upipe_mgr upipe_hls_sink_mgr = {
+    .refcount = NULL,
+    .signature = UPIPE_HLS_SINK_SIGNATURE,
+
+    .upipe_alloc = upipe_hls_sink_alloc,
+    .upipe_input = upipe_hls_sink_input,
+    .upipe_control = upipe_hls_sink_control,
+
+    .upipe_mgr_control = NULL
+};
+
+/** @This returns the management structure for HLS sink pipes.
+ *
+ * @return pointer to manager
+ */
+struct upipe_mgr *upipe_hls_sink_mgr_alloc(void)
+{
+    return &upipe_hls_sink_mgr;
+}
@@ -221,4 +221,4 @@ libupipe_modules-src += \
 
 libupipe_modules-ldlibs = -lm
 libupipe_modules-libs = libupipe
-libupipe_modules-opt-libs = bitstream
+libupipe_modules-opt-libs = bitstream pthread
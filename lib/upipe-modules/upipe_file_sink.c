@@ -12,11 +12,18 @@
  * @short Upipe sink module for files
  */
 
+#define _GNU_SOURCE
+
+#include "upipe/config.h"
 #include "upipe/ubase.h"
+#include "upipe/ulist.h"
 #include "upipe/uclock.h"
 #include "upipe/uref.h"
 #include "upipe/uref_block.h"
 #include "upipe/uref_clock.h"
+#include "upipe/umem.h"
+#include "upipe/umem_pool.h"
+#include "upipe/ubuf_block_mem.h"
 #include "upipe/upump.h"
 #include "upipe/upipe.h"
 #include "upipe/upipe_helper_upipe.h"
@@ -36,18 +43,87 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <assert.h>
 
+#ifdef UPIPE_HAVE_PTHREAD
+#include "upipe/ueventfd.h"
+
+#include <pthread.h>
+#include <poll.h>
+#include <time.h>
+#endif
+
 #ifndef O_CLOEXEC
 #   define O_CLOEXEC 0
 #endif
 
+/** alignment of coalesced blocks, suitable for O_DIRECT */
+#define UPIPE_FSINK_DIRECT_ALIGN 4096
+/** number of coalesced blocks kept in the pool */
+#define UPIPE_FSINK_BLOCK_POOL 4
+
 /** @hidden */
 static void upipe_fsink_watcher(struct upump *upump);
 /** @hidden */
 static bool upipe_fsink_output(struct upipe *upipe, struct uref *uref,
                                struct upump **upump_p);
 
+#ifdef UPIPE_HAVE_PTHREAD
+/** @internal @This is a file descriptor to be closed by the writer thread. */
+struct upipe_fsink_close {
+    /** structure for double-linked lists */
+    struct uchain uchain;
+    /** file descriptor */
+    int fd;
+    /** number of buffers to write before closing */
+    uint64_t after;
+};
+
+UBASE_FROM_TO(upipe_fsink_close, uchain, uchain, uchain)
+
+/** @internal @This is the context shared with the writer thread. */
+struct upipe_fsink_writer {
+    /** writer thread */
+    pthread_t thread;
+    /** protects the fields below */
+    pthread_mutex_t mutex;
+    /** signals new work to the writer thread */
+    pthread_cond_t cond;
+    /** signals that all given buffers were processed */
+    pthread_cond_t drained;
+    /** buffers waiting to be written */
+    struct uchain pending;
+    /** written buffers, to be released by the event loop */
+    struct uchain done;
+    /** file descriptors to close once their buffers are written */
+    struct uchain closes;
+    /** number of buffers given to the writer thread */
+    uint64_t submitted;
+    /** number of buffers processed by the writer thread */
+    uint64_t processed;
+    /** file descriptor of the current file */
+    int fd;
+    /** errno of the first failed write, or 0 */
+    int error;
+    /** true if a sync was requested */
+    bool sync;
+    /** true if the thread must exit after writing pending buffers */
+    bool stop;
+    /** number of completed writes */
+    uint64_t writes;
+    /** duration of the last write */
+    uint64_t last_latency;
+    /** duration of the longest write */
+    uint64_t max_latency;
+    /** cumulated duration of all writes */
+    uint64_t total_latency;
+
+    /** wakes up the event loop when buffers are written */
+    struct ueventfd event;
+};
+#endif
+
 /** @internal @This is the private context of a file sink pipe. */
 struct upipe_fsink {
     /** refcount management structure */
@@ -59,6 +135,8 @@ struct upipe_fsink {
     struct upump *upump;
     /** sync watcher */
     struct upump *upump_sync;
+    /** writer thread completion watcher */
+    struct upump *upump_async;
 
     /** uclock structure, if not NULL we are in live mode */
     struct uclock *uclock;
@@ -74,6 +152,40 @@ struct upipe_fsink {
     /** sync period */
     uint64_t sync_period;
 
+    /** size of coalesced blocks, or 0 */
+    unsigned int coalesce_size;
+    /** true if O_DIRECT is requested for coalesced blocks */
+    bool direct;
+    /** true if O_DIRECT is currently set on the file descriptor */
+    bool direct_active;
+    /** ubuf manager for coalesced blocks */
+    struct ubuf_mgr *block_mgr;
+    /** block being coalesced */
+    struct uref *block;
+    /** buffer of the block being coalesced, while it is mapped */
+    uint8_t *block_buffer;
+    /** number of octets in the block being coalesced */
+    unsigned int block_fill;
+    /** size to preallocate when opening a file, or 0 */
+    uint64_t preallocate;
+
+    /** byte budget of the writer thread, or 0 */
+    uint64_t async_budget;
+    /** number of buffers given to the writer thread */
+    unsigned int queue_depth;
+    /** number of bytes given to the writer thread */
+    uint64_t queued_bytes;
+    /** highest number of bytes given to the writer thread */
+    uint64_t max_queued_bytes;
+#ifdef UPIPE_HAVE_PTHREAD
+    /** true if the writer thread is running */
+    bool writer_running;
+    /** true if the writer thread reported an error */
+    bool writer_failed;
+    /** context shared with the writer thread */
+    struct upipe_fsink_writer writer;
+#endif
+
     /** temporary uref storage */
     struct uchain urefs;
     /** nb urefs in storage */
@@ -93,6 +205,7 @@ UPIPE_HELPER_VOID(upipe_fsink)
 UPIPE_HELPER_UPUMP_MGR(upipe_fsink, upump_mgr)
 UPIPE_HELPER_UPUMP(upipe_fsink, upump, upump_mgr)
 UPIPE_HELPER_UPUMP(upipe_fsink, upump_sync, upump_mgr)
+UPIPE_HELPER_UPUMP(upipe_fsink, upump_async, upump_mgr)
 UPIPE_HELPER_INPUT(upipe_fsink, urefs, nb_urefs, max_urefs, blockers, upipe_fsink_output)
 UPIPE_HELPER_UCLOCK(upipe_fsink, uclock, uclock_request, NULL, upipe_throw_provide_request, NULL)
 
@@ -117,83 +230,562 @@ static struct upipe *upipe_fsink_alloc(struct upipe_mgr *mgr,
     upipe_fsink_init_upump_mgr(upipe);
     upipe_fsink_init_upump(upipe);
     upipe_fsink_init_upump_sync(upipe);
+    upipe_fsink_init_upump_async(upipe);
     upipe_fsink_init_input(upipe);
     upipe_fsink_init_uclock(upipe);
     upipe_fsink->latency = 0;
     upipe_fsink->fd = -1;
     upipe_fsink->path = NULL;
     upipe_fsink->sync_period = 0;
+    upipe_fsink->coalesce_size = 0;
+    upipe_fsink->direct = false;
+    upipe_fsink->direct_active = false;
+    upipe_fsink->block_mgr = NULL;
+    upipe_fsink->block = NULL;
+    upipe_fsink->block_buffer = NULL;
+    upipe_fsink->block_fill = 0;
+    upipe_fsink->preallocate = 0;
+    upipe_fsink->async_budget = 0;
+    upipe_fsink->queue_depth = 0;
+    upipe_fsink->queued_bytes = 0;
+    upipe_fsink->max_queued_bytes = 0;
+#ifdef UPIPE_HAVE_PTHREAD
+    upipe_fsink->writer_running = false;
+    upipe_fsink->writer_failed = false;
+#endif
     upipe_throw_ready(upipe);
     return upipe;
 }
 
-/** @This starts the watcher waiting for the sink to unblock.
+#ifdef UPIPE_HAVE_PTHREAD
+/** @internal @This returns the current monotonic time.
+ *
+ * @return current time in units of UCLOCK_FREQ
+ */
+static uint64_t upipe_fsink_writer_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * UCLOCK_FREQ +
+           (uint64_t)ts.tv_nsec * UCLOCK_FREQ / UINT64_C(1000000000);
+}
+
+/** @internal @This checks if the writer thread was asked to exit.
+ *
+ * @param writer context shared with the writer thread
+ * @return true if the thread must exit
+ */
+static bool upipe_fsink_writer_stopping(struct upipe_fsink_writer *writer)
+{
+    pthread_mutex_lock(&writer->mutex);
+    bool stop = writer->stop;
+    pthread_mutex_unlock(&writer->mutex);
+    return stop;
+}
+
+/** @internal @This writes a buffer from the writer thread, waiting for the
+ * file descriptor if needed.
+ *
+ * @param writer context shared with the writer thread
+ * @param fd file descriptor the buffer was submitted for
+ * @param uref buffer to write
+ * @return 0, or an errno value
+ */
+static int upipe_fsink_writer_write(struct upipe_fsink_writer *writer,
+                                    int fd, struct uref *uref)
+{
+    int iovec_count = uref_block_iovec_count(uref, 0, -1);
+    if (unlikely(iovec_count == -1))
+        return EINVAL;
+    if (unlikely(iovec_count == 0))
+        return 0;
+
+    struct iovec iovecs[iovec_count];
+    if (unlikely(!ubase_check(uref_block_iovec_read(uref, 0, -1, iovecs))))
+        return EINVAL;
+
+    /* iovecs must be given back unchanged to the unmap function */
+    struct iovec remaining[iovec_count];
+    memcpy(remaining, iovecs, sizeof(iovecs));
+    struct iovec *iov = remaining;
+    int count = iovec_count;
+    int error = 0;
+    while (count > 0) {
+        ssize_t ret = writev(fd, iov, count);
+        if (unlikely(ret == -1)) {
+            switch (errno) {
+                case EINTR:
+                    continue;
+                case EAGAIN:
+#if EAGAIN != EWOULDBLOCK
+                case EWOULDBLOCK:
+#endif
+                {
+                    struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+                    if (poll(&pfd, 1, 100) == 0 &&
+                        upipe_fsink_writer_stopping(writer)) {
+                        error = EAGAIN;
+                        break;
+                    }
+                    continue;
+                }
+                default:
+                    error = errno;
+                    break;
+            }
+            break;
+        }
+
+        while (count > 0 && ret >= iov->iov_len) {
+            ret -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (uint8_t *)iov->iov_base + ret;
+            iov->iov_len -= ret;
+        }
+    }
+    uref_block_iovec_unmap(uref, 0, -1, iovecs);
+    return error;
+}
+
+/** @internal @This is the main loop of the writer thread.
+ *
+ * @param opaque context shared with the writer thread
+ * @return NULL
+ */
+static void *upipe_fsink_writer_run(void *opaque)
+{
+    struct upipe_fsink_writer *writer = opaque;
+
+    pthread_mutex_lock(&writer->mutex);
+    for ( ; ; ) {
+        struct uchain *uchain = ulist_peek(&writer->closes);
+        if (uchain != NULL && upipe_fsink_close_from_uchain(uchain)->after <=
+                              writer->processed) {
+            /* all buffers of the previous file are written */
+            ulist_pop(&writer->closes);
+            pthread_mutex_unlock(&writer->mutex);
+            struct upipe_fsink_close *close_fd =
+                upipe_fsink_close_from_uchain(uchain);
+            close(close_fd->fd);
+            free(close_fd);
+            pthread_mutex_lock(&writer->mutex);
+            continue;
+        }
+
+        if (unlikely(writer->sync)) {
+            writer->sync = false;
+            int fd = writer->fd;
+            pthread_mutex_unlock(&writer->mutex);
+            if (fd != -1)
+#if defined(_POSIX_SYNCHRONIZED_IO) && _POSIX_SYNCHRONIZED_IO > 0
+                fdatasync(fd);
+#else
+                fsync(fd);
+#endif
+            pthread_mutex_lock(&writer->mutex);
+            continue;
+        }
+
+        uchain = ulist_pop(&writer->pending);
+        if (uchain == NULL) {
+            if (writer->stop)
+                break;
+            pthread_cond_wait(&writer->cond, &writer->mutex);
+            continue;
+        }
+        struct uref *uref = uref_from_uchain(uchain);
+        int fd = uref->priv;
+        /* errors on a previous file are not reported on the current one */
+        bool current = fd == writer->fd;
+        bool failed = current && writer->error != 0;
+        pthread_mutex_unlock(&writer->mutex);
+
+        int error = 0;
+        uint64_t latency = 0;
+        if (likely(!failed)) {
+            uint64_t start = upipe_fsink_writer_now();
+            error = upipe_fsink_writer_write(writer, fd, uref);
+            latency = upipe_fsink_writer_now() - start;
+        }
+
+        pthread_mutex_lock(&writer->mutex);
+        writer->processed++;
+        if (writer->processed == writer->submitted)
+            pthread_cond_signal(&writer->drained);
+        if (unlikely(error && current && !writer->error))
+            writer->error = error;
+        if (likely(!failed)) {
+            writer->writes++;
+            writer->last_latency = latency;
+            if (latency > writer->max_latency)
+                writer->max_latency = latency;
+            writer->total_latency += latency;
+        }
+        ulist_add(&writer->done, uchain);
+        pthread_mutex_unlock(&writer->mutex);
+        ueventfd_write(&writer->event);
+        pthread_mutex_lock(&writer->mutex);
+    }
+    pthread_mutex_unlock(&writer->mutex);
+    return NULL;
+}
+
+/** @internal @This releases the buffers written by the writer thread.
  *
  * @param upipe description structure of the pipe
+ * @return errno of the first failed write, or 0
  */
-static void upipe_fsink_poll(struct upipe *upipe)
+static int upipe_fsink_writer_collect(struct upipe *upipe)
+{
+    struct upipe_fsink *upipe_fsink = upipe_fsink_from_upipe(upipe);
+    struct upipe_fsink_writer *writer = &upipe_fsink->writer;
+    struct uchain done;
+    ulist_init(&done);
+
+    pthread_mutex_lock(&writer->mutex);
+    struct uchain *uchain;
+    while ((uchain = ulist_pop(&writer->done)) != NULL)
+        ulist_add(&done, uchain);
+    int error = writer->error;
+    pthread_mutex_unlock(&writer->mutex);
+
+    while ((uchain = ulist_pop(&done)) != NULL) {
+        struct uref *uref = uref_from_uchain(uchain);
+        size_t size = 0;
+        uref_block_size(uref, &size);
+        upipe_fsink->queued_bytes -= size;
+        upipe_fsink->queue_depth--;
+        uref_free(uref);
+    }
+    return error;
+}
+
+/** @internal @This lets the completion watcher keep the event loop alive
+ * only while buffers are queued or the input is held.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_fsink_writer_status(struct upipe *upipe)
+{
+    struct upipe_fsink *upipe_fsink = upipe_fsink_from_upipe(upipe);
+    if (upipe_fsink->upump_async != NULL)
+        upump_set_status(upipe_fsink->upump_async,
+                         upipe_fsink->queue_depth ||
+                         !upipe_fsink_check_input(upipe));
+}
+
+/** @internal @This is called when the writer thread has written buffers.
+ *
+ * @param upump description structure of the watcher
+ */
+static void upipe_fsink_writer_done(struct upump *upump)
+{
+    struct upipe *upipe = upump_get_opaque(upump, struct upipe *);
+    struct upipe_fsink *upipe_fsink = upipe_fsink_from_upipe(upipe);
+    ueventfd_read(&upipe_fsink->writer.event);
+
+    int error = upipe_fsink_writer_collect(upipe);
+    if (unlikely(error && !upipe_fsink->writer_failed)) {
+        upipe_fsink->writer_failed = true;
+        upipe_warn_va(upipe, "write error to %s (%s)", upipe_fsink->path,
+                      strerror(error));
+        upipe_fsink_set_upump_sync(upipe, NULL);
+        upipe_throw_sink_end(upipe);
+    }
+
+    if (upipe_fsink_check_input(upipe)) {
+        upipe_fsink_writer_status(upipe);
+        return;
+    }
+    upipe_fsink_output_input(upipe);
+    upipe_fsink_unblock_input(upipe);
+    upipe_fsink_writer_status(upipe);
+    if (upipe_fsink_check_input(upipe))
+        /* All packets have been output, release again the pipe that has been
+         * used in @ref upipe_fsink_input. */
+        upipe_release(upipe);
+}
+
+/** @internal @This starts the writer thread if a budget is configured and a
+ * file is opened.
+ *
+ * @param upipe description structure of the pipe
+ * @return an error code
+ */
+static int upipe_fsink_start_writer(struct upipe *upipe)
 {
     struct upipe_fsink *upipe_fsink = upipe_fsink_from_upipe(upipe);
+    struct upipe_fsink_writer *writer = &upipe_fsink->writer;
+    if (upipe_fsink->writer_running) {
+        /* the thread is kept across files */
+        pthread_mutex_lock(&writer->mutex);
+        writer->fd = upipe_fsink->fd;
+        writer->error = 0;
+        pthread_mutex_unlock(&writer->mutex);
+        upipe_fsink->writer_failed = false;
+        return UBASE_ERR_NONE;
+    }
+    if (!upipe_fsink->async_budget || upipe_fsink->fd == -1)
+        return UBASE_ERR_NONE;
+
     if (unlikely(!ubase_check(upipe_fsink_check_upump_mgr(upipe)))) {
         upipe_err_va(upipe, "can't get upump_mgr");
-        upipe_throw_fatal(upipe, UBASE_ERR_UPUMP);
-        return;
+        return UBASE_ERR_UPUMP;
     }
-    struct upump *watcher = upump_alloc_fd_write(upipe_fsink->upump_mgr,
-            upipe_fsink_watcher, upipe, upipe->refcount, upipe_fsink->fd);
-    if (unlikely(watcher == NULL)) {
+    if (unlikely(!ueventfd_init(&writer->event, false))) {
+        upipe_err(upipe, "can't create eventfd");
+        return UBASE_ERR_EXTERNAL;
+    }
+    struct upump *upump = ueventfd_upump_alloc(&writer->event,
+            upipe_fsink->upump_mgr, upipe_fsink_writer_done, upipe,
+            upipe->refcount);
+    if (unlikely(upump == NULL)) {
+        ueventfd_clean(&writer->event);
         upipe_err(upipe, "can't create watcher");
-        upipe_throw_fatal(upipe, UBASE_ERR_UPUMP);
-    } else {
-        upipe_fsink_set_upump(upipe, watcher);
-        upump_start(watcher);
+        return UBASE_ERR_UPUMP;
+    }
+
+    ulist_init(&writer->pending);
+    ulist_init(&writer->done);
+    ulist_init(&writer->closes);
+    writer->submitted = 0;
+    writer->processed = 0;
+    writer->fd = upipe_fsink->fd;
+    writer->error = 0;
+    writer->sync = false;
+    writer->stop = false;
+    writer->writes = 0;
+    writer->last_latency = 0;
+    writer->max_latency = 0;
+    writer->total_latency = 0;
+    pthread_mutex_init(&writer->mutex, NULL);
+    pthread_cond_init(&writer->cond, NULL);
+    pthread_cond_init(&writer->drained, NULL);
+    if (unlikely(pthread_create(&writer->thread, NULL,
+                                upipe_fsink_writer_run, writer) != 0)) {
+        pthread_cond_destroy(&writer->drained);
+        pthread_cond_destroy(&writer->cond);
+        pthread_mutex_destroy(&writer->mutex);
+        upump_free(upump);
+        ueventfd_clean(&writer->event);
+        upipe_err(upipe, "can't create writer thread");
+        return UBASE_ERR_EXTERNAL;
     }
+
+    upipe_fsink_set_upump_async(upipe, upump);
+    upump_start(upump);
+    upipe_fsink_writer_status(upipe);
+    upipe_fsink->writer_running = true;
+    upipe_fsink->writer_failed = false;
+    upipe_fsink->max_queued_bytes = 0;
+    return UBASE_ERR_NONE;
 }
 
-/** @internal @This outputs data to the file sink.
+/** @internal @This waits for the writer thread to write pending buffers,
+ * and stops it.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_fsink_stop_writer(struct upipe *upipe)
+{
+    struct upipe_fsink *upipe_fsink = upipe_fsink_from_upipe(upipe);
+    struct upipe_fsink_writer *writer = &upipe_fsink->writer;
+    if (!upipe_fsink->writer_running)
+        return;
+
+    pthread_mutex_lock(&writer->mutex);
+    writer->stop = true;
+    pthread_cond_signal(&writer->cond);
+    pthread_mutex_unlock(&writer->mutex);
+    pthread_join(writer->thread, NULL);
+
+    int error = upipe_fsink_writer_collect(upipe);
+    if (unlikely(error && !upipe_fsink->writer_failed))
+        upipe_warn_va(upipe, "write error to %s (%s)", upipe_fsink->path,
+                      strerror(error));
+    upipe_dbg_va(upipe, "writer thread: %"PRIu64" writes, max latency %"
+                 PRIu64" us, max queued %"PRIu64" bytes", writer->writes,
+                 writer->max_latency * 1000000 / UCLOCK_FREQ,
+                 upipe_fsink->max_queued_bytes);
+
+    upipe_fsink_set_upump_async(upipe, NULL);
+    ueventfd_clean(&writer->event);
+    pthread_cond_destroy(&writer->drained);
+    pthread_cond_destroy(&writer->cond);
+    pthread_mutex_destroy(&writer->mutex);
+    upipe_fsink->writer_running = false;
+}
+
+/** @internal @This waits for the writer thread to write the buffers given
+ * so far, so that the file offset is up to date and the flags of the file
+ * descriptor may be changed without affecting pending writes.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_fsink_writer_drain(struct upipe *upipe)
+{
+    struct upipe_fsink *upipe_fsink = upipe_fsink_from_upipe(upipe);
+    struct upipe_fsink_writer *writer = &upipe_fsink->writer;
+    if (!upipe_fsink->writer_running)
+        return;
+
+    pthread_mutex_lock(&writer->mutex);
+    while (writer->processed != writer->submitted)
+        pthread_cond_wait(&writer->drained, &writer->mutex);
+    pthread_mutex_unlock(&writer->mutex);
+
+    /* errors are reported by the completion watcher */
+    upipe_fsink_writer_collect(upipe);
+    upipe_fsink_writer_status(upipe);
+}
+
+/** @internal @This gives a buffer to the writer thread.
  *
  * @param upipe description structure of the pipe
  * @param uref uref structure
- * @param upump_p reference to pump that generated the buffer
+ * @param force true to ignore the byte budget
  * @return true if the uref was processed
  */
-static bool upipe_fsink_output(struct upipe *upipe, struct uref *uref,
-                               struct upump **upump_p)
+static bool upipe_fsink_submit(struct upipe *upipe, struct uref *uref,
+                               bool force)
 {
     struct upipe_fsink *upipe_fsink = upipe_fsink_from_upipe(upipe);
-    const char *def;
-    if (unlikely(ubase_check(uref_flow_get_def(uref, &def)))) {
-        uint64_t latency = 0;
-        uref_clock_get_latency(uref, &latency);
-        if (latency > upipe_fsink->latency)
-            upipe_fsink->latency = latency;
+    struct upipe_fsink_writer *writer = &upipe_fsink->writer;
+    if (unlikely(upipe_fsink->writer_failed)) {
         uref_free(uref);
         return true;
     }
 
-    if (unlikely(upipe_fsink->fd == -1)) {
+    size_t size;
+    if (unlikely(!ubase_check(uref_block_size(uref, &size)))) {
         uref_free(uref);
-        upipe_warn(upipe, "received a buffer before opening a file");
+        upipe_warn(upipe, "cannot read ubuf buffer");
         return true;
     }
+    if (!force && upipe_fsink->queued_bytes &&
+        upipe_fsink->queued_bytes + size > upipe_fsink->async_budget)
+        /* wait for the writer thread to complete pending writes */
+        return false;
 
-    if (likely(upipe_fsink->uclock == NULL))
-        goto write_buffer;
+    uref->priv = upipe_fsink->fd;
+    pthread_mutex_lock(&writer->mutex);
+    ulist_add(&writer->pending, uref_to_uchain(uref));
+    writer->submitted++;
+    pthread_cond_signal(&writer->cond);
+    pthread_mutex_unlock(&writer->mutex);
 
-    uint64_t cr_sys = 0;
-    if (unlikely(!ubase_check(uref_clock_get_cr_sys(uref, &cr_sys)))) {
-        upipe_warn(upipe, "received non-dated buffer");
-        goto write_buffer;
-    }
+    upipe_fsink->queue_depth++;
+    upipe_fsink->queued_bytes += size;
+    if (upipe_fsink->queued_bytes > upipe_fsink->max_queued_bytes)
+        upipe_fsink->max_queued_bytes = upipe_fsink->queued_bytes;
+    upipe_fsink_writer_status(upipe);
+    return true;
+}
 
-    uint64_t now = uclock_now(upipe_fsink->uclock);
-    cr_sys += upipe_fsink->latency;
-    if (unlikely(now < cr_sys)) {
-        upipe_fsink_wait_upump(upipe, cr_sys - now, upipe_fsink_watcher);
+/** @internal @This hands the file descriptor of the current file to the
+ * writer thread, which closes it once its pending buffers are written.
+ *
+ * @param upipe description structure of the pipe
+ * @return false if the file descriptor must be closed by the caller
+ */
+static bool upipe_fsink_writer_close(struct upipe *upipe)
+{
+    struct upipe_fsink *upipe_fsink = upipe_fsink_from_upipe(upipe);
+    struct upipe_fsink_writer *writer = &upipe_fsink->writer;
+    if (!upipe_fsink->writer_running)
+        return false;
+
+    struct upipe_fsink_close *close_fd = malloc(sizeof(*close_fd));
+    if (unlikely(close_fd == NULL)) {
+        /* fall back to waiting for the pending buffers */
+        upipe_fsink_stop_writer(upipe);
         return false;
     }
+    uchain_init(upipe_fsink_close_to_uchain(close_fd));
+    close_fd->fd = upipe_fsink->fd;
+
+    pthread_mutex_lock(&writer->mutex);
+    close_fd->after = writer->submitted;
+    ulist_add(&writer->closes, upipe_fsink_close_to_uchain(close_fd));
+    writer->fd = -1;
+    pthread_cond_signal(&writer->cond);
+    pthread_mutex_unlock(&writer->mutex);
+    upipe_fsink->fd = -1;
+    return true;
+}
+#endif
+
+/** @internal @This closes the current file, if any.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_fsink_close_file(struct upipe *upipe)
+{
+    struct upipe_fsink *upipe_fsink = upipe_fsink_from_upipe(upipe);
+    if (unlikely(upipe_fsink->fd == -1))
+        return;
+    if (likely(upipe_fsink->path != NULL))
+        upipe_notice_va(upipe, "closing file %s", upipe_fsink->path);
+#ifdef UPIPE_HAVE_PTHREAD
+    if (upipe_fsink_writer_close(upipe))
+        return;
+#endif
+    ubase_clean_fd(&upipe_fsink->fd);
+}
+
+/** @This starts the watcher waiting for the sink to unblock.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_fsink_poll(struct upipe *upipe)
+{
+    struct upipe_fsink *upipe_fsink = upipe_fsink_from_upipe(upipe);
+#ifdef UPIPE_HAVE_PTHREAD
+    if (upipe_fsink->writer_running) {
+        /* the input is unblocked by the completion watcher, wake it up if
+         * no write is pending */
+        if (!upipe_fsink->queue_depth)
+            ueventfd_write(&upipe_fsink->writer.event);
+        upump_set_status(upipe_fsink->upump_async, true);
+        return;
+    }
+#endif
+    if (unlikely(!ubase_check(upipe_fsink_check_upump_mgr(upipe)))) {
+        upipe_err_va(upipe, "can't get upump_mgr");
+        upipe_throw_fatal(upipe, UBASE_ERR_UPUMP);
+        return;
+    }
+    struct upump *watcher = upump_alloc_fd_write(upipe_fsink->upump_mgr,
+            upipe_fsink_watcher, upipe, upipe->refcount, upipe_fsink->fd);
+    if (unlikely(watcher == NULL)) {
+        upipe_err(upipe, "can't create watcher");
+        upipe_throw_fatal(upipe, UBASE_ERR_UPUMP);
+    } else {
+        upipe_fsink_set_upump(upipe, watcher);
+        upump_start(watcher);
+    }
+}
+
+/** @internal @This writes a buffer to the file, or gives it to the writer
+ * thread.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref uref structure
+ * @param force true to ignore the byte budget of the writer thread
+ * @return true if the uref was processed
+ */
+static bool upipe_fsink_write(struct upipe *upipe, struct uref *uref,
+                              bool force)
+{
+    struct upipe_fsink *upipe_fsink = upipe_fsink_from_upipe(upipe);
+#ifdef UPIPE_HAVE_PTHREAD
+    if (upipe_fsink->writer_running)
+        return upipe_fsink_submit(upipe, uref, force);
+#endif
 
-write_buffer:
     for ( ; ; ) {
         int iovec_count = uref_block_iovec_count(uref, 0, -1);
         if (unlikely(iovec_count == -1)) {
@@ -255,6 +847,200 @@ write_buffer:
     return true;
 }
 
+/** @internal @This unmaps the block being coalesced, before it is written
+ * or freed.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_fsink_unmap_block(struct upipe *upipe)
+{
+    struct upipe_fsink *upipe_fsink = upipe_fsink_from_upipe(upipe);
+    if (upipe_fsink->block_buffer != NULL) {
+        uref_block_unmap(upipe_fsink->block, 0);
+        upipe_fsink->block_buffer = NULL;
+    }
+}
+
+/** @internal @This copies data into coalesced blocks, and writes the blocks
+ * when they are full.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref uref structure
+ * @return true if the uref was processed
+ */
+static bool upipe_fsink_coalesce(struct upipe *upipe, struct uref *uref)
+{
+    struct upipe_fsink *upipe_fsink = upipe_fsink_from_upipe(upipe);
+
+    for ( ; ; ) {
+        if (upipe_fsink->block != NULL &&
+            upipe_fsink->block_fill == upipe_fsink->coalesce_size) {
+            upipe_fsink_unmap_block(upipe);
+            if (!upipe_fsink_write(upipe, upipe_fsink->block, false))
+                return false;
+            upipe_fsink->block = NULL;
+        }
+
+        size_t size;
+        if (unlikely(!ubase_check(uref_block_size(uref, &size)) ||
+                     !size)) {
+            uref_free(uref);
+            return true;
+        }
+
+        if (upipe_fsink->block == NULL) {
+            struct uref *block = uref_block_alloc(uref->mgr,
+                    upipe_fsink->block_mgr, upipe_fsink->coalesce_size);
+            int block_size = -1;
+            if (unlikely(block == NULL ||
+                         !ubase_check(uref_block_write(block, 0, &block_size,
+                                 &upipe_fsink->block_buffer)))) {
+                upipe_fsink->block_buffer = NULL;
+                if (block != NULL)
+                    uref_free(block);
+                uref_free(uref);
+                upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+                return true;
+            }
+            /* the block stays mapped until it is full or flushed */
+            upipe_fsink->block = block;
+            upipe_fsink->block_fill = 0;
+        }
+
+        size_t chunk = upipe_fsink->coalesce_size - upipe_fsink->block_fill;
+        if (chunk > size)
+            chunk = size;
+        uref_block_extract(uref, 0, chunk,
+                upipe_fsink->block_buffer + upipe_fsink->block_fill);
+        upipe_fsink->block_fill += chunk;
+        if (chunk == size) {
+            /* a full block is written with the next buffer, or on close */
+            uref_free(uref);
+            return true;
+        }
+        uref_block_resize(uref, chunk, -1);
+    }
+}
+
+/** @internal @This writes the partial coalesced block, if any.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_fsink_flush_block(struct upipe *upipe)
+{
+    struct upipe_fsink *upipe_fsink = upipe_fsink_from_upipe(upipe);
+    struct uref *block = upipe_fsink->block;
+    if (block == NULL)
+        return;
+    upipe_fsink_unmap_block(upipe);
+    upipe_fsink->block = NULL;
+
+    if (unlikely(upipe_fsink->fd == -1 || !upipe_fsink->block_fill)) {
+        uref_free(block);
+        return;
+    }
+    uref_block_resize(block, 0, upipe_fsink->block_fill);
+
+    if (upipe_fsink->direct_active &&
+        upipe_fsink->block_fill % UPIPE_FSINK_DIRECT_ALIGN) {
+        /* O_DIRECT requires aligned sizes, write the tail through the page
+         * cache */
+        int flags = fcntl(upipe_fsink->fd, F_GETFL);
+        if (flags != -1)
+            fcntl(upipe_fsink->fd, F_SETFL, flags & ~O_DIRECT);
+        upipe_fsink->direct_active = false;
+    }
+
+    if (unlikely(!upipe_fsink_write(upipe, block, true))) {
+        uref_free(block);
+        upipe_warn_va(upipe, "dropping %u octets on %s",
+                      upipe_fsink->block_fill, upipe_fsink->path);
+    }
+}
+
+/** @internal @This configures a newly opened file for O_DIRECT and
+ * preallocation, if requested.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_fsink_setup_file(struct upipe *upipe)
+{
+    struct upipe_fsink *upipe_fsink = upipe_fsink_from_upipe(upipe);
+    /* no buffer is queued yet on the new file, so the offset is exact */
+    off_t offset = lseek(upipe_fsink->fd, 0, SEEK_CUR);
+
+    upipe_fsink->direct_active = false;
+    if (upipe_fsink->coalesce_size && upipe_fsink->direct) {
+        int flags = fcntl(upipe_fsink->fd, F_GETFL);
+        if (offset == -1 || offset % UPIPE_FSINK_DIRECT_ALIGN)
+            upipe_warn(upipe, "unaligned file offset, not using O_DIRECT");
+        else if (flags == -1 ||
+                 fcntl(upipe_fsink->fd, F_SETFL, flags | O_DIRECT) == -1)
+            upipe_warn(upipe, "O_DIRECT not supported, using page cache");
+        else
+            upipe_fsink->direct_active = true;
+    }
+
+    if (upipe_fsink->preallocate && offset != -1) {
+#ifdef FALLOC_FL_KEEP_SIZE
+        /* keep the file size so that the unused part is not visible */
+        if (unlikely(fallocate(upipe_fsink->fd, FALLOC_FL_KEEP_SIZE, offset,
+                               upipe_fsink->preallocate) == -1))
+            upipe_dbg_va(upipe, "can't preallocate %"PRIu64" octets (%m)",
+                         upipe_fsink->preallocate);
+#endif
+    }
+}
+
+/** @internal @This outputs data to the file sink.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref uref structure
+ * @param upump_p reference to pump that generated the buffer
+ * @return true if the uref was processed
+ */
+static bool upipe_fsink_output(struct upipe *upipe, struct uref *uref,
+                               struct upump **upump_p)
+{
+    struct upipe_fsink *upipe_fsink = upipe_fsink_from_upipe(upipe);
+    const char *def;
+    if (unlikely(ubase_check(uref_flow_get_def(uref, &def)))) {
+        uint64_t latency = 0;
+        uref_clock_get_latency(uref, &latency);
+        if (latency > upipe_fsink->latency)
+            upipe_fsink->latency = latency;
+        uref_free(uref);
+        return true;
+    }
+
+    if (unlikely(upipe_fsink->fd == -1)) {
+        uref_free(uref);
+        upipe_warn(upipe, "received a buffer before opening a file");
+        return true;
+    }
+
+    if (likely(upipe_fsink->uclock == NULL))
+        goto write_buffer;
+
+    uint64_t cr_sys = 0;
+    if (unlikely(!ubase_check(uref_clock_get_cr_sys(uref, &cr_sys)))) {
+        upipe_warn(upipe, "received non-dated buffer");
+        goto write_buffer;
+    }
+
+    uint64_t now = uclock_now(upipe_fsink->uclock);
+    cr_sys += upipe_fsink->latency;
+    if (unlikely(now < cr_sys)) {
+        upipe_fsink_wait_upump(upipe, cr_sys - now, upipe_fsink_watcher);
+        return false;
+    }
+
+write_buffer:
+    if (upipe_fsink->coalesce_size)
+        return upipe_fsink_coalesce(upipe, uref);
+    return upipe_fsink_write(upipe, uref, false);
+}
+
 /** @internal @This is called when the file descriptor can be written again.
  * Unblock the sink and unqueue all queued buffers.
  *
@@ -281,6 +1067,16 @@ static void upipe_fsink_sync(struct upump *upump)
 {
     struct upipe *upipe = upump_get_opaque(upump, struct upipe *);
     struct upipe_fsink *upipe_fsink = upipe_fsink_from_upipe(upipe);
+#ifdef UPIPE_HAVE_PTHREAD
+    if (upipe_fsink->writer_running) {
+        struct upipe_fsink_writer *writer = &upipe_fsink->writer;
+        pthread_mutex_lock(&writer->mutex);
+        writer->sync = true;
+        pthread_cond_signal(&writer->cond);
+        pthread_mutex_unlock(&writer->mutex);
+        return;
+    }
+#endif
     if (likely(upipe_fsink->fd != -1))
 #if defined(_POSIX_SYNCHRONIZED_IO) && _POSIX_SYNCHRONIZED_IO > 0
         fdatasync(upipe_fsink->fd);
@@ -369,12 +1165,8 @@ static int _upipe_fsink_set_path(struct upipe *upipe, const char *path,
                                  enum upipe_fsink_mode mode)
 {
     struct upipe_fsink *upipe_fsink = upipe_fsink_from_upipe(upipe);
-
-    if (unlikely(upipe_fsink->fd != -1)) {
-        if (likely(upipe_fsink->path != NULL))
-            upipe_notice_va(upipe, "closing file %s", upipe_fsink->path);
-        ubase_clean_fd(&upipe_fsink->fd);
-    }
+    upipe_fsink_flush_block(upipe);
+    upipe_fsink_close_file(upipe);
     ubase_clean_str(&upipe_fsink->path);
     upipe_fsink_set_upump(upipe, NULL);
     upipe_fsink_set_upump_sync(upipe, NULL);
@@ -439,7 +1231,12 @@ static int _upipe_fsink_set_path(struct upipe *upipe, const char *path,
         upipe_use(upipe);
     upipe_notice_va(upipe, "opening file %s in %s mode",
                     upipe_fsink->path, mode_desc);
+    upipe_fsink_setup_file(upipe);
+#ifdef UPIPE_HAVE_PTHREAD
+    return upipe_fsink_start_writer(upipe);
+#else
     return UBASE_ERR_NONE;
+#endif
 }
 
 /** @internal @This associates file descriptor..
@@ -453,12 +1250,8 @@ static int _upipe_fsink_set_fd(struct upipe *upipe, int fd,
                                enum upipe_fsink_mode mode)
 {
     struct upipe_fsink *upipe_fsink = upipe_fsink_from_upipe(upipe);
-
-    if (unlikely(upipe_fsink->fd != -1)) {
-        if (likely(upipe_fsink->path != NULL))
-            upipe_notice_va(upipe, "closing file %s", upipe_fsink->path);
-        ubase_clean_fd(&upipe_fsink->fd);
-    }
+    upipe_fsink_flush_block(upipe);
+    upipe_fsink_close_file(upipe);
     ubase_clean_str(&upipe_fsink->path);
     upipe_fsink_set_upump(upipe, NULL);
     upipe_fsink_set_upump_sync(upipe, NULL);
@@ -507,7 +1300,12 @@ static int _upipe_fsink_set_fd(struct upipe *upipe, int fd,
         upipe_use(upipe);
     upipe_notice_va(upipe, "opening file %s in %s mode",
                     upipe_fsink->path, mode_desc);
+    upipe_fsink_setup_file(upipe);
+#ifdef UPIPE_HAVE_PTHREAD
+    return upipe_fsink_start_writer(upipe);
+#else
     return UBASE_ERR_NONE;
+#endif
 }
 
 /** @internal @This returns the file descriptor of the currently opened file.
@@ -551,6 +1349,120 @@ static int _upipe_fsink_get_sync_period(struct upipe *upipe, uint64_t *p)
     return UBASE_ERR_NONE;
 }
 
+/** @internal @This sets the size of coalesced blocks.
+ *
+ * @param upipe description structure of the pipe
+ * @param size size of coalesced blocks, or 0 to write buffers as they come
+ * @param direct true to write coalesced blocks with O_DIRECT
+ * @return an error code
+ */
+static int _upipe_fsink_set_coalesce(struct upipe *upipe, unsigned int size,
+                                     bool direct)
+{
+    struct upipe_fsink *upipe_fsink = upipe_fsink_from_upipe(upipe);
+    size = (size + UPIPE_FSINK_DIRECT_ALIGN - 1) &
+           ~(UPIPE_FSINK_DIRECT_ALIGN - 1);
+
+    upipe_fsink_flush_block(upipe);
+    ubuf_mgr_release(upipe_fsink->block_mgr);
+    upipe_fsink->block_mgr = NULL;
+    upipe_fsink->coalesce_size = 0;
+    upipe_fsink->direct = direct;
+    if (upipe_fsink->direct_active) {
+        int flags = fcntl(upipe_fsink->fd, F_GETFL);
+        if (flags != -1)
+            fcntl(upipe_fsink->fd, F_SETFL, flags & ~O_DIRECT);
+        upipe_fsink->direct_active = false;
+    }
+    if (!size)
+        return UBASE_ERR_NONE;
+
+    size_t pool_size = 1;
+    while (pool_size < size + UPIPE_FSINK_DIRECT_ALIGN)
+        pool_size <<= 1;
+    struct umem_mgr *umem_mgr = umem_pool_mgr_alloc(pool_size, 1,
+                                                    UPIPE_FSINK_BLOCK_POOL);
+    UBASE_ALLOC_RETURN(umem_mgr)
+    upipe_fsink->block_mgr = ubuf_block_mem_mgr_alloc(UPIPE_FSINK_BLOCK_POOL,
+            UPIPE_FSINK_BLOCK_POOL, umem_mgr, 0, 0,
+            UPIPE_FSINK_DIRECT_ALIGN, 0);
+    umem_mgr_release(umem_mgr);
+    UBASE_ALLOC_RETURN(upipe_fsink->block_mgr)
+    upipe_fsink->coalesce_size = size;
+
+    if (upipe_fsink->fd != -1 && direct) {
+#ifdef UPIPE_HAVE_PTHREAD
+        /* the offset must account for the buffers still queued, which must
+         * also be written without O_DIRECT */
+        upipe_fsink_writer_drain(upipe);
+#endif
+        off_t offset = lseek(upipe_fsink->fd, 0, SEEK_CUR);
+        int flags = fcntl(upipe_fsink->fd, F_GETFL);
+        if (offset != -1 && !(offset % UPIPE_FSINK_DIRECT_ALIGN) &&
+            flags != -1 &&
+            fcntl(upipe_fsink->fd, F_SETFL, flags | O_DIRECT) != -1)
+            upipe_fsink->direct_active = true;
+        else
+            upipe_warn(upipe, "not using O_DIRECT on the current file");
+    }
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This sets the byte budget of the writer thread.
+ *
+ * @param upipe description structure of the pipe
+ * @param budget maximum number of bytes waiting to be written, or 0
+ * @return an error code
+ */
+static int _upipe_fsink_set_async(struct upipe *upipe, uint64_t budget)
+{
+    struct upipe_fsink *upipe_fsink = upipe_fsink_from_upipe(upipe);
+#ifdef UPIPE_HAVE_PTHREAD
+    upipe_fsink->async_budget = budget;
+    if (!budget) {
+        upipe_fsink_stop_writer(upipe);
+        return UBASE_ERR_NONE;
+    }
+    return upipe_fsink_start_writer(upipe);
+#else
+    if (budget) {
+        upipe_err(upipe, "writer thread not supported");
+        return UBASE_ERR_INVALID;
+    }
+    upipe_fsink->async_budget = 0;
+    return UBASE_ERR_NONE;
+#endif
+}
+
+/** @internal @This returns the statistics of the writer thread.
+ *
+ * @param upipe description structure of the pipe
+ * @param stats filled in with the statistics
+ * @return an error code
+ */
+static int _upipe_fsink_get_stats(struct upipe *upipe,
+                                  struct upipe_fsink_stats *stats)
+{
+    struct upipe_fsink *upipe_fsink = upipe_fsink_from_upipe(upipe);
+    assert(stats != NULL);
+    memset(stats, 0, sizeof(*stats));
+    stats->queue_depth = upipe_fsink->queue_depth;
+    stats->queued_bytes = upipe_fsink->queued_bytes;
+    stats->max_queued_bytes = upipe_fsink->max_queued_bytes;
+#ifdef UPIPE_HAVE_PTHREAD
+    if (upipe_fsink->writer_running) {
+        struct upipe_fsink_writer *writer = &upipe_fsink->writer;
+        pthread_mutex_lock(&writer->mutex);
+        stats->writes = writer->writes;
+        stats->last_latency = writer->last_latency;
+        stats->max_latency = writer->max_latency;
+        stats->total_latency = writer->total_latency;
+        pthread_mutex_unlock(&writer->mutex);
+    }
+#endif
+    return UBASE_ERR_NONE;
+}
+
 /** @internal @This processes control commands on a file sink pipe.
  *
  * @param upipe description structure of the pipe
@@ -622,6 +1534,52 @@ static int  _upipe_fsink_control(struct upipe *upipe, int command, va_list args)
             uint64_t *p = va_arg(args, uint64_t *);
             return _upipe_fsink_get_sync_period(upipe, p);
         }
+        case UPIPE_FSINK_SET_COALESCE: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_FSINK_SIGNATURE)
+            unsigned int size = va_arg(args, unsigned int);
+            bool direct = va_arg(args, int);
+            return _upipe_fsink_set_coalesce(upipe, size, direct);
+        }
+        case UPIPE_FSINK_GET_COALESCE: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_FSINK_SIGNATURE)
+            struct upipe_fsink *upipe_fsink = upipe_fsink_from_upipe(upipe);
+            unsigned int *size_p = va_arg(args, unsigned int *);
+            int *direct_p = va_arg(args, int *);
+            if (size_p != NULL)
+                *size_p = upipe_fsink->coalesce_size;
+            if (direct_p != NULL)
+                *direct_p = upipe_fsink->direct;
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_FSINK_SET_PREALLOCATE: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_FSINK_SIGNATURE)
+            upipe_fsink_from_upipe(upipe)->preallocate =
+                va_arg(args, uint64_t);
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_FSINK_GET_PREALLOCATE: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_FSINK_SIGNATURE)
+            uint64_t *p = va_arg(args, uint64_t *);
+            *p = upipe_fsink_from_upipe(upipe)->preallocate;
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_FSINK_SET_ASYNC: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_FSINK_SIGNATURE)
+            uint64_t budget = va_arg(args, uint64_t);
+            return _upipe_fsink_set_async(upipe, budget);
+        }
+        case UPIPE_FSINK_GET_ASYNC: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_FSINK_SIGNATURE)
+            uint64_t *p = va_arg(args, uint64_t *);
+            *p = upipe_fsink_from_upipe(upipe)->async_budget;
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_FSINK_GET_STATS: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_FSINK_SIGNATURE)
+            struct upipe_fsink_stats *stats =
+                va_arg(args, struct upipe_fsink_stats *);
+            return _upipe_fsink_get_stats(upipe, stats);
+        }
         default:
             return UBASE_ERR_UNHANDLED;
     }
@@ -671,6 +1629,10 @@ static int upipe_fsink_control(struct upipe *upipe, int command, va_list args)
 static void upipe_fsink_free(struct upipe *upipe)
 {
     struct upipe_fsink *upipe_fsink = upipe_fsink_from_upipe(upipe);
+    upipe_fsink_flush_block(upipe);
+#ifdef UPIPE_HAVE_PTHREAD
+    upipe_fsink_stop_writer(upipe);
+#endif
     if (likely(upipe_fsink->fd != -1)) {
         if (likely(upipe_fsink->path != NULL)) {
             upipe_notice_va(upipe, "closing file %s", upipe_fsink->path);
@@ -683,6 +1645,8 @@ static void upipe_fsink_free(struct upipe *upipe)
     upipe_fsink_clean_uclock(upipe);
     upipe_fsink_clean_upump(upipe);
     upipe_fsink_clean_upump_sync(upipe);
+    upipe_fsink_clean_upump_async(upipe);
+    ubuf_mgr_release(upipe_fsink->block_mgr);
     upipe_fsink_clean_upump_mgr(upipe);
     upipe_fsink_clean_input(upipe);
     upipe_fsink_clean_urefcount(upipe);
@@ -19,6 +19,8 @@
 #include "upipe/uref_block.h"
 #include "upipe/uref_block_flow.h"
 #include "upipe/uref_clock.h"
+#include "upipe/umem.h"
+#include "upipe/ubuf_block_mem.h"
 #include "upipe/upump.h"
 #include "upipe/upipe.h"
 #include "upipe/upipe_helper_upipe.h"
@@ -36,9 +38,11 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <stdarg.h>
 #include <unistd.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <assert.h>
@@ -49,6 +53,25 @@
 
 /** default size of buffers when unspecified */
 #define UBUF_DEFAULT_SIZE       32768
+/** depth of the ubuf pool of mapped windows */
+#define UBUF_WINDOW_POOL_DEPTH  32
+
+/** @internal @This is a window of the file mapped in memory. It is also a
+ * umem manager, so that buffers may be output without copy; the window is
+ * unmapped when the last ubuf pointing to it is released. */
+struct upipe_fsrc_window {
+    /** refcount management structure */
+    struct urefcount urefcount;
+    /** mapped window */
+    uint8_t *base;
+    /** size of the mapped window */
+    size_t size;
+    /** common umem management structure */
+    struct umem_mgr mgr;
+};
+
+UBASE_FROM_TO(upipe_fsrc_window, umem_mgr, umem_mgr, mgr)
+UBASE_FROM_TO(upipe_fsrc_window, urefcount, urefcount, urefcount)
 
 /** @hidden */
 static int upipe_fsrc_check(struct upipe *upipe, struct uref *flow_format);
@@ -101,6 +124,19 @@ struct upipe_fsrc {
     /** length to read */
     uint64_t length;
 
+    /** size of mapped windows, or 0 */
+    uint64_t map_window;
+    /** reading position in mapped mode */
+    uint64_t map_position;
+    /** known size of the file in mapped mode */
+    uint64_t map_file_size;
+    /** current mapped window */
+    struct upipe_fsrc_window *window;
+    /** offset of the current window in the file */
+    uint64_t window_offset;
+    /** ubuf manager of the current window */
+    struct ubuf_mgr *window_ubuf_mgr;
+
     /** public upipe structure */
     struct upipe upipe;
     /** guard for upump */
@@ -155,6 +191,12 @@ static struct upipe *upipe_fsrc_alloc(struct upipe_mgr *mgr,
     upipe_fsrc->uri = NULL;
     upipe_fsrc->fd = -1;
     upipe_fsrc->length = (uint64_t)-1;
+    upipe_fsrc->map_window = 0;
+    upipe_fsrc->map_position = 0;
+    upipe_fsrc->map_file_size = 0;
+    upipe_fsrc->window = NULL;
+    upipe_fsrc->window_offset = 0;
+    upipe_fsrc->window_ubuf_mgr = NULL;
     upipe_fsrc->safe = false;
     upipe_throw_ready(upipe);
     return upipe;
@@ -183,6 +225,209 @@ static int upipe_fsrc_get_uri(struct upipe *upipe, const char **path_p)
     return uref_uri_get_path(upipe_fsrc->uri, path_p);
 }
 
+/** @internal @This refuses to allocate buffers from a mapped window.
+ *
+ * @param mgr pointer to umem manager
+ * @param umem caller-allocated structure
+ * @param size requested size
+ * @return false
+ */
+static bool upipe_fsrc_window_alloc(struct umem_mgr *mgr, struct umem *umem,
+                                    size_t size)
+{
+    return false;
+}
+
+/** @internal @This refuses to resize buffers beyond their initial size.
+ *
+ * @param umem pointer to umem
+ * @param new_size new requested size
+ * @return false if the new size does not fit
+ */
+static bool upipe_fsrc_window_realloc(struct umem *umem, size_t new_size)
+{
+    if (new_size > umem->real_size)
+        return false;
+    umem->size = new_size;
+    return true;
+}
+
+/** @internal @This releases a buffer pointing to a mapped window. The window
+ * itself is kept mapped by its ubuf manager.
+ *
+ * @param umem pointer to umem
+ */
+static void upipe_fsrc_window_free_buf(struct umem *umem)
+{
+    umem->buffer = NULL;
+    umem->mgr = NULL;
+}
+
+/** @internal @This unmaps a window.
+ *
+ * @param urefcount pointer to urefcount
+ */
+static void upipe_fsrc_window_free(struct urefcount *urefcount)
+{
+    struct upipe_fsrc_window *window =
+        upipe_fsrc_window_from_urefcount(urefcount);
+    munmap(window->base, window->size);
+    urefcount_clean(urefcount);
+    free(window);
+}
+
+/** @internal @This releases the current window. It stays mapped until the
+ * last buffer pointing to it is released.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_fsrc_window_release(struct upipe *upipe)
+{
+    struct upipe_fsrc *upipe_fsrc = upipe_fsrc_from_upipe(upipe);
+    ubuf_mgr_release(upipe_fsrc->window_ubuf_mgr);
+    upipe_fsrc->window_ubuf_mgr = NULL;
+    if (upipe_fsrc->window != NULL)
+        urefcount_release(
+                upipe_fsrc_window_to_urefcount(upipe_fsrc->window));
+    upipe_fsrc->window = NULL;
+}
+
+/** @internal @This maps the window of the file containing the given range.
+ *
+ * @param upipe description structure of the pipe
+ * @param position start of the range, in octets
+ * @param size size of the range, in octets
+ * @return an error code
+ */
+static int upipe_fsrc_window_map(struct upipe *upipe, uint64_t position,
+                                 size_t size)
+{
+    struct upipe_fsrc *upipe_fsrc = upipe_fsrc_from_upipe(upipe);
+    upipe_fsrc_window_release(upipe);
+
+    uint64_t page_size = sysconf(_SC_PAGESIZE);
+    uint64_t offset = position - position % page_size;
+    uint64_t length = position - offset + size;
+    if (length < upipe_fsrc->map_window)
+        length = upipe_fsrc->map_window;
+    if (length > upipe_fsrc->map_file_size - offset)
+        length = upipe_fsrc->map_file_size - offset;
+
+    /* private writable mapping, so that downstream pipes may write to the
+     * ubufs without altering the file */
+    uint8_t *base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                         upipe_fsrc->fd, offset);
+    if (unlikely(base == MAP_FAILED)) {
+        upipe_err_va(upipe, "can't map window at %"PRIu64" (%m)", offset);
+        return UBASE_ERR_EXTERNAL;
+    }
+    madvise(base, length, MADV_SEQUENTIAL);
+    madvise(base, length, MADV_WILLNEED);
+
+    struct upipe_fsrc_window *window = malloc(sizeof(*window));
+    if (unlikely(window == NULL)) {
+        munmap(base, length);
+        return UBASE_ERR_ALLOC;
+    }
+    window->base = base;
+    window->size = length;
+    urefcount_init(upipe_fsrc_window_to_urefcount(window),
+                   upipe_fsrc_window_free);
+    window->mgr.refcount = upipe_fsrc_window_to_urefcount(window);
+    window->mgr.umem_alloc = upipe_fsrc_window_alloc;
+    window->mgr.umem_realloc = upipe_fsrc_window_realloc;
+    window->mgr.umem_free = upipe_fsrc_window_free_buf;
+    window->mgr.umem_mgr_vacuum = NULL;
+
+    upipe_fsrc->window_ubuf_mgr =
+        ubuf_block_mem_mgr_alloc(UBUF_WINDOW_POOL_DEPTH,
+                                 UBUF_WINDOW_POOL_DEPTH, &window->mgr,
+                                 0, 0, -1, 0);
+    if (unlikely(upipe_fsrc->window_ubuf_mgr == NULL)) {
+        urefcount_release(upipe_fsrc_window_to_urefcount(window));
+        return UBASE_ERR_ALLOC;
+    }
+    upipe_fsrc->window = window;
+    upipe_fsrc->window_offset = offset;
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This returns true if the file is read from mapped windows.
+ *
+ * @param upipe description structure of the pipe
+ * @return true if the file is mapped
+ */
+static inline bool upipe_fsrc_mapped(struct upipe *upipe)
+{
+    struct upipe_fsrc *upipe_fsrc = upipe_fsrc_from_upipe(upipe);
+    return upipe_fsrc->fd != -1 && upipe_fsrc->map_window &&
+           upipe_fsrc->regular_file;
+}
+
+/** @internal @This outputs a buffer pointing to the mapped file.
+ *
+ * @param upipe description structure of the pipe
+ * @param ret_p filled in with the size of the buffer, 0 at the end of the
+ * file and -1 in case of error
+ * @return pointer to uref, or NULL in case of error
+ */
+static struct uref *upipe_fsrc_map_read(struct upipe *upipe, ssize_t *ret_p)
+{
+    struct upipe_fsrc *upipe_fsrc = upipe_fsrc_from_upipe(upipe);
+    *ret_p = -1;
+
+    if (upipe_fsrc->map_position >= upipe_fsrc->map_file_size) {
+        /* the file may have grown */
+        struct stat st;
+        if (unlikely(fstat(upipe_fsrc->fd, &st) == -1))
+            return NULL;
+        upipe_fsrc->map_file_size = st.st_size;
+    }
+
+    size_t size = upipe_fsrc->output_size;
+    if (upipe_fsrc->map_position >= upipe_fsrc->map_file_size)
+        size = 0;
+    else if (size > upipe_fsrc->map_file_size - upipe_fsrc->map_position)
+        size = upipe_fsrc->map_file_size - upipe_fsrc->map_position;
+
+    if (!size) {
+        *ret_p = 0;
+        return uref_block_alloc(upipe_fsrc->uref_mgr, upipe_fsrc->ubuf_mgr,
+                                0);
+    }
+
+    struct upipe_fsrc_window *window = upipe_fsrc->window;
+    if (window == NULL ||
+        upipe_fsrc->map_position < upipe_fsrc->window_offset ||
+        upipe_fsrc->map_position + size >
+            upipe_fsrc->window_offset + window->size) {
+        if (unlikely(!ubase_check(upipe_fsrc_window_map(upipe,
+                        upipe_fsrc->map_position, size))))
+            return NULL;
+        window = upipe_fsrc->window;
+    }
+
+    struct umem umem;
+    umem.mgr = &window->mgr;
+    umem.buffer = window->base +
+        (upipe_fsrc->map_position - upipe_fsrc->window_offset);
+    umem.size = umem.real_size = size;
+    struct ubuf *ubuf =
+        ubuf_block_mem_alloc_from_umem(upipe_fsrc->window_ubuf_mgr,
+                                       &umem, 0, size);
+    if (unlikely(ubuf == NULL))
+        return NULL;
+    struct uref *uref = uref_alloc(upipe_fsrc->uref_mgr);
+    if (unlikely(uref == NULL)) {
+        ubuf_free(ubuf);
+        return NULL;
+    }
+    uref_attach_ubuf(uref, ubuf);
+    upipe_fsrc->map_position += size;
+    *ret_p = size;
+    return uref;
+}
+
 /** @internal @This reads data from the source and outputs it.
  * It is called either when the idler triggers (permanent storage mode) or
  * when data is available on the file descriptor (live stream mode).
@@ -215,9 +460,25 @@ static void upipe_fsrc_worker(struct upump *upump)
             return;
     }
 
-    struct uref *uref = uref_block_alloc(upipe_fsrc->uref_mgr,
-                                         upipe_fsrc->ubuf_mgr,
-                                         upipe_fsrc->output_size);
+    struct uref *uref;
+    ssize_t ret;
+    if (upipe_fsrc_mapped(upipe)) {
+        uref = upipe_fsrc_map_read(upipe, &ret);
+        if (unlikely(uref == NULL)) {
+            const char *path = "(none)";
+            upipe_fsrc_get_uri(upipe, &path);
+            upipe_err_va(upipe, "mapping error from %s", path);
+            upipe_fsrc_set_upump_safe(upipe, NULL);
+            ubase_clean_fd(&upipe_fsrc->fd);
+            upipe_fsrc_window_release(upipe);
+            upipe_throw_source_end(upipe);
+            return;
+        }
+        goto output;
+    }
+
+    uref = uref_block_alloc(upipe_fsrc->uref_mgr, upipe_fsrc->ubuf_mgr,
+                            upipe_fsrc->output_size);
     if (unlikely(uref == NULL)) {
         upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
         return;
@@ -233,7 +494,7 @@ static void upipe_fsrc_worker(struct upump *upump)
     }
     assert(output_size == upipe_fsrc->output_size);
 
-    ssize_t ret = read(upipe_fsrc->fd, buffer, upipe_fsrc->output_size);
+    ret = read(upipe_fsrc->fd, buffer, upipe_fsrc->output_size);
     uref_block_unmap(uref, 0);
 
     if (unlikely(ret == -1)) {
@@ -260,6 +521,8 @@ static void upipe_fsrc_worker(struct upump *upump)
         upipe_throw_source_end(upipe);
         return;
     }
+
+output:
     if (upipe_fsrc->length != (uint64_t)-1)
         upipe_fsrc->length -= ret;
     if (upipe_fsrc->uclock != NULL)
@@ -390,6 +653,10 @@ static int upipe_fsrc_open(struct upipe *upipe)
 
     upipe_fsrc->fd = fd;
     upipe_fsrc->regular_file = !!S_ISREG(st.st_mode);
+    upipe_fsrc->map_position = 0;
+    upipe_fsrc->map_file_size = st.st_size;
+    if (upipe_fsrc->map_window && !upipe_fsrc->regular_file)
+        upipe_warn_va(upipe, "not mapping non-regular file %s", path);
     upipe_notice_va(upipe, "opening file %s", path);
     upipe_fsrc_build_flow_def(upipe);
     return UBASE_ERR_NONE;
@@ -408,6 +675,7 @@ static void upipe_fsrc_close(struct upipe *upipe)
     }
     upipe_fsrc->length = (uint64_t)-1;
     upipe_fsrc_set_upump_safe(upipe, NULL);
+    upipe_fsrc_window_release(upipe);
     uref_free(upipe_fsrc->uri);
     upipe_fsrc->uri = NULL;
 }
@@ -492,6 +760,10 @@ static int _upipe_fsrc_get_position(struct upipe *upipe,
     assert(position_p != NULL);
     if (unlikely(upipe_fsrc->fd == -1))
         return UBASE_ERR_UNHANDLED;
+    if (upipe_fsrc_mapped(upipe)) {
+        *position_p = upipe_fsrc->map_position;
+        return UBASE_ERR_NONE;
+    }
     off_t position = lseek(upipe_fsrc->fd, 0, SEEK_CUR);
     if (unlikely(position == (off_t)-1))
         return UBASE_ERR_EXTERNAL;
@@ -510,10 +782,36 @@ static int _upipe_fsrc_set_position(struct upipe *upipe, uint64_t position)
     struct upipe_fsrc *upipe_fsrc = upipe_fsrc_from_upipe(upipe);
     if (unlikely(upipe_fsrc->fd == -1))
         return UBASE_ERR_UNHANDLED;
+    if (upipe_fsrc_mapped(upipe)) {
+        upipe_fsrc->map_position = position;
+        return UBASE_ERR_NONE;
+    }
     return lseek(upipe_fsrc->fd, position, SEEK_SET) != (off_t)-1 ?
         UBASE_ERR_NONE : UBASE_ERR_EXTERNAL;
 }
 
+/** @internal @This sets the size of mapped windows.
+ *
+ * @param upipe description structure of the pipe
+ * @param window size of mapped windows, or 0 to read the file
+ * @return an error code
+ */
+static int _upipe_fsrc_set_mmap(struct upipe *upipe, uint64_t window)
+{
+    struct upipe_fsrc *upipe_fsrc = upipe_fsrc_from_upipe(upipe);
+    bool was_mapped = upipe_fsrc_mapped(upipe);
+    if (was_mapped && !window)
+        /* resume reading where the mapping stopped */
+        lseek(upipe_fsrc->fd, upipe_fsrc->map_position, SEEK_SET);
+    else if (!was_mapped && window && upipe_fsrc->fd != -1) {
+        off_t position = lseek(upipe_fsrc->fd, 0, SEEK_CUR);
+        upipe_fsrc->map_position = position != (off_t)-1 ? position : 0;
+    }
+    upipe_fsrc_window_release(upipe);
+    upipe_fsrc->map_window = window;
+    return UBASE_ERR_NONE;
+}
+
 static int _upipe_fsrc_set_length(struct upipe *upipe, uint64_t length)
 {
     struct upipe_fsrc *upipe_fsrc = upipe_fsrc_from_upipe(upipe);
@@ -629,6 +927,18 @@ static int _upipe_fsrc_control(struct upipe *upipe, int command, va_list args)
             return _upipe_fsrc_get_range(upipe, offset_p, length_p);
         }
 
+        case UPIPE_FSRC_GET_MMAP: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_FSRC_SIGNATURE)
+            uint64_t *window_p = va_arg(args, uint64_t *);
+            *window_p = upipe_fsrc_from_upipe(upipe)->map_window;
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_FSRC_SET_MMAP: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_FSRC_SIGNATURE)
+            uint64_t window = va_arg(args, uint64_t);
+            return _upipe_fsrc_set_mmap(upipe, window);
+        }
+
         default:
             return UBASE_ERR_UNHANDLED;
     }
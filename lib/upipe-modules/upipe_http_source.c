@@ -41,6 +41,9 @@
 #include <stdint.h>
 #include <stdarg.h>
 #include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netdb.h>
@@ -52,6 +55,8 @@
 
 /** default size of buffers when unspecified */
 #define UBUF_DEFAULT_SIZE       4096
+/** default maximum size of adaptive reads */
+#define MAX_READ_SIZE           (256 * 1024)
 
 #define MAX_URL_SIZE            2048
 #define HTTP_VERSION            "HTTP/1.1"
@@ -76,6 +81,11 @@ UBASE_FROM_TO(upipe_http_src_cookie, uchain, uchain, uchain)
 
 /** @hidden */
 static int upipe_http_src_check(struct upipe *upipe, struct uref *flow_format);
+/** @hidden */
+static int upipe_http_src_mgr_get_conn(struct upipe_mgr *mgr, const char *key);
+/** @hidden */
+static void upipe_http_src_mgr_put_conn(struct upipe_mgr *mgr, const char *key,
+                                        int fd);
 
 struct header {
     const char *value;
@@ -97,6 +107,39 @@ struct upipe_http_src_request {
 #define HEADER(Value, Len) \
     (struct header){ .value = Value, .len = Len }
 
+/** @internal @This stores a range request made on an additional connection
+ * during a parallel transfer. */
+struct upipe_http_src_part {
+    /** uchain for the list of parts */
+    struct uchain uchain;
+    /** pointer to the pipe */
+    struct upipe *upipe;
+    /** socket descriptor */
+    int fd;
+    /** write watcher until the request is sent, then read watcher */
+    struct upump *upump;
+    /** request to send */
+    struct upipe_http_src_request request;
+    /** number of octets of the request already sent */
+    size_t sent;
+    /** http parser */
+    http_parser parser;
+    /** first requested octet */
+    uint64_t offset;
+    /** number of requested octets, or UINT64_MAX up to the end */
+    uint64_t length;
+    /** number of received octets */
+    uint64_t received;
+    /** received data not output yet */
+    struct uref *uref;
+    /** true when the response is complete */
+    bool done;
+    /** true if the connection may be reused */
+    bool keepalive;
+};
+
+UBASE_FROM_TO(upipe_http_src_part, uchain, uchain, uchain)
+
 /** @internal @This is the private context of a http source pipe. */
 struct upipe_http_src {
     /** refcount management structure */
@@ -151,6 +194,14 @@ struct upipe_http_src {
 
     /** socket descriptor */
     int fd;
+    /** key of the connection in the manager pool */
+    char *conn_key;
+    /** peer address, for additional connections */
+    struct sockaddr_storage addr;
+    /** peer address length */
+    socklen_t addrlen;
+    /** true if the connection may be reused after the response */
+    bool keepalive;
     /** pending request */
     struct upipe_http_src_request request;
     /** http url */
@@ -169,11 +220,45 @@ struct upipe_http_src {
     struct http_range range;
     uint64_t position;
 
+    /** current read size */
+    unsigned int read_size;
+    /** maximum read size */
+    unsigned int max_read_size;
+    /** buffer being parsed */
+    struct ubuf *rx;
+    /** mapped buffer being parsed */
+    const uint8_t *rx_base;
+    /** size of the buffer being parsed */
+    size_t rx_size;
+
+    /** maximum number of connections for parallel range requests */
+    unsigned int parallel;
+    /** size of parallel range requests */
+    uint64_t part_size;
+    /** true if the response has a valid content range */
+    bool content_range;
+    /** last octet of the content range of the response */
+    uint64_t content_last;
+    /** total size from the content range, or UINT64_MAX */
+    uint64_t content_total;
+    /** end of the parallel transfer, or 0 */
+    uint64_t transfer_end;
+    /** next offset to request during a parallel transfer */
+    uint64_t next_offset;
+    /** true when the first request of a parallel transfer is complete */
+    bool primary_done;
+    /** range requests in progress, in offset order */
+    struct uchain parts;
+
     /** http parser*/
     http_parser parser;
+    /** true when the parser completed a response */
+    bool complete;
 
     /** http parser settings */
     http_parser_settings parser_settings;
+    /** http parser settings for parallel range requests */
+    http_parser_settings part_settings;
 
     /** read/write timeout value */
     uint64_t timeout;
@@ -224,6 +309,11 @@ static int upipe_http_src_body_cb(http_parser *parser,
                                   size_t len);
 static int upipe_http_src_message_complete(http_parser *parser);
 static int upipe_http_src_status_cb(http_parser *parser);
+static int upipe_http_src_headers_complete(http_parser *parser);
+static int upipe_http_src_part_status(http_parser *parser);
+static int upipe_http_src_part_body(http_parser *parser,
+                                    const char *at, size_t len);
+static int upipe_http_src_part_complete(http_parser *parser);
 
 /** @This throw a scheme hook event.
  *
@@ -272,9 +362,25 @@ static struct upipe *upipe_http_src_alloc(struct upipe_mgr *mgr,
 
     struct upipe_http_src *upipe_http_src = upipe_http_src_from_upipe(upipe);
     upipe_http_src->fd = -1;
+    upipe_http_src->conn_key = NULL;
+    upipe_http_src->addrlen = 0;
+    upipe_http_src->keepalive = false;
     upipe_http_src->url = NULL;
     upipe_http_src->range = HTTP_RANGE(0, -1);
     upipe_http_src->position = 0;
+    upipe_http_src->read_size = UBUF_DEFAULT_SIZE;
+    upipe_http_src->max_read_size = MAX_READ_SIZE;
+    upipe_http_src->rx = NULL;
+    upipe_http_src->rx_base = NULL;
+    upipe_http_src->rx_size = 0;
+    upipe_http_src->parallel = 0;
+    upipe_http_src->part_size = 0;
+    upipe_http_src->content_range = false;
+    upipe_http_src->transfer_end = 0;
+    upipe_http_src->next_offset = 0;
+    upipe_http_src->primary_done = false;
+    ulist_init(&upipe_http_src->parts);
+    upipe_http_src->complete = false;
     upipe_http_src->location = NULL;
     upipe_http_src->header_field = HEADER(NULL, 0);
     upipe_http_src->proxy = NULL;
@@ -293,11 +399,17 @@ static struct upipe *upipe_http_src_alloc(struct upipe_mgr *mgr,
     settings->on_url = NULL;
     settings->on_header_field = upipe_http_src_header_field;
     settings->on_header_value = upipe_http_src_header_value;
-    settings->on_headers_complete = NULL;
+    settings->on_headers_complete = upipe_http_src_headers_complete;
     settings->on_body = upipe_http_src_body_cb;
     settings->on_message_complete = upipe_http_src_message_complete;
     settings->on_status_complete = upipe_http_src_status_cb;
 
+    settings = &upipe_http_src->part_settings;
+    memset(settings, 0, sizeof (*settings));
+    settings->on_body = upipe_http_src_part_body;
+    settings->on_message_complete = upipe_http_src_part_complete;
+    settings->on_status_complete = upipe_http_src_part_status;
+
     upipe_throw_ready(upipe);
 
     const char *proxy;
@@ -317,30 +429,98 @@ static struct upipe *upipe_http_src_alloc(struct upipe_mgr *mgr,
     return upipe;
 }
 
-/** @This closes a connection.
+/** @internal @This checks if the connection uses the default plain hook.
+ *
+ * @param upipe_http_src private structure of the pipe
+ * @return true if the connection is plain http
+ */
+static inline bool upipe_http_src_plain(struct upipe_http_src *upipe_http_src)
+{
+    return upipe_http_src->hook == &upipe_http_src->http_hook.hook;
+}
+
+/** @internal @This releases the main connection and its watchers, except
+ * the timeout.
  *
  * @param upipe description structure of the pipe
+ * @return the socket descriptor if the connection may be reused, or -1
  */
-static void upipe_http_src_close(struct upipe *upipe)
+static int upipe_http_src_disconnect(struct upipe *upipe)
 {
     struct upipe_http_src *upipe_http_src = upipe_http_src_from_upipe(upipe);
-    struct uref *flow_def = upipe_http_src->flow_def;
+    bool reuse = upipe_http_src->keepalive &&
+                 upipe_http_src_plain(upipe_http_src);
+    int fd = upipe_http_src->fd;
 
-    if (likely(upipe_http_src->url != NULL))
-        upipe_notice_va(upipe, "closing %s", upipe_http_src->url);
+    upipe_http_src_set_upump_read(upipe, NULL);
+    upipe_http_src_set_upump_write(upipe, NULL);
+    upipe_http_src_set_upump_data_in(upipe, NULL);
+    upipe_http_src_set_upump_data_out(upipe, NULL);
     upipe_http_src_hook_release(upipe_http_src->hook);
     upipe_http_src->hook = NULL;
-    ubase_clean_fd(&upipe_http_src->fd);
-    ubase_clean_str(&upipe_http_src->url);
+    upipe_http_src->fd = -1;
+    upipe_http_src->keepalive = false;
     free(upipe_http_src->request.buf);
     upipe_http_src->request.buf = NULL;
     upipe_http_src->request.len = 0;
     upipe_http_src->request.size = 0;
-    upipe_http_src_set_upump_read(upipe, NULL);
-    upipe_http_src_set_upump_write(upipe, NULL);
+    if (!reuse)
+        ubase_clean_fd(&fd);
+    return fd;
+}
+
+/** @internal @This frees a range request, keeping its connection in the
+ * manager pool if possible.
+ *
+ * @param upipe description structure of the pipe
+ * @param part range request to free
+ */
+static void upipe_http_src_part_free(struct upipe *upipe,
+                                     struct upipe_http_src_part *part)
+{
+    struct upipe_http_src *upipe_http_src = upipe_http_src_from_upipe(upipe);
+
+    ulist_delete(upipe_http_src_part_to_uchain(part));
+    if (part->upump != NULL)
+        upump_free(part->upump);
+    if (part->fd != -1) {
+        if (part->done && part->keepalive)
+            upipe_http_src_mgr_put_conn(upipe->mgr, upipe_http_src->conn_key,
+                                        part->fd);
+        else
+            close(part->fd);
+    }
+    free(part->request.buf);
+    uref_free(part->uref);
+    free(part);
+}
+
+/** @This closes a connection.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_http_src_close(struct upipe *upipe)
+{
+    struct upipe_http_src *upipe_http_src = upipe_http_src_from_upipe(upipe);
+    struct uref *flow_def = upipe_http_src->flow_def;
+
+    if (likely(upipe_http_src->url != NULL))
+        upipe_notice_va(upipe, "closing %s", upipe_http_src->url);
+
+    struct uchain *uchain, *uchain_tmp;
+    ulist_delete_foreach(&upipe_http_src->parts, uchain, uchain_tmp)
+        upipe_http_src_part_free(upipe,
+                                 upipe_http_src_part_from_uchain(uchain));
+    upipe_http_src->transfer_end = 0;
+    upipe_http_src->next_offset = 0;
+    upipe_http_src->primary_done = false;
+
+    int fd = upipe_http_src_disconnect(upipe);
+    if (fd != -1)
+        upipe_http_src_mgr_put_conn(upipe->mgr, upipe_http_src->conn_key, fd);
+    ubase_clean_str(&upipe_http_src->conn_key);
+    ubase_clean_str(&upipe_http_src->url);
     upipe_http_src_set_upump_timeout(upipe, NULL);
-    upipe_http_src_set_upump_data_in(upipe, NULL);
-    upipe_http_src_set_upump_data_out(upipe, NULL);
     if (flow_def)
         uref_http_delete_content_type(flow_def);
 }
@@ -434,6 +614,26 @@ static int upipe_http_src_header_value(http_parser *parser,
         snprintf(content_type, len + 1, "%.*s", (int)len, at);
         uref_http_set_content_type(flow_def, content_type);
     }
+    else if (!strncasecmp("Content-Range", field.value, field.len)) {
+        char content_range[len + 1];
+        snprintf(content_range, len + 1, "%.*s", (int)len, at);
+        uint64_t first = UINT64_MAX, last = UINT64_MAX, total = UINT64_MAX;
+        int end = -1;
+        bool valid = sscanf(content_range,
+                            "bytes %"SCNu64"-%"SCNu64"/%n",
+                            &first, &last, &end) == 2 && end != -1 &&
+                     last >= first;
+        if (valid && strcmp(content_range + end, "*")) {
+            /* the complete length is unknown if "*" */
+            char *endptr;
+            total = strtoull(content_range + end, &endptr, 10);
+            valid = endptr != content_range + end && *endptr == '\0' &&
+                    total > last;
+        }
+        upipe_http_src->content_range = valid;
+        upipe_http_src->content_last = valid ? last : UINT64_MAX;
+        upipe_http_src->content_total = valid ? total : UINT64_MAX;
+    }
     return 0;
 }
 
@@ -450,10 +650,19 @@ static int upipe_http_src_status_cb(http_parser *parser)
     return -1;
 }
 
-static int upipe_http_src_output_data(struct upipe *upipe,
-                                      const char *at, size_t len)
+/** @internal @This allocates a buffer with received data. If the data lies
+ * in the buffer being parsed, it is referenced instead of copied.
+ *
+ * @param upipe description structure of the pipe
+ * @param at received data, or NULL
+ * @param len size of the received data
+ * @return an allocated uref, or NULL in case of allocation error
+ */
+static struct uref *upipe_http_src_alloc_data(struct upipe *upipe,
+                                              const char *at, size_t len)
 {
     struct upipe_http_src *upipe_http_src = upipe_http_src_from_upipe(upipe);
+    const uint8_t *data = (const uint8_t *)at;
     struct uref *uref;
     uint64_t systime = 0;
     uint8_t *buf = NULL;
@@ -467,22 +676,56 @@ static int upipe_http_src_output_data(struct upipe *upipe,
         systime = uclock_now(upipe_http_src->uclock);
     }
 
-    /* alloc, map, copy, unmap */
-    uref = uref_block_alloc(upipe_http_src->uref_mgr,
-                            upipe_http_src->ubuf_mgr, len);
-    if (unlikely(!uref)) {
-        upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
-        return 0;
+    if (len && upipe_http_src->rx != NULL &&
+        data >= upipe_http_src->rx_base &&
+        data + len <= upipe_http_src->rx_base + upipe_http_src->rx_size) {
+        /* reference the received buffer */
+        struct ubuf *ubuf =
+            ubuf_block_splice(upipe_http_src->rx,
+                              data - upipe_http_src->rx_base, len);
+        uref = uref_alloc(upipe_http_src->uref_mgr);
+        if (unlikely(!ubuf || !uref)) {
+            if (ubuf)
+                ubuf_free(ubuf);
+            uref_free(uref);
+            upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+            return NULL;
+        }
+        uref_attach_ubuf(uref, ubuf);
+    }
+    else {
+        /* alloc, map, copy, unmap */
+        uref = uref_block_alloc(upipe_http_src->uref_mgr,
+                                upipe_http_src->ubuf_mgr, len);
+        if (unlikely(!uref)) {
+            upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+            return NULL;
+        }
+        size = -1;
+        uref_block_write(uref, 0, &size, &buf);
+        assert(len == size);
+        if (likely(at != NULL))
+            memcpy(buf, at, len);
+        uref_block_unmap(uref, 0);
     }
-    size = -1;
-    uref_block_write(uref, 0, &size, &buf);
-    assert(len == size);
-    if (likely(at != NULL))
-        memcpy(buf, at, len);
-    uref_block_unmap(uref, 0);
 
     if (systime)
         uref_clock_set_cr_sys(uref, systime);
+    return uref;
+}
+
+static int upipe_http_src_output_data(struct upipe *upipe,
+                                      const char *at, size_t len)
+{
+    struct upipe_http_src *upipe_http_src = upipe_http_src_from_upipe(upipe);
+
+    if (unlikely(at == NULL))
+        len = 0;
+
+    struct uref *uref = upipe_http_src_alloc_data(upipe, at, len);
+    if (unlikely(!uref))
+        return 0;
+
     if (len == 0)
         uref_block_set_end(uref);
     upipe_http_src->position += len;
@@ -492,6 +735,60 @@ static int upipe_http_src_output_data(struct upipe *upipe,
     return 0;
 }
 
+/** @hidden */
+static void upipe_http_src_flush(struct upipe *upipe);
+/** @hidden */
+static bool upipe_http_src_part_start(struct upipe *upipe, int fd);
+
+/** @internal @This aborts the transfer.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_http_src_abort(struct upipe *upipe)
+{
+    upipe_http_src_output_data(upipe, NULL, 0);
+    upipe_http_src_close(upipe);
+    upipe_throw_source_end(upipe);
+}
+
+/** @internal @This is called by http_parser when the headers of the main
+ * response are parsed. It starts the parallel transfer if the server
+ * returned a part of the requested content.
+ *
+ * @param parser http parser structure
+ * @return 0
+ */
+static int upipe_http_src_headers_complete(http_parser *parser)
+{
+    struct upipe_http_src *upipe_http_src = upipe_http_src_from_parser(parser);
+    struct upipe *upipe = upipe_http_src_to_upipe(upipe_http_src);
+
+    if (parser->status_code != 206 || upipe_http_src->parallel < 2 ||
+        !upipe_http_src->part_size || !upipe_http_src->content_range ||
+        !upipe_http_src_plain(upipe_http_src))
+        return 0;
+
+    uint64_t end = upipe_http_src->content_total;
+    if (upipe_http_src->range.length != (uint64_t)-1) {
+        uint64_t range_end = upipe_http_src->range.offset +
+                             upipe_http_src->range.length + 1;
+        if (range_end < end)
+            end = range_end;
+    }
+    if (upipe_http_src->content_last + 1 >= end)
+        return 0;
+
+    upipe_http_src->transfer_end = end;
+    upipe_http_src->next_offset = upipe_http_src->content_last + 1;
+    if (end != UINT64_MAX)
+        upipe_dbg_va(upipe, "fetching %"PRIu64" remaining octets over %u "
+                     "connections", end - upipe_http_src->next_offset,
+                     upipe_http_src->parallel);
+    upipe_http_src_flush(upipe);
+    /* stop parsing if the transfer was aborted */
+    return upipe_http_src->fd == -1 ? -1 : 0;
+}
+
 /** @internal @This is called by http_parser when message is completed.
  *
  * @param parser http parser structure
@@ -500,14 +797,55 @@ static int upipe_http_src_output_data(struct upipe *upipe,
 static int upipe_http_src_message_complete(http_parser *parser)
 {
     struct upipe_http_src *upipe_http_src = upipe_http_src_from_parser(parser);
-    struct upipe *upipe = upipe_http_src_to_upipe(upipe_http_src);
+
+    /* stop parsing, the response is handled by @ref upipe_http_src_process */
+    upipe_http_src->complete = true;
+    http_parser_pause(parser, 1);
+    return 0;
+}
+
+/** @internal @This handles a complete response.
+ *
+ * @param upipe description structure of the pipe
+ * @param drained true if the response ended with the received data
+ */
+static void upipe_http_src_complete(struct upipe *upipe, bool drained)
+{
+    struct upipe_http_src *upipe_http_src = upipe_http_src_from_upipe(upipe);
     char *location = upipe_http_src->location;
-    int status_code = parser->status_code;
+    int status_code = upipe_http_src->parser.status_code;
 
     upipe_http_src->location = NULL;
+    upipe_http_src->complete = false;
+    upipe_http_src->keepalive = drained &&
+        http_should_keep_alive(&upipe_http_src->parser) &&
+        upipe_http_src_plain(upipe_http_src) &&
+        !upipe_http_src->http_hook.in.len &&
+        !upipe_http_src->http_hook.out.len;
 
     upipe_dbg_va(upipe, "message complete %i", status_code);
 
+    if (upipe_http_src->transfer_end && status_code == 206) {
+        /* the remaining data is fetched by range requests */
+        upipe_http_src->primary_done = true;
+        int fd = upipe_http_src_disconnect(upipe);
+        if (fd != -1 &&
+            upipe_http_src->next_offset < upipe_http_src->transfer_end &&
+            ulist_depth(&upipe_http_src->parts) < upipe_http_src->parallel) {
+            if (!upipe_http_src_part_start(upipe, fd)) {
+                upipe_http_src_abort(upipe);
+                free(location);
+                return;
+            }
+        }
+        else if (fd != -1)
+            upipe_http_src_mgr_put_conn(upipe->mgr, upipe_http_src->conn_key,
+                                        fd);
+        free(location);
+        upipe_http_src_flush(upipe);
+        return;
+    }
+
     switch (status_code) {
     /* success */
     case 200:
@@ -524,8 +862,6 @@ static int upipe_http_src_message_complete(http_parser *parser)
         upipe_http_src_throw_redirect(upipe, location);
 
     free(location);
-
-    return 0;
 }
 
 /** @internal @This is called by http_parser when receiving fragments of body
@@ -573,7 +909,9 @@ static void upipe_http_src_process(struct upipe *upipe, const uint8_t *buffer,
             http_parser_execute(&upipe_http_src->parser,
                                 &upipe_http_src->parser_settings,
                                 (const char *)buffer, size);
-        if (parsed_len != size) {
+        if (upipe_http_src->complete)
+            upipe_http_src_complete(upipe, parsed_len == size);
+        else if (parsed_len != size && upipe_http_src->fd != -1) {
             upipe_warn(upipe, "http request execution failed");
             upipe_http_src_output_data(upipe, NULL, 0);
             upipe_http_src_close(upipe);
@@ -583,10 +921,9 @@ static void upipe_http_src_process(struct upipe *upipe, const uint8_t *buffer,
 }
 
 UBASE_FMT_PRINTF(2, 3)
-static int upipe_http_src_request_add(struct upipe *upipe, const char *fmt, ...)
+static int upipe_http_src_request_add(struct upipe_http_src_request *request,
+                                      const char *fmt, ...)
 {
-    struct upipe_http_src *upipe_http_src = upipe_http_src_from_upipe(upipe);
-    struct upipe_http_src_request *request = &upipe_http_src->request;
     int ret;
 
     va_list args;
@@ -626,12 +963,18 @@ static int upipe_http_src_request_add(struct upipe *upipe, const char *fmt, ...)
     return 0;
 }
 
-/** @internal @This builds and sends a GET request
+/** @internal @This builds a GET request
  *
  * @param upipe description structure of the pipe
+ * @param request filled with the request
+ * @param range_first first requested octet
+ * @param range_last last requested octet, or UINT64_MAX up to the end
  * @return an error code
  */
-static int upipe_http_src_send_request(struct upipe *upipe)
+static int upipe_http_src_build_request(struct upipe *upipe,
+                                        struct upipe_http_src_request *request,
+                                        uint64_t range_first,
+                                        uint64_t range_last)
 {
     struct upipe_http_src *upipe_http_src = upipe_http_src_from_upipe(upipe);
     struct uref *flow_def = upipe_http_src->flow_def;
@@ -653,7 +996,7 @@ static int upipe_http_src_send_request(struct upipe *upipe)
     /* GET url */
     if (upipe_http_src->proxy) {
         upipe_dbg_va(upipe, "GET %s", upipe_http_src->url);
-        upipe_http_src_request_add(upipe, "GET %s %s\r\n",
+        upipe_http_src_request_add(request, "GET %s %s\r\n",
                                    upipe_http_src->url, HTTP_VERSION);
     }
     else {
@@ -661,47 +1004,35 @@ static int upipe_http_src_send_request(struct upipe *upipe)
         sprintf(url, "%s%s%s", path, query ? "?" : "", query ? query : "");
 
         upipe_dbg_va(upipe, "GET %s", url);
-        upipe_http_src_request_add(upipe, "GET %s %s\r\n", url, HTTP_VERSION);
+        upipe_http_src_request_add(request, "GET %s %s\r\n", url, HTTP_VERSION);
     }
 
     /* User-Agent */
     const char *user_agent = upipe_http_src->user_agent;
     if (user_agent) {
         upipe_verbose_va(upipe, "User-Agent: %s", user_agent);
-        upipe_http_src_request_add(upipe, "User-Agent: %s\r\n", user_agent);
+        upipe_http_src_request_add(request, "User-Agent: %s\r\n", user_agent);
     }
 
     /* Host */
     const char *host = NULL;
     if (ubase_check(uref_uri_get_host(flow_def, &host))) {
         upipe_verbose_va(upipe, "Host: %s", host);
-        upipe_http_src_request_add(upipe, "Host: %s\r\n", host);
+        upipe_http_src_request_add(request, "Host: %s\r\n", host);
     }
 
     /* Range */
-    upipe_http_src->position = 0;
-    if (upipe_http_src->range.offset ||
-        upipe_http_src->range.length != (uint64_t)-1) {
-
-        if (upipe_http_src->range.offset) {
-            upipe_verbose_va(upipe, "range offset: %"PRIu64,
-                             upipe_http_src->range.offset);
-            upipe_http_src_request_add(upipe, "Range: bytes=%"PRIu64"-",
-                                       upipe_http_src->range.offset);
-            upipe_http_src->position = upipe_http_src->range.offset;
-        }
-        else
-            upipe_http_src_request_add(upipe, "Range: bytes=0-");
-
-        if (upipe_http_src->range.length != (uint64_t)-1) {
-            upipe_verbose_va(upipe, "range length: %"PRIu64,
-                             upipe_http_src->range.length);
-            upipe_http_src_request_add(upipe, "%"PRIu64,
-                                       upipe_http_src->range.offset +
-                                       upipe_http_src->range.length);
+    if (range_first || range_last != UINT64_MAX) {
+        upipe_verbose_va(upipe, "range offset: %"PRIu64, range_first);
+        upipe_http_src_request_add(request, "Range: bytes=%"PRIu64"-",
+                                   range_first);
+
+        if (range_last != UINT64_MAX) {
+            upipe_verbose_va(upipe, "range last: %"PRIu64, range_last);
+            upipe_http_src_request_add(request, "%"PRIu64, range_last);
         }
 
-        upipe_http_src_request_add(upipe, "\r\n");
+        upipe_http_src_request_add(request, "\r\n");
     }
 
     /* Cookie */
@@ -718,22 +1049,48 @@ static int upipe_http_src_send_request(struct upipe *upipe)
                     (int)cookie->ucookie.value.len, cookie->ucookie.value.at);
         if (first)
             upipe_http_src_request_add(
-                upipe, "Cookie: %.*s=%.*s",
+                request, "Cookie: %.*s=%.*s",
                 (int)cookie->ucookie.name.len, cookie->ucookie.name.at,
                 (int)cookie->ucookie.value.len, cookie->ucookie.value.at);
         else
             upipe_http_src_request_add(
-                upipe, "; %.*s=%.*s",
+                request, "; %.*s=%.*s",
                 (int)cookie->ucookie.name.len, cookie->ucookie.name.at,
                 (int)cookie->ucookie.value.len, cookie->ucookie.value.at);
         first = false;
     }
     if (!first)
-        upipe_http_src_request_add(upipe, "\r\n");
+        upipe_http_src_request_add(request, "\r\n");
 
     /* End of request */
-    upipe_http_src_request_add(upipe, "\r\n");
+    upipe_http_src_request_add(request, "\r\n");
 
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This builds and sends a GET request
+ *
+ * @param upipe description structure of the pipe
+ * @return an error code
+ */
+static int upipe_http_src_send_request(struct upipe *upipe)
+{
+    struct upipe_http_src *upipe_http_src = upipe_http_src_from_upipe(upipe);
+    uint64_t first = upipe_http_src->range.offset;
+    uint64_t last = UINT64_MAX;
+    if (upipe_http_src->range.length != (uint64_t)-1)
+        last = upipe_http_src->range.offset + upipe_http_src->range.length;
+
+    /* only ask for the first part, the rest is requested in parallel once
+     * the total size is known */
+    if (upipe_http_src->parallel > 1 && upipe_http_src->part_size &&
+        upipe_http_src_plain(upipe_http_src) &&
+        (last == UINT64_MAX || last - first >= upipe_http_src->part_size))
+        last = first + upipe_http_src->part_size - 1;
+
+    upipe_http_src->position = first;
+    UBASE_RETURN(upipe_http_src_build_request(upipe, &upipe_http_src->request,
+                                              first, last));
     ueventfd_write(&upipe_http_src->data_in);
 
     return UBASE_ERR_NONE;
@@ -760,6 +1117,173 @@ static void upipe_http_src_worker_update_state(struct upipe *upipe, int ret)
         ueventfd_write(&upipe_http_src->data_out);
 }
 
+/** @internal @This adapts the read size to the amount of data returned by
+ * the last read.
+ *
+ * @param upipe description structure of the pipe
+ * @param len size of the last read
+ */
+static void upipe_http_src_adapt_read_size(struct upipe *upipe, size_t len)
+{
+    struct upipe_http_src *upipe_http_src = upipe_http_src_from_upipe(upipe);
+    unsigned int read_size = upipe_http_src->read_size;
+
+    if (len >= read_size && read_size < upipe_http_src->max_read_size) {
+        /* the socket has more data, read more at once */
+        read_size *= 2;
+        if (read_size > upipe_http_src->max_read_size)
+            read_size = upipe_http_src->max_read_size;
+    }
+    else if (len < read_size / 4 && read_size > upipe_http_src->output_size) {
+        read_size /= 2;
+        if (read_size < upipe_http_src->output_size)
+            read_size = upipe_http_src->output_size;
+    }
+    else
+        return;
+
+    upipe_verbose_va(upipe, "read size %u", read_size);
+    upipe_http_src->read_size = read_size;
+}
+
+/** @internal @This allocates a buffer for the next read.
+ *
+ * @param upipe description structure of the pipe
+ * @param buffer_p filled with the mapped buffer
+ * @param size_p filled with the size of the buffer
+ * @return an allocated ubuf, or NULL in case of error
+ */
+static struct ubuf *upipe_http_src_read_alloc(struct upipe *upipe,
+                                              uint8_t **buffer_p, int *size_p)
+{
+    struct upipe_http_src *upipe_http_src = upipe_http_src_from_upipe(upipe);
+
+    if (upipe_http_src->read_size < upipe_http_src->output_size)
+        upipe_http_src->read_size = upipe_http_src->output_size;
+
+    struct ubuf *ubuf = ubuf_block_alloc(upipe_http_src->ubuf_mgr,
+                                         upipe_http_src->read_size);
+    if (unlikely(ubuf == NULL)) {
+        upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+        return NULL;
+    }
+    *size_p = -1;
+    if (unlikely(!ubase_check(ubuf_block_write(ubuf, 0, size_p, buffer_p)))) {
+        ubuf_free(ubuf);
+        upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+        return NULL;
+    }
+    return ubuf;
+}
+
+/** @internal @This maps a received buffer before it is parsed, so that the
+ * body can be referenced instead of copied.
+ *
+ * @param upipe description structure of the pipe
+ * @param ubuf received buffer
+ * @return the mapped buffer, or NULL in case of error
+ */
+static const uint8_t *upipe_http_src_rx_map(struct upipe *upipe,
+                                            struct ubuf *ubuf)
+{
+    struct upipe_http_src *upipe_http_src = upipe_http_src_from_upipe(upipe);
+    const uint8_t *buffer;
+    int size = -1;
+    if (unlikely(!ubase_check(ubuf_block_read(ubuf, 0, &size, &buffer))))
+        return NULL;
+    upipe_http_src->rx = ubuf;
+    upipe_http_src->rx_base = buffer;
+    upipe_http_src->rx_size = size;
+    return buffer;
+}
+
+/** @internal @This unmaps a parsed buffer.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_http_src_rx_unmap(struct upipe *upipe)
+{
+    struct upipe_http_src *upipe_http_src = upipe_http_src_from_upipe(upipe);
+    ubuf_block_unmap(upipe_http_src->rx, 0);
+    ubuf_free(upipe_http_src->rx);
+    upipe_http_src->rx = NULL;
+    upipe_http_src->rx_base = NULL;
+    upipe_http_src->rx_size = 0;
+}
+
+/** @internal @This receives and parses data from the main connection.
+ *
+ * @param upipe description structure of the pipe
+ * @param plain true to read directly from the socket
+ */
+static void upipe_http_src_receive(struct upipe *upipe, bool plain)
+{
+    struct upipe_http_src *upipe_http_src = upipe_http_src_from_upipe(upipe);
+
+    uint8_t *buffer;
+    int size;
+    struct ubuf *ubuf = upipe_http_src_read_alloc(upipe, &buffer, &size);
+    if (unlikely(ubuf == NULL))
+        return;
+
+    ssize_t len;
+    if (plain)
+        len = read(upipe_http_src->fd, buffer, size);
+    else
+        len = upipe_http_src->hook->data.read(
+            upipe, upipe_http_src->hook, buffer, size);
+    int err = errno;
+    ubuf_block_unmap(ubuf, 0);
+
+    if (unlikely(len < 0)) {
+        switch (err) {
+            case EINTR:
+            case EAGAIN:
+#if EAGAIN != EWOULDBLOCK
+            case EWOULDBLOCK:
+#endif
+                /* not an issue, try again later */
+                ubuf_free(ubuf);
+                return;
+
+            default:
+                break;
+        }
+        upipe_err_va(upipe, "read error from %s (%s)", upipe_http_src->url,
+                     strerror(err));
+    }
+    else if (len == 0) {
+        upipe_dbg(upipe, "connection closed");
+    }
+    else {
+        if (!plain)
+            ueventfd_write(&upipe_http_src->data_out);
+        upipe_http_src_adapt_read_size(upipe, len);
+    }
+
+    if (len > 0 && ubase_check(ubuf_block_resize(ubuf, 0, len)) &&
+        (buffer = (uint8_t *)upipe_http_src_rx_map(upipe, ubuf)) != NULL) {
+        upipe_http_src_process(upipe, buffer, len);
+        upipe_http_src_rx_unmap(upipe);
+    }
+    else {
+        ubuf_free(ubuf);
+        upipe_http_src_process(upipe, NULL, 0);
+    }
+
+    if (len <= 0) {
+        upipe_http_src_set_upump_read(upipe, NULL);
+        upipe_http_src_set_upump_write(upipe, NULL);
+        upipe_http_src_set_upump_timeout(upipe, NULL);
+        upipe_http_src_set_upump_data_in(upipe, NULL);
+        upipe_http_src_set_upump_data_out(upipe, NULL);
+        upipe_throw_source_end(upipe);
+    }
+
+    if (upipe_http_src->upump_read)
+        upump_start(upipe_http_src->upump_read);
+}
+
 /** @internal @This reads data from the source and outputs it.
  * It is called either when the idler triggers (permanent storage mode) or
  * when data is available on the http descriptor (live stream mode).
@@ -774,6 +1298,12 @@ static void upipe_http_src_worker_read(struct upump *upump)
     if (likely(upipe_http_src->upump_timeout))
         upump_restart(upipe_http_src->upump_timeout);
 
+    if (upipe_http_src_plain(upipe_http_src)) {
+        /* no need to go through the hook buffers */
+        upipe_http_src_receive(upipe, true);
+        return;
+    }
+
     int ret = upipe_http_src->hook->transport.read(
         upipe, upipe_http_src->hook, upipe_http_src->fd);
     upipe_http_src_worker_update_state(upipe, ret);
@@ -874,12 +1404,158 @@ static void upipe_http_src_data_out(struct upump *upump)
     struct upipe_http_src *upipe_http_src = upipe_http_src_from_upipe(upipe);
 
     ueventfd_read(&upipe_http_src->data_out);
+    upipe_http_src_receive(upipe, false);
+}
 
-    uint8_t buffer[upipe_http_src->output_size];
-    ssize_t len =
-        upipe_http_src->hook->data.read(
-            upipe, upipe_http_src->hook, buffer, upipe_http_src->output_size);
-    if (unlikely(len < 0)) {
+/** @internal @This opens an additional connection to the peer of the main
+ * connection. The connection is non-blocking and may still be in progress,
+ * it is completed by the write watcher of the range request.
+ *
+ * @param upipe description structure of the pipe
+ * @return a socket descriptor, or -1
+ */
+static int upipe_http_src_connect(struct upipe *upipe)
+{
+    struct upipe_http_src *upipe_http_src = upipe_http_src_from_upipe(upipe);
+
+    int fd = upipe_http_src_mgr_get_conn(upipe->mgr, upipe_http_src->conn_key);
+    if (fd != -1)
+        return fd;
+
+    fd = socket(upipe_http_src->addr.ss_family, SOCK_STREAM, 0);
+    if (unlikely(fd < 0)) {
+        upipe_err_va(upipe, "can't create socket (%s)", strerror(errno));
+        return -1;
+    }
+    if (unlikely(fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0 ||
+                 (connect(fd, (struct sockaddr *)&upipe_http_src->addr,
+                          upipe_http_src->addrlen) < 0 &&
+                  errno != EINPROGRESS))) {
+        upipe_err_va(upipe, "can't connect (%s)", strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/** @internal @This is called when data is available on the connection of
+ * a range request.
+ *
+ * @param upump description structure of the watcher
+ */
+static void upipe_http_src_part_read(struct upump *upump)
+{
+    struct upipe_http_src_part *part =
+        upump_get_opaque(upump, struct upipe_http_src_part *);
+    struct upipe *upipe = part->upipe;
+    struct upipe_http_src *upipe_http_src = upipe_http_src_from_upipe(upipe);
+
+    if (likely(upipe_http_src->upump_timeout))
+        upump_restart(upipe_http_src->upump_timeout);
+
+    uint8_t *buffer;
+    int size;
+    struct ubuf *ubuf = upipe_http_src_read_alloc(upipe, &buffer, &size);
+    if (unlikely(ubuf == NULL))
+        return;
+
+    ssize_t len = read(part->fd, buffer, size);
+    int err = errno;
+    ubuf_block_unmap(ubuf, 0);
+    if (unlikely(len <= 0)) {
+        ubuf_free(ubuf);
+        if (len < 0) {
+            switch (err) {
+                case EINTR:
+                case EAGAIN:
+#if EAGAIN != EWOULDBLOCK
+                case EWOULDBLOCK:
+#endif
+                    /* not an issue, try again later */
+                    return;
+                default:
+                    break;
+            }
+            upipe_err_va(upipe, "read error from %s (%s)",
+                         upipe_http_src->url, strerror(err));
+        }
+        else
+            upipe_err_va(upipe, "connection closed during range %"PRIu64,
+                         part->offset);
+        upipe_http_src_abort(upipe);
+        return;
+    }
+    upipe_http_src_adapt_read_size(upipe, len);
+
+    if (unlikely(!ubase_check(ubuf_block_resize(ubuf, 0, len)) ||
+                 upipe_http_src_rx_map(upipe, ubuf) == NULL)) {
+        ubuf_free(ubuf);
+        upipe_http_src_abort(upipe);
+        return;
+    }
+    size_t parsed_len =
+        http_parser_execute(&part->parser, &upipe_http_src->part_settings,
+                            (const char *)upipe_http_src->rx_base, len);
+    upipe_http_src_rx_unmap(upipe);
+
+    if (!part->done) {
+        if (parsed_len != len) {
+            upipe_warn_va(upipe, "range %"PRIu64" failed", part->offset);
+            upipe_http_src_abort(upipe);
+        }
+        else
+            /* output the received data if this is the range being output */
+            upipe_http_src_flush(upipe);
+        return;
+    }
+
+    if (part->length != UINT64_MAX && part->received != part->length) {
+        upipe_warn_va(upipe, "range %"PRIu64" is truncated", part->offset);
+        upipe_http_src_abort(upipe);
+        return;
+    }
+
+    /* keep the connection for another range */
+    part->keepalive = parsed_len == len &&
+                      http_should_keep_alive(&part->parser);
+    upump_free(part->upump);
+    part->upump = NULL;
+    if (!part->keepalive)
+        ubase_clean_fd(&part->fd);
+    upipe_http_src_flush(upipe);
+}
+
+/** @internal @This is called when the connection of a range request is
+ * writable. It completes the connection and sends the request, then waits
+ * for the response.
+ *
+ * @param upump description structure of the watcher
+ */
+static void upipe_http_src_part_write(struct upump *upump)
+{
+    struct upipe_http_src_part *part =
+        upump_get_opaque(upump, struct upipe_http_src_part *);
+    struct upipe *upipe = part->upipe;
+    struct upipe_http_src *upipe_http_src = upipe_http_src_from_upipe(upipe);
+
+    if (likely(upipe_http_src->upump_timeout))
+        upump_restart(upipe_http_src->upump_timeout);
+
+    if (!part->sent) {
+        int err = 0;
+        socklen_t errlen = sizeof (err);
+        if (getsockopt(part->fd, SOL_SOCKET, SO_ERROR, &err, &errlen) < 0)
+            err = errno;
+        if (unlikely(err)) {
+            upipe_err_va(upipe, "can't connect (%s)", strerror(err));
+            upipe_http_src_abort(upipe);
+            return;
+        }
+    }
+
+    ssize_t wsize = write(part->fd, part->request.buf + part->sent,
+                          part->request.len - part->sent);
+    if (unlikely(wsize < 0)) {
         switch (errno) {
             case EINTR:
             case EAGAIN:
@@ -888,32 +1564,246 @@ static void upipe_http_src_data_out(struct upump *upump)
 #endif
                 /* not an issue, try again later */
                 return;
-
             default:
                 break;
         }
-        upipe_err_va(upipe, "read error from %s (%s)", upipe_http_src->url,
-                     strerror(errno));
+        upipe_err_va(upipe, "error sending request (%s)", strerror(errno));
+        upipe_http_src_abort(upipe);
+        return;
     }
-    else if (len == 0) {
-        upipe_dbg(upipe, "connection closed");
+    part->sent += wsize;
+    if (part->sent < part->request.len)
+        return;
+
+    free(part->request.buf);
+    part->request.buf = NULL;
+    upump_free(part->upump);
+    part->upump = upump_alloc_fd_read(upipe_http_src->upump_mgr,
+                                      upipe_http_src_part_read, part,
+                                      upipe->refcount, part->fd);
+    if (unlikely(part->upump == NULL)) {
+        upipe_throw_fatal(upipe, UBASE_ERR_UPUMP);
+        upipe_http_src_abort(upipe);
+        return;
+    }
+    upump_start(part->upump);
+}
+
+/** @internal @This starts a range request for the next part of a parallel
+ * transfer.
+ *
+ * @param upipe description structure of the pipe
+ * @param fd connection to use, or -1 to open a new one
+ * @return false in case of error
+ */
+static bool upipe_http_src_part_start(struct upipe *upipe, int fd)
+{
+    struct upipe_http_src *upipe_http_src = upipe_http_src_from_upipe(upipe);
+    uint64_t offset = upipe_http_src->next_offset;
+    uint64_t length = UINT64_MAX;
+    if (upipe_http_src->transfer_end != UINT64_MAX) {
+        length = upipe_http_src->transfer_end - offset;
+        if (length > upipe_http_src->part_size)
+            length = upipe_http_src->part_size;
     }
-    else if (len > 0)
-        ueventfd_write(&upipe_http_src->data_out);
 
-    upipe_http_src_process(upipe, buffer, len > 0 ? len : 0);
+    if (fd == -1 && (fd = upipe_http_src_connect(upipe)) == -1)
+        return false;
 
-    if (len <= 0) {
-        upipe_http_src_set_upump_read(upipe, NULL);
-        upipe_http_src_set_upump_write(upipe, NULL);
-        upipe_http_src_set_upump_timeout(upipe, NULL);
-        upipe_http_src_set_upump_data_in(upipe, NULL);
-        upipe_http_src_set_upump_data_out(upipe, NULL);
-        upipe_throw_source_end(upipe);
+    struct upipe_http_src_part *part = malloc(sizeof (*part));
+    if (unlikely(part == NULL)) {
+        close(fd);
+        upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+        return false;
+    }
+    uchain_init(upipe_http_src_part_to_uchain(part));
+    part->upipe = upipe;
+    part->fd = fd;
+    part->upump = NULL;
+    part->request.buf = NULL;
+    part->request.len = 0;
+    part->request.size = 0;
+    part->sent = 0;
+    http_parser_init(&part->parser, HTTP_RESPONSE);
+    part->offset = offset;
+    part->length = length;
+    part->received = 0;
+    part->uref = NULL;
+    part->done = false;
+    part->keepalive = false;
+    ulist_add(&upipe_http_src->parts, upipe_http_src_part_to_uchain(part));
+
+    int ret = upipe_http_src_build_request(upipe, &part->request, offset,
+            length == UINT64_MAX ? UINT64_MAX : offset + length - 1);
+    if (unlikely(!ubase_check(ret) ||
+                 fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0)) {
+        upipe_http_src_part_free(upipe, part);
+        return false;
     }
 
-    if (upipe_http_src->upump_read)
-        upump_start(upipe_http_src->upump_read);
+    /* the request is sent once the connection is established */
+    part->upump = upump_alloc_fd_write(upipe_http_src->upump_mgr,
+                                       upipe_http_src_part_write, part,
+                                       upipe->refcount, fd);
+    if (unlikely(part->upump == NULL)) {
+        upipe_http_src_part_free(upipe, part);
+        upipe_throw_fatal(upipe, UBASE_ERR_UPUMP);
+        return false;
+    }
+    upump_start(part->upump);
+
+    upipe_http_src->next_offset = length == UINT64_MAX ? UINT64_MAX :
+                                  offset + length;
+    return true;
+}
+
+/** @internal @This retrieves the range request from its parser.
+ *
+ * @param parser http parser structure
+ * @return pointer to the range request
+ */
+static inline struct upipe_http_src_part *
+upipe_http_src_part_from_parser(http_parser *parser)
+{
+    return container_of(parser, struct upipe_http_src_part, parser);
+}
+
+/** @internal @This is called by http_parser when the status of a range
+ * request is received.
+ *
+ * @param parser http parser structure
+ * @return 0, or -1 if the range was not returned
+ */
+static int upipe_http_src_part_status(http_parser *parser)
+{
+    struct upipe_http_src_part *part = upipe_http_src_part_from_parser(parser);
+    struct upipe *upipe = part->upipe;
+
+    if (parser->status_code == 206)
+        return 0;
+    upipe_warn_va(upipe, "range %"PRIu64" returned http code %i",
+                  part->offset, parser->status_code);
+    if (parser->status_code >= 400)
+        upipe_http_src_throw_error(upipe, parser->status_code);
+    return -1;
+}
+
+/** @internal @This is called by http_parser when receiving data of a range
+ * request.
+ *
+ * @param parser http parser structure
+ * @param at data buffer
+ * @param len data length
+ * @return 0, or -1 in case of error
+ */
+static int upipe_http_src_part_body(http_parser *parser,
+                                    const char *at, size_t len)
+{
+    struct upipe_http_src_part *part = upipe_http_src_part_from_parser(parser);
+    struct upipe *upipe = part->upipe;
+
+    struct uref *uref = upipe_http_src_alloc_data(upipe, at, len);
+    if (unlikely(uref == NULL))
+        return -1;
+    part->received += len;
+
+    /* the data is output by @ref upipe_http_src_flush once the parser
+     * returned, since the output may close the pipe */
+    if (part->uref == NULL)
+        part->uref = uref;
+    else {
+        struct ubuf *ubuf = uref_detach_ubuf(uref);
+        uref_free(uref);
+        uref_block_append(part->uref, ubuf);
+    }
+    return 0;
+}
+
+/** @internal @This is called by http_parser when a range request is
+ * complete.
+ *
+ * @param parser http parser structure
+ * @return 0
+ */
+static int upipe_http_src_part_complete(http_parser *parser)
+{
+    struct upipe_http_src_part *part = upipe_http_src_part_from_parser(parser);
+    part->done = true;
+    http_parser_pause(parser, 1);
+    return 0;
+}
+
+/** @internal @This outputs the received ranges in order, starts new range
+ * requests, and ends the parallel transfer.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_http_src_flush(struct upipe *upipe)
+{
+    struct upipe_http_src *upipe_http_src = upipe_http_src_from_upipe(upipe);
+    struct uchain *uchain;
+
+    while (upipe_http_src->primary_done &&
+           (uchain = ulist_peek(&upipe_http_src->parts)) != NULL) {
+        struct upipe_http_src_part *part =
+            upipe_http_src_part_from_uchain(uchain);
+        if (part->uref != NULL) {
+            struct uref *uref = part->uref;
+            size_t size = 0;
+            part->uref = NULL;
+            uref_block_size(uref, &size);
+            upipe_http_src->position += size;
+            upipe_http_src_output(upipe, uref, &part->upump);
+            if (!upipe_http_src->transfer_end)
+                /* closed meanwhile */
+                return;
+        }
+        if (!part->done)
+            break;
+
+        /* hand the connection over to the next range */
+        int fd = part->fd;
+        part->fd = -1;
+        upipe_http_src_part_free(upipe, part);
+        if (fd == -1)
+            continue;
+        if (upipe_http_src->next_offset >= upipe_http_src->transfer_end)
+            upipe_http_src_mgr_put_conn(upipe->mgr, upipe_http_src->conn_key,
+                                        fd);
+        else if (!upipe_http_src_part_start(upipe, fd)) {
+            upipe_http_src_abort(upipe);
+            return;
+        }
+    }
+
+    while (upipe_http_src->next_offset < upipe_http_src->transfer_end &&
+           ulist_depth(&upipe_http_src->parts) +
+           (upipe_http_src->primary_done ? 0 : 1) < upipe_http_src->parallel) {
+        /* reuse the connection of a completed range if any */
+        int fd = -1;
+        ulist_foreach(&upipe_http_src->parts, uchain) {
+            struct upipe_http_src_part *part =
+                upipe_http_src_part_from_uchain(uchain);
+            if (part->done && part->fd != -1) {
+                fd = part->fd;
+                part->fd = -1;
+                break;
+            }
+        }
+        if (!upipe_http_src_part_start(upipe, fd)) {
+            upipe_http_src_abort(upipe);
+            return;
+        }
+    }
+
+    if (upipe_http_src->primary_done &&
+        ulist_empty(&upipe_http_src->parts) &&
+        upipe_http_src->next_offset >= upipe_http_src->transfer_end) {
+        upipe_dbg(upipe, "parallel transfer complete");
+        upipe_http_src_output_data(upipe, NULL, 0);
+        upipe_http_src_close(upipe);
+        upipe_throw_source_end(upipe);
+    }
 }
 
 /** @internal @This checks if the pump may be allocated.
@@ -1049,6 +1939,25 @@ static int upipe_http_src_get_uri(struct upipe *upipe, const char **url_p)
     return UBASE_ERR_NONE;
 }
 
+/** @internal @This allocates the key identifying a connection in the
+ * manager pool.
+ *
+ * @param scheme uri scheme
+ * @param host remote host
+ * @param service remote service, or an empty string
+ * @return an allocated string, or NULL
+ */
+static char *upipe_http_src_conn_key(const char *scheme, const char *host,
+                                     const char *service)
+{
+    size_t len = strlen(scheme) + strlen(host) + strlen(service) + 3;
+    char *key = malloc(len);
+    if (likely(key != NULL))
+        snprintf(key, len, "%s %s%s%s", scheme, host,
+                 *service ? ":" : "", service);
+    return key;
+}
+
 /** @internal @This asks to open the given http (real code here).
  *
  * @param upipe description structure of the pipe
@@ -1061,13 +1970,15 @@ static int upipe_http_src_open_url(struct upipe *upipe)
     struct uref *flow_def = upipe_http_src->flow_def;
     struct addrinfo *info = NULL, *res;
     struct addrinfo hints;
-    int ret, fd = -1;
+    int ret = 0, fd = -1;
 
     if (unlikely(flow_def == NULL))
         return UBASE_ERR_INVALID;
 
     /* init parser */
     http_parser_init(&upipe_http_src->parser, HTTP_RESPONSE);
+    upipe_http_src->complete = false;
+    upipe_http_src->content_range = false;
 
     /* get socket information */
     memset(&hints, 0, sizeof(struct addrinfo));
@@ -1075,6 +1986,9 @@ static int upipe_http_src_open_url(struct upipe *upipe)
     hints.ai_socktype = SOCK_STREAM;
     hints.ai_protocol = 0;
 
+    const char *scheme = "";
+    uref_uri_get_scheme(flow_def, &scheme);
+
     if (upipe_http_src->proxy) {
         struct uuri uuri;
         ret = uuri_from_str(&uuri, upipe_http_src->proxy);
@@ -1088,10 +2002,16 @@ static int upipe_http_src_open_url(struct upipe *upipe)
         char service[uuri.authority.port.len + 1];
         ustring_cpy(uuri.authority.port, service, sizeof (service));
 
-        upipe_verbose_va(upipe, "getaddrinfo to %s%s%s",
-                         host, strlen(service) ? ":" : "",
-                         service);
-        ret = getaddrinfo(host, service, &hints, &info);
+        upipe_http_src->conn_key =
+            upipe_http_src_conn_key(scheme, upipe_http_src->proxy, "");
+        fd = upipe_http_src_mgr_get_conn(upipe->mgr,
+                                         upipe_http_src->conn_key);
+        if (fd == -1) {
+            upipe_verbose_va(upipe, "getaddrinfo to %s%s%s",
+                             host, strlen(service) ? ":" : "",
+                             service);
+            ret = getaddrinfo(host, service, &hints, &info);
+        }
     }
     else {
         const char *host;
@@ -1101,32 +2021,49 @@ static int upipe_http_src_open_url(struct upipe *upipe)
         if (!ubase_check(uref_uri_get_port(flow_def, &service)))
             UBASE_RETURN(uref_uri_get_scheme(flow_def, &service));
 
-        upipe_verbose_va(upipe, "getaddrinfo to %s", host);
-        ret = getaddrinfo(host, service, &hints, &info);
+        upipe_http_src->conn_key =
+            upipe_http_src_conn_key(scheme, host, service);
+        fd = upipe_http_src_mgr_get_conn(upipe->mgr,
+                                         upipe_http_src->conn_key);
+        if (fd == -1) {
+            upipe_verbose_va(upipe, "getaddrinfo to %s", host);
+            ret = getaddrinfo(host, service, &hints, &info);
+        }
     }
 
-    if (unlikely(ret)) {
-        upipe_err_va(upipe, "getaddrinfo: %s", gai_strerror(ret));
-        return UBASE_ERR_EXTERNAL;
-    }
+    if (fd != -1)
+        upipe_dbg_va(upipe, "reusing connection to %s",
+                     upipe_http_src->conn_key);
+    else {
+        if (unlikely(ret)) {
+            upipe_err_va(upipe, "getaddrinfo: %s", gai_strerror(ret));
+            return UBASE_ERR_EXTERNAL;
+        }
 
-    /* connect to first working resource */
-    for (res = info; res; res = res->ai_next) {
-        fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
-        if (likely(fd >= 0)) {
-            if (connect(fd, res->ai_addr, res->ai_addrlen) == 0)
-                break;
-            ubase_clean_fd(&fd);
+        /* connect to first working resource */
+        for (res = info; res; res = res->ai_next) {
+            fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+            if (likely(fd >= 0)) {
+                if (connect(fd, res->ai_addr, res->ai_addrlen) == 0)
+                    break;
+                ubase_clean_fd(&fd);
+            }
         }
-    }
-    freeaddrinfo(info);
+        freeaddrinfo(info);
 
-    if (fd < 0) {
-        upipe_err(upipe, "could not connect to any resource");
-        upipe_throw_error(upipe, UBASE_ERR_EXTERNAL);
-        return UBASE_ERR_EXTERNAL;
+        if (fd < 0) {
+            upipe_err(upipe, "could not connect to any resource");
+            upipe_throw_error(upipe, UBASE_ERR_EXTERNAL);
+            return UBASE_ERR_EXTERNAL;
+        }
     }
 
+    /* remember the peer for additional connections */
+    upipe_http_src->addrlen = sizeof (upipe_http_src->addr);
+    if (getpeername(fd, (struct sockaddr *)&upipe_http_src->addr,
+                    &upipe_http_src->addrlen) < 0)
+        upipe_http_src->addrlen = 0;
+
     upipe_http_src->hook =
         http_src_hook_init(&upipe_http_src->http_hook, flow_def);
 
@@ -1285,6 +2222,44 @@ static int _upipe_http_src_set_user_agent(struct upipe *upipe,
     return UBASE_ERR_NONE;
 }
 
+/** @internal @This gets the parallel range requests settings.
+ *
+ * @param upipe description structure of the pipe
+ * @param connections_p filled with the maximum number of connections
+ * @param part_size_p filled with the size of each range request
+ * @return an error code
+ */
+static int _upipe_http_src_get_parallel(struct upipe *upipe,
+                                        unsigned int *connections_p,
+                                        uint64_t *part_size_p)
+{
+    struct upipe_http_src *upipe_http_src = upipe_http_src_from_upipe(upipe);
+    if (connections_p)
+        *connections_p = upipe_http_src->parallel;
+    if (part_size_p)
+        *part_size_p = upipe_http_src->part_size;
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This sets the parallel range requests settings.
+ *
+ * @param upipe description structure of the pipe
+ * @param connections maximum number of connections, 0 or 1 to disable
+ * @param part_size size of each range request
+ * @return an error code
+ */
+static int _upipe_http_src_set_parallel(struct upipe *upipe,
+                                        unsigned int connections,
+                                        uint64_t part_size)
+{
+    struct upipe_http_src *upipe_http_src = upipe_http_src_from_upipe(upipe);
+    if (connections > 1 && !part_size)
+        return UBASE_ERR_INVALID;
+    upipe_http_src->parallel = connections;
+    upipe_http_src->part_size = part_size;
+    return UBASE_ERR_NONE;
+}
+
 /** @internal @This processes control commands on a http source pipe.
  *
  * @param upipe description structure of the pipe
@@ -1368,6 +2343,38 @@ static int _upipe_http_src_control(struct upipe *upipe,
             return _upipe_http_src_set_user_agent(upipe, user_agent);
         }
 
+        case UPIPE_HTTP_SRC_GET_PARALLEL: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_HTTP_SRC_SIGNATURE)
+            unsigned int *connections_p = va_arg(args, unsigned int *);
+            uint64_t *part_size_p = va_arg(args, uint64_t *);
+            return _upipe_http_src_get_parallel(upipe, connections_p,
+                                                part_size_p);
+        }
+        case UPIPE_HTTP_SRC_SET_PARALLEL: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_HTTP_SRC_SIGNATURE)
+            unsigned int connections = va_arg(args, unsigned int);
+            uint64_t part_size = va_arg(args, uint64_t);
+            return _upipe_http_src_set_parallel(upipe, connections, part_size);
+        }
+
+        case UPIPE_HTTP_SRC_GET_MAX_READ_SIZE: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_HTTP_SRC_SIGNATURE)
+            unsigned int *max_read_size_p = va_arg(args, unsigned int *);
+            struct upipe_http_src *upipe_http_src =
+                upipe_http_src_from_upipe(upipe);
+            if (max_read_size_p)
+                *max_read_size_p = upipe_http_src->max_read_size;
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_HTTP_SRC_SET_MAX_READ_SIZE: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_HTTP_SRC_SIGNATURE)
+            struct upipe_http_src *upipe_http_src =
+                upipe_http_src_from_upipe(upipe);
+            upipe_http_src->max_read_size = va_arg(args, unsigned int);
+            upipe_http_src->read_size = upipe_http_src->output_size;
+            return UBASE_ERR_NONE;
+        }
+
         default:
             return UBASE_ERR_UNHANDLED;
     }
@@ -1400,11 +2407,140 @@ struct upipe_http_src_mgr {
     char *proxy;
     /** user agent */
     char *user_agent;
+    /** maximum number of idle connections */
+    unsigned int keepalive;
+    /** number of idle connections */
+    unsigned int nb_conns;
+    /** idle connections, oldest first */
+    struct uchain conns;
 };
 
 UBASE_FROM_TO(upipe_http_src_mgr, upipe_mgr, upipe_mgr, upipe_mgr)
 UBASE_FROM_TO(upipe_http_src_mgr, urefcount, urefcount, urefcount);
 
+/** @internal @This stores an idle connection. */
+struct upipe_http_src_conn {
+    /** uchain for the list of idle connections */
+    struct uchain uchain;
+    /** socket descriptor */
+    int fd;
+    /** connection key */
+    char key[];
+};
+
+UBASE_FROM_TO(upipe_http_src_conn, uchain, uchain, uchain)
+
+/** @internal @This closes the oldest idle connection.
+ *
+ * @param upipe_http_src_mgr private structure of the manager
+ */
+static void upipe_http_src_mgr_evict(
+        struct upipe_http_src_mgr *upipe_http_src_mgr)
+{
+    struct uchain *uchain = ulist_pop(&upipe_http_src_mgr->conns);
+    if (uchain == NULL)
+        return;
+    struct upipe_http_src_conn *conn = upipe_http_src_conn_from_uchain(uchain);
+    close(conn->fd);
+    free(conn);
+    upipe_http_src_mgr->nb_conns--;
+}
+
+/** @internal @This takes an idle connection from the pool. Connections
+ * closed by the server meanwhile are discarded.
+ *
+ * @param mgr pointer to upipe manager
+ * @param key connection key
+ * @return a connected socket descriptor, or -1
+ */
+static int upipe_http_src_mgr_get_conn(struct upipe_mgr *mgr, const char *key)
+{
+    struct upipe_http_src_mgr *upipe_http_src_mgr =
+        upipe_http_src_mgr_from_upipe_mgr(mgr);
+    struct uchain *uchain, *uchain_tmp;
+
+    if (key == NULL)
+        return -1;
+
+    ulist_delete_foreach_reverse(&upipe_http_src_mgr->conns,
+                                 uchain, uchain_tmp) {
+        struct upipe_http_src_conn *conn =
+            upipe_http_src_conn_from_uchain(uchain);
+        if (strcmp(conn->key, key))
+            continue;
+
+        int fd = conn->fd;
+        ulist_delete(uchain);
+        free(conn);
+        upipe_http_src_mgr->nb_conns--;
+
+        /* an idle connection must have nothing to read */
+        char c;
+        if (recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) < 0) {
+            switch (errno) {
+                case EAGAIN:
+#if EAGAIN != EWOULDBLOCK
+                case EWOULDBLOCK:
+#endif
+                    return fd;
+                default:
+                    break;
+            }
+        }
+        close(fd);
+    }
+    return -1;
+}
+
+/** @internal @This gives an idle connection to the pool.
+ *
+ * @param mgr pointer to upipe manager
+ * @param key connection key
+ * @param fd socket descriptor
+ */
+static void upipe_http_src_mgr_put_conn(struct upipe_mgr *mgr, const char *key,
+                                        int fd)
+{
+    struct upipe_http_src_mgr *upipe_http_src_mgr =
+        upipe_http_src_mgr_from_upipe_mgr(mgr);
+
+    if (!upipe_http_src_mgr->keepalive || key == NULL) {
+        close(fd);
+        return;
+    }
+
+    struct upipe_http_src_conn *conn = malloc(sizeof (*conn) +
+                                              strlen(key) + 1);
+    if (unlikely(conn == NULL)) {
+        close(fd);
+        return;
+    }
+    if (upipe_http_src_mgr->nb_conns >= upipe_http_src_mgr->keepalive)
+        upipe_http_src_mgr_evict(upipe_http_src_mgr);
+    uchain_init(upipe_http_src_conn_to_uchain(conn));
+    conn->fd = fd;
+    strcpy(conn->key, key);
+    ulist_add(&upipe_http_src_mgr->conns, upipe_http_src_conn_to_uchain(conn));
+    upipe_http_src_mgr->nb_conns++;
+}
+
+/** @internal @This sets the maximum number of idle connections.
+ *
+ * @param mgr pointer to upipe manager
+ * @param keepalive maximum number of idle connections
+ * @return an error code
+ */
+static int _upipe_http_src_mgr_set_keepalive(struct upipe_mgr *mgr,
+                                             unsigned int keepalive)
+{
+    struct upipe_http_src_mgr *upipe_http_src_mgr =
+        upipe_http_src_mgr_from_upipe_mgr(mgr);
+    upipe_http_src_mgr->keepalive = keepalive;
+    while (upipe_http_src_mgr->nb_conns > keepalive)
+        upipe_http_src_mgr_evict(upipe_http_src_mgr);
+    return UBASE_ERR_NONE;
+}
+
 static int _upipe_http_src_mgr_set_cookie(struct upipe_mgr *upipe_mgr,
                                           const char *cookie_string)
 {
@@ -1578,6 +2714,20 @@ static int upipe_http_src_mgr_control(struct upipe_mgr *upipe_mgr,
         const char *user_agent = va_arg(args, const char *);
         return _upipe_http_src_mgr_set_user_agent(upipe_mgr, user_agent);
     }
+
+    case UPIPE_HTTP_SRC_MGR_GET_KEEPALIVE: {
+        UBASE_SIGNATURE_CHECK(args, UPIPE_HTTP_SRC_SIGNATURE)
+        unsigned int *keepalive_p = va_arg(args, unsigned int *);
+        if (keepalive_p)
+            *keepalive_p = upipe_http_src_mgr_from_upipe_mgr(upipe_mgr)->
+                keepalive;
+        return UBASE_ERR_NONE;
+    }
+    case UPIPE_HTTP_SRC_MGR_SET_KEEPALIVE: {
+        UBASE_SIGNATURE_CHECK(args, UPIPE_HTTP_SRC_SIGNATURE)
+        unsigned int keepalive = va_arg(args, unsigned int);
+        return _upipe_http_src_mgr_set_keepalive(upipe_mgr, keepalive);
+    }
     }
     return UBASE_ERR_UNHANDLED;
 }
@@ -1595,6 +2745,8 @@ static void upipe_http_src_mgr_free(struct urefcount *urefcount)
         free(cookie->value);
         free(cookie);
     }
+    while (upipe_http_src_mgr->nb_conns)
+        upipe_http_src_mgr_evict(upipe_http_src_mgr);
     free(upipe_http_src_mgr->user_agent);
     free(upipe_http_src_mgr->proxy);
     urefcount_clean(urefcount);
@@ -1628,6 +2780,9 @@ struct upipe_mgr *upipe_http_src_mgr_alloc(void)
     };
     upipe_mgr->refcount = urefcount;
     ulist_init(&upipe_http_src_mgr->cookies);
+    ulist_init(&upipe_http_src_mgr->conns);
+    upipe_http_src_mgr->keepalive = 0;
+    upipe_http_src_mgr->nb_conns = 0;
     upipe_http_src_mgr->proxy = NULL;
     upipe_http_src_mgr->user_agent = strdup(USER_AGENT);
     if (unlikely(!upipe_http_src_mgr->user_agent)) {
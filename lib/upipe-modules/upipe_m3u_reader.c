@@ -166,6 +166,40 @@ static int attribute_iterate(const char **item,
 #define PLAYLIST_FLOW_DEF       M3U_FLOW_DEF "playlist."
 #define MASTER_FLOW_DEF         M3U_FLOW_DEF "master."
 
+/** @internal @This describes a media segment of a playlist. */
+struct upipe_m3u_reader_segment {
+    /** offset of the segment lines in the text buffer */
+    size_t offset;
+    /** size of the segment lines */
+    size_t size;
+    /** version of the key used by the segment */
+    uint64_t key;
+    /** version of the map used by the segment */
+    uint64_t map;
+    /** program date time before the segment */
+    uint64_t pdt_in;
+    /** program date time after the segment */
+    uint64_t pdt_out;
+};
+
+/** @internal @This stores the media segments of a playlist. */
+struct upipe_m3u_reader_history {
+    /** media sequence of the first segment */
+    uint64_t media_sequence;
+    /** segment lines, each one terminated by a line feed */
+    char *text;
+    /** size of the segment lines */
+    size_t text_size;
+    /** allocated size of the text buffer */
+    size_t text_alloc;
+    /** segments */
+    struct upipe_m3u_reader_segment *segments;
+    /** number of segments */
+    size_t count;
+    /** allocated number of segments */
+    size_t alloc;
+};
+
 /** @internal @This is the private context of a m3u reader pipe. */
 struct upipe_m3u_reader {
     /** urefcount management structure */
@@ -195,6 +229,10 @@ struct upipe_m3u_reader {
     struct uref *key;
     /** current map */
     struct uref *map;
+    /** version of the current key */
+    uint64_t key_version;
+    /** version of the current map */
+    uint64_t map_version;
     /** current program date time */
     uint64_t program_date_time;
     /** current discontinuity */
@@ -209,6 +247,21 @@ struct upipe_m3u_reader {
 
     /** need flush */
     bool restart;
+
+    /** only output the segments changed since the previous playlist */
+    bool incremental;
+    /** incremental parsing is used for the current playlist */
+    bool delay;
+    /** segments of the previous playlist */
+    struct upipe_m3u_reader_history prev;
+    /** segments of the current playlist */
+    struct upipe_m3u_reader_history cur;
+    /** offset of the lines of the pending segment */
+    size_t pending;
+    /** number of leading segments kept from the previous playlist */
+    uint64_t kept;
+    /** all the segments so far were kept */
+    bool matching;
 };
 
 UPIPE_HELPER_UPIPE(upipe_m3u_reader, upipe, UPIPE_M3U_READER_SIGNATURE)
@@ -221,6 +274,63 @@ UPIPE_HELPER_OUTPUT(upipe_m3u_reader, output, output_flow_def,
 UPIPE_HELPER_UREF_STREAM(upipe_m3u_reader, next_uref, next_uref_size,
                          urefs, NULL)
 
+/** @internal @This initializes a playlist history.
+ *
+ * @param history playlist history
+ */
+static void upipe_m3u_reader_history_init(
+    struct upipe_m3u_reader_history *history)
+{
+    history->media_sequence = 0;
+    history->text = NULL;
+    history->text_size = 0;
+    history->text_alloc = 0;
+    history->segments = NULL;
+    history->count = 0;
+    history->alloc = 0;
+}
+
+/** @internal @This cleans a playlist history.
+ *
+ * @param history playlist history
+ */
+static void upipe_m3u_reader_history_clean(
+    struct upipe_m3u_reader_history *history)
+{
+    free(history->text);
+    free(history->segments);
+    upipe_m3u_reader_history_init(history);
+}
+
+/** @internal @This finds a segment in a playlist history.
+ *
+ * @param history playlist history
+ * @param media_sequence media sequence of the segment
+ * @return a pointer to the segment or NULL
+ */
+static const struct upipe_m3u_reader_segment *
+upipe_m3u_reader_history_find(const struct upipe_m3u_reader_history *history,
+                              uint64_t media_sequence)
+{
+    if (media_sequence < history->media_sequence ||
+        media_sequence - history->media_sequence >= history->count)
+        return NULL;
+    return &history->segments[media_sequence - history->media_sequence];
+}
+
+/** @internal @This forgets the segments of the previous playlists.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_m3u_reader_reset_history(struct upipe *upipe)
+{
+    struct upipe_m3u_reader *upipe_m3u_reader =
+        upipe_m3u_reader_from_upipe(upipe);
+
+    upipe_m3u_reader_history_clean(&upipe_m3u_reader->prev);
+    upipe_m3u_reader->matching = false;
+}
+
 /** @internal @This allocates a m3u reader pipe.
  *
  * @param mgr common management structure
@@ -249,10 +359,19 @@ static struct upipe *upipe_m3u_reader_alloc(struct upipe_mgr *mgr,
     upipe_m3u_reader->item = NULL;
     upipe_m3u_reader->key = NULL;
     upipe_m3u_reader->map = NULL;
+    upipe_m3u_reader->key_version = 0;
+    upipe_m3u_reader->map_version = 0;
     upipe_m3u_reader->program_date_time = UINT64_MAX;
     upipe_m3u_reader->discontinuity = false;
     upipe_m3u_reader->gap = false;
     upipe_m3u_reader->restart = false;
+    upipe_m3u_reader->incremental = false;
+    upipe_m3u_reader->delay = false;
+    upipe_m3u_reader_history_init(&upipe_m3u_reader->prev);
+    upipe_m3u_reader_history_init(&upipe_m3u_reader->cur);
+    upipe_m3u_reader->pending = 0;
+    upipe_m3u_reader->kept = 0;
+    upipe_m3u_reader->matching = false;
     upipe_throw_ready(upipe);
 
     return upipe;
@@ -268,6 +387,7 @@ static void upipe_m3u_reader_flush(struct upipe *upipe)
         upipe_m3u_reader_from_upipe(upipe);
 
     uref_free(upipe_m3u_reader->current_flow_def);
+    upipe_m3u_reader->current_flow_def = NULL;
     uref_free(upipe_m3u_reader->item);
     upipe_m3u_reader->item = NULL;
 
@@ -276,6 +396,12 @@ static void upipe_m3u_reader_flush(struct upipe *upipe)
         uref_free(uref_from_uchain(uchain));
     upipe_m3u_reader_clean_uref_stream(upipe);
     upipe_m3u_reader_init_uref_stream(upipe);
+
+    upipe_m3u_reader->cur.text_size = 0;
+    upipe_m3u_reader->cur.count = 0;
+    upipe_m3u_reader->pending = 0;
+    upipe_m3u_reader->kept = 0;
+    upipe_m3u_reader->matching = upipe_m3u_reader->prev.count > 0;
 }
 
 /** @internal @This frees a m3u pipe.
@@ -292,6 +418,8 @@ static void upipe_m3u_reader_free(struct upipe *upipe)
     uref_free(upipe_m3u_reader->key);
     uref_free(upipe_m3u_reader->map);
     upipe_m3u_reader_flush(upipe);
+    upipe_m3u_reader_history_clean(&upipe_m3u_reader->prev);
+    upipe_m3u_reader_history_clean(&upipe_m3u_reader->cur);
     uref_free(upipe_m3u_reader->flow_def);
     upipe_m3u_reader_clean_uref_stream(upipe);
     upipe_m3u_reader_clean_output(upipe);
@@ -783,10 +911,6 @@ static int upipe_m3u_reader_key(struct upipe *upipe,
         return UBASE_ERR_ALLOC;
     }
 
-    if (upipe_m3u_reader->key)
-        uref_free(upipe_m3u_reader->key);
-    upipe_m3u_reader->key = key;
-
     const char *iterator = line;
     struct ustring name, value;
     while (ubase_check(attribute_iterate(&iterator, &name, &value)) &&
@@ -847,6 +971,15 @@ static int upipe_m3u_reader_key(struct upipe *upipe,
         }
     }
 
+    if (upipe_m3u_reader->key &&
+        !udict_cmp(upipe_m3u_reader->key->udict, key->udict)) {
+        /* same key, keep the version */
+        uref_free(key);
+        return UBASE_ERR_NONE;
+    }
+    uref_free(upipe_m3u_reader->key);
+    upipe_m3u_reader->key = key;
+    upipe_m3u_reader->key_version++;
     return UBASE_ERR_NONE;
 }
 
@@ -870,10 +1003,6 @@ static int upipe_m3u_reader_map(struct upipe *upipe,
         return UBASE_ERR_ALLOC;
     }
 
-    if (upipe_m3u_reader->map)
-        uref_free(upipe_m3u_reader->map);
-    upipe_m3u_reader->map = map;
-
     const char *iterator = line;
     struct ustring name, value;
     while (ubase_check(attribute_iterate(&iterator, &name, &value)) &&
@@ -897,6 +1026,15 @@ static int upipe_m3u_reader_map(struct upipe *upipe,
         }
     }
 
+    if (upipe_m3u_reader->map &&
+        !udict_cmp(upipe_m3u_reader->map->udict, map->udict)) {
+        /* same map, keep the version */
+        uref_free(map);
+        return UBASE_ERR_NONE;
+    }
+    uref_free(upipe_m3u_reader->map);
+    upipe_m3u_reader->map = map;
+    upipe_m3u_reader->map_version++;
     return UBASE_ERR_NONE;
 }
 
@@ -1231,6 +1369,255 @@ static int upipe_m3u_reader_process_uri(struct upipe *upipe,
     return UBASE_ERR_NONE;
 }
 
+/** @internal @This describes a m3u tag. */
+struct upipe_m3u_reader_tag {
+    /** tag prefix */
+    const char *pfx;
+    /** tag parser */
+    int (*cb)(struct upipe *, struct uref *, const char *);
+    /** the tag applies to the next media segment */
+    bool segment;
+};
+
+/** @internal @This is the list of handled tags. */
+static const struct upipe_m3u_reader_tag upipe_m3u_reader_tags[] = {
+    { "#EXTM3U", upipe_m3u_reader_process_m3u, false },
+    { "#EXT-X-VERSION:", upipe_m3u_reader_process_version, false },
+    { "#EXT-X-TARGETDURATION:", upipe_m3u_reader_process_target_duration,
+        false },
+    { "#EXT-X-PLAYLIST-TYPE:", upipe_m3u_reader_process_playlist_type,
+        false },
+    { "#EXTINF:", upipe_m3u_reader_process_extinf, true },
+    { "#EXT-X-BYTERANGE:", upipe_m3u_reader_process_byte_range, true },
+    { "#EXT-X-MEDIA:", upipe_m3u_reader_process_media, false },
+    { "#EXT-X-STREAM-INF:", upipe_m3u_reader_ext_x_stream_inf, false },
+    { "#EXT-X-MEDIA-SEQUENCE:", upipe_m3u_reader_ext_x_media_sequence,
+        false },
+    { "#EXT-X-ENDLIST", upipe_m3u_reader_ext_x_endlist, false },
+    { "#EXT-X-KEY:", upipe_m3u_reader_key, false },
+    { "#EXT-X-MAP:", upipe_m3u_reader_map, false },
+    { "#EXT-X-PROGRAM-DATE-TIME:", upipe_m3u_reader_program_date_time,
+        true },
+    { "#EXT-X-DATERANGE:", upipe_m3u_reader_daterange, true },
+    { "#EXT-X-DISCONTINUITY-SEQUENCE:",
+        upipe_m3u_reader_discontinuity_sequence, false },
+    { "#EXT-X-DISCONTINUITY", upipe_m3u_reader_discontinuity, true },
+    { "#EXT-X-GAP", upipe_m3u_reader_gap, true },
+    { "#EXT-X-DEFINE:", upipe_m3u_reader_define, false },
+};
+
+/** @internal @This finds the handler of a tag.
+ *
+ * @param line line starting with a tag
+ * @return a pointer to the tag description or NULL
+ */
+static const struct upipe_m3u_reader_tag *
+upipe_m3u_reader_find_tag(const char *line)
+{
+    for (unsigned i = 0; i < UBASE_ARRAY_SIZE(upipe_m3u_reader_tags); i++)
+        if (!strncmp(line, upipe_m3u_reader_tags[i].pfx,
+                     strlen(upipe_m3u_reader_tags[i].pfx)))
+            return &upipe_m3u_reader_tags[i];
+    return NULL;
+}
+
+/** @internal @This parses a line of a m3u file.
+ *
+ * @param upipe description structure of the pipe
+ * @param flow_def the current flow definition
+ * @param line the line without end of line
+ * @return an error code
+ */
+static int upipe_m3u_reader_parse_line(struct upipe *upipe,
+                                       struct uref *flow_def,
+                                       const char *line)
+{
+    if (*line == '#') {
+        const struct upipe_m3u_reader_tag *tag =
+            upipe_m3u_reader_find_tag(line);
+        if (tag != NULL)
+            return tag->cb(upipe, flow_def, line + strlen(tag->pfx));
+        upipe_dbg_va(upipe, "ignore `%s'", line);
+        return UBASE_ERR_NONE;
+    }
+
+    return upipe_m3u_reader_process_uri(upipe, flow_def, line);
+}
+
+/** @internal @This parses lines stored in the current playlist history.
+ *
+ * @param upipe description structure of the pipe
+ * @param flow_def the current flow definition
+ * @param offset offset of the first line
+ * @param size size of the lines
+ * @return an error code
+ */
+static int upipe_m3u_reader_parse_lines(struct upipe *upipe,
+                                        struct uref *flow_def,
+                                        size_t offset, size_t size)
+{
+    struct upipe_m3u_reader *upipe_m3u_reader =
+        upipe_m3u_reader_from_upipe(upipe);
+    const char *text = upipe_m3u_reader->cur.text + offset;
+
+    while (size) {
+        const char *eol = memchr(text, '\n', size);
+        size_t len = eol - text;
+        char line[len + 1];
+        memcpy(line, text, len);
+        line[len] = '\0';
+        text += len + 1;
+        size -= len + 1;
+
+        UBASE_RETURN(upipe_m3u_reader_parse_line(upipe, flow_def, line));
+    }
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This appends a line to the current playlist history.
+ *
+ * @param upipe description structure of the pipe
+ * @param line the line without end of line
+ * @param len length of the line
+ * @return an error code
+ */
+static int upipe_m3u_reader_append_line(struct upipe *upipe,
+                                        const char *line, size_t len)
+{
+    struct upipe_m3u_reader *upipe_m3u_reader =
+        upipe_m3u_reader_from_upipe(upipe);
+    struct upipe_m3u_reader_history *cur = &upipe_m3u_reader->cur;
+
+    if (cur->text_size + len + 1 > cur->text_alloc) {
+        size_t alloc = cur->text_alloc ? cur->text_alloc : 4096;
+        while (cur->text_size + len + 1 > alloc)
+            alloc *= 2;
+        char *text = realloc(cur->text, alloc);
+        UBASE_ALLOC_RETURN(text);
+        cur->text = text;
+        cur->text_alloc = alloc;
+    }
+    memcpy(cur->text + cur->text_size, line, len);
+    cur->text[cur->text_size + len] = '\n';
+    cur->text_size += len + 1;
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This handles the end of a media segment in incremental mode.
+ * The segment is skipped if it is identical to the segment with the same
+ * media sequence in the previous playlist, and all the previous segments
+ * were skipped too. Otherwise its lines are parsed.
+ *
+ * @param upipe description structure of the pipe
+ * @param flow_def the current flow definition
+ * @return an error code
+ */
+static int upipe_m3u_reader_segment_end(struct upipe *upipe,
+                                        struct uref *flow_def)
+{
+    struct upipe_m3u_reader *upipe_m3u_reader =
+        upipe_m3u_reader_from_upipe(upipe);
+    struct upipe_m3u_reader_history *cur = &upipe_m3u_reader->cur;
+
+    if (cur->count >= cur->alloc) {
+        size_t alloc = cur->alloc ? cur->alloc * 2 : 64;
+        struct upipe_m3u_reader_segment *segments =
+            realloc(cur->segments, alloc * sizeof (*segments));
+        UBASE_ALLOC_RETURN(segments);
+        cur->segments = segments;
+        cur->alloc = alloc;
+    }
+    if (!cur->count) {
+        cur->media_sequence = 0;
+        uref_m3u_playlist_flow_get_media_sequence(flow_def,
+                                                  &cur->media_sequence);
+    }
+
+    struct upipe_m3u_reader_segment *segment = &cur->segments[cur->count++];
+    segment->offset = upipe_m3u_reader->pending;
+    segment->size = cur->text_size - upipe_m3u_reader->pending;
+    segment->key = upipe_m3u_reader->key_version;
+    segment->map = upipe_m3u_reader->map_version;
+    segment->pdt_in = upipe_m3u_reader->program_date_time;
+    upipe_m3u_reader->pending = cur->text_size;
+
+    const struct upipe_m3u_reader_segment *old = NULL;
+    if (upipe_m3u_reader->matching)
+        old = upipe_m3u_reader_history_find(
+            &upipe_m3u_reader->prev, cur->media_sequence + cur->count - 1);
+    if (old != NULL && old->size == segment->size &&
+        old->key == segment->key && old->map == segment->map &&
+        old->pdt_in == segment->pdt_in &&
+        !memcmp(upipe_m3u_reader->prev.text + old->offset,
+                cur->text + segment->offset, segment->size)) {
+        UBASE_RETURN(uref_flow_set_def(flow_def, PLAYLIST_FLOW_DEF));
+        upipe_m3u_reader->program_date_time = old->pdt_out;
+        segment->pdt_out = old->pdt_out;
+        upipe_m3u_reader->kept++;
+        return UBASE_ERR_NONE;
+    }
+
+    upipe_m3u_reader->matching = false;
+    int ret = upipe_m3u_reader_parse_lines(upipe, flow_def, segment->offset,
+                                           segment->size);
+    segment->pdt_out = upipe_m3u_reader->program_date_time;
+    return ret;
+}
+
+/** @internal @This handles the end of a playlist in incremental mode.
+ *
+ * @param upipe description structure of the pipe
+ * @param flow_def the current flow definition
+ * @return an error code
+ */
+static int upipe_m3u_reader_playlist_end(struct upipe *upipe,
+                                         struct uref *flow_def)
+{
+    struct upipe_m3u_reader *upipe_m3u_reader =
+        upipe_m3u_reader_from_upipe(upipe);
+    struct upipe_m3u_reader_history *cur = &upipe_m3u_reader->cur;
+    int ret = UBASE_ERR_NONE;
+
+    if (upipe_m3u_reader->kept && upipe_m3u_reader->kept == cur->count) {
+        /* nothing has changed, output the last segment again so that the
+         * end of the playlist is signaled */
+        struct upipe_m3u_reader_segment *segment =
+            &cur->segments[cur->count - 1];
+        if (segment->key == upipe_m3u_reader->key_version &&
+            segment->map == upipe_m3u_reader->map_version) {
+            upipe_m3u_reader->kept--;
+            upipe_m3u_reader->program_date_time = segment->pdt_in;
+            ret = upipe_m3u_reader_parse_lines(upipe, flow_def,
+                                               segment->offset,
+                                               segment->size);
+        }
+    }
+
+    /* trailing tags */
+    if (ubase_check(ret))
+        ret = upipe_m3u_reader_parse_lines(
+            upipe, flow_def, upipe_m3u_reader->pending,
+            cur->text_size - upipe_m3u_reader->pending);
+    upipe_m3u_reader->pending = cur->text_size;
+
+    if (ubase_check(uref_flow_match_def(flow_def, PLAYLIST_FLOW_DEF))) {
+        if (upipe_m3u_reader->kept)
+            upipe_dbg_va(upipe, "%"PRIu64" segments kept",
+                         upipe_m3u_reader->kept);
+        if (ubase_check(ret))
+            ret = uref_m3u_playlist_flow_set_kept(flow_def,
+                                                  upipe_m3u_reader->kept);
+    }
+
+    struct upipe_m3u_reader_history tmp = upipe_m3u_reader->prev;
+    upipe_m3u_reader->prev = *cur;
+    *cur = tmp;
+    cur->text_size = 0;
+    cur->count = 0;
+    upipe_m3u_reader->pending = 0;
+    return ret;
+}
+
 /** @internal @This checks and parses a line of a m3u file.
  *
  * @param upipe description structure of the pipe
@@ -1242,29 +1629,8 @@ static int upipe_m3u_reader_process_line(struct upipe *upipe,
                                          struct uref *flow_def,
                                          struct uref *uref)
 {
-    static const struct {
-        const char *pfx;
-        int (*cb)(struct upipe *, struct uref *, const char *);
-    } ext_cb[] = {
-        { "#EXTM3U", upipe_m3u_reader_process_m3u },
-        { "#EXT-X-VERSION:", upipe_m3u_reader_process_version },
-        { "#EXT-X-TARGETDURATION:", upipe_m3u_reader_process_target_duration },
-        { "#EXT-X-PLAYLIST-TYPE:", upipe_m3u_reader_process_playlist_type },
-        { "#EXTINF:", upipe_m3u_reader_process_extinf },
-        { "#EXT-X-BYTERANGE:", upipe_m3u_reader_process_byte_range },
-        { "#EXT-X-MEDIA:", upipe_m3u_reader_process_media },
-        { "#EXT-X-STREAM-INF:", upipe_m3u_reader_ext_x_stream_inf },
-        { "#EXT-X-MEDIA-SEQUENCE:", upipe_m3u_reader_ext_x_media_sequence },
-        { "#EXT-X-ENDLIST", upipe_m3u_reader_ext_x_endlist },
-        { "#EXT-X-KEY:", upipe_m3u_reader_key },
-        { "#EXT-X-MAP:", upipe_m3u_reader_map },
-        { "#EXT-X-PROGRAM-DATE-TIME:", upipe_m3u_reader_program_date_time },
-        { "#EXT-X-DATERANGE:", upipe_m3u_reader_daterange },
-        { "#EXT-X-DISCONTINUITY-SEQUENCE:", upipe_m3u_reader_discontinuity_sequence },
-        { "#EXT-X-DISCONTINUITY", upipe_m3u_reader_discontinuity },
-        { "#EXT-X-GAP", upipe_m3u_reader_gap },
-        { "#EXT-X-DEFINE:", upipe_m3u_reader_define },
-    };
+    struct upipe_m3u_reader *upipe_m3u_reader =
+        upipe_m3u_reader_from_upipe(upipe);
 
     size_t block_size;
     UBASE_RETURN(uref_block_size(uref, &block_size));
@@ -1284,19 +1650,22 @@ static int upipe_m3u_reader_process_line(struct upipe *upipe,
     if (!strlen(line))
         return UBASE_ERR_NONE;
 
-    if (*line == '#') {
-        for (unsigned i = 0; i < UBASE_ARRAY_SIZE(ext_cb); i++) {
-            if (strncmp(line, ext_cb[i].pfx, strlen(ext_cb[i].pfx)))
-                continue;
-
-            return ext_cb[i].cb(upipe, flow_def,
-                                line + strlen(ext_cb[i].pfx));
+    if (upipe_m3u_reader->delay &&
+        !ubase_check(uref_flow_match_def(flow_def, MASTER_FLOW_DEF))) {
+        const struct upipe_m3u_reader_tag *tag = NULL;
+        if (*line == '#')
+            tag = upipe_m3u_reader_find_tag(line);
+        if (tag == NULL || tag->segment) {
+            /* delay the segment lines until its uri */
+            UBASE_RETURN(upipe_m3u_reader_append_line(upipe, line,
+                                                      strlen(line)));
+            if (*line == '#')
+                return UBASE_ERR_NONE;
+            return upipe_m3u_reader_segment_end(upipe, flow_def);
         }
-        upipe_dbg_va(upipe, "ignore `%s'", line);
-        return UBASE_ERR_NONE;
     }
 
-    return upipe_m3u_reader_process_uri(upipe, flow_def, line);
+    return upipe_m3u_reader_parse_line(upipe, flow_def, line);
 }
 
 /** @internal @This parses and outputs a m3u file.
@@ -1316,6 +1685,7 @@ static void upipe_m3u_reader_process(struct upipe *upipe)
             upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
             return;
         }
+        upipe_m3u_reader->delay = upipe_m3u_reader->incremental;
     }
 
     /* parse m3u */
@@ -1356,6 +1726,14 @@ static void upipe_m3u_reader_output_all(struct upipe *upipe,
         return;
     }
 
+    if (upipe_m3u_reader->delay) {
+        int ret = upipe_m3u_reader_playlist_end(upipe, flow_def);
+        if (unlikely(!ubase_check(ret))) {
+            upipe_m3u_reader_reset_history(upipe);
+            upipe_throw_error(upipe, ret);
+        }
+    }
+
     /* force new flow def */
     upipe_m3u_reader_store_flow_def(upipe, NULL);
     /* set output flow def */
@@ -1441,6 +1819,26 @@ static int upipe_m3u_reader_set_flow_def(struct upipe *upipe,
     return UBASE_ERR_NONE;
 }
 
+/** @internal @This enables or disables incremental parsing.
+ *
+ * @param upipe description structure of the pipe
+ * @param enabled true to enable incremental parsing
+ * @return an error code
+ */
+static int _upipe_m3u_reader_set_incremental(struct upipe *upipe,
+                                             bool enabled)
+{
+    struct upipe_m3u_reader *upipe_m3u_reader =
+        upipe_m3u_reader_from_upipe(upipe);
+
+    /* applies from the next playlist */
+    if (upipe_m3u_reader->incremental != enabled) {
+        upipe_m3u_reader->incremental = enabled;
+        upipe_m3u_reader_reset_history(upipe);
+    }
+    return UBASE_ERR_NONE;
+}
+
 /** @internal @This processes control commands on a m3u reader pipe.
  *
  * @param upipe description structure of the pipe
@@ -1452,6 +1850,9 @@ static int upipe_m3u_reader_control(struct upipe *upipe,
                                     int command,
                                     va_list args)
 {
+    if (command == UPIPE_SET_OUTPUT)
+        /* the new output does not know the previous segments */
+        upipe_m3u_reader_reset_history(upipe);
     UBASE_HANDLED_RETURN(upipe_m3u_reader_control_output(upipe, command, args));
     switch (command) {
     case UPIPE_SET_FLOW_DEF: {
@@ -1459,6 +1860,20 @@ static int upipe_m3u_reader_control(struct upipe *upipe,
         return upipe_m3u_reader_set_flow_def(upipe, p);
     }
 
+    case UPIPE_M3U_READER_SET_INCREMENTAL: {
+        UBASE_SIGNATURE_CHECK(args, UPIPE_M3U_READER_SIGNATURE)
+        int enabled = va_arg(args, int);
+        return _upipe_m3u_reader_set_incremental(upipe, enabled);
+    }
+    case UPIPE_M3U_READER_GET_INCREMENTAL: {
+        UBASE_SIGNATURE_CHECK(args, UPIPE_M3U_READER_SIGNATURE)
+        struct upipe_m3u_reader *upipe_m3u_reader =
+            upipe_m3u_reader_from_upipe(upipe);
+        int *enabled_p = va_arg(args, int *);
+        *enabled_p = upipe_m3u_reader->incremental;
+        return UBASE_ERR_NONE;
+    }
+
     default:
         return UBASE_ERR_UNHANDLED;
     }
@@ -16,6 +16,7 @@
 #include "upipe/uref_clock.h"
 #include "upipe/uref.h"
 #include "upipe/uref_flow.h"
+#include "upipe/uref_block.h"
 #include "upipe/upipe.h"
 #include "upipe/upipe_helper_urefcount.h"
 #include "upipe/upipe_helper_upipe.h"
@@ -30,10 +31,25 @@
 #include <stdarg.h>
 #include <string.h>
 #include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <sys/param.h>
+#include <sys/stat.h>
+
+#ifndef O_CLOEXEC
+#   define O_CLOEXEC 0
+#endif
 
 #define EXPECTED_FLOW_DEF "block."
 
+/** size of a TS packet */
+#define TS_SIZE 188
+/** TS sync byte */
+#define TS_SYNC 0x47
+/** octets of a TS packet needed to read the random access indicator */
+#define TS_RAI_SIZE 6
+
 /** upipe_multicat_sink structure */
 struct upipe_multicat_sink {
     /** refcount management structure */
@@ -64,6 +80,27 @@ struct upipe_multicat_sink {
     enum upipe_fsink_mode mode;
     /** sync period */
     uint64_t sync_period;
+    /** size of coalesced blocks */
+    unsigned int coalesce_size;
+    /** true if coalesced blocks are written with O_DIRECT */
+    bool direct;
+    /** size preallocated for each file */
+    uint64_t preallocate;
+
+    /** suffix of index files, or NULL */
+    char *index_suffix;
+    /** minimum interval between index entries */
+    uint64_t index_interval;
+    /** file descriptor of the current index file */
+    int index_fd;
+    /** date of the last index entry */
+    uint64_t index_last;
+    /** offset of the next packet in the current data file */
+    uint64_t data_offset;
+    /** offset of the last random access point in the current data file */
+    uint64_t rap_offset;
+    /** detection of random access points */
+    enum upipe_multicat_sink_rap rap;
 
     /** public upipe structure */
     struct upipe upipe;
@@ -73,6 +110,130 @@ UPIPE_HELPER_UPIPE(upipe_multicat_sink, upipe, UPIPE_MULTICAT_SINK_SIGNATURE);
 UPIPE_HELPER_UREFCOUNT(upipe_multicat_sink, urefcount, upipe_multicat_sink_free)
 UPIPE_HELPER_VOID(upipe_multicat_sink)
 
+/** @internal @This opens the index sidecar of a new data file.
+ *
+ * @param upipe description structure of the pipe
+ * @param idx new file index
+ */
+static void upipe_multicat_sink_open_index(struct upipe *upipe, int64_t idx)
+{
+    struct upipe_multicat_sink *upipe_multicat_sink =
+        upipe_multicat_sink_from_upipe(upipe);
+    ubase_clean_fd(&upipe_multicat_sink->index_fd);
+    upipe_multicat_sink->index_last = UINT64_MAX;
+    upipe_multicat_sink->rap_offset = UINT64_MAX;
+
+    /* start from the current size of the data file in append mode */
+    upipe_multicat_sink->data_offset = 0;
+    int fd;
+    struct stat st;
+    if (ubase_check(upipe_fsink_get_fd(upipe_multicat_sink->fsink, &fd)) &&
+        fd != -1 && fstat(fd, &st) != -1)
+        upipe_multicat_sink->data_offset = st.st_size;
+
+    if (upipe_multicat_sink->index_suffix == NULL)
+        return;
+
+    char filepath[MAXPATHLEN];
+    snprintf(filepath, MAXPATHLEN, "%s%"PRId64"%s",
+             upipe_multicat_sink->dirpath, idx,
+             upipe_multicat_sink->index_suffix);
+    int flags = O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC;
+    if (upipe_multicat_sink->mode == UPIPE_FSINK_OVERWRITE)
+        flags |= O_TRUNC;
+    upipe_multicat_sink->index_fd = open(filepath, flags,
+            S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (unlikely(upipe_multicat_sink->index_fd == -1))
+        upipe_warn_va(upipe, "can't open index %s (%m)", filepath);
+}
+
+/** @internal @This looks for a random access point in a packet.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref packet about to be written
+ * @param size size of the packet
+ * @param rap_p filled in with the offset of the random access point in the
+ * packet
+ * @return true if the packet contains a random access point
+ */
+static bool upipe_multicat_sink_find_rap(struct upipe *upipe,
+                                         struct uref *uref, size_t size,
+                                         uint64_t *rap_p)
+{
+    struct upipe_multicat_sink *upipe_multicat_sink =
+        upipe_multicat_sink_from_upipe(upipe);
+    if (upipe_multicat_sink->rap == UPIPE_MULTICAT_SINK_RAP_FLOW) {
+        *rap_p = 0;
+        return ubase_check(uref_flow_get_random(uref));
+    }
+
+    for (size_t offset = 0; offset + TS_RAI_SIZE <= size;
+         offset += TS_SIZE) {
+        uint8_t buffer[TS_RAI_SIZE];
+        const uint8_t *ts = uref_block_peek(uref, offset, TS_RAI_SIZE,
+                                            buffer);
+        if (unlikely(ts == NULL))
+            return false;
+        /* sync byte, adaptation field with at least the flags, and random
+         * access indicator */
+        bool rap = ts[0] == TS_SYNC && (ts[3] & 0x20) && ts[4] &&
+                   (ts[5] & 0x40);
+        uref_block_peek_unmap(uref, offset, buffer, ts);
+        if (rap) {
+            *rap_p = offset;
+            return true;
+        }
+    }
+    return false;
+}
+
+/** @internal @This writes an index entry for a packet, if needed.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref packet about to be written
+ * @param systime date of the packet
+ */
+static void upipe_multicat_sink_index(struct upipe *upipe, struct uref *uref,
+                                      uint64_t systime)
+{
+    struct upipe_multicat_sink *upipe_multicat_sink =
+        upipe_multicat_sink_from_upipe(upipe);
+    uint64_t offset = upipe_multicat_sink->data_offset;
+    size_t size = 0;
+    uref_block_size(uref, &size);
+    upipe_multicat_sink->data_offset += size;
+
+    if (upipe_multicat_sink->index_fd == -1)
+        return;
+    uint64_t rap_offset;
+    bool rap = upipe_multicat_sink_find_rap(upipe, uref, size, &rap_offset);
+    if (rap) {
+        offset += rap_offset;
+        upipe_multicat_sink->rap_offset = offset;
+    } else if (upipe_multicat_sink->index_last != UINT64_MAX &&
+               systime < upipe_multicat_sink->index_last +
+                         upipe_multicat_sink->index_interval)
+        return;
+    upipe_multicat_sink->index_last = systime;
+
+    if (rap)
+        offset |= UPIPE_MULTICAT_INDEX_RAP;
+    uint8_t entry[UPIPE_MULTICAT_INDEX_ENTRY_SIZE];
+    for (int i = 0; i < 8; i++) {
+        entry[i] = systime >> (56 - 8 * i);
+        entry[8 + i] = offset >> (56 - 8 * i);
+        entry[16 + i] = upipe_multicat_sink->rap_offset >> (56 - 8 * i);
+    }
+    ssize_t ret;
+    do
+        ret = write(upipe_multicat_sink->index_fd, entry, sizeof(entry));
+    while (unlikely(ret == -1 && errno == EINTR));
+    if (unlikely(ret != sizeof(entry))) {
+        upipe_warn(upipe, "can't write index entry, closing index");
+        ubase_clean_fd(&upipe_multicat_sink->index_fd);
+    }
+}
+
 /** @internal @This generates a path from idx and send set_path to the internal
  * (fsink) output
  *
@@ -95,6 +256,7 @@ static bool _upipe_multicat_sink_change_file(struct upipe *upipe, int64_t idx)
     if (upipe_multicat_sink->sync_period)
         upipe_fsink_set_sync_period(upipe_multicat_sink->fsink,
                                     upipe_multicat_sink->sync_period);
+    upipe_multicat_sink_open_index(upipe, idx);
     return true;
 }
 
@@ -127,6 +289,7 @@ static void upipe_multicat_sink_input(struct upipe *upipe, struct uref *uref,
         upipe_multicat_sink->fileidx = newidx;
     }
 
+    upipe_multicat_sink_index(upipe, uref, systime);
     upipe_input(upipe_multicat_sink->fsink, uref, upump_p);
 }
 
@@ -157,6 +320,11 @@ static int _upipe_multicat_sink_output_alloc(struct upipe *upipe)
         upipe_warn(upipe, "set_flow_def failed");
         return err;
     }
+    if (upipe_multicat_sink->coalesce_size)
+        upipe_fsink_set_coalesce(fsink, upipe_multicat_sink->coalesce_size,
+                                 upipe_multicat_sink->direct);
+    if (upipe_multicat_sink->preallocate)
+        upipe_fsink_set_preallocate(fsink, upipe_multicat_sink->preallocate);
     upipe_multicat_sink->fsink = fsink;
     return UBASE_ERR_NONE;
 }
@@ -210,6 +378,7 @@ static int _upipe_multicat_sink_set_path(struct upipe *upipe, const char *path,
         upipe_multicat_sink->dirpath = NULL;
         upipe_multicat_sink->suffix = NULL;
         upipe_fsink_set_path(upipe_multicat_sink->fsink, NULL, UPIPE_FSINK_APPEND);
+        ubase_clean_fd(&upipe_multicat_sink->index_fd);
         return UBASE_ERR_NONE;
     }
 
@@ -219,6 +388,30 @@ static int _upipe_multicat_sink_set_path(struct upipe *upipe, const char *path,
     return UBASE_ERR_NONE;
 }
 
+/** @internal @This sets the index sidecar configuration.
+ *
+ * @param upipe description structure of the pipe
+ * @param suffix suffix of index files, or NULL
+ * @param interval minimum interval between entries
+ * @return an error code
+ */
+static int _upipe_multicat_sink_set_index(struct upipe *upipe,
+                                          const char *suffix,
+                                          uint64_t interval)
+{
+    struct upipe_multicat_sink *upipe_multicat_sink =
+        upipe_multicat_sink_from_upipe(upipe);
+    free(upipe_multicat_sink->index_suffix);
+    upipe_multicat_sink->index_suffix = NULL;
+    upipe_multicat_sink->index_interval = interval;
+    if (suffix == NULL)
+        return UBASE_ERR_NONE;
+    upipe_multicat_sink->index_suffix = strndup(suffix, MAXPATHLEN);
+    UBASE_ALLOC_RETURN(upipe_multicat_sink->index_suffix)
+    upipe_notice_va(upipe, "setting index suffix %s", suffix);
+    return UBASE_ERR_NONE;
+}
+
 /** @internal @This changes the rotate interval
  *
  * @param upipe description structure of the pipe
@@ -355,6 +548,42 @@ static int upipe_multicat_sink_control(struct upipe *upipe,
             const char *ext = va_arg(args, const char *);
             return _upipe_multicat_sink_set_path(upipe, path, ext);
         }
+        case UPIPE_MULTICAT_SINK_SET_INDEX: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_MULTICAT_SINK_SIGNATURE)
+            const char *suffix = va_arg(args, const char *);
+            uint64_t interval = va_arg(args, uint64_t);
+            return _upipe_multicat_sink_set_index(upipe, suffix, interval);
+        }
+        case UPIPE_MULTICAT_SINK_GET_INDEX: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_MULTICAT_SINK_SIGNATURE)
+            const char **suffix_p = va_arg(args, const char **);
+            uint64_t *interval_p = va_arg(args, uint64_t *);
+            *suffix_p = upipe_multicat_sink->index_suffix;
+            *interval_p = upipe_multicat_sink->index_interval;
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_MULTICAT_SINK_SET_RAP: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_MULTICAT_SINK_SIGNATURE)
+            enum upipe_multicat_sink_rap rap =
+                va_arg(args, enum upipe_multicat_sink_rap);
+            switch (rap) {
+                case UPIPE_MULTICAT_SINK_RAP_FLOW:
+                case UPIPE_MULTICAT_SINK_RAP_TS:
+                    break;
+                default:
+                    upipe_err_va(upipe, "invalid RAP detection %d", rap);
+                    return UBASE_ERR_INVALID;
+            }
+            upipe_multicat_sink->rap = rap;
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_MULTICAT_SINK_GET_RAP: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_MULTICAT_SINK_SIGNATURE)
+            enum upipe_multicat_sink_rap *rap_p =
+                va_arg(args, enum upipe_multicat_sink_rap *);
+            *rap_p = upipe_multicat_sink->rap;
+            return UBASE_ERR_NONE;
+        }
         case UPIPE_MULTICAT_SINK_GET_PATH: {
             UBASE_SIGNATURE_CHECK(args, UPIPE_MULTICAT_SINK_SIGNATURE)
             return _upipe_multicat_sink_get_path(upipe, va_arg(args, char **), va_arg(args, char **));
@@ -374,6 +603,26 @@ static int upipe_multicat_sink_control(struct upipe *upipe,
             *p = upipe_multicat_sink->sync_period;
             return UBASE_ERR_NONE;
         }
+        case UPIPE_FSINK_SET_COALESCE: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_FSINK_SIGNATURE)
+            unsigned int size = va_arg(args, unsigned int);
+            bool direct = va_arg(args, int);
+            upipe_multicat_sink->coalesce_size = size;
+            upipe_multicat_sink->direct = direct;
+            if (upipe_multicat_sink->fsink != NULL)
+                return upipe_fsink_set_coalesce(upipe_multicat_sink->fsink,
+                                                size, direct);
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_FSINK_SET_PREALLOCATE: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_FSINK_SIGNATURE)
+            uint64_t size = va_arg(args, uint64_t);
+            upipe_multicat_sink->preallocate = size;
+            if (upipe_multicat_sink->fsink != NULL)
+                return upipe_fsink_set_preallocate(upipe_multicat_sink->fsink,
+                                                   size);
+            return UBASE_ERR_NONE;
+        }
         default:
             if (upipe_multicat_sink->fsink != NULL)
                 return upipe_control_va(upipe_multicat_sink->fsink,
@@ -413,6 +662,16 @@ static struct upipe *upipe_multicat_sink_alloc(struct upipe_mgr *mgr,
     upipe_multicat_sink->rotate_offset = UPIPE_MULTICAT_SINK_DEF_ROTATE_OFFSET;
     upipe_multicat_sink->mode = UPIPE_FSINK_APPEND;
     upipe_multicat_sink->sync_period = 0;
+    upipe_multicat_sink->coalesce_size = 0;
+    upipe_multicat_sink->direct = false;
+    upipe_multicat_sink->preallocate = 0;
+    upipe_multicat_sink->index_suffix = NULL;
+    upipe_multicat_sink->index_interval = 0;
+    upipe_multicat_sink->index_fd = -1;
+    upipe_multicat_sink->index_last = UINT64_MAX;
+    upipe_multicat_sink->data_offset = 0;
+    upipe_multicat_sink->rap_offset = UINT64_MAX;
+    upipe_multicat_sink->rap = UPIPE_MULTICAT_SINK_RAP_FLOW;
     upipe_multicat_sink->flow_def = NULL;
     upipe_throw_ready(upipe);
     return upipe;
@@ -436,6 +695,8 @@ static void upipe_multicat_sink_free(struct upipe *upipe)
     upipe_mgr_release(upipe_multicat_sink->fsink_mgr);
     free(upipe_multicat_sink->dirpath);
     free(upipe_multicat_sink->suffix);
+    free(upipe_multicat_sink->index_suffix);
+    ubase_clean_fd(&upipe_multicat_sink->index_fd);
     upipe_multicat_sink_clean_urefcount(upipe);
     upipe_multicat_sink_free_void(upipe);
 }
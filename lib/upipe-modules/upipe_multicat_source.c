@@ -29,6 +29,7 @@
 #include "upipe/upipe_helper_upump.h"
 #include "upipe/upipe_helper_output_size.h"
 #include "upipe-modules/upipe_multicat_source.h"
+#include "upipe-modules/upipe_multicat_sink.h"
 
 #include <stdlib.h>
 #include <stdint.h>
@@ -50,6 +51,8 @@
 #define UBUF_DEFAULT_SIZE       1316
 /** mux number of missing segments */
 #define MISSING_SEGMENTS        5
+/** maximum number of packets read at once */
+#define MAX_BATCH               1024
 
 /** @internal @This is the private context of a multicat source pipe. */
 struct upipe_msrc {
@@ -97,6 +100,8 @@ struct upipe_msrc {
     uint64_t pos;
     /** number of missing segments */
     unsigned long missing;
+    /** number of packets read at once */
+    unsigned int batch;
 
     /** public upipe structure */
     struct upipe upipe;
@@ -171,6 +176,7 @@ static struct upipe *upipe_msrc_alloc(struct upipe_mgr *mgr,
     upipe_msrc->fileidx = -1;
     upipe_msrc->pos = UINT64_MAX;
     upipe_msrc->missing = 0;
+    upipe_msrc->batch = 1;
     upipe_throw_ready(upipe);
     return upipe;
 }
@@ -222,6 +228,10 @@ static int upipe_msrc_setup(struct upipe *upipe)
         /* try next file anyway */
         return upipe_msrc_skip(upipe);
     }
+#ifdef POSIX_FADV_SEQUENTIAL
+    if (upipe_msrc->batch > 1)
+        posix_fadvise(upipe_msrc->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
 
     char aux_file[strlen(path) + strlen(aux) +
                   sizeof("18446744073709551615")];
@@ -237,6 +247,87 @@ static int upipe_msrc_setup(struct upipe *upipe)
     return UBASE_ERR_NONE;
 }
 
+/** @internal @This looks up the index sidecar of the current segment for
+ * the packet to start from, preferring the last random access point before
+ * the position.
+ *
+ * @param upipe description structure of the pipe
+ * @param packet_p filled in with the number of the packet in the segment
+ * @return an error code, if there is no usable index
+ */
+static int upipe_msrc_search_index(struct upipe *upipe, uint64_t *packet_p)
+{
+    struct upipe_msrc *upipe_msrc = upipe_msrc_from_upipe(upipe);
+    const char *path, *index;
+    UBASE_RETURN(uref_msrc_flow_get_path(upipe_msrc->flow_def_input, &path))
+    UBASE_RETURN(uref_msrc_flow_get_index(upipe_msrc->flow_def_input, &index))
+
+    char index_file[strlen(path) + strlen(index) +
+                    sizeof("18446744073709551615")];
+    sprintf(index_file, "%s%"PRIu64"%s", path, upipe_msrc->fileidx, index);
+
+    int fd = open(index_file, O_RDONLY | O_CLOEXEC);
+    if (unlikely(fd == -1)) {
+        upipe_dbg_va(upipe, "segment %"PRIu64" has no index",
+                     upipe_msrc->fileidx);
+        return UBASE_ERR_EXTERNAL;
+    }
+    struct stat index_stat;
+    if (unlikely(fstat(fd, &index_stat) == -1 ||
+                 index_stat.st_size < UPIPE_MULTICAT_INDEX_ENTRY_SIZE)) {
+        close(fd);
+        return UBASE_ERR_INVALID;
+    }
+    uint8_t *index_buf = mmap(NULL, index_stat.st_size, PROT_READ,
+                              MAP_SHARED, fd, 0);
+    close(fd);
+    if (unlikely(index_buf == MAP_FAILED))
+        return UBASE_ERR_EXTERNAL;
+
+    /* last entry dated before the position */
+    uint64_t nb_entries = index_stat.st_size / UPIPE_MULTICAT_INDEX_ENTRY_SIZE;
+    uint64_t first = 0, last = nb_entries;
+    while (last - first > 1) {
+        uint64_t mid = (first + last) / 2;
+        if (upipe_msrc_ntoh64(index_buf +
+                    mid * UPIPE_MULTICAT_INDEX_ENTRY_SIZE) <= upipe_msrc->pos)
+            first = mid;
+        else
+            last = mid;
+    }
+
+    /* each entry points to the last random access point before it */
+    const uint8_t *entry = index_buf + first * UPIPE_MULTICAT_INDEX_ENTRY_SIZE;
+    uint64_t offset = upipe_msrc_ntoh64(entry + 16);
+    if (offset == UINT64_MAX)
+        /* no random access point, use the closest entry */
+        offset = upipe_msrc_ntoh64(entry + 8);
+    munmap(index_buf, index_stat.st_size);
+
+    *packet_p = (offset & ~UPIPE_MULTICAT_INDEX_RAP) / upipe_msrc->output_size;
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This opens the current segment at the given packet.
+ *
+ * @param upipe description structure of the pipe
+ * @param packet number of the packet in the segment
+ * @return an error code
+ */
+static int upipe_msrc_seek(struct upipe *upipe, uint64_t packet)
+{
+    struct upipe_msrc *upipe_msrc = upipe_msrc_from_upipe(upipe);
+    UBASE_RETURN(upipe_msrc_setup(upipe))
+    if (unlikely(lseek(upipe_msrc->fd, (off_t)upipe_msrc->output_size * packet,
+                       SEEK_SET) == -1 ||
+                 fseeko(upipe_msrc->aux_file, 8 * packet, SEEK_SET) == -1)) {
+        upipe_warn_va(upipe, "invalid segment %"PRIu64, upipe_msrc->fileidx);
+        /* try next file anyway */
+        return upipe_msrc_skip(upipe);
+    }
+    return UBASE_ERR_NONE;
+}
+
 /** @internal @This starts the reader.
  *
  * @param upipe description structure of the pipe
@@ -255,6 +346,10 @@ static int upipe_msrc_start(struct upipe *upipe)
     uref_msrc_flow_get_offset(upipe_msrc->flow_def_input, &offset);
     upipe_msrc->fileidx = (upipe_msrc->pos - offset) / rotate;
 
+    uint64_t packet;
+    if (ubase_check(upipe_msrc_search_index(upipe, &packet)))
+        return upipe_msrc_seek(upipe, packet);
+
     char aux_file[strlen(path) + strlen(aux) +
                   sizeof(".18446744073709551615")];
     sprintf(aux_file, "%s%"PRIu64"%s", path, upipe_msrc->fileidx, aux);
@@ -303,15 +398,89 @@ static int upipe_msrc_start(struct upipe *upipe)
     munmap(aux_buf, aux_stat.st_size);
     close(fd);
 
-    UBASE_RETURN(upipe_msrc_setup(upipe))
-    if (unlikely(lseek(upipe_msrc->fd, (off_t)upipe_msrc->output_size * offset1,
-                       SEEK_SET) == -1 ||
-                 fseeko(upipe_msrc->aux_file, 8 * offset1, SEEK_SET) == -1)) {
-        upipe_warn_va(upipe, "invalid segment %"PRIu64, upipe_msrc->fileidx);
-        /* try next file anyway */
+    return upipe_msrc_seek(upipe, offset1);
+}
+
+/** @internal @This reads a batch of packets from the source, and outputs
+ * them as slices of a single chunk.
+ *
+ * @param upipe description structure of the pipe
+ * @return an error code
+ */
+static int upipe_msrc_handle_batch(struct upipe *upipe)
+{
+    struct upipe_msrc *upipe_msrc = upipe_msrc_from_upipe(upipe);
+    unsigned int output_size = upipe_msrc->output_size;
+    uint8_t aux[upipe_msrc->batch][8];
+    size_t nb_aux = fread(aux, 8, upipe_msrc->batch, upipe_msrc->aux_file);
+    if (!nb_aux)
+        return upipe_msrc_skip(upipe);
+
+    struct uref *chunk = uref_block_alloc(upipe_msrc->uref_mgr,
+                                          upipe_msrc->ubuf_mgr,
+                                          nb_aux * output_size);
+    if (unlikely(chunk == NULL))
+        return UBASE_ERR_ALLOC;
+
+    uint8_t *buffer;
+    int chunk_size = -1;
+    if (unlikely(!ubase_check(uref_block_write(chunk, 0, &chunk_size,
+                                               &buffer)))) {
+        uref_free(chunk);
+        return UBASE_ERR_ALLOC;
+    }
+
+    ssize_t ret;
+    do
+        ret = read(upipe_msrc->fd, buffer, chunk_size);
+    while (unlikely(ret == -1 && errno == EINTR));
+    uref_block_unmap(chunk, 0);
+
+    if (unlikely(ret <= 0)) {
+        uref_free(chunk);
+        if (ret == -1) {
+            switch (errno) {
+                case EAGAIN:
+#if EAGAIN != EWOULDBLOCK
+                case EWOULDBLOCK:
+#endif
+                    /* not an issue, try again later */
+                    fseeko(upipe_msrc->aux_file, -8 * (off_t)nb_aux,
+                           SEEK_CUR);
+                    return UBASE_ERR_NONE;
+                default:
+                    break;
+            }
+        }
+        upipe_warn_va(upipe, "premature end of segment %"PRIu64,
+                      upipe_msrc->fileidx);
         return upipe_msrc_skip(upipe);
     }
 
+    size_t nb_packets = (ret + output_size - 1) / output_size;
+    if (nb_packets < nb_aux)
+        /* keep aux records in sync with the data actually read */
+        fseeko(upipe_msrc->aux_file, -8 * (off_t)(nb_aux - nb_packets),
+               SEEK_CUR);
+    upipe_msrc->missing = 0;
+
+    struct upump *upump = upipe_msrc->upump;
+    for (size_t i = 0; i < nb_packets; i++) {
+        size_t size = output_size;
+        if (ret - i * output_size < size)
+            size = ret - i * output_size;
+        struct uref *uref = uref_block_splice(chunk, i * output_size, size);
+        if (unlikely(uref == NULL)) {
+            uref_free(chunk);
+            return UBASE_ERR_ALLOC;
+        }
+        uref_clock_set_cr_sys(uref, upipe_msrc_ntoh64(aux[i]));
+        upipe_msrc_output(upipe, uref, &upipe_msrc->upump);
+        if (unlikely(upipe_msrc->upump != upump))
+            /* the pipe was closed or reopened by the output */
+            break;
+    }
+    uref_free(chunk);
     return UBASE_ERR_NONE;
 }
 
@@ -323,6 +492,9 @@ static int upipe_msrc_start(struct upipe *upipe)
 static int upipe_msrc_handle(struct upipe *upipe)
 {
     struct upipe_msrc *upipe_msrc = upipe_msrc_from_upipe(upipe);
+    if (upipe_msrc->batch > 1)
+        return upipe_msrc_handle_batch(upipe);
+
     uint8_t aux[8];
     if (fread(aux, 8, 1, upipe_msrc->aux_file) != 1)
         return upipe_msrc_skip(upipe);
@@ -610,6 +782,20 @@ static int _upipe_msrc_control(struct upipe *upipe, int command, va_list args)
             uint64_t *p = va_arg(args, uint64_t *);
             return upipe_msrc_get_position(upipe, p);
         }
+        case UPIPE_MSRC_GET_BATCH: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_MSRC_SIGNATURE)
+            unsigned int *p = va_arg(args, unsigned int *);
+            *p = upipe_msrc_from_upipe(upipe)->batch;
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_MSRC_SET_BATCH: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_MSRC_SIGNATURE)
+            unsigned int batch = va_arg(args, unsigned int);
+            if (!batch || batch > MAX_BATCH)
+                return UBASE_ERR_INVALID;
+            upipe_msrc_from_upipe(upipe)->batch = batch;
+            return UBASE_ERR_NONE;
+        }
 
         default:
             return UBASE_ERR_UNHANDLED;
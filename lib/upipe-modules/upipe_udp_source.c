@@ -15,6 +15,7 @@
 #include "upipe/uclock.h"
 #include "upipe/uref.h"
 #include "upipe/uref_block.h"
+#include "upipe/ubuf_block.h"
 #include "upipe/uref_block_flow.h"
 #include "upipe/uref_clock.h"
 #include "upipe/upump.h"
@@ -40,10 +41,17 @@
 #include <unistd.h>
 #include <errno.h>
 #include <assert.h>
+#include <limits.h>
 #include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
 
 /** default size of buffers when unspecified */
 #define UBUF_DEFAULT_SIZE       4096
+/** maximum size of coalesced datagrams */
+#define UBUF_GRO_SIZE           65535
+/** default size of slabs receiving coalesced datagrams */
+#define UBUF_GRO_SLAB_SIZE      (4 * UBUF_GRO_SIZE)
 
 #define UDP_DEFAULT_TTL 0
 #define UDP_DEFAULT_PORT 1234
@@ -89,6 +97,22 @@ struct upipe_udpsrc {
     /** read size */
     unsigned int output_size;
 
+    /** size of slabs, or 0 to allocate a buffer per datagram (unless
+     * coalesced datagrams are received) */
+    unsigned int slab_size;
+    /** current slab */
+    struct ubuf *slab;
+    /** pointer to the memory of the current slab */
+    uint8_t *slab_buffer;
+    /** size of the current slab */
+    int slab_buffer_size;
+    /** offset of the unused part of the current slab */
+    int slab_offset;
+    /** true if buffers are allocated with the exact datagram size */
+    bool exact_size;
+    /** true if coalesced datagrams are received (UDP_GRO) */
+    bool gro;
+
     /** udp socket descriptor */
     int fd;
     /** udp socket uri */
@@ -149,10 +173,178 @@ static struct upipe *upipe_udpsrc_alloc(struct upipe_mgr *mgr,
     upipe_udpsrc->fd = -1;
     upipe_udpsrc->uri = NULL;
     upipe_udpsrc->addrlen = 0;
+    upipe_udpsrc->slab_size = 0;
+    upipe_udpsrc->slab = NULL;
+    upipe_udpsrc->slab_buffer = NULL;
+    upipe_udpsrc->slab_buffer_size = 0;
+    upipe_udpsrc->slab_offset = 0;
+    upipe_udpsrc->exact_size = false;
+    upipe_udpsrc->gro = false;
     upipe_throw_ready(upipe);
     return upipe;
 }
 
+/** @internal @This returns the size of the next pending datagram.
+ *
+ * @param upipe description structure of the pipe
+ * @return size of the datagram, or -1 if unknown
+ */
+static ssize_t upipe_udpsrc_peek(struct upipe *upipe)
+{
+    struct upipe_udpsrc *upipe_udpsrc = upipe_udpsrc_from_upipe(upipe);
+    return recv(upipe_udpsrc->fd, NULL, 0, MSG_PEEK | MSG_TRUNC);
+}
+
+/** @internal @This retires the current slab, which has been kept mapped
+ * for writing since its allocation. Its memory is freed once all datagrams
+ * received into it are released.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_udpsrc_clean_slab(struct upipe *upipe)
+{
+    struct upipe_udpsrc *upipe_udpsrc = upipe_udpsrc_from_upipe(upipe);
+    if (upipe_udpsrc->slab != NULL) {
+        ubuf_block_unmap(upipe_udpsrc->slab, 0);
+        ubuf_free(upipe_udpsrc->slab);
+    }
+    upipe_udpsrc->slab = NULL;
+    upipe_udpsrc->slab_buffer = NULL;
+    upipe_udpsrc->slab_buffer_size = 0;
+    upipe_udpsrc->slab_offset = 0;
+}
+
+/** @internal @This returns buffer space in the current slab, allocating a
+ * new slab if the next datagram does not fit. The space is always taken
+ * after the last datagram spliced out of the slab, so that memory already
+ * output is never written again.
+ *
+ * @param upipe description structure of the pipe
+ * @param size_p filled in with the available size
+ * @return pointer to the buffer space, or NULL in case of allocation error
+ */
+static uint8_t *upipe_udpsrc_slab_get(struct upipe *upipe, int *size_p)
+{
+    struct upipe_udpsrc *upipe_udpsrc = upipe_udpsrc_from_upipe(upipe);
+    int read_size = upipe_udpsrc->output_size;
+    int slab_size = upipe_udpsrc->slab_size;
+    if (upipe_udpsrc->gro) {
+        /* leave room for a full coalesced buffer */
+        if (read_size < UBUF_GRO_SIZE)
+            read_size = UBUF_GRO_SIZE;
+        if (!slab_size)
+            slab_size = UBUF_GRO_SLAB_SIZE;
+    }
+    if (slab_size < read_size)
+        slab_size = read_size;
+
+    if (upipe_udpsrc->slab != NULL) {
+        int remaining = upipe_udpsrc->slab_buffer_size -
+                        upipe_udpsrc->slab_offset;
+        if (remaining >= read_size) {
+            *size_p = read_size;
+            return upipe_udpsrc->slab_buffer + upipe_udpsrc->slab_offset;
+        }
+        ssize_t next = remaining > 0 ? upipe_udpsrc_peek(upipe) : -1;
+        if (next > 0 && next <= remaining) {
+            *size_p = remaining;
+            return upipe_udpsrc->slab_buffer + upipe_udpsrc->slab_offset;
+        }
+        upipe_udpsrc_clean_slab(upipe);
+    }
+
+    struct ubuf *slab = ubuf_block_alloc(upipe_udpsrc->ubuf_mgr, slab_size);
+    if (unlikely(slab == NULL))
+        return NULL;
+
+    /* the slab is mapped for writing while it is still the only owner of
+     * its memory, and remains mapped until it is retired */
+    uint8_t *buffer;
+    int size = -1;
+    if (unlikely(!ubase_check(ubuf_block_write(slab, 0, &size, &buffer)))) {
+        ubuf_free(slab);
+        return NULL;
+    }
+    if (unlikely(size != slab_size)) {
+        /* segmented block */
+        ubuf_block_unmap(slab, 0);
+        ubuf_free(slab);
+        return NULL;
+    }
+
+    upipe_udpsrc->slab = slab;
+    upipe_udpsrc->slab_buffer = buffer;
+    upipe_udpsrc->slab_buffer_size = slab_size;
+    upipe_udpsrc->slab_offset = 0;
+    *size_p = read_size;
+    return buffer;
+}
+
+/** @internal @This enables the reception of coalesced datagrams on the
+ * socket, if requested.
+ *
+ * @param upipe description structure of the pipe
+ * @return an error code
+ */
+static int upipe_udpsrc_setup_gro(struct upipe *upipe)
+{
+    struct upipe_udpsrc *upipe_udpsrc = upipe_udpsrc_from_upipe(upipe);
+    if (!upipe_udpsrc->gro || upipe_udpsrc->fd == -1)
+        return UBASE_ERR_NONE;
+
+#ifdef UDP_GRO
+    int one = 1;
+    if (likely(setsockopt(upipe_udpsrc->fd, SOL_UDP, UDP_GRO,
+                          &one, sizeof(one)) == 0))
+        return UBASE_ERR_NONE;
+    upipe_warn_va(upipe, "can't enable UDP_GRO (%m)");
+#else
+    upipe_warn(upipe, "UDP_GRO is not supported");
+#endif
+    upipe_udpsrc->gro = false;
+    return UBASE_ERR_EXTERNAL;
+}
+
+/** @internal @This outputs a received buffer, split into datagrams of the
+ * given segment size sharing the same memory.
+ *
+ * @param upipe description structure of the pipe
+ * @param ubuf received buffer
+ * @param size size of the received buffer
+ * @param segment_size size of each datagram, except the last one
+ * @param systime reception date
+ */
+static void upipe_udpsrc_output_segments(struct upipe *upipe,
+                                         struct ubuf *ubuf, int size,
+                                         int segment_size, uint64_t systime)
+{
+    struct upipe_udpsrc *upipe_udpsrc = upipe_udpsrc_from_upipe(upipe);
+
+    for (int offset = 0; offset < size; offset += segment_size) {
+        struct ubuf *segment = ubuf;
+        if (size > segment_size) {
+            int len = size - offset < segment_size ? size - offset :
+                      segment_size;
+            segment = ubuf_block_splice(ubuf, offset, len);
+        }
+        struct uref *uref = segment != NULL ?
+            uref_alloc(upipe_udpsrc->uref_mgr) : NULL;
+        if (unlikely(uref == NULL)) {
+            if (segment != NULL)
+                ubuf_free(segment);
+            upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+            break;
+        }
+        uref_attach_ubuf(uref, segment);
+        if (unlikely(upipe_udpsrc->uclock != NULL))
+            uref_clock_set_cr_sys(uref, systime);
+        upipe_udpsrc_output(upipe, uref, &upipe_udpsrc->upump);
+    }
+
+    if (size > segment_size)
+        ubuf_free(ubuf);
+}
+
 /** @internal @This reads data from the source and outputs it.
  * It is called either when the idler triggers (permanent storage mode) or
  * when data is available on the udp socket descriptor (live stream mode).
@@ -167,33 +359,60 @@ static void upipe_udpsrc_worker(struct upump *upump)
     if (unlikely(upipe_udpsrc->uclock != NULL))
         systime = uclock_now(upipe_udpsrc->uclock);
 
-    struct uref *uref = uref_block_alloc(upipe_udpsrc->uref_mgr,
-                                         upipe_udpsrc->ubuf_mgr,
-                                         upipe_udpsrc->output_size);
-    if (unlikely(uref == NULL)) {
-        upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
-        return;
-    }
-
+    struct ubuf *ubuf = NULL;
     uint8_t *buffer;
-    int output_size = -1;
-    if (unlikely(!ubase_check(uref_block_write(uref, 0, &output_size,
-                                               &buffer)))) {
-        uref_free(uref);
-        upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
-        return;
+    int output_size = upipe_udpsrc->output_size;
+    bool slab = upipe_udpsrc->gro || upipe_udpsrc->slab_size;
+    if (slab) {
+        /* coalesced datagrams are always received into slabs, so that they
+         * are packed instead of each pinning a full coalescing buffer */
+        buffer = upipe_udpsrc_slab_get(upipe, &output_size);
+        if (unlikely(buffer == NULL)) {
+            upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+            return;
+        }
+    } else {
+        if (upipe_udpsrc->exact_size) {
+            ssize_t next = upipe_udpsrc_peek(upipe);
+            if (next > 0 && next < output_size)
+                output_size = next;
+        }
+        ubuf = ubuf_block_alloc(upipe_udpsrc->ubuf_mgr, output_size);
+        int size = -1;
+        if (unlikely(ubuf == NULL ||
+                     !ubase_check(ubuf_block_write(ubuf, 0, &size,
+                                                   &buffer)))) {
+            if (ubuf != NULL)
+                ubuf_free(ubuf);
+            upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+            return;
+        }
+        assert(size == output_size);
     }
-    assert(output_size == upipe_udpsrc->output_size);
 
     struct sockaddr_storage addr;
-    socklen_t addrlen = sizeof(addr);
-
-    ssize_t ret = recvfrom(upipe_udpsrc->fd, buffer, upipe_udpsrc->output_size,
-                        0, (struct sockaddr*)&addr, &addrlen);
-    uref_block_unmap(uref, 0);
+    struct iovec iov = { .iov_base = buffer, .iov_len = output_size };
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr msg = {
+        .msg_name = &addr,
+        .msg_namelen = sizeof(addr),
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = upipe_udpsrc->gro ? control.buf : NULL,
+        .msg_controllen = upipe_udpsrc->gro ? sizeof(control.buf) : 0,
+    };
+
+    ssize_t ret = recvmsg(upipe_udpsrc->fd, &msg, 0);
+    socklen_t addrlen = msg.msg_namelen;
+    if (ubuf != NULL)
+        ubuf_block_unmap(ubuf, 0);
 
     if (unlikely(ret == -1)) {
-        uref_free(uref);
+        if (ubuf != NULL)
+            ubuf_free(ubuf);
         switch (errno) {
             case EINTR:
             case EAGAIN:
@@ -221,7 +440,8 @@ static void upipe_udpsrc_worker(struct upump *upump)
     }
 
     if (unlikely(ret == 0)) {
-        uref_free(uref);
+        if (ubuf != NULL)
+            ubuf_free(ubuf);
         if (likely(upipe_udpsrc->uclock == NULL)) {
             upipe_notice_va(upipe, "end of udp socket %s", upipe_udpsrc->uri);
             upipe_udpsrc_set_upump(upipe, NULL);
@@ -229,11 +449,34 @@ static void upipe_udpsrc_worker(struct upump *upump)
         }
         return;
     }
-    if (unlikely(upipe_udpsrc->uclock != NULL))
-        uref_clock_set_cr_sys(uref, systime);
-    if (unlikely(ret != upipe_udpsrc->output_size))
-        uref_block_resize(uref, 0, ret);
-    upipe_udpsrc_output(upipe, uref, &upipe_udpsrc->upump);
+
+    int segment_size = ret;
+#ifdef UDP_GRO
+    if (upipe_udpsrc->gro) {
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+             cmsg = CMSG_NXTHDR(&msg, cmsg))
+            if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+                int gso_size;
+                memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(gso_size));
+                if (gso_size > 0)
+                    segment_size = gso_size;
+            }
+    }
+#endif
+
+    if (slab) {
+        assert(buffer == upipe_udpsrc->slab_buffer + upipe_udpsrc->slab_offset);
+        ubuf = ubuf_block_splice(upipe_udpsrc->slab,
+                                 upipe_udpsrc->slab_offset, ret);
+        if (unlikely(ubuf == NULL)) {
+            upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+            return;
+        }
+        upipe_udpsrc->slab_offset += ret;
+    } else if (unlikely(ret != output_size))
+        ubuf_block_resize(ubuf, 0, ret);
+
+    upipe_udpsrc_output_segments(upipe, ubuf, ret, segment_size, systime);
 }
 
 /** @internal @This checks if the pump may be allocated.
@@ -340,6 +583,7 @@ static int upipe_udpsrc_set_uri(struct upipe *upipe, const char *uri)
         return UBASE_ERR_ALLOC;
     }
     upipe_notice_va(upipe, "opening udp socket %s", upipe_udpsrc->uri);
+    upipe_udpsrc_setup_gro(upipe);
     return UBASE_ERR_NONE;
 }
 
@@ -387,12 +631,50 @@ static int _upipe_udpsrc_control(struct upipe *upipe,
             *fd = upipe_udpsrc->fd;
             return UBASE_ERR_NONE;
         }
+        case UPIPE_UDPSRC_GET_SLAB_SIZE: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_UDPSRC_SIGNATURE)
+            unsigned int *slab_size_p = va_arg(args, unsigned int *);
+            *slab_size_p = upipe_udpsrc->slab_size;
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_UDPSRC_SET_SLAB_SIZE: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_UDPSRC_SIGNATURE)
+            unsigned int slab_size = va_arg(args, unsigned int);
+            if (slab_size > INT_MAX)
+                return UBASE_ERR_INVALID;
+            upipe_udpsrc_clean_slab(upipe);
+            upipe_udpsrc->slab_size = slab_size;
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_UDPSRC_GET_EXACT_SIZE: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_UDPSRC_SIGNATURE)
+            bool *exact_p = va_arg(args, bool *);
+            *exact_p = upipe_udpsrc->exact_size;
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_UDPSRC_SET_EXACT_SIZE: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_UDPSRC_SIGNATURE)
+            upipe_udpsrc->exact_size = va_arg(args, int);
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_UDPSRC_GET_GRO: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_UDPSRC_SIGNATURE)
+            bool *gro_p = va_arg(args, bool *);
+            *gro_p = upipe_udpsrc->gro;
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_UDPSRC_SET_GRO: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_UDPSRC_SIGNATURE)
+            upipe_udpsrc->gro = va_arg(args, int);
+            return upipe_udpsrc_setup_gro(upipe);
+        }
         case UPIPE_UDPSRC_SET_FD: {
             UBASE_SIGNATURE_CHECK(args, UPIPE_UDPSRC_SIGNATURE)
             upipe_udpsrc_set_upump(upipe, NULL);
             if (likely(upipe_udpsrc->fd != -1))
                 close(upipe_udpsrc->fd);
             upipe_udpsrc->fd = va_arg(args, int );
+            upipe_udpsrc_setup_gro(upipe);
             return UBASE_ERR_NONE;
         }
         default:
@@ -435,6 +717,7 @@ static void upipe_udpsrc_free(struct upipe *upipe)
     upipe_throw_dead(upipe);
 
     free(upipe_udpsrc->uri);
+    upipe_udpsrc_clean_slab(upipe);
     upipe_udpsrc_clean_output_size(upipe);
     upipe_udpsrc_clean_uclock(upipe);
     upipe_udpsrc_clean_upump(upipe);
@@ -6,6 +6,6 @@ lib-targets = libupipe_netmap
 libupipe_netmap-desc = netmap interface module
 libupipe_netmap-so-version = 1.0.0
 libupipe_netmap-includes = upipe_netmap_source.h
-libupipe_netmap-src = upipe_netmap_source.c
+libupipe_netmap-src = upipe_netmap_source.c upipe_netmap_spares.h
 libupipe_netmap-deps = netmap
 libupipe_netmap-libs = libupipe bitstream
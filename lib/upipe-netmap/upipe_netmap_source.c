@@ -21,6 +21,9 @@
 #include "upipe/uref_clock.h"
 #include "upipe/upump.h"
 #include "upipe/ubuf.h"
+#include "upipe/ubuf_block_mem.h"
+#include "upipe/umem.h"
+#include "upipe/urefcount.h"
 #include "upipe/upipe.h"
 #include "upipe/upipe_helper_upipe.h"
 #include "upipe/upipe_helper_urefcount.h"
@@ -33,6 +36,8 @@
 #include "upipe/upipe_helper_uclock.h"
 #include "upipe-netmap/upipe_netmap_source.h"
 
+#include "upipe_netmap_spares.h"
+
 #include <net/if.h>
 
 #define NETMAP_WITH_LIBS
@@ -45,6 +50,11 @@
 #include <bitstream/ietf/udp.h>
 #include <bitstream/ieee/ethernet.h>
 
+/** default number of spare buffers for zero-copy reception */
+#define ZEROCOPY_BUFFERS 0
+/** depth of the pools of the zero-copy ubuf manager */
+#define UBUF_POOL_DEPTH 1024
+
 /** @hidden */
 static int upipe_netmap_source_check(struct upipe *upipe, struct uref *flow_format);
 
@@ -93,6 +103,13 @@ struct upipe_netmap_source {
     /** netmap ring **/
     unsigned int ring_idx;
 
+    /** number of spare buffers requested for zero-copy */
+    unsigned int zerocopy;
+    /** spare buffers, or NULL if zero-copy is disabled */
+    struct upipe_netmap_spares *spares;
+    /** ubuf manager wrapping spare buffers */
+    struct ubuf_mgr *spares_ubuf_mgr;
+
     /** public upipe structure */
     struct upipe upipe;
 };
@@ -140,10 +157,129 @@ static struct upipe *upipe_netmap_source_alloc(struct upipe_mgr *mgr,
     upipe_netmap_source_init_uclock(upipe);
     upipe_netmap_source->uri = NULL;
     upipe_netmap_source->d = NULL;
+    upipe_netmap_source->zerocopy = ZEROCOPY_BUFFERS;
+    upipe_netmap_source->spares = NULL;
+    upipe_netmap_source->spares_ubuf_mgr = NULL;
     upipe_throw_ready(upipe);
     return upipe;
 }
 
+/** @internal @This gives the spare buffers back to netmap and closes the
+ * netmap descriptor.
+ *
+ * @param spares pointer to spare buffers
+ */
+static void upipe_netmap_source_spares_release(
+        struct upipe_netmap_spares *spares)
+{
+    struct nm_desc *d = spares->opaque;
+
+    /* rebuild the list of extra buffers so that netmap frees them */
+    uint32_t head = 0;
+    uint8_t *buf;
+    while ((buf = upipe_netmap_spares_get(spares)) != NULL) {
+        *(uint32_t *)buf = head;
+        head = upipe_netmap_spares_idx(spares, buf);
+    }
+    d->nifp->ni_bufs_head = head;
+    nm_close(d);
+}
+
+/** @internal @This takes ownership of the extra buffers allocated by netmap
+ * and of the netmap descriptor.
+ *
+ * @param upipe description structure of the pipe
+ * @param d netmap descriptor
+ * @return pointer to spare buffers, or NULL in case of error
+ */
+static struct upipe_netmap_spares *
+    upipe_netmap_source_spares_alloc_set(struct upipe *upipe,
+                                         struct nm_desc *d)
+{
+    struct upipe_netmap_source *upipe_netmap_source =
+        upipe_netmap_source_from_upipe(upipe);
+    struct netmap_ring *rxring =
+        NETMAP_RXRING(d->nifp, upipe_netmap_source->ring_idx);
+    struct upipe_netmap_spares *spares =
+        upipe_netmap_spares_alloc(d->req.nr_arg3,
+                                  (uint8_t *)NETMAP_BUF(rxring, 0),
+                                  rxring->nr_buf_size,
+                                  upipe_netmap_source_spares_release, d);
+    if (unlikely(spares == NULL))
+        return NULL;
+
+    uint32_t idx = d->nifp->ni_bufs_head;
+    while (idx != 0) {
+        uint8_t *buf = (uint8_t *)NETMAP_BUF(rxring, idx);
+        idx = *(uint32_t *)buf;
+        upipe_netmap_spares_put(spares, buf);
+    }
+    d->nifp->ni_bufs_head = 0;
+    return spares;
+}
+
+/** @internal @This allocates a uref for a received payload, either by
+ * swapping the slot with a spare buffer, or by copying it.
+ *
+ * @param upipe description structure of the pipe
+ * @param rxring netmap receive ring
+ * @param slot netmap slot
+ * @param payload pointer to the payload inside the slot buffer
+ * @param payload_len size of the payload
+ * @return pointer to uref, or NULL in case of allocation error
+ */
+static struct uref *upipe_netmap_source_alloc_uref(struct upipe *upipe,
+                                                   struct netmap_ring *rxring,
+                                                   struct netmap_slot *slot,
+                                                   const uint8_t *payload,
+                                                   uint16_t payload_len)
+{
+    struct upipe_netmap_source *upipe_netmap_source =
+        upipe_netmap_source_from_upipe(upipe);
+    struct upipe_netmap_spares *spares = upipe_netmap_source->spares;
+    uint8_t *spare;
+
+    if (spares != NULL && upipe_netmap_source->spares_ubuf_mgr != NULL &&
+        (spare = upipe_netmap_spares_get(spares)) != NULL) {
+        uint8_t *buf = (uint8_t *)NETMAP_BUF(rxring, slot->buf_idx);
+        struct umem umem;
+        upipe_netmap_spares_umem(spares, buf, &umem);
+        struct uref *uref = uref_alloc(upipe_netmap_source->uref_mgr);
+        struct ubuf *ubuf = NULL;
+        if (likely(uref != NULL))
+            ubuf = ubuf_block_mem_alloc_from_umem(
+                    upipe_netmap_source->spares_ubuf_mgr,
+                    &umem, payload - buf, payload_len);
+        if (likely(ubuf != NULL)) {
+            uref_attach_ubuf(uref, ubuf);
+            slot->buf_idx = upipe_netmap_spares_idx(spares, spare);
+            slot->flags |= NS_BUF_CHANGED;
+            return uref;
+        }
+        if (uref != NULL)
+            uref_free(uref);
+        upipe_netmap_spares_put(spares, spare);
+    }
+
+    struct uref *uref = uref_block_alloc(upipe_netmap_source->uref_mgr,
+                                         upipe_netmap_source->ubuf_mgr,
+                                         payload_len);
+    if (unlikely(uref == NULL))
+        return NULL;
+
+    uint8_t *buffer;
+    int output_size = -1;
+    if (unlikely(!ubase_check(uref_block_write(uref, 0, &output_size,
+                                               &buffer)))) {
+        uref_free(uref);
+        return NULL;
+    }
+
+    memcpy(buffer, payload, payload_len);
+    uref_block_unmap(uref, 0);
+    return uref;
+}
+
 static void upipe_netmap_source_worker(struct upump *upump)
 {
     struct upipe *upipe = upump_get_opaque(upump, struct upipe *);
@@ -159,7 +295,8 @@ static void upipe_netmap_source_worker(struct upump *upump)
 
     while (!nm_ring_empty(rxring)) {
         const uint32_t cur = rxring->cur;
-        uint8_t *src = (uint8_t*)NETMAP_BUF(rxring, rxring->slot[cur].buf_idx);
+        struct netmap_slot *slot = &rxring->slot[cur];
+        uint8_t *src = (uint8_t*)NETMAP_BUF(rxring, slot->buf_idx);
 
         if (ethernet_get_lentype(src) != ETHERNET_TYPE_IP)
             goto next;
@@ -172,26 +309,13 @@ static void upipe_netmap_source_worker(struct upump *upump)
         const uint8_t *rtp = udp_payload(udp);
         uint16_t payload_len = udp_get_len(udp) - UDP_HEADER_SIZE;
 
-        struct uref *uref = uref_block_alloc(upipe_netmap_source->uref_mgr,
-                                             upipe_netmap_source->ubuf_mgr,
-                                             payload_len);
+        struct uref *uref = upipe_netmap_source_alloc_uref(upipe, rxring,
+                slot, rtp, payload_len);
         if (unlikely(uref == NULL)) {
             upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
             return;
         }
 
-        uint8_t *buffer;
-        int output_size = -1;
-        if (unlikely(!ubase_check(uref_block_write(uref, 0, &output_size,
-                                                   &buffer)))) {
-            uref_free(uref);
-            upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
-            return;
-        }
-
-        memcpy(buffer, rtp, payload_len);
-        uref_block_unmap(uref, 0);
-
         uref_clock_set_cr_sys(uref, systime);
 
         upipe_netmap_source_output(upipe, uref, &upipe_netmap_source->upump);
@@ -270,6 +394,54 @@ static int upipe_netmap_source_get_uri(struct upipe *upipe, const char **uri_p)
     return UBASE_ERR_NONE;
 }
 
+/** @internal @This closes the netmap descriptor. If buffers are still held
+ * downstream, it is actually closed when the last one is released.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_netmap_source_close(struct upipe *upipe)
+{
+    struct upipe_netmap_source *upipe_netmap_source = upipe_netmap_source_from_upipe(upipe);
+
+    ubuf_mgr_release(upipe_netmap_source->spares_ubuf_mgr);
+    upipe_netmap_source->spares_ubuf_mgr = NULL;
+    if (upipe_netmap_source->spares != NULL) {
+        upipe_netmap_spares_release(upipe_netmap_source->spares);
+        upipe_netmap_source->spares = NULL;
+    } else
+        nm_close(upipe_netmap_source->d);
+    upipe_netmap_source->d = NULL;
+}
+
+/** @internal @This sets up zero-copy reception with the extra buffers
+ * allocated by netmap, or falls back to copying.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_netmap_source_open_spares(struct upipe *upipe)
+{
+    struct upipe_netmap_source *upipe_netmap_source = upipe_netmap_source_from_upipe(upipe);
+
+    struct upipe_netmap_spares *spares =
+        upipe_netmap_source_spares_alloc_set(upipe, upipe_netmap_source->d);
+    if (unlikely(spares == NULL)) {
+        upipe_warn_va(upipe, "can't get %u spare buffers, copying payloads",
+                      upipe_netmap_source->zerocopy);
+        return;
+    }
+
+    upipe_netmap_source->spares_ubuf_mgr =
+        ubuf_block_mem_mgr_alloc(UBUF_POOL_DEPTH, UBUF_POOL_DEPTH,
+                                 &spares->mgr, 0, 0, -1, 0);
+    upipe_netmap_source->spares = spares;
+    if (unlikely(upipe_netmap_source->spares_ubuf_mgr == NULL)) {
+        upipe_warn(upipe, "can't allocate ubuf manager, copying payloads");
+        return;
+    }
+    upipe_dbg_va(upipe, "using %u spare buffers for zero-copy",
+                 upipe_netmap_source->d->req.nr_arg3);
+}
+
 /** @internal @This asks to open the given netmap source.
  *
  * @param upipe description structure of the pipe
@@ -280,9 +452,9 @@ static int upipe_netmap_source_set_uri(struct upipe *upipe, const char *uri)
 {
     struct upipe_netmap_source *upipe_netmap_source = upipe_netmap_source_from_upipe(upipe);
 
-    nm_close(upipe_netmap_source->d);
-    ubase_clean_str(&upipe_netmap_source->uri);
     upipe_netmap_source_set_upump(upipe, NULL);
+    upipe_netmap_source_close(upipe);
+    ubase_clean_str(&upipe_netmap_source->uri);
 
     if (unlikely(uri == NULL))
         return UBASE_ERR_NONE;
@@ -292,16 +464,25 @@ static int upipe_netmap_source_set_uri(struct upipe *upipe, const char *uri)
         return UBASE_ERR_EXTERNAL;
     }
 
-    upipe_netmap_source->d = nm_open(uri, NULL, 0, 0);
+    if (upipe_netmap_source->zerocopy) {
+        /* request extra buffers to swap with the ring slots */
+        struct nm_desc parent;
+        memset(&parent, 0, sizeof(parent));
+        parent.req.nr_arg3 = upipe_netmap_source->zerocopy;
+        upipe_netmap_source->d = nm_open(uri, NULL, NM_OPEN_ARG3, &parent);
+    } else
+        upipe_netmap_source->d = nm_open(uri, NULL, 0, 0);
     if (unlikely(!upipe_netmap_source->d)) {
         upipe_err_va(upipe, "can't open netmap socket %s", uri);
         return UBASE_ERR_EXTERNAL;
     }
 
+    if (upipe_netmap_source->zerocopy)
+        upipe_netmap_source_open_spares(upipe);
+
     upipe_netmap_source->uri = strdup(uri);
     if (unlikely(upipe_netmap_source->uri == NULL)) {
-        nm_close(upipe_netmap_source->d);
-        upipe_netmap_source->d = NULL;
+        upipe_netmap_source_close(upipe);
         upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
         return UBASE_ERR_ALLOC;
     }
@@ -343,6 +524,21 @@ static int _upipe_netmap_source_control(struct upipe *upipe,
             const char *uri = va_arg(args, const char *);
             return upipe_netmap_source_set_uri(upipe, uri);
         }
+
+        case UPIPE_NETMAP_SOURCE_GET_ZEROCOPY: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_NETMAP_SOURCE_SIGNATURE)
+            unsigned int *nb_buffers_p = va_arg(args, unsigned int *);
+            *nb_buffers_p = upipe_netmap_source_from_upipe(upipe)->zerocopy;
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_NETMAP_SOURCE_SET_ZEROCOPY: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_NETMAP_SOURCE_SIGNATURE)
+            unsigned int nb_buffers = va_arg(args, unsigned int);
+            if (nb_buffers > UINT16_MAX)
+                return UBASE_ERR_INVALID;
+            upipe_netmap_source_from_upipe(upipe)->zerocopy = nb_buffers;
+            return UBASE_ERR_NONE;
+        }
         default:
             return UBASE_ERR_UNHANDLED;
     }
@@ -371,7 +567,8 @@ static void upipe_netmap_source_free(struct upipe *upipe)
 {
     struct upipe_netmap_source *upipe_netmap_source = upipe_netmap_source_from_upipe(upipe);
 
-    nm_close(upipe_netmap_source->d);
+    upipe_netmap_source_set_upump(upipe, NULL);
+    upipe_netmap_source_close(upipe);
 
     upipe_throw_dead(upipe);
 
@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short Upipe set of spare netmap buffers for zero-copy reception
+ * The spare buffers are swapped with the buffers of the receive ring so that
+ * received packets can be output without copy. The set is also a umem
+ * manager, so that the buffers held by ubufs come back to the set when
+ * released, from any thread. This part does not depend on netmap itself.
+ */
+
+#ifndef _UPIPE_NETMAP_UPIPE_NETMAP_SPARES_H_
+/** @hidden */
+#define _UPIPE_NETMAP_UPIPE_NETMAP_SPARES_H_
+
+#include "upipe/ubase.h"
+#include "upipe/umem.h"
+#include "upipe/ulifo.h"
+#include "upipe/urefcount.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <assert.h>
+
+/** @internal @This is a set of spare netmap buffers. */
+struct upipe_netmap_spares {
+    /** refcount management structure */
+    struct urefcount urefcount;
+
+    /** called when the last reference is released, with the unused buffers
+     * still in the set */
+    void (*release)(struct upipe_netmap_spares *);
+    /** opaque given to the release callback (netmap descriptor) */
+    void *opaque;
+    /** address of the netmap buffer of index 0 */
+    uint8_t *base;
+    /** size of a netmap buffer */
+    uint32_t buf_size;
+
+    /** LIFO of unused spare buffers */
+    struct ulifo bufs;
+
+    /** common umem management structure */
+    struct umem_mgr mgr;
+
+    /** extra space for ulifo */
+    uint8_t ulifo_extra[];
+};
+
+UBASE_FROM_TO(upipe_netmap_spares, umem_mgr, umem_mgr, mgr)
+UBASE_FROM_TO(upipe_netmap_spares, urefcount, urefcount, urefcount)
+
+/** @internal @This returns the index of a netmap buffer.
+ *
+ * @param spares pointer to spare buffers
+ * @param buf pointer to the netmap buffer
+ * @return buffer index
+ */
+static inline uint32_t
+    upipe_netmap_spares_idx(struct upipe_netmap_spares *spares,
+                            const uint8_t *buf)
+{
+    return (buf - spares->base) / spares->buf_size;
+}
+
+/** @internal @This refuses to allocate buffers, since spare buffers may only
+ * be obtained by swapping ring slots.
+ *
+ * @param mgr pointer to umem manager
+ * @param umem caller-allocated structure
+ * @param size requested size
+ * @return false
+ */
+static inline bool upipe_netmap_spares_umem_alloc(struct umem_mgr *mgr,
+                                                  struct umem *umem,
+                                                  size_t size)
+{
+    return false;
+}
+
+/** @internal @This resizes a buffer, which is only possible inside the
+ * netmap buffer.
+ *
+ * @param umem pointer to umem
+ * @param new_size new requested size
+ * @return false if the new size does not fit in a netmap buffer
+ */
+static inline bool upipe_netmap_spares_umem_realloc(struct umem *umem,
+                                                    size_t new_size)
+{
+    if (new_size > umem->real_size)
+        return false;
+    umem->size = new_size;
+    return true;
+}
+
+/** @internal @This gives a buffer back to the spare buffers.
+ *
+ * @param umem pointer to umem
+ */
+static inline void upipe_netmap_spares_umem_free(struct umem *umem)
+{
+    struct upipe_netmap_spares *spares =
+        upipe_netmap_spares_from_umem_mgr(umem->mgr);
+    bool ret = ulifo_push(&spares->bufs, umem->buffer);
+    assert(ret);
+    (void)ret;
+    umem->buffer = NULL;
+    umem->mgr = NULL;
+}
+
+/** @internal @This hands the unused buffers to the release callback and
+ * frees the set.
+ *
+ * @param urefcount pointer to urefcount
+ */
+static inline void upipe_netmap_spares_free(struct urefcount *urefcount)
+{
+    struct upipe_netmap_spares *spares =
+        upipe_netmap_spares_from_urefcount(urefcount);
+    spares->release(spares);
+    ulifo_clean(&spares->bufs);
+    urefcount_clean(urefcount);
+    free(spares);
+}
+
+/** @internal @This allocates an empty set of spare buffers.
+ *
+ * @param nb_bufs maximum number of buffers in the set
+ * @param base address of the netmap buffer of index 0
+ * @param buf_size size of a netmap buffer
+ * @param release called when the last reference is released
+ * @param opaque opaque given to the release callback
+ * @return pointer to spare buffers, or NULL in case of error
+ */
+static inline struct upipe_netmap_spares *
+    upipe_netmap_spares_alloc(unsigned int nb_bufs, uint8_t *base,
+                              uint32_t buf_size,
+                              void (*release)(struct upipe_netmap_spares *),
+                              void *opaque)
+{
+    if (unlikely(nb_bufs == 0 || nb_bufs > UINT16_MAX))
+        return NULL;
+
+    struct upipe_netmap_spares *spares =
+        malloc(sizeof(struct upipe_netmap_spares) + ulifo_sizeof(nb_bufs));
+    if (unlikely(spares == NULL))
+        return NULL;
+
+    spares->release = release;
+    spares->opaque = opaque;
+    spares->base = base;
+    spares->buf_size = buf_size;
+    ulifo_init(&spares->bufs, nb_bufs, spares->ulifo_extra);
+
+    urefcount_init(upipe_netmap_spares_to_urefcount(spares),
+                   upipe_netmap_spares_free);
+    spares->mgr.refcount = upipe_netmap_spares_to_urefcount(spares);
+    spares->mgr.umem_alloc = upipe_netmap_spares_umem_alloc;
+    spares->mgr.umem_realloc = upipe_netmap_spares_umem_realloc;
+    spares->mgr.umem_free = upipe_netmap_spares_umem_free;
+    spares->mgr.umem_mgr_vacuum = NULL;
+    return spares;
+}
+
+/** @internal @This releases a reference to the set of spare buffers.
+ *
+ * @param spares pointer to spare buffers
+ */
+static inline void upipe_netmap_spares_release(
+        struct upipe_netmap_spares *spares)
+{
+    urefcount_release(upipe_netmap_spares_to_urefcount(spares));
+}
+
+/** @internal @This adds an unused buffer to the set.
+ *
+ * @param spares pointer to spare buffers
+ * @param buf pointer to the netmap buffer
+ * @return false if the set is full
+ */
+static inline bool upipe_netmap_spares_put(struct upipe_netmap_spares *spares,
+                                           uint8_t *buf)
+{
+    return ulifo_push(&spares->bufs, buf);
+}
+
+/** @internal @This takes an unused buffer from the set.
+ *
+ * @param spares pointer to spare buffers
+ * @return pointer to the netmap buffer, or NULL if all are in use
+ */
+static inline uint8_t *upipe_netmap_spares_get(
+        struct upipe_netmap_spares *spares)
+{
+    return ulifo_pop(&spares->bufs, uint8_t *);
+}
+
+/** @internal @This fills in a umem describing a netmap buffer, which is given
+ * back to the set when the umem is freed.
+ *
+ * @param spares pointer to spare buffers
+ * @param buf pointer to the netmap buffer
+ * @param umem caller-allocated structure
+ */
+static inline void upipe_netmap_spares_umem(struct upipe_netmap_spares *spares,
+                                            uint8_t *buf, struct umem *umem)
+{
+    umem->mgr = &spares->mgr;
+    umem->buffer = buf;
+    umem->size = umem->real_size = spares->buf_size;
+}
+
+#endif
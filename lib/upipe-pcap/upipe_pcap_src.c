@@ -11,12 +11,17 @@
  */
 
 /* TODO:
-    - avoid memcpy? custom ubuf_mgr to delay pcap_close?
-    - filtering? pcap_setfilter() or something else
     - set uref source ip?
  */
 
 #include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 
 #include "upipe/upipe.h"
 #include "upipe/upump.h"
@@ -24,6 +29,8 @@
 #include "upipe/uref_clock.h"
 #include "upipe/uclock.h"
 #include "upipe/uref_block_flow.h"
+#include "upipe/ubuf_block_mem.h"
+#include "upipe/umem.h"
 #include "upipe/upipe_helper_upipe.h"
 #include "upipe/upipe_helper_urefcount.h"
 #include "upipe/upipe_helper_void.h"
@@ -41,6 +48,36 @@
 #include <bitstream/ietf/udp.h>
 #include <bitstream/ieee/ethernet.h>
 
+/** depth of the pools of the ubuf manager wrapping the mapped file */
+#define UBUF_POOL_DEPTH 1024
+/** size of the global header of a pcap file */
+#define PCAP_FILE_HEADER_SIZE 24
+/** size of the record header of a pcap file */
+#define PCAP_RECORD_HEADER_SIZE 16
+/** magic number of pcap files with microsecond timestamps */
+#define PCAP_MAGIC_USEC 0xa1b2c3d4
+/** magic number of pcap files with nanosecond timestamps */
+#define PCAP_MAGIC_NSEC 0xa1b23c4d
+/** link type of ethernet captures */
+#define PCAP_LINKTYPE_ETHERNET 1
+
+/** @internal @This is a capture file mapped in memory. It is also a umem
+ * manager, so that packets may be output without copy; the file is unmapped
+ * when the last ubuf pointing to it is released. */
+struct upipe_pcap_src_map {
+    /** refcount management structure */
+    struct urefcount urefcount;
+    /** mapped file */
+    uint8_t *base;
+    /** size of the mapped file */
+    size_t size;
+    /** common umem management structure */
+    struct umem_mgr mgr;
+};
+
+UBASE_FROM_TO(upipe_pcap_src_map, umem_mgr, umem_mgr, mgr)
+UBASE_FROM_TO(upipe_pcap_src_map, urefcount, urefcount, urefcount)
+
 struct upipe_pcap_src {
     /** refcount management structure */
     struct urefcount urefcount;
@@ -82,6 +119,33 @@ struct upipe_pcap_src {
     uint64_t cr_offset;
     struct uref *uref;
 
+    /** mapped capture file, or NULL if the file is read with libpcap */
+    struct upipe_pcap_src_map *map;
+    /** ubuf manager wrapping the mapped file */
+    struct ubuf_mgr *map_ubuf_mgr;
+    /** offset of the next record in the mapped file */
+    size_t map_offset;
+    /** true if the mapped file has the opposite byte order */
+    bool map_swapped;
+    /** true if the mapped file has nanosecond timestamps */
+    bool map_nsec;
+
+    /** maximum number of packets output per callback */
+    unsigned int batch;
+    /** replay speed, or 0 to output as fast as possible */
+    struct urational speed;
+    /** timestamp of the first packet, or UINT64_MAX */
+    uint64_t ts_origin;
+    /** true if the pump is a timer waiting for the held uref */
+    bool waiting;
+
+    /** true if datagrams are filtered by destination */
+    bool filter;
+    /** destination address to keep, in host order, or INADDR_ANY */
+    uint32_t filter_addr;
+    /** destination port to keep, or 0 */
+    uint16_t filter_port;
+
     /** public upipe structure */
     struct upipe upipe;
 };
@@ -107,13 +171,174 @@ UPIPE_HELPER_UCLOCK(upipe_pcap_src, uclock, uclock_request, upipe_pcap_src_check
                     upipe_pcap_src_register_output_request,
                     upipe_pcap_src_unregister_output_request)
 
+/** @internal @This refuses to allocate buffers from the mapped file.
+ *
+ * @param mgr pointer to umem manager
+ * @param umem caller-allocated structure
+ * @param size requested size
+ * @return false
+ */
+static bool upipe_pcap_src_map_alloc(struct umem_mgr *mgr, struct umem *umem,
+                                     size_t size)
+{
+    return false;
+}
+
+/** @internal @This refuses to resize buffers beyond the packet.
+ *
+ * @param umem pointer to umem
+ * @param new_size new requested size
+ * @return false if the new size does not fit in the packet
+ */
+static bool upipe_pcap_src_map_realloc(struct umem *umem, size_t new_size)
+{
+    if (new_size > umem->real_size)
+        return false;
+    umem->size = new_size;
+    return true;
+}
+
+/** @internal @This releases a buffer pointing to the mapped file. The file
+ * itself is kept mapped by the ubuf manager.
+ *
+ * @param umem pointer to umem
+ */
+static void upipe_pcap_src_map_free_buf(struct umem *umem)
+{
+    umem->buffer = NULL;
+    umem->mgr = NULL;
+}
+
+/** @internal @This unmaps a capture file.
+ *
+ * @param urefcount pointer to urefcount
+ */
+static void upipe_pcap_src_map_free(struct urefcount *urefcount)
+{
+    struct upipe_pcap_src_map *map =
+        upipe_pcap_src_map_from_urefcount(urefcount);
+    munmap(map->base, map->size);
+    urefcount_clean(urefcount);
+    free(map);
+}
+
+/** @internal @This reads a 32-bit field of the mapped file.
+ *
+ * @param upipe description structure of the pipe
+ * @param p pointer to the field
+ * @return value of the field
+ */
+static inline uint32_t upipe_pcap_src_map_read(struct upipe *upipe,
+                                               const uint8_t *p)
+{
+    struct upipe_pcap_src *upipe_pcap_src = upipe_pcap_src_from_upipe(upipe);
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return upipe_pcap_src->map_swapped ? __builtin_bswap32(v) : v;
+}
+
+/** @internal @This maps a classic pcap file of ethernet captures.
+ *
+ * @param upipe description structure of the pipe
+ * @param uri path to the capture file
+ * @return an error code, UBASE_ERR_INVALID if the file must be read with
+ * libpcap
+ */
+static int upipe_pcap_src_map_open(struct upipe *upipe, const char *uri)
+{
+    struct upipe_pcap_src *upipe_pcap_src = upipe_pcap_src_from_upipe(upipe);
+
+    int fd = open(uri, O_RDONLY);
+    if (unlikely(fd < 0)) {
+        upipe_err_va(upipe, "can't open %s (%m)", uri);
+        return UBASE_ERR_EXTERNAL;
+    }
+    struct stat st;
+    if (unlikely(fstat(fd, &st) < 0)) {
+        upipe_err_va(upipe, "can't stat %s (%m)", uri);
+        close(fd);
+        return UBASE_ERR_EXTERNAL;
+    }
+    if (st.st_size < PCAP_FILE_HEADER_SIZE) {
+        close(fd);
+        return UBASE_ERR_INVALID;
+    }
+
+    /* private writable mapping, so that downstream pipes may write to the
+     * ubufs without altering the file */
+    uint8_t *base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (unlikely(base == MAP_FAILED)) {
+        upipe_warn_va(upipe, "can't map %s (%m)", uri);
+        return UBASE_ERR_INVALID;
+    }
+    madvise(base, st.st_size, MADV_SEQUENTIAL);
+
+    uint32_t magic;
+    memcpy(&magic, base, sizeof(magic));
+    upipe_pcap_src->map_swapped = magic == __builtin_bswap32(PCAP_MAGIC_USEC) ||
+                                  magic == __builtin_bswap32(PCAP_MAGIC_NSEC);
+    if (upipe_pcap_src->map_swapped)
+        magic = __builtin_bswap32(magic);
+    upipe_pcap_src->map_nsec = magic == PCAP_MAGIC_NSEC;
+    if ((magic != PCAP_MAGIC_USEC && magic != PCAP_MAGIC_NSEC) ||
+        upipe_pcap_src_map_read(upipe, base + 20) != PCAP_LINKTYPE_ETHERNET) {
+        munmap(base, st.st_size);
+        return UBASE_ERR_INVALID;
+    }
+
+    struct upipe_pcap_src_map *map = malloc(sizeof(*map));
+    if (unlikely(map == NULL)) {
+        munmap(base, st.st_size);
+        return UBASE_ERR_ALLOC;
+    }
+    map->base = base;
+    map->size = st.st_size;
+    urefcount_init(upipe_pcap_src_map_to_urefcount(map),
+                   upipe_pcap_src_map_free);
+    map->mgr.refcount = upipe_pcap_src_map_to_urefcount(map);
+    map->mgr.umem_alloc = upipe_pcap_src_map_alloc;
+    map->mgr.umem_realloc = upipe_pcap_src_map_realloc;
+    map->mgr.umem_free = upipe_pcap_src_map_free_buf;
+    map->mgr.umem_mgr_vacuum = NULL;
+
+    upipe_pcap_src->map_ubuf_mgr =
+        ubuf_block_mem_mgr_alloc(UBUF_POOL_DEPTH, UBUF_POOL_DEPTH,
+                                 &map->mgr, 0, 0, -1, 0);
+    if (unlikely(upipe_pcap_src->map_ubuf_mgr == NULL)) {
+        urefcount_release(upipe_pcap_src_map_to_urefcount(map));
+        return UBASE_ERR_ALLOC;
+    }
+    upipe_pcap_src->map = map;
+    upipe_pcap_src->map_offset = PCAP_FILE_HEADER_SIZE;
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This unmaps the capture file, once all packets pointing to it
+ * are released.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_pcap_src_map_close(struct upipe *upipe)
+{
+    struct upipe_pcap_src *upipe_pcap_src = upipe_pcap_src_from_upipe(upipe);
+    ubuf_mgr_release(upipe_pcap_src->map_ubuf_mgr);
+    upipe_pcap_src->map_ubuf_mgr = NULL;
+    if (upipe_pcap_src->map != NULL)
+        urefcount_release(upipe_pcap_src_map_to_urefcount(upipe_pcap_src->map));
+    upipe_pcap_src->map = NULL;
+}
+
 /** @internal @This skips ethernet, IP and UDP headers
  *
  * @param buf pointer to ethernet packet
  * @param len size of ethernet packet
+ * @param ip_p filled in with a pointer to the IP header
  * @return the amount of bytes to skip to reach UDP payload
  */
-static size_t upipe_pcap_skip(const uint8_t *buf, size_t len)
+static size_t upipe_pcap_skip(const uint8_t *buf, size_t len,
+                              const uint8_t **ip_p)
 {
     if (len < ETHERNET_HEADER_LEN + ETHERNET_VLAN_LEN)
         return 0;
@@ -135,25 +360,54 @@ static size_t upipe_pcap_skip(const uint8_t *buf, size_t len)
     if (len < UDP_HEADER_SIZE)
         return 0;
 
+    *ip_p = ip;
     return len - UDP_HEADER_SIZE;
 }
 
-/** @internal @This reads data from the source and outputs it.
+/** @internal @This reads the next packet of the capture.
  *
- * @param upump description structure of the read watcher
+ * @param upipe description structure of the pipe
+ * @param data_p filled in with a pointer to the packet
+ * @param len_p filled in with the captured size of the packet
+ * @param ts_p filled in with the capture timestamp
+ * @return 1 if a packet was read, 0 if none is available, or -1 at the end
+ * of the capture
  */
-static void upipe_pcap_src_worker(struct upump *upump)
+static int upipe_pcap_src_next(struct upipe *upipe, const uint8_t **data_p,
+                               size_t *len_p, uint64_t *ts_p)
 {
-    struct upipe *upipe = upump_get_opaque(upump, struct upipe *);
     struct upipe_pcap_src *upipe_pcap_src = upipe_pcap_src_from_upipe(upipe);
+    struct upipe_pcap_src_map *map = upipe_pcap_src->map;
+
+    if (map != NULL) {
+        size_t offset = upipe_pcap_src->map_offset;
+        if (map->size - offset < PCAP_RECORD_HEADER_SIZE)
+            return -1;
+
+        const uint8_t *rec = map->base + offset;
+        uint32_t sec = upipe_pcap_src_map_read(upipe, rec);
+        uint32_t frac = upipe_pcap_src_map_read(upipe, rec + 4);
+        uint32_t caplen = upipe_pcap_src_map_read(upipe, rec + 8);
+        uint32_t len = upipe_pcap_src_map_read(upipe, rec + 12);
+        offset += PCAP_RECORD_HEADER_SIZE;
+        if (unlikely(caplen > map->size - offset)) {
+            upipe_warn(upipe, "truncated capture file");
+            return -1;
+        }
 
-    pcap_t *pcap = upipe_pcap_src->pcap;
-
-    if (upipe_pcap_src->uref) {
-        upipe_pcap_src_output(upipe, upipe_pcap_src->uref, &upipe_pcap_src->upump);
-        upipe_pcap_src->uref = NULL;
+        if (len != caplen)
+            upipe_warn_va(upipe, "Length captured (%"PRIu32") is not "
+                          "packet len (%"PRIu32")", caplen, len);
+        *data_p = map->base + offset;
+        *len_p = caplen;
+        *ts_p = (uint64_t)sec * UCLOCK_FREQ + (upipe_pcap_src->map_nsec ?
+                (uint64_t)frac * UCLOCK_FREQ / 1000000000 :
+                (uint64_t)frac * (UCLOCK_FREQ / 1000000));
+        upipe_pcap_src->map_offset = offset + caplen;
+        return 1;
     }
 
+    pcap_t *pcap = upipe_pcap_src->pcap;
     struct pcap_pkthdr *hdr;
     const u_char *data;
     switch (pcap_next_ex(pcap, &hdr, &data)) {
@@ -161,16 +415,14 @@ static void upipe_pcap_src_worker(struct upump *upump)
         break;
 
     case PCAP_ERROR_BREAK:
-        upipe_throw_source_end(upipe);
-        upipe_pcap_src_set_upump(upipe, NULL);
-        return;
+        return -1;
 
     case PCAP_ERROR:
         upipe_err_va(upipe, "%s", pcap_geterr(pcap));
-        return;
+        return 0;
 
     default: /* 0, PCAP_ERROR_NOT_ACTIVATED, only for live capture */
-        return;
+        return 0;
     }
 
     size_t len = hdr->len;
@@ -181,57 +433,171 @@ static void upipe_pcap_src_worker(struct upump *upump)
             len = hdr->caplen;
     }
 
-    size_t udp_len = upipe_pcap_skip(data, len);
-    assert(udp_len < len);
-    if (udp_len == 0) {
-        return;
+    *data_p = data;
+    *len_p = len;
+    *ts_p = hdr->ts.tv_sec * UCLOCK_FREQ + hdr->ts.tv_usec * (UCLOCK_FREQ / 1000000);
+    return 1;
+}
+
+/** @internal @This checks whether a datagram matches the filter.
+ *
+ * @param upipe description structure of the pipe
+ * @param ip pointer to the IP header
+ * @return true if the datagram must be output
+ */
+static inline bool upipe_pcap_src_match(struct upipe *upipe,
+                                        const uint8_t *ip)
+{
+    struct upipe_pcap_src *upipe_pcap_src = upipe_pcap_src_from_upipe(upipe);
+    if (!upipe_pcap_src->filter)
+        return true;
+
+    const uint8_t *udp = ip + 4 * ip_get_ihl(ip);
+    return (upipe_pcap_src->filter_addr == INADDR_ANY ||
+            ip_get_dstaddr((uint8_t *)ip) == upipe_pcap_src->filter_addr) &&
+           (upipe_pcap_src->filter_port == 0 ||
+            udp_get_dstport((uint8_t *)udp) == upipe_pcap_src->filter_port);
+}
+
+/** @internal @This allocates a uref containing a UDP payload, pointing to
+ * the mapped file if possible.
+ *
+ * @param upipe description structure of the pipe
+ * @param payload pointer to the payload
+ * @param size size of the payload
+ * @return pointer to uref, or NULL in case of allocation error
+ */
+static struct uref *upipe_pcap_src_alloc_uref(struct upipe *upipe,
+                                              const uint8_t *payload,
+                                              size_t size)
+{
+    struct upipe_pcap_src *upipe_pcap_src = upipe_pcap_src_from_upipe(upipe);
+
+    if (upipe_pcap_src->map != NULL) {
+        struct umem umem;
+        umem.mgr = &upipe_pcap_src->map->mgr;
+        umem.buffer = (uint8_t *)payload;
+        umem.size = umem.real_size = size;
+        struct ubuf *ubuf =
+            ubuf_block_mem_alloc_from_umem(upipe_pcap_src->map_ubuf_mgr,
+                                           &umem, 0, size);
+        if (unlikely(ubuf == NULL))
+            return NULL;
+        struct uref *uref = uref_alloc(upipe_pcap_src->uref_mgr);
+        if (unlikely(uref == NULL)) {
+            ubuf_free(ubuf);
+            return NULL;
+        }
+        uref_attach_ubuf(uref, ubuf);
+        return uref;
     }
 
     struct uref *uref = uref_block_alloc(upipe_pcap_src->uref_mgr,
                                          upipe_pcap_src->ubuf_mgr,
-                                         udp_len);
-    if (unlikely(!uref)) {
-        upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
-        return;
-    }
+                                         size);
+    if (unlikely(!uref))
+        return NULL;
 
     uint8_t *buffer;
     int output_size = -1;
     if (unlikely(!ubase_check(uref_block_write(uref, 0, &output_size,
                                                &buffer)))) {
         uref_free(uref);
-        upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
-        return;
+        return NULL;
     }
 
-    memcpy(buffer, &data[len - udp_len], udp_len);
+    memcpy(buffer, payload, size);
 
     uref_block_unmap(uref, 0);
+    return uref;
+}
 
-    uint64_t ts = hdr->ts.tv_sec * UCLOCK_FREQ + hdr->ts.tv_usec * (UCLOCK_FREQ / 1000000);
-
-    if (upipe_pcap_src->uclock) {
-        uint64_t now = uclock_now(upipe_pcap_src->uclock);
+/** @internal @This converts a capture timestamp to a cr_sys date.
+ *
+ * @param upipe description structure of the pipe
+ * @param ts capture timestamp
+ * @return cr_sys date
+ */
+static uint64_t upipe_pcap_src_date(struct upipe *upipe, uint64_t ts)
+{
+    struct upipe_pcap_src *upipe_pcap_src = upipe_pcap_src_from_upipe(upipe);
 
-        if (upipe_pcap_src->cr_offset == 0)
-            upipe_pcap_src->cr_offset = now - ts;
+    if (upipe_pcap_src->ts_origin == UINT64_MAX) {
+        upipe_pcap_src->ts_origin = ts;
+        upipe_pcap_src->cr_offset = upipe_pcap_src->uclock ?
+            uclock_now(upipe_pcap_src->uclock) : ts;
+    }
 
-        ts += upipe_pcap_src->cr_offset;
+    uint64_t delta = ts > upipe_pcap_src->ts_origin ?
+                     ts - upipe_pcap_src->ts_origin : 0;
+    if (upipe_pcap_src->speed.num)
+        delta = delta * upipe_pcap_src->speed.den / upipe_pcap_src->speed.num;
+    return upipe_pcap_src->cr_offset + delta;
+}
 
-        uref_clock_set_cr_sys(uref, ts);
-        upipe_pcap_src->uref = uref;
+/** @internal @This reads data from the source and outputs it.
+ *
+ * @param upump description structure of the read watcher
+ */
+static void upipe_pcap_src_worker(struct upump *upump)
+{
+    struct upipe *upipe = upump_get_opaque(upump, struct upipe *);
+    struct upipe_pcap_src *upipe_pcap_src = upipe_pcap_src_from_upipe(upipe);
 
-        uint64_t ticks = 0;
-        if (now < ts)
-            ticks = ts - now;
+    if (upipe_pcap_src->uref) {
+        upipe_pcap_src_output(upipe, upipe_pcap_src->uref, &upipe_pcap_src->upump);
+        upipe_pcap_src->uref = NULL;
+    }
 
-        upipe_pcap_src_wait_upump(upipe, ticks, upipe_pcap_src_worker);
-        return;
+    if (upipe_pcap_src->waiting) {
+        /* get back to the idler */
+        upipe_pcap_src->waiting = false;
+        upipe_pcap_src_set_upump(upipe, NULL);
+        upipe_pcap_src_check(upipe, NULL);
     }
 
-    uref_clock_set_cr_sys(uref, ts);
+    for (unsigned int i = 0; i < upipe_pcap_src->batch; i++) {
+        const uint8_t *data;
+        size_t len;
+        uint64_t ts;
+        int ret = upipe_pcap_src_next(upipe, &data, &len, &ts);
+        if (ret < 0) {
+            upipe_throw_source_end(upipe);
+            upipe_pcap_src_set_upump(upipe, NULL);
+            return;
+        }
+        if (ret == 0)
+            return;
+
+        const uint8_t *ip;
+        size_t udp_len = upipe_pcap_skip(data, len, &ip);
+        assert(udp_len < len);
+        if (udp_len == 0 || !upipe_pcap_src_match(upipe, ip))
+            continue;
+
+        struct uref *uref = upipe_pcap_src_alloc_uref(upipe,
+                &data[len - udp_len], udp_len);
+        if (unlikely(!uref)) {
+            upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+            return;
+        }
+
+        uint64_t cr_sys = upipe_pcap_src_date(upipe, ts);
+        uref_clock_set_cr_sys(uref, cr_sys);
+
+        if (upipe_pcap_src->uclock && upipe_pcap_src->speed.num) {
+            uint64_t now = uclock_now(upipe_pcap_src->uclock);
+            if (now < cr_sys) {
+                upipe_pcap_src->uref = uref;
+                upipe_pcap_src->waiting = true;
+                upipe_pcap_src_wait_upump(upipe, cr_sys - now,
+                                          upipe_pcap_src_worker);
+                return;
+            }
+        }
 
-    upipe_pcap_src_output(upipe, uref, &upipe_pcap_src->upump);
+        upipe_pcap_src_output(upipe, uref, &upipe_pcap_src->upump);
+    }
 }
 
 /** @internal @This checks if the pump may be allocated.
@@ -266,7 +632,8 @@ static int upipe_pcap_src_check(struct upipe *upipe, struct uref *flow_format)
         return UBASE_ERR_NONE;
     }
 
-    if (upipe_pcap_src->pcap && !upipe_pcap_src->upump) {
+    if ((upipe_pcap_src->pcap || upipe_pcap_src->map) &&
+        !upipe_pcap_src->upump) {
         struct upump *upump;
             upump = upump_alloc_idler(upipe_pcap_src->upump_mgr,
                                       upipe_pcap_src_worker, upipe,
@@ -282,6 +649,28 @@ static int upipe_pcap_src_check(struct upipe *upipe, struct uref *flow_format)
     return UBASE_ERR_NONE;
 }
 
+/** @internal @This closes the current capture file, if any.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_pcap_src_close(struct upipe *upipe)
+{
+    struct upipe_pcap_src *upipe_pcap_src = upipe_pcap_src_from_upipe(upipe);
+
+    if (upipe_pcap_src->pcap || upipe_pcap_src->map) {
+        if (upipe_pcap_src->pcap)
+            pcap_close(upipe_pcap_src->pcap);
+        upipe_pcap_src_map_close(upipe);
+        upipe_pcap_src_set_upump(upipe, NULL);
+    }
+    upipe_pcap_src->pcap = NULL;
+    if (upipe_pcap_src->uref) {
+        uref_free(upipe_pcap_src->uref);
+        upipe_pcap_src->uref = NULL;
+    }
+    upipe_pcap_src->waiting = false;
+}
+
 /** @internal @This asks to open the given pcap capture file.
  *
  * @param upipe description structure of the pipe
@@ -292,15 +681,16 @@ static int upipe_pcap_set_uri(struct upipe *upipe, const char *uri)
 {
     struct upipe_pcap_src *upipe_pcap_src = upipe_pcap_src_from_upipe(upipe);
 
-    if (!uri) {
-        if (upipe_pcap_src->pcap) {
-            pcap_close(upipe_pcap_src->pcap);
-            upipe_pcap_src_set_upump(upipe, NULL);
-        }
-        upipe_pcap_src->pcap = NULL;
+    upipe_pcap_src_close(upipe);
+    if (!uri)
         return UBASE_ERR_NONE;
-    }
 
+    upipe_pcap_src->ts_origin = UINT64_MAX;
+    int err = upipe_pcap_src_map_open(upipe, uri);
+    if (err != UBASE_ERR_INVALID)
+        return err;
+
+    /* not a classic pcap file of ethernet captures, use libpcap */
     upipe_pcap_src->pcap = pcap_open_offline(uri, upipe_pcap_src->errbuf);
     if (!upipe_pcap_src->pcap) {
         upipe_err_va(upipe, "%s: %s", uri, upipe_pcap_src->errbuf);
@@ -310,6 +700,46 @@ static int upipe_pcap_set_uri(struct upipe *upipe, const char *uri)
     return UBASE_ERR_NONE;
 }
 
+/** @internal @This sets the UDP destination filter.
+ *
+ * @param upipe description structure of the pipe
+ * @param filter destination of the form [addr][:port], or NULL
+ * @return an error code
+ */
+static int upipe_pcap_src_set_filter_str(struct upipe *upipe,
+                                         const char *filter)
+{
+    struct upipe_pcap_src *upipe_pcap_src = upipe_pcap_src_from_upipe(upipe);
+
+    upipe_pcap_src->filter = false;
+    if (filter == NULL)
+        return UBASE_ERR_NONE;
+
+    char addr[INET_ADDRSTRLEN] = "";
+    unsigned int port = 0;
+    const char *colon = strchr(filter, ':');
+    size_t addr_len = colon != NULL ? colon - filter : strlen(filter);
+    if (addr_len >= sizeof(addr) ||
+        (colon != NULL && (sscanf(colon + 1, "%u", &port) != 1 ||
+                           port > UINT16_MAX))) {
+        upipe_err_va(upipe, "invalid filter %s", filter);
+        return UBASE_ERR_INVALID;
+    }
+    memcpy(addr, filter, addr_len);
+    addr[addr_len] = '\0';
+
+    struct in_addr in = { .s_addr = INADDR_ANY };
+    if (addr_len && inet_pton(AF_INET, addr, &in) != 1) {
+        upipe_err_va(upipe, "invalid filter address %s", addr);
+        return UBASE_ERR_INVALID;
+    }
+
+    upipe_pcap_src->filter = true;
+    upipe_pcap_src->filter_addr = ntohl(in.s_addr);
+    upipe_pcap_src->filter_port = port;
+    return UBASE_ERR_NONE;
+}
+
 /** @internal @This processes control commands on a pcap source pipe.
  *
  * @param upipe description structure of the pipe
@@ -333,6 +763,28 @@ static int _upipe_pcap_src_control(struct upipe *upipe, int command,
             return upipe_pcap_src_control_output(upipe, command, args);
         case UPIPE_SET_URI:
             return upipe_pcap_set_uri(upipe, va_arg(args, const char *));
+
+        case UPIPE_PCAP_SRC_SET_BATCH: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_PCAP_SRC_SIGNATURE)
+            unsigned int batch = va_arg(args, unsigned int);
+            if (!batch)
+                return UBASE_ERR_INVALID;
+            upipe_pcap_src_from_upipe(upipe)->batch = batch;
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_PCAP_SRC_SET_SPEED: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_PCAP_SRC_SIGNATURE)
+            struct urational speed = va_arg(args, struct urational);
+            if (speed.num < 0 || (speed.num && !speed.den))
+                return UBASE_ERR_INVALID;
+            upipe_pcap_src_from_upipe(upipe)->speed = speed;
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_PCAP_SRC_SET_FILTER: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_PCAP_SRC_SIGNATURE)
+            const char *filter = va_arg(args, const char *);
+            return upipe_pcap_src_set_filter_str(upipe, filter);
+        }
         default:
             return UBASE_ERR_UNHANDLED;
     }
@@ -360,13 +812,9 @@ static int upipe_pcap_src_control(struct upipe *upipe, int command,
  */
 static void upipe_pcap_src_free(struct upipe *upipe)
 {
-    struct upipe_pcap_src *upipe_pcap_src = upipe_pcap_src_from_upipe(upipe);
     upipe_throw_dead(upipe);
 
-    if (upipe_pcap_src->pcap)
-        pcap_close(upipe_pcap_src->pcap);
-    if (upipe_pcap_src->uref)
-        uref_free(upipe_pcap_src->uref);
+    upipe_pcap_src_close(upipe);
 
     upipe_pcap_src_clean_output(upipe);
     upipe_pcap_src_clean_urefcount(upipe);
@@ -400,6 +848,18 @@ static struct upipe *upipe_pcap_src_alloc(struct upipe_mgr *mgr,
     upipe_pcap_src->pcap = NULL;
     upipe_pcap_src->uref = NULL;
     upipe_pcap_src->cr_offset = 0;
+    upipe_pcap_src->map = NULL;
+    upipe_pcap_src->map_ubuf_mgr = NULL;
+    upipe_pcap_src->map_offset = 0;
+    upipe_pcap_src->map_swapped = false;
+    upipe_pcap_src->map_nsec = false;
+    upipe_pcap_src->batch = 1;
+    upipe_pcap_src->speed.num = upipe_pcap_src->speed.den = 1;
+    upipe_pcap_src->ts_origin = UINT64_MAX;
+    upipe_pcap_src->waiting = false;
+    upipe_pcap_src->filter = false;
+    upipe_pcap_src->filter_addr = INADDR_ANY;
+    upipe_pcap_src->filter_port = 0;
 
     upipe_pcap_src_init_urefcount(upipe);
     upipe_pcap_src_init_ubuf_mgr(upipe);
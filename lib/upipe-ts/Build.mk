@@ -54,6 +54,8 @@ libupipe_ts-src = \
     upipe_ts_align.c \
     upipe_ts_cat_decoder.c \
     upipe_ts_check.c \
+    upipe_ts_crc32.c \
+    upipe_ts_crc32.h \
     upipe_ts_decaps.c \
     upipe_ts_demux.c \
     upipe_ts_eit_decoder.c \
@@ -81,6 +83,8 @@ libupipe_ts-src = \
     upipe_ts_si_generator.c \
     upipe_ts_split.c \
     upipe_ts_sync.c \
+    upipe_ts_sync_scan.c \
+    upipe_ts_sync_scan.h \
     upipe_ts_tdt_decoder.c \
     upipe_ts_tot_decoder.c \
     upipe_ts_tstd.c \
@@ -26,6 +26,7 @@
 #include "upipe-ts/upipe_ts_cat_decoder.h"
 #include "upipe-ts/uref_ts_flow.h"
 #include "upipe_ts_psi_decoder.h"
+#include "upipe_ts_crc32.h"
 
 #include <bitstream/mpeg/psi/desc_09.h>
 
@@ -125,7 +126,7 @@ static bool upipe_ts_catd_table_validate(struct upipe *upipe)
                                                   &section))))
             return false;
 
-        if (!cat_validate(section) || !psi_check_crc(section)) {
+        if (!cat_validate(section) || !upipe_ts_crc32_check(section)) {
             uref_block_unmap(section_uref, 0);
             return false;
         }
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short Upipe CRC32/MPEG-2 computation for PSI sections
+ * This is a faster equivalent of psi_check_crc and psi_set_crc from
+ * <bitstream/mpeg/psi.h>, processing 8 octets per iteration.
+ */
+
+#ifndef _UPIPE_TS_UPIPE_TS_CRC32_H_
+/** @hidden */
+#define _UPIPE_TS_UPIPE_TS_CRC32_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include <bitstream/mpeg/psi.h>
+
+/** @This computes the CRC32/MPEG-2 of a buffer (polynomial 0x04C11DB7,
+ * MSB first, no final xor).
+ *
+ * @param crc initial value, 0xffffffff or the result of a previous call
+ * @param buf pointer to the buffer
+ * @param size size of the buffer in octets
+ * @return CRC32/MPEG-2 of the buffer
+ */
+uint32_t upipe_ts_crc32(uint32_t crc, const uint8_t *buf, size_t size);
+
+/** @This checks the CRC of a PSI section. The section length must have been
+ * validated beforehand.
+ *
+ * @param section pointer to the PSI section
+ * @return false if the CRC is wrong
+ */
+static inline bool upipe_ts_crc32_check(const uint8_t *section)
+{
+    /* the CRC of a message followed by its own CRC is 0 */
+    return !upipe_ts_crc32(0xffffffff, section,
+                           psi_get_length(section) + PSI_HEADER_SIZE);
+}
+
+/** @This computes and writes the CRC of a PSI section.
+ *
+ * @param section pointer to the PSI section
+ */
+static inline void upipe_ts_crc32_set(uint8_t *section)
+{
+    size_t end = psi_get_length(section) + PSI_HEADER_SIZE - PSI_CRC_SIZE;
+    uint32_t crc = upipe_ts_crc32(0xffffffff, section, end);
+    section[end] = crc >> 24;
+    section[end + 1] = crc >> 16;
+    section[end + 2] = crc >> 8;
+    section[end + 3] = crc;
+}
+
+#endif
@@ -9,6 +9,9 @@
 
 /** @file
  * @short Upipe module decapsulating (removing TS header) TS packets
+ *
+ * This module accepts either one TS packet per uref ("block.mpegts."), or
+ * vectors of aligned TS packets of the same PID ("block.mpegtsaligned.").
  */
 
 #include "upipe/uref.h"
@@ -32,6 +35,8 @@
 
 /** we only accept TS packets */
 #define EXPECTED_FLOW_DEF "block.mpegts."
+/** or vectors of aligned TS packets */
+#define EXPECTED_FLOW_DEF_ALIGNED "block.mpegtsaligned."
 
 /** @internal @This is the private context of a ts_decaps pipe. */
 struct upipe_ts_decaps {
@@ -51,6 +56,12 @@ struct upipe_ts_decaps {
     int8_t last_cc;
     /** last TS packet */
     struct uref *last_uref;
+    /** offset of the last payload in the vector being processed */
+    size_t last_offset;
+    /** size of the last payload in the vector being processed, or 0 */
+    size_t last_size;
+    /** true if the input carries vectors of TS packets */
+    bool aligned;
 
     /** lost packets based on cc errors */
     uint64_t lost;
@@ -87,130 +98,303 @@ static struct upipe *upipe_ts_decaps_alloc(struct upipe_mgr *mgr,
     upipe_ts_decaps->last_cc = -1;
     upipe_ts_decaps->lost = 0;
     upipe_ts_decaps->last_uref = NULL;
+    upipe_ts_decaps->last_offset = 0;
+    upipe_ts_decaps->last_size = 0;
+    upipe_ts_decaps->aligned = false;
     upipe_throw_ready(upipe);
     return upipe;
 }
 
-/** @internal @This parses and removes the TS header of a packet.
+/** @internal @This describes a TS packet being decapsulated. */
+struct upipe_ts_decaps_packet {
+    /** offset of the payload in the uref */
+    size_t offset;
+    /** continuity counter */
+    uint8_t cc;
+    /** true if the packet has a payload */
+    bool has_payload;
+    /** true if the transport error indicator is set */
+    bool transporterror;
+    /** true if the payload unit start indicator is set */
+    bool unitstart;
+    /** true if the packet is discontinuous */
+    bool discontinuity;
+    /** true if the random access indicator is set */
+    bool random;
+    /** PCR value, or UINT64_MAX */
+    uint64_t pcr;
+};
+
+/** @internal @This parses the TS header and adaptation field of a packet.
  *
  * @param upipe description structure of the pipe
  * @param uref uref structure
- * @param upump_p reference to pump that generated the buffer
+ * @param offset offset of the packet in the uref
+ * @param packet filled in with the description of the packet
+ * @return false if the packet must be dropped
  */
-static void upipe_ts_decaps_input(struct upipe *upipe, struct uref *uref,
-                                  struct upump **upump_p)
+static bool upipe_ts_decaps_parse(struct upipe *upipe, struct uref *uref,
+                                  size_t offset,
+                                  struct upipe_ts_decaps_packet *packet)
 {
     struct upipe_ts_decaps *upipe_ts_decaps = upipe_ts_decaps_from_upipe(upipe);
     uint8_t buffer[TS_HEADER_SIZE_PCR];
-    const uint8_t *ts_header = uref_block_peek(uref, 0, TS_HEADER_SIZE,
+    const uint8_t *ts_header = uref_block_peek(uref, offset, TS_HEADER_SIZE,
                                                buffer);
     if (unlikely(ts_header == NULL)) {
-        uref_free(uref);
         upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
-        return;
+        return false;
     }
-    bool transporterror = ts_get_transporterror(ts_header);
-    bool unitstart = ts_get_unitstart(ts_header);
-    uint8_t cc = ts_get_cc(ts_header);
-    bool has_payload = ts_has_payload(ts_header);
+    packet->transporterror = ts_get_transporterror(ts_header);
+    packet->unitstart = ts_get_unitstart(ts_header);
+    packet->cc = ts_get_cc(ts_header);
+    packet->has_payload = ts_has_payload(ts_header);
     bool has_adaptation = ts_has_adaptation(ts_header);
-    UBASE_FATAL(upipe, uref_block_peek_unmap(uref, 0, buffer, ts_header))
-    UBASE_FATAL(upipe, uref_block_resize(uref, TS_HEADER_SIZE, -1))
+    UBASE_FATAL(upipe, uref_block_peek_unmap(uref, offset, buffer, ts_header))
+    packet->offset = offset + TS_HEADER_SIZE;
+    packet->discontinuity = upipe_ts_decaps->last_cc == -1;
+    packet->random = false;
+    packet->pcr = UINT64_MAX;
 
-    bool discontinuity = upipe_ts_decaps->last_cc == -1;
-    bool random = false;
     if (unlikely(has_adaptation)) {
         uint8_t *af = buffer + TS_HEADER_SIZE;
-        if (unlikely(!ubase_check(uref_block_extract(uref, 0, 1, af)))) {
-            uref_free(uref);
+        if (unlikely(!ubase_check(uref_block_extract(uref, packet->offset, 1,
+                                                     af)))) {
             upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
-            return;
+            return false;
         }
         uint8_t af_length = af[0];
 
-        if (unlikely((!has_payload && af_length != 183) || af_length > 183)) {
+        if (unlikely((!packet->has_payload && af_length != 183) ||
+                     af_length > 183)) {
             upipe_warn(upipe, "invalid adaptation field received");
-            uref_free(uref);
-            return;
+            return false;
         }
 
         if (af_length) {
-            if (unlikely(!ubase_check(uref_block_extract(uref, 1, 1, af + 1)))) {
-                uref_free(uref);
+            if (unlikely(!ubase_check(uref_block_extract(uref,
+                                packet->offset + 1, 1, af + 1)))) {
                 upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
-                return;
+                return false;
             }
 
-            if (unlikely(!discontinuity && tsaf_has_discontinuity(buffer))) {
+            if (unlikely(!packet->discontinuity &&
+                         tsaf_has_discontinuity(buffer))) {
                 upipe_warn(upipe, "discontinuity flagged");
-                discontinuity = true;
+                packet->discontinuity = true;
             }
 
-            random = tsaf_has_randomaccess(buffer);
+            packet->random = tsaf_has_randomaccess(buffer);
 
             if (tsaf_has_pcr(buffer)) {
                 uint8_t *af_pcr = buffer + TS_HEADER_SIZE_AF;
-                const uint8_t *pcr = uref_block_peek(uref, 2,
+                const uint8_t *pcr = uref_block_peek(uref, packet->offset + 2,
                         TS_HEADER_SIZE_PCR - TS_HEADER_SIZE_AF, af_pcr);
                 if (unlikely(pcr == NULL)) {
-                    uref_free(uref);
                     upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
-                    return;
+                    return false;
                 }
                 uint64_t pcrval = (tsaf_get_pcr(pcr - TS_HEADER_SIZE_AF) * 300 +
                                    tsaf_get_pcrext(pcr - TS_HEADER_SIZE_AF));
                 pcrval *= UCLOCK_FREQ / 27000000;
-                UBASE_FATAL(upipe, uref_block_peek_unmap(uref, 2, af_pcr, pcr))
-
-                uref_clock_set_ref(uref);
-                upipe_throw_clock_ref(upipe, uref, pcrval,
-                                      discontinuity ? 1 : 0);
+                UBASE_FATAL(upipe, uref_block_peek_unmap(uref,
+                            packet->offset + 2, af_pcr, pcr))
+                packet->pcr = pcrval;
             }
         }
 
-        UBASE_FATAL(upipe, uref_block_resize(uref, af_length + 1, -1))
+        packet->offset += af_length + 1;
     }
+    return true;
+}
+
+/** @internal @This materializes the last payload, if it is still part of
+ * the vector being processed.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref vector being processed
+ */
+static void upipe_ts_decaps_sync_last(struct upipe *upipe, struct uref *uref)
+{
+    struct upipe_ts_decaps *upipe_ts_decaps = upipe_ts_decaps_from_upipe(upipe);
+    if (!upipe_ts_decaps->last_size)
+        return;
+
+    uref_free(upipe_ts_decaps->last_uref);
+    upipe_ts_decaps->last_uref = uref_block_splice(uref,
+            upipe_ts_decaps->last_offset, upipe_ts_decaps->last_size);
+    upipe_ts_decaps->last_size = 0;
+}
 
-    if (unlikely(ts_check_duplicate(cc, upipe_ts_decaps->last_cc))) {
-        if (!has_payload) {
+/** @internal @This checks the continuity counter of a packet.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref uref structure
+ * @param packet description of the packet
+ * @return false if the packet must be dropped
+ */
+static bool upipe_ts_decaps_check_cc(struct upipe *upipe, struct uref *uref,
+                                     struct upipe_ts_decaps_packet *packet)
+{
+    struct upipe_ts_decaps *upipe_ts_decaps = upipe_ts_decaps_from_upipe(upipe);
+    if (unlikely(ts_check_duplicate(packet->cc, upipe_ts_decaps->last_cc))) {
+        if (!packet->has_payload) {
             /* padding or just PCR */
-            uref_free(uref);
-            return;
+            return false;
         }
+        upipe_ts_decaps_sync_last(upipe, uref);
         if (upipe_ts_decaps->last_uref != NULL &&
-            ubase_check(uref_block_compare(uref, 0,
+            ubase_check(uref_block_compare(uref, packet->offset,
                                            upipe_ts_decaps->last_uref))) {
             upipe_verbose(upipe, "removing duplicate packet");
-            uref_free(uref);
-            return;
+            return false;
         }
         upipe_warn_va(upipe, "potentially lost 16 packets");
         upipe_ts_decaps->lost += 16;
-        discontinuity = true;
+        packet->discontinuity = true;
     }
 
-    if (unlikely(!discontinuity &&
-                 ts_check_discontinuity(cc, upipe_ts_decaps->last_cc))) {
-        int lost = (0x10 + cc - upipe_ts_decaps->last_cc - 1) & 0xf;
+    if (unlikely(!packet->discontinuity &&
+                 ts_check_discontinuity(packet->cc,
+                                        upipe_ts_decaps->last_cc))) {
+        int lost = (0x10 + packet->cc - upipe_ts_decaps->last_cc - 1) & 0xf;
         upipe_ts_decaps->lost += lost;
         upipe_warn_va(upipe, "potentially lost %d packets", lost);
-        discontinuity = true;
-    }
-    upipe_ts_decaps->last_cc = cc;
-
-    if (unlikely(!has_payload)) {
-        uref_free(uref);
-        return;
+        packet->discontinuity = true;
     }
+    upipe_ts_decaps->last_cc = packet->cc;
+    return packet->has_payload;
+}
 
-    if (unlikely(discontinuity))
+/** @internal @This sets the flags of a payload.
+ *
+ * @param uref payload
+ * @param packet description of the packet
+ */
+static void upipe_ts_decaps_set_flags(struct uref *uref,
+                                      struct upipe_ts_decaps_packet *packet)
+{
+    if (unlikely(packet->discontinuity))
         uref_flow_set_discontinuity(uref);
-    if (unlikely(random))
+    if (unlikely(packet->random))
         uref_flow_set_random(uref);
-    if (unlikely(unitstart))
+    if (unlikely(packet->unitstart))
         uref_block_set_start(uref);
-    if (unlikely(transporterror))
+    if (unlikely(packet->transporterror))
         uref_flow_set_error(uref);
+}
+
+/** @internal @This decapsulates a vector of aligned TS packets. The payloads
+ * of consecutive packets are gathered into a single uref, unless a packet
+ * carries a flag or a PCR.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref uref structure
+ * @param size size of the uref
+ * @param upump_p reference to pump that generated the buffer
+ */
+static void upipe_ts_decaps_input_vector(struct upipe *upipe,
+                                         struct uref *uref, size_t size,
+                                         struct upump **upump_p)
+{
+    struct upipe_ts_decaps *upipe_ts_decaps = upipe_ts_decaps_from_upipe(upipe);
+    struct uref *output = NULL;
+    if (unlikely(size % TS_SIZE))
+        upipe_warn_va(upipe, "dropping %zu trailing octets", size % TS_SIZE);
+
+    for (size_t offset = 0; offset + TS_SIZE <= size; offset += TS_SIZE) {
+        struct upipe_ts_decaps_packet packet;
+        if (!upipe_ts_decaps_parse(upipe, uref, offset, &packet))
+            continue;
+
+        if (packet.pcr != UINT64_MAX) {
+            if (output != NULL) {
+                upipe_ts_decaps_output(upipe, output, upump_p);
+                output = NULL;
+            }
+            uref_clock_set_ref(uref);
+            upipe_throw_clock_ref(upipe, uref, packet.pcr,
+                                  packet.discontinuity ? 1 : 0);
+            uref_clock_delete_ref(uref);
+        }
+
+        if (!upipe_ts_decaps_check_cc(upipe, uref, &packet))
+            continue;
+
+        size_t payload_size = offset + TS_SIZE - packet.offset;
+        if (unlikely(!payload_size))
+            continue;
+        if (output != NULL && !packet.discontinuity && !packet.random &&
+            !packet.unitstart && !packet.transporterror) {
+            struct ubuf *ubuf = ubuf_block_splice(uref->ubuf, packet.offset,
+                                                  payload_size);
+            if (unlikely(ubuf == NULL ||
+                         !ubase_check(uref_block_append(output, ubuf)))) {
+                ubuf_free(ubuf);
+                upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+                continue;
+            }
+        } else {
+            if (output != NULL)
+                upipe_ts_decaps_output(upipe, output, upump_p);
+            output = uref_block_splice(uref, packet.offset, payload_size);
+            if (unlikely(output == NULL)) {
+                upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+                continue;
+            }
+            upipe_ts_decaps_set_flags(output, &packet);
+            if (packet.pcr != UINT64_MAX)
+                uref_clock_set_ref(output);
+        }
+        upipe_ts_decaps->last_offset = packet.offset;
+        upipe_ts_decaps->last_size = payload_size;
+    }
+
+    upipe_ts_decaps_sync_last(upipe, uref);
+    uref_free(uref);
+    if (output != NULL)
+        upipe_ts_decaps_output(upipe, output, upump_p);
+}
+
+/** @internal @This parses and removes the TS header of a packet.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref uref structure
+ * @param upump_p reference to pump that generated the buffer
+ */
+static void upipe_ts_decaps_input(struct upipe *upipe, struct uref *uref,
+                                  struct upump **upump_p)
+{
+    struct upipe_ts_decaps *upipe_ts_decaps = upipe_ts_decaps_from_upipe(upipe);
+    if (upipe_ts_decaps->aligned) {
+        size_t size;
+        if (unlikely(!ubase_check(uref_block_size(uref, &size)))) {
+            uref_free(uref);
+            upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+            return;
+        }
+        upipe_ts_decaps_input_vector(upipe, uref, size, upump_p);
+        return;
+    }
+
+    struct upipe_ts_decaps_packet packet;
+    if (unlikely(!upipe_ts_decaps_parse(upipe, uref, 0, &packet))) {
+        uref_free(uref);
+        return;
+    }
+
+    if (packet.pcr != UINT64_MAX) {
+        uref_clock_set_ref(uref);
+        upipe_throw_clock_ref(upipe, uref, packet.pcr,
+                              packet.discontinuity ? 1 : 0);
+    }
+
+    if (!upipe_ts_decaps_check_cc(upipe, uref, &packet)) {
+        uref_free(uref);
+        return;
+    }
+    UBASE_FATAL(upipe, uref_block_resize(uref, packet.offset, -1))
+    upipe_ts_decaps_set_flags(uref, &packet);
 
     uref_free(upipe_ts_decaps->last_uref);
     upipe_ts_decaps->last_uref = uref_dup(uref);
@@ -230,7 +414,8 @@ static int upipe_ts_decaps_set_flow_def(struct upipe *upipe,
         return UBASE_ERR_INVALID;
     const char *def;
     UBASE_RETURN(uref_flow_get_def(flow_def, &def))
-    if (ubase_ncmp(def, EXPECTED_FLOW_DEF))
+    bool aligned = !ubase_ncmp(def, EXPECTED_FLOW_DEF_ALIGNED);
+    if (!aligned && ubase_ncmp(def, EXPECTED_FLOW_DEF))
         return UBASE_ERR_INVALID;
     struct uref *flow_def_dup;
     if (unlikely((flow_def_dup = uref_dup(flow_def)) == NULL)) {
@@ -238,8 +423,11 @@ static int upipe_ts_decaps_set_flow_def(struct upipe *upipe,
         return UBASE_ERR_ALLOC;
     }
     if (unlikely(!ubase_check(uref_flow_set_def_va(flow_def_dup, "block.%s",
-                                       def + strlen(EXPECTED_FLOW_DEF)))))
+                    def + (aligned ? strlen(EXPECTED_FLOW_DEF_ALIGNED) :
+                                     strlen(EXPECTED_FLOW_DEF))))))
         upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+    struct upipe_ts_decaps *upipe_ts_decaps = upipe_ts_decaps_from_upipe(upipe);
+    upipe_ts_decaps->aligned = aligned;
     upipe_ts_decaps_store_flow_def(upipe, flow_def_dup);
     return UBASE_ERR_NONE;
 }
@@ -55,6 +55,7 @@
 #include "upipe-modules/upipe_idem.h"
 #include "upipe-modules/upipe_setflowdef.h"
 #include "upipe-modules/upipe_probe_uref.h"
+#include "upipe-modules/upipe_worker_linear.h"
 #include "upipe-ts/uref_ts_flow.h"
 #include "upipe-ts/uref_ts_event.h"
 #include "upipe-ts/upipe_ts_demux.h"
@@ -96,6 +97,10 @@
 #define EXPECTED_FLOW_DEF_SYNC "block.mpegts."
 /** or otherwise aligned TS packets to check */
 #define EXPECTED_FLOW_DEF_CHECK "block.mpegtsaligned."
+/** flow definition of elementary streams split from the TS */
+#define OUTPUT_FLOW_DEF_SPLIT "block.mpegts."
+/** or in batch mode */
+#define OUTPUT_FLOW_DEF_SPLIT_ALIGNED "block.mpegtsaligned."
 /** maximum number of PIDs */
 #define MAX_PIDS 8192
 /** 2^33 (max resolution of PCR, PTS and DTS) */
@@ -115,6 +120,8 @@
 #define EITS_TABLEIDS 16
 /** teletext frame rate */
 #define TELX_FPS 25
+/** length of the queues to and from worker threads */
+#define WORKER_QUEUE_LENGTH 255
 
 #define UPIPE_TS_DEMUX_EMM_SIGNATURE UBASE_FOURCC('t','s','d','M')
 
@@ -283,8 +290,18 @@ struct upipe_ts_demux {
     bool eit_enabled;
     /** enable EITs table ID decoder */
     bool eits_enabled;
+    /** drop repeated SI sections before the decoders */
+    bool psi_cache;
     /** maximum allowed interval between PCRs */
     uint64_t max_pcr_interval;
+    /** maximum number of TS packets per uref in the front end */
+    unsigned int batch;
+    /** list of worker threads framing the programs */
+    struct uchain workers;
+    /** number of worker threads */
+    unsigned int nb_workers;
+    /** number of programs assigned to worker threads */
+    unsigned int worker_index;
 
     /** probe to get new flow events from inner pipes created by psi_pid
      * objects */
@@ -400,6 +417,8 @@ struct upipe_ts_demux_program {
     uint16_t pcr_pid;
     /** PCR ts_split output inner pipe */
     struct upipe *pcr_split_output;
+    /** worker thread framing the elementary streams, or NULL */
+    struct upipe_ts_demux_worker *worker;
 
     /** offset between MPEG timestamps and Upipe timestamps */
     int64_t timestamp_offset;
@@ -598,6 +617,18 @@ struct upipe_ts_demux_psi_pid {
 
 UBASE_FROM_TO(upipe_ts_demux_psi_pid, uchain, uchain, uchain)
 
+/** @internal @This checks if repeated sections may be dropped on a PID, that
+ * is if its decoders do not rely on repetitions (as the PAT and PMT decoders
+ * do to signal random access points).
+ *
+ * @param pid PID
+ * @return true if the section cache may be enabled
+ */
+static inline bool upipe_ts_demux_psi_pid_cacheable(uint16_t pid)
+{
+    return pid == NIT_PID || pid == SDT_PID || pid == EIT_PID;
+}
+
 /** @internal @This allocates and initializes a new PID-specific
  * substructure.
  *
@@ -644,6 +675,8 @@ static struct upipe_ts_demux_psi_pid *
         free(psi_pid);
         return NULL;
     }
+    if (upipe_ts_demux->psi_cache && upipe_ts_demux_psi_pid_cacheable(pid))
+        upipe_ts_psi_split_set_cache(psi_pid->psi_split, true);
 
     uref_flow_set_def(flow_def, "block.mpegts.mpegtspsi.");
     psi_pid->split_output =
@@ -725,6 +758,83 @@ static void
     }
 }
 
+/** @internal @This is the context of a worker thread of a ts_demux pipe. */
+struct upipe_ts_demux_worker {
+    /** structure for double-linked lists */
+    struct uchain uchain;
+    /** manager of linear worker pipes running on the thread */
+    struct upipe_mgr *wlin_mgr;
+    /** probe hierarchy to use on the thread */
+    struct uprobe *uprobe;
+};
+
+UBASE_FROM_TO(upipe_ts_demux_worker, uchain, uchain, uchain)
+
+/** @internal @This adds a worker thread to frame the elementary streams of
+ * the programs allocated afterwards.
+ *
+ * @param upipe description structure of the pipe
+ * @param wlin_mgr manager of linear worker pipes running on the thread
+ * @param uprobe probe hierarchy to use on the thread
+ * @return an error code
+ */
+static int upipe_ts_demux_worker_add(struct upipe *upipe,
+                                     struct upipe_mgr *wlin_mgr,
+                                     struct uprobe *uprobe)
+{
+    struct upipe_ts_demux *upipe_ts_demux = upipe_ts_demux_from_upipe(upipe);
+    if (unlikely(wlin_mgr == NULL || uprobe == NULL))
+        return UBASE_ERR_INVALID;
+
+    struct upipe_ts_demux_worker *worker =
+        malloc(sizeof(struct upipe_ts_demux_worker));
+    UBASE_ALLOC_RETURN(worker)
+    worker->wlin_mgr = upipe_mgr_use(wlin_mgr);
+    worker->uprobe = uprobe_use(uprobe);
+    uchain_init(upipe_ts_demux_worker_to_uchain(worker));
+    ulist_add(&upipe_ts_demux->workers,
+              upipe_ts_demux_worker_to_uchain(worker));
+    upipe_ts_demux->nb_workers++;
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This picks the worker thread of a new program, in a
+ * round-robin fashion.
+ *
+ * @param upipe description structure of the pipe
+ * @return pointer to the worker, or NULL if there is no worker thread
+ */
+static struct upipe_ts_demux_worker *
+    upipe_ts_demux_worker_next(struct upipe *upipe)
+{
+    struct upipe_ts_demux *upipe_ts_demux = upipe_ts_demux_from_upipe(upipe);
+    if (!upipe_ts_demux->nb_workers)
+        return NULL;
+    struct uchain *uchain =
+        ulist_at(&upipe_ts_demux->workers,
+                 upipe_ts_demux->worker_index++ % upipe_ts_demux->nb_workers);
+    return upipe_ts_demux_worker_from_uchain(uchain);
+}
+
+/** @internal @This frees all worker threads.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_ts_demux_worker_clean(struct upipe *upipe)
+{
+    struct upipe_ts_demux *upipe_ts_demux = upipe_ts_demux_from_upipe(upipe);
+    struct uchain *uchain, *uchain_tmp;
+    ulist_delete_foreach(&upipe_ts_demux->workers, uchain, uchain_tmp) {
+        struct upipe_ts_demux_worker *worker =
+            upipe_ts_demux_worker_from_uchain(uchain);
+        ulist_delete(uchain);
+        upipe_mgr_release(worker->wlin_mgr);
+        uprobe_release(worker->uprobe);
+        free(worker);
+    }
+    upipe_ts_demux->nb_workers = 0;
+}
+
 
 /*
  * upipe_ts_demux_output structure handling (derived from upipe structure)
@@ -832,6 +942,25 @@ static int upipe_ts_demux_output_clock_ts(struct upipe *upipe,
     return upipe_throw(upipe, event, uref);
 }
 
+/** @internal @This converts the flow definition of an elementary stream
+ * so that ts_split outputs vectors of TS packets, in batch mode.
+ *
+ * @param demux ts_demux structure
+ * @param flow_def flow definition packet to modify
+ * @return an error code
+ */
+static int upipe_ts_demux_batch_flow_def(struct upipe_ts_demux *demux,
+                                         struct uref *flow_def)
+{
+    const char *def;
+    if (demux->batch <= 1 ||
+        !ubase_check(uref_flow_get_def(flow_def, &def)) ||
+        ubase_ncmp(def, OUTPUT_FLOW_DEF_SPLIT))
+        return UBASE_ERR_NONE;
+    return uref_flow_set_def_va(flow_def, OUTPUT_FLOW_DEF_SPLIT_ALIGNED "%s",
+                                def + strlen(OUTPUT_FLOW_DEF_SPLIT));
+}
+
 /** @internal @This catches need_output events coming from output inner pipes.
  *
  * @param upipe description structure of the pipe
@@ -858,7 +987,8 @@ static int upipe_ts_demux_output_plumber(struct upipe *upipe,
     if (!uprobe_plumber(event, args, &flow_def, &def))
         return upipe_throw_proxy(upipe, inner, event, args);
 
-    if (!ubase_ncmp(def, "block.mpegts.")) {
+    if (!ubase_ncmp(def, OUTPUT_FLOW_DEF_SPLIT) ||
+        !ubase_ncmp(def, OUTPUT_FLOW_DEF_SPLIT_ALIGNED)) {
         /* allocate ts_decaps inner */
         if (unlikely(upipe_ts_demux_output->decaps == NULL)) {
             upipe_release(upipe_ts_demux_output->setrap);
@@ -935,6 +1065,48 @@ static int upipe_ts_demux_output_plumber(struct upipe *upipe,
         upipe_release(inner);
     }
 
+    if (ts_demux_mgr->autof_mgr != NULL && program->worker != NULL) {
+        /* allocate autof inner on the worker thread of the program */
+        struct upipe_ts_demux_worker *worker = program->worker;
+        struct upipe *autof =
+            upipe_void_alloc(ts_demux_mgr->autof_mgr,
+                uprobe_pfx_alloc_va(uprobe_use(worker->uprobe),
+                                    UPROBE_LOG_VERBOSE, "autof %"PRIu64,
+                                    upipe_ts_demux_output->pid));
+        if (unlikely(autof == NULL))
+            return UBASE_ERR_ALLOC;
+
+        struct upipe *output =
+            upipe_wlin_alloc(worker->wlin_mgr,
+                uprobe_pfx_alloc(
+                    uprobe_use(&upipe_ts_demux_output->last_inner_probe),
+                    UPROBE_LOG_VERBOSE, "autof worker"),
+                autof,
+                uprobe_pfx_alloc_va(uprobe_use(worker->uprobe),
+                                    UPROBE_LOG_VERBOSE, "autof remote %"PRIu64,
+                                    upipe_ts_demux_output->pid),
+                WORKER_QUEUE_LENGTH, WORKER_QUEUE_LENGTH);
+        if (unlikely(output == NULL))
+            return UBASE_ERR_ALLOC;
+        int err = upipe_set_output(inner, output);
+        if (unlikely(!ubase_check(err))) {
+            upipe_release(output);
+            return err;
+        }
+
+        /* allocate probe_uref to watch pts on this thread */
+        output = upipe_void_chain_output(
+            output, ts_demux_mgr->probe_uref_mgr,
+            uprobe_pfx_alloc(
+                uprobe_use(&upipe_ts_demux_output->timestamp_probe),
+                UPROBE_LOG_VERBOSE, "autof probe"));
+        if (unlikely(output == NULL))
+            return UBASE_ERR_ALLOC;
+
+        upipe_ts_demux_output_store_bin_output(upipe, output);
+        return UBASE_ERR_NONE;
+    }
+
     if (ts_demux_mgr->autof_mgr != NULL) {
         /* allocate autof inner */
         struct upipe *output =
@@ -1163,15 +1335,26 @@ static struct upipe *upipe_ts_demux_output_alloc(struct upipe_mgr *mgr,
 
     struct upipe_ts_demux_mgr *ts_demux_mgr =
         upipe_ts_demux_mgr_from_upipe_mgr(upipe_ts_demux_to_upipe(demux)->mgr);
+    struct uref *flow_def_split = uref_dup(flow_def);
+    if (unlikely(flow_def_split == NULL ||
+                 !ubase_check(upipe_ts_demux_batch_flow_def(demux,
+                                                            flow_def_split)))) {
+        uref_free(flow_def_split);
+        upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+        return upipe;
+    }
+
     /* set up split_output and set rap inner pipes */
-    if (unlikely((upipe_ts_demux_output->split_output =
-                    upipe_flow_alloc_sub(
-                        demux->split,
-                        uprobe_pfx_alloc_va(
-                            uprobe_use(&upipe_ts_demux_output->probe),
-                            UPROBE_LOG_VERBOSE,
-                            "split output %"PRIu64, upipe_ts_demux_output->pid),
-                        flow_def)) == NULL ||
+    upipe_ts_demux_output->split_output =
+        upipe_flow_alloc_sub(demux->split,
+                             uprobe_pfx_alloc_va(
+                                 uprobe_use(&upipe_ts_demux_output->probe),
+                                 UPROBE_LOG_VERBOSE,
+                                 "split output %"PRIu64,
+                                 upipe_ts_demux_output->pid),
+                             flow_def_split);
+    uref_free(flow_def_split);
+    if (unlikely(upipe_ts_demux_output->split_output == NULL ||
                  (upipe_ts_demux_output->setrap =
                     upipe_void_alloc_output(upipe_ts_demux_output->split_output,
                                ts_demux_mgr->setrap_mgr,
@@ -1204,6 +1387,10 @@ static bool upipe_ts_demux_output_pmtd_update(struct upipe *upipe,
     struct upipe_ts_demux_output *upipe_ts_demux_output =
         upipe_ts_demux_output_from_upipe(upipe);
     if (likely(upipe_ts_demux_output->setrap != NULL)) {
+        struct upipe_ts_demux_program *program =
+            upipe_ts_demux_program_from_output_mgr(upipe->mgr);
+        struct upipe_ts_demux *demux = upipe_ts_demux_from_program_mgr(
+                    upipe_ts_demux_program_to_upipe(program)->mgr);
         struct uref *flow_def = uref_dup(flow_def_pmtd);
         if (unlikely(flow_def == NULL)) {
             upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
@@ -1213,7 +1400,9 @@ static bool upipe_ts_demux_output_pmtd_update(struct upipe *upipe,
         const char *def;
         if (unlikely(!ubase_check(uref_flow_get_raw_def(flow_def_pmtd, &def)) ||
                      !ubase_check(uref_flow_set_def(flow_def, def)) ||
-                     !ubase_check(uref_flow_delete_raw_def(flow_def)))) {
+                     !ubase_check(uref_flow_delete_raw_def(flow_def)) ||
+                     !ubase_check(upipe_ts_demux_batch_flow_def(demux,
+                                                                flow_def)))) {
             uref_free(flow_def);
             upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
             return false;
@@ -2214,6 +2403,8 @@ static struct upipe *upipe_ts_demux_program_alloc(struct upipe_mgr *mgr,
     upipe_ts_demux_program->pmt_rap = 0;
     upipe_ts_demux_program->pcr_pid = 0;
     upipe_ts_demux_program->pcr_split_output = NULL;
+    upipe_ts_demux_program->worker =
+        upipe_ts_demux_worker_next(upipe_ts_demux_to_upipe(demux));
     upipe_ts_demux_program->psi_pid_pmt =
         upipe_ts_demux_program->psi_pid_eit =
         upipe_ts_demux_program->psi_pid_ecm = NULL;
@@ -3695,7 +3886,12 @@ static struct upipe *upipe_ts_demux_alloc(struct upipe_mgr *mgr,
     upipe_ts_demux->auto_conformance = true;
     upipe_ts_demux->eit_enabled = true;
     upipe_ts_demux->eits_enabled = true;
+    upipe_ts_demux->psi_cache = true;
     upipe_ts_demux->max_pcr_interval = MAX_PCR_INTERVAL;
+    upipe_ts_demux->batch = 1;
+    ulist_init(&upipe_ts_demux->workers);
+    upipe_ts_demux->nb_workers = 0;
+    upipe_ts_demux->worker_index = 0;
     upipe_ts_demux->nit_pid = 0;
     upipe_ts_demux->flow_def_input = NULL;
 
@@ -3862,7 +4058,9 @@ static int upipe_ts_demux_set_flow_def(struct upipe *upipe,
     struct upipe_ts_demux_mgr *ts_demux_mgr =
         upipe_ts_demux_mgr_from_upipe_mgr(upipe->mgr);
     struct upipe *input;
-    if (ubase_ncmp(def, EXPECTED_FLOW_DEF_SYNC)) {
+    if (ubase_ncmp(def, EXPECTED_FLOW_DEF_SYNC) &&
+        (upipe_ts_demux->batch <= 1 ||
+         ubase_ncmp(def, EXPECTED_FLOW_DEF_CHECK))) {
         if (!ubase_ncmp(def, EXPECTED_FLOW_DEF_CHECK))
             /* allocate ts_check inner pipe */
             input = upipe_void_alloc(ts_demux_mgr->ts_check_mgr,
@@ -3879,10 +4077,14 @@ static int upipe_ts_demux_set_flow_def(struct upipe *upipe,
             upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
             return UBASE_ERR_ALLOC;
         }
+        if (upipe_ts_demux->batch > 1 &&
+            ubase_ncmp(def, EXPECTED_FLOW_DEF_CHECK))
+            upipe_ts_sync_set_batch(input, upipe_ts_demux->batch);
         upipe_ts_demux_store_bin_input(upipe, input);
         upipe_set_output(input, upipe_ts_demux->setrap);
 
     } else {
+        /* in batch mode, aligned packets are checked by ts_split */
         upipe_ts_demux_store_bin_input(upipe,
                                          upipe_use(upipe_ts_demux->setrap));
         upipe_ts_demux_sync_acquired(upipe);
@@ -3988,6 +4190,53 @@ static int _upipe_ts_demux_set_eits_enabled(struct upipe *upipe,
     return UBASE_ERR_NONE;
 }
 
+/** @internal @This enables or disables the section cache on SI PIDs.
+ *
+ * @param upipe description structure of the pipe
+ * @param enabled true to drop repeated sections, false otherwise
+ * @return an error code
+ */
+static int _upipe_ts_demux_set_psi_cache(struct upipe *upipe, bool enabled)
+{
+    struct upipe_ts_demux *upipe_ts_demux = upipe_ts_demux_from_upipe(upipe);
+    upipe_ts_demux->psi_cache = enabled;
+
+    struct uchain *uchain;
+    ulist_foreach (&upipe_ts_demux->psi_pids, uchain) {
+        struct upipe_ts_demux_psi_pid *psi_pid =
+            upipe_ts_demux_psi_pid_from_uchain(uchain);
+        if (upipe_ts_demux_psi_pid_cacheable(psi_pid->pid))
+            UBASE_RETURN(upipe_ts_psi_split_set_cache(psi_pid->psi_split,
+                                                      enabled))
+    }
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This returns the number of sections dropped by the section
+ * cache on the SI PIDs.
+ *
+ * @param upipe description structure of the pipe
+ * @param hits_p filled in with the number of cache hits
+ * @return an error code
+ */
+static int _upipe_ts_demux_get_psi_cache_hits(struct upipe *upipe,
+                                              uint64_t *hits_p)
+{
+    struct upipe_ts_demux *upipe_ts_demux = upipe_ts_demux_from_upipe(upipe);
+    *hits_p = 0;
+
+    struct uchain *uchain;
+    ulist_foreach (&upipe_ts_demux->psi_pids, uchain) {
+        struct upipe_ts_demux_psi_pid *psi_pid =
+            upipe_ts_demux_psi_pid_from_uchain(uchain);
+        uint64_t hits;
+        UBASE_RETURN(upipe_ts_psi_split_get_cache_hits(psi_pid->psi_split,
+                                                       &hits))
+        *hits_p += hits;
+    }
+    return UBASE_ERR_NONE;
+}
+
 /** @internal @This sets the maximum allow interval between PCRs.
  *
  * @param upipe description structure of the pipe
@@ -4026,6 +4275,42 @@ static int _upipe_ts_demux_get_max_pcr_interval(struct upipe *upipe,
     return UBASE_ERR_NONE;
 }
 
+/** @internal @This sets the maximum number of TS packets per uref in the
+ * front end of the demux.
+ *
+ * @param upipe description structure of the pipe
+ * @param batch number of packets, 1 to disable batch mode
+ * @return an error code
+ */
+static int _upipe_ts_demux_set_batch(struct upipe *upipe, unsigned int batch)
+{
+    struct upipe_ts_demux *demux = upipe_ts_demux_from_upipe(upipe);
+    if (!batch)
+        return UBASE_ERR_INVALID;
+    if (demux->flow_def_input != NULL) {
+        upipe_warn(upipe, "batch mode must be set before the flow definition");
+        return UBASE_ERR_BUSY;
+    }
+    demux->batch = batch;
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This returns the maximum number of TS packets per uref in the
+ * front end of the demux.
+ *
+ * @param upipe description structure of the pipe
+ * @param batch_p filled in with the number of packets
+ * @return an error code
+ */
+static int _upipe_ts_demux_get_batch(struct upipe *upipe,
+                                     unsigned int *batch_p)
+{
+    struct upipe_ts_demux *demux = upipe_ts_demux_from_upipe(upipe);
+    if (batch_p)
+        *batch_p = demux->batch;
+    return UBASE_ERR_NONE;
+}
+
 /** @internal @This processes control commands on a ts_demux pipe.
  *
  * @param upipe description structure of the pipe
@@ -4103,6 +4388,16 @@ static int upipe_ts_demux_control(struct upipe *upipe,
             int enabled = va_arg(args, int);
             return _upipe_ts_demux_set_eits_enabled(upipe, !!enabled);
         }
+        case UPIPE_TS_DEMUX_SET_PSI_CACHE: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_TS_DEMUX_SIGNATURE);
+            int enabled = va_arg(args, int);
+            return _upipe_ts_demux_set_psi_cache(upipe, !!enabled);
+        }
+        case UPIPE_TS_DEMUX_GET_PSI_CACHE_HITS: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_TS_DEMUX_SIGNATURE);
+            uint64_t *hits_p = va_arg(args, uint64_t *);
+            return _upipe_ts_demux_get_psi_cache_hits(upipe, hits_p);
+        }
         case UPIPE_TS_DEMUX_SET_MAX_PCR_INTERVAL: {
             UBASE_SIGNATURE_CHECK(args, UPIPE_TS_DEMUX_SIGNATURE);
             uint64_t max = va_arg(args, uint64_t);
@@ -4113,6 +4408,22 @@ static int upipe_ts_demux_control(struct upipe *upipe,
             uint64_t *max = va_arg(args, uint64_t *);
             return _upipe_ts_demux_get_max_pcr_interval(upipe, max);
         }
+        case UPIPE_TS_DEMUX_SET_BATCH: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_TS_DEMUX_SIGNATURE);
+            unsigned int batch = va_arg(args, unsigned int);
+            return _upipe_ts_demux_set_batch(upipe, batch);
+        }
+        case UPIPE_TS_DEMUX_GET_BATCH: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_TS_DEMUX_SIGNATURE);
+            unsigned int *batch_p = va_arg(args, unsigned int *);
+            return _upipe_ts_demux_get_batch(upipe, batch_p);
+        }
+        case UPIPE_TS_DEMUX_ADD_WORKER: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_TS_DEMUX_SIGNATURE);
+            struct upipe_mgr *wlin_mgr = va_arg(args, struct upipe_mgr *);
+            struct uprobe *uprobe = va_arg(args, struct uprobe *);
+            return upipe_ts_demux_worker_add(upipe, wlin_mgr, uprobe);
+        }
 
         default:
             break;
@@ -4143,6 +4454,7 @@ static void upipe_ts_demux_free(struct urefcount *urefcount_real)
     uref_free(upipe_ts_demux->flow_def_input);
     upipe_ts_demux_clean_sub_emms(upipe);
     upipe_ts_demux_clean_sub_programs(upipe);
+    upipe_ts_demux_worker_clean(upipe);
     upipe_ts_demux_clean_sync(upipe);
     upipe_ts_demux_clean_uref_mgr(upipe);
     urefcount_clean(urefcount_real);
@@ -28,6 +28,7 @@
 #include "upipe-ts/upipe_ts_emm_decoder.h"
 #include "upipe-ts/uref_ts_flow.h"
 #include "upipe_ts_psi_decoder.h"
+#include "upipe_ts_crc32.h"
 
 #include <bitstream/ebu/biss.h>
 
@@ -235,7 +236,7 @@ static bool upipe_ts_emmd_table_validate(struct upipe *upipe)
                                                   &section))))
             return false;
 
-        if (!bissca_emm_validate(section) || !psi_check_crc(section)) {
+        if (!bissca_emm_validate(section) || !upipe_ts_crc32_check(section)) {
             uref_block_unmap(section_uref, 0);
             return false;
         }
@@ -1050,7 +1051,7 @@ static bool upipe_ts_emmd_ecm_table_validate(struct upipe *upipe)
                                                   &section))))
             return false;
 
-        if (/*!ecm_validate(section) || */!psi_check_crc(section)) {
+        if (/*!ecm_validate(section) || */!upipe_ts_crc32_check(section)) {
             uref_block_unmap(section_uref, 0);
             return false;
         }
@@ -8,6 +8,10 @@
 
 /** @file
  * @short Upipe module encapsulating (adding TS header) PES and PSI access units
+ *
+ * With a "block.mpegts." input flow definition, the module instead passes
+ * through already packetized TS packets, only rewriting the PID and the
+ * continuity counter, and optionally restamping the PCR.
  */
 
 #include "upipe/ubase.h"
@@ -43,6 +47,8 @@
 #define EXPECTED_FLOW_DEF "block."
 /** flow definition for PSI */
 #define FLOW_DEF_PSI "block.mpegtspsi."
+/** flow definition for TS packets passed through */
+#define FLOW_DEF_PASSTHROUGH "block.mpegts."
 /** 2^33 (max resolution of PCR, PTS and DTS) */
 #define POW2_33 UINT64_C(8589934592)
 /** ratio between Upipe freq and MPEG PES freq */
@@ -115,6 +121,12 @@ struct upipe_ts_encaps {
     uint64_t max_delay;
     /** true if we chop PSI sections */
     bool psi;
+    /** true if we pass through TS packets */
+    bool passthrough;
+    /** true if PCRs of passed-through packets are restamped */
+    bool pcr_restamp;
+    /** last continuity counter of passed-through packets */
+    uint8_t passthrough_cc;
 
     /** PCR interval (or 0) */
     uint64_t pcr_interval;
@@ -210,6 +222,9 @@ static struct upipe *upipe_ts_encaps_alloc(struct upipe_mgr *mgr,
     upipe_ts_encaps->tb_rate = 0;
     upipe_ts_encaps->max_delay = T_STD_MAX_RETENTION;
     upipe_ts_encaps->psi = false;
+    upipe_ts_encaps->passthrough = false;
+    upipe_ts_encaps->pcr_restamp = false;
+    upipe_ts_encaps->passthrough_cc = UINT8_MAX;
     upipe_ts_encaps->pcr_interval = 0;
     upipe_ts_encaps->pes_id = 0;
     upipe_ts_encaps->pes_header_size = 0;
@@ -252,11 +267,17 @@ static void upipe_ts_encaps_update_status(struct upipe *upipe)
     if (encaps->uref == NULL)
         goto upipe_ts_encaps_update_status_pcr;
 
-    cr_sys = encaps->uref_cr_sys -
-            (uint64_t)encaps->uref_size * UCLOCK_FREQ / encaps->octetrate;
-    if (encaps->uref_dts_sys != UINT64_MAX)
-        dts_sys = encaps->uref_dts_sys -
-            (uint64_t)encaps->uref_size * UCLOCK_FREQ / encaps->tb_rate;
+    if (encaps->passthrough) {
+        /* keep the timing of the original multiplex */
+        cr_sys = encaps->uref_cr_sys;
+        dts_sys = encaps->uref_dts_sys;
+    } else {
+        cr_sys = encaps->uref_cr_sys -
+                (uint64_t)encaps->uref_size * UCLOCK_FREQ / encaps->octetrate;
+        if (encaps->uref_dts_sys != UINT64_MAX)
+            dts_sys = encaps->uref_dts_sys -
+                (uint64_t)encaps->uref_size * UCLOCK_FREQ / encaps->tb_rate;
+    }
     uint64_t tb_buffer = encaps->tb_buffer;
 
     if (encaps->last_splice < cr_sys) {
@@ -277,7 +298,7 @@ static void upipe_ts_encaps_update_status(struct upipe *upipe)
             if (unlikely(cr_sys > dts_sys))
                 cr_sys = dts_sys;
         }
-    } else {
+    } else if (!encaps->passthrough) {
         /* Move forward the buffer wrt. the TB buffer. */
         int64_t tb_diff = (uint64_t)(tb_buffer - (TS_SIZE - TS_HEADER_SIZE)) *
                           UCLOCK_FREQ / encaps->tb_rate;
@@ -328,7 +349,7 @@ static void upipe_ts_encaps_update_ready(struct upipe *upipe)
     if (encaps->uref == NULL || encaps->ubuf_mgr == NULL)
         goto upipe_ts_encaps_update_ready_done;
 
-    if (encaps->eos || encaps->psi) {
+    if (encaps->eos || encaps->psi || encaps->passthrough) {
         uref_ready = true;
         goto upipe_ts_encaps_update_ready_done;
     }
@@ -418,7 +439,10 @@ static void upipe_ts_encaps_promote_uref(struct upipe *upipe)
         uint64_t cr_prog = 0, cr_sys;
         size_t uref_size;
         if (unlikely(ubase_check(uref_flow_get_def(uref, &def)))) {
-            encaps->psi = !ubase_ncmp(def, "block.mpegts.mpegtspsi.");
+            encaps->passthrough =
+                ubase_check(uref_ts_flow_get_passthrough(uref));
+            encaps->psi = !encaps->passthrough &&
+                          !ubase_ncmp(def, "block.mpegts.mpegtspsi.");
             uref_flow_set_def(uref, "void.");
             uref_block_flow_get_octetrate(uref, &encaps->octetrate);
             uref_ts_flow_get_tb_rate(uref, &encaps->tb_rate);
@@ -448,6 +472,7 @@ static void upipe_ts_encaps_promote_uref(struct upipe *upipe)
                                                                &cr_sys)) ||
                             !ubase_check(uref_block_size(uref, &uref_size)) ||
                             (encaps->pcr_interval && has_cr &&
+                             !encaps->passthrough &&
                              !ubase_check(uref_clock_get_cr_prog(uref,
                                                                  &cr_prog))))) {
             upipe_warn(upipe, "dropping non-dated packet (internal error)");
@@ -461,9 +486,13 @@ static void upipe_ts_encaps_promote_uref(struct upipe *upipe)
         encaps->uref_cr_sys = cr_sys;
         assert(cr_sys);
         encaps->uref_dts_sys = UINT64_MAX;
-        uref_clock_get_dts_sys(uref, &encaps->uref_dts_sys);
+        if (encaps->passthrough)
+            /* the packet may not be delayed further than max_delay */
+            encaps->uref_dts_sys = cr_sys + encaps->max_delay;
+        else
+            uref_clock_get_dts_sys(uref, &encaps->uref_dts_sys);
         encaps->uref_size = uref_size;
-        if (!encaps->pcr_interval)
+        if (!encaps->pcr_interval || encaps->passthrough)
             encaps->sys_prog_last_cr_prog = UINT64_MAX;
         else if (has_cr) {
             encaps->sys_prog_last_cr_prog = cr_prog;
@@ -534,7 +563,7 @@ static void upipe_ts_encaps_input(struct upipe *upipe, struct uref *uref,
 
     uint64_t cr_sys, cr_prog;
     if (unlikely(!ubase_check(uref_clock_get_cr_sys(uref, &cr_sys)) ||
-                 (encaps->pcr_interval &&
+                 (encaps->pcr_interval && !encaps->passthrough &&
                   !ubase_check(uref_clock_get_cr_prog(uref, &cr_prog))))) {
         upipe_warn(upipe, "dropping non-dated packet");
         uref_free(uref);
@@ -553,6 +582,27 @@ static void upipe_ts_encaps_input(struct upipe *upipe, struct uref *uref,
         return;
     }
 
+    if (encaps->passthrough) {
+        if (unlikely(uref_size % TS_SIZE)) {
+            upipe_warn(upipe, "dropping truncated TS packets");
+            uref_free(uref);
+            return;
+        }
+
+        /* queue vectors of TS packets one packet at a time */
+        while (uref_size > TS_SIZE) {
+            struct uref *next = uref_block_split(uref, TS_SIZE);
+            if (unlikely(next == NULL)) {
+                uref_free(uref);
+                upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+                return;
+            }
+            upipe_ts_encaps_hold_input(upipe, uref);
+            uref = next;
+            uref_size -= TS_SIZE;
+        }
+    }
+
     upipe_ts_encaps_hold_input(upipe, uref);
     upipe_ts_encaps_block_input(upipe, upump_p);
     if (encaps->uref == NULL)
@@ -618,8 +668,9 @@ static int upipe_ts_encaps_set_flow_def(struct upipe *upipe,
         !ubase_check(uref_ts_flow_get_pid(flow_def, &pid)))
         return UBASE_ERR_INVALID;
 
+    bool passthrough = !ubase_ncmp(def, FLOW_DEF_PASSTHROUGH);
     uint8_t pes_id;
-    if (ubase_ncmp(def, FLOW_DEF_PSI)) {
+    if (!passthrough && ubase_ncmp(def, FLOW_DEF_PSI)) {
         if (!ubase_check(uref_ts_flow_get_pes_id(flow_def, &pes_id)))
             return UBASE_ERR_INVALID;
     }
@@ -630,7 +681,10 @@ static int upipe_ts_encaps_set_flow_def(struct upipe *upipe,
         return UBASE_ERR_ALLOC;
     }
 
-    if (ubase_ncmp(def, FLOW_DEF_PSI)) {
+    if (passthrough) {
+        if (unlikely(!ubase_check(uref_ts_flow_set_passthrough(flow_def_dup))))
+            upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+    } else if (ubase_ncmp(def, FLOW_DEF_PSI)) {
         if (unlikely(!ubase_check(uref_flow_set_def_va(flow_def_dup,
                             "block.mpegts.mpegtspes.%s",
                             def + strlen(EXPECTED_FLOW_DEF)))))
@@ -695,6 +749,9 @@ static int upipe_ts_encaps_set_pcr_interval(struct upipe *upipe,
 static int upipe_ts_encaps_set_cr_prog(struct upipe *upipe, uint64_t cr_prog)
 {
     struct upipe_ts_encaps *encaps = upipe_ts_encaps_from_upipe(upipe);
+    if (encaps->passthrough)
+        /* timestamps of passed-through packets are kept */
+        return UBASE_ERR_NONE;
     if (encaps->uref == NULL)
         return UBASE_ERR_INVALID;
 
@@ -1077,20 +1134,19 @@ static int upipe_ts_encaps_promote_au(struct upipe *upipe)
     return UBASE_ERR_NONE;
 }
 
-/** @internal @This builds a TS header.
+/** @internal @This returns the size of a TS header.
  *
  * @param upipe description structure of the pipe
  * @param payload_size available size of the payload
- * @param start true if it's the first packet of the access unit
  * @param pcr_prog value of the PCR field, in 27 MHz units, or UINT64_MAX
  * @param random true if the packet is a random access point
  * @param discontinuity true if the packet must have the discontinuity flag
- * @return allocated TS header
+ * @return size of the TS header
  */
-static struct ubuf *upipe_ts_encaps_build_ts(struct upipe *upipe,
-                                             size_t payload_size, bool start,
-                                             uint64_t pcr_prog, bool random,
-                                             bool discontinuity)
+static size_t upipe_ts_encaps_header_size(struct upipe *upipe,
+                                          size_t payload_size,
+                                          uint64_t pcr_prog, bool random,
+                                          bool discontinuity)
 {
     struct upipe_ts_encaps *encaps = upipe_ts_encaps_from_upipe(upipe);
     size_t header_size;
@@ -1103,23 +1159,32 @@ static struct ubuf *upipe_ts_encaps_build_ts(struct upipe *upipe,
 
     if (!encaps->psi && payload_size < TS_SIZE - header_size)
         header_size = TS_SIZE - payload_size;
+    return header_size;
+}
 
+/** @internal @This writes a TS header.
+ *
+ * @param upipe description structure of the pipe
+ * @param buffer buffer to write to
+ * @param header_size size of the TS header
+ * @param payload_size available size of the payload
+ * @param start true if it's the first packet of the access unit
+ * @param pcr_prog value of the PCR field, in 27 MHz units, or UINT64_MAX
+ * @param random true if the packet is a random access point
+ * @param discontinuity true if the packet must have the discontinuity flag
+ */
+static void upipe_ts_encaps_write_ts(struct upipe *upipe, uint8_t *buffer,
+                                     size_t header_size, size_t payload_size,
+                                     bool start, uint64_t pcr_prog,
+                                     bool random, bool discontinuity)
+{
+    struct upipe_ts_encaps *encaps = upipe_ts_encaps_from_upipe(upipe);
 #ifdef VERBOSE_HEADERS
     upipe_verbose_va(upipe, "preparing TS header (size %zu%s%s%s%s)",
             header_size, start ? ", start" : "", random ? ", random" : "",
             discontinuity ? ", disc" : "",
             pcr_prog != UINT64_MAX ? ", pcr" : "");
 #endif
-    struct ubuf *ubuf = ubuf_block_alloc(encaps->ubuf_mgr, header_size);
-    uint8_t *buffer;
-    int size = -1;
-    if (unlikely(ubuf == NULL ||
-                 !ubase_check(ubuf_block_write(ubuf, 0, &size, &buffer)))) {
-        ubuf_free(ubuf);
-        return NULL;
-    }
-    assert(size == header_size);
-
     ts_init(buffer);
     ts_set_pid(buffer, encaps->pid);
     if (payload_size) {
@@ -1143,7 +1208,47 @@ static struct ubuf *upipe_ts_encaps_build_ts(struct upipe *upipe,
             tsaf_set_pcrext(buffer, pcr_prog % SCALE_33);
         }
     }
+}
+
+/** @internal @This builds a TS header.
+ *
+ * @param upipe description structure of the pipe
+ * @param buffer buffer of TS_SIZE octets to write the header to, or NULL
+ * to allocate a ubuf
+ * @param payload_size available size of the payload
+ * @param start true if it's the first packet of the access unit
+ * @param pcr_prog value of the PCR field, in 27 MHz units, or UINT64_MAX
+ * @param random true if the packet is a random access point
+ * @param discontinuity true if the packet must have the discontinuity flag
+ * @return allocated TS header, or NULL if it was written to buffer
+ */
+static struct ubuf *upipe_ts_encaps_build_ts(struct upipe *upipe,
+                                             uint8_t *buffer,
+                                             size_t payload_size, bool start,
+                                             uint64_t pcr_prog, bool random,
+                                             bool discontinuity)
+{
+    struct upipe_ts_encaps *encaps = upipe_ts_encaps_from_upipe(upipe);
+    size_t header_size = upipe_ts_encaps_header_size(upipe, payload_size,
+                                                     pcr_prog, random,
+                                                     discontinuity);
+    if (buffer != NULL) {
+        upipe_ts_encaps_write_ts(upipe, buffer, header_size, payload_size,
+                                 start, pcr_prog, random, discontinuity);
+        return NULL;
+    }
+
+    struct ubuf *ubuf = ubuf_block_alloc(encaps->ubuf_mgr, header_size);
+    int size = -1;
+    if (unlikely(ubuf == NULL ||
+                 !ubase_check(ubuf_block_write(ubuf, 0, &size, &buffer)))) {
+        ubuf_free(ubuf);
+        return NULL;
+    }
+    assert(size == header_size);
 
+    upipe_ts_encaps_write_ts(upipe, buffer, header_size, payload_size,
+                             start, pcr_prog, random, discontinuity);
     ubuf_block_unmap(ubuf, 0);
     return ubuf;
 }
@@ -1152,19 +1257,24 @@ static struct ubuf *upipe_ts_encaps_build_ts(struct upipe *upipe,
  * build a complete TS packet. For PSI sections it may also append padding.
  *
  * @param upipe description structure of the pipe
- * @param ubuf_p appended with the payload of the packet
+ * @param ubuf_p appended with the payload of the packet, if buffer is NULL
+ * @param buffer TS packet whose header is already written, to copy the
+ * payload to, or NULL
  * @param dts_sys_p filled in with the DTS, or UINT64_MAX
  * @return an error code
  */
 static int upipe_ts_encaps_complete(struct upipe *upipe, struct ubuf **ubuf_p,
-                                    uint64_t *dts_sys_p)
+                                    uint8_t *buffer, uint64_t *dts_sys_p)
 {
     struct upipe_ts_encaps *encaps = upipe_ts_encaps_from_upipe(upipe);
     encaps->need_status = true;
     *dts_sys_p = UINT64_MAX;
 
     size_t ubuf_size;
-    UBASE_RETURN(ubuf_block_size(*ubuf_p, &ubuf_size));
+    if (buffer != NULL)
+        ubuf_size = ts_payload(buffer) - buffer;
+    else
+        UBASE_RETURN(ubuf_block_size(*ubuf_p, &ubuf_size));
     assert(ubuf_size < TS_SIZE);
 
     for ( ; ; ) {
@@ -1180,12 +1290,34 @@ static int upipe_ts_encaps_complete(struct upipe *upipe, struct ubuf **ubuf_p,
                 (uint64_t)(uref_size - header_size) * UCLOCK_FREQ /
                 encaps->tb_rate;
 
-        struct ubuf *payload = uref_detach_ubuf(encaps->uref);
+        size_t payload_size = uref_size;
         if (uref_size >= TS_SIZE - ubuf_size) {
-            size_t payload_size = TS_SIZE - ubuf_size;
+            payload_size = TS_SIZE - ubuf_size;
             assert(payload_size);
-            uref_attach_ubuf(encaps->uref,
-                             ubuf_block_split(payload, payload_size));
+        }
+
+        if (buffer != NULL) {
+            /* copy the payload right after the header */
+            if (unlikely(!ubase_check(uref_block_extract(encaps->uref, 0,
+                                payload_size, buffer + ubuf_size)) ||
+                         (payload_size < uref_size &&
+                          !ubase_check(uref_block_resize(encaps->uref,
+                                payload_size, -1)))))
+                return UBASE_ERR_INVALID;
+        } else {
+            struct ubuf *payload = uref_detach_ubuf(encaps->uref);
+            if (uref_size >= TS_SIZE - ubuf_size)
+                uref_attach_ubuf(encaps->uref,
+                                 ubuf_block_split(payload, payload_size));
+            if (unlikely(payload == NULL ||
+                         !ubase_check(ubuf_block_append(*ubuf_p, payload)))) {
+                ubuf_free(payload);
+                ubuf_free(*ubuf_p);
+                return UBASE_ERR_ALLOC;
+            }
+        }
+
+        if (uref_size >= TS_SIZE - ubuf_size) {
             encaps->uref_size -= payload_size;
             encaps->au_size -= payload_size;
             if (payload_size >= header_size)
@@ -1198,13 +1330,6 @@ static int upipe_ts_encaps_complete(struct upipe *upipe, struct ubuf **ubuf_p,
             encaps->au_size -= uref_size;
         }
 
-        if (unlikely(payload == NULL ||
-                     !ubase_check(ubuf_block_append(*ubuf_p, payload)))) {
-            ubuf_free(payload);
-            ubuf_free(*ubuf_p);
-            return UBASE_ERR_ALLOC;
-        }
-
         if (uref_size <= TS_SIZE - ubuf_size)
             upipe_ts_encaps_consume_uref(upipe);
 
@@ -1223,6 +1348,11 @@ static int upipe_ts_encaps_complete(struct upipe *upipe, struct ubuf **ubuf_p,
 
     if (ubuf_size < TS_SIZE) {
         /* With PSI, pad with 0xff */
+        if (buffer != NULL) {
+            memset(buffer + ubuf_size, 0xff, TS_SIZE - ubuf_size);
+            return UBASE_ERR_NONE;
+        }
+
         struct ubuf *padding = ubuf_dup(encaps->padding);
         if (unlikely(padding == NULL ||
                      !ubase_check(ubuf_block_resize(padding, 0,
@@ -1237,17 +1367,96 @@ static int upipe_ts_encaps_complete(struct upipe *upipe, struct ubuf **ubuf_p,
     return UBASE_ERR_NONE;
 }
 
-/** @This returns a ubuf containing a TS packet, and the dts_sys of the packet.
+/** @internal @This passes through the input TS packet, rewriting its PID
+ * and continuity counter, and restamping its PCR if configured to do so.
+ *
+ * @param upipe description structure of the pipe
+ * @param ubuf_p filled in with a pointer to the ubuf, if buffer is NULL
+ * @param buffer buffer of TS_SIZE octets to write the packet to, or NULL
+ * @param dts_sys_p filled in with UINT64_MAX
+ * @return an error code
+ */
+static int upipe_ts_encaps_passthrough(struct upipe *upipe,
+                                       struct ubuf **ubuf_p, uint8_t *buffer,
+                                       uint64_t *dts_sys_p)
+{
+    struct upipe_ts_encaps *encaps = upipe_ts_encaps_from_upipe(upipe);
+    struct ubuf *ubuf = NULL;
+    if (buffer == NULL) {
+        int size = -1;
+        ubuf = ubuf_block_alloc(encaps->ubuf_mgr, TS_SIZE);
+        if (unlikely(ubuf == NULL ||
+                     !ubase_check(ubuf_block_write(ubuf, 0, &size,
+                                                   &buffer)))) {
+            ubuf_free(ubuf);
+            return UBASE_ERR_ALLOC;
+        }
+    }
+
+    int err = uref_block_extract(encaps->uref, 0, TS_SIZE, buffer);
+    if (likely(ubase_check(err))) {
+        ts_set_pid(buffer, encaps->pid);
+        if (ts_has_payload(buffer)) {
+            /* duplicate packets keep the same continuity counter */
+            if (ts_get_cc(buffer) != encaps->passthrough_cc) {
+                encaps->last_cc++;
+                encaps->last_cc &= 0xf;
+            }
+            encaps->passthrough_cc = ts_get_cc(buffer);
+        }
+        ts_set_cc(buffer, encaps->last_cc);
+
+        if (encaps->pcr_restamp && ts_has_adaptation(buffer) &&
+            ts_get_adaptation(buffer) && tsaf_has_pcr(buffer)) {
+            /* compensate the delay between the original muxing date and
+             * ours */
+            int64_t pcr = tsaf_get_pcr(buffer) * SCALE_33 +
+                          tsaf_get_pcrext(buffer);
+            pcr += (int64_t)encaps->last_splice -
+                   (int64_t)encaps->uref_cr_sys;
+            pcr %= (int64_t)(POW2_33 * SCALE_33);
+            if (pcr < 0)
+                pcr += POW2_33 * SCALE_33;
+            tsaf_set_pcr(buffer, (pcr / SCALE_33) % POW2_33);
+            tsaf_set_pcrext(buffer, pcr % SCALE_33);
+        }
+    }
+
+    if (ubuf != NULL) {
+        ubuf_block_unmap(ubuf, 0);
+        if (unlikely(!ubase_check(err)))
+            ubuf_free(ubuf);
+        else
+            *ubuf_p = ubuf;
+    }
+    UBASE_RETURN(err)
+
+    /* the timestamps of the payload are not parsed */
+    *dts_sys_p = UINT64_MAX;
+    if (encaps->tb_buffer > TS_SIZE - TS_HEADER_SIZE)
+        encaps->tb_buffer -= TS_SIZE - TS_HEADER_SIZE;
+    else
+        encaps->tb_buffer = 0;
+    encaps->need_status = true;
+    upipe_ts_encaps_consume_uref(upipe);
+    return UBASE_ERR_NONE;
+}
+
+/** @This returns a ubuf containing a TS packet, or writes it to the given
+ * buffer, and the dts_sys of the packet. If both ubuf_p and buffer are NULL,
+ * late packets are flushed.
  *
  * @param upipe description structure of the pipe
  * @param cr_sys_min date at which the packet will be muxed
  * @param cr_sys_max maximum date allowed for muxing
  * @param ubuf_p filled in with a pointer to the ubuf (may be NULL)
+ * @param buffer buffer of TS_SIZE octets to write the packet to, or NULL
  * @param dts_sys_p filled in with the dts_sys, or UINT64_MAX
  * @return an error code
  */
 static int _upipe_ts_encaps_splice(struct upipe *upipe, uint64_t cr_sys_min,
-        uint64_t cr_sys_max, struct ubuf **ubuf_p, uint64_t *dts_sys_p)
+        uint64_t cr_sys_max, struct ubuf **ubuf_p, uint8_t *buffer,
+        uint64_t *dts_sys_p)
 {
     struct upipe_ts_encaps *encaps = upipe_ts_encaps_from_upipe(upipe);
     if (encaps->ubuf_mgr == NULL)
@@ -1261,7 +1470,7 @@ static int _upipe_ts_encaps_splice(struct upipe *upipe, uint64_t cr_sys_min,
     }
     encaps->last_splice = cr_sys_min;
 
-    if (ubuf_p == NULL) {
+    if (ubuf_p == NULL && buffer == NULL) {
         /* Flush until cr_sys_min */
         while (encaps->uref != NULL) {
             if (encaps->uref_dts_sys != UINT64_MAX) {
@@ -1303,14 +1512,23 @@ static int _upipe_ts_encaps_splice(struct upipe *upipe, uint64_t cr_sys_min,
         if (unlikely(pcr_prog == UINT64_MAX))
             upipe_dbg(upipe, "adding unnecessary padding (internal error)");
 
-        *ubuf_p = upipe_ts_encaps_build_ts(upipe, 0, false, pcr_prog, false,
-                                           false);
+        struct ubuf *ubuf = upipe_ts_encaps_build_ts(upipe, buffer, 0, false,
+                                                     pcr_prog, false, false);
+        if (buffer == NULL)
+            *ubuf_p = ubuf;
         *dts_sys_p = pcr_prog != UINT64_MAX ? cr_sys_min : UINT64_MAX;
         encaps->need_status = true;
         upipe_ts_encaps_check_status(upipe);
         return UBASE_ERR_NONE;
     }
 
+    if (encaps->passthrough) {
+        UBASE_RETURN(upipe_ts_encaps_passthrough(upipe, ubuf_p, buffer,
+                                                 dts_sys_p));
+        upipe_ts_encaps_check_status(upipe);
+        return UBASE_ERR_NONE;
+    }
+
     bool start = ubase_check(uref_block_get_start(encaps->uref));
     if (start) {
         UBASE_RETURN(upipe_ts_encaps_promote_au(upipe));
@@ -1318,15 +1536,19 @@ static int _upipe_ts_encaps_splice(struct upipe *upipe, uint64_t cr_sys_min,
     assert(encaps->uref_size);
     assert(encaps->au_size);
 
-    *ubuf_p = upipe_ts_encaps_build_ts(upipe, encaps->au_size, start, pcr_prog,
+    struct ubuf *ubuf = upipe_ts_encaps_build_ts(upipe, buffer,
+            encaps->au_size, start, pcr_prog,
             ubase_check(uref_flow_get_random(encaps->uref)),
             ubase_check(uref_flow_get_discontinuity(encaps->uref)));
-    UBASE_ALLOC_RETURN(*ubuf_p);
+    if (buffer == NULL) {
+        UBASE_ALLOC_RETURN(ubuf);
+        *ubuf_p = ubuf;
+    }
     uref_block_delete_start(encaps->uref);
     uref_flow_delete_random(encaps->uref);
     uref_flow_delete_discontinuity(encaps->uref);
 
-    UBASE_RETURN(upipe_ts_encaps_complete(upipe, ubuf_p, dts_sys_p));
+    UBASE_RETURN(upipe_ts_encaps_complete(upipe, ubuf_p, buffer, dts_sys_p));
     if (pcr_prog != UINT64_MAX)
         *dts_sys_p = encaps->last_splice;
 
@@ -1400,6 +1622,12 @@ static int upipe_ts_encaps_control(struct upipe *upipe,
             uint64_t pcr_interval = va_arg(args, uint64_t);
             return upipe_ts_encaps_set_pcr_interval(upipe, pcr_interval);
         }
+        case UPIPE_TS_MUX_SET_PCR_RESTAMP: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_TS_MUX_SIGNATURE)
+            struct upipe_ts_encaps *encaps = upipe_ts_encaps_from_upipe(upipe);
+            encaps->pcr_restamp = !!va_arg(args, int);
+            return UBASE_ERR_NONE;
+        }
         case UPIPE_TS_MUX_SET_CR_PROG: {
             UBASE_SIGNATURE_CHECK(args, UPIPE_TS_MUX_SIGNATURE)
             uint64_t cr_prog = va_arg(args, uint64_t);
@@ -1417,7 +1645,18 @@ static int upipe_ts_encaps_control(struct upipe *upipe,
             struct ubuf **ubuf_p = va_arg(args, struct ubuf **);
             uint64_t *dts_sys_p = va_arg(args, uint64_t *);
             return _upipe_ts_encaps_splice(upipe, cr_sys_min, cr_sys_max,
-                                           ubuf_p, dts_sys_p);
+                                           ubuf_p, NULL, dts_sys_p);
+        }
+        case UPIPE_TS_ENCAPS_SPLICE_BUFFER: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_TS_ENCAPS_SIGNATURE)
+            uint64_t cr_sys_min = va_arg(args, uint64_t);
+            uint64_t cr_sys_max = va_arg(args, uint64_t);
+            uint8_t *buffer = va_arg(args, uint8_t *);
+            uint64_t *dts_sys_p = va_arg(args, uint64_t *);
+            if (buffer == NULL)
+                return UBASE_ERR_INVALID;
+            return _upipe_ts_encaps_splice(upipe, cr_sys_min, cr_sys_max,
+                                           NULL, buffer, dts_sys_p);
         }
         case UPIPE_TS_ENCAPS_EOS: {
             UBASE_SIGNATURE_CHECK(args, UPIPE_TS_ENCAPS_SIGNATURE)
@@ -1466,6 +1705,7 @@ static const char *upipe_ts_encaps_command_str(int cmd)
         UBASE_CASE_TO_STR(UPIPE_TS_ENCAPS_SET_TB_SIZE);
         UBASE_CASE_TO_STR(UPIPE_TS_ENCAPS_SPLICE);
         UBASE_CASE_TO_STR(UPIPE_TS_ENCAPS_EOS);
+        UBASE_CASE_TO_STR(UPIPE_TS_ENCAPS_SPLICE_BUFFER);
         default: break;
     }
     return NULL;
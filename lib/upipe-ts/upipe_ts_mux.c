@@ -68,6 +68,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#include <stdio.h>
 #include <string.h>
 #include <limits.h>
 #include <assert.h>
@@ -127,6 +128,8 @@
 #define MAX_DELAY_TELX (UCLOCK_FREQ / 25)
 /** max retention time for DVB subtitles - unbound */
 #define MAX_DELAY_DVBSUB MAX_DELAY_STILL
+/** max additional delay of passed-through TS packets */
+#define MAX_DELAY_PASSTHROUGH (UCLOCK_FREQ / 10)
 /** fixed PES header size for teletext (ETSI EN 300 472 4.2) */
 #define PES_HEADER_SIZE_TELX 45
 
@@ -211,6 +214,37 @@ static int upipe_ts_mux_check(struct upipe *upipe, struct uref *unused);
 
 /** @hidden */
 struct upipe_ts_mux_psi_pid;
+/** @hidden */
+struct upipe_ts_mux_input;
+
+/** @internal @This lists the dates on which inputs are scheduled. */
+enum upipe_ts_mux_date {
+    /** cr_sys of the next packet */
+    UPIPE_TS_MUX_DATE_CR,
+    /** dts_sys of the next packet */
+    UPIPE_TS_MUX_DATE_DTS,
+    /** cr_sys of the next PCR */
+    UPIPE_TS_MUX_DATE_PCR,
+
+    /** number of dates */
+    UPIPE_TS_MUX_DATES
+};
+
+/** @internal @This defines why an input may hold the mux in file mode. */
+enum upipe_ts_mux_wait {
+    /** the input doesn't hold the mux */
+    UPIPE_TS_MUX_WAIT_NONE,
+    /** the input has no flow definition yet, and holds the mux during
+     * preroll */
+    UPIPE_TS_MUX_WAIT_UNKNOWN,
+    /** the input has no packet ready and holds the mux */
+    UPIPE_TS_MUX_WAIT_DATA,
+    /** the input is deleted and has no packet ready, it must be released */
+    UPIPE_TS_MUX_WAIT_DELETED,
+
+    /** number of states */
+    UPIPE_TS_MUX_WAITS
+};
 
 /** @internal @This is the private context of a ts_mux pipe. */
 struct upipe_ts_mux {
@@ -344,6 +378,10 @@ struct upipe_ts_mux {
     size_t tb_size;
     /** force PES alignment */
     bool force_pes_alignment;
+    /** true if TS packets are written to a contiguous buffer */
+    bool contiguous;
+    /** true if PCRs of passed-through TS packets are restamped */
+    bool pcr_restamp;
 
     /** list of PIDs carrying PSI */
     struct uchain psi_pids;
@@ -361,6 +399,12 @@ struct upipe_ts_mux {
     struct uref *uref;
     /** size of current aggregation */
     size_t uref_size;
+    /** contiguous buffer of the current aggregation, mapped */
+    struct ubuf *buffer_ubuf;
+    /** pointer to the contiguous buffer */
+    uint8_t *buffer;
+    /** size of the contiguous buffer */
+    size_t buffer_size;
     /** true during the preroll period */
     bool preroll;
 
@@ -371,6 +415,16 @@ struct upipe_ts_mux {
 
     /** list of programs */
     struct uchain programs;
+    /** binary min-heaps of all inputs, one per scheduling date */
+    struct upipe_ts_mux_input **heaps[UPIPE_TS_MUX_DATES];
+    /** number of inputs in the heaps */
+    unsigned int heap_size;
+    /** number of allocated slots in the heaps */
+    unsigned int heap_allocated;
+    /** sequence number of the next input, to break ties in the heaps */
+    uint64_t input_seq;
+    /** number of inputs in each wait state */
+    unsigned int nb_waits[UPIPE_TS_MUX_WAITS];
 
     /** manager to create programs */
     struct upipe_mgr program_mgr;
@@ -543,6 +597,8 @@ struct upipe_ts_mux_input {
     uint64_t buffer_duration;
     /** true if the output is used for PCR */
     bool pcr;
+    /** true if TS packets are passed through */
+    bool passthrough;
     /** calculated required octetrate including overheads */
     uint64_t required_octetrate;
 
@@ -568,6 +624,12 @@ struct upipe_ts_mux_input {
     uint64_t pcr_sys;
     /** true if the input is ready to output packet */
     bool ready;
+    /** sequence number, to break ties in the heaps */
+    uint64_t seq;
+    /** positions in the heaps of the mux */
+    unsigned int heap_index[UPIPE_TS_MUX_DATES];
+    /** wait state in file mode */
+    enum upipe_ts_mux_wait wait;
 
     /** psi_pid structure for PSI-based elementary streams */
     struct upipe_ts_mux_psi_pid *psi_pid;
@@ -608,6 +670,195 @@ UPIPE_HELPER_SUBPIPE(upipe_ts_mux_program, upipe_ts_mux_input, input,
 /** @hidden */
 static void upipe_ts_mux_input_free(struct urefcount *urefcount_real);
 
+/** @internal @This returns the date of an input used as a key in a heap.
+ *
+ * @param input input structure
+ * @param date date to return
+ * @return the date
+ */
+static inline uint64_t upipe_ts_mux_input_date(struct upipe_ts_mux_input *input,
+                                               enum upipe_ts_mux_date date)
+{
+    switch (date) {
+        case UPIPE_TS_MUX_DATE_CR:
+            return input->cr_sys;
+        case UPIPE_TS_MUX_DATE_DTS:
+            return input->dts_sys;
+        case UPIPE_TS_MUX_DATE_PCR:
+            return input->pcr_sys;
+        default:
+            break;
+    }
+    return UINT64_MAX;
+}
+
+/** @internal @This checks if an input must be before another one in a heap.
+ * Inputs with the same date are ordered by creation.
+ *
+ * @param input1 first input
+ * @param input2 second input
+ * @param date date used as a key
+ * @return true if the first input comes first
+ */
+static inline bool upipe_ts_mux_heap_before(struct upipe_ts_mux_input *input1,
+                                            struct upipe_ts_mux_input *input2,
+                                            enum upipe_ts_mux_date date)
+{
+    uint64_t date1 = upipe_ts_mux_input_date(input1, date);
+    uint64_t date2 = upipe_ts_mux_input_date(input2, date);
+    return date1 < date2 || (date1 == date2 && input1->seq < input2->seq);
+}
+
+/** @internal @This stores an input at a given position of a heap.
+ *
+ * @param mux ts_mux structure
+ * @param date date used as a key
+ * @param index position in the heap
+ * @param input input to store
+ */
+static inline void upipe_ts_mux_heap_set(struct upipe_ts_mux *mux,
+                                         enum upipe_ts_mux_date date,
+                                         unsigned int index,
+                                         struct upipe_ts_mux_input *input)
+{
+    mux->heaps[date][index] = input;
+    input->heap_index[date] = index;
+}
+
+/** @internal @This restores the heap property around an input whose date
+ * has changed.
+ *
+ * @param mux ts_mux structure
+ * @param date date used as a key
+ * @param input input to move
+ */
+static void upipe_ts_mux_heap_update(struct upipe_ts_mux *mux,
+                                     enum upipe_ts_mux_date date,
+                                     struct upipe_ts_mux_input *input)
+{
+    struct upipe_ts_mux_input **heap = mux->heaps[date];
+    unsigned int index = input->heap_index[date];
+
+    while (index) {
+        unsigned int parent = (index - 1) / 2;
+        if (!upipe_ts_mux_heap_before(input, heap[parent], date))
+            break;
+        upipe_ts_mux_heap_set(mux, date, index, heap[parent]);
+        index = parent;
+    }
+
+    for ( ; ; ) {
+        unsigned int child = 2 * index + 1;
+        if (child >= mux->heap_size)
+            break;
+        if (child + 1 < mux->heap_size &&
+            upipe_ts_mux_heap_before(heap[child + 1], heap[child], date))
+            child++;
+        if (!upipe_ts_mux_heap_before(heap[child], input, date))
+            break;
+        upipe_ts_mux_heap_set(mux, date, index, heap[child]);
+        index = child;
+    }
+    upipe_ts_mux_heap_set(mux, date, index, input);
+}
+
+/** @internal @This returns the first input of a heap.
+ *
+ * @param mux ts_mux structure
+ * @param date date used as a key
+ * @return pointer to the input with the lowest date, or NULL
+ */
+static inline struct upipe_ts_mux_input *
+    upipe_ts_mux_heap_peek(struct upipe_ts_mux *mux,
+                           enum upipe_ts_mux_date date)
+{
+    return mux->heap_size ? mux->heaps[date][0] : NULL;
+}
+
+/** @internal @This adds an input to the heaps.
+ *
+ * @param mux ts_mux structure
+ * @param input input to add
+ * @return an error code
+ */
+static int upipe_ts_mux_heap_add(struct upipe_ts_mux *mux,
+                                 struct upipe_ts_mux_input *input)
+{
+    if (mux->heap_size >= mux->heap_allocated) {
+        unsigned int allocated = mux->heap_allocated ?
+                                 mux->heap_allocated * 2 : 16;
+        for (int date = 0; date < UPIPE_TS_MUX_DATES; date++) {
+            struct upipe_ts_mux_input **heap =
+                realloc(mux->heaps[date], allocated * sizeof(*heap));
+            UBASE_ALLOC_RETURN(heap)
+            mux->heaps[date] = heap;
+        }
+        mux->heap_allocated = allocated;
+    }
+
+    input->seq = mux->input_seq++;
+    input->wait = UPIPE_TS_MUX_WAIT_NONE;
+    mux->nb_waits[input->wait]++;
+    unsigned int index = mux->heap_size++;
+    for (int date = 0; date < UPIPE_TS_MUX_DATES; date++) {
+        upipe_ts_mux_heap_set(mux, date, index, input);
+        upipe_ts_mux_heap_update(mux, date, input);
+    }
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This removes an input from the heaps.
+ *
+ * @param mux ts_mux structure
+ * @param input input to remove
+ */
+static void upipe_ts_mux_heap_del(struct upipe_ts_mux *mux,
+                                  struct upipe_ts_mux_input *input)
+{
+    if (unlikely(input->heap_index[0] == UINT_MAX))
+        return;
+    mux->nb_waits[input->wait]--;
+    unsigned int last = --mux->heap_size;
+    for (int date = 0; date < UPIPE_TS_MUX_DATES; date++) {
+        unsigned int index = input->heap_index[date];
+        struct upipe_ts_mux_input *moved = mux->heaps[date][last];
+        if (index == last)
+            continue;
+        upipe_ts_mux_heap_set(mux, date, index, moved);
+        upipe_ts_mux_heap_update(mux, date, moved);
+    }
+}
+
+/** @internal @This reschedules an input after its dates or its state
+ * changed.
+ *
+ * @param mux ts_mux structure
+ * @param input input to reschedule
+ */
+static void upipe_ts_mux_input_schedule(struct upipe_ts_mux *mux,
+                                        struct upipe_ts_mux_input *input)
+{
+    if (unlikely(input->heap_index[0] == UINT_MAX))
+        return;
+    for (int date = 0; date < UPIPE_TS_MUX_DATES; date++)
+        upipe_ts_mux_heap_update(mux, date, input);
+
+    enum upipe_ts_mux_wait wait = UPIPE_TS_MUX_WAIT_NONE;
+    if (input->ready)
+        ;
+    else if (input->deleted)
+        wait = UPIPE_TS_MUX_WAIT_DELETED;
+    else if (input->input_type == UPIPE_TS_MUX_INPUT_UNKNOWN)
+        wait = UPIPE_TS_MUX_WAIT_UNKNOWN;
+    else if (input->input_type != UPIPE_TS_MUX_INPUT_OTHER &&
+             input->input_type != UPIPE_TS_MUX_INPUT_SCTE35 &&
+             input->input_type != UPIPE_TS_MUX_INPUT_METADATA)
+        wait = UPIPE_TS_MUX_WAIT_DATA;
+    mux->nb_waits[input->wait]--;
+    mux->nb_waits[wait]++;
+    input->wait = wait;
+}
+
 
 /*
  * psi_pid structure handling
@@ -972,6 +1223,10 @@ static int upipe_ts_mux_input_encaps_probe(struct uprobe *uprobe,
     upipe_ts_mux_input->dts_sys = va_arg(args, uint64_t);
     upipe_ts_mux_input->pcr_sys = va_arg(args, uint64_t);
     upipe_ts_mux_input->ready = !!va_arg(args, int);
+    upipe_ts_mux_input_schedule(upipe_ts_mux_from_program_mgr(
+                upipe_ts_mux_program_to_upipe(
+                    upipe_ts_mux_program_from_input_mgr(upipe->mgr))->mgr),
+            upipe_ts_mux_input);
     return UBASE_ERR_NONE;
 }
 
@@ -1007,6 +1262,7 @@ static struct upipe *upipe_ts_mux_input_alloc(struct upipe_mgr *mgr,
     upipe_ts_mux_input_init_bin_input(upipe);
     uchain_init(upipe_ts_mux_input_to_uchain_psi(upipe_ts_mux_input));
     upipe_ts_mux_input->pcr = false;
+    upipe_ts_mux_input->passthrough = false;
     upipe_ts_mux_input->deleted = false;
     upipe_ts_mux_input->input_type = UPIPE_TS_MUX_INPUT_UNKNOWN;
     upipe_ts_mux_input->pid = 0;
@@ -1030,6 +1286,12 @@ static struct upipe *upipe_ts_mux_input_alloc(struct upipe_mgr *mgr,
         upipe_ts_mux_input->original_au_per_sec.den = 0;
 
     upipe_ts_mux_input_init_sub(upipe);
+    upipe_ts_mux_input->heap_index[0] = UINT_MAX;
+    if (unlikely(!ubase_check(upipe_ts_mux_heap_add(upipe_ts_mux,
+                                                    upipe_ts_mux_input))))
+        upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+    else
+        upipe_ts_mux_input_schedule(upipe_ts_mux, upipe_ts_mux_input);
     uprobe_init(&upipe_ts_mux_input->probe, upipe_ts_mux_input_probe, NULL);
     upipe_ts_mux_input->probe.refcount =
         upipe_ts_mux_input_to_urefcount_real(upipe_ts_mux_input);
@@ -1110,6 +1372,8 @@ static int upipe_ts_mux_input_set_flow_def(struct upipe *upipe,
     uint64_t octetrate = 0;
 
     UBASE_RETURN(uref_flow_get_def(flow_def, &def))
+    /* TS packets passed through without decapsulation */
+    bool passthrough = !ubase_ncmp(def, "block.mpegts.");
 
     /* check virtual/block and octetrate */
     const char *sub_def = def;
@@ -1136,6 +1400,36 @@ static int upipe_ts_mux_input_set_flow_def(struct upipe *upipe,
         return UBASE_ERR_INVALID;
     }
 
+    /* passed-through packets keep the time base of their original
+     * multiplex, which the program PCR cannot serve together with ours */
+    struct uchain *uchain;
+    ulist_foreach (&program->inputs, uchain) {
+        struct upipe_ts_mux_input *other =
+            upipe_ts_mux_input_from_uchain(uchain);
+        if (other != input && !other->deleted &&
+            other->input_type != UPIPE_TS_MUX_INPUT_UNKNOWN &&
+            other->passthrough != passthrough) {
+            upipe_warn_va(upipe, "cannot mix passed-through and "
+                          "encapsulated inputs in a program (%s)", def);
+            return UBASE_ERR_INVALID;
+        }
+    }
+
+    /* the PMT describes the elementary stream of passed-through packets */
+    char raw_def[strlen(def) + sizeof("void.scte35.")];
+    if (passthrough) {
+        const char *es_def = def + strlen("block.mpegts.");
+        if (!ubase_ncmp(es_def, "mpegtspes."))
+            snprintf(raw_def, sizeof(raw_def), "block.%s",
+                     es_def + strlen("mpegtspes."));
+        else if (!ubase_ncmp(es_def, "mpegtspsi.mpegtsscte35."))
+            snprintf(raw_def, sizeof(raw_def), "void.scte35.");
+        else
+            snprintf(raw_def, sizeof(raw_def), "block.%s", es_def);
+        def = raw_def;
+        sub_def = def + strcspn(def, ".");
+    }
+
     struct uref *flow_def_dup;
     if (unlikely((flow_def_dup = uref_dup(flow_def)) == NULL ||
                  !ubase_check(uref_flow_set_raw_def(flow_def_dup, def)))) {
@@ -1187,6 +1481,9 @@ static int upipe_ts_mux_input_set_flow_def(struct upipe *upipe,
     } else if (!ubase_ncmp(def, "mpegtspsi.")) {
         input_type = UPIPE_TS_MUX_INPUT_PSI;
     }
+    if (passthrough && input_type != UPIPE_TS_MUX_INPUT_VIDEO &&
+        input_type != UPIPE_TS_MUX_INPUT_AUDIO)
+        input_type = UPIPE_TS_MUX_INPUT_OTHER;
 
     uint64_t pes_overhead = 0;
     uint64_t buffer_size = 0;
@@ -1199,7 +1496,7 @@ static int upipe_ts_mux_input_set_flow_def(struct upipe *upipe,
     bool has_random = false;
     uint64_t coalesce_latency = 0;
 
-    if (!ubase_ncmp(def, "void.")) {
+    if (passthrough || !ubase_ncmp(def, "void.")) {
         /* nothing to do */
     } else if (strstr(def, ".pic.sub.") != NULL) {
         if (!ubase_ncmp(def, "block.dvb_teletext.")) {
@@ -1356,7 +1653,7 @@ static int upipe_ts_mux_input_set_flow_def(struct upipe *upipe,
         original_au_per_sec = au_per_sec;
     input->original_au_per_sec = original_au_per_sec;
 
-    uint64_t ts_overhead = TS_HEADER_SIZE *
+    uint64_t ts_overhead = passthrough ? 0 : TS_HEADER_SIZE *
         (octetrate + pes_overhead + TS_SIZE - TS_HEADER_SIZE - 1) /
         (TS_SIZE - TS_HEADER_SIZE);
 
@@ -1378,11 +1675,38 @@ static int upipe_ts_mux_input_set_flow_def(struct upipe *upipe,
         pes_alignment = true;
     }
 
-    if (!ubase_ncmp(def, "void.scte35.")) { /* SCTE-35 */
+    if (passthrough) { /* TS packets */
+        upipe_ts_mux_input_store_bin_input(upipe, upipe_use(input->encaps));
+        upipe_ts_mux_set_pcr_restamp(input->encaps, upipe_ts_mux->pcr_restamp);
+
+        if (input->psi_pid != NULL) {
+            upipe_ts_mux_psi_pid_release(input->psi_pid);
+            input->psi_pid = NULL;
+        }
+
+        uint64_t tb_rate = octetrate;
+        if (input_type == UPIPE_TS_MUX_INPUT_VIDEO) {
+            uint64_t max_octetrate = octetrate;
+            uref_block_flow_get_max_octetrate(flow_def, &max_octetrate);
+            /* ISO/IEC 13818-1 2.4.2.3 */
+            tb_rate = max_octetrate * 6 / 5;
+        } else if (input_type == UPIPE_TS_MUX_INPUT_AUDIO)
+            tb_rate = TB_RATE_AUDIO;
+        UBASE_FATAL(upipe, uref_ts_flow_set_tb_rate(flow_def_dup, tb_rate));
+
+        max_delay = MAX_DELAY_PASSTHROUGH;
+        if (max_delay > input->max_delay)
+            max_delay = input->max_delay;
+        UBASE_FATAL(upipe, uref_ts_flow_set_max_delay(flow_def_dup,
+                                                      max_delay));
+        input->buffer_duration = max_delay;
+
+    } else if (!ubase_ncmp(def, "void.scte35.")) { /* SCTE-35 */
         input->cr_sys = UINT64_MAX;
         input->dts_sys = UINT64_MAX;
         input->pcr_sys = UINT64_MAX;
         input->ready = false;
+        upipe_ts_mux_input_schedule(upipe_ts_mux, input);
         if (!ulist_is_in(upipe_ts_mux_input_to_uchain_psi(input)))
             ulist_add(&upipe_ts_mux->psi_inputs,
                       upipe_ts_mux_input_to_uchain_psi(input));
@@ -1515,6 +1839,8 @@ static int upipe_ts_mux_input_set_flow_def(struct upipe *upipe,
     uint64_t latency = 0;
     uref_clock_get_latency(flow_def, &latency);
     input->input_type = input_type;
+    input->passthrough = passthrough;
+    upipe_ts_mux_input_schedule(upipe_ts_mux, input);
     input->pid = pid;
     input->octetrate = octetrate;
     input->required_octetrate = octetrate + pes_overhead + ts_overhead;
@@ -1828,7 +2154,10 @@ static void upipe_ts_mux_input_free(struct urefcount *urefcount_real)
     struct upipe *upipe = upipe_ts_mux_input_to_upipe(upipe_ts_mux_input);
     struct upipe_ts_mux_program *program =
         upipe_ts_mux_program_from_input_mgr(upipe->mgr);
+    struct upipe_ts_mux *mux = upipe_ts_mux_from_program_mgr(
+                upipe_ts_mux_program_to_upipe(program)->mgr);
 
+    upipe_ts_mux_heap_del(mux, upipe_ts_mux_input);
     upipe_ts_mux_input_clean_sub(upipe);
     if (!upipe_single(upipe_ts_mux_program_to_upipe(program)))
         upipe_ts_mux_program_change(upipe_ts_mux_program_to_upipe(program));
@@ -1858,6 +2187,7 @@ static void upipe_ts_mux_input_no_input(struct upipe *upipe)
     upipe_use(upipe_ts_mux_to_upipe(mux));
 
     upipe_ts_mux_input->deleted = true;
+    upipe_ts_mux_input_schedule(mux, upipe_ts_mux_input);
     if (upipe_ts_mux_input->input_type == UPIPE_TS_MUX_INPUT_SCTE35) {
         ulist_delete(upipe_ts_mux_input_to_uchain_psi(upipe_ts_mux_input));
         upipe_release(upipe_ts_mux_input->encaps);
@@ -2095,6 +2425,7 @@ static void upipe_ts_mux_program_change(struct upipe *upipe)
         upipe_ts_mux_program_from_upipe(upipe);
     uint64_t pcr_pid = UNDEF_PCR, old_pcr_pid = UNDEF_PCR;
     struct upipe_ts_mux_input *pcr_input = NULL, *old_pcr_input = NULL;
+    bool passthrough = false;
 
     struct uchain *uchain;
     ulist_foreach (&upipe_ts_mux_program->inputs, uchain) {
@@ -2104,10 +2435,23 @@ static void upipe_ts_mux_program_change(struct upipe *upipe)
             old_pcr_pid = input->pid;
             old_pcr_input = input;
         }
+        if (input->input_type == UPIPE_TS_MUX_INPUT_UNKNOWN)
+            continue;
+        if (input->passthrough) {
+            /* we cannot insert PCRs in passed-through packets, so keep the
+             * PID carrying the original PCR */
+            passthrough = true;
+            if (ubase_check(uref_ts_flow_get_passthrough_pcr(
+                            input->input_flow_def)) &&
+                (pcr_input == NULL || pcr_pid > input->pid)) {
+                pcr_pid = input->pid;
+                pcr_input = input;
+            }
+            continue;
+        }
         if (input->input_type == UPIPE_TS_MUX_INPUT_OTHER ||
             input->input_type == UPIPE_TS_MUX_INPUT_SCTE35 ||
-            input->input_type == UPIPE_TS_MUX_INPUT_METADATA ||
-            input->input_type == UPIPE_TS_MUX_INPUT_UNKNOWN)
+            input->input_type == UPIPE_TS_MUX_INPUT_METADATA)
             continue;
         if (pcr_input == NULL ||
             (pcr_input->input_type == UPIPE_TS_MUX_INPUT_AUDIO &&
@@ -2122,16 +2466,17 @@ static void upipe_ts_mux_program_change(struct upipe *upipe)
     if (pcr_pid != old_pcr_pid) {
         if (old_pcr_pid != UNDEF_PCR) {
             old_pcr_input->pcr = false;
-            if (old_pcr_input->encaps != NULL)
+            if (old_pcr_input->encaps != NULL && !old_pcr_input->passthrough)
                 upipe_ts_mux_set_pcr_interval(old_pcr_input->encaps, 0);
         }
 
         if (pcr_pid != UNDEF_PCR) {
             pcr_input->pcr = true;
-            if (pcr_input->encaps != NULL)
+            if (pcr_input->encaps != NULL && !pcr_input->passthrough)
                 upipe_ts_mux_set_pcr_interval(pcr_input->encaps,
                         upipe_ts_mux_program->pcr_interval);
-        }
+        } else if (passthrough)
+            upipe_warn(upipe, "no passed-through input carries the PCR");
         upipe_ts_psig_program_set_pcr_pid(upipe_ts_mux_program->psig_program,
                                           pcr_pid);
     }
@@ -2916,6 +3261,8 @@ static struct upipe *upipe_ts_mux_alloc(struct upipe_mgr *mgr,
     upipe_ts_mux->octetrate_in_progress = false;
     upipe_ts_mux->interval = 0;
     upipe_ts_mux->force_pes_alignment = false;
+    upipe_ts_mux->contiguous = false;
+    upipe_ts_mux->pcr_restamp = false;
 
     ulist_init(&upipe_ts_mux->psi_pids);
     ulist_init(&upipe_ts_mux->psi_pids_splice);
@@ -2928,7 +3275,16 @@ static struct upipe *upipe_ts_mux_alloc(struct upipe_mgr *mgr,
     upipe_ts_mux->cr_sys_remainder = 0;
     upipe_ts_mux->uref = NULL;
     upipe_ts_mux->uref_size = 0;
+    upipe_ts_mux->buffer_ubuf = NULL;
+    upipe_ts_mux->buffer = NULL;
+    upipe_ts_mux->buffer_size = 0;
     upipe_ts_mux->preroll = true;
+    for (int date = 0; date < UPIPE_TS_MUX_DATES; date++)
+        upipe_ts_mux->heaps[date] = NULL;
+    upipe_ts_mux->heap_size = upipe_ts_mux->heap_allocated = 0;
+    upipe_ts_mux->input_seq = 0;
+    for (int wait = 0; wait < UPIPE_TS_MUX_WAITS; wait++)
+        upipe_ts_mux->nb_waits[wait] = 0;
 
     uprobe_init(&upipe_ts_mux->probe, upipe_ts_mux_probe, NULL);
     upipe_ts_mux->probe.refcount = upipe_ts_mux_to_urefcount_real(upipe_ts_mux);
@@ -3047,20 +3403,190 @@ static uint64_t upipe_ts_mux_show_increment(struct upipe *upipe)
         mux->total_octetrate;
 }
 
-/** @internal @This splices a ubuf to output.
+/** @internal @This returns a pointer to the next TS packet in the contiguous
+ * buffer of the current aggregation, allocating the aggregation if needed.
+ *
+ * @param upipe description structure of the pipe
+ * @return pointer to TS_SIZE octets to write to, or NULL if the TS packet must
+ * be appended as a ubuf
+ */
+static uint8_t *upipe_ts_mux_get_buffer(struct upipe *upipe)
+{
+    struct upipe_ts_mux *mux = upipe_ts_mux_from_upipe(upipe);
+    if (mux->uref == NULL) {
+        mux->uref = uref_alloc(mux->uref_mgr);
+        if (unlikely(mux->uref == NULL)) {
+            upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+            return NULL;
+        }
+        uref_clock_set_cr_sys(mux->uref, mux->cr_sys);
+
+        if (mux->contiguous) {
+            int size = -1;
+            mux->buffer_ubuf = ubuf_block_alloc(mux->ubuf_mgr, mux->mtu);
+            if (unlikely(mux->buffer_ubuf == NULL ||
+                         !ubase_check(ubuf_block_write(mux->buffer_ubuf, 0,
+                                                       &size,
+                                                       &mux->buffer)))) {
+                upipe_warn(upipe, "unable to allocate a contiguous buffer");
+                ubuf_free(mux->buffer_ubuf);
+                mux->buffer_ubuf = NULL;
+            } else
+                mux->buffer_size = size;
+        }
+    }
+
+    if (mux->buffer_ubuf == NULL ||
+        mux->uref_size + TS_SIZE > mux->buffer_size)
+        return NULL;
+    return mux->buffer + mux->uref_size;
+}
+
+/** @internal @This attaches the contiguous buffer, if any, to the current
+ * aggregation.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_ts_mux_flush_buffer(struct upipe *upipe)
+{
+    struct upipe_ts_mux *mux = upipe_ts_mux_from_upipe(upipe);
+    struct ubuf *ubuf = mux->buffer_ubuf;
+    if (ubuf == NULL)
+        return;
+
+    mux->buffer_ubuf = NULL;
+    mux->buffer = NULL;
+    ubuf_block_unmap(ubuf, 0);
+    if (unlikely(!mux->uref_size)) {
+        ubuf_free(ubuf);
+        return;
+    }
+    if (mux->uref_size < mux->buffer_size)
+        ubuf_block_resize(ubuf, 0, mux->uref_size);
+    uref_attach_ubuf(mux->uref, ubuf);
+}
+
+/** @internal @This accounts for a TS packet appended to our buffer.
+ *
+ * @param upipe description structure of the pipe
+ * @param dts_sys dts_sys associated with the TS packet
+ */
+static void upipe_ts_mux_append_dts(struct upipe *upipe, uint64_t dts_sys)
+{
+    struct upipe_ts_mux *mux = upipe_ts_mux_from_upipe(upipe);
+    uint64_t current_dts_sys;
+    if (dts_sys != UINT64_MAX &&
+        (!ubase_check(uref_clock_get_dts_sys(mux->uref, &current_dts_sys)) ||
+         current_dts_sys > dts_sys))
+        uref_clock_set_cr_dts_delay(mux->uref, dts_sys - mux->cr_sys);
+    mux->uref_size += TS_SIZE;
+}
+
+/** @internal @This appends a ubuf to our buffer.
  *
  * @param upipe description structure of the pipe
- * @param ubuf_p filled in with the ubuf to output, or NULL if none is available
- * @param dts_sys_p filled with the dts_sys of the fragment
+ * @param ubuf ubuf to append
+ * @param dts_sys dts_sys associated with the ubuf
  */
-static void upipe_ts_mux_splice(struct upipe *upipe, struct ubuf **ubuf_p,
-                                uint64_t *dts_sys_p)
+static void upipe_ts_mux_append(struct upipe *upipe, struct ubuf *ubuf,
+                                uint64_t dts_sys)
+{
+    struct upipe_ts_mux *mux = upipe_ts_mux_from_upipe(upipe);
+    uint8_t *buffer = upipe_ts_mux_get_buffer(upipe);
+    if (unlikely(mux->uref == NULL)) {
+        ubuf_free(ubuf);
+        return;
+    }
+
+    if (buffer != NULL) {
+        ubuf_block_extract(ubuf, 0, TS_SIZE, buffer);
+        ubuf_free(ubuf);
+    } else {
+        upipe_ts_mux_flush_buffer(upipe);
+        if (mux->uref->ubuf == NULL)
+            uref_attach_ubuf(mux->uref, ubuf);
+        else
+            uref_block_append(mux->uref, ubuf);
+    }
+    upipe_ts_mux_append_dts(upipe, dts_sys);
+}
+
+/** @internal @This appends a padding TS packet to our buffer.
+ *
+ * @param upipe description structure of the pipe
+ * @return false in case of allocation failure
+ */
+static bool upipe_ts_mux_append_padding(struct upipe *upipe)
+{
+    struct upipe_ts_mux *mux = upipe_ts_mux_from_upipe(upipe);
+    uint8_t *buffer = upipe_ts_mux_get_buffer(upipe);
+    if (unlikely(mux->uref == NULL))
+        return false;
+
+    if (buffer != NULL) {
+        ubuf_block_extract(mux->padding, 0, TS_SIZE, buffer);
+        upipe_ts_mux_append_dts(upipe, UINT64_MAX);
+        return true;
+    }
+
+    struct ubuf *ubuf = ubuf_dup(mux->padding);
+    if (unlikely(ubuf == NULL))
+        return false;
+    upipe_ts_mux_append(upipe, ubuf, UINT64_MAX);
+    return true;
+}
+
+/** @internal @This splices a TS packet from an encaps pipe and appends it to
+ * our buffer.
+ *
+ * @param upipe description structure of the pipe
+ * @param encaps encaps pipe to splice from
+ * @param cr_sys date at which the packet will be muxed
+ * @return true if a TS packet was appended
+ */
+static bool upipe_ts_mux_splice_encaps(struct upipe *upipe,
+                                       struct upipe *encaps, uint64_t cr_sys)
+{
+    struct upipe_ts_mux *mux = upipe_ts_mux_from_upipe(upipe);
+    uint64_t dts_sys;
+    int err;
+
+    uint8_t *buffer = upipe_ts_mux_get_buffer(upipe);
+    if (buffer != NULL) {
+        err = upipe_ts_encaps_splice_buffer(encaps, cr_sys,
+                                            cr_sys + mux->interval,
+                                            buffer, &dts_sys);
+        if (ubase_check(err)) {
+            upipe_ts_mux_append_dts(upipe, dts_sys);
+            return true;
+        }
+    } else {
+        struct ubuf *ubuf = NULL;
+        err = upipe_ts_encaps_splice(encaps, cr_sys, cr_sys + mux->interval,
+                                     &ubuf, &dts_sys);
+        if (ubase_check(err) && ubuf != NULL) {
+            upipe_ts_mux_append(upipe, ubuf, dts_sys);
+            return true;
+        }
+    }
+
+    if (!ubase_check(err)) {
+        upipe_warn(upipe, "internal error in splice");
+        upipe_throw_fatal(upipe, err);
+    }
+    return false;
+}
+
+/** @internal @This splices a TS packet and appends it to our buffer.
+ *
+ * @param upipe description structure of the pipe
+ * @return true if a TS packet was appended, false if none is available
+ */
+static bool upipe_ts_mux_splice(struct upipe *upipe)
 {
     struct upipe_ts_mux *mux = upipe_ts_mux_from_upipe(upipe);
     uint64_t original_cr_sys = mux->cr_sys - mux->latency;
     struct uchain *uchain;
-    int err;
-    *ubuf_p = NULL;
 
     /* Order of priority: 1. PSI */
     while (!ulist_empty(&mux->psi_pids_splice)) {
@@ -3079,107 +3605,63 @@ static void upipe_ts_mux_splice(struct upipe *upipe, struct ubuf **ubuf_p,
         if (psi_pid->cr_sys > original_cr_sys)
             break; /* Too soon */
 
-        err = upipe_ts_encaps_splice(psi_pid->encaps, original_cr_sys,
-                                     original_cr_sys + mux->interval,
-                                     ubuf_p, dts_sys_p);
-        if (!ubase_check(err)) {
-            upipe_warn(upipe, "internal error in splice");
-            upipe_throw_fatal(upipe, err);
-        }
         /* No need to pop uchain as the probe does it for us. */
-        return;
+        return upipe_ts_mux_splice_encaps(upipe, psi_pid->encaps,
+                                          original_cr_sys);
     }
 
-    /* 2. Inputs */
-    uint64_t cr_sys = UINT64_MAX;
-    struct upipe_ts_mux_input *selected_input = NULL;
-    struct uchain *uchain_tmp;
-    ulist_delete_foreach (&mux->programs, uchain, uchain_tmp) {
-        struct upipe_ts_mux_program *program =
-            upipe_ts_mux_program_from_uchain(uchain);
-        upipe_use(upipe_ts_mux_program_to_upipe(program));
-
-        struct uchain *uchain_input, *uchain_tmp2;
-        ulist_delete_foreach (&program->inputs, uchain_input, uchain_tmp2) {
-            struct upipe_ts_mux_input *input =
-                upipe_ts_mux_input_from_uchain(uchain_input);
-            if (input->dts_sys < original_cr_sys) { /* flush */
-                upipe_ts_encaps_splice(input->encaps, original_cr_sys,
-                                       original_cr_sys + mux->interval,
-                                       NULL, NULL);
-
-                if (input->deleted && !input->ready) {
-                    /* This triggers the immediate deletion of the input. */
-                    upipe_release(input->encaps);
-                    continue;
-                }
-            }
-
-            if (input->dts_sys <= original_cr_sys + mux->interval ||
-                input->pcr_sys <= original_cr_sys) {
-                selected_input = input;
-                upipe_release(upipe_ts_mux_program_to_upipe(program));
-                goto upipe_ts_mux_splice_done;
-            }
-            if (input->cr_sys < cr_sys) {
-                selected_input = input;
-                cr_sys = input->cr_sys;
-            }
+    /* 2. Inputs, from the heaps of their next dates */
+    struct upipe_ts_mux_input *selected_input;
+    while ((selected_input =
+                upipe_ts_mux_heap_peek(mux, UPIPE_TS_MUX_DATE_DTS)) != NULL &&
+           selected_input->dts_sys < original_cr_sys) {
+        /* flush */
+        upipe_ts_encaps_splice(selected_input->encaps, original_cr_sys,
+                               original_cr_sys + mux->interval, NULL, NULL);
+
+        if (selected_input->deleted && !selected_input->ready) {
+            struct upipe *program = upipe_ts_mux_program_to_upipe(
+                upipe_ts_mux_program_from_input_mgr(
+                    upipe_ts_mux_input_to_upipe(selected_input)->mgr));
+            upipe_use(program);
+            /* This triggers the immediate deletion of the input. */
+            upipe_release(selected_input->encaps);
+            upipe_release(program);
+            continue;
         }
-
-        upipe_release(upipe_ts_mux_program_to_upipe(program));
+        if (selected_input->dts_sys <= original_cr_sys + mux->interval)
+            goto upipe_ts_mux_splice_done;
     }
 
+    /* Urgent inputs: DTS within the next interval, or PCR due */
+    if (selected_input != NULL &&
+        selected_input->dts_sys <= original_cr_sys + mux->interval)
+        goto upipe_ts_mux_splice_done;
+    selected_input = upipe_ts_mux_heap_peek(mux, UPIPE_TS_MUX_DATE_PCR);
+    if (selected_input != NULL && selected_input->pcr_sys <= original_cr_sys)
+        goto upipe_ts_mux_splice_done;
+
+    selected_input = upipe_ts_mux_heap_peek(mux, UPIPE_TS_MUX_DATE_CR);
     if (selected_input == NULL ||
         selected_input->cr_sys > original_cr_sys)
-        return;
+        return false;
 
+    bool spliced;
+    struct upipe *program;
 upipe_ts_mux_splice_done:
-    err = upipe_ts_encaps_splice(selected_input->encaps, original_cr_sys,
-                                 original_cr_sys + mux->interval,
-                                 ubuf_p, dts_sys_p);
-    if (!ubase_check(err)) {
-        upipe_warn(upipe, "internal error in splice");
-        upipe_throw_fatal(upipe, err);
-    }
+    program = upipe_ts_mux_program_to_upipe(
+        upipe_ts_mux_program_from_input_mgr(
+            upipe_ts_mux_input_to_upipe(selected_input)->mgr));
+    upipe_use(program);
+    spliced = upipe_ts_mux_splice_encaps(upipe, selected_input->encaps,
+                                         original_cr_sys);
 
     if (selected_input->deleted && !selected_input->ready) {
         /* This triggers the immediate deletion of the input. */
         upipe_release(selected_input->encaps);
     }
-}
-
-/** @internal @This appends a uref to our buffer.
- *
- * @param upipe description structure of the pipe
- * @param ubuf ubuf to append
- * @param dts_sys dts_sys associated with the ubuf
- */
-static void upipe_ts_mux_append(struct upipe *upipe, struct ubuf *ubuf,
-                                uint64_t dts_sys)
-{
-    struct upipe_ts_mux *mux = upipe_ts_mux_from_upipe(upipe);
-    if (mux->uref == NULL) {
-        mux->uref = uref_alloc(mux->uref_mgr);
-        if (unlikely(mux->uref == NULL)) {
-            upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
-            ubuf_free(ubuf);
-            return;
-        }
-        uref_clock_set_cr_sys(mux->uref, mux->cr_sys);
-        if (dts_sys != UINT64_MAX)
-            uref_clock_set_cr_dts_delay(mux->uref, dts_sys - mux->cr_sys);
-        uref_attach_ubuf(mux->uref, ubuf);
-    } else {
-        uint64_t current_dts_sys;
-        if (dts_sys != UINT64_MAX &&
-            (!ubase_check(uref_clock_get_dts_sys(mux->uref,
-                                                 &current_dts_sys)) ||
-             current_dts_sys > dts_sys))
-            uref_clock_set_cr_dts_delay(mux->uref, dts_sys - mux->cr_sys);
-        uref_block_append(mux->uref, ubuf);
-    }
-    mux->uref_size += TS_SIZE;
+    upipe_release(program);
+    return spliced;
 }
 
 /** @internal @This completes a uref and outputs it.
@@ -3190,6 +3672,7 @@ static void upipe_ts_mux_append(struct upipe *upipe, struct ubuf *ubuf,
 static void upipe_ts_mux_complete(struct upipe *upipe, struct upump **upump_p)
 {
     struct upipe_ts_mux *mux = upipe_ts_mux_from_upipe(upipe);
+    upipe_ts_mux_flush_buffer(upipe);
     struct uref *uref = mux->uref;
     mux->uref = NULL;
     mux->uref_size = 0;
@@ -3214,12 +3697,8 @@ static void _upipe_ts_mux_watcher(struct upipe *upipe)
 
         while (mux->uref_size < mux->mtu) {
             nb_packets++;
-            struct ubuf *ubuf;
-            uint64_t dts_sys;
-            upipe_ts_mux_splice(upipe, &ubuf, &dts_sys);
-            if (ubuf == NULL)
+            if (!upipe_ts_mux_splice(upipe))
                 break;
-            upipe_ts_mux_append(upipe, ubuf, dts_sys);
         }
 
         uint64_t dts_sys;
@@ -3229,10 +3708,8 @@ static void _upipe_ts_mux_watcher(struct upipe *upipe)
              dts_sys + mux->latency < upipe_ts_mux_show_increment(upipe))) {
             while (mux->uref_size < mux->mtu) {
                 nb_packets++;
-                struct ubuf *ubuf = ubuf_dup(mux->padding);
-                if (ubuf == NULL)
+                if (!upipe_ts_mux_append_padding(upipe))
                     break;
-                upipe_ts_mux_append(upipe, ubuf, UINT64_MAX);
             }
         }
 
@@ -3263,39 +3740,35 @@ static void upipe_ts_mux_watcher(struct upump *upump)
 static uint64_t upipe_ts_mux_check_available(struct upipe *upipe)
 {
     struct upipe_ts_mux *mux = upipe_ts_mux_from_upipe(upipe);
-    uint64_t min_cr_sys = UINT64_MAX;
 
-    struct uchain *uchain_program, *uchain_program_tmp;
-    ulist_delete_foreach (&mux->programs, uchain_program,
-                          uchain_program_tmp) {
-        struct upipe_ts_mux_program *program =
-            upipe_ts_mux_program_from_uchain(uchain_program);
-        upipe_use(upipe_ts_mux_program_to_upipe(program));
+    if (mux->nb_waits[UPIPE_TS_MUX_WAIT_DELETED]) {
+        /* release deleted inputs which have nothing more to output */
+        struct uchain *uchain_program, *uchain_program_tmp;
+        ulist_delete_foreach (&mux->programs, uchain_program,
+                              uchain_program_tmp) {
+            struct upipe_ts_mux_program *program =
+                upipe_ts_mux_program_from_uchain(uchain_program);
+            upipe_use(upipe_ts_mux_program_to_upipe(program));
 
-        struct uchain *uchain_input, *uchain_input_tmp;
-        ulist_delete_foreach (&program->inputs, uchain_input,
-                              uchain_input_tmp) {
-            struct upipe_ts_mux_input *input =
-                upipe_ts_mux_input_from_uchain(uchain_input);
-            if (!input->ready) {
-                if (input->deleted) {
+            struct uchain *uchain_input, *uchain_input_tmp;
+            ulist_delete_foreach (&program->inputs, uchain_input,
+                                  uchain_input_tmp) {
+                struct upipe_ts_mux_input *input =
+                    upipe_ts_mux_input_from_uchain(uchain_input);
+                if (input->wait == UPIPE_TS_MUX_WAIT_DELETED)
                     upipe_release(input->encaps);
-                    continue;
-                } else if (input->input_type != UPIPE_TS_MUX_INPUT_OTHER &&
-                           input->input_type != UPIPE_TS_MUX_INPUT_SCTE35 &&
-                           input->input_type != UPIPE_TS_MUX_INPUT_METADATA &&
-                           (input->input_type != UPIPE_TS_MUX_INPUT_UNKNOWN ||
-                            mux->preroll)) {
-                    upipe_release(upipe_ts_mux_program_to_upipe(program));
-                    return UINT64_MAX;
-                }
             }
-            if (min_cr_sys > input->cr_sys)
-                min_cr_sys = input->cr_sys;
+            upipe_release(upipe_ts_mux_program_to_upipe(program));
         }
-        upipe_release(upipe_ts_mux_program_to_upipe(program));
     }
-    return min_cr_sys;
+
+    if (mux->nb_waits[UPIPE_TS_MUX_WAIT_DATA] ||
+        (mux->preroll && mux->nb_waits[UPIPE_TS_MUX_WAIT_UNKNOWN]))
+        return UINT64_MAX;
+
+    struct upipe_ts_mux_input *input =
+        upipe_ts_mux_heap_peek(mux, UPIPE_TS_MUX_DATE_CR);
+    return input != NULL ? input->cr_sys : UINT64_MAX;
 }
 
 /** @internal @This sets the initial cr_prog of all programs.
@@ -3342,11 +3815,7 @@ static void upipe_ts_mux_work_file(struct upipe *upipe, struct upump **upump_p)
             upipe_ts_mux_prepare_psi(upipe, min_cr_sys, 0);
         }
 
-        struct ubuf *ubuf;
-        uint64_t dts_sys;
-        upipe_ts_mux_splice(upipe, &ubuf, &dts_sys);
-        if (ubuf != NULL) {
-            upipe_ts_mux_append(upipe, ubuf, dts_sys);
+        if (upipe_ts_mux_splice(upipe)) {
             if (mux->uref_size >= mux->mtu) {
                 upipe_ts_mux_complete(upipe, &mux->upump);
                 upipe_ts_mux_increment(upipe);
@@ -3354,6 +3823,7 @@ static void upipe_ts_mux_work_file(struct upipe *upipe, struct upump **upump_p)
             continue;
         }
 
+        uint64_t dts_sys;
         if (mux->mode == UPIPE_TS_MUX_MODE_CAPPED &&
             (mux->uref == NULL ||
              !ubase_check(uref_clock_get_dts_sys(mux->uref, &dts_sys)) ||
@@ -3363,10 +3833,8 @@ static void upipe_ts_mux_work_file(struct upipe *upipe, struct upump **upump_p)
         }
 
         while (mux->uref_size < mux->mtu) {
-            struct ubuf *ubuf = ubuf_dup(mux->padding);
-            if (ubuf == NULL)
+            if (!upipe_ts_mux_append_padding(upipe))
                 break;
-            upipe_ts_mux_append(upipe, ubuf, UINT64_MAX);
         }
 
         upipe_ts_mux_complete(upipe, upump_p);
@@ -3666,7 +4134,8 @@ static void upipe_ts_mux_update(struct upipe *upipe)
             ulist_foreach (&program->inputs, uchain_input) {
                 struct upipe_ts_mux_input *input =
                     upipe_ts_mux_input_from_uchain(uchain_input);
-                if (input->pcr && input->encaps != NULL)
+                if (input->pcr && !input->passthrough &&
+                    input->encaps != NULL)
                     upipe_ts_mux_set_pcr_interval(input->encaps,
                             mux->interval < program->pcr_interval / 2 ?
                             program->pcr_interval -
@@ -4708,6 +5177,78 @@ static int _upipe_ts_mux_force_pes_alignment(struct upipe *upipe,
     return UBASE_ERR_NONE;
 }
 
+/** @internal @This sets whether TS packets are written to a contiguous
+ * buffer. It takes effect from the next output uref.
+ *
+ * @param upipe description structure of the pipe
+ * @param contiguous true for contiguous output buffers
+ * @return an error code
+ */
+static int _upipe_ts_mux_set_contiguous(struct upipe *upipe, bool contiguous)
+{
+    struct upipe_ts_mux *mux = upipe_ts_mux_from_upipe(upipe);
+    mux->contiguous = contiguous;
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This returns whether TS packets are written to a contiguous
+ * buffer.
+ *
+ * @param upipe description structure of the pipe
+ * @param contiguous_p filled in with 1 for contiguous output buffers
+ * @return an error code
+ */
+static int _upipe_ts_mux_get_contiguous(struct upipe *upipe,
+                                        int *contiguous_p)
+{
+    struct upipe_ts_mux *mux = upipe_ts_mux_from_upipe(upipe);
+    if (contiguous_p != NULL)
+        *contiguous_p = mux->contiguous ? 1 : 0;
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This sets whether the PCRs of passed-through TS packets are
+ * restamped.
+ *
+ * @param upipe description structure of the pipe
+ * @param restamp true to restamp PCRs
+ * @return an error code
+ */
+static int _upipe_ts_mux_set_pcr_restamp(struct upipe *upipe, bool restamp)
+{
+    struct upipe_ts_mux *mux = upipe_ts_mux_from_upipe(upipe);
+    mux->pcr_restamp = restamp;
+
+    struct uchain *uchain;
+    ulist_foreach (&mux->programs, uchain) {
+        struct upipe_ts_mux_program *program =
+            upipe_ts_mux_program_from_uchain(uchain);
+        struct uchain *uchain_input;
+        ulist_foreach (&program->inputs, uchain_input) {
+            struct upipe_ts_mux_input *input =
+                upipe_ts_mux_input_from_uchain(uchain_input);
+            if (input->encaps != NULL)
+                upipe_ts_mux_set_pcr_restamp(input->encaps, restamp);
+        }
+    }
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This returns whether the PCRs of passed-through TS packets are
+ * restamped.
+ *
+ * @param upipe description structure of the pipe
+ * @param restamp_p filled in with 1 if PCRs are restamped
+ * @return an error code
+ */
+static int _upipe_ts_mux_get_pcr_restamp(struct upipe *upipe, int *restamp_p)
+{
+    struct upipe_ts_mux *mux = upipe_ts_mux_from_upipe(upipe);
+    if (restamp_p != NULL)
+        *restamp_p = mux->pcr_restamp ? 1 : 0;
+    return UBASE_ERR_NONE;
+}
+
 /** @internal @This sets the default minimum PES duration.
  *
  * @param upipe description structure of the pipe
@@ -4978,6 +5519,26 @@ static int _upipe_ts_mux_control(struct upipe *upipe, int command, va_list args)
             int force = va_arg(args, int);
             return _upipe_ts_mux_force_pes_alignment(upipe, !!force);
         }
+        case UPIPE_TS_MUX_SET_CONTIGUOUS: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_TS_MUX_SIGNATURE)
+            int contiguous = va_arg(args, int);
+            return _upipe_ts_mux_set_contiguous(upipe, !!contiguous);
+        }
+        case UPIPE_TS_MUX_GET_CONTIGUOUS: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_TS_MUX_SIGNATURE)
+            int *contiguous_p = va_arg(args, int *);
+            return _upipe_ts_mux_get_contiguous(upipe, contiguous_p);
+        }
+        case UPIPE_TS_MUX_SET_PCR_RESTAMP: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_TS_MUX_SIGNATURE)
+            int restamp = va_arg(args, int);
+            return _upipe_ts_mux_set_pcr_restamp(upipe, !!restamp);
+        }
+        case UPIPE_TS_MUX_GET_PCR_RESTAMP: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_TS_MUX_SIGNATURE)
+            int *restamp_p = va_arg(args, int *);
+            return _upipe_ts_mux_get_pcr_restamp(upipe, restamp_p);
+        }
 
         case UPIPE_TS_MUX_GET_VERSION:
         case UPIPE_TS_MUX_SET_VERSION:
@@ -5027,13 +5588,9 @@ static void upipe_ts_mux_free(struct urefcount *urefcount_real)
     struct upipe *upipe = upipe_ts_mux_to_upipe(mux);
 
     if (mux->uref != NULL) {
-        size_t uref_size;
-        while ((ubase_check(uref_block_size(mux->uref, &uref_size)) &&
-                uref_size < mux->mtu)) {
-            struct ubuf *ubuf = ubuf_dup(mux->padding);
-            if (ubuf == NULL)
+        while (mux->uref_size < mux->mtu) {
+            if (!upipe_ts_mux_append_padding(upipe))
                 break;
-            upipe_ts_mux_append(upipe, ubuf, UINT64_MAX);
         }
 
         upipe_ts_mux_complete(upipe, NULL);
@@ -5043,6 +5600,8 @@ static void upipe_ts_mux_free(struct urefcount *urefcount_real)
 
     ubuf_free(mux->padding);
     uref_free(mux->flow_def_input);
+    for (int date = 0; date < UPIPE_TS_MUX_DATES; date++)
+        free(mux->heaps[date]);
     uprobe_clean(&mux->probe);
     urefcount_clean(urefcount_real);
     upipe_ts_mux_clean_inner_sink(upipe);
@@ -28,6 +28,7 @@
 #include "upipe-ts/upipe_ts_nit_decoder.h"
 #include "upipe-ts/uref_ts_flow.h"
 #include "upipe_ts_psi_decoder.h"
+#include "upipe_ts_crc32.h"
 
 #include <stdlib.h>
 #include <stdbool.h>
@@ -179,7 +180,7 @@ static bool upipe_ts_nitd_table_validate(struct upipe *upipe)
                                                   &section))))
             return false;
 
-        if (!nit_validate(section) || !psi_check_crc(section)) {
+        if (!nit_validate(section) || !upipe_ts_crc32_check(section)) {
             uref_block_unmap(section_uref, 0);
             return false;
         }
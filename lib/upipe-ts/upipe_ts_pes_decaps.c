@@ -139,6 +139,124 @@ static void upipe_ts_pesd_check_output(struct upipe *upipe,
     upipe_ts_pesd->next_uref = NULL;
 }
 
+/** @internal @This checks if PES packets of the given stream ID carry the
+ * optional PES header.
+ *
+ * @param streamid PES stream ID (other than padding)
+ * @return true if the optional PES header is present
+ */
+static inline bool upipe_ts_pesd_has_optional(uint8_t streamid)
+{
+    return streamid != PES_STREAM_ID_PSM &&
+           streamid != PES_STREAM_ID_PRIVATE_2 &&
+           streamid != PES_STREAM_ID_ECM &&
+           streamid != PES_STREAM_ID_EMM &&
+           streamid != PES_STREAM_ID_PSD &&
+           streamid != PES_STREAM_ID_DSMCC &&
+           streamid != PES_STREAM_ID_H222_1_E;
+}
+
+/** @internal @This attaches the timestamps of the PES header to the next
+ * uref.
+ *
+ * @param upipe description structure of the pipe
+ * @param pts PTS field of the PES header
+ * @param dts DTS field of the PES header, or PTS if there is none
+ * @param validate false if the syntax of the fields is wrong
+ */
+static void upipe_ts_pesd_set_dates(struct upipe *upipe, uint64_t pts,
+                                    uint64_t dts, bool validate)
+{
+    struct upipe_ts_pesd *upipe_ts_pesd = upipe_ts_pesd_from_upipe(upipe);
+    if (unlikely(!validate)) {
+        upipe_warn(upipe, "wrong PES timestamp syntax");
+#if 0
+        /* disable this because it is a common syntax error */
+        upipe_ts_pesd_flush(upipe, true);
+        return;
+#endif
+    }
+
+    uint64_t dts_pts_delay = (POW2_33 + pts - dts) % POW2_33;
+    dts_pts_delay *= UCLOCK_FREQ / 90000;
+    if (dts_pts_delay > MAX_DELAY) {
+        upipe_warn_va(upipe, "invalid PTS field (%"PRIu64" < %"PRIu64")",
+                      pts, dts);
+        dts_pts_delay = 0;
+    }
+    dts *= UCLOCK_FREQ / 90000;
+    uref_clock_set_dts_orig(upipe_ts_pesd->next_uref, dts);
+    uref_clock_set_dts_pts_delay(upipe_ts_pesd->next_uref, dts_pts_delay);
+    upipe_throw_clock_ts(upipe, upipe_ts_pesd->next_uref);
+}
+
+/** @internal @This parses and removes the PES header of a packet in place,
+ * without copies, in the common case where the whole header lies in the
+ * first segment of the buffer. Anything else, including invalid headers,
+ * is left to the generic path.
+ *
+ * @param upipe description structure of the pipe
+ * @param upump_p reference to pump that generated the buffer
+ * @return false if the header must be parsed by the generic path
+ */
+static bool upipe_ts_pesd_decaps_fast(struct upipe *upipe,
+                                      struct upump **upump_p)
+{
+    struct upipe_ts_pesd *upipe_ts_pesd = upipe_ts_pesd_from_upipe(upipe);
+    const uint8_t *pes;
+    int size = -1;
+    if (unlikely(!ubase_check(uref_block_read(upipe_ts_pesd->next_uref, 0,
+                                              &size, &pes))))
+        return false;
+
+    if (unlikely(size < PES_HEADER_SIZE_NOPTS || !pes_validate(pes) ||
+                 pes_get_streamid(pes) == PES_STREAM_ID_PADDING ||
+                 !upipe_ts_pesd_has_optional(pes_get_streamid(pes)) ||
+                 !pes_validate_header(pes))) {
+        uref_block_unmap(upipe_ts_pesd->next_uref, 0);
+        return false;
+    }
+
+    uint16_t length = pes_get_length(pes);
+    uint8_t headerlength = pes_get_headerlength(pes);
+    bool has_pts = pes_has_pts(pes);
+    bool has_dts = pes_has_dts(pes);
+    if (unlikely((length != 0 &&
+                  headerlength + PES_HEADER_OPTIONAL_SIZE > length) ||
+                 (has_pts && headerlength < PES_HEADER_SIZE_PTS -
+                                            PES_HEADER_SIZE_NOPTS) ||
+                 (has_dts && headerlength < PES_HEADER_SIZE_PTSDTS -
+                                            PES_HEADER_SIZE_NOPTS) ||
+                 PES_HEADER_SIZE_NOPTS + headerlength > size)) {
+        uref_block_unmap(upipe_ts_pesd->next_uref, 0);
+        return false;
+    }
+
+    uint64_t pts = 0, dts = 0;
+    bool validate = true;
+    if (has_pts) {
+        validate = pes_validate_pts(pes);
+        pts = dts = pes_get_pts(pes);
+        if (has_dts) {
+            validate = validate && pes_validate_dts(pes);
+            dts = pes_get_dts(pes);
+        }
+    }
+    uref_block_unmap(upipe_ts_pesd->next_uref, 0);
+
+    if (length)
+        upipe_ts_pesd->next_pes_size = length + PES_HEADER_SIZE;
+    else
+        upipe_ts_pesd->next_pes_size = 0;
+    if (has_pts)
+        upipe_ts_pesd_set_dates(upipe, pts, dts, validate);
+
+    UBASE_FATAL(upipe, uref_block_resize(upipe_ts_pesd->next_uref,
+                            PES_HEADER_SIZE_NOPTS + headerlength, -1))
+    upipe_ts_pesd_check_output(upipe, upump_p);
+    return true;
+}
+
 /** @internal @This parses and removes the PES header of a packet.
  *
  * @param upipe description structure of the pipe
@@ -147,6 +265,9 @@ static void upipe_ts_pesd_check_output(struct upipe *upipe,
 static void upipe_ts_pesd_decaps(struct upipe *upipe, struct upump **upump_p)
 {
     struct upipe_ts_pesd *upipe_ts_pesd = upipe_ts_pesd_from_upipe(upipe);
+    if (likely(upipe_ts_pesd_decaps_fast(upipe, upump_p)))
+        return;
+
     uint8_t buffer[PES_HEADER_SIZE];
     const uint8_t *pes_header = uref_block_peek(upipe_ts_pesd->next_uref,
                                                 0, PES_HEADER_SIZE, buffer);
@@ -175,13 +296,7 @@ static void upipe_ts_pesd_decaps(struct upipe *upipe, struct upump **upump_p)
     else
         upipe_ts_pesd->next_pes_size = 0;
 
-    if (streamid == PES_STREAM_ID_PSM ||
-        streamid == PES_STREAM_ID_PRIVATE_2 ||
-        streamid == PES_STREAM_ID_ECM ||
-        streamid == PES_STREAM_ID_EMM ||
-        streamid == PES_STREAM_ID_PSD ||
-        streamid == PES_STREAM_ID_DSMCC ||
-        streamid == PES_STREAM_ID_H222_1_E) {
+    if (!upipe_ts_pesd_has_optional(streamid)) {
         UBASE_FATAL(upipe, uref_block_resize(upipe_ts_pesd->next_uref,
                                              PES_HEADER_SIZE, -1))
         upipe_ts_pesd_check_output(upipe, upump_p);
@@ -250,26 +365,7 @@ static void upipe_ts_pesd_decaps(struct upipe *upipe, struct upump **upump_p)
         UBASE_FATAL(upipe, uref_block_peek_unmap(upipe_ts_pesd->next_uref,
                                     PES_HEADER_SIZE_NOPTS, buffer3, ts_fields))
 
-        if (unlikely(!validate)) {
-            upipe_warn(upipe, "wrong PES timestamp syntax");
-#if 0
-            /* disable this because it is a common syntax error */
-            upipe_ts_pesd_flush(upipe, true);
-            return;
-#endif
-        }
-
-        uint64_t dts_pts_delay = (POW2_33 + pts - dts) % POW2_33;
-        dts_pts_delay *= UCLOCK_FREQ / 90000;
-        if (dts_pts_delay > MAX_DELAY) {
-            upipe_warn_va(upipe, "invalid PTS field (%"PRIu64" < %"PRIu64")",
-                          pts, dts);
-            dts_pts_delay = 0;
-        }
-        dts *= UCLOCK_FREQ / 90000;
-        uref_clock_set_dts_orig(upipe_ts_pesd->next_uref, dts);
-        uref_clock_set_dts_pts_delay(upipe_ts_pesd->next_uref, dts_pts_delay);
-        upipe_throw_clock_ts(upipe, upipe_ts_pesd->next_uref);
+        upipe_ts_pesd_set_dates(upipe, pts, dts, validate);
     }
 
     UBASE_FATAL(upipe, uref_block_resize(upipe_ts_pesd->next_uref,
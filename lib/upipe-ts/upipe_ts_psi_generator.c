@@ -37,6 +37,7 @@
 #include "upipe-ts/upipe_ts_mux.h"
 #include "upipe-ts/uref_ts_flow.h"
 #include "upipe-framers/uref_mpga_flow.h"
+#include "upipe_ts_crc32.h"
 
 #include <stdlib.h>
 #include <stdbool.h>
@@ -1267,7 +1268,7 @@ static void upipe_ts_psig_program_build(struct upipe *upipe)
     uint8_t *es = pmt_get_es(buffer, j);
     pmt_set_length(buffer, es - buffer - PMT_HEADER_SIZE);
     uint16_t pmt_size = psi_get_length(buffer) + PSI_HEADER_SIZE;
-    psi_set_crc(buffer);
+    upipe_ts_crc32_set(buffer);
     ubuf_block_unmap(ubuf, 0);
     ubuf_block_resize(ubuf, 0, pmt_size);
 
@@ -1807,7 +1808,7 @@ static void upipe_ts_psig_build(struct upipe *upipe)
         }
 
         psi_set_lastsection(buffer, nb_sections - 1);
-        psi_set_crc(buffer);
+        upipe_ts_crc32_set(buffer);
 
         ubuf_block_unmap(ubuf, 0);
     }
@@ -24,13 +24,30 @@
 #include "upipe/upipe_helper_subpipe.h"
 #include "upipe-ts/uref_ts_flow.h"
 #include "upipe-ts/upipe_ts_psi_split.h"
+#include "upipe_ts_crc32.h"
 
 #include <stdlib.h>
 #include <stdarg.h>
+#include <string.h>
 
+#include <bitstream/mpeg/psi.h>
 
 /** we only accept blocks containing exactly one PSI section */
 #define EXPECTED_FLOW_DEF "block.mpegtspsi."
+/** initial number of entries of the section cache (power of 2) */
+#define CACHE_MIN_SIZE 64
+
+/** @internal @This is an entry of the section cache. */
+struct upipe_ts_psi_split_cache {
+    /** true if the entry is in use */
+    bool used;
+    /** table ID, table ID extension and section number of the entry */
+    uint32_t key;
+    /** header of the last section stored in this entry */
+    uint8_t header[PSI_HEADER_SIZE_SYNTAX1];
+    /** CRC of the last section stored in this entry */
+    uint32_t crc;
+};
 
 /** @internal @This is the private context of a ts_psi_split pipe. */
 struct upipe_ts_psi_split {
@@ -45,6 +62,15 @@ struct upipe_ts_psi_split {
     /** manager to create output subpipes */
     struct upipe_mgr sub_mgr;
 
+    /** section cache (open addressing), or NULL if disabled */
+    struct upipe_ts_psi_split_cache *cache;
+    /** number of entries of the section cache (power of 2) */
+    size_t cache_size;
+    /** number of entries in use in the section cache */
+    size_t cache_count;
+    /** number of sections dropped by the cache */
+    uint64_t cache_hits;
+
     /** public upipe structure */
     struct upipe upipe;
 };
@@ -113,6 +139,16 @@ static struct upipe *upipe_ts_psi_split_sub_alloc(struct upipe_mgr *mgr,
     upipe_ts_psi_split_sub_init_sub(upipe);
     upipe_ts_psi_split_sub_store_flow_def(upipe, flow_def);
 
+    /* the new output must receive the sections already seen */
+    struct upipe_ts_psi_split *upipe_ts_psi_split =
+        upipe_ts_psi_split_from_sub_mgr(mgr);
+    if (upipe_ts_psi_split->cache != NULL) {
+        memset(upipe_ts_psi_split->cache, 0,
+               sizeof(struct upipe_ts_psi_split_cache) *
+               upipe_ts_psi_split->cache_size);
+        upipe_ts_psi_split->cache_count = 0;
+    }
+
     upipe_throw_ready(upipe);
     return upipe;
 }
@@ -194,10 +230,150 @@ static struct upipe *upipe_ts_psi_split_alloc(struct upipe_mgr *mgr,
                    upipe_ts_psi_split_free);
     upipe_ts_psi_split_init_sub_subs(upipe);
     upipe_ts_psi_split_init_sub_mgr(upipe);
+    upipe_ts_psi_split->cache = NULL;
+    upipe_ts_psi_split->cache_size = 0;
+    upipe_ts_psi_split->cache_count = 0;
+    upipe_ts_psi_split->cache_hits = 0;
     upipe_throw_ready(upipe);
     return upipe;
 }
 
+/** @internal @This checks the CRC of a section which may span several
+ * segments.
+ *
+ * @param uref uref containing the section
+ * @param length total length of the section
+ * @return false if the CRC is wrong
+ */
+static bool upipe_ts_psi_split_check_crc(struct uref *uref, size_t length)
+{
+    uint32_t crc = 0xffffffff;
+    size_t offset = 0;
+    while (offset < length) {
+        const uint8_t *buffer;
+        int size = length - offset;
+        if (unlikely(!ubase_check(uref_block_read(uref, offset, &size,
+                                                  &buffer))))
+            return false;
+        crc = upipe_ts_crc32(crc, buffer, size);
+        uref_block_unmap(uref, offset);
+        offset += size;
+    }
+    return !crc;
+}
+
+/** @internal @This finds the entry of a key in a section cache, or the free
+ * entry where it should be inserted.
+ *
+ * @param cache array of entries
+ * @param size number of entries (power of 2)
+ * @param key table ID, table ID extension and section number
+ * @return pointer to the entry
+ */
+static struct upipe_ts_psi_split_cache *
+    upipe_ts_psi_split_cache_find(struct upipe_ts_psi_split_cache *cache,
+                                  size_t size, uint32_t key)
+{
+    /* fold the high bits of the Fibonacci hash into the low ones */
+    uint32_t hash = key * UINT32_C(0x9e3779b1);
+    size_t i = (hash ^ (hash >> 16)) & (size - 1);
+    while (cache[i].used && cache[i].key != key)
+        i = (i + 1) & (size - 1);
+    return &cache[i];
+}
+
+/** @internal @This doubles the number of entries of the section cache.
+ *
+ * @param upipe description structure of the pipe
+ * @return an error code
+ */
+static int upipe_ts_psi_split_cache_grow(struct upipe *upipe)
+{
+    struct upipe_ts_psi_split *upipe_ts_psi_split =
+        upipe_ts_psi_split_from_upipe(upipe);
+    size_t size = upipe_ts_psi_split->cache_size * 2;
+    struct upipe_ts_psi_split_cache *cache =
+        calloc(size, sizeof(struct upipe_ts_psi_split_cache));
+    if (unlikely(cache == NULL))
+        return UBASE_ERR_ALLOC;
+
+    for (size_t i = 0; i < upipe_ts_psi_split->cache_size; i++)
+        if (upipe_ts_psi_split->cache[i].used)
+            *upipe_ts_psi_split_cache_find(cache, size,
+                    upipe_ts_psi_split->cache[i].key) =
+                upipe_ts_psi_split->cache[i];
+    free(upipe_ts_psi_split->cache);
+    upipe_ts_psi_split->cache = cache;
+    upipe_ts_psi_split->cache_size = size;
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This looks up a section in the cache, and stores it if it
+ * is not a repetition.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref uref containing the section
+ * @return true if the section is a repetition and must be dropped
+ */
+static bool upipe_ts_psi_split_cache_hit(struct upipe *upipe,
+                                         struct uref *uref)
+{
+    struct upipe_ts_psi_split *upipe_ts_psi_split =
+        upipe_ts_psi_split_from_upipe(upipe);
+    uint8_t header[PSI_HEADER_SIZE_SYNTAX1];
+    uint8_t crc_buffer[PSI_CRC_SIZE];
+    size_t size;
+    if (unlikely(!ubase_check(uref_block_extract(uref, 0,
+                        PSI_HEADER_SIZE_SYNTAX1, header)) ||
+                 !psi_get_syntax(header) ||
+                 !ubase_check(uref_block_size(uref, &size))))
+        return false;
+
+    size_t length = psi_get_length(header) + PSI_HEADER_SIZE;
+    if (unlikely(length < PSI_HEADER_SIZE_SYNTAX1 + PSI_CRC_SIZE ||
+                 length > size ||
+                 !ubase_check(uref_block_extract(uref, length - PSI_CRC_SIZE,
+                                                 PSI_CRC_SIZE, crc_buffer))))
+        return false;
+    uint32_t crc = ((uint32_t)crc_buffer[0] << 24) |
+                   ((uint32_t)crc_buffer[1] << 16) |
+                   ((uint32_t)crc_buffer[2] << 8) | crc_buffer[3];
+
+    /* a new version of a section replaces the previous one in its entry */
+    uint32_t key = ((uint32_t)psi_get_tableid(header) << 24) |
+                   ((uint32_t)psi_get_tableidext(header) << 8) |
+                   psi_get_section(header);
+    struct upipe_ts_psi_split_cache *entry =
+        upipe_ts_psi_split_cache_find(upipe_ts_psi_split->cache,
+                                      upipe_ts_psi_split->cache_size, key);
+    if (entry->used && entry->crc == crc &&
+        !memcmp(entry->header, header, PSI_HEADER_SIZE_SYNTAX1)) {
+        upipe_ts_psi_split->cache_hits++;
+        return true;
+    }
+
+    /* do not let a corrupted section mask the next repetitions */
+    if (!upipe_ts_psi_split_check_crc(uref, length))
+        return false;
+
+    if (!entry->used) {
+        /* keep the load factor under 3/4 */
+        if ((upipe_ts_psi_split->cache_count + 1) * 4 >
+            upipe_ts_psi_split->cache_size * 3) {
+            if (unlikely(!ubase_check(upipe_ts_psi_split_cache_grow(upipe))))
+                return false;
+            entry = upipe_ts_psi_split_cache_find(upipe_ts_psi_split->cache,
+                    upipe_ts_psi_split->cache_size, key);
+        }
+        entry->used = true;
+        entry->key = key;
+        upipe_ts_psi_split->cache_count++;
+    }
+    memcpy(entry->header, header, PSI_HEADER_SIZE_SYNTAX1);
+    entry->crc = crc;
+    return false;
+}
+
 /** @internal @This demuxes a PSI section to the appropriate output(s).
  *
  * @param upipe description structure of the pipe
@@ -209,6 +385,12 @@ static void upipe_ts_psi_split_input(struct upipe *upipe, struct uref *uref,
 {
     struct upipe_ts_psi_split *upipe_ts_psi_split =
         upipe_ts_psi_split_from_upipe(upipe);
+    if (upipe_ts_psi_split->cache != NULL &&
+        upipe_ts_psi_split_cache_hit(upipe, uref)) {
+        uref_free(uref);
+        return;
+    }
+
     struct uchain *uchain;
     ulist_foreach (&upipe_ts_psi_split->subs, uchain) {
         struct upipe_ts_psi_split_sub *output =
@@ -255,6 +437,49 @@ static int upipe_ts_psi_split_set_flow_def(struct upipe *upipe,
     return uref_flow_match_def(flow_def, EXPECTED_FLOW_DEF);
 }
 
+/** @internal @This enables or disables the section cache.
+ *
+ * @param upipe description structure of the pipe
+ * @param enabled true to enable the cache
+ * @return an error code
+ */
+static int _upipe_ts_psi_split_set_cache(struct upipe *upipe, bool enabled)
+{
+    struct upipe_ts_psi_split *upipe_ts_psi_split =
+        upipe_ts_psi_split_from_upipe(upipe);
+    if (!enabled) {
+        free(upipe_ts_psi_split->cache);
+        upipe_ts_psi_split->cache = NULL;
+        upipe_ts_psi_split->cache_size = 0;
+        upipe_ts_psi_split->cache_count = 0;
+        return UBASE_ERR_NONE;
+    }
+    if (upipe_ts_psi_split->cache != NULL)
+        return UBASE_ERR_NONE;
+
+    upipe_ts_psi_split->cache =
+        calloc(CACHE_MIN_SIZE, sizeof(struct upipe_ts_psi_split_cache));
+    if (unlikely(upipe_ts_psi_split->cache == NULL))
+        return UBASE_ERR_ALLOC;
+    upipe_ts_psi_split->cache_size = CACHE_MIN_SIZE;
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This returns the number of sections dropped by the cache.
+ *
+ * @param upipe description structure of the pipe
+ * @param hits_p filled in with the number of cache hits
+ * @return an error code
+ */
+static int _upipe_ts_psi_split_get_cache_hits(struct upipe *upipe,
+                                              uint64_t *hits_p)
+{
+    struct upipe_ts_psi_split *upipe_ts_psi_split =
+        upipe_ts_psi_split_from_upipe(upipe);
+    *hits_p = upipe_ts_psi_split->cache_hits;
+    return UBASE_ERR_NONE;
+}
+
 /** @internal @This processes control commands.
  *
  * @param upipe description structure of the pipe
@@ -280,6 +505,16 @@ static int upipe_ts_psi_split_control(struct upipe *upipe,
             struct uref *flow_def = va_arg(args, struct uref *);
             return upipe_ts_psi_split_set_flow_def(upipe, flow_def);
         }
+        case UPIPE_TS_PSI_SPLIT_SET_CACHE: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_TS_PSI_SPLIT_SIGNATURE);
+            bool enabled = !!va_arg(args, int);
+            return _upipe_ts_psi_split_set_cache(upipe, enabled);
+        }
+        case UPIPE_TS_PSI_SPLIT_GET_CACHE_HITS: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_TS_PSI_SPLIT_SIGNATURE);
+            uint64_t *hits_p = va_arg(args, uint64_t *);
+            return _upipe_ts_psi_split_get_cache_hits(upipe, hits_p);
+        }
 
         default:
             return UBASE_ERR_UNHANDLED;
@@ -297,6 +532,7 @@ static void upipe_ts_psi_split_free(struct urefcount *urefcount_real)
     struct upipe *upipe = upipe_ts_psi_split_to_upipe(upipe_ts_psi_split);
     upipe_throw_dead(upipe);
     upipe_ts_psi_split_clean_sub_subs(upipe);
+    free(upipe_ts_psi_split->cache);
     urefcount_clean(urefcount_real);
     upipe_ts_psi_split_clean_urefcount(upipe);
     upipe_ts_psi_split_free_void(upipe);
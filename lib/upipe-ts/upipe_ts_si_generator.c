@@ -40,6 +40,7 @@
 #include "upipe-ts/upipe_ts_mux.h"
 #include "upipe-ts/uref_ts_flow.h"
 #include "upipe-ts/uref_ts_event.h"
+#include "upipe_ts_crc32.h"
 
 #include <stdlib.h>
 #include <stdbool.h>
@@ -542,7 +543,7 @@ static void upipe_ts_sig_service_build_eit(struct upipe *upipe)
 
         eit_set_segment_last_sec_number(buffer, nb_sections - 1);
         psi_set_lastsection(buffer, nb_sections - 1);
-        psi_set_crc(buffer);
+        upipe_ts_crc32_set(buffer);
 
         ubuf_block_unmap(ubuf, 0);
     }
@@ -655,7 +656,7 @@ static void upipe_ts_sig_service_build_eit(struct upipe *upipe)
             psi_set_lastsection(buffer, nb_sections - 1);
         }
         eit_set_last_table_id(buffer, table_id);
-        psi_set_crc(buffer);
+        upipe_ts_crc32_set(buffer);
 
         ubuf_block_unmap(ubuf, 0);
     }
@@ -1293,7 +1294,7 @@ static void upipe_ts_sig_build_nit(struct upipe *upipe)
         }
 
         psi_set_lastsection(buffer, nb_sections - 1);
-        psi_set_crc(buffer);
+        upipe_ts_crc32_set(buffer);
 
         ubuf_block_unmap(ubuf, 0);
     }
@@ -1554,7 +1555,7 @@ static void upipe_ts_sig_build_sdt(struct upipe *upipe)
         }
 
         psi_set_lastsection(buffer, nb_sections - 1);
-        psi_set_crc(buffer);
+        upipe_ts_crc32_set(buffer);
 
         ubuf_block_unmap(ubuf, 0);
     }
@@ -1983,7 +1984,7 @@ static void upipe_ts_sig_send_tdttot(struct upipe *upipe, uint64_t cr_sys,
         }
 
         tot_set_utc(buffer, dvb_time_encode_UTC(now / UCLOCK_FREQ));
-        psi_set_crc(buffer);
+        upipe_ts_crc32_set(buffer);
         ubuf_block_unmap(ubuf, 0);
         uref_block_append(uref, ubuf);
     }
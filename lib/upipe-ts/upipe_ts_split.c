@@ -8,6 +8,12 @@
 
 /** @file
  * @short Upipe module splitting PIDs of a transport stream
+ *
+ * This module accepts either one TS packet per uref ("block.mpegts."), or
+ * vectors of aligned TS packets ("block.mpegtsaligned."). In the latter case,
+ * outputs allocated with a "block.mpegtsaligned." flow definition receive
+ * one vector per input uref with the packets of their PID, while the other
+ * outputs still receive one uref per packet.
  */
 
 #include "upipe/ulist.h"
@@ -25,14 +31,20 @@
 #include "upipe-ts/upipe_ts_split.h"
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <stdbool.h>
 #include <stdarg.h>
 #include <assert.h>
 
 #include <bitstream/mpeg/ts.h>
 
-/** we only accept blocks containing exactly one TS packet */
+/** we accept blocks containing exactly one TS packet */
 #define EXPECTED_FLOW_DEF "block.mpegts."
+/** or vectors of aligned TS packets */
+#define EXPECTED_FLOW_DEF_ALIGNED "block.mpegtsaligned."
+/** TS synchronization word */
+#define TS_SYNC 0x47
 /** maximum number of PIDs */
 #define MAX_PIDS 8192
 
@@ -40,8 +52,6 @@
 struct upipe_ts_split_pid {
     /** subs specific to that PID */
     struct uchain subs;
-    /** true if we asked for this PID */
-    bool set;
 };
 
 /** @internal @This is the private context of a ts split pipe. */
@@ -53,7 +63,14 @@ struct upipe_ts_split {
 
     /** list of output subpipes */
     struct uchain subs;
-
+    /** list of output subpipes with a pending vector */
+    struct uchain pending;
+    /** true if the input carries vectors of TS packets */
+    bool aligned;
+
+    /** bitmap of the PIDs we asked for, checked before the PIDs array so
+     * that unwanted packets are dropped without touching it */
+    uint64_t wanted[MAX_PIDS / 64];
     /** PIDs array */
     struct upipe_ts_split_pid pids[MAX_PIDS];
 
@@ -70,6 +87,18 @@ UPIPE_HELPER_VOID(upipe_ts_split)
 
 UBASE_FROM_TO(upipe_ts_split, urefcount, urefcount_real, urefcount_real)
 
+/** @internal @This checks if a PID has at least one output.
+ *
+ * @param upipe_ts_split private context of the ts split pipe
+ * @param pid PID
+ * @return true if the PID is wanted
+ */
+static inline bool upipe_ts_split_wanted(struct upipe_ts_split *upipe_ts_split,
+                                         uint16_t pid)
+{
+    return upipe_ts_split->wanted[pid / 64] & (UINT64_C(1) << (pid % 64));
+}
+
 /** @hidden */
 static void upipe_ts_split_free(struct urefcount *urefcount_real);
 
@@ -81,6 +110,17 @@ struct upipe_ts_split_sub {
     struct uchain uchain;
     /** structure for double-linked lists, PID */
     struct uchain uchain_pid;
+    /** structure for double-linked lists, pending vectors */
+    struct uchain uchain_pending;
+
+    /** true if the output receives vectors of TS packets */
+    bool aligned;
+    /** vector of TS packets being built */
+    struct uref *vector;
+    /** offset of the run of packets not yet added to the vector */
+    size_t run_offset;
+    /** size of the run of packets not yet added to the vector */
+    size_t run_size;
 
     /** pipe acting as output */
     struct upipe *output;
@@ -104,6 +144,7 @@ UPIPE_HELPER_SUBPIPE(upipe_ts_split, upipe_ts_split_sub, sub, sub_mgr,
                      subs, uchain)
 
 UBASE_FROM_TO(upipe_ts_split_sub, uchain, uchain_pid, uchain_pid)
+UBASE_FROM_TO(upipe_ts_split_sub, uchain, uchain_pending, uchain_pending)
 
 /** @hidden */
 static void upipe_ts_split_pid_set(struct upipe *upipe, uint16_t pid,
@@ -134,6 +175,12 @@ static struct upipe *upipe_ts_split_sub_alloc(struct upipe_mgr *mgr,
         upipe_ts_split_sub_from_upipe(upipe);
     upipe_ts_split_sub_init_urefcount(upipe);
     uchain_init(&upipe_ts_split_sub->uchain_pid);
+    uchain_init(&upipe_ts_split_sub->uchain_pending);
+    upipe_ts_split_sub->aligned =
+        ubase_check(uref_flow_match_def(flow_def, EXPECTED_FLOW_DEF_ALIGNED));
+    upipe_ts_split_sub->vector = NULL;
+    upipe_ts_split_sub->run_offset = 0;
+    upipe_ts_split_sub->run_size = 0;
     upipe_ts_split_sub_init_output(upipe);
     upipe_ts_split_sub_init_sub(upipe);
     upipe_ts_split_sub_store_flow_def(upipe, flow_def);
@@ -193,6 +240,10 @@ static void upipe_ts_split_sub_free(struct upipe *upipe)
                     upipe_ts_split_to_upipe(upipe_ts_split), pid,
                     upipe_ts_split_sub);
     }
+    if (upipe_ts_split_sub->vector != NULL || upipe_ts_split_sub->run_size) {
+        ulist_delete(upipe_ts_split_sub_to_uchain_pending(upipe_ts_split_sub));
+        uref_free(upipe_ts_split_sub->vector);
+    }
 
     upipe_throw_dead(upipe);
     upipe_ts_split_sub_clean_output(upipe);
@@ -238,12 +289,13 @@ static struct upipe *upipe_ts_split_alloc(struct upipe_mgr *mgr,
                    upipe_ts_split_free);
     upipe_ts_split_init_sub_subs(upipe);
     upipe_ts_split_init_sub_mgr(upipe);
+    ulist_init(&upipe_ts_split->pending);
+    upipe_ts_split->aligned = false;
 
+    memset(upipe_ts_split->wanted, 0, sizeof(upipe_ts_split->wanted));
     int i;
-    for (i = 0; i < MAX_PIDS; i++) {
+    for (i = 0; i < MAX_PIDS; i++)
         ulist_init(&upipe_ts_split->pids[i].subs);
-        upipe_ts_split->pids[i].set = false;
-    }
     upipe_throw_ready(upipe);
     return upipe;
 }
@@ -258,16 +310,17 @@ static void upipe_ts_split_pid_check(struct upipe *upipe, uint16_t pid)
 {
     assert(pid < MAX_PIDS);
     struct upipe_ts_split *upipe_ts_split = upipe_ts_split_from_upipe(upipe);
+    uint64_t mask = UINT64_C(1) << (pid % 64);
     if (!ulist_empty(&upipe_ts_split->pids[pid].subs)) {
-        if (!upipe_ts_split->pids[pid].set) {
-            upipe_ts_split->pids[pid].set = true;
+        if (!upipe_ts_split_wanted(upipe_ts_split, pid)) {
+            upipe_ts_split->wanted[pid / 64] |= mask;
             upipe_dbg_va(upipe, "throw ts split add pid %"PRIu16, pid);
             upipe_throw(upipe, UPROBE_TS_SPLIT_ADD_PID,
                         UPIPE_TS_SPLIT_SIGNATURE, (unsigned int)pid);
         }
     } else {
-        if (upipe_ts_split->pids[pid].set) {
-            upipe_ts_split->pids[pid].set = false;
+        if (upipe_ts_split_wanted(upipe_ts_split, pid)) {
+            upipe_ts_split->wanted[pid / 64] &= ~mask;
             upipe_dbg_va(upipe, "throw ts split del pid %"PRIu16, pid);
             upipe_throw(upipe, UPROBE_TS_SPLIT_DEL_PID,
                         UPIPE_TS_SPLIT_SIGNATURE, (unsigned int)pid);
@@ -311,6 +364,132 @@ static void upipe_ts_split_pid_unset(struct upipe *upipe, uint16_t pid,
     upipe_ts_split_pid_check(upipe, pid);
 }
 
+/** @internal @This appends the pending run of packets of an output to its
+ * vector.
+ *
+ * @param output output sub-structure
+ * @param uref vector of TS packets being split
+ * @return an error code
+ */
+static int upipe_ts_split_sub_append(struct upipe_ts_split_sub *output,
+                                     struct uref *uref)
+{
+    if (!output->run_size)
+        return UBASE_ERR_NONE;
+
+    if (output->vector == NULL) {
+        output->vector = uref_block_splice(uref, output->run_offset,
+                                           output->run_size);
+        UBASE_ALLOC_RETURN(output->vector)
+    } else {
+        struct ubuf *ubuf = ubuf_block_splice(uref->ubuf, output->run_offset,
+                                              output->run_size);
+        UBASE_ALLOC_RETURN(ubuf)
+        if (unlikely(!ubase_check(uref_block_append(output->vector, ubuf)))) {
+            ubuf_free(ubuf);
+            return UBASE_ERR_ALLOC;
+        }
+    }
+    output->run_size = 0;
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This demuxes a vector of aligned TS packets to the appropriate
+ * output(s). Contiguous packets of the same PID are spliced at once, and each
+ * vector output receives a single uref.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref uref structure
+ * @param size size of the uref
+ * @param upump_p reference to pump that generated the buffer
+ */
+static void upipe_ts_split_input_vector(struct upipe *upipe, struct uref *uref,
+                                        size_t size, struct upump **upump_p)
+{
+    struct upipe_ts_split *upipe_ts_split = upipe_ts_split_from_upipe(upipe);
+    if (unlikely(size % TS_SIZE))
+        upipe_warn_va(upipe, "dropping %zu trailing octets", size % TS_SIZE);
+
+    for (size_t offset = 0; offset + TS_SIZE <= size; offset += TS_SIZE) {
+        uint8_t buffer[TS_HEADER_SIZE];
+        const uint8_t *ts_header = uref_block_peek(uref, offset,
+                                                   TS_HEADER_SIZE, buffer);
+        if (unlikely(ts_header == NULL)) {
+            upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+            break;
+        }
+        uint8_t sync = ts_header[0];
+        uint16_t pid = ts_get_pid(ts_header);
+        UBASE_FATAL(upipe, uref_block_peek_unmap(uref, offset, buffer,
+                                                 ts_header))
+        if (unlikely(sync != TS_SYNC)) {
+            upipe_warn_va(upipe, "invalid TS sync 0x%"PRIx8", dropping %zu "
+                          "octets", sync, size - offset);
+            break;
+        }
+        if (!upipe_ts_split_wanted(upipe_ts_split, pid))
+            continue;
+
+        struct uchain *uchain, *uchain_tmp;
+        ulist_delete_foreach(&upipe_ts_split->pids[pid].subs, uchain,
+                             uchain_tmp) {
+            struct upipe_ts_split_sub *output =
+                upipe_ts_split_sub_from_uchain_pid(uchain);
+            if (output->aligned) {
+                if (output->run_size &&
+                    output->run_offset + output->run_size == offset) {
+                    output->run_size += TS_SIZE;
+                    continue;
+                }
+                bool pending = output->vector != NULL || output->run_size;
+                if (unlikely(!ubase_check(
+                        upipe_ts_split_sub_append(output, uref)))) {
+                    upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+                    continue;
+                }
+                if (!pending)
+                    ulist_add(&upipe_ts_split->pending,
+                              upipe_ts_split_sub_to_uchain_pending(output));
+                output->run_offset = offset;
+                output->run_size = TS_SIZE;
+                continue;
+            }
+
+            /* materialize a uref for this packet */
+            struct uref *packet = uref_block_splice(uref, offset, TS_SIZE);
+            if (unlikely(packet == NULL)) {
+                upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+                continue;
+            }
+            upipe_ts_split_sub_output(upipe_ts_split_sub_to_upipe(output),
+                                      packet, upump_p);
+        }
+    }
+
+    struct uchain *uchain;
+    while ((uchain = ulist_pop(&upipe_ts_split->pending)) != NULL) {
+        struct upipe_ts_split_sub *output =
+            upipe_ts_split_sub_from_uchain_pending(uchain);
+        if (output->vector == NULL && output->run_offset == 0 &&
+            output->run_size == size && ulist_empty(&upipe_ts_split->pending)) {
+            /* the last output takes the whole vector, forward it as is */
+            output->run_size = 0;
+            upipe_ts_split_sub_output(upipe_ts_split_sub_to_upipe(output),
+                                      uref, upump_p);
+            return;
+        }
+        if (unlikely(!ubase_check(upipe_ts_split_sub_append(output, uref))))
+            upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+        struct uref *vector = output->vector;
+        output->vector = NULL;
+        output->run_size = 0;
+        if (likely(vector != NULL))
+            upipe_ts_split_sub_output(upipe_ts_split_sub_to_upipe(output),
+                                      vector, upump_p);
+    }
+    uref_free(uref);
+}
+
 /** @internal @This demuxes a TS packet to the appropriate output(s).
  *
  * @param upipe description structure of the pipe
@@ -321,6 +500,17 @@ static void upipe_ts_split_input(struct upipe *upipe, struct uref *uref,
                                  struct upump **upump_p)
 {
     struct upipe_ts_split *upipe_ts_split = upipe_ts_split_from_upipe(upipe);
+    if (upipe_ts_split->aligned) {
+        size_t size;
+        if (unlikely(!ubase_check(uref_block_size(uref, &size)))) {
+            uref_free(uref);
+            upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+            return;
+        }
+        upipe_ts_split_input_vector(upipe, uref, size, upump_p);
+        return;
+    }
+
     uint8_t buffer[TS_HEADER_SIZE];
     const uint8_t *ts_header = uref_block_peek(uref, 0, TS_HEADER_SIZE,
                                                buffer);
@@ -331,12 +521,19 @@ static void upipe_ts_split_input(struct upipe *upipe, struct uref *uref,
     }
     uint16_t pid = ts_get_pid(ts_header);
     UBASE_FATAL(upipe, uref_block_peek_unmap(uref, 0, buffer, ts_header))
+    if (!upipe_ts_split_wanted(upipe_ts_split, pid)) {
+        uref_free(uref);
+        return;
+    }
 
+    /* only duplicate for true fan-out, the last output gets the original */
     struct uchain *uchain, *uchain_tmp;
     ulist_delete_foreach(&upipe_ts_split->pids[pid].subs, uchain, uchain_tmp) {
         struct upipe_ts_split_sub *output =
                 upipe_ts_split_sub_from_uchain_pid(uchain);
-        if (likely(uchain->next == NULL)) {
+        if (unlikely(uref == NULL))
+            break;
+        if (likely(ulist_is_last(&upipe_ts_split->pids[pid].subs, uchain))) {
             upipe_ts_split_sub_output(upipe_ts_split_sub_to_upipe(output),
                                       uref, upump_p);
             uref = NULL;
@@ -368,7 +565,15 @@ static int upipe_ts_split_set_flow_def(struct upipe *upipe,
 {
     if (flow_def == NULL)
         return UBASE_ERR_INVALID;
-    return uref_flow_match_def(flow_def, EXPECTED_FLOW_DEF);
+    struct upipe_ts_split *upipe_ts_split = upipe_ts_split_from_upipe(upipe);
+    if (ubase_check(uref_flow_match_def(flow_def,
+                                        EXPECTED_FLOW_DEF_ALIGNED))) {
+        upipe_ts_split->aligned = true;
+        return UBASE_ERR_NONE;
+    }
+    UBASE_RETURN(uref_flow_match_def(flow_def, EXPECTED_FLOW_DEF))
+    upipe_ts_split->aligned = false;
+    return UBASE_ERR_NONE;
 }
 
 /** @internal @This processes control commands.
@@ -32,10 +32,12 @@
 #include "upipe/upipe_helper_output.h"
 #include "upipe/upipe_helper_output_size.h"
 #include "upipe-ts/upipe_ts_sync.h"
+#include "upipe_ts_sync_scan.h"
 
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#include <string.h>
 #include <assert.h>
 
 #include <bitstream/mpeg/ts.h>
@@ -48,6 +50,8 @@
 #define OUTPUT_FLOW_DEF "block.mpegts."
 /** otherwise there is a suffix to decaps */
 #define SUFFIX_OUTPUT_FLOW_DEF "block.mpegtssuffix."
+/** in batch mode we output vectors of TS packets */
+#define BATCH_OUTPUT_FLOW_DEF "block.mpegtsaligned."
 /** TS synchronization word */
 #define TS_SYNC 0x47
 
@@ -69,6 +73,13 @@ struct upipe_ts_sync {
     size_t output_size;
     /** number of packets to sync with */
     unsigned int ts_sync;
+    /** maximum number of packets per output uref */
+    unsigned int batch;
+    /** input flow definition packet */
+    struct uref *flow_def_input;
+    /** function scanning a contiguous buffer for sync words */
+    size_t (*scan)(const uint8_t *buffer, size_t size, size_t stride,
+                   unsigned int count);
     /** next uref to be processed */
     struct uref *next_uref;
     /** original size of the next uref */
@@ -91,6 +102,24 @@ UPIPE_HELPER_UREF_STREAM(upipe_ts_sync, next_uref, next_uref_size, urefs, NULL)
 UPIPE_HELPER_OUTPUT(upipe_ts_sync, output, flow_def, output_state, request_list)
 UPIPE_HELPER_OUTPUT_SIZE(upipe_ts_sync, output_size)
 
+/** @internal @This selects the function scanning for sync words.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_ts_sync_setup_scan(struct upipe *upipe)
+{
+    struct upipe_ts_sync *upipe_ts_sync = upipe_ts_sync_from_upipe(upipe);
+    upipe_ts_sync->scan = upipe_ts_sync_scan_c;
+
+#if defined(__GNUC__) && defined(__x86_64__)
+    upipe_ts_sync->scan = upipe_ts_sync_scan_sse2;
+    if (__builtin_cpu_supports("avx2"))
+        upipe_ts_sync->scan = upipe_ts_sync_scan_avx2;
+#elif defined(__GNUC__) && defined(__aarch64__)
+    upipe_ts_sync->scan = upipe_ts_sync_scan_neon;
+#endif
+}
+
 /** @internal @This allocates a ts_sync pipe.
  *
  * @param mgr common management structure
@@ -114,12 +143,46 @@ static struct upipe *upipe_ts_sync_alloc(struct upipe_mgr *mgr,
     upipe_ts_sync_init_output(upipe);
     upipe_ts_sync_init_output_size(upipe, TS_SIZE);
     upipe_ts_sync->ts_sync = DEFAULT_TS_SYNC;
+    upipe_ts_sync->batch = 1;
+    upipe_ts_sync->flow_def_input = NULL;
+    upipe_ts_sync_setup_scan(upipe);
     upipe_ts_sync->next_uref = NULL;
     ulist_init(&upipe_ts_sync->urefs);
     upipe_throw_ready(upipe);
     return upipe;
 }
 
+/** @internal @This returns the number of consecutive sync words in the
+ * working buffer, starting at the given offset.
+ *
+ * @param upipe description structure of the pipe
+ * @param offset offset of the first sync word
+ * @param max maximum number of sync words to check
+ * @return number of sync words
+ */
+static unsigned int upipe_ts_sync_words(struct upipe *upipe, size_t offset,
+                                        unsigned int max)
+{
+    struct upipe_ts_sync *upipe_ts_sync = upipe_ts_sync_from_upipe(upipe);
+    unsigned int words = 0;
+    while (words < max) {
+        const uint8_t *buffer;
+        int size = -1;
+        if (unlikely(!ubase_check(uref_block_read(upipe_ts_sync->next_uref,
+                                          offset, &size, &buffer))))
+            break;
+        unsigned int chunk = upipe_ts_sync_validate(buffer, size,
+                upipe_ts_sync->output_size, max - words);
+        uref_block_unmap(upipe_ts_sync->next_uref, offset);
+        words += chunk;
+        offset += chunk * upipe_ts_sync->output_size;
+        if (chunk * upipe_ts_sync->output_size < size)
+            /* mismatch, or enough words */
+            break;
+    }
+    return words;
+}
+
 /** @internal @This checks the presence of the required number of sync words
  * in the working buffer.
  *
@@ -131,35 +194,63 @@ static struct upipe *upipe_ts_sync_alloc(struct upipe_mgr *mgr,
 static bool upipe_ts_sync_check(struct upipe *upipe, size_t *offset_p)
 {
     struct upipe_ts_sync *upipe_ts_sync = upipe_ts_sync_from_upipe(upipe);
+    size_t stride = upipe_ts_sync->output_size;
+    unsigned int count = upipe_ts_sync->ts_sync;
+    size_t span = (count - 1) * stride + 1;
+    size_t total_size;
+    if (unlikely(!ubase_check(uref_block_size(upipe_ts_sync->next_uref,
+                                              &total_size))))
+        return false;
+
     for ( ; ; ) {
+        /* candidates entirely in a contiguous segment */
+        const uint8_t *buffer;
+        int size = -1;
+        if (unlikely(!ubase_check(uref_block_read(upipe_ts_sync->next_uref,
+                                          *offset_p, &size, &buffer))))
+            return false;
+        if (size >= span) {
+            size_t found = upipe_ts_sync->scan(buffer, size, stride, count);
+            uref_block_unmap(upipe_ts_sync->next_uref, *offset_p);
+            *offset_p += found;
+            if (found + span <= size)
+                return true;
+        } else
+            uref_block_unmap(upipe_ts_sync->next_uref, *offset_p);
+
+        /* candidate spanning several segments */
         if (unlikely(!ubase_check(uref_block_scan(upipe_ts_sync->next_uref,
                                                   offset_p, TS_SYNC))))
             return false;
-
-        /* first octet at *offset_p is a sync word */
-        int ts_sync = upipe_ts_sync->ts_sync - 1;
-        for (int offset = *offset_p + upipe_ts_sync->output_size; ts_sync;
-             ts_sync--, offset += upipe_ts_sync->output_size) {
-            const uint8_t *buffer;
-            int size = 1;
-            uint8_t word;
-            if (unlikely(!ubase_check(uref_block_read(upipe_ts_sync->next_uref,
-                                          offset, &size, &buffer))))
-                /* not enough sync words could be tested */
-                return false;
-            assert(size == 1);
-            word = *buffer;
-            uref_block_unmap(upipe_ts_sync->next_uref, offset);
-            if (word != TS_SYNC) {
-                *offset_p += 1;
-                break;
-            }
-        }
-        if (!ts_sync)
-            break;
+        unsigned int words = upipe_ts_sync_words(upipe, *offset_p, count);
+        if (words == count)
+            return true;
+        if (*offset_p + words * stride >= total_size)
+            /* not enough sync words could be tested */
+            return false;
+        *offset_p += 1;
     }
+}
 
-    return true;
+/** @internal @This returns the number of TS packets that may be extracted at
+ * once from the start of the working buffer. Like @ref upipe_ts_sync_check,
+ * a packet is only considered if the configured number of sync words
+ * following it are present.
+ *
+ * @param upipe description structure of the pipe
+ * @return number of packets, at least 1
+ */
+static unsigned int upipe_ts_sync_count(struct upipe *upipe)
+{
+    struct upipe_ts_sync *upipe_ts_sync = upipe_ts_sync_from_upipe(upipe);
+    if (upipe_ts_sync->batch <= 1 || upipe_ts_sync->output_size != TS_SIZE)
+        return 1;
+
+    unsigned int words = upipe_ts_sync_words(upipe, 0,
+            upipe_ts_sync->batch + upipe_ts_sync->ts_sync - 1);
+    /* sync words at 0 .. ts_sync - 1 have already been checked */
+    assert(words >= upipe_ts_sync->ts_sync);
+    return words - upipe_ts_sync->ts_sync + 1;
 }
 
 /** @internal @This flushes all input buffers.
@@ -221,7 +312,7 @@ static void upipe_ts_sync_input(struct upipe *upipe, struct uref *uref,
         /* upipe_ts_sync_check said there is at least one TS packet there. */
         upipe_ts_sync_sync_acquired(upipe);
         struct uref *output = upipe_ts_sync_extract_uref_stream(upipe,
-                                                    upipe_ts_sync->output_size);
+                upipe_ts_sync_count(upipe) * upipe_ts_sync->output_size);
         if (unlikely(output == NULL)) {
             upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
             continue;
@@ -230,6 +321,38 @@ static void upipe_ts_sync_input(struct upipe *upipe, struct uref *uref,
     }
 }
 
+/** @internal @This builds the output flow definition.
+ *
+ * @param upipe description structure of the pipe
+ * @return an error code
+ */
+static int upipe_ts_sync_build_flow_def(struct upipe *upipe)
+{
+    struct upipe_ts_sync *upipe_ts_sync = upipe_ts_sync_from_upipe(upipe);
+    if (upipe_ts_sync->flow_def_input == NULL)
+        return UBASE_ERR_NONE;
+
+    struct uref *flow_def_dup;
+    if (unlikely((flow_def_dup =
+                  uref_dup(upipe_ts_sync->flow_def_input)) == NULL)) {
+        upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+        return UBASE_ERR_ALLOC;
+    }
+    bool batch = upipe_ts_sync->batch > 1 &&
+                 upipe_ts_sync->output_size == TS_SIZE;
+    if (unlikely(!ubase_check(uref_block_flow_set_size(flow_def_dup,
+                                upipe_ts_sync->output_size)) ||
+                 !ubase_check(uref_flow_set_def(flow_def_dup,
+                                batch ? BATCH_OUTPUT_FLOW_DEF :
+                                        OUTPUT_FLOW_DEF)))) {
+        uref_free(flow_def_dup);
+        upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+        return UBASE_ERR_ALLOC;
+    }
+    upipe_ts_sync_store_flow_def(upipe, flow_def_dup);
+    return UBASE_ERR_NONE;
+}
+
 /** @internal @This sets the input flow definition.
  *
  * @param upipe description structure of the pipe
@@ -248,11 +371,9 @@ static int upipe_ts_sync_set_flow_def(struct upipe *upipe,
         return UBASE_ERR_ALLOC;
     }
     struct upipe_ts_sync *upipe_ts_sync = upipe_ts_sync_from_upipe(upipe);
-    UBASE_RETURN(uref_block_flow_set_size(flow_def_dup,
-                                          upipe_ts_sync->output_size))
-    UBASE_RETURN(uref_flow_set_def(flow_def_dup, OUTPUT_FLOW_DEF))
-    upipe_ts_sync_store_flow_def(upipe, flow_def_dup);
-    return UBASE_ERR_NONE;
+    uref_free(upipe_ts_sync->flow_def_input);
+    upipe_ts_sync->flow_def_input = flow_def_dup;
+    return upipe_ts_sync_build_flow_def(upipe);
 }
 
 /** @internal @This returns the configured number of packets to synchronize
@@ -287,6 +408,37 @@ static int _upipe_ts_sync_set_sync(struct upipe *upipe, int sync)
     return UBASE_ERR_NONE;
 }
 
+/** @internal @This returns the maximum number of packets per output buffer.
+ *
+ * @param upipe description structure of the pipe
+ * @param batch_p filled in with number of packets
+ * @return an error code
+ */
+static int _upipe_ts_sync_get_batch(struct upipe *upipe,
+                                    unsigned int *batch_p)
+{
+    struct upipe_ts_sync *upipe_ts_sync = upipe_ts_sync_from_upipe(upipe);
+    assert(batch_p != NULL);
+    *batch_p = upipe_ts_sync->batch;
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This sets the maximum number of packets per output buffer.
+ * Vectors are only output with standard 188-octet packets.
+ *
+ * @param upipe description structure of the pipe
+ * @param batch number of packets
+ * @return an error code
+ */
+static int _upipe_ts_sync_set_batch(struct upipe *upipe, unsigned int batch)
+{
+    struct upipe_ts_sync *upipe_ts_sync = upipe_ts_sync_from_upipe(upipe);
+    if (!batch)
+        return UBASE_ERR_INVALID;
+    upipe_ts_sync->batch = batch;
+    return upipe_ts_sync_build_flow_def(upipe);
+}
+
 /** @internal @This processes control commands on a ts sync pipe.
  *
  * @param upipe description structure of the pipe
@@ -316,6 +468,16 @@ static int upipe_ts_sync_control(struct upipe *upipe,
             int sync = va_arg(args, int);
             return _upipe_ts_sync_set_sync(upipe, sync);
         }
+        case UPIPE_TS_SYNC_GET_BATCH: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_TS_SYNC_SIGNATURE)
+            unsigned int *batch_p = va_arg(args, unsigned int *);
+            return _upipe_ts_sync_get_batch(upipe, batch_p);
+        }
+        case UPIPE_TS_SYNC_SET_BATCH: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_TS_SYNC_SIGNATURE)
+            unsigned int batch = va_arg(args, unsigned int);
+            return _upipe_ts_sync_set_batch(upipe, batch);
+        }
         default:
             return UBASE_ERR_UNHANDLED;
     }
@@ -327,10 +489,12 @@ static int upipe_ts_sync_control(struct upipe *upipe,
  */
 static void upipe_ts_sync_free(struct upipe *upipe)
 {
+    struct upipe_ts_sync *upipe_ts_sync = upipe_ts_sync_from_upipe(upipe);
     upipe_ts_sync_flush(upipe, NULL);
     upipe_throw_dead(upipe);
 
     upipe_ts_sync_clean_uref_stream(upipe);
+    uref_free(upipe_ts_sync->flow_def_input);
     upipe_ts_sync_clean_output(upipe);
     upipe_ts_sync_clean_output_size(upipe);
     upipe_ts_sync_clean_sync(upipe);
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short Upipe search for TS synchronization words
+ *
+ * The SIMD versions compare a vector of candidates with the sync word, then
+ * AND the comparisons of the vectors loaded one stride later, so that a
+ * remaining lane means the given number of consecutive sync words.
+ */
+
+#include "upipe_ts_sync_scan.h"
+
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+/** TS synchronization word */
+#define TS_SYNC 0x47
+
+/** @This returns the number of consecutive sync words found in a
+ * contiguous buffer.
+ *
+ * @param buffer pointer to the buffer
+ * @param size size of the buffer
+ * @param stride distance between sync words
+ * @param max maximum number of sync words to check
+ * @return number of sync words
+ */
+unsigned int upipe_ts_sync_validate(const uint8_t *buffer, size_t size,
+                                    size_t stride, unsigned int max)
+{
+    unsigned int words = 0;
+    for (size_t offset = 0; words < max && offset < size; offset += stride) {
+        if (buffer[offset] != TS_SYNC)
+            break;
+        words++;
+    }
+    return words;
+}
+
+/** @This scans a contiguous buffer for the first offset followed
+ * by the given number of sync words.
+ *
+ * @param buffer pointer to the buffer
+ * @param size size of the buffer, at least (count - 1) * stride
+ * @param stride distance between sync words
+ * @param count number of sync words
+ * @return offset of the first match, or the first offset that could not be
+ * tested
+ */
+size_t upipe_ts_sync_scan_c(const uint8_t *buffer, size_t size,
+                            size_t stride, unsigned int count)
+{
+    size_t end = size - (count - 1) * stride;
+    for (size_t i = 0; i < end; i++) {
+        const uint8_t *match = memchr(buffer + i, TS_SYNC, end - i);
+        if (match == NULL)
+            break;
+        i = match - buffer;
+        if (upipe_ts_sync_validate(buffer + i, size - i, stride, count) ==
+            count)
+            return i;
+    }
+    return end;
+}
+
+#if defined(__GNUC__) && defined(__x86_64__)
+/** @This scans a contiguous buffer for sync words, 16 candidates
+ * at a time.
+ *
+ * @param buffer pointer to the buffer
+ * @param size size of the buffer, at least (count - 1) * stride
+ * @param stride distance between sync words
+ * @param count number of sync words
+ * @return offset of the first match, or the first offset that could not be
+ * tested
+ */
+size_t upipe_ts_sync_scan_sse2(const uint8_t *buffer, size_t size,
+                               size_t stride, unsigned int count)
+{
+    size_t end = size - (count - 1) * stride;
+    const __m128i sync = _mm_set1_epi8(TS_SYNC);
+    size_t i;
+    for (i = 0; i + 16 <= end; i += 16) {
+        __m128i match = _mm_cmpeq_epi8(
+                _mm_loadu_si128((const __m128i *)(buffer + i)), sync);
+        for (unsigned int k = 1; k < count && _mm_movemask_epi8(match); k++)
+            match = _mm_and_si128(match, _mm_cmpeq_epi8(
+                _mm_loadu_si128((const __m128i *)(buffer + i + k * stride)),
+                sync));
+        int mask = _mm_movemask_epi8(match);
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    return i + upipe_ts_sync_scan_c(buffer + i, size - i, stride, count);
+}
+
+/** @This scans a contiguous buffer for sync words, 32 candidates
+ * at a time.
+ *
+ * @param buffer pointer to the buffer
+ * @param size size of the buffer, at least (count - 1) * stride
+ * @param stride distance between sync words
+ * @param count number of sync words
+ * @return offset of the first match, or the first offset that could not be
+ * tested
+ */
+__attribute__((target("avx2")))
+size_t upipe_ts_sync_scan_avx2(const uint8_t *buffer, size_t size,
+                               size_t stride, unsigned int count)
+{
+    size_t end = size - (count - 1) * stride;
+    const __m256i sync = _mm256_set1_epi8(TS_SYNC);
+    size_t i;
+    for (i = 0; i + 32 <= end; i += 32) {
+        __m256i match = _mm256_cmpeq_epi8(
+                _mm256_loadu_si256((const __m256i *)(buffer + i)), sync);
+        for (unsigned int k = 1; k < count && _mm256_movemask_epi8(match); k++)
+            match = _mm256_and_si256(match, _mm256_cmpeq_epi8(
+                _mm256_loadu_si256((const __m256i *)(buffer + i + k * stride)),
+                sync));
+        unsigned int mask = _mm256_movemask_epi8(match);
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    return i + upipe_ts_sync_scan_sse2(buffer + i, size - i, stride, count);
+}
+#endif
+
+#if defined(__GNUC__) && defined(__aarch64__)
+/** @This scans a contiguous buffer for sync words, 16 candidates
+ * at a time.
+ *
+ * @param buffer pointer to the buffer
+ * @param size size of the buffer, at least (count - 1) * stride
+ * @param stride distance between sync words
+ * @param count number of sync words
+ * @return offset of the first match, or the first offset that could not be
+ * tested
+ */
+size_t upipe_ts_sync_scan_neon(const uint8_t *buffer, size_t size,
+                               size_t stride, unsigned int count)
+{
+    size_t end = size - (count - 1) * stride;
+    const uint8x16_t sync = vdupq_n_u8(TS_SYNC);
+    size_t i;
+    for (i = 0; i + 16 <= end; i += 16) {
+        uint8x16_t match = vceqq_u8(vld1q_u8(buffer + i), sync);
+        for (unsigned int k = 1; k < count && vmaxvq_u8(match); k++)
+            match = vandq_u8(match,
+                    vceqq_u8(vld1q_u8(buffer + i + k * stride), sync));
+        if (vmaxvq_u8(match)) {
+            uint8_t lanes[16];
+            vst1q_u8(lanes, match);
+            for (int j = 0; ; j++)
+                if (lanes[j])
+                    return i + j;
+        }
+    }
+    return i + upipe_ts_sync_scan_c(buffer + i, size - i, stride, count);
+}
+#endif
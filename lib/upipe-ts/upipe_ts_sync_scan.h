@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short Upipe search for TS synchronization words
+ * The scan functions look for the first offset of a contiguous buffer followed
+ * by a given number of sync words, with SIMD versions selected at runtime by
+ * the ts_sync pipe.
+ */
+
+#ifndef _UPIPE_TS_UPIPE_TS_SYNC_SCAN_H_
+/** @hidden */
+#define _UPIPE_TS_UPIPE_TS_SYNC_SCAN_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/** @This returns the number of consecutive sync words found in a
+ * contiguous buffer.
+ *
+ * @param buffer pointer to the buffer
+ * @param size size of the buffer
+ * @param stride distance between sync words
+ * @param max maximum number of sync words to check
+ * @return number of sync words
+ */
+unsigned int upipe_ts_sync_validate(const uint8_t *buffer, size_t size,
+                                    size_t stride, unsigned int max);
+
+/** @This scans a contiguous buffer for the first offset followed by the
+ * given number of sync words.
+ *
+ * @param buffer pointer to the buffer
+ * @param size size of the buffer, at least (count - 1) * stride
+ * @param stride distance between sync words
+ * @param count number of sync words
+ * @return offset of the first match, or the first offset that could not be
+ * tested
+ */
+size_t upipe_ts_sync_scan_c(const uint8_t *buffer, size_t size,
+                            size_t stride, unsigned int count);
+
+#if defined(__GNUC__) && defined(__x86_64__)
+/** @This scans a contiguous buffer for sync words, 16 candidates at a time.
+ * It gives the same result as @ref upipe_ts_sync_scan_c.
+ *
+ * @param buffer pointer to the buffer
+ * @param size size of the buffer, at least (count - 1) * stride
+ * @param stride distance between sync words
+ * @param count number of sync words
+ * @return offset of the first match, or the first offset that could not be
+ * tested
+ */
+size_t upipe_ts_sync_scan_sse2(const uint8_t *buffer, size_t size,
+                               size_t stride, unsigned int count);
+
+/** @This scans a contiguous buffer for sync words, 32 candidates at a time.
+ * It requires AVX2 and gives the same result as @ref upipe_ts_sync_scan_c.
+ *
+ * @param buffer pointer to the buffer
+ * @param size size of the buffer, at least (count - 1) * stride
+ * @param stride distance between sync words
+ * @param count number of sync words
+ * @return offset of the first match, or the first offset that could not be
+ * tested
+ */
+size_t upipe_ts_sync_scan_avx2(const uint8_t *buffer, size_t size,
+                               size_t stride, unsigned int count);
+#endif
+
+#if defined(__GNUC__) && defined(__aarch64__)
+/** @This scans a contiguous buffer for sync words, 16 candidates at a time.
+ * It gives the same result as @ref upipe_ts_sync_scan_c.
+ *
+ * @param buffer pointer to the buffer
+ * @param size size of the buffer, at least (count - 1) * stride
+ * @param stride distance between sync words
+ * @param count number of sync words
+ * @return offset of the first match, or the first offset that could not be
+ * tested
+ */
+size_t upipe_ts_sync_scan_neon(const uint8_t *buffer, size_t size,
+                               size_t stride, unsigned int count);
+#endif
+
+#endif
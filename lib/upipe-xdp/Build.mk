@@ -0,0 +1,12 @@
+configs += xdp
+xdp-includes = linux/if_xdp.h
+
+lib-targets = libupipe_xdp
+
+libupipe_xdp-desc = AF_XDP socket modules
+libupipe_xdp-so-version = 1.0.0
+libupipe_xdp-includes = upipe_xdp_sink.h upipe_xdp_src.h
+libupipe_xdp-src = upipe_xdp_sink.c upipe_xdp_src.c upipe_xdp_umem.c \
+                   upipe_xdp_umem.h
+libupipe_xdp-deps = xdp
+libupipe_xdp-libs = libupipe libxdp bitstream
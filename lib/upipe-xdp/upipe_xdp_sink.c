@@ -0,0 +1,692 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short Upipe sink module for AF_XDP sockets
+ */
+
+#include "upipe/ubase.h"
+#include "upipe/uclock.h"
+#include "upipe/uref.h"
+#include "upipe/uref_block.h"
+#include "upipe/uref_clock.h"
+#include "upipe/uref_flow.h"
+#include "upipe/upump.h"
+#include "upipe/upipe.h"
+#include "upipe/upipe_helper_upipe.h"
+#include "upipe/upipe_helper_urefcount.h"
+#include "upipe/upipe_helper_void.h"
+#include "upipe/upipe_helper_upump_mgr.h"
+#include "upipe/upipe_helper_upump.h"
+#include "upipe/upipe_helper_input.h"
+#include "upipe/upipe_helper_uclock.h"
+#include "upipe-xdp/upipe_xdp_sink.h"
+#include "upipe_xdp_umem.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+
+#include <xdp/xsk.h>
+
+#include <bitstream/ietf/ip.h>
+#include <bitstream/ietf/udp.h>
+#include <bitstream/ieee/ethernet.h>
+
+/** tolerance for late packets */
+#define SYSTIME_TOLERANCE UCLOCK_FREQ
+/** print late packets */
+#define SYSTIME_PRINT (UCLOCK_FREQ / 100)
+/** expected flow definition on all flows */
+#define EXPECTED_FLOW_DEF "block."
+/** default time-to-live */
+#define DEFAULT_TTL 64
+/** size of the headers prepended to the payload */
+#define HEADERS_SIZE (ETHERNET_HEADER_LEN + IP_HEADER_MINSIZE + UDP_HEADER_SIZE)
+
+/** @hidden */
+static void upipe_xdp_sink_watcher(struct upump *upump);
+/** @hidden */
+static bool upipe_xdp_sink_output(struct upipe *upipe, struct uref *uref,
+                                  struct upump **upump_p);
+
+/** @internal @This is the private context of an xdp sink pipe. */
+struct upipe_xdp_sink {
+    /** refcount management structure */
+    struct urefcount urefcount;
+
+    /** upump manager */
+    struct upump_mgr *upump_mgr;
+    /** write watcher */
+    struct upump *upump;
+
+    /** uclock structure, if not NULL we are in live mode */
+    struct uclock *uclock;
+    /** uclock request */
+    struct urequest uclock_request;
+
+    /** delay applied to systime attribute when uclock is provided */
+    uint64_t latency;
+    /** temporary uref storage */
+    struct uchain urefs;
+    /** nb urefs in storage */
+    unsigned int nb_urefs;
+    /** max urefs in storage */
+    unsigned int max_urefs;
+    /** list of blockers */
+    struct uchain blockers;
+
+    /** interface uri */
+    char *uri;
+    /** UMEM area */
+    struct upipe_xdp_umem *xumem;
+    /** AF_XDP socket */
+    struct xsk_socket *xsk;
+    /** transmit ring */
+    struct xsk_ring_prod tx;
+
+    /** template of the ethernet, IPv4 and UDP headers */
+    uint8_t headers[HEADERS_SIZE];
+    /** IPv4 identification of the next datagram */
+    uint16_t ip_id;
+
+    /** public upipe structure */
+    struct upipe upipe;
+};
+
+UPIPE_HELPER_UPIPE(upipe_xdp_sink, upipe, UPIPE_XDP_SINK_SIGNATURE)
+UPIPE_HELPER_UREFCOUNT(upipe_xdp_sink, urefcount, upipe_xdp_sink_free)
+UPIPE_HELPER_VOID(upipe_xdp_sink)
+UPIPE_HELPER_UPUMP_MGR(upipe_xdp_sink, upump_mgr)
+UPIPE_HELPER_UPUMP(upipe_xdp_sink, upump, upump_mgr)
+UPIPE_HELPER_INPUT(upipe_xdp_sink, urefs, nb_urefs, max_urefs, blockers,
+                   upipe_xdp_sink_output)
+UPIPE_HELPER_UCLOCK(upipe_xdp_sink, uclock, uclock_request, NULL,
+                    upipe_throw_provide_request, NULL)
+
+/** @internal @This allocates an xdp sink pipe.
+ *
+ * @param mgr common management structure
+ * @param uprobe structure used to raise events
+ * @param signature signature of the pipe allocator
+ * @param args optional arguments
+ * @return pointer to upipe or NULL in case of allocation error
+ */
+static struct upipe *upipe_xdp_sink_alloc(struct upipe_mgr *mgr,
+                                          struct uprobe *uprobe,
+                                          uint32_t signature, va_list args)
+{
+    struct upipe *upipe = upipe_xdp_sink_alloc_void(mgr, uprobe, signature,
+                                                    args);
+    if (unlikely(upipe == NULL))
+        return NULL;
+
+    struct upipe_xdp_sink *upipe_xdp_sink = upipe_xdp_sink_from_upipe(upipe);
+    upipe_xdp_sink_init_urefcount(upipe);
+    upipe_xdp_sink_init_upump_mgr(upipe);
+    upipe_xdp_sink_init_upump(upipe);
+    upipe_xdp_sink_init_input(upipe);
+    upipe_xdp_sink_init_uclock(upipe);
+    upipe_xdp_sink->latency = 0;
+    upipe_xdp_sink->uri = NULL;
+    upipe_xdp_sink->xumem = NULL;
+    upipe_xdp_sink->xsk = NULL;
+    upipe_xdp_sink->ip_id = 0;
+    memset(upipe_xdp_sink->headers, 0, HEADERS_SIZE);
+    upipe_throw_ready(upipe);
+    return upipe;
+}
+
+/** @This starts the watcher waiting for the sink to unblock.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_xdp_sink_poll(struct upipe *upipe)
+{
+    struct upipe_xdp_sink *upipe_xdp_sink = upipe_xdp_sink_from_upipe(upipe);
+    if (unlikely(!ubase_check(upipe_xdp_sink_check_upump_mgr(upipe)))) {
+        upipe_err_va(upipe, "can't get upump_mgr");
+        upipe_throw_fatal(upipe, UBASE_ERR_UPUMP);
+        return;
+    }
+    struct upump *watcher = upump_alloc_fd_write(upipe_xdp_sink->upump_mgr,
+            upipe_xdp_sink_watcher, upipe, upipe->refcount,
+            xsk_socket__fd(upipe_xdp_sink->xsk));
+    if (unlikely(watcher == NULL)) {
+        upipe_err_va(upipe, "can't create watcher");
+        upipe_throw_fatal(upipe, UBASE_ERR_UPUMP);
+    } else {
+        upipe_xdp_sink_set_upump(upipe, watcher);
+        upump_start(watcher);
+    }
+}
+
+/** @internal @This wakes up the kernel if it waits for transmit descriptors.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_xdp_sink_kick(struct upipe *upipe)
+{
+    struct upipe_xdp_sink *upipe_xdp_sink = upipe_xdp_sink_from_upipe(upipe);
+    if (xsk_ring_prod__needs_wakeup(&upipe_xdp_sink->tx))
+        sendto(xsk_socket__fd(upipe_xdp_sink->xsk), NULL, 0, MSG_DONTWAIT,
+               NULL, 0);
+}
+
+/** @internal @This writes the headers of a datagram in a frame.
+ *
+ * @param upipe description structure of the pipe
+ * @param frame pointer to the frame
+ * @param payload_len size of the UDP payload
+ */
+static void upipe_xdp_sink_build(struct upipe *upipe, uint8_t *frame,
+                                 uint16_t payload_len)
+{
+    struct upipe_xdp_sink *upipe_xdp_sink = upipe_xdp_sink_from_upipe(upipe);
+    memcpy(frame, upipe_xdp_sink->headers, HEADERS_SIZE);
+
+    uint8_t *ip = frame + ETHERNET_HEADER_LEN;
+    ip_set_len(ip, IP_HEADER_MINSIZE + UDP_HEADER_SIZE + payload_len);
+    ip_set_id(ip, upipe_xdp_sink->ip_id++);
+
+    uint32_t cksum = 0;
+    for (int i = 0; i < IP_HEADER_MINSIZE; i += 2)
+        cksum += (ip[i] << 8) | ip[i + 1];
+    while (cksum >> 16)
+        cksum = (cksum & 0xffff) + (cksum >> 16);
+    ip_set_cksum(ip, ~cksum & 0xffff);
+
+    uint8_t *udp = ip + IP_HEADER_MINSIZE;
+    udp_set_len(udp, UDP_HEADER_SIZE + payload_len);
+}
+
+/** @internal @This outputs data to the xdp sink.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref uref structure
+ * @param upump_p reference to pump that generated the buffer
+ * @return true if the uref was processed
+ */
+static bool upipe_xdp_sink_output(struct upipe *upipe, struct uref *uref,
+                                  struct upump **upump_p)
+{
+    struct upipe_xdp_sink *upipe_xdp_sink = upipe_xdp_sink_from_upipe(upipe);
+    const char *def;
+    if (unlikely(ubase_check(uref_flow_get_def(uref, &def)))) {
+        uint64_t latency = 0;
+        uref_clock_get_latency(uref, &latency);
+        if (latency > upipe_xdp_sink->latency)
+            upipe_xdp_sink->latency = latency;
+        uref_free(uref);
+        return true;
+    }
+
+    if (unlikely(upipe_xdp_sink->xsk == NULL)) {
+        uref_free(uref);
+        upipe_warn(upipe, "received a buffer before opening a socket");
+        return true;
+    }
+
+    if (likely(upipe_xdp_sink->uclock == NULL))
+        goto write_buffer;
+
+    uint64_t systime = 0;
+    if (unlikely(!ubase_check(uref_clock_get_cr_sys(uref, &systime)))) {
+        upipe_warn(upipe, "received non-dated buffer");
+        goto write_buffer;
+    }
+
+    uint64_t now = uclock_now(upipe_xdp_sink->uclock);
+    systime += upipe_xdp_sink->latency;
+    if (unlikely(now < systime)) {
+        upipe_xdp_sink_check_upump_mgr(upipe);
+        if (likely(upipe_xdp_sink->upump_mgr != NULL)) {
+            upipe_verbose_va(upipe, "sleeping %"PRIu64" (%"PRIu64")",
+                             systime - now, systime);
+            upipe_xdp_sink_wait_upump(upipe, systime - now,
+                                      upipe_xdp_sink_watcher);
+            return false;
+        }
+    } else if (now > systime + SYSTIME_TOLERANCE) {
+        upipe_warn_va(upipe,
+                      "dropping late packet %"PRIu64" ms, latency %"PRIu64" ms",
+                      (now - systime) / (UCLOCK_FREQ / 1000),
+                      upipe_xdp_sink->latency / (UCLOCK_FREQ / 1000));
+        uref_free(uref);
+        return true;
+    } else if (now > systime + SYSTIME_PRINT)
+        upipe_warn_va(upipe,
+                      "outputting late packet %"PRIu64" ms, latency %"PRIu64" ms",
+                      (now - systime) / (UCLOCK_FREQ / 1000),
+                      upipe_xdp_sink->latency / (UCLOCK_FREQ / 1000));
+
+write_buffer:;
+    struct upipe_xdp_umem *xumem = upipe_xdp_sink->xumem;
+    size_t payload_len = 0;
+    if (unlikely(!ubase_check(uref_block_size(uref, &payload_len)) ||
+                 payload_len + HEADERS_SIZE > xumem->frame_size)) {
+        upipe_warn_va(upipe, "dropping invalid block (%zu octets)",
+                      payload_len);
+        uref_free(uref);
+        return true;
+    }
+
+    upipe_xdp_umem_reclaim(xumem);
+    uint8_t *frame = upipe_xdp_umem_pop(xumem);
+    uint32_t idx;
+    if (unlikely(frame == NULL ||
+                 xsk_ring_prod__reserve(&upipe_xdp_sink->tx, 1, &idx) != 1)) {
+        if (frame != NULL)
+            upipe_xdp_umem_push(xumem, frame);
+        upipe_xdp_sink_kick(upipe);
+        upipe_xdp_sink_poll(upipe);
+        return false;
+    }
+
+    upipe_xdp_sink_build(upipe, frame, payload_len);
+    uref_block_extract(uref, 0, -1, frame + HEADERS_SIZE);
+    uref_free(uref);
+
+    struct xdp_desc *desc = xsk_ring_prod__tx_desc(&upipe_xdp_sink->tx, idx);
+    desc->addr = upipe_xdp_umem_addr(xumem, frame);
+    desc->len = HEADERS_SIZE + payload_len;
+    xsk_ring_prod__submit(&upipe_xdp_sink->tx, 1);
+    upipe_xdp_sink_kick(upipe);
+    return true;
+}
+
+/** @internal @This is called when the socket can be written again.
+ * Unblock the sink and unqueue all queued buffers.
+ *
+ * @param upump description structure of the watcher
+ */
+static void upipe_xdp_sink_watcher(struct upump *upump)
+{
+    struct upipe *upipe = upump_get_opaque(upump, struct upipe *);
+    upipe_xdp_sink_set_upump(upipe, NULL);
+    upipe_xdp_sink_output_input(upipe);
+    upipe_xdp_sink_unblock_input(upipe);
+    if (upipe_xdp_sink_check_input(upipe)) {
+        /* All packets have been output, release again the pipe that has been
+         * used in @ref upipe_xdp_sink_input. */
+        upipe_release(upipe);
+    }
+}
+
+/** @internal @This receives data.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref uref structure
+ * @param upump_p reference to pump that generated the buffer
+ */
+static void upipe_xdp_sink_input(struct upipe *upipe, struct uref *uref,
+                                 struct upump **upump_p)
+{
+    if (!upipe_xdp_sink_check_input(upipe)) {
+        upipe_xdp_sink_hold_input(upipe, uref);
+        upipe_xdp_sink_block_input(upipe, upump_p);
+    } else if (!upipe_xdp_sink_output(upipe, uref, upump_p)) {
+        upipe_xdp_sink_hold_input(upipe, uref);
+        upipe_xdp_sink_block_input(upipe, upump_p);
+        /* Increment upipe refcount to avoid disappearing before all packets
+         * have been sent. */
+        upipe_use(upipe);
+    }
+}
+
+/** @internal @This sets the input flow definition.
+ *
+ * @param upipe description structure of the pipe
+ * @param flow_def flow definition packet
+ * @return an error code
+ */
+static int upipe_xdp_sink_set_flow_def(struct upipe *upipe,
+                                       struct uref *flow_def)
+{
+    if (flow_def == NULL)
+        return UBASE_ERR_INVALID;
+    UBASE_RETURN(uref_flow_match_def(flow_def, EXPECTED_FLOW_DEF))
+    flow_def = uref_dup(flow_def);
+    UBASE_ALLOC_RETURN(flow_def)
+    upipe_input(upipe, flow_def, NULL);
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This parses an IPv4 address and a port.
+ *
+ * @param string address of the form addr:port
+ * @param addr_p filled in with the address
+ * @param port_p filled in with the port
+ * @return false in case of error
+ */
+static bool upipe_xdp_sink_parse_addr(const char *string,
+                                      struct in_addr *addr_p,
+                                      uint16_t *port_p)
+{
+    char addr[INET_ADDRSTRLEN];
+    unsigned int port;
+    if (sscanf(string, "%15[0-9.]:%u", addr, &port) != 2 || port > UINT16_MAX)
+        return false;
+    *port_p = port;
+    return inet_pton(AF_INET, addr, addr_p) == 1;
+}
+
+/** @internal @This fills the template of the headers from the uri.
+ *
+ * @param upipe description structure of the pipe
+ * @param uri sink uri
+ * @param ifname interface name
+ * @return an error code
+ */
+static int upipe_xdp_sink_parse_headers(struct upipe *upipe, const char *uri,
+                                        const char *ifname)
+{
+    struct upipe_xdp_sink *upipe_xdp_sink = upipe_xdp_sink_from_upipe(upipe);
+    uint8_t *eth = upipe_xdp_sink->headers;
+    uint8_t *ip = eth + ETHERNET_HEADER_LEN;
+    uint8_t *udp = ip + IP_HEADER_MINSIZE;
+
+    const char *dst = strchr(uri, '@');
+    struct in_addr dst_addr, src_addr = { .s_addr = INADDR_ANY };
+    uint16_t dst_port, src_port = 0;
+    if (dst == NULL ||
+        !upipe_xdp_sink_parse_addr(dst + 1, &dst_addr, &dst_port)) {
+        upipe_err_va(upipe, "invalid destination in uri %s", uri);
+        return UBASE_ERR_INVALID;
+    }
+
+    bool has_dmac = false;
+    unsigned int ttl = DEFAULT_TTL;
+    const char *option = dst;
+    while ((option = strchr(option, '/')) != NULL) {
+        option++;
+        if (!strncmp(option, "src=", strlen("src="))) {
+            if (!upipe_xdp_sink_parse_addr(option + strlen("src="),
+                                           &src_addr, &src_port)) {
+                upipe_err_va(upipe, "invalid source in uri %s", uri);
+                return UBASE_ERR_INVALID;
+            }
+        } else if (!strncmp(option, "dmac=", strlen("dmac="))) {
+            uint8_t *mac = eth;
+            if (sscanf(option + strlen("dmac="),
+                       "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx", &mac[0], &mac[1],
+                       &mac[2], &mac[3], &mac[4], &mac[5]) != 6) {
+                upipe_err_va(upipe, "invalid MAC address in uri %s", uri);
+                return UBASE_ERR_INVALID;
+            }
+            has_dmac = true;
+        } else if (!strncmp(option, "ttl=", strlen("ttl="))) {
+            ttl = strtoul(option + strlen("ttl="), NULL, 10);
+        }
+    }
+
+    uint32_t daddr = ntohl(dst_addr.s_addr);
+    if (IN_MULTICAST(daddr)) {
+        eth[0] = 0x01;
+        eth[1] = 0x00;
+        eth[2] = 0x5e;
+        eth[3] = (daddr >> 16) & 0x7f;
+        eth[4] = (daddr >> 8) & 0xff;
+        eth[5] = daddr & 0xff;
+    } else if (!has_dmac) {
+        upipe_err_va(upipe, "missing dmac option for unicast uri %s", uri);
+        return UBASE_ERR_INVALID;
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (unlikely(fd < 0)) {
+        upipe_err_va(upipe, "can't open socket (%m)");
+        return UBASE_ERR_EXTERNAL;
+    }
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+    if (unlikely(ioctl(fd, SIOCGIFHWADDR, &ifr) < 0)) {
+        upipe_err_va(upipe, "can't get MAC address of %s (%m)", ifname);
+        close(fd);
+        return UBASE_ERR_EXTERNAL;
+    }
+    memcpy(eth + 6, ifr.ifr_hwaddr.sa_data, 6);
+    if (src_addr.s_addr == INADDR_ANY) {
+        ifr.ifr_addr.sa_family = AF_INET;
+        if (ioctl(fd, SIOCGIFADDR, &ifr) == 0)
+            src_addr = ((struct sockaddr_in *)&ifr.ifr_addr)->sin_addr;
+        else
+            upipe_warn_va(upipe, "can't get address of %s (%m)", ifname);
+    }
+    close(fd);
+
+    ethernet_set_lentype(eth, ETHERNET_TYPE_IP);
+    ip_set_version(ip, 4);
+    ip_set_ihl(ip, 5);
+    ip_set_tos(ip, 0);
+    ip_set_ttl(ip, ttl);
+    ip_set_proto(ip, IP_PROTO_UDP);
+    ip_set_srcaddr(ip, ntohl(src_addr.s_addr));
+    ip_set_dstaddr(ip, daddr);
+    udp_set_srcport(udp, src_port ? src_port : dst_port);
+    udp_set_dstport(udp, dst_port);
+    udp_set_cksum(udp, 0);
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This closes the socket and releases the UMEM area.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_xdp_sink_close(struct upipe *upipe)
+{
+    struct upipe_xdp_sink *upipe_xdp_sink = upipe_xdp_sink_from_upipe(upipe);
+
+    upipe_xdp_sink_set_upump(upipe, NULL);
+    if (upipe_xdp_sink->xsk != NULL) {
+        upipe_notice_va(upipe, "closing AF_XDP socket %s",
+                        upipe_xdp_sink->uri);
+        xsk_socket__delete(upipe_xdp_sink->xsk);
+        upipe_xdp_sink->xsk = NULL;
+    }
+    upipe_xdp_umem_release(upipe_xdp_sink->xumem);
+    upipe_xdp_sink->xumem = NULL;
+    ubase_clean_str(&upipe_xdp_sink->uri);
+}
+
+/** @internal @This returns the uri of the currently opened socket.
+ *
+ * @param upipe description structure of the pipe
+ * @param uri_p filled in with the uri of the socket
+ * @return an error code
+ */
+static int _upipe_xdp_sink_get_uri(struct upipe *upipe, const char **uri_p)
+{
+    struct upipe_xdp_sink *upipe_xdp_sink = upipe_xdp_sink_from_upipe(upipe);
+    assert(uri_p != NULL);
+    *uri_p = upipe_xdp_sink->uri;
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This asks to open the given socket.
+ *
+ * @param upipe description structure of the pipe
+ * @param uri uri of the socket
+ * @return an error code
+ */
+static int _upipe_xdp_sink_set_uri(struct upipe *upipe, const char *uri)
+{
+    struct upipe_xdp_sink *upipe_xdp_sink = upipe_xdp_sink_from_upipe(upipe);
+
+    upipe_xdp_sink_close(upipe);
+    if (!upipe_xdp_sink_check_input(upipe))
+        /* Release the pipe used in @ref upipe_xdp_sink_input. */
+        upipe_release(upipe);
+
+    if (unlikely(uri == NULL))
+        return UBASE_ERR_NONE;
+
+    upipe_xdp_sink_check_upump_mgr(upipe);
+
+    char ifname[IFNAMSIZ];
+    uint32_t queue;
+    bool generic;
+    UBASE_RETURN(upipe_xdp_parse_ifname(upipe, uri, ifname, &queue, &generic))
+    UBASE_RETURN(upipe_xdp_sink_parse_headers(upipe, uri, ifname))
+
+    upipe_xdp_sink->xumem = upipe_xdp_umem_alloc(upipe, UPIPE_XDP_UMEM_FRAMES,
+                                                 UPIPE_XDP_UMEM_FRAME_SIZE);
+    if (unlikely(upipe_xdp_sink->xumem == NULL))
+        return UBASE_ERR_EXTERNAL;
+
+    int err = upipe_xdp_socket_create(upipe, &upipe_xdp_sink->xsk, ifname,
+                                      queue, upipe_xdp_sink->xumem,
+                                      NULL, &upipe_xdp_sink->tx, generic);
+    if (unlikely(!ubase_check(err))) {
+        upipe_xdp_sink_close(upipe);
+        return err;
+    }
+
+    upipe_xdp_sink->uri = strdup(uri);
+    if (unlikely(upipe_xdp_sink->uri == NULL)) {
+        upipe_xdp_sink_close(upipe);
+        upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+        return UBASE_ERR_ALLOC;
+    }
+    if (!upipe_xdp_sink_check_input(upipe))
+        /* Use again the pipe that we previously released. */
+        upipe_use(upipe);
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This flushes all currently held buffers, and unblocks the
+ * sources.
+ *
+ * @param upipe description structure of the pipe
+ * @return an error code
+ */
+static int upipe_xdp_sink_flush(struct upipe *upipe)
+{
+    if (upipe_xdp_sink_flush_input(upipe)) {
+        upipe_xdp_sink_set_upump(upipe, NULL);
+        /* All packets have been output, release again the pipe that has been
+         * used in @ref upipe_xdp_sink_input. */
+        upipe_release(upipe);
+    }
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This processes control commands on an xdp sink pipe.
+ *
+ * @param upipe description structure of the pipe
+ * @param command type of command to process
+ * @param args arguments of the command
+ * @return an error code
+ */
+static int _upipe_xdp_sink_control(struct upipe *upipe,
+                                   int command, va_list args)
+{
+    switch (command) {
+        case UPIPE_REGISTER_REQUEST:
+        case UPIPE_UNREGISTER_REQUEST:
+            return upipe_control_provide_request(upipe, command, args);
+
+        case UPIPE_ATTACH_UPUMP_MGR:
+            upipe_xdp_sink_set_upump(upipe, NULL);
+            return upipe_xdp_sink_attach_upump_mgr(upipe);
+        case UPIPE_ATTACH_UCLOCK:
+            upipe_xdp_sink_set_upump(upipe, NULL);
+            upipe_xdp_sink_require_uclock(upipe);
+            return UBASE_ERR_NONE;
+        case UPIPE_SET_FLOW_DEF: {
+            struct uref *flow_def = va_arg(args, struct uref *);
+            return upipe_xdp_sink_set_flow_def(upipe, flow_def);
+        }
+
+        case UPIPE_GET_MAX_LENGTH: {
+            unsigned int *p = va_arg(args, unsigned int *);
+            return upipe_xdp_sink_get_max_length(upipe, p);
+        }
+        case UPIPE_SET_MAX_LENGTH: {
+            unsigned int max_length = va_arg(args, unsigned int);
+            return upipe_xdp_sink_set_max_length(upipe, max_length);
+        }
+
+        case UPIPE_GET_URI: {
+            const char **uri_p = va_arg(args, const char **);
+            return _upipe_xdp_sink_get_uri(upipe, uri_p);
+        }
+        case UPIPE_SET_URI: {
+            const char *uri = va_arg(args, const char *);
+            return _upipe_xdp_sink_set_uri(upipe, uri);
+        }
+        case UPIPE_FLUSH:
+            return upipe_xdp_sink_flush(upipe);
+        default:
+            return UBASE_ERR_UNHANDLED;
+    }
+}
+
+/** @internal @This processes control commands on an xdp sink pipe, and
+ * checks the status of the pipe afterwards.
+ *
+ * @param upipe description structure of the pipe
+ * @param command type of command to process
+ * @param args arguments of the command
+ * @return an error code
+ */
+static int upipe_xdp_sink_control(struct upipe *upipe, int command,
+                                  va_list args)
+{
+    struct upipe_xdp_sink *upipe_xdp_sink = upipe_xdp_sink_from_upipe(upipe);
+    UBASE_RETURN(_upipe_xdp_sink_control(upipe, command, args));
+
+    if (unlikely(!upipe_xdp_sink_check_input(upipe) &&
+                 upipe_xdp_sink->xsk != NULL))
+        upipe_xdp_sink_poll(upipe);
+
+    return UBASE_ERR_NONE;
+}
+
+/** @This frees a upipe.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_xdp_sink_free(struct upipe *upipe)
+{
+    upipe_xdp_sink_close(upipe);
+    upipe_throw_dead(upipe);
+
+    upipe_xdp_sink_clean_uclock(upipe);
+    upipe_xdp_sink_clean_upump(upipe);
+    upipe_xdp_sink_clean_upump_mgr(upipe);
+    upipe_xdp_sink_clean_input(upipe);
+    upipe_xdp_sink_clean_urefcount(upipe);
+    upipe_xdp_sink_free_void(upipe);
+}
+
+/** module manager static descriptor */
+static struct upipe_mgr upipe_xdp_sink_mgr = {
+    .refcount = NULL,
+    .signature = UPIPE_XDP_SINK_SIGNATURE,
+
+    .upipe_alloc = upipe_xdp_sink_alloc,
+    .upipe_input = upipe_xdp_sink_input,
+    .upipe_control = upipe_xdp_sink_control,
+
+    .upipe_mgr_control = NULL
+};
+
+/** @This returns the management structure for all xdp sink pipes.
+ *
+ * @return pointer to manager
+ */
+struct upipe_mgr *upipe_xdp_sink_mgr_alloc(void)
+{
+    return &upipe_xdp_sink_mgr;
+}
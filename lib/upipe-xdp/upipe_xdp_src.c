@@ -0,0 +1,532 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short Upipe source module for AF_XDP sockets
+ */
+
+#include "upipe/ubase.h"
+#include "upipe/uprobe.h"
+#include "upipe/uclock.h"
+#include "upipe/uref.h"
+#include "upipe/uref_block.h"
+#include "upipe/uref_block_flow.h"
+#include "upipe/uref_clock.h"
+#include "upipe/upump.h"
+#include "upipe/ubuf.h"
+#include "upipe/ubuf_block_mem.h"
+#include "upipe/upipe.h"
+#include "upipe/upipe_helper_upipe.h"
+#include "upipe/upipe_helper_urefcount.h"
+#include "upipe/upipe_helper_void.h"
+#include "upipe/upipe_helper_uref_mgr.h"
+#include "upipe/upipe_helper_ubuf_mgr.h"
+#include "upipe/upipe_helper_output.h"
+#include "upipe/upipe_helper_upump_mgr.h"
+#include "upipe/upipe_helper_upump.h"
+#include "upipe/upipe_helper_uclock.h"
+#include "upipe-xdp/upipe_xdp_src.h"
+#include "upipe_xdp_umem.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <net/if.h>
+
+#include <xdp/xsk.h>
+
+#include <bitstream/ietf/ip.h>
+#include <bitstream/ietf/udp.h>
+#include <bitstream/ieee/ethernet.h>
+
+/** depth of the pools of the UMEM ubuf manager */
+#define UBUF_POOL_DEPTH 1024
+/** below this number of frames in the fill ring, payloads are copied */
+#define FILL_LOW_WATERMARK (2 * UPIPE_XDP_UMEM_BATCH)
+
+/** @hidden */
+static int upipe_xdp_src_check(struct upipe *upipe, struct uref *flow_format);
+
+/** @internal @This is the private context of an xdp source pipe. */
+struct upipe_xdp_src {
+    /** refcount management structure */
+    struct urefcount urefcount;
+
+    /** uref manager */
+    struct uref_mgr *uref_mgr;
+    /** uref manager request */
+    struct urequest uref_mgr_request;
+
+    /** ubuf manager, used when payloads have to be copied */
+    struct ubuf_mgr *ubuf_mgr;
+    /** flow format packet */
+    struct uref *flow_format;
+    /** ubuf manager request */
+    struct urequest ubuf_mgr_request;
+
+    /** uclock structure, if not NULL we are in live mode */
+    struct uclock *uclock;
+    /** uclock request */
+    struct urequest uclock_request;
+
+    /** pipe acting as output */
+    struct upipe *output;
+    /** flow definition packet */
+    struct uref *flow_def;
+    /** output state */
+    enum upipe_helper_output_state output_state;
+    /** list of output requests */
+    struct uchain request_list;
+
+    /** upump manager */
+    struct upump_mgr *upump_mgr;
+    /** read watcher */
+    struct upump *upump;
+
+    /** interface uri */
+    char *uri;
+    /** UMEM area */
+    struct upipe_xdp_umem *xumem;
+    /** ubuf manager wrapping UMEM frames */
+    struct ubuf_mgr *umem_ubuf_mgr;
+    /** AF_XDP socket */
+    struct xsk_socket *xsk;
+    /** receive ring */
+    struct xsk_ring_cons rx;
+
+    /** public upipe structure */
+    struct upipe upipe;
+};
+
+UPIPE_HELPER_UPIPE(upipe_xdp_src, upipe, UPIPE_XDP_SRC_SIGNATURE)
+UPIPE_HELPER_UREFCOUNT(upipe_xdp_src, urefcount, upipe_xdp_src_free)
+UPIPE_HELPER_VOID(upipe_xdp_src)
+
+UPIPE_HELPER_OUTPUT(upipe_xdp_src, output, flow_def, output_state, request_list)
+UPIPE_HELPER_UREF_MGR(upipe_xdp_src, uref_mgr, uref_mgr_request,
+                      upipe_xdp_src_check,
+                      upipe_xdp_src_register_output_request,
+                      upipe_xdp_src_unregister_output_request)
+UPIPE_HELPER_UBUF_MGR(upipe_xdp_src, ubuf_mgr, flow_format, ubuf_mgr_request,
+                      upipe_xdp_src_check,
+                      upipe_xdp_src_register_output_request,
+                      upipe_xdp_src_unregister_output_request)
+UPIPE_HELPER_UCLOCK(upipe_xdp_src, uclock, uclock_request, upipe_xdp_src_check,
+                    upipe_xdp_src_register_output_request,
+                    upipe_xdp_src_unregister_output_request)
+
+UPIPE_HELPER_UPUMP_MGR(upipe_xdp_src, upump_mgr)
+UPIPE_HELPER_UPUMP(upipe_xdp_src, upump, upump_mgr)
+
+/** @internal @This allocates an xdp source pipe.
+ *
+ * @param mgr common management structure
+ * @param uprobe structure used to raise events
+ * @param signature signature of the pipe allocator
+ * @param args optional arguments
+ * @return pointer to upipe or NULL in case of allocation error
+ */
+static struct upipe *upipe_xdp_src_alloc(struct upipe_mgr *mgr,
+                                         struct uprobe *uprobe,
+                                         uint32_t signature, va_list args)
+{
+    struct upipe *upipe = upipe_xdp_src_alloc_void(mgr, uprobe, signature,
+                                                   args);
+    if (unlikely(upipe == NULL))
+        return NULL;
+
+    struct upipe_xdp_src *upipe_xdp_src = upipe_xdp_src_from_upipe(upipe);
+    upipe_xdp_src_init_urefcount(upipe);
+    upipe_xdp_src_init_uref_mgr(upipe);
+    upipe_xdp_src_init_ubuf_mgr(upipe);
+    upipe_xdp_src_init_output(upipe);
+    upipe_xdp_src_init_upump_mgr(upipe);
+    upipe_xdp_src_init_upump(upipe);
+    upipe_xdp_src_init_uclock(upipe);
+    upipe_xdp_src->uri = NULL;
+    upipe_xdp_src->xumem = NULL;
+    upipe_xdp_src->umem_ubuf_mgr = NULL;
+    upipe_xdp_src->xsk = NULL;
+    upipe_throw_ready(upipe);
+    return upipe;
+}
+
+/** @internal @This finds the UDP payload in an ethernet frame.
+ *
+ * @param frame pointer to the ethernet frame
+ * @param len size of the ethernet frame
+ * @param payload_len_p filled in with the size of the UDP payload
+ * @return offset of the UDP payload, or -1 if it is not a UDP/IPv4 frame
+ */
+static int upipe_xdp_src_parse(const uint8_t *frame, uint32_t len,
+                               uint16_t *payload_len_p)
+{
+    if (unlikely(len < ETHERNET_HEADER_LEN + IP_HEADER_MINSIZE +
+                       UDP_HEADER_SIZE))
+        return -1;
+    if (ethernet_get_lentype(frame) != ETHERNET_TYPE_IP)
+        return -1;
+
+    const uint8_t *ip = frame + ETHERNET_HEADER_LEN;
+    if (ip_get_proto(ip) != IP_PROTO_UDP)
+        return -1;
+
+    uint32_t ip_len = 4 * ip_get_ihl(ip);
+    if (unlikely(ETHERNET_HEADER_LEN + ip_len + UDP_HEADER_SIZE > len))
+        return -1;
+
+    const uint8_t *udp = ip + ip_len;
+    uint16_t udp_len = udp_get_len(udp);
+    int offset = udp + UDP_HEADER_SIZE - frame;
+    if (unlikely(udp_len < UDP_HEADER_SIZE ||
+                 offset + udp_len - UDP_HEADER_SIZE > len))
+        return -1;
+
+    *payload_len_p = udp_len - UDP_HEADER_SIZE;
+    return offset;
+}
+
+/** @internal @This allocates a uref pointing to the payload of a frame.
+ *
+ * @param upipe description structure of the pipe
+ * @param frame pointer to the frame, whose ownership is transferred
+ * @param offset offset of the payload in the frame
+ * @param size size of the payload
+ * @param copy true if the payload must be copied
+ * @return pointer to uref, or NULL in case of allocation error
+ */
+static struct uref *upipe_xdp_src_alloc_uref(struct upipe *upipe,
+                                             uint8_t *frame, int offset,
+                                             int size, bool copy)
+{
+    struct upipe_xdp_src *upipe_xdp_src = upipe_xdp_src_from_upipe(upipe);
+    struct upipe_xdp_umem *xumem = upipe_xdp_src->xumem;
+
+    if (copy) {
+        struct uref *uref = uref_block_alloc(upipe_xdp_src->uref_mgr,
+                                             upipe_xdp_src->ubuf_mgr, size);
+        if (likely(uref != NULL)) {
+            uint8_t *buffer;
+            int output_size = -1;
+            if (unlikely(!ubase_check(uref_block_write(uref, 0, &output_size,
+                                                       &buffer)))) {
+                uref_free(uref);
+                uref = NULL;
+            } else {
+                memcpy(buffer, frame + offset, size);
+                uref_block_unmap(uref, 0);
+            }
+        }
+        upipe_xdp_umem_push(xumem, frame);
+        return uref;
+    }
+
+    struct uref *uref = uref_alloc(upipe_xdp_src->uref_mgr);
+    if (unlikely(uref == NULL)) {
+        upipe_xdp_umem_push(xumem, frame);
+        return NULL;
+    }
+
+    struct umem umem;
+    upipe_xdp_umem_wrap(xumem, &umem, frame);
+    struct ubuf *ubuf =
+        ubuf_block_mem_alloc_from_umem(upipe_xdp_src->umem_ubuf_mgr,
+                                       &umem, offset, size);
+    if (unlikely(ubuf == NULL)) {
+        upipe_xdp_umem_push(xumem, frame);
+        uref_free(uref);
+        return NULL;
+    }
+    uref_attach_ubuf(uref, ubuf);
+    return uref;
+}
+
+/** @internal @This reads packets from the receive ring and outputs them.
+ *
+ * @param upump description structure of the read watcher
+ */
+static void upipe_xdp_src_worker(struct upump *upump)
+{
+    struct upipe *upipe = upump_get_opaque(upump, struct upipe *);
+    struct upipe_xdp_src *upipe_xdp_src = upipe_xdp_src_from_upipe(upipe);
+    struct upipe_xdp_umem *xumem = upipe_xdp_src->xumem;
+
+    uint64_t systime = 0;
+    if (likely(upipe_xdp_src->uclock != NULL))
+        systime = uclock_now(upipe_xdp_src->uclock);
+
+    uint32_t idx;
+    unsigned int nb = xsk_ring_cons__peek(&upipe_xdp_src->rx,
+                                          UPIPE_XDP_UMEM_BATCH, &idx);
+    if (nb) {
+        /* when the application holds most frames, copy payloads so that
+         * frames go back to the kernel immediately */
+        uint32_t level = xumem->fill.size -
+            xsk_prod_nb_free(&xumem->fill, xumem->fill.size);
+        bool copy = level < FILL_LOW_WATERMARK;
+
+        for (unsigned int i = 0; i < nb; i++) {
+            const struct xdp_desc *desc =
+                xsk_ring_cons__rx_desc(&upipe_xdp_src->rx, idx + i);
+            uint8_t *frame = upipe_xdp_umem_frame(xumem, desc->addr);
+            uint64_t addr = xsk_umem__add_offset_to_addr(desc->addr);
+            uint8_t *packet = xumem->area + addr;
+
+            uint16_t payload_len;
+            int offset = upipe_xdp_src_parse(packet, desc->len, &payload_len);
+            if (offset < 0) {
+                upipe_xdp_umem_push(xumem, frame);
+                continue;
+            }
+
+            struct uref *uref = upipe_xdp_src_alloc_uref(upipe, frame,
+                    packet - frame + offset, payload_len, copy);
+            if (unlikely(uref == NULL)) {
+                upipe_throw_error(upipe, UBASE_ERR_ALLOC);
+                continue;
+            }
+
+            if (likely(upipe_xdp_src->uclock != NULL))
+                uref_clock_set_cr_sys(uref, systime);
+            upipe_xdp_src_output(upipe, uref, &upipe_xdp_src->upump);
+        }
+        xsk_ring_cons__release(&upipe_xdp_src->rx, nb);
+    }
+
+    upipe_xdp_umem_refill(xumem);
+    if (xsk_ring_prod__needs_wakeup(&xumem->fill))
+        recvfrom(xsk_socket__fd(upipe_xdp_src->xsk), NULL, 0, MSG_DONTWAIT,
+                 NULL, NULL);
+}
+
+/** @internal @This checks if the pump may be allocated.
+ *
+ * @param upipe description structure of the pipe
+ * @param flow_format amended flow format
+ * @return an error code
+ */
+static int upipe_xdp_src_check(struct upipe *upipe, struct uref *flow_format)
+{
+    struct upipe_xdp_src *upipe_xdp_src = upipe_xdp_src_from_upipe(upipe);
+    if (flow_format != NULL)
+        upipe_xdp_src_store_flow_def(upipe, flow_format);
+
+    upipe_xdp_src_check_upump_mgr(upipe);
+    if (upipe_xdp_src->upump_mgr == NULL)
+        return UBASE_ERR_NONE;
+
+    if (upipe_xdp_src->uref_mgr == NULL) {
+        upipe_xdp_src_require_uref_mgr(upipe);
+        return UBASE_ERR_NONE;
+    }
+
+    if (upipe_xdp_src->ubuf_mgr == NULL) {
+        struct uref *flow_format =
+            uref_block_flow_alloc_def(upipe_xdp_src->uref_mgr, NULL);
+        if (unlikely(flow_format == NULL)) {
+            upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+            return UBASE_ERR_ALLOC;
+        }
+        upipe_xdp_src_require_ubuf_mgr(upipe, flow_format);
+        return UBASE_ERR_NONE;
+    }
+
+    if (upipe_xdp_src->uclock == NULL &&
+        urequest_get_opaque(&upipe_xdp_src->uclock_request, struct upipe *)
+            != NULL)
+        return UBASE_ERR_NONE;
+
+    if (upipe_xdp_src->xsk == NULL || upipe_xdp_src->upump != NULL)
+        return UBASE_ERR_NONE;
+
+    upipe_xdp_umem_refill(upipe_xdp_src->xumem);
+
+    struct upump *upump = upump_alloc_fd_read(upipe_xdp_src->upump_mgr,
+            upipe_xdp_src_worker, upipe, upipe->refcount,
+            xsk_socket__fd(upipe_xdp_src->xsk));
+    if (unlikely(upump == NULL)) {
+        upipe_throw_fatal(upipe, UBASE_ERR_UPUMP);
+        return UBASE_ERR_UPUMP;
+    }
+    upipe_xdp_src_set_upump(upipe, upump);
+    upump_start(upump);
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This closes the socket and releases the UMEM area. Frames
+ * still referenced by ubufs keep the area alive until they are released.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_xdp_src_close(struct upipe *upipe)
+{
+    struct upipe_xdp_src *upipe_xdp_src = upipe_xdp_src_from_upipe(upipe);
+
+    upipe_xdp_src_set_upump(upipe, NULL);
+    if (upipe_xdp_src->xsk != NULL) {
+        upipe_notice_va(upipe, "closing AF_XDP socket %s", upipe_xdp_src->uri);
+        xsk_socket__delete(upipe_xdp_src->xsk);
+        upipe_xdp_src->xsk = NULL;
+    }
+    ubuf_mgr_release(upipe_xdp_src->umem_ubuf_mgr);
+    upipe_xdp_src->umem_ubuf_mgr = NULL;
+    upipe_xdp_umem_release(upipe_xdp_src->xumem);
+    upipe_xdp_src->xumem = NULL;
+    ubase_clean_str(&upipe_xdp_src->uri);
+}
+
+/** @internal @This returns the uri of the currently opened interface.
+ *
+ * @param upipe description structure of the pipe
+ * @param uri_p filled in with the uri
+ * @return an error code
+ */
+static int upipe_xdp_src_get_uri(struct upipe *upipe, const char **uri_p)
+{
+    struct upipe_xdp_src *upipe_xdp_src = upipe_xdp_src_from_upipe(upipe);
+    assert(uri_p != NULL);
+    *uri_p = upipe_xdp_src->uri;
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This asks to open the given interface queue.
+ *
+ * @param upipe description structure of the pipe
+ * @param uri interface uri, ifname[-queue][/generic]
+ * @return an error code
+ */
+static int upipe_xdp_src_set_uri(struct upipe *upipe, const char *uri)
+{
+    struct upipe_xdp_src *upipe_xdp_src = upipe_xdp_src_from_upipe(upipe);
+
+    upipe_xdp_src_close(upipe);
+    if (unlikely(uri == NULL))
+        return UBASE_ERR_NONE;
+
+    char ifname[IFNAMSIZ];
+    uint32_t queue;
+    bool generic;
+    UBASE_RETURN(upipe_xdp_parse_ifname(upipe, uri, ifname, &queue, &generic))
+
+    upipe_xdp_src->xumem = upipe_xdp_umem_alloc(upipe, UPIPE_XDP_UMEM_FRAMES,
+                                                UPIPE_XDP_UMEM_FRAME_SIZE);
+    if (unlikely(upipe_xdp_src->xumem == NULL))
+        return UBASE_ERR_EXTERNAL;
+
+    upipe_xdp_src->umem_ubuf_mgr =
+        ubuf_block_mem_mgr_alloc(UBUF_POOL_DEPTH, UBUF_POOL_DEPTH,
+                                 &upipe_xdp_src->xumem->mgr, 0, 0, -1, 0);
+    upipe_xdp_src->uri = strdup(uri);
+    if (unlikely(upipe_xdp_src->umem_ubuf_mgr == NULL ||
+                 upipe_xdp_src->uri == NULL)) {
+        upipe_xdp_src_close(upipe);
+        upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+        return UBASE_ERR_ALLOC;
+    }
+
+    int err = upipe_xdp_socket_create(upipe, &upipe_xdp_src->xsk, ifname,
+                                      queue, upipe_xdp_src->xumem,
+                                      &upipe_xdp_src->rx, NULL, generic);
+    if (unlikely(!ubase_check(err))) {
+        upipe_xdp_src_close(upipe);
+        return err;
+    }
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This processes control commands on an xdp source pipe.
+ *
+ * @param upipe description structure of the pipe
+ * @param command type of command to process
+ * @param args arguments of the command
+ * @return an error code
+ */
+static int _upipe_xdp_src_control(struct upipe *upipe,
+                                  int command, va_list args)
+{
+    switch (command) {
+        case UPIPE_ATTACH_UPUMP_MGR:
+            upipe_xdp_src_set_upump(upipe, NULL);
+            return upipe_xdp_src_attach_upump_mgr(upipe);
+        case UPIPE_ATTACH_UCLOCK:
+            upipe_xdp_src_set_upump(upipe, NULL);
+            upipe_xdp_src_require_uclock(upipe);
+            return UBASE_ERR_NONE;
+
+        case UPIPE_GET_FLOW_DEF:
+        case UPIPE_GET_OUTPUT:
+        case UPIPE_SET_OUTPUT:
+            return upipe_xdp_src_control_output(upipe, command, args);
+
+        case UPIPE_GET_URI: {
+            const char **uri_p = va_arg(args, const char **);
+            return upipe_xdp_src_get_uri(upipe, uri_p);
+        }
+        case UPIPE_SET_URI: {
+            const char *uri = va_arg(args, const char *);
+            return upipe_xdp_src_set_uri(upipe, uri);
+        }
+        default:
+            return UBASE_ERR_UNHANDLED;
+    }
+}
+
+/** @internal @This processes control commands on an xdp source pipe, and
+ * checks the status of the pipe afterwards.
+ *
+ * @param upipe description structure of the pipe
+ * @param command type of command to process
+ * @param args arguments of the command
+ * @return an error code
+ */
+static int upipe_xdp_src_control(struct upipe *upipe, int command,
+                                 va_list args)
+{
+    UBASE_RETURN(_upipe_xdp_src_control(upipe, command, args));
+
+    return upipe_xdp_src_check(upipe, NULL);
+}
+
+/** @This frees a upipe.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_xdp_src_free(struct upipe *upipe)
+{
+    upipe_xdp_src_close(upipe);
+
+    upipe_throw_dead(upipe);
+
+    upipe_xdp_src_clean_uclock(upipe);
+    upipe_xdp_src_clean_upump(upipe);
+    upipe_xdp_src_clean_upump_mgr(upipe);
+    upipe_xdp_src_clean_output(upipe);
+    upipe_xdp_src_clean_ubuf_mgr(upipe);
+    upipe_xdp_src_clean_uref_mgr(upipe);
+    upipe_xdp_src_clean_urefcount(upipe);
+    upipe_xdp_src_free_void(upipe);
+}
+
+/** module manager static descriptor */
+static struct upipe_mgr upipe_xdp_src_mgr = {
+    .refcount = NULL,
+    .signature = UPIPE_XDP_SRC_SIGNATURE,
+
+    .upipe_alloc = upipe_xdp_src_alloc,
+    .upipe_input = NULL,
+    .upipe_control = upipe_xdp_src_control,
+
+    .upipe_mgr_control = NULL
+};
+
+/** @This returns the management structure for all xdp sources.
+ *
+ * @return pointer to manager
+ */
+struct upipe_mgr *upipe_xdp_src_mgr_alloc(void)
+{
+    return &upipe_xdp_src_mgr;
+}
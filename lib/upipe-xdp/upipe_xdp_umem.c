@@ -0,0 +1,311 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short Upipe internal helper functions for AF_XDP UMEM areas
+ */
+
+#include "upipe/ubase.h"
+#include "upipe/urefcount.h"
+#include "upipe/ulifo.h"
+#include "upipe/umem.h"
+#include "upipe/upipe.h"
+#include "upipe_xdp_umem.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <net/if.h>
+
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+#include <xdp/xsk.h>
+
+/** @internal @This gives an unused frame to the caller.
+ *
+ * @param mgr pointer to umem manager
+ * @param umem caller-allocated structure, filled in with the frame
+ * @param size requested size, which must fit in a frame
+ * @return false if no frame is available
+ */
+static bool upipe_xdp_umem_alloc_frame(struct umem_mgr *mgr, struct umem *umem,
+                                       size_t size)
+{
+    struct upipe_xdp_umem *xumem = upipe_xdp_umem_from_umem_mgr(mgr);
+    if (unlikely(size > xumem->frame_size))
+        return false;
+
+    uint8_t *frame = upipe_xdp_umem_pop(xumem);
+    if (unlikely(frame == NULL))
+        return false;
+
+    upipe_xdp_umem_wrap(xumem, umem, frame);
+    umem->size = size;
+    return true;
+}
+
+/** @internal @This resizes a frame, which is only possible inside the frame.
+ *
+ * @param umem pointer to umem
+ * @param new_size new requested size
+ * @return false if the new size does not fit in a frame
+ */
+static bool upipe_xdp_umem_realloc_frame(struct umem *umem, size_t new_size)
+{
+    if (new_size > umem->real_size)
+        return false;
+    umem->size = new_size;
+    return true;
+}
+
+/** @internal @This gives a frame back to the UMEM area.
+ *
+ * @param umem pointer to umem
+ */
+static void upipe_xdp_umem_free_frame(struct umem *umem)
+{
+    struct upipe_xdp_umem *xumem = upipe_xdp_umem_from_umem_mgr(umem->mgr);
+    upipe_xdp_umem_push(xumem, umem->buffer);
+    umem->buffer = NULL;
+    umem->mgr = NULL;
+}
+
+/** @This refills the fill ring with as many unused frames as possible. It
+ * must only be called from the thread receiving packets.
+ *
+ * @param xumem pointer to UMEM area
+ * @return number of frames given to the kernel
+ */
+unsigned int upipe_xdp_umem_refill(struct upipe_xdp_umem *xumem)
+{
+    unsigned int total = 0;
+    for ( ; ; ) {
+        uint8_t *frames[UPIPE_XDP_UMEM_BATCH];
+        uint32_t nb = xsk_prod_nb_free(&xumem->fill, UPIPE_XDP_UMEM_BATCH);
+        if (nb > UPIPE_XDP_UMEM_BATCH)
+            nb = UPIPE_XDP_UMEM_BATCH;
+
+        uint32_t count = 0;
+        while (count < nb &&
+               (frames[count] = upipe_xdp_umem_pop(xumem)) != NULL)
+            count++;
+        if (!count)
+            break;
+
+        uint32_t idx;
+        if (unlikely(xsk_ring_prod__reserve(&xumem->fill, count,
+                                            &idx) != count)) {
+            while (count)
+                upipe_xdp_umem_push(xumem, frames[--count]);
+            break;
+        }
+        for (uint32_t i = 0; i < count; i++)
+            *xsk_ring_prod__fill_addr(&xumem->fill, idx + i) =
+                upipe_xdp_umem_addr(xumem, frames[i]);
+        xsk_ring_prod__submit(&xumem->fill, count);
+        total += count;
+
+        if (count < UPIPE_XDP_UMEM_BATCH)
+            break;
+    }
+    return total;
+}
+
+/** @This reclaims frames from the completion ring. It must only be called
+ * from the thread sending packets.
+ *
+ * @param xumem pointer to UMEM area
+ * @return number of reclaimed frames
+ */
+unsigned int upipe_xdp_umem_reclaim(struct upipe_xdp_umem *xumem)
+{
+    uint32_t idx;
+    unsigned int nb = xsk_ring_cons__peek(&xumem->comp, xumem->nb_frames,
+                                          &idx);
+    for (unsigned int i = 0; i < nb; i++) {
+        uint64_t addr = *xsk_ring_cons__comp_addr(&xumem->comp, idx + i);
+        upipe_xdp_umem_push(xumem, upipe_xdp_umem_frame(xumem, addr));
+    }
+    if (nb)
+        xsk_ring_cons__release(&xumem->comp, nb);
+    return nb;
+}
+
+/** @internal @This frees a UMEM area.
+ *
+ * @param urefcount pointer to urefcount
+ */
+static void upipe_xdp_umem_free(struct urefcount *urefcount)
+{
+    struct upipe_xdp_umem *xumem = upipe_xdp_umem_from_urefcount(urefcount);
+    xsk_umem__delete(xumem->umem);
+    munmap(xumem->area, (size_t)xumem->nb_frames * xumem->frame_size);
+    ulifo_clean(&xumem->free_frames);
+    urefcount_clean(urefcount);
+    free(xumem);
+}
+
+/** @This allocates a UMEM area and registers it with the kernel.
+ *
+ * @param upipe description structure of the pipe, for logging
+ * @param nb_frames number of frames
+ * @param frame_size size of a frame
+ * @return pointer to UMEM area, or NULL in case of error
+ */
+struct upipe_xdp_umem *upipe_xdp_umem_alloc(struct upipe *upipe,
+                                            uint32_t nb_frames,
+                                            uint32_t frame_size)
+{
+    if (unlikely(nb_frames == 0 || nb_frames > UINT16_MAX)) {
+        upipe_err_va(upipe, "invalid number of UMEM frames %"PRIu32,
+                     nb_frames);
+        return NULL;
+    }
+
+    struct upipe_xdp_umem *xumem =
+        malloc(sizeof(struct upipe_xdp_umem) + ulifo_sizeof(nb_frames));
+    if (unlikely(xumem == NULL)) {
+        upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+        return NULL;
+    }
+
+    size_t size = (size_t)nb_frames * frame_size;
+    xumem->area = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (unlikely(xumem->area == MAP_FAILED)) {
+        upipe_err_va(upipe, "can't allocate UMEM area (%m)");
+        free(xumem);
+        return NULL;
+    }
+    xumem->frame_size = frame_size;
+    xumem->nb_frames = nb_frames;
+
+    struct xsk_umem_config config = {
+        .fill_size = XSK_RING_PROD__DEFAULT_NUM_DESCS,
+        .comp_size = XSK_RING_CONS__DEFAULT_NUM_DESCS,
+        .frame_size = frame_size,
+        .frame_headroom = XSK_UMEM__DEFAULT_FRAME_HEADROOM,
+        .flags = 0,
+    };
+    int err = xsk_umem__create(&xumem->umem, xumem->area, size,
+                               &xumem->fill, &xumem->comp, &config);
+    if (unlikely(err)) {
+        upipe_err_va(upipe, "can't register UMEM area (%s)", strerror(-err));
+        munmap(xumem->area, size);
+        free(xumem);
+        return NULL;
+    }
+
+    ulifo_init(&xumem->free_frames, nb_frames, xumem->ulifo_extra);
+    for (uint32_t i = 0; i < nb_frames; i++)
+        upipe_xdp_umem_push(xumem, xumem->area + (size_t)i * frame_size);
+
+    urefcount_init(upipe_xdp_umem_to_urefcount(xumem), upipe_xdp_umem_free);
+    xumem->mgr.refcount = upipe_xdp_umem_to_urefcount(xumem);
+    xumem->mgr.umem_alloc = upipe_xdp_umem_alloc_frame;
+    xumem->mgr.umem_realloc = upipe_xdp_umem_realloc_frame;
+    xumem->mgr.umem_free = upipe_xdp_umem_free_frame;
+    xumem->mgr.umem_mgr_vacuum = NULL;
+    return xumem;
+}
+
+/** @This parses an interface specification of the form
+ * ifname[-queue][/option...], as used by the xdp pipes.
+ *
+ * @param upipe description structure of the pipe, for logging
+ * @param uri interface specification
+ * @param ifname filled in with the interface name
+ * @param queue_p filled in with the queue index
+ * @param generic_p set to true if the generic (SKB) mode is forced
+ * @return an error code
+ */
+int upipe_xdp_parse_ifname(struct upipe *upipe, const char *uri,
+                           char *ifname, uint32_t *queue_p, bool *generic_p)
+{
+    size_t len = strcspn(uri, "@/");
+    if (unlikely(len == 0 || len >= IFNAMSIZ)) {
+        upipe_err_va(upipe, "invalid interface in uri %s", uri);
+        return UBASE_ERR_INVALID;
+    }
+    memcpy(ifname, uri, len);
+    ifname[len] = '\0';
+
+    *queue_p = 0;
+    char *dash = strrchr(ifname, '-');
+    if (dash != NULL && dash[1] && strspn(dash + 1, "0123456789") ==
+                                   strlen(dash + 1)) {
+        *queue_p = strtoul(dash + 1, NULL, 10);
+        *dash = '\0';
+    }
+
+    *generic_p = false;
+    const char *option = uri + len;
+    while ((option = strchr(option, '/')) != NULL) {
+        option++;
+        if (!strncmp(option, "generic", strlen("generic")))
+            *generic_p = true;
+    }
+    return UBASE_ERR_NONE;
+}
+
+/** @This creates an AF_XDP socket, trying zero-copy first, then native copy
+ * mode, then generic (SKB) mode.
+ *
+ * @param upipe description structure of the pipe, for logging
+ * @param xsk_p filled in with the socket
+ * @param ifname interface name
+ * @param queue queue index
+ * @param xumem UMEM area
+ * @param rx receive ring, or NULL
+ * @param tx transmit ring, or NULL
+ * @param generic true to force the generic (SKB) mode
+ * @return an error code
+ */
+int upipe_xdp_socket_create(struct upipe *upipe, struct xsk_socket **xsk_p,
+                            const char *ifname, uint32_t queue,
+                            struct upipe_xdp_umem *xumem,
+                            struct xsk_ring_cons *rx, struct xsk_ring_prod *tx,
+                            bool generic)
+{
+    static const struct {
+        const char *name;
+        uint32_t xdp_flags;
+        uint16_t bind_flags;
+    } modes[] = {
+        { "native zero-copy", XDP_FLAGS_DRV_MODE, XDP_ZEROCOPY },
+        { "native copy", XDP_FLAGS_DRV_MODE, XDP_COPY },
+        { "generic", XDP_FLAGS_SKB_MODE, XDP_COPY },
+    };
+
+    int err = 0;
+    for (unsigned i = generic ? UBASE_ARRAY_SIZE(modes) - 1 : 0;
+         i < UBASE_ARRAY_SIZE(modes); i++) {
+        struct xsk_socket_config config = {
+            .rx_size = XSK_RING_CONS__DEFAULT_NUM_DESCS,
+            .tx_size = XSK_RING_PROD__DEFAULT_NUM_DESCS,
+            .libxdp_flags = 0,
+            .xdp_flags = modes[i].xdp_flags | XDP_FLAGS_UPDATE_IF_NOEXIST,
+            .bind_flags = modes[i].bind_flags | XDP_USE_NEED_WAKEUP,
+        };
+        err = xsk_socket__create(xsk_p, ifname, queue, xumem->umem,
+                                 rx, tx, &config);
+        if (!err) {
+            upipe_notice_va(upipe, "opened AF_XDP socket on %s queue %"PRIu32
+                            " in %s mode", ifname, queue, modes[i].name);
+            return UBASE_ERR_NONE;
+        }
+        upipe_dbg_va(upipe, "can't open AF_XDP socket on %s in %s mode (%s)",
+                     ifname, modes[i].name, strerror(-err));
+    }
+
+    upipe_err_va(upipe, "can't open AF_XDP socket on %s queue %"PRIu32" (%s)",
+                 ifname, queue, strerror(-err));
+    return UBASE_ERR_EXTERNAL;
+}
@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short Upipe internal helper functions for AF_XDP UMEM areas
+ */
+
+#ifndef _UPIPE_XDP_UPIPE_XDP_UMEM_H_
+/** @hidden */
+#define _UPIPE_XDP_UPIPE_XDP_UMEM_H_
+
+#include "upipe/ubase.h"
+#include "upipe/urefcount.h"
+#include "upipe/ulifo.h"
+#include "upipe/umem.h"
+#include "upipe/upipe.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include <xdp/xsk.h>
+
+/** default number of frames in a UMEM area */
+#define UPIPE_XDP_UMEM_FRAMES       4096
+/** default size of a UMEM frame */
+#define UPIPE_XDP_UMEM_FRAME_SIZE   XSK_UMEM__DEFAULT_FRAME_SIZE
+/** maximum number of descriptors processed at once */
+#define UPIPE_XDP_UMEM_BATCH        64
+
+/** @This is a UMEM area shared with the kernel, along with its fill and
+ * completion rings. It is also a umem manager whose buffers are UMEM frames,
+ * so that frames can be wrapped into block ubufs and returned to the area
+ * when the last reference is released, from any thread. */
+struct upipe_xdp_umem {
+    /** refcount management structure */
+    struct urefcount urefcount;
+
+    /** UMEM area */
+    uint8_t *area;
+    /** size of a frame */
+    uint32_t frame_size;
+    /** number of frames */
+    uint32_t nb_frames;
+
+    /** libxdp UMEM */
+    struct xsk_umem *umem;
+    /** fill ring (application to kernel) */
+    struct xsk_ring_prod fill;
+    /** completion ring (kernel to application) */
+    struct xsk_ring_cons comp;
+
+    /** LIFO of frames owned by the application and currently unused */
+    struct ulifo free_frames;
+
+    /** common umem management structure */
+    struct umem_mgr mgr;
+
+    /** extra space for ulifo */
+    uint8_t ulifo_extra[];
+};
+
+UBASE_FROM_TO(upipe_xdp_umem, umem_mgr, umem_mgr, mgr)
+UBASE_FROM_TO(upipe_xdp_umem, urefcount, urefcount, urefcount)
+
+/** @This returns the address of a frame relative to the UMEM area.
+ *
+ * @param xumem pointer to UMEM area
+ * @param frame pointer to the frame (or to any octet inside the frame)
+ * @return frame address, suitable for ring descriptors
+ */
+static inline uint64_t upipe_xdp_umem_addr(struct upipe_xdp_umem *xumem,
+                                           const uint8_t *frame)
+{
+    uint64_t addr = frame - xumem->area;
+    return addr - addr % xumem->frame_size;
+}
+
+/** @This returns a pointer to the frame containing the given address.
+ *
+ * @param xumem pointer to UMEM area
+ * @param addr address relative to the UMEM area, possibly with an offset
+ * @return pointer to the beginning of the frame
+ */
+static inline uint8_t *upipe_xdp_umem_frame(struct upipe_xdp_umem *xumem,
+                                            uint64_t addr)
+{
+    addr = xsk_umem__extract_addr(addr);
+    return xumem->area + addr - addr % xumem->frame_size;
+}
+
+/** @This takes an unused frame from the UMEM area.
+ *
+ * @param xumem pointer to UMEM area
+ * @return pointer to the frame, or NULL if all frames are in use
+ */
+static inline uint8_t *upipe_xdp_umem_pop(struct upipe_xdp_umem *xumem)
+{
+    return ulifo_pop(&xumem->free_frames, uint8_t *);
+}
+
+/** @This gives back an unused frame to the UMEM area. It is thread-safe.
+ *
+ * @param xumem pointer to UMEM area
+ * @param frame pointer to the frame (or to any octet inside the frame)
+ */
+static inline void upipe_xdp_umem_push(struct upipe_xdp_umem *xumem,
+                                       uint8_t *frame)
+{
+    bool ret = ulifo_push(&xumem->free_frames,
+                          xumem->area + upipe_xdp_umem_addr(xumem, frame));
+    assert(ret);
+    (void)ret;
+}
+
+/** @This initializes a umem pointing to a frame owned by the application,
+ * so that it can be wrapped into a block ubuf. The frame is given back to
+ * the UMEM area by @ref umem_free.
+ *
+ * @param xumem pointer to UMEM area
+ * @param umem caller-allocated structure to fill in
+ * @param frame pointer to the frame
+ */
+static inline void upipe_xdp_umem_wrap(struct upipe_xdp_umem *xumem,
+                                       struct umem *umem, uint8_t *frame)
+{
+    umem->mgr = &xumem->mgr;
+    umem->buffer = frame;
+    umem->size = umem->real_size = xumem->frame_size;
+}
+
+/** @This refills the fill ring with as many unused frames as possible. It
+ * must only be called from the thread receiving packets.
+ *
+ * @param xumem pointer to UMEM area
+ * @return number of frames given to the kernel
+ */
+unsigned int upipe_xdp_umem_refill(struct upipe_xdp_umem *xumem);
+
+/** @This reclaims frames from the completion ring. It must only be called
+ * from the thread sending packets.
+ *
+ * @param xumem pointer to UMEM area
+ * @return number of reclaimed frames
+ */
+unsigned int upipe_xdp_umem_reclaim(struct upipe_xdp_umem *xumem);
+
+/** @This allocates a UMEM area and registers it with the kernel.
+ *
+ * @param upipe description structure of the pipe, for logging
+ * @param nb_frames number of frames
+ * @param frame_size size of a frame
+ * @return pointer to UMEM area, or NULL in case of error
+ */
+struct upipe_xdp_umem *upipe_xdp_umem_alloc(struct upipe *upipe,
+                                            uint32_t nb_frames,
+                                            uint32_t frame_size);
+
+/** @This increments the reference count of a UMEM area.
+ *
+ * @param xumem pointer to UMEM area
+ * @return same pointer
+ */
+static inline struct upipe_xdp_umem *
+    upipe_xdp_umem_use(struct upipe_xdp_umem *xumem)
+{
+    if (xumem != NULL)
+        urefcount_use(&xumem->urefcount);
+    return xumem;
+}
+
+/** @This decrements the reference count of a UMEM area or frees it. The
+ * sockets using the area must have been deleted beforehand.
+ *
+ * @param xumem pointer to UMEM area
+ */
+static inline void upipe_xdp_umem_release(struct upipe_xdp_umem *xumem)
+{
+    if (xumem != NULL)
+        urefcount_release(&xumem->urefcount);
+}
+
+/** @This parses an interface specification of the form
+ * ifname[-queue][/option...], as used by the xdp pipes.
+ *
+ * @param upipe description structure of the pipe, for logging
+ * @param uri interface specification
+ * @param ifname filled in with the interface name
+ * @param queue_p filled in with the queue index
+ * @param generic_p set to true if the generic (SKB) mode is forced
+ * @return an error code
+ */
+int upipe_xdp_parse_ifname(struct upipe *upipe, const char *uri,
+                           char *ifname, uint32_t *queue_p, bool *generic_p);
+
+/** @This creates an AF_XDP socket, trying zero-copy first, then native copy
+ * mode, then generic (SKB) mode.
+ *
+ * @param upipe description structure of the pipe, for logging
+ * @param xsk_p filled in with the socket
+ * @param ifname interface name
+ * @param queue queue index
+ * @param xumem UMEM area
+ * @param rx receive ring, or NULL
+ * @param tx transmit ring, or NULL
+ * @param generic true to force the generic (SKB) mode
+ * @return an error code
+ */
+int upipe_xdp_socket_create(struct upipe *upipe, struct xsk_socket **xsk_p,
+                            const char *ifname, uint32_t queue,
+                            struct upipe_xdp_umem *xumem,
+                            struct xsk_ring_cons *rx, struct xsk_ring_prod *tx,
+                            bool generic);
+
+#endif
@@ -98,6 +98,8 @@ static struct ubuf *ubuf_block_mem_alloc(struct ubuf_mgr *mgr,
     const char *plane_orig;
     struct ubuf_mem_shared *shared_orig;
     size_t offset_orig, size_orig;
+    struct umem *umem_orig = NULL;
+    int umem_offset = 0;
     switch (signature) {
         case UBUF_ALLOC_BLOCK:
             size = va_arg(args, int);
@@ -127,6 +129,16 @@ static struct ubuf *ubuf_block_mem_alloc(struct ubuf_mgr *mgr,
                 return NULL;
             break;
 
+        case UBUF_BLOCK_MEM_ALLOC_FROM_UMEM:
+            umem_orig = va_arg(args, struct umem *);
+            umem_offset = va_arg(args, int);
+            size = va_arg(args, int);
+            if (unlikely(umem_orig == NULL || umem_orig->mgr == NULL ||
+                         umem_offset < 0 || size < 0 ||
+                         umem_offset + size > umem_size(umem_orig)))
+                return NULL;
+            break;
+
         default:
             return NULL;
     }
@@ -140,6 +152,20 @@ static struct ubuf *ubuf_block_mem_alloc(struct ubuf_mgr *mgr,
     struct ubuf *ubuf = ubuf_block_mem_to_ubuf(block_mem);
     ubuf_block_common_init(ubuf, false);
 
+    if (signature == UBUF_BLOCK_MEM_ALLOC_FROM_UMEM) {
+        /* We take ownership of an externally allocated umem. */
+        block_mem->shared = ubuf_block_mem_shared_alloc_pool(mgr);
+        if (unlikely(block_mem->shared == NULL)) {
+            ubuf_block_mem_free_pool(mgr, block_mem);
+            return NULL;
+        }
+        block_mem->shared->umem = *umem_orig;
+        ubuf_block_common_set(ubuf, umem_offset, size);
+        ubuf_block_common_set_buffer(ubuf,
+                                     ubuf_mem_shared_buffer(block_mem->shared));
+        return ubuf;
+    }
+
     if (signature != UBUF_ALLOC_BLOCK) {
         /* We reuse a shared structure. */
         block_mem->shared = ubuf_mem_shared_use(shared_orig);
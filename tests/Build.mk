@@ -15,9 +15,12 @@ distfiles = valgrind_wrapper.sh valgrind.supp \
             uref_dump_test.txt \
             uref_uri_test.txt \
             ustring_test.txt \
-            $(foreach i,1 2 3 4 5 6 7 8 9, \
+            $(foreach i,1 2 3 4 5 6 7 8 9 10, \
               upipe_m3u_reader_test_files/$i.m3u \
-              upipe_m3u_reader_test_files/$i.m3u.logs)
+              upipe_m3u_reader_test_files/$i.m3u.logs) \
+            $(foreach i,1 2 3 4 5, \
+              upipe_m3u_reader_test_files/live/$i.m3u) \
+            upipe_m3u_reader_test_files/live/incremental.logs
 
 tests += ubits_test
 ubits_test-src = ubits_test.c
@@ -129,6 +132,12 @@ upipe_auto_source_test-src = upipe_auto_source_test.c
 upipe_auto_source_test-libs = libupipe libupipe_modules libupump_ev
 upipe_auto_source_test-opt-libs = libupipe_bearssl libupipe_openssl
 
+tests += upipe_av_avio_test
+upipe_av_avio_test-src = upipe_av_avio_test.c
+upipe_av_avio_test-cppflags = -I$(top_srcdir)
+upipe_av_avio_test-libs = libupipe libupipe_av libupump_ev libavformat \
+                          libavcodec libavutil pthread
+
 test-targets += upipe_avcodec_decode_test
 upipe_avcodec_decode_test-src = upipe_avcodec_decode_test.c
 upipe_avcodec_decode_test-deps = upipe_avcdec
@@ -209,6 +218,10 @@ upipe_file_test-src = upipe_file_test.c
 upipe_file_test-deps = upipe_fsink
 upipe_file_test-libs = libupipe libupipe_modules libupump_ev
 
+tests += upipe_file_sink_test
+upipe_file_sink_test-src = upipe_file_sink_test.c
+upipe_file_sink_test-libs = libupipe libupipe_modules libupump_ev
+
 tests += upipe_filter_blend_test
 upipe_filter_blend_test-src = upipe_filter_blend_test.c
 upipe_filter_blend_test-libs = libupipe libupipe_modules libupipe_filters
@@ -246,6 +259,15 @@ test-targets += upipe_h265_framer_test_build
 upipe_h265_framer_test_build-src = upipe_h265_framer_test_build.c
 upipe_h265_framer_test_build-libs = libupipe libupipe_x265 bitstream
 
+tests += upipe_hls_playlist_test
+upipe_hls_playlist_test-src = upipe_hls_playlist_test.c
+upipe_hls_playlist_test-libs = libupipe libupipe_modules libupipe_hls \
+                               libupump_ev
+
+tests += upipe_hls_sink_test
+upipe_hls_sink_test-src = upipe_hls_sink_test.c
+upipe_hls_sink_test-libs = libupipe libupipe_modules libupipe_hls bitstream
+
 tests += upipe_htons_test
 upipe_htons_test-src = upipe_htons_test.c
 upipe_htons_test-libs = libupipe libupipe_modules
@@ -255,6 +277,10 @@ upipe_http_src_test-src = upipe_http_src_test.c
 upipe_http_src_test-libs = libupipe libupipe_modules libupump_ev
 upipe_http_src_test-opt-libs = libupipe_bearssl libupipe_openssl
 
+tests += upipe_http_src_ranges_test
+upipe_http_src_ranges_test-src = upipe_http_src_ranges_test.c
+upipe_http_src_ranges_test-libs = libupipe libupipe_modules libupump_ev pthread
+
 tests += upipe_interlace_test
 upipe_interlace_test-src = upipe_interlace_test.c
 upipe_interlace_test-libs = libupipe libupipe_modules
@@ -290,6 +316,11 @@ upipe_multicat_test-src = upipe_multicat_test.c
 upipe_multicat_test-deps = upipe_fsink
 upipe_multicat_test-libs = libupipe libupipe_modules libupump_ev
 
+tests += upipe_netmap_spares_test
+upipe_netmap_spares_test-src = upipe_netmap_spares_test.c
+upipe_netmap_spares_test-cppflags = -I$(top_srcdir)
+upipe_netmap_spares_test-libs = libupipe
+
 tests += upipe_null_test
 upipe_null_test-src = upipe_null_test.c
 upipe_null_test-libs = libupipe libupipe_modules
@@ -305,6 +336,10 @@ test-targets += upipe_pcap_src_test
 upipe_pcap_src_test-src = upipe_pcap_src_test.c
 upipe_pcap_src_test-libs = libupipe libupump_ev libupipe_modules libupipe_pcap
 
+tests += upipe_pcap_src_controls_test
+upipe_pcap_src_controls_test-src = upipe_pcap_src_controls_test.c
+upipe_pcap_src_controls_test-libs = libupipe libupump_ev libupipe_pcap
+
 tests += upipe_play_test
 upipe_play_test-src = upipe_play_test.c
 upipe_play_test-libs = libupipe libupipe_modules
@@ -409,6 +444,12 @@ tests += upipe_ts_demux_test
 upipe_ts_demux_test-src = upipe_ts_demux_test.c
 upipe_ts_demux_test-libs = libupipe libupipe_ts libupipe_framers bitstream
 
+tests += upipe_ts_demux_workers_test
+upipe_ts_demux_workers_test-src = upipe_ts_demux_workers_test.c
+upipe_ts_demux_workers_test-libs = libupipe libupipe_ts libupipe_framers \
+                                   libupipe_modules libupipe_pthread \
+                                   libupump_ev bitstream pthread
+
 tests += upipe_ts_eit_decoder_test
 upipe_ts_eit_decoder_test-src = upipe_ts_eit_decoder_test.c
 upipe_ts_eit_decoder_test-libs = libupipe libupipe_ts bitstream
@@ -417,6 +458,14 @@ tests += upipe_ts_encaps_test
 upipe_ts_encaps_test-src = upipe_ts_encaps_test.c
 upipe_ts_encaps_test-libs = libupipe libupipe_ts bitstream
 
+test-targets += upipe_ts_mux_bench
+upipe_ts_mux_bench-src = upipe_ts_mux_bench.c
+upipe_ts_mux_bench-libs = libupipe libupipe_ts bitstream
+
+tests += upipe_ts_mux_passthrough_test
+upipe_ts_mux_passthrough_test-src = upipe_ts_mux_passthrough_test.c
+upipe_ts_mux_passthrough_test-libs = libupipe libupipe_ts bitstream
+
 tests += upipe_ts_nit_decoder_test
 upipe_ts_nit_decoder_test-src = upipe_ts_nit_decoder_test.c
 upipe_ts_nit_decoder_test-libs = libupipe libupipe_ts bitstream
@@ -429,6 +478,10 @@ tests += upipe_ts_pes_decaps_test
 upipe_ts_pes_decaps_test-src = upipe_ts_pes_decaps_test.c
 upipe_ts_pes_decaps_test-libs = libupipe libupipe_ts bitstream
 
+test-targets += upipe_ts_pes_decaps_bench
+upipe_ts_pes_decaps_bench-src = upipe_ts_pes_decaps_bench.c
+upipe_ts_pes_decaps_bench-libs = libupipe libupipe_ts bitstream
+
 tests += upipe_ts_pes_encaps_test
 upipe_ts_pes_encaps_test-src = upipe_ts_pes_encaps_test.c
 upipe_ts_pes_encaps_test-libs = libupipe libupipe_ts bitstream
@@ -571,6 +624,10 @@ upipe_x265_test-src = upipe_x265_test.c
 upipe_x265_test-libs = libupipe libupipe_x265
 check-$(builddir)/upipe_x265_test: log-env += ASAN_OPTIONS="detect_leaks=0"
 
+tests += upipe_xdp_sink_test
+upipe_xdp_sink_test-src = upipe_xdp_sink_test.c
+upipe_xdp_sink_test-libs = libupipe libupump_ev libupipe_xdp
+
 tests += upipe_zoneplate_source_test
 upipe_zoneplate_source_test-src = upipe_zoneplate_source_test.c
 upipe_zoneplate_source_test-libs = libupipe libupipe_filters libupump_ev
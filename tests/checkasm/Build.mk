@@ -8,6 +8,8 @@ checkasm-src = \
     planar8_input.c \
     sdi_input.c \
     timer.h \
+    ts_crc32.c \
+    ts_sync_scan.c \
     uyvy_input.c \
     v210_input.c
 
@@ -26,4 +28,6 @@ $(builddir)/checkasm: \
     $(top_builddir)/lib/upipe-hbrmt/sdienc.o \
     $(top_builddir)/lib/upipe-hbrmt/sdidec.o \
     $(top_builddir)/lib/upipe-hbrmt/x86/sdienc.o \
-    $(top_builddir)/lib/upipe-hbrmt/x86/sdidec.o
+    $(top_builddir)/lib/upipe-hbrmt/x86/sdidec.o \
+    $(if $(have_bitstream),$(top_builddir)/lib/upipe-ts/upipe_ts_crc32.o \
+                           $(top_builddir)/lib/upipe-ts/upipe_ts_sync_scan.o)
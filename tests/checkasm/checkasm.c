@@ -78,6 +78,8 @@ static const struct {
     { "planar10_input", checkasm_check_planar10_input },
     { "planar8_input", checkasm_check_planar8_input },
     { "sdi_input", checkasm_check_sdi_input },
+    { "ts_crc32", checkasm_check_ts_crc32 },
+    { "ts_sync_scan", checkasm_check_ts_sync_scan },
     { "uyvy_input", checkasm_check_uyvy_input },
     { "v210_input", checkasm_check_v210_input },
     { NULL, NULL }
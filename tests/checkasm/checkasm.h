@@ -81,6 +81,8 @@
 void checkasm_check_planar10_input(void);
 void checkasm_check_planar8_input(void);
 void checkasm_check_sdi_input(void);
+void checkasm_check_ts_crc32(void);
+void checkasm_check_ts_sync_scan(void);
 void checkasm_check_uyvy_input(void);
 void checkasm_check_v210_input(void);
 
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <string.h>
+
+#include "checkasm.h"
+#ifdef HAVE_BITSTREAM
+#include "lib/upipe-ts/upipe_ts_crc32.h"
+#endif
+
+#define BUF_SIZE 4096
+
+/* bytewise implementation, as in bitstream */
+static uint32_t crc32_bytewise(uint32_t crc, const uint8_t *buf, size_t size)
+{
+    while (size--) {
+        crc ^= (uint32_t)*buf++ << 24;
+        for (int i = 0; i < 8; i++)
+            crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04c11db7 : crc << 1;
+    }
+    return crc;
+}
+
+static void check_crc32(uint32_t (*crc32)(uint32_t, const uint8_t *, size_t))
+{
+    if (check_func(crc32, "ts_crc32")) {
+        uint8_t buf[BUF_SIZE];
+        declare_func(uint32_t, uint32_t crc, const uint8_t *buf, size_t size);
+
+        for (int i = 0; i < BUF_SIZE; i++)
+            buf[i] = rnd();
+        for (int i = 0; i < 64; i++) {
+            size_t offset = rnd() % 8;
+            size_t size = rnd() % (BUF_SIZE - offset + 1);
+            uint32_t crc = rnd();
+            if (call_ref(crc, buf + offset, size) !=
+                    call_new(crc, buf + offset, size))
+                fail();
+        }
+        for (size_t size = 0; size < 16; size++)
+            if (call_ref(0xffffffff, buf, size) !=
+                    call_new(0xffffffff, buf, size))
+                fail();
+        bench_new(0xffffffff, buf, BUF_SIZE);
+    }
+}
+
+void checkasm_check_ts_crc32(void)
+{
+    /* the bytewise version is registered first so that it is the reference */
+    check_crc32(crc32_bytewise);
+#ifdef HAVE_BITSTREAM
+    check_crc32(upipe_ts_crc32);
+#endif
+    report("ts_crc32");
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <string.h>
+
+#include "checkasm.h"
+#ifdef HAVE_BITSTREAM
+#include "lib/upipe-ts/upipe_ts_sync_scan.h"
+#endif
+
+#define BUF_SIZE 4096
+
+#ifdef HAVE_BITSTREAM
+/* fills the buffer with noise, sync words in one octet out of density */
+static void randomize_buffer(uint8_t *buf, unsigned int density)
+{
+    for (int i = 0; i < BUF_SIZE; i++) {
+        buf[i] = rnd();
+        if (!(rnd() % density))
+            buf[i] = 0x47;
+        else if (buf[i] == 0x47)
+            buf[i] = 0;
+    }
+}
+#endif
+
+void checkasm_check_ts_sync_scan(void)
+{
+#ifdef HAVE_BITSTREAM
+    size_t (*scan)(const uint8_t *buffer, size_t size, size_t stride,
+                   unsigned int count) = upipe_ts_sync_scan_c;
+
+#if defined(__GNUC__) && defined(__x86_64__)
+    int cpu_flags = av_get_cpu_flags();
+
+    if (cpu_flags & AV_CPU_FLAG_SSE2)
+        scan = upipe_ts_sync_scan_sse2;
+    if (cpu_flags & AV_CPU_FLAG_AVX2)
+        scan = upipe_ts_sync_scan_avx2;
+#elif defined(__GNUC__) && defined(__aarch64__)
+    if (av_get_cpu_flags() & AV_CPU_FLAG_NEON)
+        scan = upipe_ts_sync_scan_neon;
+#endif
+
+    if (check_func(scan, "ts_sync_scan")) {
+        static const size_t strides[] = { 188, 196, 204 };
+        uint8_t buf[BUF_SIZE];
+        declare_func(size_t, const uint8_t *buffer, size_t size,
+                     size_t stride, unsigned int count);
+
+        for (int i = 0; i < 256; i++) {
+            size_t stride = strides[rnd() % 3];
+            unsigned int count = 1 + rnd() % 5;
+            randomize_buffer(buf, 1 + rnd() % 8);
+
+            /* plant a sequence of sync words, except sometimes */
+            size_t min = (count - 1) * stride;
+            size_t offset = rnd() % (BUF_SIZE - min);
+            if (rnd() % 4)
+                for (unsigned int k = 0; k < count; k++)
+                    buf[offset + k * stride] = 0x47;
+
+            size_t start = rnd() % 32;
+            size_t size = min + rnd() % (BUF_SIZE - start - min + 1);
+            if (call_ref(buf + start, size, stride, count) !=
+                    call_new(buf + start, size, stride, count))
+                fail();
+        }
+
+        /* steady state: aligned TS packets, and a lost one at the end */
+        memset(buf, 0xff, BUF_SIZE);
+        for (size_t offset = 0; offset < BUF_SIZE; offset += 188)
+            buf[offset] = 0x47;
+        for (size_t start = 0; start < 188; start++)
+            if (call_ref(buf + start, BUF_SIZE - start, 188, 2) !=
+                    call_new(buf + start, BUF_SIZE - start, 188, 2))
+                fail();
+
+        randomize_buffer(buf, 2);
+        bench_new(buf, BUF_SIZE, 188, 2);
+    }
+#endif
+    report("ts_sync_scan");
+}
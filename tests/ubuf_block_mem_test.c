@@ -295,6 +295,30 @@ int main(int argc, char **argv)
     ubuf_free(ubuf1);
     ubuf_free(ubuf2);
 
+    /* test ubuf_block_mem_alloc_from_umem */
+    struct umem umem;
+    assert(umem_alloc(umem_mgr, &umem, UBUF_SIZE));
+    for (int i = 0; i < UBUF_SIZE; i++)
+        umem_buffer(&umem)[i] = i;
+    assert(ubuf_block_mem_alloc_from_umem(mgr, &umem, 16,
+                                          UBUF_SIZE) == NULL);
+    ubuf1 = ubuf_block_mem_alloc_from_umem(mgr, &umem, 16, UBUF_SIZE - 16);
+    assert(ubuf1 != NULL);
+    ubase_assert(ubuf_block_size(ubuf1, &size));
+    assert(size == UBUF_SIZE - 16);
+    wanted = -1;
+    ubase_assert(ubuf_block_read(ubuf1, 0, &wanted, &r));
+    assert(wanted == UBUF_SIZE - 16);
+    assert(r[0] == 16);
+    ubase_assert(ubuf_block_unmap(ubuf1, 0));
+    ubuf2 = ubuf_block_splice(ubuf1, 4, 8);
+    assert(ubuf2 != NULL);
+    ubuf_free(ubuf1);
+    ubase_assert(ubuf_block_extract(ubuf2, 0, -1, buf));
+    for (int i = 0; i < 8; i++)
+        assert(buf[i] == i + 20);
+    ubuf_free(ubuf2);
+
     ubuf_mgr_release(mgr);
     umem_mgr_release(umem_mgr);
     return 0;
@@ -0,0 +1,264 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short unit tests for threaded avio output contexts and demuxers
+ */
+
+#undef NDEBUG
+
+#include "upipe/config.h"
+#include "upipe/ubase.h"
+#include "upipe/upump.h"
+#include "upump-ev/upump_ev.h"
+#include "lib/upipe-av/upipe_av_avio.h"
+#include "lib/upipe-av/upipe_av_demux.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+
+#include <libavutil/error.h>
+#include <libavformat/avformat.h>
+
+#define UPUMP_POOL 0
+#define UPUMP_BLOCKER_POOL 0
+#define BUFFER_SIZE 65536
+#define CHUNK_SIZE 1000
+#define HEADER_SIZE 44
+#define SAMPLE_RATE 48000
+#define NB_SAMPLES 200000
+#define DATA_SIZE (NB_SAMPLES * 2)
+
+#ifdef UPIPE_HAVE_PTHREAD
+
+static struct upump_mgr *upump_mgr;
+
+/** threaded avio context or demuxer notifying the watcher */
+static struct upipe_av_avio *avio = NULL;
+static struct upipe_av_demux *demux = NULL;
+/** number of notifications */
+static unsigned int nb_notifications = 0;
+
+/** returns the value of the octet at the given offset of the samples */
+static uint8_t pattern(size_t offset)
+{
+    return (offset * 7 + offset / 251) & 0xff;
+}
+
+/** writes a little-endian value */
+static void write_le(uint8_t *p, uint32_t value, unsigned int size)
+{
+    for (unsigned int i = 0; i < size; i++)
+        p[i] = value >> (8 * i);
+}
+
+/** builds a WAV header for mono s16le samples */
+static void build_header(uint8_t *header, uint32_t data_size)
+{
+    memcpy(header, "RIFF", 4);
+    write_le(header + 4, HEADER_SIZE - 8 + data_size, 4);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    write_le(header + 16, 16, 4);
+    write_le(header + 20, 1, 2);
+    write_le(header + 22, 1, 2);
+    write_le(header + 24, SAMPLE_RATE, 4);
+    write_le(header + 28, SAMPLE_RATE * 2, 4);
+    write_le(header + 32, 2, 2);
+    write_le(header + 34, 16, 2);
+    memcpy(header + 36, "data", 4);
+    write_le(header + 40, data_size, 4);
+}
+
+/** helper phony watcher, stopping the event loop on each notification */
+static void notified(struct upump *upump)
+{
+    if (avio != NULL)
+        upipe_av_avio_ack(avio);
+    if (demux != NULL)
+        upipe_av_demux_ack(demux);
+    nb_notifications++;
+    upump_stop(upump);
+}
+
+/** runs the event loop until the next notification */
+static void wait_notification(struct upump *upump)
+{
+    unsigned int nb = nb_notifications;
+    upump_start(upump);
+    upump_mgr_run(upump_mgr, NULL);
+    assert(nb_notifications == nb + 1);
+}
+
+/** writes a WAV file through the I/O thread, patching the header at the
+ * end */
+static void test_write(const char *path)
+{
+    avio = upipe_av_avio_alloc(BUFFER_SIZE);
+    assert(avio != NULL);
+    struct upump *upump = upipe_av_avio_upump_alloc(avio, upump_mgr,
+                                                    notified, NULL, NULL);
+    assert(upump != NULL);
+
+    assert(upipe_av_avio_open(avio, path, NULL) == 0);
+    while (upipe_av_avio_status(avio) == AVERROR(EAGAIN))
+        wait_notification(upump);
+    assert(upipe_av_avio_status(avio) == 0);
+
+    AVIOContext *pb = upipe_av_avio_context(avio);
+    assert(pb != NULL);
+    assert(pb->seekable & AVIO_SEEKABLE_NORMAL);
+
+    uint8_t header[HEADER_SIZE];
+    memset(header, 0, sizeof (header));
+    avio_write(pb, header, sizeof (header));
+
+    unsigned int nb_full = 0;
+    for (size_t offset = 0; offset < DATA_SIZE; offset += CHUNK_SIZE) {
+        while (upipe_av_avio_full(avio)) {
+            /* the event loop never blocks on the I/O thread */
+            nb_full++;
+            wait_notification(upump);
+        }
+        uint8_t chunk[CHUNK_SIZE];
+        for (size_t i = 0; i < CHUNK_SIZE; i++)
+            chunk[i] = pattern(offset + i);
+        avio_write(pb, chunk, CHUNK_SIZE);
+    }
+    avio_flush(pb);
+    printf("write buffer was full %u times\n", nb_full);
+
+    assert(avio_size(pb) == HEADER_SIZE + DATA_SIZE);
+    assert(avio_seek(pb, 0, SEEK_SET) == 0);
+    build_header(header, DATA_SIZE);
+    avio_write(pb, header, sizeof (header));
+    assert(avio_tell(pb) == HEADER_SIZE);
+    assert(avio_seek(pb, HEADER_SIZE + DATA_SIZE, SEEK_SET) ==
+           HEADER_SIZE + DATA_SIZE);
+    assert(avio_size(pb) == HEADER_SIZE + DATA_SIZE);
+
+    upipe_av_avio_close(avio);
+    upump_free(upump);
+    assert(upipe_av_avio_free(avio) == 0);
+    avio = NULL;
+
+    FILE *file = fopen(path, "rb");
+    assert(file != NULL);
+    uint8_t read_header[HEADER_SIZE];
+    assert(fread(read_header, 1, HEADER_SIZE, file) == HEADER_SIZE);
+    assert(!memcmp(read_header, header, HEADER_SIZE));
+    for (size_t offset = 0; offset < DATA_SIZE; offset++)
+        assert(fgetc(file) == pattern(offset));
+    assert(fgetc(file) == EOF);
+    fclose(file);
+}
+
+/** reads the WAV file back through the I/O thread */
+static void test_read(const char *path)
+{
+    demux = upipe_av_demux_alloc(path, NULL, BUFFER_SIZE);
+    assert(demux != NULL);
+    struct upump *upump = upipe_av_demux_upump_alloc(demux, upump_mgr,
+                                                     notified, NULL, NULL);
+    assert(upump != NULL);
+
+    AVFormatContext *context;
+    while (upipe_av_demux_context(demux, &context) == AVERROR(EAGAIN))
+        wait_notification(upump);
+    assert(upipe_av_demux_context(demux, &context) == 0);
+    assert(context != NULL);
+    assert(context->nb_streams == 1);
+    AVCodecParameters *codecpar = context->streams[0]->codecpar;
+    assert(codecpar->codec_id == AV_CODEC_ID_PCM_S16LE);
+    assert(codecpar->sample_rate == SAMPLE_RATE);
+    AVRational time_base = context->streams[0]->time_base;
+
+    /* nothing is read until the context is handed back */
+    AVPacket *pkt = av_packet_alloc();
+    assert(pkt != NULL);
+    assert(upipe_av_demux_read(demux, pkt) == AVERROR(EAGAIN));
+    upipe_av_demux_start(demux);
+    size_t offset = 0;
+    int error;
+    while ((error = upipe_av_demux_read(demux, pkt)) != AVERROR_EOF) {
+        if (error == AVERROR(EAGAIN)) {
+            wait_notification(upump);
+            continue;
+        }
+        assert(error == 0);
+        assert(pkt->stream_index == 0);
+        assert(!av_cmp_q(pkt->time_base, time_base));
+        for (int i = 0; i < pkt->size; i++)
+            assert(pkt->data[i] == pattern(offset + i));
+        offset += pkt->size;
+        av_packet_unref(pkt);
+    }
+    assert(offset == DATA_SIZE);
+    av_packet_free(&pkt);
+
+    upump_free(upump);
+    upipe_av_demux_free(demux);
+    demux = NULL;
+}
+
+/** checks that errors are posted back to the event loop */
+static void test_errors(const char *dir)
+{
+    char path[strlen(dir) + sizeof ("/missing/file.wav")];
+    sprintf(path, "%s/missing/file.wav", dir);
+
+    avio = upipe_av_avio_alloc(BUFFER_SIZE);
+    assert(avio != NULL);
+    struct upump *upump = upipe_av_avio_upump_alloc(avio, upump_mgr,
+                                                    notified, NULL, NULL);
+    assert(upump != NULL);
+    assert(upipe_av_avio_open(avio, path, NULL) == 0);
+    while (upipe_av_avio_status(avio) == AVERROR(EAGAIN))
+        wait_notification(upump);
+    assert(upipe_av_avio_status(avio) < 0);
+    upump_free(upump);
+    assert(upipe_av_avio_free(avio) < 0);
+    avio = NULL;
+
+    demux = upipe_av_demux_alloc(path, NULL, BUFFER_SIZE);
+    assert(demux != NULL);
+    upump = upipe_av_demux_upump_alloc(demux, upump_mgr, notified, NULL, NULL);
+    assert(upump != NULL);
+    AVFormatContext *context;
+    while (upipe_av_demux_context(demux, &context) == AVERROR(EAGAIN))
+        wait_notification(upump);
+    assert(upipe_av_demux_context(demux, &context) < 0);
+    assert(context == NULL);
+    upump_free(upump);
+    upipe_av_demux_free(demux);
+    demux = NULL;
+}
+
+#endif
+
+int main(int argc, char **argv)
+{
+#ifdef UPIPE_HAVE_PTHREAD
+    char dir[] = "upipe_av_avio_test.XXXXXX";
+    assert(mkdtemp(dir) != NULL);
+    char path[sizeof (dir) + sizeof ("/test.wav")];
+    sprintf(path, "%s/test.wav", dir);
+
+    upump_mgr = upump_ev_mgr_alloc_default(UPUMP_POOL, UPUMP_BLOCKER_POOL);
+    assert(upump_mgr != NULL);
+
+    test_write(path);
+    test_read(path);
+    test_errors(dir);
+
+    upump_mgr_release(upump_mgr);
+    unlink(path);
+    rmdir(dir);
+#endif
+    return 0;
+}
@@ -0,0 +1,258 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short unit tests for coalesced writes of the file sink pipe
+ */
+
+#undef NDEBUG
+
+#include "upipe/uprobe.h"
+#include "upipe/uprobe_stdio.h"
+#include "upipe/uprobe_prefix.h"
+#include "upipe/uprobe_upump_mgr.h"
+#include "upipe/umem.h"
+#include "upipe/umem_alloc.h"
+#include "upipe/udict.h"
+#include "upipe/udict_inline.h"
+#include "upipe/ubuf.h"
+#include "upipe/ubuf_block_mem.h"
+#include "upipe/uref.h"
+#include "upipe/uref_block.h"
+#include "upipe/uref_block_flow.h"
+#include "upipe/uref_std.h"
+#include "upipe/upump.h"
+#include "upump-ev/upump_ev.h"
+#include "upipe/upipe.h"
+#include "upipe-modules/upipe_file_sink.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <assert.h>
+
+#define UDICT_POOL_DEPTH 0
+#define UREF_POOL_DEPTH 0
+#define UBUF_POOL_DEPTH 0
+#define UPUMP_POOL 0
+#define UPUMP_BLOCKER_POOL 0
+#define UPROBE_LOG_LEVEL UPROBE_LOG_DEBUG
+#define BLOCK_SIZE 4096
+#define BUDGET 65536
+
+static struct uref_mgr *uref_mgr;
+static struct ubuf_mgr *ubuf_mgr;
+static struct upump_mgr *upump_mgr;
+static struct uprobe *logger;
+
+/** definition of our uprobe */
+static int catch(struct uprobe *uprobe, struct upipe *upipe,
+                 int event, va_list args)
+{
+    switch (event) {
+        default:
+            assert(0);
+            break;
+        case UPROBE_READY:
+        case UPROBE_DEAD:
+            break;
+    }
+    return UBASE_ERR_NONE;
+}
+
+/** returns the value of the octet at the given offset of the stream */
+static uint8_t pattern(size_t offset)
+{
+    return (offset * 7 + offset / 251) & 0xff;
+}
+
+/** sends the octets [begin, end[ of the stream by chunks */
+static void send_stream(struct upipe *fsink, size_t begin, size_t end,
+                        size_t chunk)
+{
+    for (size_t offset = begin; offset < end; offset += chunk) {
+        size_t size = end - offset < chunk ? end - offset : chunk;
+        struct uref *uref = uref_block_alloc(uref_mgr, ubuf_mgr, size);
+        assert(uref != NULL);
+        uint8_t *buffer;
+        int wanted = -1;
+        ubase_assert(uref_block_write(uref, 0, &wanted, &buffer));
+        assert(wanted == size);
+        for (size_t i = 0; i < size; i++)
+            buffer[i] = pattern(offset + i);
+        ubase_assert(uref_block_unmap(uref, 0));
+        upipe_input(fsink, uref, NULL);
+    }
+}
+
+/** checks that a file contains the octets [begin, end[ of the stream */
+static void check(const char *path, size_t begin, size_t end)
+{
+    struct stat st;
+    assert(stat(path, &st) == 0);
+    assert(st.st_size == end - begin);
+
+    int fd = open(path, O_RDONLY);
+    assert(fd != -1);
+    uint8_t buffer[end - begin + 1];
+    assert(read(fd, buffer, sizeof(buffer)) == end - begin);
+    close(fd);
+    for (size_t i = 0; i < end - begin; i++)
+        assert(buffer[i] == pattern(begin + i));
+}
+
+/** writes total octets by chunks, optionally changing the file at rotate */
+static void test(bool direct, uint64_t budget, size_t total, size_t chunk,
+                 size_t rotate)
+{
+    char path[] = "upipe_file_sink_test.XXXXXX";
+    char path2[] = "upipe_file_sink_test.XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd != -1);
+    close(fd);
+    fd = mkstemp(path2);
+    assert(fd != -1);
+    close(fd);
+
+    struct upipe_mgr *upipe_fsink_mgr = upipe_fsink_mgr_alloc();
+    assert(upipe_fsink_mgr != NULL);
+    struct upipe *fsink = upipe_void_alloc(upipe_fsink_mgr,
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                             "file sink"));
+    assert(fsink != NULL);
+    upipe_mgr_release(upipe_fsink_mgr);
+
+    struct uref *flow_def = uref_block_flow_alloc_def(uref_mgr, NULL);
+    assert(flow_def != NULL);
+    ubase_assert(upipe_set_flow_def(fsink, flow_def));
+    uref_free(flow_def);
+
+    unsigned int size;
+    bool value;
+    ubase_assert(upipe_fsink_set_coalesce(fsink, BLOCK_SIZE - 1, direct));
+    ubase_assert(upipe_fsink_get_coalesce(fsink, &size, &value));
+    assert(size == BLOCK_SIZE);
+    assert(value == direct);
+    if (budget)
+        ubase_assert(upipe_fsink_set_async(fsink, budget));
+    ubase_assert(upipe_fsink_set_path(fsink, path, UPIPE_FSINK_OVERWRITE));
+
+    if (rotate) {
+        send_stream(fsink, 0, rotate, chunk);
+        /* the partial block goes to the previous file */
+        ubase_assert(upipe_fsink_set_path(fsink, path2,
+                                          UPIPE_FSINK_OVERWRITE));
+        send_stream(fsink, rotate, total, chunk);
+    } else
+        send_stream(fsink, 0, total, chunk);
+
+    if (budget) {
+        struct upipe_fsink_stats stats;
+        ubase_assert(upipe_fsink_get_stats(fsink, &stats));
+        assert(stats.queued_bytes <= budget);
+        upump_mgr_run(upump_mgr, NULL);
+    }
+    /* the last partial block is written on release */
+    upipe_release(fsink);
+
+    if (rotate) {
+        check(path, 0, rotate);
+        check(path2, rotate, total);
+    } else
+        check(path, 0, total);
+    unlink(path);
+    unlink(path2);
+}
+
+/** writes before octets through the writer thread, then enables coalescing
+ * with O_DIRECT while they may still be queued */
+static void test_switch(size_t before, size_t total)
+{
+    char path[] = "upipe_file_sink_test.XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd != -1);
+    close(fd);
+
+    struct upipe_mgr *upipe_fsink_mgr = upipe_fsink_mgr_alloc();
+    assert(upipe_fsink_mgr != NULL);
+    struct upipe *fsink = upipe_void_alloc(upipe_fsink_mgr,
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                             "file sink"));
+    assert(fsink != NULL);
+    upipe_mgr_release(upipe_fsink_mgr);
+
+    struct uref *flow_def = uref_block_flow_alloc_def(uref_mgr, NULL);
+    assert(flow_def != NULL);
+    ubase_assert(upipe_set_flow_def(fsink, flow_def));
+    uref_free(flow_def);
+
+    ubase_assert(upipe_fsink_set_async(fsink, BUDGET));
+    ubase_assert(upipe_fsink_set_path(fsink, path, UPIPE_FSINK_OVERWRITE));
+    send_stream(fsink, 0, before, 188);
+    /* the queued writes are not aligned for O_DIRECT */
+    ubase_assert(upipe_fsink_set_coalesce(fsink, BLOCK_SIZE, true));
+    send_stream(fsink, before, total, 1000);
+
+    upump_mgr_run(upump_mgr, NULL);
+    upipe_release(fsink);
+
+    check(path, 0, total);
+    unlink(path);
+}
+
+int main(int argc, char *argv[])
+{
+    struct umem_mgr *umem_mgr = umem_alloc_mgr_alloc();
+    assert(umem_mgr != NULL);
+    struct udict_mgr *udict_mgr = udict_inline_mgr_alloc(UDICT_POOL_DEPTH,
+                                                         umem_mgr, -1, -1);
+    assert(udict_mgr != NULL);
+    uref_mgr = uref_std_mgr_alloc(UREF_POOL_DEPTH, udict_mgr, 0);
+    assert(uref_mgr != NULL);
+    ubuf_mgr = ubuf_block_mem_mgr_alloc(UBUF_POOL_DEPTH, UBUF_POOL_DEPTH,
+                                        umem_mgr, 0, 0, -1, 0);
+    assert(ubuf_mgr != NULL);
+    upump_mgr = upump_ev_mgr_alloc_default(UPUMP_POOL, UPUMP_BLOCKER_POOL);
+    assert(upump_mgr != NULL);
+
+    struct uprobe uprobe;
+    uprobe_init(&uprobe, catch, NULL);
+    logger = uprobe_stdio_alloc(&uprobe, stdout, UPROBE_LOG_LEVEL);
+    assert(logger != NULL);
+    logger = uprobe_upump_mgr_alloc(logger, upump_mgr);
+    assert(logger != NULL);
+
+    /* unaligned tail after full O_DIRECT blocks */
+    test(true, 0, 3 * BLOCK_SIZE + 100, 1000, 0);
+    /* aligned end, no tail */
+    test(true, 0, 2 * BLOCK_SIZE, 512, 0);
+    /* final flush of a file smaller than a block */
+    test(true, 0, 100, 100, 0);
+    test(false, 0, 100, 30, 0);
+    /* chunks larger than a block */
+    test(true, 0, 5 * BLOCK_SIZE + 1, 3 * BLOCK_SIZE + 5, 0);
+    /* through the writer thread */
+    test(true, BUDGET, 5 * BLOCK_SIZE + 1, 777, 0);
+    test(true, BUDGET, 100, 100, 0);
+    /* the partial block is flushed when the file changes */
+    test(true, 0, 4 * BLOCK_SIZE + 10, 1000, 2 * BLOCK_SIZE + 300);
+    test(true, BUDGET, 4 * BLOCK_SIZE + 10, 1000, 2 * BLOCK_SIZE + 300);
+    /* O_DIRECT enabled while buffers are queued on the writer thread */
+    test_switch(2 * BLOCK_SIZE, 4 * BLOCK_SIZE + 100);
+    test_switch(1000, 3 * BLOCK_SIZE);
+
+    upump_mgr_release(upump_mgr);
+    ubuf_mgr_release(ubuf_mgr);
+    uref_mgr_release(uref_mgr);
+    udict_mgr_release(udict_mgr);
+    umem_mgr_release(umem_mgr);
+    uprobe_release(logger);
+    uprobe_clean(&uprobe);
+    return 0;
+}
@@ -48,9 +48,11 @@
 #define UPROBE_LOG_LEVEL UPROBE_LOG_DEBUG
 
 static void usage(const char *argv0) {
-    fprintf(stdout, "Usage: %s [-d <delay>] [-a|-o] <source file> <sink file>\n", argv0);
+    fprintf(stdout, "Usage: %s [-d <delay>] [-w <budget>] [-m <window>] [-a|-o] <source file> <sink file>\n", argv0);
     fprintf(stdout, "-a : append\n");
     fprintf(stdout, "-o : overwrite\n");
+    fprintf(stdout, "-w : write from a thread with the given byte budget\n");
+    fprintf(stdout, "-m : map the source file by windows of the given size\n");
     exit(EXIT_FAILURE);
 }
 
@@ -75,13 +77,21 @@ int main(int argc, char *argv[])
 {
     const char *src_file, *sink_file;
     int64_t delay = 0;
+    uint64_t budget = 0;
+    uint64_t window = 0;
     enum upipe_fsink_mode mode = UPIPE_FSINK_CREATE;
     int opt;
-    while ((opt = getopt(argc, argv, "d:ao")) != -1) {
+    while ((opt = getopt(argc, argv, "d:w:m:ao")) != -1) {
         switch (opt) {
             case 'd':
                 delay = atoi(optarg);
                 break;
+            case 'm':
+                window = strtoull(optarg, NULL, 0);
+                break;
+            case 'w':
+                budget = strtoull(optarg, NULL, 0);
+                break;
             case 'a':
                 mode = UPIPE_FSINK_APPEND;
                 break;
@@ -134,6 +144,12 @@ int main(int argc, char *argv[])
                              UPROBE_LOG_LEVEL, "file source"));
     assert(upipe_fsrc != NULL);
     ubase_assert(upipe_set_output_size(upipe_fsrc, READ_SIZE));
+    if (window) {
+        uint64_t value;
+        ubase_assert(upipe_fsrc_set_mmap(upipe_fsrc, window));
+        ubase_assert(upipe_fsrc_get_mmap(upipe_fsrc, &value));
+        assert(value == window);
+    }
     ubase_assert(upipe_set_uri(upipe_fsrc, src_file));
     uint64_t size;
     if (ubase_check(upipe_src_get_size(upipe_fsrc, &size)))
@@ -164,6 +180,12 @@ int main(int argc, char *argv[])
     assert(upipe_fsink != NULL);
     if (delay)
         ubase_assert(upipe_attach_uclock(upipe_fsink));
+    if (budget) {
+        uint64_t value;
+        ubase_assert(upipe_fsink_set_async(upipe_fsink, budget));
+        ubase_assert(upipe_fsink_get_async(upipe_fsink, &value));
+        assert(value == budget);
+    }
     ubase_assert(upipe_fsink_set_path(upipe_fsink, sink_file, mode));
     upipe_release(upipe_fsink);
 
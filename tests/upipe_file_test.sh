@@ -10,3 +10,11 @@ trap cleanup EXIT
 
 "$srcdir"/valgrind_wrapper.sh "$srcdir" ./upipe_file_test "$srcdir"/upipe_ts_test.ts "$TMP"/test
 cmp --quiet "$TMP"/test "$srcdir"/upipe_ts_test.ts
+
+rm -f "$TMP"/test
+"$srcdir"/valgrind_wrapper.sh "$srcdir" ./upipe_file_test -w 65536 "$srcdir"/upipe_ts_test.ts "$TMP"/test
+cmp --quiet "$TMP"/test "$srcdir"/upipe_ts_test.ts
+
+rm -f "$TMP"/test
+"$srcdir"/valgrind_wrapper.sh "$srcdir" ./upipe_file_test -m 65536 "$srcdir"/upipe_ts_test.ts "$TMP"/test
+cmp --quiet "$TMP"/test "$srcdir"/upipe_ts_test.ts
@@ -0,0 +1,472 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short unit tests for the prefetch cache of the hls playlist pipe
+ */
+
+#undef NDEBUG
+
+#include "upipe/uprobe.h"
+#include "upipe/uprobe_stdio.h"
+#include "upipe/uprobe_prefix.h"
+#include "upipe/uprobe_uref_mgr.h"
+#include "upipe/uprobe_upump_mgr.h"
+#include "upipe/uprobe_source_mgr.h"
+#include "upipe/uclock.h"
+#include "upipe/umem.h"
+#include "upipe/umem_alloc.h"
+#include "upipe/udict.h"
+#include "upipe/udict_inline.h"
+#include "upipe/ubuf.h"
+#include "upipe/ubuf_block_mem.h"
+#include "upipe/uref.h"
+#include "upipe/uref_block.h"
+#include "upipe/uref_block_flow.h"
+#include "upipe/uref_flow.h"
+#include "upipe/uref_uri.h"
+#include "upipe/uref_m3u.h"
+#include "upipe/uref_m3u_playlist.h"
+#include "upipe/uref_m3u_playlist_flow.h"
+#include "upipe/uref_std.h"
+#include "upipe/upump.h"
+#include "upipe/upump_blocker.h"
+#include "upump-ev/upump_ev.h"
+#include "upipe/upipe.h"
+#include "upipe-hls/upipe_hls_playlist.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#define UDICT_POOL_DEPTH 0
+#define UREF_POOL_DEPTH 0
+#define UBUF_POOL_DEPTH 0
+#define UPUMP_POOL 0
+#define UPUMP_BLOCKER_POOL 0
+#define UPROBE_LOG_LEVEL UPROBE_LOG_DEBUG
+#define NB_ITEMS 5
+#define PREFETCH 2
+#define CHUNK_SIZE 1000
+#define CACHE_SIZE (3 * CHUNK_SIZE)
+#define MAX_SOURCES 16
+#define PUMPED_CHUNKS (3 * CACHE_SIZE / CHUNK_SIZE)
+
+static struct uref_mgr *uref_mgr;
+static struct ubuf_mgr *ubuf_mgr;
+static struct upump_mgr *upump_mgr;
+/** playlist pipe */
+static struct upipe *playlist;
+
+/** number of ended items */
+static unsigned int item_ends = 0;
+/** number of octets received at the output */
+static size_t received = 0;
+/** number of chunks output by sources from a pump, or 0 */
+static unsigned int pumped_chunks = 0;
+/** true if the output blocks its input */
+static bool sink_block = false;
+/** blocker of the output */
+static struct upump_blocker *sink_blocker = NULL;
+
+/** phony source pipe */
+struct source {
+    /** refcount management structure */
+    struct urefcount urefcount;
+    /** public structure */
+    struct upipe upipe;
+    /** output pipe */
+    struct upipe *output;
+    /** uri of the item */
+    char *uri;
+    /** pump outputting the chunks */
+    struct upump *upump;
+    /** number of chunks output from the pump */
+    unsigned int sent;
+    /** true once released by the playlist */
+    bool dead;
+};
+
+/** sources allocated by the playlist, in order */
+static struct source *sources[MAX_SOURCES];
+/** number of allocated sources */
+static unsigned int nb_sources = 0;
+
+/** definition of our uprobe */
+static int catch(struct uprobe *uprobe, struct upipe *upipe,
+                 int event, va_list args)
+{
+    switch (event) {
+        case UPROBE_FATAL:
+        case UPROBE_ERROR:
+            assert(0);
+            break;
+        default:
+            if (uprobe_check_extended(event, args,
+                                      UPROBE_HLS_PLAYLIST_ITEM_END,
+                                      UPIPE_HLS_PLAYLIST_SIGNATURE))
+                item_ends++;
+            break;
+    }
+    return UBASE_ERR_NONE;
+}
+
+/** helper phony source pipe */
+static void source_free(struct urefcount *urefcount)
+{
+    struct source *source = container_of(urefcount, struct source, urefcount);
+    if (source->upump != NULL)
+        upump_free(source->upump);
+    source->upump = NULL;
+    upipe_release(source->output);
+    source->output = NULL;
+    source->dead = true;
+    upipe_clean(&source->upipe);
+}
+
+/** helper phony source pipe */
+static struct upipe *source_alloc(struct upipe_mgr *mgr, struct uprobe *uprobe,
+                                  uint32_t signature, va_list args)
+{
+    struct source *source = malloc(sizeof (struct source));
+    assert(source != NULL);
+    source->output = NULL;
+    source->uri = NULL;
+    source->upump = NULL;
+    source->sent = 0;
+    source->dead = false;
+    urefcount_init(&source->urefcount, source_free);
+    upipe_init(&source->upipe, mgr, uprobe);
+    source->upipe.refcount = &source->urefcount;
+    assert(nb_sources < MAX_SOURCES);
+    sources[nb_sources++] = source;
+    return &source->upipe;
+}
+
+/** checks that the cache stays within its maximum size */
+static void check_cache_size(void)
+{
+    struct upipe_hls_playlist_stats stats;
+    ubase_assert(upipe_hls_playlist_get_stats(playlist, &stats));
+    assert(stats.size <= CACHE_SIZE);
+}
+
+/** helper phony source pipe outputting chunks from a pump */
+static void source_worker(struct upump *upump)
+{
+    struct source *source = upump_get_opaque(upump, struct source *);
+    if (source->sent == pumped_chunks) {
+        upump_free(source->upump);
+        source->upump = NULL;
+        upipe_throw_source_end(&source->upipe);
+        return;
+    }
+
+    if (!source->sent) {
+        struct uref *flow_def = uref_block_flow_alloc_def(uref_mgr, NULL);
+        assert(flow_def != NULL);
+        ubase_assert(upipe_set_flow_def(source->output, flow_def));
+        uref_free(flow_def);
+    }
+    struct uref *uref = uref_block_alloc(uref_mgr, ubuf_mgr, CHUNK_SIZE);
+    assert(uref != NULL);
+    source->sent++;
+    upipe_input(source->output, uref, &source->upump);
+    check_cache_size();
+}
+
+/** helper phony source pipe */
+static int source_control(struct upipe *upipe, int command, va_list args)
+{
+    struct source *source = container_of(upipe, struct source, upipe);
+    switch (command) {
+        case UPIPE_SET_URI:
+            free(source->uri);
+            source->uri = strdup(va_arg(args, const char *));
+            if (pumped_chunks && source->upump == NULL) {
+                source->upump = upump_alloc_idler(upump_mgr, source_worker,
+                                                  source, NULL);
+                assert(source->upump != NULL);
+                upump_start(source->upump);
+            }
+            return UBASE_ERR_NONE;
+        case UPIPE_SET_OUTPUT:
+            upipe_release(source->output);
+            source->output = upipe_use(va_arg(args, struct upipe *));
+            return UBASE_ERR_NONE;
+        case UPIPE_SRC_SET_RANGE:
+        case UPIPE_ATTACH_UCLOCK:
+            return UBASE_ERR_NONE;
+        default:
+            return UBASE_ERR_UNHANDLED;
+    }
+}
+
+/** phony source manager */
+static struct upipe_mgr source_mgr = {
+    .refcount = NULL,
+    .signature = 0,
+    .upipe_alloc = source_alloc,
+    .upipe_input = NULL,
+    .upipe_control = source_control
+};
+
+/** returns true if the source was released by the playlist */
+static bool source_dead(unsigned int n)
+{
+    return sources[n]->dead;
+}
+
+/** outputs a block from a source */
+static void source_feed(unsigned int n, size_t size)
+{
+    struct source *source = sources[n];
+    assert(!source_dead(n));
+    struct uref *flow_def = uref_block_flow_alloc_def(uref_mgr, NULL);
+    assert(flow_def != NULL);
+    ubase_assert(upipe_set_flow_def(source->output, flow_def));
+    uref_free(flow_def);
+    struct uref *uref = uref_block_alloc(uref_mgr, ubuf_mgr, size);
+    assert(uref != NULL);
+    upipe_input(source->output, uref, NULL);
+}
+
+/** ends a source */
+static void source_end(unsigned int n)
+{
+    assert(!source_dead(n));
+    upipe_throw_source_end(&sources[n]->upipe);
+}
+
+/** helper phony pipe counting the output octets */
+static struct upipe *sink_alloc(struct upipe_mgr *mgr, struct uprobe *uprobe,
+                                uint32_t signature, va_list args)
+{
+    struct upipe *upipe = malloc(sizeof (struct upipe));
+    assert(upipe != NULL);
+    upipe_init(upipe, mgr, uprobe);
+    return upipe;
+}
+
+/** helper phony pipe counting the output octets */
+static void sink_blocker_cb(struct upump_blocker *blocker)
+{
+    assert(blocker == sink_blocker);
+    upump_blocker_free(blocker);
+    sink_blocker = NULL;
+}
+
+/** helper phony pipe counting the output octets */
+static void sink_input(struct upipe *upipe, struct uref *uref,
+                       struct upump **upump_p)
+{
+    size_t size;
+    ubase_assert(uref_block_size(uref, &size));
+    received += size;
+    uref_free(uref);
+    if (sink_block && sink_blocker == NULL) {
+        assert(upump_p != NULL && *upump_p != NULL);
+        sink_blocker = upump_blocker_alloc(*upump_p, sink_blocker_cb, NULL);
+        assert(sink_blocker != NULL);
+    }
+}
+
+/** helper phony pipe counting the output octets */
+static int sink_control(struct upipe *upipe, int command, va_list args)
+{
+    switch (command) {
+        case UPIPE_REGISTER_REQUEST:
+        case UPIPE_UNREGISTER_REQUEST:
+        case UPIPE_SET_FLOW_DEF:
+            return UBASE_ERR_NONE;
+        default:
+            return UBASE_ERR_UNHANDLED;
+    }
+}
+
+/** helper phony pipe counting the output octets */
+static struct upipe_mgr sink_mgr = {
+    .refcount = NULL,
+    .signature = 0,
+    .upipe_alloc = sink_alloc,
+    .upipe_input = sink_input,
+    .upipe_control = sink_control
+};
+
+/** checks the statistics of the cache */
+static void check_stats(struct upipe *upipe, uint64_t hits, uint64_t misses,
+                        uint64_t evictions, uint64_t size)
+{
+    struct upipe_hls_playlist_stats stats;
+    ubase_assert(upipe_hls_playlist_get_stats(upipe, &stats));
+    assert(stats.hits == hits);
+    assert(stats.misses == misses);
+    assert(stats.evictions == evictions);
+    assert(stats.size == size);
+}
+
+int main(int argc, char *argv[])
+{
+    struct umem_mgr *umem_mgr = umem_alloc_mgr_alloc();
+    assert(umem_mgr != NULL);
+    struct udict_mgr *udict_mgr = udict_inline_mgr_alloc(UDICT_POOL_DEPTH,
+                                                         umem_mgr, -1, -1);
+    assert(udict_mgr != NULL);
+    uref_mgr = uref_std_mgr_alloc(UREF_POOL_DEPTH, udict_mgr, 0);
+    assert(uref_mgr != NULL);
+    ubuf_mgr = ubuf_block_mem_mgr_alloc(UBUF_POOL_DEPTH, UBUF_POOL_DEPTH,
+                                        umem_mgr, 0, 0, -1, 0);
+    assert(ubuf_mgr != NULL);
+    upump_mgr = upump_ev_mgr_alloc_default(UPUMP_POOL, UPUMP_BLOCKER_POOL);
+    assert(upump_mgr != NULL);
+
+    struct uprobe uprobe;
+    uprobe_init(&uprobe, catch, NULL);
+    struct uprobe *logger = uprobe_stdio_alloc(&uprobe, stdout,
+                                               UPROBE_LOG_LEVEL);
+    assert(logger != NULL);
+    logger = uprobe_uref_mgr_alloc(logger, uref_mgr);
+    assert(logger != NULL);
+    logger = uprobe_upump_mgr_alloc(logger, upump_mgr);
+    assert(logger != NULL);
+    logger = uprobe_source_mgr_alloc(logger, &source_mgr);
+    assert(logger != NULL);
+
+    struct upipe_mgr *upipe_hls_playlist_mgr = upipe_hls_playlist_mgr_alloc();
+    assert(upipe_hls_playlist_mgr != NULL);
+    struct upipe *upipe = upipe_void_alloc(upipe_hls_playlist_mgr,
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                             "playlist"));
+    assert(upipe != NULL);
+    upipe_mgr_release(upipe_hls_playlist_mgr);
+    playlist = upipe;
+
+    struct upipe *sink = upipe_void_alloc(&sink_mgr, uprobe_use(logger));
+    assert(sink != NULL);
+    ubase_assert(upipe_set_output(upipe, sink));
+    ubase_assert(upipe_hls_playlist_set_prefetch(upipe, PREFETCH,
+                                                 CACHE_SIZE));
+
+    /* VOD playlist of NB_ITEMS items */
+    struct uref *flow_def = uref_alloc_control(uref_mgr);
+    assert(flow_def != NULL);
+    ubase_assert(uref_flow_set_def(flow_def, "block.m3u.playlist."));
+    ubase_assert(uref_uri_set_from_str(flow_def,
+                                       "http://localhost/playlist.m3u8"));
+    ubase_assert(uref_m3u_playlist_flow_set_type(flow_def, "VOD"));
+    ubase_assert(uref_m3u_playlist_flow_set_endlist(flow_def));
+    ubase_assert(uref_m3u_playlist_flow_set_media_sequence(flow_def, 0));
+    ubase_assert(uref_m3u_playlist_flow_set_target_duration(flow_def,
+                                                            UCLOCK_FREQ));
+    ubase_assert(upipe_set_flow_def(upipe, flow_def));
+    uref_free(flow_def);
+
+    for (unsigned int i = 0; i < NB_ITEMS; i++) {
+        struct uref *item = uref_alloc(uref_mgr);
+        assert(item != NULL);
+        char uri[64];
+        snprintf(uri, sizeof (uri), "http://localhost/segment%u.ts", i);
+        ubase_assert(uref_m3u_set_uri(item, uri));
+        ubase_assert(uref_m3u_playlist_set_seq_duration(item, UCLOCK_FREQ));
+        if (i == NB_ITEMS - 1)
+            uref_block_set_end(item);
+        upipe_input(upipe, item, NULL);
+    }
+
+    /* the first item is downloaded, and the next ones are prefetched */
+    ubase_assert(upipe_hls_playlist_play(upipe));
+    assert(nb_sources == 1 + PREFETCH);
+    assert(!strcmp(sources[0]->uri, "http://localhost/segment0.ts"));
+    assert(!strcmp(sources[1]->uri, "http://localhost/segment1.ts"));
+    assert(!strcmp(sources[2]->uri, "http://localhost/segment2.ts"));
+    check_stats(upipe, 0, 1, 0, 0);
+
+    source_feed(1, CHUNK_SIZE);
+    source_feed(2, CHUNK_SIZE);
+    source_feed(0, CHUNK_SIZE);
+    check_stats(upipe, 0, 1, 0, 3 * CHUNK_SIZE);
+
+    /* the playing item counts against the cache size, the farthest
+     * prefetched item is dropped to make room for it */
+    source_feed(0, CHUNK_SIZE);
+    check_stats(upipe, 0, 1, 1, 3 * CHUNK_SIZE);
+    assert(source_dead(2));
+    assert(!source_dead(1));
+
+    source_end(0);
+    upump_mgr_run(upump_mgr, NULL);
+    assert(received == 2 * CHUNK_SIZE);
+    assert(item_ends == 1);
+    assert(source_dead(0));
+    check_stats(upipe, 0, 1, 1, CHUNK_SIZE);
+
+    /* the next item is played from the cache, and the dropped item is
+     * prefetched again */
+    ubase_assert(upipe_hls_playlist_next(upipe));
+    ubase_assert(upipe_hls_playlist_play(upipe));
+    check_stats(upipe, 1, 1, 1, CHUNK_SIZE);
+    assert(nb_sources == 5);
+    assert(!strcmp(sources[3]->uri, "http://localhost/segment2.ts"));
+    assert(!strcmp(sources[4]->uri, "http://localhost/segment3.ts"));
+
+    /* the data of the playing item that does not fit is held out of the
+     * cache until there is room */
+    source_feed(1, 3 * CHUNK_SIZE);
+    check_stats(upipe, 1, 1, 3, CHUNK_SIZE);
+    assert(source_dead(3));
+    assert(source_dead(4));
+
+    source_end(1);
+    upump_mgr_run(upump_mgr, NULL);
+    assert(received == 6 * CHUNK_SIZE);
+    assert(item_ends == 2);
+    check_stats(upipe, 1, 1, 3, 0);
+
+    /* while the output is blocked, the source of the playing item is
+     * blocked once the cache is full */
+    unsigned int first = nb_sources;
+    pumped_chunks = PUMPED_CHUNKS;
+    sink_block = true;
+    ubase_assert(upipe_hls_playlist_next(upipe));
+    ubase_assert(upipe_hls_playlist_play(upipe));
+    assert(nb_sources == first + 3);
+    assert(!strcmp(sources[first]->uri, "http://localhost/segment2.ts"));
+    upump_mgr_run(upump_mgr, NULL);
+    assert(sink_blocker != NULL);
+    assert(received == 7 * CHUNK_SIZE);
+    assert(!source_dead(first));
+    assert(sources[first]->sent < PUMPED_CHUNKS);
+    assert(sources[first]->upump != NULL);
+    check_cache_size();
+
+    /* the source is unblocked when the output drains the cache */
+    sink_block = false;
+    upump_blocker_free(sink_blocker);
+    sink_blocker = NULL;
+    upump_mgr_run(upump_mgr, NULL);
+    assert(received == (6 + PUMPED_CHUNKS) * CHUNK_SIZE);
+    assert(item_ends == 3);
+    assert(source_dead(first));
+
+    upipe_release(upipe);
+    for (unsigned int i = 0; i < nb_sources; i++) {
+        assert(source_dead(i));
+        free(sources[i]->uri);
+        free(sources[i]);
+    }
+    upipe_clean(sink);
+    free(sink);
+
+    upump_mgr_release(upump_mgr);
+    ubuf_mgr_release(ubuf_mgr);
+    uref_mgr_release(uref_mgr);
+    udict_mgr_release(udict_mgr);
+    umem_mgr_release(umem_mgr);
+    uprobe_release(logger);
+    uprobe_clean(&uprobe);
+    return 0;
+}
@@ -0,0 +1,381 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short unit tests for the HLS sink pipe
+ *
+ * A program with a video PID and a multi-packet PMT is cut into segments
+ * and low-latency parts, with a PCR discontinuity which then slides out of
+ * the playlist window.
+ */
+
+#undef NDEBUG
+
+#include "upipe/uprobe.h"
+#include "upipe/uprobe_stdio.h"
+#include "upipe/uprobe_prefix.h"
+#include "upipe/umem.h"
+#include "upipe/umem_alloc.h"
+#include "upipe/udict.h"
+#include "upipe/udict_inline.h"
+#include "upipe/ubuf.h"
+#include "upipe/ubuf_block_mem.h"
+#include "upipe/uclock.h"
+#include "upipe/uref.h"
+#include "upipe/uref_block.h"
+#include "upipe/uref_block_flow.h"
+#include "upipe/uref_std.h"
+#include "upipe/upipe.h"
+#include "upipe-modules/upipe_file_sink.h"
+#include "upipe-hls/upipe_hls_sink.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/param.h>
+#include <assert.h>
+
+#include <bitstream/mpeg/ts.h>
+#include <bitstream/mpeg/psi.h>
+
+#define UDICT_POOL_DEPTH 0
+#define UREF_POOL_DEPTH 0
+#define UBUF_POOL_DEPTH 0
+#define UPROBE_LOG_LEVEL UPROBE_LOG_DEBUG
+#define PMT_PID 0x100
+#define AUDIO_PID 0x101
+#define VIDEO_PID 0x200
+/** number of audio elementary streams, making the PMT span two packets */
+#define NB_AUDIO 40
+/** interval between packets of a PID */
+#define TICK (UCLOCK_FREQ / 25)
+/** number of ticks between video random access points */
+#define GOP 30
+/** number of ticks between tables */
+#define PSI_INTERVAL 25
+/** the PCR jumps at this tick */
+#define JUMP (2 * GOP)
+#define NB_TICKS (20 * GOP)
+#define DURATION (2 * UCLOCK_FREQ)
+#define PART_DURATION (UCLOCK_FREQ / 2)
+#define WINDOW 3
+#define PREFIX "seg"
+
+static struct uref_mgr *uref_mgr;
+static struct ubuf_mgr *ubuf_mgr;
+static char dir[] = "upipe_hls_sink_test.XXXXXX";
+static uint8_t cc[8192];
+
+/** definition of our uprobe */
+static int catch(struct uprobe *uprobe, struct upipe *upipe,
+                 int event, va_list args)
+{
+    switch (event) {
+        default:
+            assert(0);
+            break;
+        case UPROBE_READY:
+        case UPROBE_DEAD:
+        case UPROBE_NEED_UPUMP_MGR:
+            break;
+    }
+    return UBASE_ERR_NONE;
+}
+
+/** sends a packet to the sink and returns a pointer to fill it in */
+static struct uref *packet_alloc(uint16_t pid, bool unitstart,
+                                 uint8_t **ts_p)
+{
+    struct uref *uref = uref_block_alloc(uref_mgr, ubuf_mgr, TS_SIZE);
+    assert(uref != NULL);
+    int size = -1;
+    ubase_assert(uref_block_write(uref, 0, &size, ts_p));
+    assert(size == TS_SIZE);
+    memset(*ts_p, 0xff, TS_SIZE);
+    ts_init(*ts_p);
+    ts_set_pid(*ts_p, pid);
+    ts_set_cc(*ts_p, cc[pid]++);
+    ts_set_payload(*ts_p);
+    if (unitstart)
+        ts_set_unitstart(*ts_p);
+    return uref;
+}
+
+/** sends a section, split into packets */
+static void send_section(struct upipe *upipe, uint16_t pid,
+                         const uint8_t *section)
+{
+    size_t size = psi_get_length(section) + PSI_HEADER_SIZE;
+    size_t offset = 0;
+    while (offset < size) {
+        uint8_t *ts;
+        struct uref *uref = packet_alloc(pid, !offset, &ts);
+        uint8_t *payload = ts + TS_HEADER_SIZE;
+        if (!offset)
+            *payload++ = 0;
+        size_t chunk = MIN(size - offset, ts + TS_SIZE - payload);
+        memcpy(payload, section + offset, chunk);
+        offset += chunk;
+        uref_block_unmap(uref, 0);
+        upipe_input(upipe, uref, NULL);
+    }
+}
+
+/** sends the PAT and the two-packet PMT */
+static void send_psi(struct upipe *upipe)
+{
+    uint8_t pat[PSI_MAX_SIZE + PSI_HEADER_SIZE];
+    pat_init(pat);
+    pat_set_length(pat, PAT_PROGRAM_SIZE);
+    pat_set_tsid(pat, 1);
+    psi_set_version(pat, 0);
+    psi_set_current(pat);
+    psi_set_section(pat, 0);
+    psi_set_lastsection(pat, 0);
+    uint8_t *program = pat_get_program(pat, 0);
+    patn_init(program);
+    patn_set_program(program, 1);
+    patn_set_pid(program, PMT_PID);
+    psi_set_crc(pat);
+    send_section(upipe, PAT_PID, pat);
+
+    /* the video PID is listed last, in the second packet */
+    uint8_t pmt[PSI_MAX_SIZE + PSI_HEADER_SIZE];
+    pmt_init(pmt);
+    pmt_set_length(pmt, (NB_AUDIO + 1) * PMT_ES_SIZE);
+    pmt_set_program(pmt, 1);
+    psi_set_version(pmt, 0);
+    psi_set_current(pmt);
+    psi_set_section(pmt, 0);
+    psi_set_lastsection(pmt, 0);
+    pmt_set_pcrpid(pmt, AUDIO_PID);
+    pmt_set_desclength(pmt, 0);
+    for (int i = 0; i <= NB_AUDIO; i++) {
+        uint8_t *es = pmt_get_es(pmt, i);
+        assert(es != NULL);
+        pmtn_init(es);
+        pmtn_set_streamtype(es, i < NB_AUDIO ? PMT_STREAMTYPE_AUDIO_MPEG2 :
+                                               PMT_STREAMTYPE_VIDEO_AVC);
+        pmtn_set_pid(es, i < NB_AUDIO ? AUDIO_PID + i : VIDEO_PID);
+        pmtn_set_desclength(es, 0);
+    }
+    psi_set_crc(pmt);
+    assert(psi_get_length(pmt) + PSI_HEADER_SIZE > TS_SIZE - TS_HEADER_SIZE);
+    send_section(upipe, PMT_PID, pmt);
+}
+
+/** sends the packets of a tick: video first, then audio with a PCR */
+static void send_tick(struct upipe *upipe, unsigned int tick)
+{
+    uint8_t *ts;
+    struct uref *uref = packet_alloc(VIDEO_PID, true, &ts);
+    if (!(tick % GOP)) {
+        ts_set_adaptation(ts, 1);
+        tsaf_set_randomaccess(ts);
+    }
+    uref_block_unmap(uref, 0);
+    upipe_input(upipe, uref, NULL);
+
+    /* audio frames are all random access points */
+    uint64_t pcr = tick * TICK + (tick >= JUMP ? 100 * UCLOCK_FREQ : 0);
+    uref = packet_alloc(AUDIO_PID, true, &ts);
+    ts_set_adaptation(ts, 7);
+    tsaf_set_randomaccess(ts);
+    tsaf_set_pcr(ts, pcr / 300);
+    tsaf_set_pcrext(ts, pcr % 300);
+    uref_block_unmap(uref, 0);
+    upipe_input(upipe, uref, NULL);
+}
+
+/** checks that a segment starts with the tables, then a video access point */
+static void check_segment(unsigned int sequence, uint64_t size)
+{
+    char path[MAXPATHLEN];
+    snprintf(path, sizeof (path), "%s/" PREFIX "%u.ts", dir, sequence);
+    struct stat st;
+    assert(stat(path, &st) == 0);
+    assert(st.st_size == size);
+    assert(!(size % TS_SIZE));
+
+    uint8_t ts[4 * TS_SIZE];
+    int fd = open(path, O_RDONLY);
+    assert(fd != -1);
+    assert(read(fd, ts, sizeof (ts)) == sizeof (ts));
+    close(fd);
+    assert(ts_get_pid(ts) == PAT_PID && ts_get_unitstart(ts));
+    assert(ts_get_pid(ts + TS_SIZE) == PMT_PID &&
+           ts_get_unitstart(ts + TS_SIZE));
+    assert(ts_get_pid(ts + 2 * TS_SIZE) == PMT_PID &&
+           !ts_get_unitstart(ts + 2 * TS_SIZE));
+    uint8_t *rap = ts + 3 * TS_SIZE;
+    assert(ts_get_pid(rap) == VIDEO_PID);
+    assert(ts_has_adaptation(rap) && tsaf_has_randomaccess(rap));
+}
+
+/** checks that a segment was deleted */
+static void check_deleted(unsigned int sequence)
+{
+    char path[MAXPATHLEN];
+    snprintf(path, sizeof (path), "%s/" PREFIX "%u.ts", dir, sequence);
+    assert(access(path, F_OK) == -1);
+}
+
+/** checks the playlist, the segments and the parts it lists */
+static void check_playlist(unsigned int media_sequence, bool ended)
+{
+    char path[MAXPATHLEN];
+    snprintf(path, sizeof (path), "%s/playlist.m3u8", dir);
+    FILE *f = fopen(path, "r");
+    assert(f != NULL);
+
+    char line[256];
+    unsigned int sequence = UINT_MAX, nb_segments = 0, nb_parts = 0;
+    unsigned int discontinuity_sequence = 0;
+    uint64_t offset = 0;
+    bool hint = false, endlist = false, first_part = true;
+    double duration = 0.;
+    while (fgets(line, sizeof (line), f) != NULL) {
+        unsigned int value, size, part_offset;
+        double part_duration;
+        char independent[32] = "";
+        assert(!hint && !endlist);
+
+        if (sscanf(line, "#EXT-X-TARGETDURATION:%u", &value) == 1)
+            assert(value == 2);
+        else if (sscanf(line, "#EXT-X-MEDIA-SEQUENCE:%u", &value) == 1)
+            sequence = value;
+        else if (sscanf(line, "#EXT-X-DISCONTINUITY-SEQUENCE:%u",
+                        &value) == 1)
+            discontinuity_sequence = value;
+        else if (!strcmp(line, "#EXT-X-DISCONTINUITY\n"))
+            assert(0);
+        else if (sscanf(line, "#EXT-X-PART:DURATION=%lf,URI=\"" PREFIX
+                        "%u.ts\",BYTERANGE=\"%u@%u\"%31s", &part_duration,
+                        &value, &size, &part_offset, independent) >= 4) {
+            assert(value == sequence);
+            assert(part_offset == offset);
+            assert(part_duration > 0. && part_duration <= 0.5);
+            assert(first_part == !strcmp(independent, ",INDEPENDENT=YES"));
+            first_part = false;
+            offset += size;
+            nb_parts++;
+        }
+        else if (sscanf(line, "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"" PREFIX
+                        "%u.ts\",BYTERANGE-START=%u", &value,
+                        &part_offset) == 2) {
+            assert(value == sequence);
+            assert(part_offset == offset);
+            hint = true;
+        }
+        else if (sscanf(line, "#EXTINF:%lf,", &duration) == 1) {
+            assert(fgets(line, sizeof (line), f) != NULL);
+            assert(sscanf(line, PREFIX "%u.ts", &value) == 1);
+            assert(value == sequence);
+            /* segments are cut on the video access points */
+            assert(duration == (double)GOP * 2 * TICK / UCLOCK_FREQ ||
+                   (ended && value == NB_TICKS / GOP / 2 - 1));
+            check_segment(value, offset);
+            sequence++;
+            nb_segments++;
+            offset = 0;
+            first_part = true;
+        }
+        else if (!strcmp(line, "#EXT-X-ENDLIST\n"))
+            endlist = true;
+    }
+    fclose(f);
+
+    assert(sequence == media_sequence + WINDOW);
+    assert(nb_segments == WINDOW);
+    assert(nb_parts >= 4 * WINDOW);
+    /* the segment following the PCR jump has left the window */
+    assert(discontinuity_sequence == 1);
+    assert(hint == !ended);
+    assert(endlist == ended);
+}
+
+int main(int argc, char *argv[])
+{
+    struct umem_mgr *umem_mgr = umem_alloc_mgr_alloc();
+    assert(umem_mgr != NULL);
+    struct udict_mgr *udict_mgr = udict_inline_mgr_alloc(UDICT_POOL_DEPTH,
+                                                         umem_mgr, -1, -1);
+    assert(udict_mgr != NULL);
+    uref_mgr = uref_std_mgr_alloc(UREF_POOL_DEPTH, udict_mgr, 0);
+    assert(uref_mgr != NULL);
+    ubuf_mgr = ubuf_block_mem_mgr_alloc(UBUF_POOL_DEPTH, UBUF_POOL_DEPTH,
+                                        umem_mgr, 0, 0, -1, 0);
+    assert(ubuf_mgr != NULL);
+
+    struct uprobe uprobe;
+    uprobe_init(&uprobe, catch, NULL);
+    struct uprobe *logger = uprobe_stdio_alloc(&uprobe, stdout,
+                                               UPROBE_LOG_LEVEL);
+    assert(logger != NULL);
+
+    assert(mkdtemp(dir) != NULL);
+    char playlist[MAXPATHLEN];
+    snprintf(playlist, sizeof (playlist), "%s/playlist.m3u8", dir);
+
+    struct upipe_mgr *upipe_fsink_mgr = upipe_fsink_mgr_alloc();
+    assert(upipe_fsink_mgr != NULL);
+    struct upipe_mgr *upipe_hls_sink_mgr = upipe_hls_sink_mgr_alloc();
+    assert(upipe_hls_sink_mgr != NULL);
+    struct upipe *upipe_hls_sink = upipe_void_alloc(upipe_hls_sink_mgr,
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                             "hls sink"));
+    assert(upipe_hls_sink != NULL);
+    ubase_assert(upipe_hls_sink_set_fsink_mgr(upipe_hls_sink,
+                                              upipe_fsink_mgr));
+    upipe_mgr_release(upipe_fsink_mgr);
+
+    struct uref *flow_def = uref_block_flow_alloc_def(uref_mgr, "mpegts.");
+    assert(flow_def != NULL);
+    ubase_assert(upipe_set_flow_def(upipe_hls_sink, flow_def));
+    uref_free(flow_def);
+    ubase_assert(upipe_hls_sink_set_duration(upipe_hls_sink, DURATION,
+                                             PART_DURATION));
+    ubase_assert(upipe_hls_sink_set_window(upipe_hls_sink, WINDOW));
+    ubase_assert(upipe_hls_sink_set_path(upipe_hls_sink, playlist, PREFIX));
+
+    for (unsigned int tick = 0; tick < NB_TICKS; tick++) {
+        if (!(tick % PSI_INTERVAL))
+            send_psi(upipe_hls_sink);
+        send_tick(upipe_hls_sink, tick);
+    }
+
+    /* 10 segments of two GOPs, the last one being written */
+    unsigned int nb_segments = NB_TICKS / GOP / 2;
+    check_playlist(nb_segments - 1 - WINDOW, false);
+    for (unsigned int i = 0; i < nb_segments - 1 - 2 * WINDOW; i++)
+        check_deleted(i);
+
+    upipe_release(upipe_hls_sink);
+    check_playlist(nb_segments - WINDOW, true);
+    for (unsigned int i = 0; i < nb_segments - 2 * WINDOW; i++)
+        check_deleted(i);
+
+    /* clean up the segments left */
+    for (unsigned int i = nb_segments - 2 * WINDOW; i < nb_segments; i++) {
+        char path[MAXPATHLEN];
+        snprintf(path, sizeof (path), "%s/" PREFIX "%u.ts", dir, i);
+        assert(unlink(path) == 0);
+    }
+    assert(unlink(playlist) == 0);
+    assert(rmdir(dir) == 0);
+
+    ubuf_mgr_release(ubuf_mgr);
+    uref_mgr_release(uref_mgr);
+    udict_mgr_release(udict_mgr);
+    umem_mgr_release(umem_mgr);
+    uprobe_release(logger);
+    uprobe_clean(&uprobe);
+    return 0;
+}
@@ -0,0 +1,346 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short unit tests for parallel range requests of the http source
+ *
+ * A local server answers range requests on persistent connections, and
+ * delays some ranges so that they complete out of order.
+ */
+
+#undef NDEBUG
+
+#include "upipe/uprobe.h"
+#include "upipe/uprobe_stdio.h"
+#include "upipe/uprobe_prefix.h"
+#include "upipe/uprobe_uref_mgr.h"
+#include "upipe/uprobe_upump_mgr.h"
+#include "upipe/uprobe_ubuf_mem.h"
+#include "upipe/umem.h"
+#include "upipe/umem_alloc.h"
+#include "upipe/udict.h"
+#include "upipe/udict_inline.h"
+#include "upipe/uref.h"
+#include "upipe/uref_block.h"
+#include "upipe/uref_std.h"
+#include "upipe/upump.h"
+#include "upump-ev/upump_ev.h"
+#include "upipe/upipe.h"
+#include "upipe-modules/upipe_http_source.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <assert.h>
+
+#define UDICT_POOL_DEPTH 10
+#define UREF_POOL_DEPTH 10
+#define UBUF_POOL_DEPTH 10
+#define UPUMP_POOL 1
+#define UPUMP_BLOCKER_POOL 1
+#define UPROBE_LOG_LEVEL UPROBE_LOG_DEBUG
+#define READ_SIZE 4096
+#define TOTAL_SIZE (1024 * 1024 + 333)
+#define PART_SIZE (64 * 1024)
+#define PARALLEL 4
+/** delay of the ranges answered late, in microseconds */
+#define DELAY 20000
+
+/** number of accepted connections */
+static unsigned int nb_connections = 0;
+/** number of answered requests */
+static unsigned int nb_requests = 0;
+/** protects the counters */
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** next expected offset at the output */
+static uint64_t position = 0;
+/** true when the end of the transfer was output */
+static bool ended = false;
+
+/** returns the value of the octet at the given offset of the content */
+static uint8_t pattern(uint64_t offset)
+{
+    return (offset * 13 + offset / 257) & 0xff;
+}
+
+/** writes a whole buffer to a socket */
+static bool send_all(int fd, const uint8_t *buffer, size_t size)
+{
+    while (size) {
+        ssize_t ret = write(fd, buffer, size);
+        if (ret <= 0)
+            return false;
+        buffer += ret;
+        size -= ret;
+    }
+    return true;
+}
+
+/** answers the requests of a connection until it is closed */
+static void *serve(void *arg)
+{
+    int fd = (intptr_t)arg;
+    char request[4096];
+    size_t len = 0;
+
+    for ( ; ; ) {
+        char *end;
+        request[len] = '\0';
+        while ((end = strstr(request, "\r\n\r\n")) == NULL) {
+            assert(len < sizeof (request) - 1);
+            ssize_t ret = read(fd, request + len, sizeof (request) - 1 - len);
+            if (ret <= 0) {
+                close(fd);
+                return NULL;
+            }
+            len += ret;
+            request[len] = '\0';
+        }
+        *end = '\0';
+        assert(!strncmp(request, "GET /content HTTP/1.1\r\n", 23));
+
+        uint64_t first = 0, last = TOTAL_SIZE - 1;
+        const char *range = strstr(request, "\r\nRange: bytes=");
+        assert(range != NULL);
+        int ret = sscanf(range, "\r\nRange: bytes=%"SCNu64"-%"SCNu64,
+                         &first, &last);
+        assert(ret >= 1);
+        if (last >= TOTAL_SIZE)
+            last = TOTAL_SIZE - 1;
+        assert(first <= last);
+
+        /* consume the request */
+        size_t consumed = end + 4 - request;
+        memmove(request, request + consumed, len - consumed);
+        len -= consumed;
+
+        pthread_mutex_lock(&mutex);
+        nb_requests++;
+        pthread_mutex_unlock(&mutex);
+
+        /* the first range of each round completes last */
+        if ((first / PART_SIZE) % PARALLEL == 1)
+            usleep(DELAY);
+
+        char header[256];
+        int header_len = snprintf(header, sizeof (header),
+                "HTTP/1.1 206 Partial Content\r\n"
+                "Content-Range: bytes %"PRIu64"-%"PRIu64"/%u\r\n"
+                "Content-Length: %"PRIu64"\r\n"
+                "\r\n", first, last, TOTAL_SIZE, last - first + 1);
+        uint8_t *body = malloc(last - first + 1);
+        assert(body != NULL);
+        for (uint64_t i = first; i <= last; i++)
+            body[i - first] = pattern(i);
+        bool sent = send_all(fd, (const uint8_t *)header, header_len) &&
+                    send_all(fd, body, last - first + 1);
+        free(body);
+        if (!sent)
+            break;
+    }
+    close(fd);
+    return NULL;
+}
+
+/** accepts connections and serves each one in a thread */
+static void *server(void *arg)
+{
+    int listen_fd = (intptr_t)arg;
+    for ( ; ; ) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0)
+            break;
+        pthread_mutex_lock(&mutex);
+        nb_connections++;
+        pthread_mutex_unlock(&mutex);
+
+        pthread_t thread;
+        assert(!pthread_create(&thread, NULL, serve, (void *)(intptr_t)fd));
+        pthread_detach(thread);
+    }
+    return NULL;
+}
+
+/** definition of our uprobe */
+static int catch(struct uprobe *uprobe, struct upipe *upipe,
+                 int event, va_list args)
+{
+    switch (event) {
+        default:
+            assert(0);
+            break;
+        case UPROBE_READY:
+        case UPROBE_DEAD:
+        case UPROBE_SOURCE_END:
+        case UPROBE_NEW_FLOW_DEF:
+            break;
+        case UPROBE_HTTP_SRC_SCHEME_HOOK:
+            /* use the default plain http hook */
+            return UBASE_ERR_UNHANDLED;
+    }
+    return UBASE_ERR_NONE;
+}
+
+/** helper phony pipe checking the received content */
+static struct upipe *sink_alloc(struct upipe_mgr *mgr, struct uprobe *uprobe,
+                                uint32_t signature, va_list args)
+{
+    struct upipe *upipe = malloc(sizeof(struct upipe));
+    assert(upipe != NULL);
+    upipe_init(upipe, mgr, uprobe);
+    return upipe;
+}
+
+/** helper phony pipe checking the received content */
+static void sink_input(struct upipe *upipe, struct uref *uref,
+                       struct upump **upump_p)
+{
+    assert(!ended);
+    size_t size;
+    ubase_assert(uref_block_size(uref, &size));
+    if (!size) {
+        assert(ubase_check(uref_block_get_end(uref)));
+        ended = true;
+        uref_free(uref);
+        return;
+    }
+
+    uint8_t buffer[size];
+    ubase_assert(uref_block_extract(uref, 0, size, buffer));
+    for (size_t i = 0; i < size; i++)
+        assert(buffer[i] == pattern(position + i));
+    position += size;
+    uref_free(uref);
+}
+
+/** helper phony pipe checking the received content */
+static int sink_control(struct upipe *upipe, int command, va_list args)
+{
+    switch (command) {
+        case UPIPE_REGISTER_REQUEST: {
+            struct urequest *urequest = va_arg(args, struct urequest *);
+            return upipe_throw_provide_request(upipe, urequest);
+        }
+        case UPIPE_UNREGISTER_REQUEST:
+        case UPIPE_SET_FLOW_DEF:
+            return UBASE_ERR_NONE;
+        default:
+            return UBASE_ERR_UNHANDLED;
+    }
+}
+
+/** helper phony pipe checking the received content */
+static void sink_free(struct upipe *upipe)
+{
+    upipe_clean(upipe);
+    free(upipe);
+}
+
+/** helper phony pipe checking the received content */
+static struct upipe_mgr sink_mgr = {
+    .refcount = NULL,
+    .signature = 0,
+    .upipe_alloc = sink_alloc,
+    .upipe_input = sink_input,
+    .upipe_control = sink_control
+};
+
+int main(int argc, char *argv[])
+{
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    assert(listen_fd >= 0);
+    struct sockaddr_in sin;
+    memset(&sin, 0, sizeof (sin));
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sin.sin_port = 0;
+    assert(!bind(listen_fd, (struct sockaddr *)&sin, sizeof (sin)));
+    assert(!listen(listen_fd, PARALLEL));
+    socklen_t sinlen = sizeof (sin);
+    assert(!getsockname(listen_fd, (struct sockaddr *)&sin, &sinlen));
+    pthread_t thread;
+    assert(!pthread_create(&thread, NULL, server,
+                           (void *)(intptr_t)listen_fd));
+
+    struct umem_mgr *umem_mgr = umem_alloc_mgr_alloc();
+    assert(umem_mgr != NULL);
+    struct udict_mgr *udict_mgr = udict_inline_mgr_alloc(UDICT_POOL_DEPTH,
+                                                         umem_mgr, -1, -1);
+    assert(udict_mgr != NULL);
+    struct uref_mgr *uref_mgr = uref_std_mgr_alloc(UREF_POOL_DEPTH, udict_mgr,
+                                                   0);
+    assert(uref_mgr != NULL);
+    struct upump_mgr *upump_mgr = upump_ev_mgr_alloc_default(UPUMP_POOL,
+            UPUMP_BLOCKER_POOL);
+    assert(upump_mgr != NULL);
+    struct uprobe uprobe;
+    uprobe_init(&uprobe, catch, NULL);
+    struct uprobe *logger = uprobe_stdio_alloc(&uprobe, stdout,
+                                               UPROBE_LOG_LEVEL);
+    assert(logger != NULL);
+    logger = uprobe_uref_mgr_alloc(logger, uref_mgr);
+    assert(logger != NULL);
+    logger = uprobe_upump_mgr_alloc(logger, upump_mgr);
+    assert(logger != NULL);
+    logger = uprobe_ubuf_mem_alloc(logger, umem_mgr, UBUF_POOL_DEPTH,
+                                   UBUF_POOL_DEPTH);
+    assert(logger != NULL);
+
+    struct upipe_mgr *upipe_http_src_mgr = upipe_http_src_mgr_alloc();
+    assert(upipe_http_src_mgr != NULL);
+    ubase_assert(upipe_http_src_mgr_set_keepalive(upipe_http_src_mgr,
+                                                  PARALLEL));
+
+    struct upipe *sink = upipe_void_alloc(&sink_mgr, uprobe_use(logger));
+    assert(sink != NULL);
+
+    struct upipe *upipe_http_src = upipe_void_alloc(upipe_http_src_mgr,
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL, "http"));
+    assert(upipe_http_src != NULL);
+    ubase_assert(upipe_set_output_size(upipe_http_src, READ_SIZE));
+    ubase_assert(upipe_http_src_set_parallel(upipe_http_src, PARALLEL,
+                                             PART_SIZE));
+    char uri[64];
+    snprintf(uri, sizeof (uri), "http://127.0.0.1:%u/content",
+             ntohs(sin.sin_port));
+    ubase_assert(upipe_set_uri(upipe_http_src, uri));
+    ubase_assert(upipe_set_output(upipe_http_src, sink));
+
+    upump_mgr_run(upump_mgr, NULL);
+
+    /* the whole content is output in order */
+    assert(ended);
+    assert(position == TOTAL_SIZE);
+    /* one request per part, over no more connections than in parallel */
+    pthread_mutex_lock(&mutex);
+    assert(nb_requests == (TOTAL_SIZE + PART_SIZE - 1) / PART_SIZE);
+    assert(nb_connections == PARALLEL);
+    pthread_mutex_unlock(&mutex);
+
+    upipe_release(upipe_http_src);
+    sink_free(sink);
+    upipe_mgr_release(upipe_http_src_mgr);
+
+    upump_mgr_release(upump_mgr);
+    uref_mgr_release(uref_mgr);
+    udict_mgr_release(udict_mgr);
+    umem_mgr_release(umem_mgr);
+    uprobe_release(logger);
+    uprobe_clean(&uprobe);
+
+    shutdown(listen_fd, SHUT_RDWR);
+    close(listen_fd);
+    pthread_join(thread, NULL);
+    return 0;
+}
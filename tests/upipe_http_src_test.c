@@ -77,6 +77,9 @@ enum opt {
     OPT_VERBOSE     = 'v',
     OPT_QUIET       = 'q',
     OPT_PARALLEL    = 'p',
+    OPT_KEEPALIVE   = 'k',
+    OPT_RANGES      = 'r',
+    OPT_PART_SIZE   = 's',
     OPT_USE_BEARSSL = 0x100,
     OPT_USE_OPENSSL,
 };
@@ -86,6 +89,9 @@ static struct option options[] = {
     { "verbose", no_argument, NULL, OPT_VERBOSE },
     { "quiet", no_argument, NULL, OPT_QUIET },
     { "parallel", required_argument, NULL, OPT_PARALLEL },
+    { "keepalive", required_argument, NULL, OPT_KEEPALIVE },
+    { "ranges", required_argument, NULL, OPT_RANGES },
+    { "part-size", required_argument, NULL, OPT_PART_SIZE },
     { "use-bearssl", no_argument, NULL, OPT_USE_BEARSSL },
     { "use-openssl", no_argument, NULL, OPT_USE_OPENSSL },
     { 0, 0, 0, 0 },
@@ -109,6 +115,9 @@ int main(int argc, char *argv[])
     int opt;
     int index;
     int parallel = 1;
+    unsigned int keepalive = 0;
+    unsigned int ranges = 0;
+    uint64_t part_size = 1024 * 1024;
 #ifdef HAVE_BEARSSL
     bool use_bearssl = true;
 #endif
@@ -119,7 +128,7 @@ int main(int argc, char *argv[])
     /*
      * parse options
      */
-    while ((opt = getopt_long(argc, argv, "hvqp:", options, &index)) != -1) {
+    while ((opt = getopt_long(argc, argv, "hvqp:k:r:s:", options, &index)) != -1) {
         switch (opt) {
         case OPT_HELP:
             usage(argv[0]);
@@ -140,6 +149,18 @@ int main(int argc, char *argv[])
             parallel = atoi(optarg);
             break;
 
+        case OPT_KEEPALIVE:
+            keepalive = strtoul(optarg, NULL, 0);
+            break;
+
+        case OPT_RANGES:
+            ranges = strtoul(optarg, NULL, 0);
+            break;
+
+        case OPT_PART_SIZE:
+            part_size = strtoull(optarg, NULL, 0);
+            break;
+
 #ifdef HAVE_BEARSSL
         case OPT_USE_BEARSSL:
             use_bearssl = true;
@@ -215,6 +236,11 @@ int main(int argc, char *argv[])
     }
 #endif
 
+    struct upipe_mgr *upipe_http_src_mgr = upipe_http_src_mgr_alloc();
+    assert(upipe_http_src_mgr != NULL);
+    ubase_assert(upipe_http_src_mgr_set_keepalive(upipe_http_src_mgr,
+                                                  keepalive));
+
     struct upipe *sources[parallel];
     for (int i = 0; i < parallel; i++) {
         for (int j = optind; j < argc; j++) {
@@ -226,13 +252,14 @@ int main(int argc, char *argv[])
             ubase_assert(upipe_fsink_set_path(
                 upipe_fsink, "/dev/stdout", UPIPE_FSINK_OVERWRITE));
 
-            struct upipe_mgr *upipe_http_src_mgr = upipe_http_src_mgr_alloc();
             sources[i] = upipe_void_alloc(
                 upipe_http_src_mgr,
                 uprobe_pfx_alloc(uprobe_use(logger), log_level, "http"));
-            upipe_mgr_release(upipe_http_src_mgr); // nop
             assert(sources[i] != NULL);
             ubase_assert(upipe_set_output_size(sources[i], READ_SIZE));
+            if (ranges)
+                ubase_assert(upipe_http_src_set_parallel(sources[i], ranges,
+                                                         part_size));
             ubase_assert(upipe_set_uri(sources[i], argv[j]));
             ubase_assert(upipe_set_output(sources[i], upipe_fsink));
             upipe_release(upipe_fsink);
@@ -243,6 +270,7 @@ int main(int argc, char *argv[])
 
     for (int i = 0; i < parallel; i++)
         upipe_release(sources[i]);
+    upipe_mgr_release(upipe_http_src_mgr);
 
     upump_mgr_release(upump_mgr);
     uref_mgr_release(uref_mgr);
@@ -33,6 +33,7 @@
 #include "upipe-modules/upipe_null.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #define UDICT_POOL_DEPTH 0
@@ -98,6 +99,10 @@ static int catch_uref(struct uprobe *uprobe,
         if (ubase_check(uref_m3u_playlist_flow_get_endlist(uref)))
             printf("playlist end\n");
 
+        uint64_t kept;
+        if (ubase_check(uref_m3u_playlist_flow_get_kept(uref, &kept)))
+            printf("playlist kept: %"PRIu64"\n", kept);
+
         return UBASE_ERR_NONE;
     }
 
@@ -199,6 +204,12 @@ static int catch_uref(struct uprobe *uprobe,
 
 int main(int argc, char *argv[])
 {
+    bool incremental = false;
+    if (argc >= 2 && !strcmp(argv[1], "-i")) {
+        incremental = true;
+        argc--;
+        argv++;
+    }
     assert(argc >= 2);
     nb_files = argc - 1;
     files = argv + 1;
@@ -247,6 +258,8 @@ int main(int argc, char *argv[])
                          UPROBE_LOG_VERBOSE, "m3u reader"));
     upipe_mgr_release(upipe_m3u_reader_mgr);
     assert(upipe_m3u_reader != NULL);
+    ubase_assert(upipe_m3u_reader_set_incremental(upipe_m3u_reader,
+                                                  incremental));
 
     struct uprobe uprobe_uref;
     uprobe_init(&uprobe_uref, catch_uref, uprobe_use(logger));
@@ -28,6 +28,7 @@
 #include "upipe/uref.h"
 #include "upipe/uref_std.h"
 #include "upipe/uref_clock.h"
+#include "upipe/uref_flow.h"
 #include "upipe/uref_block_flow.h"
 #include "upipe/uref_dump.h"
 #include "upipe/upump.h"
@@ -38,6 +39,7 @@
 #include "upipe-modules/upipe_multicat_source.h"
 #include "upipe-modules/upipe_genaux.h"
 
+#include <stdbool.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -57,6 +59,10 @@
 #define UPROBE_LOG_LEVEL UPROBE_LOG_DEBUG
 #define UREF_PER_SLICE 10
 #define SLICES_NUM 10
+#define RAP_PERIOD 7
+#define RAP_PHASE 3
+#define TS_SIZE 188
+#define DATE_SIZE sizeof(uint64_t)
 
 static struct uref_mgr *uref_mgr;
 static struct ubuf_mgr *ubuf_mgr;
@@ -65,6 +71,11 @@ static struct upump *idler;
 static uint64_t rotate = 0;
 static uint64_t rotate_offset = 0;
 static uint64_t gen_systime = 0;
+static uint64_t budget = 0;
+static bool ts = false;
+static size_t packet_size = DATE_SIZE;
+static uint64_t msrc_systime = 0;
+static unsigned int msrc_count = 0;
 
 static void sig_handler(int sig)
 {
@@ -73,7 +84,7 @@ static void sig_handler(int sig)
 }
 
 static void usage(const char *argv0) {
-    fprintf(stdout, "Usage: %s [-r <rotate> [-O <rotate offset>]] <dest dir> <suffix>\n", argv0);
+    fprintf(stdout, "Usage: %s [-r <rotate> [-O <rotate offset>]] [-b <batch>] [-i <index interval> [-t]] [-w <budget>] <dest dir> <suffix>\n", argv0);
     exit(EXIT_FAILURE);
 }
 
@@ -86,6 +97,10 @@ static int catch(struct uprobe *uprobe, struct upipe *upipe,
             assert(0);
             break;
         case UPROBE_READY:
+            /* the writer thread of the file sink is kept across rotations */
+            if (budget && upipe->mgr->signature == UPIPE_FSINK_SIGNATURE)
+                ubase_assert(upipe_fsink_set_async(upipe, budget));
+            break;
         case UPROBE_DEAD:
         case UPROBE_SOURCE_END:
         case UPROBE_NEW_FLOW_DEF:
@@ -95,6 +110,13 @@ static int catch(struct uprobe *uprobe, struct upipe *upipe,
     return UBASE_ERR_NONE;
 }
 
+/** returns true if the packet of the given date is a random access point */
+static bool is_rap(uint64_t systime)
+{
+    return (systime - rotate_offset) / (rotate / UREF_PER_SLICE) %
+           RAP_PERIOD == RAP_PHASE;
+}
+
 /** packet generator */
 static void genpacket_idler(struct upump *upump)
 {
@@ -105,11 +127,22 @@ static void genpacket_idler(struct upump *upump)
     int size = -1;
     uint8_t *buf;
 
-    struct uref *uref = uref_block_alloc(uref_mgr, ubuf_mgr, sizeof(uint64_t));
+    struct uref *uref = uref_block_alloc(uref_mgr, ubuf_mgr, packet_size);
     ubase_assert(uref_block_write(uref, 0, &size, &buf));
-    assert(size == sizeof(uint64_t));
-
-    upipe_genaux_hton64(buf, gen_systime);
+    assert(size == packet_size);
+
+    if (ts) {
+        /* adaptation field filling the packet up to the date */
+        memset(buf, 0xff, packet_size);
+        buf[0] = 0x47;
+        buf[1] = 0x01;
+        buf[2] = 0x00;
+        buf[3] = 0x30;
+        buf[4] = TS_SIZE - 5 - DATE_SIZE;
+        buf[5] = is_rap(gen_systime) ? 0x40 : 0;
+    } else if (is_rap(gen_systime))
+        uref_flow_set_random(uref);
+    upipe_genaux_hton64(buf + packet_size - DATE_SIZE, gen_systime);
     uref_clock_set_cr_sys(uref, gen_systime);
 
     uref_block_unmap(uref, 0);
@@ -135,20 +168,20 @@ static void test_input(struct upipe *upipe, struct uref *uref,
     upipe_dbg(upipe, "===> received input uref");
     uref_dump(uref, upipe->uprobe);
 
-    static uint64_t systime = 0;
     uint64_t cr_sys;
     ubase_assert(uref_clock_get_cr_sys(uref, &cr_sys));
-    assert(cr_sys == systime);
+    assert(cr_sys == msrc_systime);
 
     int size = -1;
     const uint8_t *buf;
     ubase_assert(uref_block_read(uref, 0, &size, &buf));
     assert(size == sizeof(uint64_t));
     cr_sys = upipe_genaux_ntoh64(buf);
-    assert(cr_sys == systime);
+    assert(cr_sys == msrc_systime);
     ubase_assert(uref_block_unmap(uref, 0));
     uref_free(uref);
-    systime += rotate/UREF_PER_SLICE;
+    msrc_systime += rotate/UREF_PER_SLICE;
+    msrc_count++;
 }
 
 /** helper phony pipe */
@@ -186,16 +219,70 @@ static struct upipe_mgr test_mgr = {
     .upipe_control = test_control
 };
 
+/** returns the date of the first packet output by msrc when seeking to
+ * the given position, according to the index */
+static uint64_t seek_start(uint64_t pos, uint64_t index_interval)
+{
+    uint64_t date = pos - (pos - rotate_offset) % rotate;
+    uint64_t last = UINT64_MAX, last_rap = UINT64_MAX;
+    for ( ; date <= pos; date += rotate / UREF_PER_SLICE) {
+        if (is_rap(date))
+            last = last_rap = date;
+        else if (last == UINT64_MAX || date >= last + index_interval)
+            last = date;
+    }
+    return last_rap != UINT64_MAX ? last_rap : last;
+}
+
+/** reads the files with msrc from the given position */
+static void read_msrc(struct upump_mgr *upump_mgr, struct uprobe *logger,
+                      const char *dirpath, const char *suffix, bool index,
+                      unsigned int batch, uint64_t position)
+{
+    struct upipe_mgr *upipe_msrc_mgr = upipe_msrc_mgr_alloc();
+    struct upipe *msrc = upipe_void_alloc(upipe_msrc_mgr,
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                             "multicat source"));
+    assert(msrc != NULL);
+    upipe_mgr_release(upipe_msrc_mgr);
+    struct uref *flow = uref_alloc_control(uref_mgr);
+    assert(flow != NULL);
+    ubase_assert(uref_msrc_flow_set_path(flow, dirpath));
+    ubase_assert(uref_msrc_flow_set_data(flow, suffix));
+    ubase_assert(uref_msrc_flow_set_aux(flow, suffix));
+    ubase_assert(uref_msrc_flow_set_rotate(flow, rotate));
+    ubase_assert(uref_msrc_flow_set_offset(flow, rotate_offset));
+    if (index)
+        ubase_assert(uref_msrc_flow_set_index(flow, ".idx"));
+    ubase_assert(upipe_set_flow_def(msrc, flow));
+    uref_free(flow);
+    ubase_assert(upipe_set_output_size(msrc, sizeof(uint64_t)));
+    ubase_assert(upipe_msrc_set_batch(msrc, batch));
+
+    struct upipe *test = upipe_void_alloc(&test_mgr, uprobe_use(logger));
+    assert(test != NULL);
+    ubase_assert(upipe_set_output(msrc, test));
+
+    // fire !
+    ubase_assert(upipe_src_set_position(msrc, position));
+    upump_mgr_run(upump_mgr, NULL);
+
+    upipe_release(msrc);
+    test_free(test);
+}
+
 int main(int argc, char *argv[])
 {
     const char *dirpath, *suffix;
     struct uref *flow;
     char filepath[MAXPATHLEN];
     int i, j, fd, ret, opt;
+    unsigned int batch = 1;
+    uint64_t index_interval = 0;
 
     signal (SIGINT, sig_handler);
 
-    while ((opt = getopt(argc, argv, "r:O:")) != -1) {
+    while ((opt = getopt(argc, argv, "r:O:b:i:tw:")) != -1) {
         switch (opt) {
             case 'r':
                 rotate = strtoull(optarg, NULL, 0);
@@ -203,6 +290,19 @@ int main(int argc, char *argv[])
             case 'O':
                 gen_systime = rotate_offset = strtoull(optarg, NULL, 0);
                 break;
+            case 'b':
+                batch = strtoul(optarg, NULL, 0);
+                break;
+            case 'i':
+                index_interval = strtoull(optarg, NULL, 0);
+                break;
+            case 't':
+                ts = true;
+                packet_size = TS_SIZE;
+                break;
+            case 'w':
+                budget = strtoull(optarg, NULL, 0);
+                break;
             default:
                 usage(argv[0]);
         }
@@ -269,6 +369,16 @@ int main(int argc, char *argv[])
     }
     ubase_assert(upipe_multicat_sink_set_mode(multicat_sink, UPIPE_FSINK_OVERWRITE));
     ubase_assert(upipe_multicat_sink_set_path(multicat_sink, dirpath, suffix));
+    if (index_interval)
+        ubase_assert(upipe_multicat_sink_set_index(multicat_sink, ".idx",
+                                                   index_interval));
+    if (ts) {
+        enum upipe_multicat_sink_rap rap;
+        ubase_assert(upipe_multicat_sink_set_rap(multicat_sink,
+                                                 UPIPE_MULTICAT_SINK_RAP_TS));
+        ubase_assert(upipe_multicat_sink_get_rap(multicat_sink, &rap));
+        assert(rap == UPIPE_MULTICAT_SINK_RAP_TS);
+    }
 
     // idler - packet generator
     idler = upump_alloc_idler(upump_mgr, genpacket_idler, NULL, NULL);
@@ -290,10 +400,10 @@ int main(int argc, char *argv[])
         fd = open(filepath, O_RDONLY);
         assert(fd != -1);
         for (j = 0; j < UREF_PER_SLICE; j++) {
-            uint8_t buf[8];
-            ret = read(fd, buf, sizeof(uint64_t));
-            assert(ret == sizeof(uint64_t));
-            val = upipe_genaux_ntoh64(buf);
+            uint8_t buf[packet_size];
+            ret = read(fd, buf, packet_size);
+            assert(ret == packet_size);
+            val = upipe_genaux_ntoh64(buf + packet_size - DATE_SIZE);
             if (val != systime) {
                 printf("%d %d - %"PRIu64" != %"PRIu64"\n", i, j, val, systime);
             }
@@ -302,37 +412,65 @@ int main(int argc, char *argv[])
         }
         printf("Ok.\n");
         close(fd);
-    }
 
-    // check resulting files with msrc
-    struct upipe_mgr *upipe_msrc_mgr = upipe_msrc_mgr_alloc();
-    struct upipe *msrc = upipe_void_alloc(upipe_msrc_mgr,
-            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
-                             "multicat source"));
-    assert(msrc != NULL);
-    upipe_mgr_release(upipe_msrc_mgr);
-    flow = uref_alloc_control(uref_mgr);
-    assert(flow != NULL);
-    ubase_assert(uref_msrc_flow_set_path(flow, dirpath));
-    ubase_assert(uref_msrc_flow_set_data(flow, suffix));
-    ubase_assert(uref_msrc_flow_set_aux(flow, suffix));
-    ubase_assert(uref_msrc_flow_set_rotate(flow, rotate));
-    ubase_assert(uref_msrc_flow_set_offset(flow, rotate_offset));
-    ubase_assert(upipe_set_flow_def(msrc, flow));
-    uref_free(flow);
-    ubase_assert(upipe_set_output_size(msrc, sizeof(uint64_t)));
+        if (!index_interval)
+            continue;
+        // entries: first packet, random access points, and interval
+        snprintf(filepath, MAXPATHLEN, "%s%"PRId64"%s", dirpath,
+                 (systime - rotate) / rotate, ".idx");
+        fd = open(filepath, O_RDONLY);
+        assert(fd != -1);
+        uint64_t last = UINT64_MAX, last_rap = UINT64_MAX;
+        uint64_t date = systime - rotate;
+        for (j = 0; j < UREF_PER_SLICE; j++, date += rotate/UREF_PER_SLICE) {
+            uint64_t offset = j * packet_size;
+            bool rap = is_rap(date);
+            if (rap)
+                last_rap = offset;
+            else if (last != UINT64_MAX && date < last + index_interval)
+                continue;
+            last = date;
+
+            uint8_t entry[UPIPE_MULTICAT_INDEX_ENTRY_SIZE];
+            ret = read(fd, entry, sizeof(entry));
+            assert(ret == sizeof(entry));
+            assert(upipe_genaux_ntoh64(entry) == date);
+            assert(upipe_genaux_ntoh64(entry + 8) ==
+                   (offset | (rap ? UPIPE_MULTICAT_INDEX_RAP : 0)));
+            assert(upipe_genaux_ntoh64(entry + 16) == last_rap);
+        }
+        uint8_t entry[UPIPE_MULTICAT_INDEX_ENTRY_SIZE];
+        assert(read(fd, entry, sizeof(entry)) == 0);
+        close(fd);
+    }
 
-    struct upipe *test = upipe_void_alloc(&test_mgr, uprobe_use(logger));
-    assert(test != NULL);
-    ubase_assert(upipe_set_output(msrc, test));
+    if (!ts) {
+        // check resulting files with msrc, the aux files being the data
+        // files
+        msrc_systime = rotate_offset;
+        msrc_count = 0;
+        read_msrc(upump_mgr, logger, dirpath, suffix, index_interval != 0,
+                  batch, rotate_offset);
+        assert(msrc_count == SLICES_NUM * UREF_PER_SLICE);
+    }
 
-    // fire !
-    ubase_assert(upipe_src_set_position(msrc, 0));
-    upump_mgr_run(upump_mgr, NULL);
+    if (!ts && index_interval) {
+        // seek in the middle of slices, with and without a previous random
+        // access point in the slice
+        for (i = 0; i < SLICES_NUM; i += 3) {
+            uint64_t pos = rotate_offset + i * rotate +
+                           (UREF_PER_SLICE / 2 - i % 5) *
+                           (rotate / UREF_PER_SLICE);
+            msrc_systime = seek_start(pos, index_interval);
+            msrc_count = 0;
+            read_msrc(upump_mgr, logger, dirpath, suffix, true, batch, pos);
+            assert(msrc_count == (SLICES_NUM * rotate + rotate_offset -
+                                  seek_start(pos, index_interval)) /
+                                 (rotate / UREF_PER_SLICE));
+        }
+    }
 
     // release everything
-    upipe_release(msrc);
-    test_free(test);
     upump_mgr_release(upump_mgr);
     uref_mgr_release(uref_mgr);
     ubuf_mgr_release(ubuf_mgr);
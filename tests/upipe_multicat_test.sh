@@ -9,3 +9,18 @@ cleanup() { rm -rf "$TMP"; }
 trap cleanup EXIT
 
 "$srcdir"/valgrind_wrapper.sh "$srcdir" ./upipe_multicat_test -r 270000000 -O 135000000 "$TMP"/ .bar
+
+mkdir "$TMP"/batch
+"$srcdir"/valgrind_wrapper.sh "$srcdir" ./upipe_multicat_test -r 270000000 -O 135000000 -b 16 "$TMP"/batch/ .bar
+
+mkdir "$TMP"/index
+"$srcdir"/valgrind_wrapper.sh "$srcdir" ./upipe_multicat_test -r 270000000 -O 135000000 -i 27000000 "$TMP"/index/ .bar
+
+mkdir "$TMP"/async
+"$srcdir"/valgrind_wrapper.sh "$srcdir" ./upipe_multicat_test -r 270000000 -O 135000000 -w 65536 "$TMP"/async/ .bar
+
+mkdir "$TMP"/rap
+"$srcdir"/valgrind_wrapper.sh "$srcdir" ./upipe_multicat_test -r 270000000 -O 135000000 -i 81000000 "$TMP"/rap/ .bar
+
+mkdir "$TMP"/ts
+"$srcdir"/valgrind_wrapper.sh "$srcdir" ./upipe_multicat_test -r 270000000 -O 135000000 -i 81000000 -t "$TMP"/ts/ .ts
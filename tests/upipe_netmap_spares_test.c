@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short unit tests for the spare buffers of the netmap source
+ */
+
+#undef NDEBUG
+
+#include "upipe/umem.h"
+#include "upipe/ubuf.h"
+#include "upipe/ubuf_block.h"
+#include "upipe/ubuf_block_mem.h"
+#include "lib/upipe-netmap/upipe_netmap_spares.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#define UBUF_POOL_DEPTH     2
+#define NB_BUFS             4
+#define BUF_SIZE            2048
+#define PAYLOAD_OFFSET      42
+#define PAYLOAD_SIZE        1316
+
+/** buffers given back to netmap on release */
+static unsigned int released = 0;
+
+/** phony netmap release callback */
+static void release(struct upipe_netmap_spares *spares)
+{
+    assert(spares->opaque == &released);
+    uint8_t *buf;
+    while ((buf = upipe_netmap_spares_get(spares)) != NULL) {
+        uint32_t idx = upipe_netmap_spares_idx(spares, buf);
+        assert(idx >= 1 && idx <= NB_BUFS);
+        released++;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    /* buffer 0 is reserved by netmap, like in a real ring */
+    uint8_t *base = malloc((NB_BUFS + 1) * BUF_SIZE);
+    assert(base != NULL);
+
+    struct upipe_netmap_spares *spares =
+        upipe_netmap_spares_alloc(NB_BUFS, base, BUF_SIZE, release,
+                                  &released);
+    assert(spares != NULL);
+    for (unsigned int i = 1; i <= NB_BUFS; i++)
+        assert(upipe_netmap_spares_put(spares, base + i * BUF_SIZE));
+    assert(!upipe_netmap_spares_put(spares, base));
+
+    struct ubuf_mgr *ubuf_mgr =
+        ubuf_block_mem_mgr_alloc(UBUF_POOL_DEPTH, UBUF_POOL_DEPTH,
+                                 &spares->mgr, 0, 0, -1, 0);
+    assert(ubuf_mgr != NULL);
+
+    /* spare buffers can't be allocated, only swapped */
+    assert(ubuf_block_alloc(ubuf_mgr, PAYLOAD_SIZE) == NULL);
+
+    /* hold all spare buffers downstream */
+    struct ubuf *ubufs[NB_BUFS];
+    for (unsigned int i = 0; i < NB_BUFS; i++) {
+        uint8_t *buf = upipe_netmap_spares_get(spares);
+        assert(buf != NULL);
+        memset(buf + PAYLOAD_OFFSET, i, PAYLOAD_SIZE);
+
+        struct umem umem;
+        upipe_netmap_spares_umem(spares, buf, &umem);
+        ubufs[i] = ubuf_block_mem_alloc_from_umem(ubuf_mgr, &umem,
+                                                  PAYLOAD_OFFSET,
+                                                  PAYLOAD_SIZE);
+        assert(ubufs[i] != NULL);
+
+        size_t size;
+        ubase_assert(ubuf_block_size(ubufs[i], &size));
+        assert(size == PAYLOAD_SIZE);
+        const uint8_t *r;
+        int wanted = -1;
+        ubase_assert(ubuf_block_read(ubufs[i], 0, &wanted, &r));
+        assert(r == buf + PAYLOAD_OFFSET);
+        assert(r[0] == i && r[PAYLOAD_SIZE - 1] == i);
+        ubase_assert(ubuf_block_unmap(ubufs[i], 0));
+    }
+
+    /* exhausted: the source falls back to copying */
+    assert(upipe_netmap_spares_get(spares) == NULL);
+
+    /* a released buffer comes back to the set */
+    const uint8_t *r;
+    int wanted = -1;
+    ubase_assert(ubuf_block_read(ubufs[1], 0, &wanted, &r));
+    uint8_t *buf1 = (uint8_t *)r - PAYLOAD_OFFSET;
+    ubase_assert(ubuf_block_unmap(ubufs[1], 0));
+    ubuf_free(ubufs[1]);
+    uint8_t *buf = upipe_netmap_spares_get(spares);
+    assert(buf == buf1);
+    assert(upipe_netmap_spares_get(spares) == NULL);
+    assert(upipe_netmap_spares_put(spares, buf));
+
+    /* a duplicated ubuf keeps the buffer until both are released */
+    struct ubuf *dup = ubuf_dup(ubufs[2]);
+    assert(dup != NULL);
+    ubuf_free(ubufs[2]);
+    assert(upipe_netmap_spares_get(spares) == buf1);
+    assert(upipe_netmap_spares_get(spares) == NULL);
+    assert(upipe_netmap_spares_put(spares, buf1));
+    ubuf_free(dup);
+
+    /* the set survives the pipe as long as buffers are held downstream */
+    ubuf_mgr_release(ubuf_mgr);
+    upipe_netmap_spares_release(spares);
+    assert(released == 0);
+    ubuf_free(ubufs[0]);
+    assert(released == 0);
+    ubuf_free(ubufs[3]);
+    assert(released == NB_BUFS);
+
+    free(base);
+    return 0;
+}
@@ -0,0 +1,390 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short unit tests for the batch, speed and filter controls of the pcap
+ * source pipe
+ */
+
+#undef NDEBUG
+
+#include "upipe/uprobe.h"
+#include "upipe/uprobe_stdio.h"
+#include "upipe/uprobe_prefix.h"
+#include "upipe/uprobe_uref_mgr.h"
+#include "upipe/uprobe_upump_mgr.h"
+#include "upipe/uprobe_uclock.h"
+#include "upipe/uprobe_ubuf_mem.h"
+#include "upipe/uclock.h"
+#include "upipe/uclock_std.h"
+#include "upipe/umem.h"
+#include "upipe/umem_alloc.h"
+#include "upipe/udict.h"
+#include "upipe/udict_inline.h"
+#include "upipe/uref.h"
+#include "upipe/uref_block.h"
+#include "upipe/uref_clock.h"
+#include "upipe/uref_std.h"
+#include "upipe/upump.h"
+#include "upump-ev/upump_ev.h"
+#include "upipe/upipe.h"
+#include "upipe-pcap/upipe_pcap_src.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+
+#define UDICT_POOL_DEPTH 0
+#define UREF_POOL_DEPTH 0
+#define UBUF_POOL_DEPTH 0
+#define UPUMP_POOL 0
+#define UPUMP_BLOCKER_POOL 0
+#define UPROBE_LOG_LEVEL UPROBE_LOG_DEBUG
+#define NB_PACKETS 12
+#define PAYLOAD_SIZE 20
+#define TS_ORIGIN 1000
+#define PACKET_INTERVAL (UCLOCK_FREQ / 100)
+#define PACING_TOLERANCE (UCLOCK_FREQ / 1000)
+
+static struct upump_mgr *upump_mgr;
+static struct uclock *uclock;
+/** idler marking the end of each callback of the source */
+static struct upump *boundary;
+/** true if the source was paced by a uclock */
+static bool live;
+/** indices and dates of the received packets */
+static unsigned int nb_packets;
+static unsigned int indices[NB_PACKETS];
+static uint64_t dates[NB_PACKETS];
+/** packets received since the last boundary, and sizes of the groups */
+static unsigned int group;
+static unsigned int nb_groups;
+static unsigned int groups[NB_PACKETS];
+
+/** returns the last octet of the destination address of a packet */
+static uint8_t packet_addr(unsigned int i)
+{
+    return i % 3 ? 1 : 2;
+}
+
+/** returns the destination port of a packet */
+static uint16_t packet_port(unsigned int i)
+{
+    return i % 2 ? 5678 : 1234;
+}
+
+/** definition of our uprobe */
+static int catch(struct uprobe *uprobe, struct upipe *upipe,
+                 int event, va_list args)
+{
+    switch (event) {
+        case UPROBE_SOURCE_END:
+            upump_stop(boundary);
+            break;
+        default:
+            break;
+    }
+    return UBASE_ERR_NONE;
+}
+
+/** helper idler closing the group of packets of the last callback */
+static void boundary_cb(struct upump *upump)
+{
+    if (group) {
+        groups[nb_groups++] = group;
+        group = 0;
+    }
+}
+
+/** helper phony pipe */
+static void test_input(struct upipe *upipe, struct uref *uref,
+                       struct upump **upump_p)
+{
+    assert(nb_packets < NB_PACKETS);
+    size_t size;
+    ubase_assert(uref_block_size(uref, &size));
+    assert(size == PAYLOAD_SIZE);
+    uint8_t index;
+    ubase_assert(uref_block_extract(uref, 0, 1, &index));
+    uint64_t cr_sys;
+    ubase_assert(uref_clock_get_cr_sys(uref, &cr_sys));
+    if (live)
+        /* packets are not output before their date, give or take the
+         * resolution of the timers of the event loop */
+        assert(uclock_now(uclock) + PACING_TOLERANCE >= cr_sys);
+    indices[nb_packets] = index;
+    dates[nb_packets] = cr_sys;
+    nb_packets++;
+    group++;
+    uref_free(uref);
+}
+
+/** helper phony pipe */
+static int test_control(struct upipe *upipe, int command, va_list args)
+{
+    switch (command) {
+        case UPIPE_SET_FLOW_DEF:
+            return UBASE_ERR_NONE;
+        case UPIPE_REGISTER_REQUEST: {
+            struct urequest *request = va_arg(args, struct urequest *);
+            return upipe_throw_provide_request(upipe, request);
+        }
+        case UPIPE_UNREGISTER_REQUEST:
+            return UBASE_ERR_NONE;
+        default:
+            return UBASE_ERR_UNHANDLED;
+    }
+}
+
+/** helper phony pipe */
+static struct upipe_mgr test_mgr = {
+    .refcount = NULL,
+    .upipe_input = test_input,
+    .upipe_control = test_control
+};
+
+/** writes a little-endian 32-bit value */
+static void write_le32(FILE *file, uint32_t value)
+{
+    uint8_t buffer[4] = { value, value >> 8, value >> 16, value >> 24 };
+    assert(fwrite(buffer, sizeof(buffer), 1, file) == 1);
+}
+
+/** writes a capture of NB_PACKETS UDP datagrams to alternating
+ * destinations, one every PACKET_INTERVAL */
+static void write_capture(const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    assert(file != NULL);
+    write_le32(file, 0xa1b2c3d4);
+    write_le32(file, 2 | (4 << 16));
+    write_le32(file, 0);
+    write_le32(file, 0);
+    write_le32(file, 65535);
+    write_le32(file, 1);
+
+    for (unsigned int i = 0; i < NB_PACKETS; i++) {
+        uint8_t frame[14 + 20 + 8 + PAYLOAD_SIZE];
+        memset(frame, 0, sizeof(frame));
+        /* ethernet */
+        frame[12] = 0x08;
+        /* IPv4 */
+        uint8_t *ip = frame + 14;
+        ip[0] = 0x45;
+        ip[3] = sizeof(frame) - 14;
+        ip[8] = 64;
+        ip[9] = 17;
+        ip[12] = 10; ip[15] = 1;
+        ip[16] = 239; ip[19] = packet_addr(i);
+        /* UDP */
+        uint8_t *udp = ip + 20;
+        udp[0] = 0x04; udp[1] = 0x00;
+        udp[2] = packet_port(i) >> 8;
+        udp[3] = packet_port(i) & 0xff;
+        udp[5] = 8 + PAYLOAD_SIZE;
+        udp[8] = i;
+
+        uint64_t usec = (uint64_t)i * PACKET_INTERVAL * 1000000 / UCLOCK_FREQ;
+        write_le32(file, TS_ORIGIN + usec / 1000000);
+        write_le32(file, usec % 1000000);
+        write_le32(file, sizeof(frame));
+        write_le32(file, sizeof(frame));
+        assert(fwrite(frame, sizeof(frame), 1, file) == 1);
+    }
+    fclose(file);
+}
+
+/** replays the capture with the given controls */
+static void run(struct uprobe *logger, const char *path, unsigned int batch,
+                struct urational speed, const char *filter, bool paced)
+{
+    nb_packets = 0;
+    group = 0;
+    nb_groups = 0;
+    live = paced;
+
+    struct upipe_mgr *upipe_pcap_src_mgr = upipe_pcap_src_mgr_alloc();
+    assert(upipe_pcap_src_mgr != NULL);
+    struct upipe *upipe_pcap_src = upipe_void_alloc(upipe_pcap_src_mgr,
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL, "pcap"));
+    assert(upipe_pcap_src != NULL);
+    upipe_mgr_release(upipe_pcap_src_mgr);
+
+    struct upipe sink;
+    upipe_init(&sink, &test_mgr, uprobe_use(logger));
+    ubase_assert(upipe_set_output(upipe_pcap_src, &sink));
+    if (paced)
+        ubase_assert(upipe_attach_uclock(upipe_pcap_src));
+    ubase_assert(upipe_pcap_src_set_batch(upipe_pcap_src, batch));
+    ubase_assert(upipe_pcap_src_set_speed(upipe_pcap_src, speed));
+    ubase_assert(upipe_pcap_src_set_filter(upipe_pcap_src, filter));
+
+    boundary = upump_alloc_idler(upump_mgr, boundary_cb, NULL, NULL);
+    assert(boundary != NULL);
+    upump_start(boundary);
+    uint64_t start = uclock_now(uclock);
+    ubase_assert(upipe_set_uri(upipe_pcap_src, path));
+    upump_mgr_run(upump_mgr, NULL);
+    boundary_cb(boundary);
+    upump_free(boundary);
+
+    if (paced && nb_packets)
+        /* the replay lasts as long as the scaled capture */
+        assert(uclock_now(uclock) - start >= dates[nb_packets - 1] - dates[0]);
+
+    upipe_release(upipe_pcap_src);
+    upipe_clean(&sink);
+}
+
+/** checks the packets received without filter and their dates */
+static void check_dates(uint64_t interval, uint64_t origin)
+{
+    assert(nb_packets == NB_PACKETS);
+    for (unsigned int i = 0; i < NB_PACKETS; i++) {
+        assert(indices[i] == i);
+        assert(dates[i] == (i ? dates[0] + i * interval : origin));
+    }
+}
+
+/** checks the sizes of the groups of packets output per callback */
+static void check_groups(unsigned int batch)
+{
+    unsigned int total = 0;
+    for (unsigned int i = 0; i < nb_groups; i++) {
+        assert(groups[i] <= batch);
+        if (i < nb_groups - 1)
+            assert(groups[i] == batch);
+        total += groups[i];
+    }
+    assert(total == nb_packets);
+}
+
+/** checks the packets received with a filter */
+static void check_filter(int addr, int port)
+{
+    unsigned int expected = 0;
+    for (unsigned int i = 0; i < NB_PACKETS; i++) {
+        if ((addr != -1 && packet_addr(i) != addr) ||
+            (port != -1 && packet_port(i) != port))
+            continue;
+        assert(expected < nb_packets);
+        assert(indices[expected] == i);
+        expected++;
+    }
+    assert(expected == nb_packets);
+    assert(nb_packets < NB_PACKETS);
+}
+
+int main(int argc, char *argv[])
+{
+    char path[] = "upipe_pcap_src_controls_test.XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd != -1);
+    close(fd);
+    write_capture(path);
+
+    struct umem_mgr *umem_mgr = umem_alloc_mgr_alloc();
+    assert(umem_mgr != NULL);
+    struct udict_mgr *udict_mgr = udict_inline_mgr_alloc(UDICT_POOL_DEPTH,
+                                                         umem_mgr, -1, -1);
+    assert(udict_mgr != NULL);
+    struct uref_mgr *uref_mgr = uref_std_mgr_alloc(UREF_POOL_DEPTH, udict_mgr,
+                                                   0);
+    assert(uref_mgr != NULL);
+    upump_mgr = upump_ev_mgr_alloc_default(UPUMP_POOL, UPUMP_BLOCKER_POOL);
+    assert(upump_mgr != NULL);
+    uclock = uclock_std_alloc(0);
+    assert(uclock != NULL);
+    struct uprobe uprobe;
+    uprobe_init(&uprobe, catch, NULL);
+    struct uprobe *logger =
+        uprobe_stdio_alloc(&uprobe, stdout, UPROBE_LOG_LEVEL);
+    assert(logger != NULL);
+    logger = uprobe_uref_mgr_alloc(logger, uref_mgr);
+    assert(logger != NULL);
+    logger = uprobe_upump_mgr_alloc(logger, upump_mgr);
+    assert(logger != NULL);
+    logger = uprobe_uclock_alloc(logger, uclock);
+    assert(logger != NULL);
+    logger = uprobe_ubuf_mem_alloc(logger, umem_mgr, UBUF_POOL_DEPTH,
+                                   UBUF_POOL_DEPTH);
+    assert(logger != NULL);
+
+    struct urational normal = { .num = 1, .den = 1 };
+    uint64_t origin = (uint64_t)TS_ORIGIN * UCLOCK_FREQ;
+
+    /* invalid controls */
+    struct upipe_mgr *upipe_pcap_src_mgr = upipe_pcap_src_mgr_alloc();
+    struct upipe *upipe_pcap_src = upipe_void_alloc(upipe_pcap_src_mgr,
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL, "pcap"));
+    assert(upipe_pcap_src != NULL);
+    upipe_mgr_release(upipe_pcap_src_mgr);
+    struct urational no_den = { .num = 1, .den = 0 };
+    assert(upipe_pcap_src_set_batch(upipe_pcap_src, 0) == UBASE_ERR_INVALID);
+    assert(upipe_pcap_src_set_speed(upipe_pcap_src, no_den) ==
+           UBASE_ERR_INVALID);
+    assert(upipe_pcap_src_set_filter(upipe_pcap_src, "foo") ==
+           UBASE_ERR_INVALID);
+    assert(upipe_pcap_src_set_filter(upipe_pcap_src, ":70000") ==
+           UBASE_ERR_INVALID);
+    upipe_release(upipe_pcap_src);
+
+    /* batches */
+    run(logger, path, 1, normal, NULL, false);
+    check_dates(PACKET_INTERVAL, origin);
+    check_groups(1);
+    run(logger, path, 4, normal, NULL, false);
+    check_dates(PACKET_INTERVAL, origin);
+    check_groups(4);
+    assert(nb_groups == 3);
+    run(logger, path, 5, normal, NULL, false);
+    check_dates(PACKET_INTERVAL, origin);
+    check_groups(5);
+    assert(nb_groups == 3);
+
+    /* dates scaled by the speed */
+    struct urational fast = { .num = 2, .den = 1 };
+    run(logger, path, 1, fast, NULL, false);
+    check_dates(PACKET_INTERVAL / 2, origin);
+    struct urational slow = { .num = 1, .den = 2 };
+    run(logger, path, 1, slow, NULL, false);
+    check_dates(PACKET_INTERVAL * 2, origin);
+    struct urational unpaced = { .num = 0, .den = 1 };
+    run(logger, path, 1, unpaced, NULL, false);
+    check_dates(PACKET_INTERVAL, origin);
+
+    /* pacing on the uclock */
+    struct urational faster = { .num = 4, .den = 1 };
+    run(logger, path, 4, faster, NULL, true);
+    assert(nb_packets == NB_PACKETS);
+    for (unsigned int i = 1; i < NB_PACKETS; i++)
+        assert(dates[i] == dates[0] + i * (PACKET_INTERVAL / 4));
+
+    /* filters on the destination */
+    run(logger, path, 4, normal, "239.0.0.1:1234", false);
+    check_filter(1, 1234);
+    run(logger, path, 4, normal, ":5678", false);
+    check_filter(-1, 5678);
+    run(logger, path, 4, normal, "239.0.0.2", false);
+    check_filter(2, -1);
+    /* filtered datagrams still count in the batch */
+    assert(nb_groups == 3);
+    assert(groups[0] == 2 && groups[1] == 1 && groups[2] == 1);
+    run(logger, path, 4, normal, NULL, false);
+    check_dates(PACKET_INTERVAL, origin);
+
+    upump_mgr_release(upump_mgr);
+    uref_mgr_release(uref_mgr);
+    udict_mgr_release(udict_mgr);
+    umem_mgr_release(umem_mgr);
+    uclock_release(uclock);
+    uprobe_release(logger);
+    uprobe_clean(&uprobe);
+    unlink(path);
+    return 0;
+}
@@ -63,6 +63,7 @@ enum {
     SOURCE_NO_URI = 1,
     SOURCE_RELEASE = 3,
     SOURCE_RESET_NO_URI = 5,
+    SOURCE_REOPEN = 7,
     SOURCE_MAX
 };
 
@@ -160,6 +161,8 @@ int main(int argc, char *argv[])
         }
         if (i == SOURCE_RESET_NO_URI)
             ubase_assert(upipe_set_uri(sources[i], NULL));
+        if (i == SOURCE_REOPEN)
+            ubase_assert(upipe_set_uri(sources[i], file));
     }
 
     upump_mgr_run(upump_mgr, NULL);
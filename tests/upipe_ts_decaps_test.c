@@ -32,6 +32,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 
 #include <bitstream/mpeg/ts.h>
@@ -48,6 +49,14 @@ static int discontinuity = UBASE_ERR_NONE;
 static int start = UBASE_ERR_NONE;
 static size_t payload_size = 184;
 
+/** expected outputs in vector mode */
+struct expect {
+    size_t payload_size;
+    int start;
+    int discontinuity;
+};
+static const struct expect *expect = NULL;
+
 /** definition of our uprobe */
 static int catch(struct uprobe *uprobe, struct upipe *upipe,
                  int event, va_list args)
@@ -90,6 +99,15 @@ static void test_input(struct upipe *upipe, struct uref *uref,
     assert(uref != NULL);
     size_t size;
     ubase_assert(uref_block_size(uref, &size));
+    if (expect != NULL) {
+        assert(size == expect->payload_size);
+        assert(expect->start == uref_block_get_start(uref));
+        assert(expect->discontinuity == uref_flow_get_discontinuity(uref));
+        expect++;
+        uref_free(uref);
+        nb_packets--;
+        return;
+    }
     assert(size == payload_size);
     assert(transporterror == uref_flow_get_error(uref));
     assert(discontinuity == uref_flow_get_discontinuity(uref));
@@ -219,6 +237,51 @@ int main(int argc, char *argv[])
     assert(!nb_packets);
     assert(!pcr);
 
+    upipe_release(upipe_ts_decaps);
+
+    /* vectors of aligned packets */
+    uref = uref_block_flow_alloc_def(uref_mgr, "mpegtsaligned.");
+    assert(uref != NULL);
+    upipe_ts_decaps = upipe_void_alloc(upipe_ts_decaps_mgr,
+            uprobe_pfx_alloc(uprobe_use(uprobe_stdio), UPROBE_LOG_LEVEL,
+                                   "ts decaps aligned"));
+    assert(upipe_ts_decaps != NULL);
+    ubase_assert(upipe_set_flow_def(upipe_ts_decaps, uref));
+    ubase_assert(upipe_set_output(upipe_ts_decaps, upipe_sink));
+    uref_free(uref);
+
+    uref = uref_block_alloc(uref_mgr, ubuf_mgr, 5 * TS_SIZE);
+    assert(uref != NULL);
+    size = -1;
+    ubase_assert(uref_block_write(uref, 0, &size, &buffer));
+    assert(size == 5 * TS_SIZE);
+    for (int i = 0; i < 5; i++) {
+        ts_init(buffer + i * TS_SIZE);
+        ts_set_cc(buffer + i * TS_SIZE, i);
+        ts_set_payload(buffer + i * TS_SIZE);
+        memset(buffer + i * TS_SIZE + TS_HEADER_SIZE, i,
+               TS_SIZE - TS_HEADER_SIZE);
+    }
+    ts_set_unitstart(buffer);
+    ts_set_adaptation(buffer + 2 * TS_SIZE, 7);
+    pcr = 0x112121212;
+    tsaf_set_pcr(buffer + 2 * TS_SIZE, pcr / 300);
+    tsaf_set_pcrext(buffer + 2 * TS_SIZE, pcr % 300);
+    /* duplicate of the fourth packet */
+    memcpy(buffer + 4 * TS_SIZE, buffer + 3 * TS_SIZE, TS_SIZE);
+    uref_block_unmap(uref, 0);
+
+    static const struct expect expect_vector[] = {
+        { 2 * 184, UBASE_ERR_NONE, UBASE_ERR_NONE },
+        { 176 + 184, UBASE_ERR_INVALID, UBASE_ERR_INVALID },
+    };
+    expect = expect_vector;
+    nb_packets += 2;
+    upipe_input(upipe_ts_decaps, uref, NULL);
+    assert(!nb_packets);
+    assert(!pcr);
+    assert(expect == expect_vector + 2);
+
     upipe_release(upipe_ts_decaps);
     upipe_mgr_release(upipe_ts_decaps_mgr); // nop
 
@@ -0,0 +1,548 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short unit tests for TS demux module framing programs on worker threads
+ */
+
+#undef NDEBUG
+
+#include "upipe/ubase.h"
+#include "upipe/urefcount.h"
+#include "upipe/uprobe.h"
+#include "upipe/uprobe_stdio.h"
+#include "upipe/uprobe_prefix.h"
+#include "upipe/uprobe_uref_mgr.h"
+#include "upipe/uprobe_ubuf_mem.h"
+#include "upipe/uclock.h"
+#include "upipe/umem.h"
+#include "upipe/umem_alloc.h"
+#include "upipe/udict.h"
+#include "upipe/udict_inline.h"
+#include "upipe/ubuf.h"
+#include "upipe/ubuf_block_mem.h"
+#include "upipe/uref.h"
+#include "upipe/uref_flow.h"
+#include "upipe/uref_block_flow.h"
+#include "upipe/uref_block.h"
+#include "upipe/uref_clock.h"
+#include "upipe/uref_std.h"
+#include "upipe/upump.h"
+#include "upipe/upipe.h"
+#include "upump-ev/upump_ev.h"
+#include "upipe-pthread/uprobe_pthread_upump_mgr.h"
+#include "upipe-modules/upipe_worker_linear.h"
+#include "upipe-modules/upipe_transfer.h"
+#include "upipe-ts/upipe_ts_demux.h"
+#include "upipe-ts/upipe_ts_split.h"
+#include "upipe-framers/upipe_auto_framer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include <bitstream/mpeg/ts.h>
+#include <bitstream/mpeg/psi.h>
+#include <bitstream/mpeg/pes.h>
+#include <bitstream/mpeg/mp2v.h>
+
+#define UDICT_POOL_DEPTH 0
+#define UREF_POOL_DEPTH 0
+#define UBUF_POOL_DEPTH 0
+#define UPUMP_POOL 0
+#define UPUMP_BLOCKER_POOL 0
+#define XFER_QUEUE 255
+#define XFER_POOL 1
+#define UPROBE_LOG_LEVEL UPROBE_LOG_DEBUG
+#define NB_PROGRAMS 2
+#define TSID 42
+#define PMT_PID(program) (100 * ((program) + 1))
+#define ES_PID(program) (PMT_PID(program) + 1)
+#define PROGRAM_NUMBER(program) (12 + (program))
+/** the first PCR of a program is mapped to this date */
+#define PROG_ORIGIN ((UINT64_C(1) << 33) * UCLOCK_FREQ / 90000)
+
+static struct uprobe *logger;
+static struct upipe *upipe_ts_demux;
+static struct upipe *upipe_ts_demux_programs[NB_PROGRAMS];
+static struct upipe *upipe_ts_demux_outputs[NB_PROGRAMS];
+static struct upipe *sinks[NB_PROGRAMS];
+static pthread_t main_thread_id;
+static pthread_t worker_thread_ids[NB_PROGRAMS];
+/** number of flow definitions thrown on each worker thread */
+static unsigned int worker_flow_defs[NB_PROGRAMS];
+/** number of framed pictures received on the main thread */
+static unsigned int nb_pictures = 0;
+
+/** PCR, DTS and PTS of the only picture of each program, in 27 MHz units */
+static const uint64_t pcrs[NB_PROGRAMS] = {
+    UCLOCK_FREQ, 2 * UCLOCK_FREQ
+};
+static const uint64_t dtss[NB_PROGRAMS] = {
+    2 * UCLOCK_FREQ, 2 * UCLOCK_FREQ + UCLOCK_FREQ / 2
+};
+static const uint64_t ptss[NB_PROGRAMS] = {
+    3 * UCLOCK_FREQ, 2 * UCLOCK_FREQ + UCLOCK_FREQ / 2 + UCLOCK_FREQ / 25
+};
+
+/** helper phony pipe */
+struct test_pipe {
+    struct urefcount urefcount;
+    unsigned int program;
+    bool flow_def;
+    unsigned int nb_packets;
+    struct upipe upipe;
+};
+
+/** helper phony pipe */
+static void test_free(struct urefcount *urefcount)
+{
+    struct test_pipe *test_pipe =
+        container_of(urefcount, struct test_pipe, urefcount);
+    upipe_dbg(&test_pipe->upipe, "dead");
+    assert(test_pipe->flow_def);
+    assert(test_pipe->nb_packets == 1);
+    urefcount_clean(&test_pipe->urefcount);
+    upipe_clean(&test_pipe->upipe);
+    free(test_pipe);
+}
+
+/** helper phony pipe */
+static struct upipe *test_alloc(struct upipe_mgr *mgr,
+                                struct uprobe *uprobe, uint32_t signature,
+                                va_list args)
+{
+    struct test_pipe *test_pipe = malloc(sizeof(struct test_pipe));
+    assert(test_pipe != NULL);
+    upipe_init(&test_pipe->upipe, mgr, uprobe);
+    urefcount_init(&test_pipe->urefcount, test_free);
+    test_pipe->upipe.refcount = &test_pipe->urefcount;
+    test_pipe->program = 0;
+    test_pipe->flow_def = false;
+    test_pipe->nb_packets = 0;
+    return &test_pipe->upipe;
+}
+
+/** helper phony pipe */
+static void test_input(struct upipe *upipe, struct uref *uref,
+                       struct upump **upump_p)
+{
+    struct test_pipe *test_pipe = container_of(upipe, struct test_pipe, upipe);
+    upipe_dbg(upipe, "input");
+    assert(pthread_equal(pthread_self(), main_thread_id));
+    assert(test_pipe->flow_def);
+
+    /* timestamps are relative to the first PCR of each program */
+    unsigned int program = test_pipe->program;
+    uint64_t dts_prog, pts_prog;
+    ubase_assert(uref_clock_get_dts_prog(uref, &dts_prog));
+    ubase_assert(uref_clock_get_pts_prog(uref, &pts_prog));
+    assert(dts_prog == PROG_ORIGIN + dtss[program] - pcrs[program]);
+    assert(pts_prog == PROG_ORIGIN + ptss[program] - pcrs[program]);
+    uint64_t dts_orig;
+    ubase_assert(uref_clock_get_dts_orig(uref, &dts_orig));
+    assert(dts_orig == dtss[program]);
+
+    test_pipe->nb_packets++;
+    nb_pictures++;
+    uref_free(uref);
+}
+
+/** helper phony pipe */
+static int test_control(struct upipe *upipe, int command, va_list args)
+{
+    struct test_pipe *test_pipe = container_of(upipe, struct test_pipe, upipe);
+    assert(pthread_equal(pthread_self(), main_thread_id));
+    switch (command) {
+        case UPIPE_REGISTER_REQUEST: {
+            struct urequest *urequest = va_arg(args, struct urequest *);
+            return upipe_throw_provide_request(upipe, urequest);
+        }
+        case UPIPE_UNREGISTER_REQUEST:
+            return UBASE_ERR_NONE;
+
+        case UPIPE_SET_FLOW_DEF: {
+            struct uref *flow_def = va_arg(args, struct uref *);
+            const char *def;
+            ubase_assert(uref_flow_get_def(flow_def, &def));
+            upipe_dbg_va(upipe, "flow_def %s", def);
+            assert(!ubase_ncmp(def, "block.mpeg2video.pic."));
+            uint64_t flow_id;
+            ubase_assert(uref_flow_get_id(flow_def, &flow_id));
+            assert(flow_id == ES_PID(test_pipe->program));
+            test_pipe->flow_def = true;
+            return UBASE_ERR_NONE;
+        }
+        default:
+            assert(0);
+            return UBASE_ERR_UNHANDLED;
+    }
+}
+
+/** helper phony pipe */
+static struct upipe_mgr test_mgr = {
+    .refcount = NULL,
+    .upipe_alloc = test_alloc,
+    .upipe_input = test_input,
+    .upipe_control = test_control
+};
+
+/** runs the event loop of a worker thread */
+static void *thread(void *_upipe_xfer_mgr)
+{
+    struct upipe_mgr *upipe_xfer_mgr = (struct upipe_mgr *)_upipe_xfer_mgr;
+
+    struct upump_mgr *upump_mgr = upump_ev_mgr_alloc_loop(UPUMP_POOL,
+                                                          UPUMP_BLOCKER_POOL);
+    assert(upump_mgr != NULL);
+    uprobe_pthread_upump_mgr_set(logger, upump_mgr);
+
+    ubase_assert(upipe_xfer_mgr_attach(upipe_xfer_mgr, upump_mgr));
+    upipe_mgr_release(upipe_xfer_mgr);
+
+    upump_mgr_run(upump_mgr, NULL);
+
+    upump_mgr_release(upump_mgr);
+
+    return NULL;
+}
+
+/** allocates the elementary stream output of a program */
+static void alloc_output(struct upipe *program, struct uref *flow_def)
+{
+    unsigned int i;
+    for (i = 0; i < NB_PROGRAMS; i++)
+        if (program == upipe_ts_demux_programs[i])
+            break;
+    assert(i < NB_PROGRAMS);
+    uint64_t flow_id;
+    ubase_assert(uref_flow_get_id(flow_def, &flow_id));
+    assert(flow_id == ES_PID(i));
+    assert(upipe_ts_demux_outputs[i] == NULL);
+
+    upipe_ts_demux_outputs[i] = upipe_flow_alloc_sub(program,
+            uprobe_pfx_alloc_va(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                                "ts demux video %u", i),
+            flow_def);
+    assert(upipe_ts_demux_outputs[i] != NULL);
+
+    sinks[i] = upipe_void_alloc(&test_mgr,
+            uprobe_pfx_alloc_va(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                                "sink %u", i));
+    assert(sinks[i] != NULL);
+    container_of(sinks[i], struct test_pipe, upipe)->program = i;
+    ubase_assert(upipe_set_output(upipe_ts_demux_outputs[i], sinks[i]));
+}
+
+/** definition of our uprobe */
+static int catch(struct uprobe *uprobe, struct upipe *upipe,
+                 int event, va_list args)
+{
+    switch (event) {
+        default:
+            assert(0);
+            break;
+        case UPROBE_READY:
+        case UPROBE_DEAD:
+        case UPROBE_SYNC_ACQUIRED:
+        case UPROBE_SYNC_LOST:
+        case UPROBE_CLOCK_REF:
+        case UPROBE_CLOCK_TS:
+        case UPROBE_TS_SPLIT_ADD_PID:
+        case UPROBE_TS_SPLIT_DEL_PID:
+        case UPROBE_NEED_OUTPUT:
+        case UPROBE_NEED_UPUMP_MGR:
+        case UPROBE_SOURCE_END:
+        case UPROBE_STALLED:
+            break;
+        case UPROBE_NEW_FLOW_DEF:
+            for (unsigned int i = 0; i < NB_PROGRAMS; i++)
+                if (pthread_equal(pthread_self(), worker_thread_ids[i]))
+                    worker_flow_defs[i]++;
+            break;
+        case UPROBE_SPLIT_UPDATE: {
+            assert(pthread_equal(pthread_self(), main_thread_id));
+            struct uref *flow_def = NULL;
+            while (ubase_check(upipe_split_iterate(upipe, &flow_def)) &&
+                   flow_def != NULL) {
+                const char *def;
+                ubase_assert(uref_flow_get_def(flow_def, &def));
+                if (!ubase_ncmp(def, "void.")) {
+                    uint64_t flow_id;
+                    ubase_assert(uref_flow_get_id(flow_def, &flow_id));
+                    unsigned int i = flow_id - PROGRAM_NUMBER(0);
+                    assert(i < NB_PROGRAMS);
+                    assert(upipe_ts_demux_programs[i] == NULL);
+                    upipe_ts_demux_programs[i] =
+                        upipe_flow_alloc_sub(upipe_ts_demux,
+                            uprobe_pfx_alloc_va(uprobe_use(logger),
+                                                UPROBE_LOG_LEVEL,
+                                                "ts demux program %u", i),
+                            flow_def);
+                    assert(upipe_ts_demux_programs[i] != NULL);
+                } else if (!ubase_ncmp(def, "block.mpeg2video."))
+                    alloc_output(upipe, flow_def);
+            }
+            break;
+        }
+    }
+    return UBASE_ERR_NONE;
+}
+
+/** allocates a TS packet */
+static struct uref *alloc_packet(struct uref_mgr *uref_mgr,
+                                 struct ubuf_mgr *ubuf_mgr, uint8_t **buffer_p)
+{
+    struct uref *uref = uref_block_alloc(uref_mgr, ubuf_mgr, TS_SIZE);
+    assert(uref != NULL);
+    int size = -1;
+    ubase_assert(uref_block_write(uref, 0, &size, buffer_p));
+    assert(size == TS_SIZE);
+    ts_init(*buffer_p);
+    ts_set_unitstart(*buffer_p);
+    ts_set_cc(*buffer_p, 0);
+    ts_set_payload(*buffer_p);
+    return uref;
+}
+
+/** sends a PAT listing all programs */
+static void send_pat(struct uref_mgr *uref_mgr, struct ubuf_mgr *ubuf_mgr)
+{
+    uint8_t *buffer;
+    struct uref *uref = alloc_packet(uref_mgr, ubuf_mgr, &buffer);
+    ts_set_pid(buffer, 0);
+    uint8_t *payload = ts_payload(buffer);
+    *payload++ = 0; /* pointer_field */
+    pat_init(payload);
+    pat_set_length(payload, NB_PROGRAMS * PAT_PROGRAM_SIZE);
+    pat_set_tsid(payload, TSID);
+    psi_set_version(payload, 0);
+    psi_set_current(payload);
+    psi_set_section(payload, 0);
+    psi_set_lastsection(payload, 0);
+    for (unsigned int i = 0; i < NB_PROGRAMS; i++) {
+        uint8_t *pat_program = pat_get_program(payload, i);
+        patn_init(pat_program);
+        patn_set_program(pat_program, PROGRAM_NUMBER(i));
+        patn_set_pid(pat_program, PMT_PID(i));
+    }
+    psi_set_crc(payload);
+    payload += PAT_HEADER_SIZE + NB_PROGRAMS * PAT_PROGRAM_SIZE +
+               PSI_CRC_SIZE;
+    *payload = 0xff;
+    uref_block_unmap(uref, 0);
+    upipe_input(upipe_ts_demux, uref, NULL);
+}
+
+/** sends the PMT of a program, with a single MPEG-2 video stream also
+ * carrying the PCR */
+static void send_pmt(struct uref_mgr *uref_mgr, struct ubuf_mgr *ubuf_mgr,
+                     unsigned int program)
+{
+    uint8_t *buffer;
+    struct uref *uref = alloc_packet(uref_mgr, ubuf_mgr, &buffer);
+    ts_set_pid(buffer, PMT_PID(program));
+    uint8_t *payload = ts_payload(buffer);
+    *payload++ = 0; /* pointer_field */
+    pmt_init(payload);
+    pmt_set_length(payload, PMT_ES_SIZE);
+    pmt_set_program(payload, PROGRAM_NUMBER(program));
+    psi_set_version(payload, 0);
+    psi_set_current(payload);
+    psi_set_section(payload, 0);
+    psi_set_lastsection(payload, 0);
+    pmt_set_pcrpid(payload, ES_PID(program));
+    pmt_set_desclength(payload, 0);
+    uint8_t *pmt_es = pmt_get_es(payload, 0);
+    pmtn_init(pmt_es);
+    pmtn_set_pid(pmt_es, ES_PID(program));
+    pmtn_set_streamtype(pmt_es, 2);
+    pmtn_set_desclength(pmt_es, 0);
+    psi_set_crc(payload);
+    payload += PMT_HEADER_SIZE + PMT_ES_SIZE + PSI_CRC_SIZE;
+    *payload = 0xff;
+    uref_block_unmap(uref, 0);
+    upipe_input(upipe_ts_demux, uref, NULL);
+}
+
+/** sends a complete I picture of a program, with a PCR */
+static void send_picture(struct uref_mgr *uref_mgr, struct ubuf_mgr *ubuf_mgr,
+                         unsigned int program)
+{
+    uint8_t *buffer;
+    struct uref *uref = alloc_packet(uref_mgr, ubuf_mgr, &buffer);
+    ts_set_pid(buffer, ES_PID(program));
+    ts_set_adaptation(buffer, TS_SIZE - TS_HEADER_SIZE -
+            PES_HEADER_SIZE_PTSDTS - MP2VSEQ_HEADER_SIZE -
+            MP2VSEQX_HEADER_SIZE - MP2VPIC_HEADER_SIZE -
+            MP2VPICX_HEADER_SIZE - 4 - MP2VEND_HEADER_SIZE - 1);
+    tsaf_set_discontinuity(buffer);
+    tsaf_set_randomaccess(buffer);
+    tsaf_set_pcr(buffer, pcrs[program] / 300);
+    tsaf_set_pcrext(buffer, pcrs[program] % 300);
+    uint8_t *payload = ts_payload(buffer);
+    pes_init(payload);
+    pes_set_streamid(payload, PES_STREAM_ID_VIDEO_MPEG);
+    pes_set_headerlength(payload, 0);
+    pes_set_length(payload, MP2VSEQ_HEADER_SIZE + MP2VSEQX_HEADER_SIZE +
+            MP2VPIC_HEADER_SIZE + MP2VPICX_HEADER_SIZE + 4 +
+            MP2VEND_HEADER_SIZE + PES_HEADER_SIZE_PTSDTS - PES_HEADER_SIZE);
+    pes_set_dataalignment(payload);
+    pes_set_pts(payload, ptss[program] / 300);
+    pes_set_dts(payload, dtss[program] / 300);
+    payload = pes_payload(payload);
+
+    mp2vseq_init(payload);
+    mp2vseq_set_horizontal(payload, 720);
+    mp2vseq_set_vertical(payload, 576);
+    mp2vseq_set_aspect(payload, MP2VSEQ_ASPECT_16_9);
+    mp2vseq_set_framerate(payload, MP2VSEQ_FRAMERATE_25);
+    mp2vseq_set_bitrate(payload, 2000000/400);
+    mp2vseq_set_vbvbuffer(payload, 1835008/16/1024);
+    payload += MP2VSEQ_HEADER_SIZE;
+
+    mp2vseqx_init(payload);
+    mp2vseqx_set_profilelevel(payload,
+                              MP2VSEQX_PROFILE_MAIN | MP2VSEQX_LEVEL_MAIN);
+    mp2vseqx_set_chroma(payload, MP2VSEQX_CHROMA_420);
+    mp2vseqx_set_horizontal(payload, 0);
+    mp2vseqx_set_vertical(payload, 0);
+    mp2vseqx_set_bitrate(payload, 0);
+    mp2vseqx_set_vbvbuffer(payload, 0);
+    payload += MP2VSEQX_HEADER_SIZE;
+
+    mp2vpic_init(payload);
+    mp2vpic_set_temporalreference(payload, 0);
+    mp2vpic_set_codingtype(payload, MP2VPIC_TYPE_I);
+    mp2vpic_set_vbvdelay(payload, UINT16_MAX);
+    payload += MP2VPIC_HEADER_SIZE;
+
+    mp2vpicx_init(payload);
+    mp2vpicx_set_fcode00(payload, 0);
+    mp2vpicx_set_fcode01(payload, 0);
+    mp2vpicx_set_fcode10(payload, 0);
+    mp2vpicx_set_fcode11(payload, 0);
+    mp2vpicx_set_intradc(payload, 0);
+    mp2vpicx_set_structure(payload, MP2VPICX_FRAME_PICTURE);
+    mp2vpicx_set_tff(payload);
+    payload += MP2VPICX_HEADER_SIZE;
+
+    mp2vstart_init(payload, 1);
+    payload += 4;
+
+    mp2vend_init(payload);
+    uref_block_unmap(uref, 0);
+    upipe_input(upipe_ts_demux, uref, NULL);
+}
+
+int main(int argc, char *argv[])
+{
+    main_thread_id = pthread_self();
+    struct upump_mgr *upump_mgr =
+        upump_ev_mgr_alloc_default(UPUMP_POOL, UPUMP_BLOCKER_POOL);
+    assert(upump_mgr != NULL);
+
+    struct umem_mgr *umem_mgr = umem_alloc_mgr_alloc();
+    assert(umem_mgr != NULL);
+    struct udict_mgr *udict_mgr = udict_inline_mgr_alloc(UDICT_POOL_DEPTH,
+                                                         umem_mgr, -1, -1);
+    assert(udict_mgr != NULL);
+    struct uref_mgr *uref_mgr = uref_std_mgr_alloc(UREF_POOL_DEPTH, udict_mgr,
+                                                   0);
+    assert(uref_mgr != NULL);
+    struct ubuf_mgr *ubuf_mgr = ubuf_block_mem_mgr_alloc(UBUF_POOL_DEPTH,
+                                                         UBUF_POOL_DEPTH,
+                                                         umem_mgr, 0, 0, -1, 0);
+    assert(ubuf_mgr != NULL);
+    struct uprobe uprobe;
+    uprobe_init(&uprobe, catch, NULL);
+    logger = uprobe_stdio_alloc(&uprobe, stdout, UPROBE_LOG_LEVEL);
+    assert(logger != NULL);
+    logger = uprobe_uref_mgr_alloc(logger, uref_mgr);
+    assert(logger != NULL);
+    logger = uprobe_ubuf_mem_alloc(logger, umem_mgr,
+                                   UBUF_POOL_DEPTH, UBUF_POOL_DEPTH);
+    assert(logger != NULL);
+    logger = uprobe_pthread_upump_mgr_alloc(logger);
+    assert(logger != NULL);
+    uprobe_pthread_upump_mgr_set(logger, upump_mgr);
+
+    struct upipe_mgr *upipe_autof_mgr = upipe_autof_mgr_alloc();
+    assert(upipe_autof_mgr != NULL);
+
+    struct upipe_mgr *upipe_ts_demux_mgr = upipe_ts_demux_mgr_alloc();
+    assert(upipe_ts_demux_mgr != NULL);
+    ubase_assert(upipe_ts_demux_mgr_set_autof_mgr(upipe_ts_demux_mgr,
+                                                  upipe_autof_mgr));
+
+    struct uref *uref;
+    uref = uref_block_flow_alloc_def(uref_mgr, "mpegts.");
+    assert(uref != NULL);
+
+    upipe_ts_demux = upipe_void_alloc(upipe_ts_demux_mgr,
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL, "ts demux"));
+    assert(upipe_ts_demux != NULL);
+    ubase_assert(upipe_set_flow_def(upipe_ts_demux, uref));
+    uref_free(uref);
+
+    for (unsigned int i = 0; i < NB_PROGRAMS; i++) {
+        struct upipe_mgr *upipe_xfer_mgr =
+            upipe_xfer_mgr_alloc(XFER_QUEUE, XFER_POOL, NULL);
+        assert(upipe_xfer_mgr != NULL);
+        upipe_mgr_use(upipe_xfer_mgr);
+        assert(pthread_create(&worker_thread_ids[i], NULL, thread,
+                              upipe_xfer_mgr) == 0);
+
+        struct upipe_mgr *upipe_wlin_mgr =
+            upipe_wlin_mgr_alloc(upipe_xfer_mgr);
+        assert(upipe_wlin_mgr != NULL);
+        upipe_mgr_release(upipe_xfer_mgr);
+        ubase_assert(upipe_ts_demux_add_worker(upipe_ts_demux,
+                                               upipe_wlin_mgr, logger));
+        upipe_mgr_release(upipe_wlin_mgr);
+    }
+
+    send_pat(uref_mgr, ubuf_mgr);
+    for (unsigned int i = 0; i < NB_PROGRAMS; i++) {
+        assert(upipe_ts_demux_programs[i] != NULL);
+        send_pmt(uref_mgr, ubuf_mgr, i);
+        assert(upipe_ts_demux_outputs[i] != NULL);
+    }
+    for (unsigned int i = 0; i < NB_PROGRAMS; i++)
+        send_picture(uref_mgr, ubuf_mgr, i);
+
+    /* the framed pictures come back to this thread once the queues are
+     * flushed */
+    for (unsigned int i = 0; i < NB_PROGRAMS; i++) {
+        upipe_release(sinks[i]);
+        upipe_release(upipe_ts_demux_outputs[i]);
+        upipe_release(upipe_ts_demux_programs[i]);
+    }
+    upipe_release(upipe_ts_demux);
+
+    upump_mgr_run(upump_mgr, NULL);
+    assert(nb_pictures == NB_PROGRAMS);
+
+    for (unsigned int i = 0; i < NB_PROGRAMS; i++) {
+        assert(!pthread_join(worker_thread_ids[i], NULL));
+        /* each program was framed on its own worker thread */
+        assert(worker_flow_defs[i]);
+    }
+
+    upipe_mgr_release(upipe_ts_demux_mgr);
+    upipe_mgr_release(upipe_autof_mgr);
+
+    upump_mgr_release(upump_mgr);
+    uref_mgr_release(uref_mgr);
+    ubuf_mgr_release(ubuf_mgr);
+    udict_mgr_release(udict_mgr);
+    umem_mgr_release(umem_mgr);
+    uprobe_release(logger);
+    uprobe_clean(&uprobe);
+
+    return 0;
+}
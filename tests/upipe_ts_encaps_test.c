@@ -38,6 +38,7 @@
 
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 
 #include <bitstream/mpeg/ts.h>
@@ -386,8 +387,24 @@ int main(int argc, char *argv[])
                                   (uint64_t)total_size * UCLOCK_FREQ / 2194);
         }
 
-        ubase_assert(upipe_ts_encaps_splice(upipe_ts_encaps, mux_sys, mux_sys,
-                                            &ubuf, &dts_sys));
+        if (i % 2) {
+            /* write every other packet to a contiguous buffer */
+            ubuf = ubuf_block_alloc(ubuf_mgr, TS_SIZE);
+            assert(ubuf != NULL);
+            size = -1;
+            ubase_assert(ubuf_block_write(ubuf, 0, &size, &buffer));
+            assert(size == TS_SIZE);
+            ubase_assert(upipe_ts_encaps_splice_buffer(upipe_ts_encaps,
+                        mux_sys, mux_sys, buffer, &dts_sys));
+            int header_size = ts_payload(buffer) - buffer;
+            ubuf_block_unmap(ubuf, 0);
+            /* check_ubuf expects the header in its own segment */
+            struct ubuf *payload = ubuf_block_split(ubuf, header_size);
+            assert(payload != NULL);
+            ubase_assert(ubuf_block_append(ubuf, payload));
+        } else
+            ubase_assert(upipe_ts_encaps_splice(upipe_ts_encaps,
+                        mux_sys, mux_sys, &ubuf, &dts_sys));
 
         if (i == 0) {
             check_ubuf(ubuf, PES_STREAM_ID_PRIVATE_2, true, false, false, true,
@@ -605,6 +622,82 @@ int main(int argc, char *argv[])
 
     upipe_release(upipe_ts_encaps);
 
+    /* TS packets passed through */
+    flow_def = uref_block_flow_alloc_def(uref_mgr,
+                                         "mpegts.mpegtspes.mpeg2video.pic.");
+    assert(flow_def != NULL);
+    ubase_assert(uref_block_flow_set_octetrate(flow_def, 18800));
+    ubase_assert(uref_ts_flow_set_tb_rate(flow_def, 22560));
+    ubase_assert(uref_ts_flow_set_pid(flow_def, 68));
+    ubase_assert(uref_ts_flow_set_max_delay(flow_def, UCLOCK_FREQ / 10));
+
+    upipe_ts_encaps = upipe_void_alloc(upipe_ts_encaps_mgr,
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                             "ts encaps"));
+    assert(upipe_ts_encaps != NULL);
+    ubase_assert(upipe_set_flow_def(upipe_ts_encaps, flow_def));
+    uref_free(flow_def);
+    ubase_assert(upipe_ts_mux_set_pcr_restamp(upipe_ts_encaps, true));
+
+    /* a vector of three packets, the second one being a duplicate of the
+     * first one, and the third one carrying a PCR */
+    uref = uref_block_alloc(uref_mgr, ubuf_mgr, 3 * TS_SIZE);
+    assert(uref != NULL);
+    size = -1;
+    ubase_assert(uref_block_write(uref, 0, &size, &buffer));
+    assert(size == 3 * TS_SIZE);
+    for (i = 0; i < 3; i++) {
+        uint8_t *ts = buffer + i * TS_SIZE;
+        ts_init(ts);
+        ts_set_pid(ts, 100);
+        ts_set_payload(ts);
+        ts_set_cc(ts, i < 2 ? 5 : 6);
+        if (i == 2) {
+            ts_set_adaptation(ts, TS_HEADER_SIZE_PCR - TS_HEADER_SIZE - 1);
+            tsaf_set_pcr(ts, 1000);
+            tsaf_set_pcrext(ts, 0);
+        }
+        memset(ts_payload(ts), i, TS_SIZE - (ts_payload(ts) - ts));
+    }
+    uref_block_unmap(uref, 0);
+    uref_clock_set_cr_sys(uref, UINT32_MAX);
+    upipe_input(upipe_ts_encaps, uref, NULL);
+    assert(next_ready);
+    assert(next_cr_sys == UINT32_MAX);
+    assert(next_dts_sys == UINT32_MAX + UCLOCK_FREQ / 10);
+    last_cc = 3;
+    ubase_assert(upipe_ts_mux_set_cc(upipe_ts_encaps, last_cc));
+
+    for (i = 0; i < 3; i++) {
+        uint64_t mux_sys = UINT32_MAX + (i + 1) * UCLOCK_FREQ / 100;
+        ubase_assert(upipe_ts_encaps_splice(upipe_ts_encaps, mux_sys,
+                                            mux_sys, &ubuf, &dts_sys));
+        assert(dts_sys == UINT64_MAX);
+
+        uint8_t *ts;
+        size = -1;
+        ubase_assert(ubuf_block_write(ubuf, 0, &size, &ts));
+        assert(size == TS_SIZE);
+        assert(ts_validate(ts));
+        assert(ts_get_pid(ts) == 68);
+        if (i != 1)
+            last_cc = (last_cc + 1) & 0xf;
+        assert(ts_get_cc(ts) == last_cc);
+        if (i == 2) {
+            assert(tsaf_has_pcr(ts));
+            assert(tsaf_get_pcr(ts) * 300 + tsaf_get_pcrext(ts) ==
+                   1000 * 300 + (i + 1) * UCLOCK_FREQ / 100);
+        }
+        const uint8_t *payload = ts_payload(ts);
+        for ( ; payload < ts + TS_SIZE; payload++)
+            assert(*payload == i);
+        ubuf_block_unmap(ubuf, 0);
+        ubuf_free(ubuf);
+    }
+    assert(!next_ready);
+
+    upipe_release(upipe_ts_encaps);
+
     upipe_mgr_release(upipe_ts_encaps_mgr); // nop
 
     uref_mgr_release(uref_mgr);
@@ -0,0 +1,324 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short benchmark for the TS mux module
+ *
+ * This muxes 50 programs of one video and nine audio elementary streams
+ * (500 PIDs) into a capped 80 Mbits/s transport stream, in file mode, and
+ * reports how fast the output packets are produced. With -c, the mux writes
+ * its output to contiguous buffers.
+ *
+ * Usage: upipe_ts_mux_bench [-c] [<duration in seconds>]
+ */
+
+#undef NDEBUG
+
+#include "upipe/uprobe.h"
+#include "upipe/uprobe_stdio.h"
+#include "upipe/uprobe_prefix.h"
+#include "upipe/uprobe_uref_mgr.h"
+#include "upipe/uprobe_ubuf_mem.h"
+#include "upipe/umem.h"
+#include "upipe/umem_alloc.h"
+#include "upipe/udict.h"
+#include "upipe/udict_inline.h"
+#include "upipe/ubuf.h"
+#include "upipe/ubuf_block_mem.h"
+#include "upipe/uclock.h"
+#include "upipe/uref.h"
+#include "upipe/uref_flow.h"
+#include "upipe/uref_block.h"
+#include "upipe/uref_block_flow.h"
+#include "upipe/uref_pic_flow.h"
+#include "upipe/uref_sound_flow.h"
+#include "upipe/uref_program_flow.h"
+#include "upipe/uref_void_flow.h"
+#include "upipe/uref_clock.h"
+#include "upipe/uref_std.h"
+#include "upipe/upipe.h"
+#include "upipe-ts/upipe_ts_mux.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+
+#include <bitstream/mpeg/ts.h>
+
+#define UDICT_POOL_DEPTH 10
+#define UREF_POOL_DEPTH 10
+#define UBUF_POOL_DEPTH 10
+#define UPROBE_LOG_LEVEL UPROBE_LOG_WARNING
+#define NB_PROGRAMS 50
+#define NB_AUDIOS 9
+#define NB_INPUTS (1 + NB_AUDIOS)
+#define OCTETRATE (80000000 / 8)
+#define VIDEO_OCTETRATE (800000 / 8)
+#define AUDIO_OCTETRATE (64000 / 8)
+#define AUDIO_SAMPLES 1152
+#define AUDIO_RATE 48000
+#define VIDEO_FPS 25
+#define GOP_SIZE 25
+#define CR_DTS_DELAY (UCLOCK_FREQ / 10)
+#define SLICE (UCLOCK_FREQ / 100)
+#define DURATION 10
+
+/** elementary stream fed to the mux */
+struct bench_input {
+    /** mux input */
+    struct upipe *upipe;
+    /** payload of the access units */
+    struct ubuf *payload;
+    /** duration of an access unit */
+    uint64_t duration;
+    /** date of the next access unit */
+    uint64_t dts;
+    /** number of access units so far */
+    uint64_t nb_aus;
+    /** true for the video input */
+    bool video;
+};
+
+static struct uref_mgr *uref_mgr;
+static struct bench_input inputs[NB_PROGRAMS][NB_INPUTS];
+static uint64_t nb_packets = 0;
+
+/** helper phony pipe counting output packets */
+static struct upipe *sink_alloc(struct upipe_mgr *mgr, struct uprobe *uprobe,
+                                uint32_t signature, va_list args)
+{
+    struct upipe *upipe = malloc(sizeof(struct upipe));
+    assert(upipe != NULL);
+    upipe_init(upipe, mgr, uprobe);
+    return upipe;
+}
+
+/** helper phony pipe counting output packets */
+static void sink_input(struct upipe *upipe, struct uref *uref,
+                       struct upump **upump_p)
+{
+    size_t size;
+    ubase_assert(uref_block_size(uref, &size));
+    assert(!(size % TS_SIZE));
+    nb_packets += size / TS_SIZE;
+    uref_free(uref);
+}
+
+/** helper phony pipe counting output packets */
+static int sink_control(struct upipe *upipe, int command, va_list args)
+{
+    switch (command) {
+        case UPIPE_REGISTER_REQUEST: {
+            struct urequest *urequest = va_arg(args, struct urequest *);
+            return upipe_throw_provide_request(upipe, urequest);
+        }
+        case UPIPE_UNREGISTER_REQUEST:
+        case UPIPE_SET_FLOW_DEF:
+            return UBASE_ERR_NONE;
+        default:
+            return UBASE_ERR_UNHANDLED;
+    }
+}
+
+/** helper phony pipe counting output packets */
+static void sink_free(struct upipe *upipe)
+{
+    upipe_clean(upipe);
+    free(upipe);
+}
+
+/** helper phony pipe counting output packets */
+static struct upipe_mgr sink_mgr = {
+    .refcount = NULL,
+    .signature = 0,
+    .upipe_alloc = sink_alloc,
+    .upipe_input = sink_input,
+    .upipe_control = sink_control
+};
+
+/** @This allocates a mux input and its payload. */
+static void bench_input_init(struct bench_input *input, struct upipe *program,
+                             struct uprobe *logger, struct ubuf_mgr *ubuf_mgr,
+                             unsigned int prog, unsigned int es)
+{
+    struct uref *flow_def;
+    uint64_t octetrate;
+    input->video = es == 0;
+    if (input->video) {
+        flow_def = uref_block_flow_alloc_def(uref_mgr, "mpeg2video.pic.");
+        assert(flow_def != NULL);
+        struct urational fps = { .num = VIDEO_FPS, .den = 1 };
+        ubase_assert(uref_pic_flow_set_fps(flow_def, fps));
+        ubase_assert(uref_block_flow_set_buffer_size(flow_def,
+                                                     VIDEO_OCTETRATE / 2));
+        octetrate = VIDEO_OCTETRATE;
+        input->duration = UCLOCK_FREQ / VIDEO_FPS;
+    } else {
+        flow_def = uref_block_flow_alloc_def(uref_mgr, "mp2.sound.");
+        assert(flow_def != NULL);
+        ubase_assert(uref_sound_flow_set_rate(flow_def, AUDIO_RATE));
+        ubase_assert(uref_sound_flow_set_samples(flow_def, AUDIO_SAMPLES));
+        octetrate = AUDIO_OCTETRATE;
+        input->duration = UCLOCK_FREQ * AUDIO_SAMPLES / AUDIO_RATE;
+    }
+    ubase_assert(uref_block_flow_set_octetrate(flow_def, octetrate));
+
+    input->upipe = upipe_flow_alloc_sub(program,
+            uprobe_pfx_alloc_va(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                                "input %u.%u", prog, es), flow_def);
+    assert(input->upipe != NULL);
+    uref_free(flow_def);
+
+    size_t size = octetrate * input->duration / UCLOCK_FREQ;
+    input->payload = ubuf_block_alloc(ubuf_mgr, size);
+    assert(input->payload != NULL);
+    uint8_t *buffer;
+    int buffer_size = -1;
+    ubase_assert(ubuf_block_write(input->payload, 0, &buffer_size, &buffer));
+    memset(buffer, 0, buffer_size);
+    ubuf_block_unmap(input->payload, 0);
+
+    input->dts = CR_DTS_DELAY;
+    input->nb_aus = 0;
+}
+
+/** @This feeds an input with its access units up to the given date. */
+static void bench_input_feed(struct bench_input *input, uint64_t end)
+{
+    while (input->dts < end + CR_DTS_DELAY) {
+        struct uref *uref = uref_alloc(uref_mgr);
+        assert(uref != NULL);
+        struct ubuf *ubuf = ubuf_dup(input->payload);
+        assert(ubuf != NULL);
+        uref_attach_ubuf(uref, ubuf);
+
+        uint64_t cr = input->dts - CR_DTS_DELAY;
+        uref_clock_set_cr_prog(uref, cr);
+        uref_clock_set_cr_sys(uref, cr);
+        uref_clock_set_cr_dts_delay(uref, CR_DTS_DELAY);
+        uref_clock_set_dts_pts_delay(uref, 0);
+        uref_clock_set_duration(uref, input->duration);
+        if (input->video && !(input->nb_aus % GOP_SIZE))
+            uref_flow_set_random(uref);
+
+        upipe_input(input->upipe, uref, NULL);
+        input->dts += input->duration;
+        input->nb_aus++;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t duration = DURATION;
+    bool contiguous = false;
+    int opt = 1;
+    if (argc > opt && !strcmp(argv[opt], "-c")) {
+        contiguous = true;
+        opt++;
+    }
+    if (argc > opt)
+        duration = strtoull(argv[opt], NULL, 10);
+
+    struct umem_mgr *umem_mgr = umem_alloc_mgr_alloc();
+    assert(umem_mgr != NULL);
+    struct udict_mgr *udict_mgr = udict_inline_mgr_alloc(UDICT_POOL_DEPTH,
+                                                         umem_mgr, -1, -1);
+    assert(udict_mgr != NULL);
+    uref_mgr = uref_std_mgr_alloc(UREF_POOL_DEPTH, udict_mgr, 0);
+    assert(uref_mgr != NULL);
+    struct ubuf_mgr *ubuf_mgr = ubuf_block_mem_mgr_alloc(UBUF_POOL_DEPTH,
+                                                         UBUF_POOL_DEPTH,
+                                                         umem_mgr, 0, 0, -1, 0);
+    assert(ubuf_mgr != NULL);
+
+    struct uprobe *logger = uprobe_stdio_alloc(NULL, stdout, UPROBE_LOG_LEVEL);
+    assert(logger != NULL);
+    logger = uprobe_uref_mgr_alloc(logger, uref_mgr);
+    assert(logger != NULL);
+    logger = uprobe_ubuf_mem_alloc(logger, umem_mgr, UBUF_POOL_DEPTH,
+                                   UBUF_POOL_DEPTH);
+    assert(logger != NULL);
+
+    struct upipe_mgr *upipe_ts_mux_mgr = upipe_ts_mux_mgr_alloc();
+    assert(upipe_ts_mux_mgr != NULL);
+    struct upipe *upipe_ts_mux = upipe_void_alloc(upipe_ts_mux_mgr,
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL, "ts mux"));
+    assert(upipe_ts_mux != NULL);
+    upipe_mgr_release(upipe_ts_mux_mgr);
+
+    struct upipe *sink = upipe_void_alloc(&sink_mgr, uprobe_use(logger));
+    assert(sink != NULL);
+    ubase_assert(upipe_set_output(upipe_ts_mux, sink));
+
+    struct uref *flow_def = uref_void_flow_alloc_def(uref_mgr);
+    assert(flow_def != NULL);
+    ubase_assert(upipe_set_flow_def(upipe_ts_mux, flow_def));
+    uref_free(flow_def);
+    ubase_assert(upipe_ts_mux_set_mode(upipe_ts_mux,
+                                       UPIPE_TS_MUX_MODE_CAPPED));
+    ubase_assert(upipe_ts_mux_set_octetrate(upipe_ts_mux, OCTETRATE));
+    ubase_assert(upipe_ts_mux_set_version(upipe_ts_mux, 1));
+    ubase_assert(upipe_ts_mux_set_cr_prog(upipe_ts_mux, 0));
+    ubase_assert(upipe_ts_mux_set_contiguous(upipe_ts_mux, contiguous));
+
+    struct upipe *programs[NB_PROGRAMS];
+    for (unsigned int i = 0; i < NB_PROGRAMS; i++) {
+        flow_def = uref_program_flow_alloc_def(uref_mgr);
+        assert(flow_def != NULL);
+        programs[i] = upipe_flow_alloc_sub(upipe_ts_mux,
+                uprobe_pfx_alloc_va(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                                    "program %u", i), flow_def);
+        assert(programs[i] != NULL);
+        uref_free(flow_def);
+        ubase_assert(upipe_ts_mux_set_version(programs[i], 1));
+
+        for (unsigned int j = 0; j < NB_INPUTS; j++)
+            bench_input_init(&inputs[i][j], programs[i], logger, ubuf_mgr,
+                             i, j);
+    }
+
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (uint64_t end = SLICE; end <= duration * UCLOCK_FREQ; end += SLICE)
+        for (unsigned int i = 0; i < NB_PROGRAMS; i++)
+            for (unsigned int j = 0; j < NB_INPUTS; j++)
+                bench_input_feed(&inputs[i][j], end);
+
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+
+    uint64_t elapsed = (stop.tv_sec - start.tv_sec) * UINT64_C(1000000000) +
+                       stop.tv_nsec - start.tv_nsec;
+    printf("%"PRIu64" s of stream, %"PRIu64" packets in %"PRIu64" ms: "
+           "%"PRIu64" packets/s, %"PRIu64" ns/packet, %.1fx real time\n",
+           duration, nb_packets, elapsed / 1000000,
+           elapsed ? nb_packets * UINT64_C(1000000000) / elapsed : 0,
+           nb_packets ? elapsed / nb_packets : 0,
+           elapsed ? (double)duration * 1000000000. / elapsed : 0.);
+    assert(nb_packets);
+
+    for (unsigned int i = 0; i < NB_PROGRAMS; i++) {
+        for (unsigned int j = 0; j < NB_INPUTS; j++) {
+            upipe_release(inputs[i][j].upipe);
+            ubuf_free(inputs[i][j].payload);
+        }
+        upipe_release(programs[i]);
+    }
+    upipe_release(upipe_ts_mux);
+    sink_free(sink);
+
+    ubuf_mgr_release(ubuf_mgr);
+    uref_mgr_release(uref_mgr);
+    udict_mgr_release(udict_mgr);
+    umem_mgr_release(umem_mgr);
+    uprobe_release(logger);
+
+    return 0;
+}
@@ -0,0 +1,351 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short unit tests for TS mux module with passed-through TS packets
+ */
+
+#undef NDEBUG
+
+#include "upipe/uprobe.h"
+#include "upipe/uprobe_stdio.h"
+#include "upipe/uprobe_prefix.h"
+#include "upipe/uprobe_uref_mgr.h"
+#include "upipe/uprobe_ubuf_mem.h"
+#include "upipe/umem.h"
+#include "upipe/umem_alloc.h"
+#include "upipe/udict.h"
+#include "upipe/udict_inline.h"
+#include "upipe/ubuf.h"
+#include "upipe/ubuf_block_mem.h"
+#include "upipe/uclock.h"
+#include "upipe/uref.h"
+#include "upipe/uref_flow.h"
+#include "upipe/uref_block.h"
+#include "upipe/uref_block_flow.h"
+#include "upipe/uref_pic_flow.h"
+#include "upipe/uref_program_flow.h"
+#include "upipe/uref_void_flow.h"
+#include "upipe/uref_clock.h"
+#include "upipe/uref_std.h"
+#include "upipe/upipe.h"
+#include "upipe-ts/upipe_ts_mux.h"
+#include "upipe-ts/uref_ts_flow.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include <bitstream/mpeg/ts.h>
+#include <bitstream/mpeg/psi.h>
+
+#define UDICT_POOL_DEPTH 0
+#define UREF_POOL_DEPTH 0
+#define UBUF_POOL_DEPTH 0
+#define UPROBE_LOG_LEVEL UPROBE_LOG_DEBUG
+#define OCTETRATE (2000000 / 8)
+#define PACKETS_PER_SEC 500
+#define NB_PACKETS PACKETS_PER_SEC
+#define NB_INPUTS 2
+#define SOURCE_PID 1000
+#define VIDEO_PID 256
+#define AUDIO_PID 257
+
+/** passed-through input */
+struct test_input {
+    /** mux input */
+    struct upipe *upipe;
+    /** PID in the output multiplex */
+    uint16_t pid;
+    /** number of packets received by the sink */
+    unsigned int nb_packets;
+    /** last continuity counter in the output multiplex */
+    uint8_t last_cc;
+};
+
+static struct test_input inputs[NB_INPUTS];
+/** PCR PID announced in the PMT, or 0 */
+static uint16_t pcr_pid = 0;
+
+/** helper phony pipe checking output packets */
+static struct upipe *sink_alloc(struct upipe_mgr *mgr, struct uprobe *uprobe,
+                                uint32_t signature, va_list args)
+{
+    struct upipe *upipe = malloc(sizeof(struct upipe));
+    assert(upipe != NULL);
+    upipe_init(upipe, mgr, uprobe);
+    return upipe;
+}
+
+/** helper phony pipe checking output packets */
+static void sink_packet(uint8_t *buffer)
+{
+    assert(ts_validate(buffer));
+    uint16_t pid = ts_get_pid(buffer);
+
+    if (ts_get_unitstart(buffer) && ts_has_payload(buffer)) {
+        uint8_t *payload = ts_payload(buffer);
+        uint8_t *section = payload + 1 + *payload;
+        if (section < buffer + TS_SIZE &&
+            psi_get_tableid(section) == PMT_TABLE_ID) {
+            uint16_t pmt_pcr_pid = pmt_get_pcrpid(section);
+            assert(!pcr_pid || pcr_pid == pmt_pcr_pid);
+            pcr_pid = pmt_pcr_pid;
+            return;
+        }
+    }
+
+    for (unsigned int i = 0; i < NB_INPUTS; i++) {
+        struct test_input *input = &inputs[i];
+        if (pid != input->pid)
+            continue;
+
+        /* packets are rewritten, not reordered or re-encapsulated */
+        assert(ts_has_payload(buffer));
+        if (input->nb_packets)
+            assert(ts_get_cc(buffer) == ((input->last_cc + 1) & 0xf));
+        input->last_cc = ts_get_cc(buffer);
+        uint8_t *payload = ts_payload(buffer);
+        assert(payload == buffer + TS_HEADER_SIZE);
+        assert(payload[0] == (input->nb_packets & 0xff));
+        assert(payload[1] == i);
+        input->nb_packets++;
+    }
+}
+
+/** helper phony pipe checking output packets */
+static void sink_input(struct upipe *upipe, struct uref *uref,
+                       struct upump **upump_p)
+{
+    size_t size;
+    ubase_assert(uref_block_size(uref, &size));
+    assert(!(size % TS_SIZE));
+    for (size_t offset = 0; offset < size; offset += TS_SIZE) {
+        uint8_t buffer[TS_SIZE];
+        ubase_assert(uref_block_extract(uref, offset, TS_SIZE, buffer));
+        sink_packet(buffer);
+    }
+    uref_free(uref);
+}
+
+/** helper phony pipe checking output packets */
+static int sink_control(struct upipe *upipe, int command, va_list args)
+{
+    switch (command) {
+        case UPIPE_REGISTER_REQUEST: {
+            struct urequest *urequest = va_arg(args, struct urequest *);
+            return upipe_throw_provide_request(upipe, urequest);
+        }
+        case UPIPE_UNREGISTER_REQUEST:
+        case UPIPE_SET_FLOW_DEF:
+            return UBASE_ERR_NONE;
+        default:
+            return UBASE_ERR_UNHANDLED;
+    }
+}
+
+/** helper phony pipe checking output packets */
+static void sink_free(struct upipe *upipe)
+{
+    upipe_clean(upipe);
+    free(upipe);
+}
+
+/** helper phony pipe checking output packets */
+static struct upipe_mgr sink_mgr = {
+    .refcount = NULL,
+    .signature = 0,
+    .upipe_alloc = sink_alloc,
+    .upipe_input = sink_input,
+    .upipe_control = sink_control
+};
+
+/** allocates the flow definition of a passed-through input */
+static struct uref *alloc_passthrough_flow_def(struct uref_mgr *uref_mgr,
+                                               const char *def, uint16_t pid)
+{
+    struct uref *flow_def = uref_block_flow_alloc_def(uref_mgr, def);
+    assert(flow_def != NULL);
+    ubase_assert(uref_block_flow_set_octetrate(flow_def,
+                                               TS_SIZE * PACKETS_PER_SEC));
+    ubase_assert(uref_ts_flow_set_pid(flow_def, pid));
+    return flow_def;
+}
+
+/** allocates the flow definition of an encapsulated input */
+static struct uref *alloc_encaps_flow_def(struct uref_mgr *uref_mgr)
+{
+    struct uref *flow_def = uref_block_flow_alloc_def(uref_mgr,
+                                                      "mpeg2video.pic.");
+    assert(flow_def != NULL);
+    struct urational fps = { .num = 25, .den = 1 };
+    ubase_assert(uref_pic_flow_set_fps(flow_def, fps));
+    ubase_assert(uref_block_flow_set_octetrate(flow_def, OCTETRATE / 4));
+    ubase_assert(uref_block_flow_set_buffer_size(flow_def, OCTETRATE / 8));
+    return flow_def;
+}
+
+/** sends a source TS packet to an input */
+static void send_packet(struct uref_mgr *uref_mgr, struct ubuf_mgr *ubuf_mgr,
+                        unsigned int input, unsigned int n, uint64_t cr)
+{
+    struct uref *uref = uref_block_alloc(uref_mgr, ubuf_mgr, TS_SIZE);
+    assert(uref != NULL);
+    uint8_t *buffer;
+    int size = -1;
+    ubase_assert(uref_block_write(uref, 0, &size, &buffer));
+    assert(size == TS_SIZE);
+    ts_init(buffer);
+    ts_set_pid(buffer, SOURCE_PID + input);
+    ts_set_cc(buffer, n & 0xf);
+    ts_set_payload(buffer);
+    uint8_t *payload = ts_payload(buffer);
+    memset(payload, 0xff, buffer + TS_SIZE - payload);
+    payload[0] = n & 0xff;
+    payload[1] = input;
+    uref_block_unmap(uref, 0);
+
+    uref_clock_set_cr_sys(uref, cr);
+    uref_clock_set_cr_prog(uref, cr);
+    upipe_input(inputs[input].upipe, uref, NULL);
+}
+
+int main(int argc, char **argv)
+{
+    struct umem_mgr *umem_mgr = umem_alloc_mgr_alloc();
+    assert(umem_mgr != NULL);
+    struct udict_mgr *udict_mgr = udict_inline_mgr_alloc(UDICT_POOL_DEPTH,
+                                                         umem_mgr, -1, -1);
+    assert(udict_mgr != NULL);
+    struct uref_mgr *uref_mgr = uref_std_mgr_alloc(UREF_POOL_DEPTH, udict_mgr,
+                                                   0);
+    assert(uref_mgr != NULL);
+    struct ubuf_mgr *ubuf_mgr = ubuf_block_mem_mgr_alloc(UBUF_POOL_DEPTH,
+                                                         UBUF_POOL_DEPTH,
+                                                         umem_mgr, 0, 0, -1, 0);
+    assert(ubuf_mgr != NULL);
+
+    struct uprobe *logger = uprobe_stdio_alloc(NULL, stdout, UPROBE_LOG_LEVEL);
+    assert(logger != NULL);
+    logger = uprobe_uref_mgr_alloc(logger, uref_mgr);
+    assert(logger != NULL);
+    logger = uprobe_ubuf_mem_alloc(logger, umem_mgr, UBUF_POOL_DEPTH,
+                                   UBUF_POOL_DEPTH);
+    assert(logger != NULL);
+
+    struct upipe_mgr *upipe_ts_mux_mgr = upipe_ts_mux_mgr_alloc();
+    assert(upipe_ts_mux_mgr != NULL);
+    struct upipe *upipe_ts_mux = upipe_void_alloc(upipe_ts_mux_mgr,
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL, "ts mux"));
+    assert(upipe_ts_mux != NULL);
+    upipe_mgr_release(upipe_ts_mux_mgr);
+
+    struct upipe *sink = upipe_void_alloc(&sink_mgr, uprobe_use(logger));
+    assert(sink != NULL);
+    ubase_assert(upipe_set_output(upipe_ts_mux, sink));
+
+    struct uref *flow_def = uref_void_flow_alloc_def(uref_mgr);
+    assert(flow_def != NULL);
+    ubase_assert(upipe_set_flow_def(upipe_ts_mux, flow_def));
+    uref_free(flow_def);
+    ubase_assert(upipe_ts_mux_set_mode(upipe_ts_mux,
+                                       UPIPE_TS_MUX_MODE_CAPPED));
+    ubase_assert(upipe_ts_mux_set_octetrate(upipe_ts_mux, OCTETRATE));
+    ubase_assert(upipe_ts_mux_set_cr_prog(upipe_ts_mux, 0));
+
+    /* encapsulated inputs don't accept passed-through packets */
+    flow_def = uref_program_flow_alloc_def(uref_mgr);
+    assert(flow_def != NULL);
+    struct upipe *program = upipe_flow_alloc_sub(upipe_ts_mux,
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                             "encaps program"), flow_def);
+    assert(program != NULL);
+    uref_free(flow_def);
+
+    flow_def = alloc_encaps_flow_def(uref_mgr);
+    struct upipe *encaps_input = upipe_flow_alloc_sub(program,
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                             "encaps input"), flow_def);
+    assert(encaps_input != NULL);
+    uref_free(flow_def);
+
+    struct upipe *input = upipe_void_alloc_sub(program,
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                             "rejected input"));
+    assert(input != NULL);
+    flow_def = alloc_passthrough_flow_def(uref_mgr,
+            "mpegts.mpegtspes.mp2.sound.", AUDIO_PID);
+    assert(!ubase_check(upipe_set_flow_def(input, flow_def)));
+    uref_free(flow_def);
+    upipe_release(input);
+    upipe_release(encaps_input);
+    upipe_release(program);
+
+    /* program made of passed-through packets */
+    flow_def = uref_program_flow_alloc_def(uref_mgr);
+    assert(flow_def != NULL);
+    program = upipe_flow_alloc_sub(upipe_ts_mux,
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                             "passthrough program"), flow_def);
+    assert(program != NULL);
+    uref_free(flow_def);
+
+    inputs[0].pid = VIDEO_PID;
+    flow_def = alloc_passthrough_flow_def(uref_mgr,
+            "mpegts.mpegtspes.mpeg2video.pic.", VIDEO_PID);
+    inputs[0].upipe = upipe_flow_alloc_sub(program,
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                             "video"), flow_def);
+    assert(inputs[0].upipe != NULL);
+    uref_free(flow_def);
+
+    /* the source multiplex carries the PCR on the audio PID, and we cannot
+     * insert PCRs in the video PID */
+    inputs[1].pid = AUDIO_PID;
+    flow_def = alloc_passthrough_flow_def(uref_mgr,
+            "mpegts.mpegtspes.mp2.sound.", AUDIO_PID);
+    ubase_assert(uref_ts_flow_set_passthrough_pcr(flow_def));
+    inputs[1].upipe = upipe_flow_alloc_sub(program,
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                             "audio"), flow_def);
+    assert(inputs[1].upipe != NULL);
+    uref_free(flow_def);
+
+    /* passed-through programs don't accept encapsulated inputs */
+    input = upipe_void_alloc_sub(program,
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                             "rejected input"));
+    assert(input != NULL);
+    flow_def = alloc_encaps_flow_def(uref_mgr);
+    assert(!ubase_check(upipe_set_flow_def(input, flow_def)));
+    uref_free(flow_def);
+    upipe_release(input);
+
+    for (unsigned int n = 0; n < NB_PACKETS; n++)
+        for (unsigned int i = 0; i < NB_INPUTS; i++)
+            send_packet(uref_mgr, ubuf_mgr, i, n,
+                        UCLOCK_FREQ + n * UCLOCK_FREQ / PACKETS_PER_SEC);
+
+    for (unsigned int i = 0; i < NB_INPUTS; i++)
+        upipe_release(inputs[i].upipe);
+    upipe_release(program);
+    upipe_release(upipe_ts_mux);
+    sink_free(sink);
+
+    assert(pcr_pid == AUDIO_PID);
+    for (unsigned int i = 0; i < NB_INPUTS; i++)
+        assert(inputs[i].nb_packets == NB_PACKETS);
+
+    ubuf_mgr_release(ubuf_mgr);
+    uref_mgr_release(uref_mgr);
+    udict_mgr_release(udict_mgr);
+    umem_mgr_release(umem_mgr);
+    uprobe_release(logger);
+
+    return 0;
+}
@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short benchmark for the TS PES decaps module
+ *
+ * This feeds a 50 Mbits/s, 25 fps video elementary stream, cut into TS
+ * payloads as ts_decaps outputs them, to the PES decaps module, and reports
+ * how fast it is decapsulated.
+ *
+ * Usage: upipe_ts_pes_decaps_bench [<duration in seconds>]
+ */
+
+#undef NDEBUG
+
+#include "upipe/uprobe.h"
+#include "upipe/uprobe_stdio.h"
+#include "upipe/uprobe_prefix.h"
+#include "upipe/umem.h"
+#include "upipe/umem_alloc.h"
+#include "upipe/udict.h"
+#include "upipe/udict_inline.h"
+#include "upipe/ubuf.h"
+#include "upipe/ubuf_block_mem.h"
+#include "upipe/uref.h"
+#include "upipe/uref_block.h"
+#include "upipe/uref_block_flow.h"
+#include "upipe/uref_std.h"
+#include "upipe/upipe.h"
+#include "upipe-ts/upipe_ts_pes_decaps.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+
+#include <bitstream/mpeg/ts.h>
+#include <bitstream/mpeg/pes.h>
+
+#define UDICT_POOL_DEPTH 10
+#define UREF_POOL_DEPTH 10
+#define UBUF_POOL_DEPTH 10
+#define UPROBE_LOG_LEVEL UPROBE_LOG_WARNING
+#define OCTETRATE (50000000 / 8)
+#define VIDEO_FPS 25
+#define AU_SIZE (OCTETRATE / VIDEO_FPS)
+#define PES_SIZE (PES_HEADER_SIZE_PTSDTS + AU_SIZE)
+#define PAYLOAD_SIZE (TS_SIZE - TS_HEADER_SIZE)
+#define DURATION 60
+
+static uint64_t nb_octets = 0;
+
+/** helper phony pipe counting output octets */
+static struct upipe *sink_alloc(struct upipe_mgr *mgr, struct uprobe *uprobe,
+                                uint32_t signature, va_list args)
+{
+    struct upipe *upipe = malloc(sizeof(struct upipe));
+    assert(upipe != NULL);
+    upipe_init(upipe, mgr, uprobe);
+    return upipe;
+}
+
+/** helper phony pipe counting output octets */
+static void sink_input(struct upipe *upipe, struct uref *uref,
+                       struct upump **upump_p)
+{
+    size_t size;
+    ubase_assert(uref_block_size(uref, &size));
+    nb_octets += size;
+    uref_free(uref);
+}
+
+/** helper phony pipe counting output octets */
+static int sink_control(struct upipe *upipe, int command, va_list args)
+{
+    switch (command) {
+        case UPIPE_REGISTER_REQUEST: {
+            struct urequest *urequest = va_arg(args, struct urequest *);
+            return upipe_throw_provide_request(upipe, urequest);
+        }
+        case UPIPE_UNREGISTER_REQUEST:
+        case UPIPE_SET_FLOW_DEF:
+            return UBASE_ERR_NONE;
+        default:
+            return UBASE_ERR_UNHANDLED;
+    }
+}
+
+/** helper phony pipe counting output octets */
+static void sink_free(struct upipe *upipe)
+{
+    upipe_clean(upipe);
+    free(upipe);
+}
+
+/** helper phony pipe counting output octets */
+static struct upipe_mgr sink_mgr = {
+    .refcount = NULL,
+    .signature = 0,
+    .upipe_alloc = sink_alloc,
+    .upipe_input = sink_input,
+    .upipe_control = sink_control
+};
+
+int main(int argc, char **argv)
+{
+    uint64_t duration = DURATION;
+    if (argc > 1)
+        duration = strtoull(argv[1], NULL, 10);
+
+    struct umem_mgr *umem_mgr = umem_alloc_mgr_alloc();
+    assert(umem_mgr != NULL);
+    struct udict_mgr *udict_mgr = udict_inline_mgr_alloc(UDICT_POOL_DEPTH,
+                                                         umem_mgr, -1, -1);
+    assert(udict_mgr != NULL);
+    struct uref_mgr *uref_mgr = uref_std_mgr_alloc(UREF_POOL_DEPTH, udict_mgr,
+                                                   0);
+    assert(uref_mgr != NULL);
+    struct ubuf_mgr *ubuf_mgr = ubuf_block_mem_mgr_alloc(UBUF_POOL_DEPTH,
+                                                         UBUF_POOL_DEPTH,
+                                                         umem_mgr, 0, 0, -1, 0);
+    assert(ubuf_mgr != NULL);
+
+    struct uprobe *logger = uprobe_stdio_alloc(NULL, stdout, UPROBE_LOG_LEVEL);
+    assert(logger != NULL);
+
+    struct upipe_mgr *upipe_ts_pesd_mgr = upipe_ts_pesd_mgr_alloc();
+    assert(upipe_ts_pesd_mgr != NULL);
+    struct upipe *upipe_ts_pesd = upipe_void_alloc(upipe_ts_pesd_mgr,
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                             "ts pesd"));
+    assert(upipe_ts_pesd != NULL);
+    upipe_mgr_release(upipe_ts_pesd_mgr);
+
+    struct uref *flow_def = uref_block_flow_alloc_def(uref_mgr,
+                                                      "mpegtspes.");
+    assert(flow_def != NULL);
+    ubase_assert(upipe_set_flow_def(upipe_ts_pesd, flow_def));
+    uref_free(flow_def);
+
+    struct upipe *sink = upipe_void_alloc(&sink_mgr, uprobe_use(logger));
+    assert(sink != NULL);
+    ubase_assert(upipe_set_output(upipe_ts_pesd, sink));
+
+    struct ubuf *pes = ubuf_block_alloc(ubuf_mgr, PES_SIZE);
+    assert(pes != NULL);
+    uint8_t *buffer;
+    int size = -1;
+    ubase_assert(ubuf_block_write(pes, 0, &size, &buffer));
+    assert(size == PES_SIZE);
+    memset(buffer, 0, size);
+    pes_init(buffer);
+    pes_set_streamid(buffer, PES_STREAM_ID_VIDEO_MPEG);
+    pes_set_length(buffer, 0);
+    pes_set_headerlength(buffer, PES_HEADER_SIZE_PTSDTS -
+                                 PES_HEADER_SIZE_NOPTS);
+    pes_set_dataalignment(buffer);
+    ubuf_block_unmap(pes, 0);
+
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    uint64_t nb_packets = 0;
+    uint64_t frames = duration * VIDEO_FPS;
+    for (uint64_t frame = 0; frame < frames; frame++) {
+        uint64_t dts = frame * 90000 / VIDEO_FPS;
+        size = -1;
+        ubase_assert(ubuf_block_write(pes, 0, &size, &buffer));
+        pes_set_pts(buffer, dts + 2 * 90000 / VIDEO_FPS);
+        pes_set_dts(buffer, dts);
+        ubuf_block_unmap(pes, 0);
+
+        for (size_t offset = 0; offset < PES_SIZE; offset += PAYLOAD_SIZE) {
+            size_t chunk = PES_SIZE - offset;
+            if (chunk > PAYLOAD_SIZE)
+                chunk = PAYLOAD_SIZE;
+            struct uref *uref = uref_alloc(uref_mgr);
+            assert(uref != NULL);
+            struct ubuf *ubuf = ubuf_block_splice(pes, offset, chunk);
+            assert(ubuf != NULL);
+            uref_attach_ubuf(uref, ubuf);
+            if (!offset)
+                uref_block_set_start(uref);
+            upipe_input(upipe_ts_pesd, uref, NULL);
+            nb_packets++;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+
+    uint64_t elapsed = (stop.tv_sec - start.tv_sec) * UINT64_C(1000000000) +
+                       stop.tv_nsec - start.tv_nsec;
+    printf("%"PRIu64" s of stream, %"PRIu64" packets in %"PRIu64" ms: "
+           "%"PRIu64" Mbits/s, %"PRIu64" ns/packet, %.1fx real time\n",
+           duration, nb_packets, elapsed / 1000000,
+           elapsed ? nb_octets * 8 * UINT64_C(1000) / elapsed : 0,
+           nb_packets ? elapsed / nb_packets : 0,
+           elapsed ? (double)duration * 1000000000. / elapsed : 0.);
+    assert(nb_octets == frames * AU_SIZE);
+
+    ubuf_free(pes);
+    upipe_release(upipe_ts_pesd);
+    sink_free(sink);
+
+    ubuf_mgr_release(ubuf_mgr);
+    uref_mgr_release(uref_mgr);
+    udict_mgr_release(udict_mgr);
+    umem_mgr_release(umem_mgr);
+    uprobe_release(logger);
+
+    return 0;
+}
@@ -68,6 +68,7 @@ static int catch(struct uprobe *uprobe, struct upipe *upipe,
 struct test {
     uint16_t table_id;
     unsigned int nb_packets;
+    unsigned int expected_packets;
     struct upipe upipe;
 };
 
@@ -80,6 +81,7 @@ static struct upipe *test_alloc(struct upipe_mgr *mgr, struct uprobe *uprobe,
     upipe_init(&test->upipe, mgr, uprobe);
     test->table_id = 0;
     test->nb_packets = 0;
+    test->expected_packets = 1;
     return &test->upipe;
 }
 
@@ -90,6 +92,13 @@ static void test_set_table(struct upipe *upipe, uint16_t table_id)
     test->table_id = table_id;
 }
 
+/** helper phony pipe */
+static void test_set_expected(struct upipe *upipe, unsigned int nb_packets)
+{
+    struct test *test = container_of(upipe, struct test, upipe);
+    test->expected_packets = nb_packets;
+}
+
 /** helper phony pipe */
 static void test_input(struct upipe *upipe, struct uref *uref,
                           struct upump **upump_p)
@@ -125,7 +134,7 @@ static int test_control(struct upipe *upipe, int command, va_list args)
 static void test_free(struct upipe *upipe)
 {
     struct test *test = container_of(upipe, struct test, upipe);
-    assert(test->nb_packets == 1);
+    assert(test->nb_packets == test->expected_packets);
     upipe_clean(upipe);
     free(test);
 }
@@ -138,6 +147,33 @@ static struct upipe_mgr test_mgr = {
     .upipe_control = test_control
 };
 
+/** sends a section of table 70 with the given version and section number,
+ * optionally corrupting its payload after the CRC is computed */
+static void send_section(struct upipe *upipe, struct uref_mgr *uref_mgr,
+                         struct ubuf_mgr *ubuf_mgr, uint8_t version,
+                         uint8_t section, bool corrupt)
+{
+    struct uref *uref = uref_block_alloc(uref_mgr, ubuf_mgr, PSI_MAX_SIZE);
+    assert(uref != NULL);
+    uint8_t *buffer;
+    int size = -1;
+    ubase_assert(uref_block_write(uref, 0, &size, &buffer));
+    assert(size == PSI_MAX_SIZE);
+    memset(buffer, 0, PSI_MAX_SIZE);
+    psi_init(buffer, 1);
+    psi_set_tableid(buffer, 70);
+    psi_set_tableidext(buffer, 70);
+    psi_set_version(buffer, version);
+    psi_set_section(buffer, section);
+    psi_set_lastsection(buffer, 255);
+    psi_set_length(buffer, PSI_MAX_SIZE - PSI_HEADER_SIZE);
+    psi_set_crc(buffer);
+    if (corrupt)
+        buffer[PSI_HEADER_SIZE_SYNTAX1] ^= 0xff;
+    uref_block_unmap(uref, 0);
+    upipe_input(upipe, uref, NULL);
+}
+
 int main(int argc, char *argv[])
 {
     struct umem_mgr *umem_mgr = umem_alloc_mgr_alloc();
@@ -246,13 +282,69 @@ int main(int argc, char *argv[])
     uref_block_unmap(uref, 0);
     upipe_input(upipe_ts_psi_split, uref, NULL);
 
+    /* repetitions of a section are dropped by the cache */
+    ubase_assert(upipe_ts_psi_split_set_cache(upipe_ts_psi_split, true));
+    uref = uref_block_flow_alloc_def(uref_mgr, "mpegtspsi.");
+    assert(uref != NULL);
+    psi_set_tableid(filter, 70);
+    psi_set_tableidext(filter, 70);
+    ubase_assert(uref_ts_flow_set_psi_filter(uref, filter, mask,
+                                       PSI_HEADER_SIZE_SYNTAX1));
+    struct upipe *upipe_sink70 = upipe_void_alloc(&test_mgr,
+                                                  uprobe_use(uprobe_stdio));
+    assert(upipe_sink70 != NULL);
+    test_set_table(upipe_sink70, 70);
+
+    struct upipe *upipe_ts_psi_split_output70 =
+        upipe_flow_alloc_sub(upipe_ts_psi_split,
+                uprobe_pfx_alloc(uprobe_use(uprobe_stdio), UPROBE_LOG_LEVEL,
+                                 "ts psi split output 70"), uref);
+    assert(upipe_ts_psi_split_output70 != NULL);
+    ubase_assert(upipe_set_output(upipe_ts_psi_split_output70, upipe_sink70));
+    uref_free(uref);
+
+    for (int i = 0; i < 3; i++)
+        send_section(upipe_ts_psi_split, uref_mgr, ubuf_mgr, 0, 0, false);
+    uint64_t hits;
+    ubase_assert(upipe_ts_psi_split_get_cache_hits(upipe_ts_psi_split,
+                                                   &hits));
+    assert(hits == 2);
+
+    /* a new version is forwarded, then cached */
+    send_section(upipe_ts_psi_split, uref_mgr, ubuf_mgr, 1, 0, false);
+    send_section(upipe_ts_psi_split, uref_mgr, ubuf_mgr, 1, 0, false);
+    ubase_assert(upipe_ts_psi_split_get_cache_hits(upipe_ts_psi_split,
+                                                   &hits));
+    assert(hits == 3);
+
+    /* a corrupted section is forwarded but not cached, so that it does not
+     * mask the next correct copy */
+    send_section(upipe_ts_psi_split, uref_mgr, ubuf_mgr, 2, 0, true);
+    send_section(upipe_ts_psi_split, uref_mgr, ubuf_mgr, 2, 0, false);
+    send_section(upipe_ts_psi_split, uref_mgr, ubuf_mgr, 2, 0, false);
+    ubase_assert(upipe_ts_psi_split_get_cache_hits(upipe_ts_psi_split,
+                                                   &hits));
+    assert(hits == 4);
+
+    /* the cache grows with the number of sections */
+    for (int i = 1; i < 201; i++)
+        send_section(upipe_ts_psi_split, uref_mgr, ubuf_mgr, 0, i, false);
+    for (int i = 1; i < 201; i++)
+        send_section(upipe_ts_psi_split, uref_mgr, ubuf_mgr, 0, i, false);
+    ubase_assert(upipe_ts_psi_split_get_cache_hits(upipe_ts_psi_split,
+                                                   &hits));
+    assert(hits == 204);
+    test_set_expected(upipe_sink70, 4 + 200);
+
     upipe_release(upipe_ts_psi_split_output68);
     upipe_release(upipe_ts_psi_split_output69);
+    upipe_release(upipe_ts_psi_split_output70);
     upipe_release(upipe_ts_psi_split);
     upipe_mgr_release(upipe_ts_psi_split_mgr); // nop
 
     test_free(upipe_sink68);
     test_free(upipe_sink69);
+    test_free(upipe_sink70);
 
     uref_mgr_release(uref_mgr);
     ubuf_mgr_release(ubuf_mgr);
@@ -22,6 +22,7 @@
 #include "upipe/ubuf.h"
 #include "upipe/ubuf_block_mem.h"
 #include "upipe/uref.h"
+#include "upipe/uref_flow.h"
 #include "upipe/uref_block_flow.h"
 #include "upipe/uref_block.h"
 #include "upipe/uref_std.h"
@@ -74,6 +75,9 @@ static int catch(struct uprobe *uprobe, struct upipe *upipe,
 struct test {
     uint16_t pid;
     bool got_packet;
+    unsigned int nb_packets;
+    unsigned int nb_urefs;
+    const struct uref *last_uref;
     struct upipe upipe;
 };
 
@@ -88,6 +92,9 @@ static struct upipe *test_alloc(struct upipe_mgr *mgr, struct uprobe *uprobe,
     assert(test != NULL);
     upipe_init(&test->upipe, mgr, uprobe);
     test->got_packet = false;
+    test->nb_packets = 0;
+    test->nb_urefs = 0;
+    test->last_uref = NULL;
     test->pid = pid;
     return &test->upipe;
 }
@@ -99,13 +106,21 @@ static void test_input(struct upipe *upipe, struct uref *uref,
     struct test *test = container_of(upipe, struct test, upipe);
     assert(uref != NULL);
     test->got_packet = true;
-    const uint8_t *buffer;
-    int size = -1;
-    ubase_assert(uref_block_read(uref, 0, &size, &buffer));
-    assert(size == TS_SIZE); //because of the way we allocated it
-    assert(ts_validate(buffer));
-    assert(ts_get_pid(buffer) == test->pid);
-    uref_block_unmap(uref, 0);
+    size_t uref_size;
+    ubase_assert(uref_block_size(uref, &uref_size));
+    assert(uref_size && !(uref_size % TS_SIZE));
+    for (int offset = 0; offset < uref_size; offset += TS_SIZE) {
+        const uint8_t *buffer;
+        int size = TS_SIZE;
+        ubase_assert(uref_block_read(uref, offset, &size, &buffer));
+        assert(size == TS_SIZE); //because of the way we allocated it
+        assert(ts_validate(buffer));
+        assert(ts_get_pid(buffer) == test->pid);
+        uref_block_unmap(uref, offset);
+        test->nb_packets++;
+    }
+    test->nb_urefs++;
+    test->last_uref = uref;
     uref_free(uref);
 }
 
@@ -203,7 +218,22 @@ int main(int argc, char *argv[])
     ts_pad(buffer);
     ts_set_pid(buffer, 68);
     uref_block_unmap(uref, 0);
+    const struct uref *input = uref;
+    upipe_input(upipe_ts_split, uref, NULL);
+    /* a single output receives the original uref */
+    assert(container_of(upipe_sink68, struct test, upipe)->last_uref == input);
+
+    /* unwanted PIDs are dropped */
+    uref = uref_block_alloc(uref_mgr, ubuf_mgr, TS_SIZE);
+    assert(uref != NULL);
+    size = -1;
+    ubase_assert(uref_block_write(uref, 0, &size, &buffer));
+    assert(size == TS_SIZE);
+    ts_pad(buffer);
+    ts_set_pid(buffer, 70);
+    uref_block_unmap(uref, 0);
     upipe_input(upipe_ts_split, uref, NULL);
+    assert(container_of(upipe_sink68, struct test, upipe)->nb_urefs == 1);
 
     uref = uref_block_alloc(uref_mgr, ubuf_mgr, TS_SIZE);
     assert(uref != NULL);
@@ -215,6 +245,80 @@ int main(int argc, char *argv[])
     uref_block_unmap(uref, 0);
     upipe_input(upipe_ts_split, uref, NULL);
 
+    upipe_release(upipe_ts_split_output68);
+    upipe_release(upipe_ts_split_output69);
+    upipe_release(upipe_ts_split);
+
+    test_free(upipe_sink68);
+    test_free(upipe_sink69);
+
+    /* vectors of aligned packets */
+    uref = uref_block_flow_alloc_def(uref_mgr, "mpegtsaligned.");
+    assert(uref != NULL);
+    upipe_ts_split = upipe_void_alloc(upipe_ts_split_mgr,
+            uprobe_pfx_alloc(uprobe_use(uprobe_stdio), UPROBE_LOG_LEVEL,
+                             "ts split aligned"));
+    assert(upipe_ts_split != NULL);
+    ubase_assert(upipe_set_flow_def(upipe_ts_split, uref));
+
+    /* PID 68 receives vectors, PID 69 single packets */
+    ubase_assert(uref_ts_flow_set_pid(uref, 68));
+    upipe_sink68 = upipe_flow_alloc(&test_mgr, uprobe_use(uprobe_stdio), uref);
+    assert(upipe_sink68 != NULL);
+    upipe_ts_split_output68 = upipe_flow_alloc_sub(upipe_ts_split,
+            uprobe_pfx_alloc(uprobe_use(uprobe_stdio), UPROBE_LOG_LEVEL,
+                             "ts split output 68"), uref);
+    assert(upipe_ts_split_output68 != NULL);
+    ubase_assert(upipe_set_output(upipe_ts_split_output68, upipe_sink68));
+
+    ubase_assert(uref_flow_set_def(uref, "block.mpegts."));
+    ubase_assert(uref_ts_flow_set_pid(uref, 69));
+    upipe_sink69 = upipe_flow_alloc(&test_mgr, uprobe_use(uprobe_stdio), uref);
+    assert(upipe_sink69 != NULL);
+    upipe_ts_split_output69 = upipe_flow_alloc_sub(upipe_ts_split,
+            uprobe_pfx_alloc(uprobe_use(uprobe_stdio), UPROBE_LOG_LEVEL,
+                             "ts split output 69"), uref);
+    assert(upipe_ts_split_output69 != NULL);
+    ubase_assert(upipe_set_output(upipe_ts_split_output69, upipe_sink69));
+    uref_free(uref);
+
+    static const uint16_t pids[] = { 68, 68, 69, 68, 69 };
+    uref = uref_block_alloc(uref_mgr, ubuf_mgr, 5 * TS_SIZE);
+    assert(uref != NULL);
+    size = -1;
+    ubase_assert(uref_block_write(uref, 0, &size, &buffer));
+    assert(size == 5 * TS_SIZE);
+    for (int i = 0; i < 5; i++) {
+        ts_pad(buffer + i * TS_SIZE);
+        ts_set_pid(buffer + i * TS_SIZE, pids[i]);
+    }
+    uref_block_unmap(uref, 0);
+    upipe_input(upipe_ts_split, uref, NULL);
+
+    struct test *test68 = container_of(upipe_sink68, struct test, upipe);
+    struct test *test69 = container_of(upipe_sink69, struct test, upipe);
+    assert(test68->nb_packets == 3);
+    assert(test68->nb_urefs == 1);
+    assert(test69->nb_packets == 2);
+    assert(test69->nb_urefs == 2);
+
+    /* a vector entirely for one output is forwarded as is */
+    uref = uref_block_alloc(uref_mgr, ubuf_mgr, 3 * TS_SIZE);
+    assert(uref != NULL);
+    size = -1;
+    ubase_assert(uref_block_write(uref, 0, &size, &buffer));
+    assert(size == 3 * TS_SIZE);
+    for (int i = 0; i < 3; i++) {
+        ts_pad(buffer + i * TS_SIZE);
+        ts_set_pid(buffer + i * TS_SIZE, 68);
+    }
+    uref_block_unmap(uref, 0);
+    input = uref;
+    upipe_input(upipe_ts_split, uref, NULL);
+    assert(test68->nb_packets == 6);
+    assert(test68->nb_urefs == 2);
+    assert(test68->last_uref == input);
+
     upipe_release(upipe_ts_split_output68);
     upipe_release(upipe_ts_split_output69);
     upipe_release(upipe_ts_split);
@@ -22,6 +22,7 @@
 #include "upipe/ubuf.h"
 #include "upipe/ubuf_block_mem.h"
 #include "upipe/uref.h"
+#include "upipe/uref_flow.h"
 #include "upipe/uref_block_flow.h"
 #include "upipe/uref_block.h"
 #include "upipe/uref_std.h"
@@ -30,6 +31,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 
 #include <bitstream/mpeg/ts.h>
@@ -39,7 +41,9 @@
 #define UBUF_POOL_DEPTH 0
 #define UPROBE_LOG_LEVEL UPROBE_LOG_DEBUG
 
+static size_t packet_size = TS_SIZE;
 static unsigned int nb_packets = 0;
+static unsigned int nb_urefs = 0;
 static int expect_loss = -1;
 
 /** definition of our uprobe */
@@ -79,16 +83,20 @@ static void test_input(struct upipe *upipe, struct uref *uref,
     assert(uref != NULL);
     size_t size;
     ubase_assert(uref_block_size(uref, &size));
-    assert(size == TS_SIZE);
+    assert(size && !(size % packet_size));
 
-    const uint8_t *buffer;
-    int rsize = 1;
-    ubase_assert(uref_block_read(uref, 0, &rsize, &buffer));
-    assert(rsize == 1);
-    assert(ts_validate(buffer));
-    uref_block_unmap(uref, 0);
+    for (int offset = 0; offset < size; offset += packet_size) {
+        const uint8_t *buffer;
+        int rsize = 1;
+        ubase_assert(uref_block_read(uref, offset, &rsize, &buffer));
+        assert(rsize == 1);
+        assert(ts_validate(buffer));
+        uref_block_unmap(uref, offset);
+        assert(nb_packets);
+        nb_packets--;
+    }
     uref_free(uref);
-    nb_packets--;
+    nb_urefs++;
 }
 
 /** helper phony pipe */
@@ -118,6 +126,25 @@ static struct upipe_mgr test_mgr = {
     .upipe_control = test_control
 };
 
+/** sends a copy of a buffer, in urefs of at most chunk octets */
+static void send_buffer(struct upipe *upipe, struct uref_mgr *uref_mgr,
+                        struct ubuf_mgr *ubuf_mgr, const uint8_t *data,
+                        size_t size, size_t chunk)
+{
+    for (size_t offset = 0; offset < size; offset += chunk) {
+        int wanted = size - offset < chunk ? size - offset : chunk;
+        struct uref *uref = uref_block_alloc(uref_mgr, ubuf_mgr, wanted);
+        assert(uref != NULL);
+        uint8_t *buffer;
+        int bsize = -1;
+        ubase_assert(uref_block_write(uref, 0, &bsize, &buffer));
+        assert(bsize == wanted);
+        memcpy(buffer, data + offset, wanted);
+        uref_block_unmap(uref, 0);
+        upipe_input(upipe, uref, NULL);
+    }
+}
+
 int main(int argc, char *argv[])
 {
     struct umem_mgr *umem_mgr = umem_alloc_mgr_alloc();
@@ -216,6 +243,114 @@ int main(int argc, char *argv[])
     ubase_assert(upipe_ts_sync_get_sync(upipe_ts_sync, &sync));
     assert(sync == 4);
 
+    nb_packets++;
+    upipe_release(upipe_ts_sync);
+    assert(!nb_packets);
+
+    /* batch mode */
+    uref = uref_block_flow_alloc_def(uref_mgr, NULL);
+    assert(uref != NULL);
+    upipe_ts_sync = upipe_void_alloc(upipe_ts_sync_mgr,
+            uprobe_pfx_alloc(uprobe_use(uprobe_stdio), UPROBE_LOG_LEVEL,
+                             "ts sync batch"));
+    assert(upipe_ts_sync != NULL);
+    ubase_assert(upipe_ts_sync_set_batch(upipe_ts_sync, 4));
+    unsigned int batch;
+    ubase_assert(upipe_ts_sync_get_batch(upipe_ts_sync, &batch));
+    assert(batch == 4);
+    ubase_assert(upipe_set_flow_def(upipe_ts_sync, uref));
+    ubase_assert(upipe_set_output(upipe_ts_sync, upipe_sink));
+    uref_free(uref);
+
+    const char *def;
+    ubase_assert(upipe_get_flow_def(upipe_ts_sync, &uref));
+    ubase_assert(uref_flow_get_def(uref, &def));
+    assert(!strcmp(def, "block.mpegtsaligned."));
+
+    uref = uref_block_alloc(uref_mgr, ubuf_mgr, 6 * TS_SIZE);
+    assert(uref != NULL);
+    size = -1;
+    ubase_assert(uref_block_write(uref, 0, &size, &buffer));
+    assert(size == 6 * TS_SIZE);
+    for (int i = 0; i < 6; i++)
+        ts_pad(buffer + i * TS_SIZE);
+    uref_block_unmap(uref, 0);
+    /* 4 + 1 packets, the last one waits for the next sync word */
+    nb_packets += 5;
+    nb_urefs = 0;
+    upipe_input(upipe_ts_sync, uref, NULL);
+    assert(!nb_packets);
+    assert(nb_urefs == 2);
+
+    nb_packets++;
+    upipe_release(upipe_ts_sync);
+    assert(!nb_packets);
+
+    /* 204-octet packets, after junk and across segments */
+    uref = uref_block_flow_alloc_def(uref_mgr, NULL);
+    assert(uref != NULL);
+    upipe_ts_sync = upipe_void_alloc(upipe_ts_sync_mgr,
+            uprobe_pfx_alloc(uprobe_use(uprobe_stdio), UPROBE_LOG_LEVEL,
+                             "ts sync 204"));
+    assert(upipe_ts_sync != NULL);
+    ubase_assert(upipe_set_output_size(upipe_ts_sync, 204));
+    ubase_assert(upipe_set_flow_def(upipe_ts_sync, uref));
+    ubase_assert(upipe_set_output(upipe_ts_sync, upipe_sink));
+    uref_free(uref);
+
+    uint8_t stream[12 * 204 + 1000];
+    memset(stream, 0, 57);
+    stream[3] = 0x47;
+    for (int i = 0; i < 6; i++) {
+        uint8_t *packet = stream + 57 + i * 204;
+        ts_pad(packet);
+        for (int j = 0; j < 16; j++)
+            packet[TS_SIZE + j] = j;
+    }
+    packet_size = 204;
+    /* the last packet waits for the next sync word */
+    nb_packets += 5;
+    send_buffer(upipe_ts_sync, uref_mgr, ubuf_mgr, stream, 57 + 6 * 204, 500);
+    assert(!nb_packets);
+
+    nb_packets++;
+    upipe_release(upipe_ts_sync);
+    assert(!nb_packets);
+    packet_size = TS_SIZE;
+
+    /* resync after noise full of sync words */
+    uref = uref_block_flow_alloc_def(uref_mgr, NULL);
+    assert(uref != NULL);
+    upipe_ts_sync = upipe_void_alloc(upipe_ts_sync_mgr,
+            uprobe_pfx_alloc(uprobe_use(uprobe_stdio), UPROBE_LOG_LEVEL,
+                             "ts sync noise"));
+    assert(upipe_ts_sync != NULL);
+    ubase_assert(upipe_set_flow_def(upipe_ts_sync, uref));
+    ubase_assert(upipe_set_output(upipe_ts_sync, upipe_sink));
+    uref_free(uref);
+
+    for (int i = 0; i < 10; i++)
+        ts_pad(stream + i * TS_SIZE);
+    nb_packets += 9;
+    expect_loss = -1;
+    send_buffer(upipe_ts_sync, uref_mgr, ubuf_mgr, stream, 10 * TS_SIZE,
+                10 * TS_SIZE);
+    assert(!nb_packets);
+
+    /* never two sync words one packet apart, in the noise or across it */
+    for (int i = 0; i < 1000; i++)
+        stream[i] = i % 7 == 3 ? 0x47 : i * 13 % 71;
+    expect_loss = 0;
+    send_buffer(upipe_ts_sync, uref_mgr, ubuf_mgr, stream, 1000, 1000);
+    assert(!nb_packets);
+
+    for (int i = 0; i < 10; i++)
+        ts_pad(stream + i * TS_SIZE);
+    nb_packets += 9;
+    send_buffer(upipe_ts_sync, uref_mgr, ubuf_mgr, stream, 10 * TS_SIZE,
+                3 * TS_SIZE + 5);
+    assert(!nb_packets);
+
     nb_packets++;
     upipe_release(upipe_ts_sync);
     assert(!nb_packets);
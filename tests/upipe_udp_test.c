@@ -45,6 +45,8 @@
 #include <unistd.h>
 #include <assert.h>
 #include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
 #include <netdb.h>
 
 #define UDICT_POOL_DEPTH 0
@@ -56,6 +58,7 @@
 #define UPROBE_LOG_LEVEL UPROBE_LOG_DEBUG
 #define BUF_SIZE 256
 #define FORMAT "This is packet number %d"
+#define HELD_MAX 100
 
 /* FIXME: uncomment or remove */
 /*static void usage(const char *argv0) {
@@ -79,6 +82,35 @@ struct upipe *upipe_udpsrc;
 struct upipe *upipe_udpsink;
 static int counter = 0;
 
+/** datagram sizes sent in exact-size mode */
+#define EXACT_SIZE(counter) (32 + ((counter) % 8) * 16)
+
+/** umem manager allocating buffers */
+static struct umem_mgr *umem_mgr;
+/** largest buffer allocated since the last reset */
+static size_t umem_max_size = 0;
+/** number of buffers allocated since the last reset */
+static unsigned int umem_nb_alloc = 0;
+
+/** helper umem manager recording the size of allocated buffers */
+static bool test_umem_alloc(struct umem_mgr *mgr, struct umem *umem,
+                            size_t size)
+{
+    if (size > umem_max_size)
+        umem_max_size = size;
+    umem_nb_alloc++;
+    return umem_alloc(umem_mgr, umem, size);
+}
+
+/** helper umem manager recording the size of allocated buffers */
+static struct umem_mgr test_umem_mgr = {
+    .refcount = NULL,
+    .umem_alloc = test_umem_alloc,
+    .umem_realloc = NULL,
+    .umem_free = NULL,
+    .umem_mgr_vacuum = NULL
+};
+
 /** definition of our uprobe */
 static int catch(struct uprobe *uprobe, struct upipe *upipe,
                  int event, va_list args)
@@ -101,6 +133,16 @@ static int catch(struct uprobe *uprobe, struct upipe *upipe,
 struct udpsrc_test {
     int counter;
     struct uref *flow;
+    /** true if the size of datagrams must match @ref EXACT_SIZE */
+    bool exact;
+    /** true if received urefs are held until the end of the test */
+    bool hold;
+    /** held urefs */
+    struct uref *held[HELD_MAX];
+    /** number of held urefs */
+    int nb_held;
+    /** counter of the first held uref */
+    int held_counter;
     struct upipe upipe;
 };
 
@@ -115,6 +157,10 @@ static struct upipe *test_alloc(struct upipe_mgr *mgr, struct uprobe *uprobe,
     assert(udpsrc_test != NULL);
     udpsrc_test->flow = NULL;
     udpsrc_test->counter = 0;
+    udpsrc_test->exact = false;
+    udpsrc_test->hold = false;
+    udpsrc_test->nb_held = 0;
+    udpsrc_test->held_counter = 0;
     upipe_init(&udpsrc_test->upipe, mgr, uprobe);
     upipe_throw_ready(&udpsrc_test->upipe);
     return &udpsrc_test->upipe;
@@ -129,6 +175,12 @@ static void test_input(struct upipe *upipe, struct uref *uref,
     struct udpsrc_test *udpsrc_test = udpsrc_test_from_upipe(upipe);
     assert(uref != NULL);
 
+    if (udpsrc_test->exact) {
+        size_t size;
+        ubase_assert(uref_block_size(uref, &size));
+        assert(size == EXACT_SIZE(udpsrc_test->counter));
+    }
+
     if ((rbuf = uref_block_peek(uref, 0, -1, buf))) {
         upipe_dbg_va(upipe, "Received string: %s", rbuf);
         snprintf((char *)str, sizeof(str), FORMAT, udpsrc_test->counter);
@@ -136,13 +188,42 @@ static void test_input(struct upipe *upipe, struct uref *uref,
         udpsrc_test->counter++;
         uref_block_peek_unmap(uref, 0, buf, rbuf);
     }
-    if (udpsrc_test->counter == 110 || udpsrc_test->counter == 210) {
+    if (udpsrc_test->counter > 100 && udpsrc_test->counter % 100 == 10) {
         upipe_set_uri(upipe_udpsrc, NULL);
     }
 
+    if (udpsrc_test->hold && udpsrc_test->nb_held < HELD_MAX) {
+        if (!udpsrc_test->nb_held)
+            udpsrc_test->held_counter = udpsrc_test->counter - 1;
+        udpsrc_test->held[udpsrc_test->nb_held++] = uref;
+        return;
+    }
     uref_free(uref);
 }
 
+/** helper phony pipe */
+static void test_check_held(struct upipe *upipe)
+{
+    uint8_t buf[BUF_SIZE], str[BUF_SIZE];
+    const uint8_t *rbuf;
+    struct udpsrc_test *udpsrc_test = udpsrc_test_from_upipe(upipe);
+    assert(udpsrc_test->nb_held == HELD_MAX);
+
+    /* datagrams received later must not have overwritten held ones */
+    for (int i = 0; i < udpsrc_test->nb_held; i++) {
+        struct uref *uref = udpsrc_test->held[i];
+        rbuf = uref_block_peek(uref, 0, -1, buf);
+        assert(rbuf != NULL);
+        snprintf((char *)str, sizeof(str), FORMAT,
+                 udpsrc_test->held_counter + i);
+        assert(strncmp((char *)str, (char *)rbuf, BUF_SIZE) == 0);
+        uref_block_peek_unmap(uref, 0, buf, rbuf);
+        uref_free(uref);
+    }
+    udpsrc_test->nb_held = 0;
+    udpsrc_test->hold = false;
+}
+
 /** helper phony pipe */
 static int test_control(struct upipe *upipe, int command, va_list args)
 {
@@ -225,6 +306,83 @@ static void genpackets2(struct upump *upump)
     }
 }
 
+/* packet generator of datagrams of various sizes */
+static void genpackets3(struct upump *upump)
+{
+    struct uref *uref;
+    uint8_t *buf;
+    int i, size;
+
+    printf("Counter: %d\n", counter);
+    if (counter > 300) {
+        upump_stop(write_pump);
+        return;
+    }
+
+    for (i=0; i < 10; i++) {
+        size = -1;
+        uref = uref_block_alloc(uref_mgr, ubuf_mgr, EXACT_SIZE(counter));
+        uref_block_write(uref, 0, &size, &buf);
+        assert(size == EXACT_SIZE(counter));
+        memset(buf, 0, size);
+        snprintf((char *)buf, size, FORMAT, counter);
+        uref_block_unmap(uref, 0);
+        counter++;
+        upipe_input(upipe_udpsink, uref, NULL);
+    }
+}
+
+/* packet generator of coalesced datagrams */
+static void genpackets4(struct upump *upump)
+{
+    uint8_t buf[10 * BUF_SIZE];
+    int i;
+
+    printf("Counter: %d\n", counter);
+    if (counter > 400) {
+        upump_stop(write_pump);
+        return;
+    }
+
+    memset(buf, 0, sizeof(buf));
+    for (i=0; i < 10; i++)
+        snprintf((char *)buf + i * BUF_SIZE, BUF_SIZE, FORMAT, counter + i);
+
+#ifdef UDP_SEGMENT
+    /* send 10 datagrams in a single buffer, so that the loopback interface
+     * hands them coalesced to the UDP_GRO socket */
+    struct iovec iov = { .iov_base = buf, .iov_len = sizeof(buf) };
+    union {
+        char buf[CMSG_SPACE(sizeof(uint16_t))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct msghdr msg = {
+        .msg_name = p->ai_addr,
+        .msg_namelen = p->ai_addrlen,
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control.buf,
+        .msg_controllen = sizeof(control.buf),
+    };
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    uint16_t gso_size = BUF_SIZE;
+    memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+    if (sendmsg(sockfd, &msg, 0) == sizeof(buf)) {
+        counter += 10;
+        return;
+    }
+#endif
+    for (i=0; i < 10; i++) {
+        sendto(sockfd, buf + i * BUF_SIZE, BUF_SIZE, 0,
+               p->ai_addr, p->ai_addrlen);
+        counter++;
+    }
+}
+
 int main(int argc, char *argv[])
 {
     char udp_uri[512], port_str[8];
@@ -232,7 +390,7 @@ int main(int argc, char *argv[])
     bool ret;
 
     /* env */
-    struct umem_mgr *umem_mgr = umem_alloc_mgr_alloc();
+    umem_mgr = umem_alloc_mgr_alloc();
     assert(umem_mgr != NULL);
     struct udict_mgr *udict_mgr = udict_inline_mgr_alloc(UDICT_POOL_DEPTH,
                                                          umem_mgr, -1, -1);
@@ -258,7 +416,7 @@ int main(int argc, char *argv[])
     assert(logger != NULL);
     logger = uprobe_uclock_alloc(logger, uclock);
     assert(logger != NULL);
-    logger = uprobe_ubuf_mem_alloc(logger, umem_mgr, UBUF_POOL_DEPTH,
+    logger = uprobe_ubuf_mem_alloc(logger, &test_umem_mgr, UBUF_POOL_DEPTH,
                                    UBUF_POOL_DEPTH);
     assert(logger != NULL);
 
@@ -340,6 +498,14 @@ int main(int argc, char *argv[])
     assert(ret);
     ubase_assert(upipe_set_uri(upipe_udpsink, udp_uri+1));
 
+    /* receive into slabs shared by several datagrams, and hold them while
+     * the following datagrams are received */
+    unsigned int slab_size;
+    ubase_assert(upipe_udpsrc_set_slab_size(upipe_udpsrc, 4 * READ_SIZE));
+    ubase_assert(upipe_udpsrc_get_slab_size(upipe_udpsrc, &slab_size));
+    assert(slab_size == 4 * READ_SIZE);
+    udpsrc_test_from_upipe(udpsrc_test)->hold = true;
+
     /* redefine write pump */
     write_pump = upump_alloc_idler(upump_mgr, genpackets2, NULL, NULL);
     assert(write_pump);
@@ -348,6 +514,65 @@ int main(int argc, char *argv[])
     /* fire again */
     upump_mgr_run(upump_mgr, NULL);
 
+    assert(udpsrc_test_from_upipe(udpsrc_test)->counter == 210);
+    test_check_held(udpsrc_test);
+    upump_free(write_pump);
+
+    /* allocate buffers of the size of each datagram */
+    bool exact_size;
+    ubase_assert(upipe_udpsrc_set_slab_size(upipe_udpsrc, 0));
+    ubase_assert(upipe_udpsrc_set_exact_size(upipe_udpsrc, true));
+    ubase_assert(upipe_udpsrc_get_exact_size(upipe_udpsrc, &exact_size));
+    assert(exact_size);
+    ubase_assert(upipe_set_uri(upipe_udpsrc, udp_uri));
+    udpsrc_test_from_upipe(udpsrc_test)->exact = true;
+    umem_max_size = 0;
+
+    write_pump = upump_alloc_idler(upump_mgr, genpackets3, NULL, NULL);
+    assert(write_pump);
+    upump_start(write_pump);
+
+    upump_mgr_run(upump_mgr, NULL);
+
+    assert(udpsrc_test_from_upipe(udpsrc_test)->counter == 310);
+    assert(umem_max_size && umem_max_size < READ_SIZE);
+    udpsrc_test_from_upipe(udpsrc_test)->exact = false;
+    ubase_assert(upipe_udpsrc_set_exact_size(upipe_udpsrc, false));
+    upump_free(write_pump);
+
+    /* receive coalesced datagrams, and hold them */
+    bool gro;
+    ubase_assert(upipe_set_uri(upipe_udpsrc, udp_uri));
+    if (!ubase_check(upipe_udpsrc_set_gro(upipe_udpsrc, true)))
+        printf("UDP_GRO is not supported\n");
+    ubase_assert(upipe_udpsrc_get_gro(upipe_udpsrc, &gro));
+    udpsrc_test_from_upipe(udpsrc_test)->hold = true;
+    umem_nb_alloc = 0;
+
+    snprintf(port_str, sizeof(port_str), "%s", strrchr(udp_uri, ':') + 1);
+    freeaddrinfo(servinfo);
+    assert(getaddrinfo("127.0.0.1", port_str, &hints, &servinfo) == 0);
+    for (p = servinfo; p != NULL; p = p->ai_next) {
+        if (( sockfd = socket(p->ai_family, p->ai_socktype, p->ai_protocol)) == -1) {
+            continue;
+        }
+        break;
+    }
+    assert(p);
+
+    write_pump = upump_alloc_idler(upump_mgr, genpackets4, NULL, NULL);
+    assert(write_pump);
+    upump_start(write_pump);
+
+    upump_mgr_run(upump_mgr, NULL);
+
+    assert(udpsrc_test_from_upipe(udpsrc_test)->counter == 410);
+    test_check_held(udpsrc_test);
+    /* datagrams are packed into slabs instead of a buffer per reception */
+    if (gro)
+        assert(umem_nb_alloc <= 2);
+    close(sockfd);
+
     /* release */
     upump_free(write_pump);
     upipe_release(upipe_udpsrc);
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short unit tests for xdp sink pipe
+ *
+ * The sink is only opened on queues that cannot exist, so that the test
+ * checks the error paths without requiring an AF_XDP capable interface.
+ */
+
+#undef NDEBUG
+
+#include "upipe/uprobe.h"
+#include "upipe/uprobe_stdio.h"
+#include "upipe/uprobe_prefix.h"
+#include "upipe/uprobe_uref_mgr.h"
+#include "upipe/uprobe_upump_mgr.h"
+#include "upipe/umem.h"
+#include "upipe/umem_alloc.h"
+#include "upipe/udict.h"
+#include "upipe/udict_inline.h"
+#include "upipe/ubuf.h"
+#include "upipe/ubuf_block_mem.h"
+#include "upipe/uref.h"
+#include "upipe/uref_block.h"
+#include "upipe/uref_block_flow.h"
+#include "upipe/uref_std.h"
+#include "upipe/upump.h"
+#include "upump-ev/upump_ev.h"
+#include "upipe/upipe.h"
+#include "upipe-xdp/upipe_xdp_sink.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#define UDICT_POOL_DEPTH 0
+#define UREF_POOL_DEPTH 0
+#define UBUF_POOL_DEPTH 0
+#define UPUMP_POOL 0
+#define UPUMP_BLOCKER_POOL 0
+#define UPROBE_LOG_LEVEL UPROBE_LOG_DEBUG
+#define PAYLOAD_SIZE 188
+
+/** definition of our uprobe */
+static int catch(struct uprobe *uprobe, struct upipe *upipe,
+                 int event, va_list args)
+{
+    switch (event) {
+        default:
+            assert(0);
+            break;
+        case UPROBE_READY:
+        case UPROBE_DEAD:
+        case UPROBE_LOG:
+            break;
+    }
+    return UBASE_ERR_NONE;
+}
+
+/** checks that setting the given uri fails and leaves the sink closed */
+static void test_uri(struct upipe *upipe, const char *uri, int expected)
+{
+    const char *current = uri;
+    assert(upipe_set_uri(upipe, uri) == expected);
+    ubase_assert(upipe_get_uri(upipe, &current));
+    assert(current == NULL);
+}
+
+int main(int argc, char *argv[])
+{
+    struct umem_mgr *umem_mgr = umem_alloc_mgr_alloc();
+    assert(umem_mgr != NULL);
+    struct udict_mgr *udict_mgr = udict_inline_mgr_alloc(UDICT_POOL_DEPTH,
+                                                         umem_mgr, -1, -1);
+    assert(udict_mgr != NULL);
+    struct uref_mgr *uref_mgr = uref_std_mgr_alloc(UREF_POOL_DEPTH, udict_mgr,
+                                                   0);
+    assert(uref_mgr != NULL);
+    struct ubuf_mgr *ubuf_mgr = ubuf_block_mem_mgr_alloc(UBUF_POOL_DEPTH,
+                                                         UBUF_POOL_DEPTH,
+                                                         umem_mgr, 0, 0, -1,
+                                                         0);
+    assert(ubuf_mgr != NULL);
+    struct upump_mgr *upump_mgr = upump_ev_mgr_alloc_default(UPUMP_POOL,
+                                                             UPUMP_BLOCKER_POOL);
+    assert(upump_mgr != NULL);
+
+    struct uprobe uprobe;
+    uprobe_init(&uprobe, catch, NULL);
+    struct uprobe *logger = uprobe_stdio_alloc(&uprobe, stdout,
+                                               UPROBE_LOG_LEVEL);
+    assert(logger != NULL);
+    logger = uprobe_uref_mgr_alloc(logger, uref_mgr);
+    assert(logger != NULL);
+    logger = uprobe_upump_mgr_alloc(logger, upump_mgr);
+    assert(logger != NULL);
+
+    struct upipe_mgr *upipe_xdp_sink_mgr = upipe_xdp_sink_mgr_alloc();
+    assert(upipe_xdp_sink_mgr != NULL);
+    struct upipe *upipe_xdp_sink = upipe_void_alloc(upipe_xdp_sink_mgr,
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                             "xdp sink"));
+    assert(upipe_xdp_sink != NULL);
+
+    struct uref *flow_def = uref_block_flow_alloc_def(uref_mgr, NULL);
+    assert(flow_def != NULL);
+    ubase_assert(upipe_set_flow_def(upipe_xdp_sink, flow_def));
+    uref_free(flow_def);
+
+    /* malformed uris */
+    test_uri(upipe_xdp_sink, "lo", UBASE_ERR_INVALID);
+    test_uri(upipe_xdp_sink, "@239.0.0.1:1234", UBASE_ERR_INVALID);
+    test_uri(upipe_xdp_sink, "lo@239.0.0.1", UBASE_ERR_INVALID);
+    test_uri(upipe_xdp_sink, "lo@239.0.0.1:1234/src=foo", UBASE_ERR_INVALID);
+    test_uri(upipe_xdp_sink, "lo@239.0.0.1:1234/dmac=zz", UBASE_ERR_INVALID);
+    test_uri(upipe_xdp_sink, "lo@127.0.0.1:1234", UBASE_ERR_INVALID);
+
+    /* nonexistent interface */
+    test_uri(upipe_xdp_sink, "upipe-nonexist@239.0.0.1:1234",
+             UBASE_ERR_EXTERNAL);
+
+    /* the AF_XDP socket cannot be created on a queue that lo does not have,
+     * whether or not the kernel and the privileges allow AF_XDP at all */
+    test_uri(upipe_xdp_sink, "lo-4095@239.0.0.1:1234", UBASE_ERR_EXTERNAL);
+    test_uri(upipe_xdp_sink, "lo-4095@239.0.0.1:1234/generic",
+             UBASE_ERR_EXTERNAL);
+
+    /* a buffer received while closed is dropped */
+    struct uref *uref = uref_block_alloc(uref_mgr, ubuf_mgr, PAYLOAD_SIZE);
+    assert(uref != NULL);
+    uint8_t *buffer;
+    int size = -1;
+    ubase_assert(uref_block_write(uref, 0, &size, &buffer));
+    assert(size == PAYLOAD_SIZE);
+    memset(buffer, 0x47, size);
+    uref_block_unmap(uref, 0);
+    upipe_input(upipe_xdp_sink, uref, NULL);
+
+    /* closing an already closed sink is allowed */
+    ubase_assert(upipe_set_uri(upipe_xdp_sink, NULL));
+    ubase_assert(upipe_flush(upipe_xdp_sink));
+
+    upipe_release(upipe_xdp_sink);
+    upipe_mgr_release(upipe_xdp_sink_mgr);
+
+    upump_mgr_release(upump_mgr);
+    uref_mgr_release(uref_mgr);
+    ubuf_mgr_release(ubuf_mgr);
+    udict_mgr_release(udict_mgr);
+    umem_mgr_release(umem_mgr);
+    uprobe_release(logger);
+    uprobe_clean(&uprobe);
+
+    return 0;
+}